@@ -719,6 +719,39 @@ t_hmac (const void *plaintext,
 }
 
 
+/**
+ * Key the HMAC of an HMAC-HASH.
+ *
+ * @param key Key to use.
+ * @param[out] hc HMAC context to initialize, to be cleared by the caller.
+ */
+static void
+t_ax_hmac_key (const struct GNUNET_CRYPTO_SymmetricSessionKey *key,
+               struct GNUNET_CRYPTO_HmacContext *hc)
+{
+  static const char ctx[] = "axolotl HMAC-HASH";
+  static struct GNUNET_CRYPTO_KdfContext kc;
+  static int once;
+  struct GNUNET_CRYPTO_AuthKey auth_key;
+
+  if (! once)
+  {
+    once = 1;
+    GNUNET_CRYPTO_kdf_context_init (&kc,
+                                    ctx, sizeof(ctx));
+  }
+  GNUNET_CRYPTO_kdf_context_derive (&kc,
+                                    auth_key.key, sizeof(auth_key.key),
+                                    key, sizeof(*key),
+                                    NULL);
+  GNUNET_CRYPTO_hmac_context_init (hc,
+                                   auth_key.key,
+                                   sizeof(auth_key.key));
+  GNUNET_CRYPTO_zero_keys (&auth_key,
+                           sizeof(auth_key));
+}
+
+
 /**
  * Perform a HMAC.
  *
@@ -733,45 +766,79 @@ t_ax_hmac_hash (const struct GNUNET_CRYPTO_SymmetricSessionKey *key,
                 const void *source,
                 unsigned int len)
 {
-  static const char ctx[] = "axolotl HMAC-HASH";
-  struct GNUNET_CRYPTO_AuthKey auth_key;
+  struct GNUNET_CRYPTO_HmacContext hc;
 
-  GNUNET_CRYPTO_hmac_derive_key (&auth_key,
-                                 key,
-                                 ctx, sizeof(ctx),
-                                 NULL);
-  GNUNET_CRYPTO_hmac (&auth_key,
-                      source,
-                      len,
-                      hash);
+  t_ax_hmac_key (key,
+                 &hc);
+  GNUNET_CRYPTO_hmac_context_calculate (&hc,
+                                        source,
+                                        len,
+                                        hash);
+  GNUNET_CRYPTO_hmac_context_clear (&hc);
 }
 
 
 /**
  * Derive a symmetric encryption key from an HMAC-HASH.
  *
- * @param key Key to use for the HMAC.
+ * @param hc HMAC keyed with #t_ax_hmac_key().
  * @param[out] out Key to generate.
  * @param source Source key material (data to HMAC).
  * @param len Length of @a source.
  */
 static void
-t_hmac_derive_key (const struct GNUNET_CRYPTO_SymmetricSessionKey *key,
+t_hmac_derive_key (const struct GNUNET_CRYPTO_HmacContext *hc,
                    struct GNUNET_CRYPTO_SymmetricSessionKey *out,
                    const void *source,
                    unsigned int len)
 {
   static const char ctx[] = "axolotl derive key";
+  static struct GNUNET_CRYPTO_KdfContext kc;
+  static int once;
   struct GNUNET_HashCode h;
 
-  t_ax_hmac_hash (key,
-                  &h,
-                  source,
-                  len);
-  GNUNET_CRYPTO_kdf (out, sizeof(*out),
-                     ctx, sizeof(ctx),
-                     &h, sizeof(h),
-                     NULL);
+  if (! once)
+  {
+    once = 1;
+    GNUNET_CRYPTO_kdf_context_init (&kc,
+                                    ctx, sizeof(ctx));
+  }
+  GNUNET_CRYPTO_hmac_context_calculate (hc,
+                                        source,
+                                        len,
+                                        &h);
+  GNUNET_CRYPTO_kdf_context_derive (&kc,
+                                    out, sizeof(*out),
+                                    &h, sizeof(h),
+                                    NULL);
+}
+
+
+/**
+ * Advance a chain key.  The message key and the next chain key are
+ * both derived from HMAC-HASHes with the current chain key, so the
+ * HMAC is only keyed once.
+ *
+ * @param[in,out] ck Chain key to advance.
+ * @param[out] mk Message key to generate.
+ */
+static void
+t_ax_chain_step (struct GNUNET_CRYPTO_SymmetricSessionKey *ck,
+                 struct GNUNET_CRYPTO_SymmetricSessionKey *mk)
+{
+  struct GNUNET_CRYPTO_HmacContext hc;
+
+  t_ax_hmac_key (ck,
+                 &hc);
+  t_hmac_derive_key (&hc,
+                     mk,
+                     "0",
+                     1);
+  t_hmac_derive_key (&hc,
+                     ck,
+                     "1",
+                     1);
+  GNUNET_CRYPTO_hmac_context_clear (&hc);
 }
 
 
@@ -838,10 +905,8 @@ t_ax_encrypt (struct CadetTunnelAxolotl *ax,
                                   ratchet_time);
   }
 
-  t_hmac_derive_key (&ax->CKs,
-                     &MK,
-                     "0",
-                     1);
+  t_ax_chain_step (&ax->CKs,
+                   &MK);
   GNUNET_CRYPTO_symmetric_derive_iv (&iv,
                                      &MK,
                                      NULL, 0,
@@ -853,10 +918,6 @@ t_ax_encrypt (struct CadetTunnelAxolotl *ax,
                                               &iv,
                                               dst);
   GNUNET_assert (size == out_size);
-  t_hmac_derive_key (&ax->CKs,
-                     &ax->CKs,
-                     "1",
-                     1);
 }
 
 
@@ -878,10 +939,8 @@ t_ax_decrypt (struct CadetTunnelAxolotl *ax,
   struct GNUNET_CRYPTO_SymmetricInitializationVector iv;
   size_t out_size;
 
-  t_hmac_derive_key (&ax->CKr,
-                     &MK,
-                     "0",
-                     1);
+  t_ax_chain_step (&ax->CKr,
+                   &MK);
   GNUNET_CRYPTO_symmetric_derive_iv (&iv,
                                      &MK,
                                      NULL, 0,
@@ -893,10 +952,6 @@ t_ax_decrypt (struct CadetTunnelAxolotl *ax,
                                               &iv,
                                               dst);
   GNUNET_assert (out_size == size);
-  t_hmac_derive_key (&ax->CKr,
-                     &ax->CKr,
-                     "1",
-                     1);
 }
 
 
@@ -1084,14 +1139,8 @@ store_skipped_key (struct CadetTunnelAxolotl *ax,
   key->timestamp = GNUNET_TIME_absolute_get ();
   key->Kn = ax->Nr;
   key->HK = ax->HKr;
-  t_hmac_derive_key (&ax->CKr,
-                     &key->MK,
-                     "0",
-                     1);
-  t_hmac_derive_key (&ax->CKr,
-                     &ax->CKr,
-                     "1",
-                     1);
+  t_ax_chain_step (&ax->CKr,
+                   &key->MK);
   GNUNET_CONTAINER_DLL_insert (ax->skipped_head,
                                ax->skipped_tail,
                                key);
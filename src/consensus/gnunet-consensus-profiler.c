@@ -35,12 +35,20 @@ static unsigned int replication = 1;
 
 static unsigned int num_values = 5;
 
+static unsigned int num_rounds = 1;
+
 static struct GNUNET_TIME_Relative conclude_timeout;
 
 static struct GNUNET_TIME_Relative consensus_delay;
 
 static struct GNUNET_CONSENSUS_Handle **consensus_handles;
 
+/**
+ * Configurations of the peers, needed to connect again for
+ * further rounds.
+ */
+static const struct GNUNET_CONFIGURATION_Handle **peer_cfgs;
+
 static struct GNUNET_TESTBED_Operation **testbed_operations;
 
 static unsigned int num_connected_handles;
@@ -55,6 +63,8 @@ static struct GNUNET_HashCode session_id;
 
 static unsigned int peers_done = 0;
 
+static unsigned int rounds_done = 0;
+
 static int dist_static;
 
 static unsigned *results_for_peer;
@@ -83,6 +93,11 @@ static struct GNUNET_TIME_Absolute start;
  */
 static struct GNUNET_TIME_Absolute deadline;
 
+/**
+ * Start time of the first round.
+ */
+static struct GNUNET_TIME_Absolute first_start;
+
 
 /**
  * Signature of the event handler function called by the
@@ -143,6 +158,44 @@ statistics_cb (void *cls,
 }
 
 
+static void
+do_consensus ();
+
+
+static void
+new_element_cb (void *cls,
+                const struct GNUNET_SET_Element *element);
+
+
+/**
+ * Start another round of consensus with fresh values
+ * among the same peers.
+ */
+static void
+start_round ()
+{
+  struct GNUNET_HashCode round_hash;
+
+  GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+              "starting round %u\n",
+              rounds_done + 1);
+  peers_done = 0;
+  GNUNET_CRYPTO_hash (&rounds_done, sizeof(rounds_done), &round_hash);
+  GNUNET_CRYPTO_hash_xor (&session_id, &round_hash, &session_id);
+  start = GNUNET_TIME_absolute_get ();
+  deadline = GNUNET_TIME_absolute_add (start, conclude_timeout);
+  for (unsigned int i = 0; i < num_peers; i++)
+    consensus_handles[i] = GNUNET_CONSENSUS_create (peer_cfgs[i],
+                                                    num_peers, peer_ids,
+                                                    &session_id,
+                                                    start,
+                                                    deadline,
+                                                    &new_element_cb,
+                                                    &consensus_handles[i]);
+  do_consensus ();
+}
+
+
 static void
 destroy (void *cls)
 {
@@ -154,14 +207,30 @@ destroy (void *cls)
   peers_done++;
   if (peers_done == num_peers)
   {
+    struct GNUNET_TIME_Relative duration;
     unsigned int i;
+
+    rounds_done++;
+    if (rounds_done < num_rounds)
+    {
+      start_round ();
+      return;
+    }
+    duration = GNUNET_TIME_absolute_get_duration (first_start);
     for (i = 0; i < num_peers; i++)
       GNUNET_TESTBED_operation_done (testbed_operations[i]);
     for (i = 0; i < num_peers; i++)
       printf ("P%u got %u of %u elements\n",
               i,
               results_for_peer[i],
-              num_values);
+              num_values * num_rounds);
+    printf ("%u rounds with %u values took %s (%.2f rounds/s)\n",
+            num_rounds,
+            num_values,
+            GNUNET_STRINGS_relative_time_to_string (duration,
+                                                    GNUNET_YES),
+            num_rounds * 1000000.0
+            / GNUNET_MAX (duration.rel_value_us, 1));
     if (NULL != statistics_filename)
       statistics_file = fopen (statistics_filename, "w");
     GNUNET_TESTBED_get_statistics (num_peers, peers, NULL, NULL,
@@ -346,6 +415,7 @@ connect_adapter (void *cls,
   struct GNUNET_CONSENSUS_Handle *consensus;
 
   chp = (struct GNUNET_CONSENSUS_Handle **) cls;
+  peer_cfgs[chp - consensus_handles] = cfg;
 
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
               "connect adapter, %d peers\n",
@@ -454,6 +524,8 @@ test_master (void *cls,
   results_for_peer = GNUNET_malloc (num_peers * sizeof(unsigned int));
   consensus_handles = GNUNET_malloc (num_peers * sizeof(struct
                                                         ConsensusHandle *));
+  peer_cfgs = GNUNET_malloc (num_peers * sizeof(struct
+                                                GNUNET_CONFIGURATION_Handle *));
   testbed_operations = GNUNET_malloc (num_peers * sizeof(struct
                                                          ConsensusHandle *));
 
@@ -500,9 +572,16 @@ run (void *cls, char *const *args, const char *cfgfile,
     return;
   }
 
+  if (0 == num_rounds)
+  {
+    fprintf (stderr, "r must be >0\n");
+    return;
+  }
+
   start = GNUNET_TIME_absolute_add (GNUNET_TIME_absolute_get (),
                                     consensus_delay);
   deadline = GNUNET_TIME_absolute_add (start, conclude_timeout);
+  first_start = start;
 
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
               "running gnunet-consensus\n");
@@ -543,6 +622,13 @@ main (int argc, char **argv)
                                gettext_noop ("number of values"),
                                &num_values),
 
+    GNUNET_GETOPT_option_uint ('r',
+                               "rounds",
+                               NULL,
+                               gettext_noop (
+                                 "number of consecutive consensus rounds to run and time"),
+                               &num_rounds),
+
     GNUNET_GETOPT_option_relative_time ('t',
                                         "timeout",
                                         NULL,
@@ -2441,8 +2441,12 @@ start_task (struct ConsensusSession *session,
 
 
 /*
- * Run all steps of the session that don't any
+ * Run all steps of the session that don't have any
  * more dependencies.
+ *
+ * Steps without dependencies on each other, such as the
+ * gradecasts of the different leaders, run concurrently, so that
+ * their set operations with the other peers overlap.
  */
 static void
 run_ready_steps (struct ConsensusSession *session)
@@ -2475,8 +2479,8 @@ run_ready_steps (struct ConsensusSession *session)
                                                         step->is_finished))
         finish_step (step);
 
-      /* Running the next ready steps will be triggered by task completion */
-      return;
+      /* Steps that only become ready once this one finishes
+         will be started by task completion. */
     }
     step = step->next;
   }
@@ -98,6 +98,56 @@ struct LookupResultMessage
 };
 
 
+/**
+ * The result was taken from the result cache of the service.
+ */
+#define GNS_TRACE_FLAG_CACHE_HIT 1
+
+/**
+ * The lookup waited for an identical lookup.
+ */
+#define GNS_TRACE_FLAG_COALESCED 2
+
+
+/**
+ * Message from GNS service to client: where the time of a lookup
+ * was spent.  Sent right before the #LookupResultMessage if the
+ * client asked for it with #GNUNET_GNS_LO_TRACE.
+ */
+struct LookupTraceMessage
+{
+  /**
+   * Header of type #GNUNET_MESSAGE_TYPE_GNS_LOOKUP_TRACE
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Unique identifier for this request (for key collisions).
+   */
+  uint32_t id GNUNET_PACKED;
+
+  /**
+   * Combination of GNS_TRACE_FLAG_* values, in NBO.
+   */
+  uint32_t flags GNUNET_PACKED;
+
+  /**
+   * Total time the service spent on the lookup.
+   */
+  struct GNUNET_TIME_RelativeNBO total;
+
+  /**
+   * Time spent in each `enum GNUNET_GNS_LookupPhase`.
+   */
+  struct GNUNET_TIME_RelativeNBO phase_time[GNUNET_GNS_PHASE_MAX];
+
+  /**
+   * How often the lookup entered each phase, in NBO.
+   */
+  uint32_t phase_count[GNUNET_GNS_PHASE_MAX] GNUNET_PACKED;
+};
+
+
 GNUNET_NETWORK_STRUCT_END
 
 #endif
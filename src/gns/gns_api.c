@@ -77,10 +77,20 @@ struct GNUNET_GNS_LookupRequest
    */
   struct GNUNET_MQ_Envelope *env;
 
+  /**
+   * Trace of the lookup, valid if @e have_trace is set.
+   */
+  struct GNUNET_GNS_LookupTrace trace;
+
   /**
    * request id
    */
   uint32_t r_id;
+
+  /**
+   * #GNUNET_YES if the service sent us a trace.
+   */
+  int have_trace;
 };
 
 
@@ -148,6 +158,44 @@ mq_error_handler (void *cls,
 }
 
 
+/**
+ * Handler for traces received from the GNS service.  Stores the
+ * trace in the request until the result arrives.
+ *
+ * @param cls the `struct GNUNET_GNS_Handle *`
+ * @param trace_msg the incoming message
+ */
+static void
+handle_trace (void *cls,
+              const struct LookupTraceMessage *trace_msg)
+{
+  struct GNUNET_GNS_Handle *handle = cls;
+  uint32_t r_id = ntohl (trace_msg->id);
+  uint32_t flags = ntohl (trace_msg->flags);
+  struct GNUNET_GNS_LookupRequest *lr;
+
+  for (lr = handle->lookup_head; NULL != lr; lr = lr->next)
+    if (lr->r_id == r_id)
+      break;
+  if (NULL == lr)
+    return;
+  lr->trace.total = GNUNET_TIME_relative_ntoh (trace_msg->total);
+  for (unsigned int i = 0; i < GNUNET_GNS_PHASE_MAX; i++)
+  {
+    lr->trace.phase_time[i]
+      = GNUNET_TIME_relative_ntoh (trace_msg->phase_time[i]);
+    lr->trace.phase_count[i] = ntohl (trace_msg->phase_count[i]);
+  }
+  lr->trace.cache_hit = (0 != (flags & GNS_TRACE_FLAG_CACHE_HIT))
+                        ? GNUNET_YES
+                        : GNUNET_NO;
+  lr->trace.coalesced = (0 != (flags & GNS_TRACE_FLAG_COALESCED))
+                        ? GNUNET_YES
+                        : GNUNET_NO;
+  lr->have_trace = GNUNET_YES;
+}
+
+
 /**
  * Check validity of message received from the GNS service
  *
@@ -233,6 +281,10 @@ static void
 reconnect (struct GNUNET_GNS_Handle *handle)
 {
   struct GNUNET_MQ_MessageHandler handlers[] = {
+    GNUNET_MQ_hd_fixed_size (trace,
+                             GNUNET_MESSAGE_TYPE_GNS_LOOKUP_TRACE,
+                             struct LookupTraceMessage,
+                             handle),
     GNUNET_MQ_hd_var_size (result,
                            GNUNET_MESSAGE_TYPE_GNS_LOOKUP_RESULT,
                            struct LookupResultMessage,
@@ -396,6 +448,56 @@ GNUNET_GNS_lookup_limited (struct GNUNET_GNS_Handle *handle,
 }
 
 
+/**
+ * Get the trace of a lookup that was started with the
+ * #GNUNET_GNS_LO_TRACE option.  May only be called from
+ * within the result processor of the lookup.
+ *
+ * @param lr the lookup request
+ * @return the trace, NULL if the service did not provide one
+ */
+const struct GNUNET_GNS_LookupTrace *
+GNUNET_GNS_lookup_get_trace (const struct GNUNET_GNS_LookupRequest *lr)
+{
+  if (GNUNET_YES != lr->have_trace)
+    return NULL;
+  return &lr->trace;
+}
+
+
+/**
+ * Get a human-readable name for a lookup phase.
+ *
+ * @param phase the phase
+ * @return name of the phase, e.g. "namecache"
+ */
+const char *
+GNUNET_GNS_phase_to_string (enum GNUNET_GNS_LookupPhase phase)
+{
+  switch (phase)
+  {
+  case GNUNET_GNS_PHASE_NAMECACHE:
+    return "namecache";
+
+  case GNUNET_GNS_PHASE_DHT:
+    return "DHT";
+
+  case GNUNET_GNS_PHASE_REVOCATION:
+    return "revocation";
+
+  case GNUNET_GNS_PHASE_DNS:
+    return "DNS";
+
+  case GNUNET_GNS_PHASE_VPN:
+    return "VPN";
+
+  default:
+    GNUNET_break (0);
+    return "unknown";
+  }
+}
+
+
 /**
  * Perform an asynchronous lookup operation on the GNS.
  *
@@ -68,6 +68,11 @@ struct GNUNET_GNS_LookupWithTldRequest
    */
   struct GNUNET_GNS_LookupRequest *lr;
 
+  /**
+   * Trace of @e lr, only set while the result processor runs.
+   */
+  const struct GNUNET_GNS_LookupTrace *trace;
+
   /**
    * Lookup an ego with the identity service.
    */
@@ -153,6 +158,7 @@ process_lookup_result (void *cls,
 {
   struct GNUNET_GNS_LookupWithTldRequest *ltr = cls;
 
+  ltr->trace = GNUNET_GNS_lookup_get_trace (ltr->lr);
   ltr->lr = NULL;
   ltr->lookup_proc (ltr->lookup_proc_cls, GNUNET_YES, rd_count, rd);
   GNUNET_GNS_lookup_with_tld_cancel (ltr);
@@ -216,9 +222,10 @@ identity_zone_cb (void *cls,
   }
   /* if the name is of the form 'label' (and not 'label.SUBDOMAIN'), never go to the DHT */
   if (NULL == strchr (ltr->name, (unsigned char) '.'))
-    ltr->options = GNUNET_GNS_LO_NO_DHT;
+    ltr->options = GNUNET_GNS_LO_NO_DHT | (ltr->options & GNUNET_GNS_LO_TRACE);
   else
-    ltr->options = GNUNET_GNS_LO_LOCAL_MASTER;
+    ltr->options = GNUNET_GNS_LO_LOCAL_MASTER
+                   | (ltr->options & GNUNET_GNS_LO_TRACE);
   GNUNET_IDENTITY_key_get_public (priv, &pkey);
   lookup_with_public_key (ltr, &pkey);
 }
@@ -350,4 +357,21 @@ GNUNET_GNS_lookup_with_tld_cancel (struct GNUNET_GNS_LookupWithTldRequest *ltr)
 }
 
 
+/**
+ * Get the trace of a lookup that was started with the
+ * #GNUNET_GNS_LO_TRACE option.  May only be called from
+ * within the result processor of the lookup.
+ *
+ * @param ltr the lookup request
+ * @return the trace, NULL if the service did not provide one
+ *         (or no GNS lookup was made)
+ */
+const struct GNUNET_GNS_LookupTrace *
+GNUNET_GNS_lookup_with_tld_get_trace (
+  const struct GNUNET_GNS_LookupWithTldRequest *ltr)
+{
+  return ltr->trace;
+}
+
+
 /* end of gns_tld_api.c */
@@ -34,6 +34,93 @@
  */
 #define TIMEOUT GNUNET_TIME_UNIT_MINUTES
 
+/**
+ * How many datagrams do we read from a socket at most before
+ * giving other tasks a chance to run?
+ */
+#define RECV_BATCH_SIZE 32
+
+/**
+ * Maximum size of a DNS request we accept via UDP.
+ */
+#define MAX_UDP_SIZE UINT16_MAX
+
+/**
+ * Default number of answers we keep in the answer cache.
+ */
+#define DEFAULT_CACHE_SIZE 4096
+
+
+/**
+ * Socket we listen on for DNS requests.
+ */
+struct ListenSocket
+{
+  /**
+   * Kept in a DLL.
+   */
+  struct ListenSocket *next;
+
+  /**
+   * Kept in a DLL.
+   */
+  struct ListenSocket *prev;
+
+  /**
+   * The socket.
+   */
+  struct GNUNET_NETWORK_Handle *sock;
+
+  /**
+   * Task reading from @e sock.
+   */
+  struct GNUNET_SCHEDULER_Task *read_task;
+};
+
+
+/**
+ * Answer from GNS that we remember to answer the same question
+ * again without asking GNS.
+ */
+struct CacheEntry
+{
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct CacheEntry *next;
+
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct CacheEntry *prev;
+
+  /**
+   * Hash over the name and type of the question.
+   */
+  struct GNUNET_HashCode key;
+
+  /**
+   * When does the first of the records expire?
+   */
+  struct GNUNET_TIME_Absolute expiration;
+
+  /**
+   * Number of records in @e rd_ser.
+   */
+  unsigned int rd_count;
+
+  /**
+   * Number of bytes in @e rd_ser.
+   */
+  size_t rd_len;
+
+  /**
+   * Serialized records, allocated at the end of this struct.
+   */
+  const char *rd_ser;
+};
+
+
 /**
  * Data kept per request.
  */
@@ -86,6 +173,11 @@ struct Request
    */
   size_t udp_msg_size;
 
+  /**
+   * Key of the question in the #cache.
+   */
+  struct GNUNET_HashCode cache_key;
+
   /**
    * ID of the original request.
    */
@@ -114,24 +206,39 @@ struct GNUNET_GNS_Handle *gns;
 struct GNUNET_DNSSTUB_Context *dns_stub;
 
 /**
- * Listen socket for IPv4.
+ * Sockets we listen on, kept in a DLL.
  */
-static struct GNUNET_NETWORK_Handle *listen_socket4;
+static struct ListenSocket *ls_head;
 
 /**
- * Listen socket for IPv6.
+ * Sockets we listen on, kept in a DLL.
  */
-static struct GNUNET_NETWORK_Handle *listen_socket6;
+static struct ListenSocket *ls_tail;
 
 /**
- * Task for IPv4 socket.
+ * How many sockets do we open per address family?
  */
-static struct GNUNET_SCHEDULER_Task *t4;
+static unsigned long long num_sockets;
 
 /**
- * Task for IPv6 socket.
+ * Map from question hashes to `struct CacheEntry`s.
  */
-static struct GNUNET_SCHEDULER_Task *t6;
+static struct GNUNET_CONTAINER_MultiHashMap *cache;
+
+/**
+ * Cache entries, most recently used first.
+ */
+static struct CacheEntry *ce_head;
+
+/**
+ * Cache entries, most recently used first.
+ */
+static struct CacheEntry *ce_tail;
+
+/**
+ * Maximum number of entries in the #cache.
+ */
+static unsigned long long cache_size;
 
 /**
  * IP of DNS server
@@ -157,26 +264,31 @@ static const struct GNUNET_CONFIGURATION_Handle *cfg;
 static void
 do_shutdown (void *cls)
 {
+  struct ListenSocket *ls;
+  struct CacheEntry *ce;
+
   (void) cls;
-  if (NULL != t4)
-  {
-    GNUNET_SCHEDULER_cancel (t4);
-    t4 = NULL;
-  }
-  if (NULL != t6)
+  while (NULL != (ls = ls_head))
   {
-    GNUNET_SCHEDULER_cancel (t6);
-    t6 = NULL;
+    GNUNET_CONTAINER_DLL_remove (ls_head,
+                                 ls_tail,
+                                 ls);
+    if (NULL != ls->read_task)
+      GNUNET_SCHEDULER_cancel (ls->read_task);
+    GNUNET_NETWORK_socket_close (ls->sock);
+    GNUNET_free (ls);
   }
-  if (NULL != listen_socket4)
+  while (NULL != (ce = ce_head))
   {
-    GNUNET_NETWORK_socket_close (listen_socket4);
-    listen_socket4 = NULL;
+    GNUNET_CONTAINER_DLL_remove (ce_head,
+                                 ce_tail,
+                                 ce);
+    GNUNET_free (ce);
   }
-  if (NULL != listen_socket6)
+  if (NULL != cache)
   {
-    GNUNET_NETWORK_socket_close (listen_socket6);
-    listen_socket6 = NULL;
+    GNUNET_CONTAINER_multihashmap_destroy (cache);
+    cache = NULL;
   }
   if (NULL != gns)
   {
@@ -191,6 +303,188 @@ do_shutdown (void *cls)
 }
 
 
+/**
+ * Compute the key of a question in the #cache.
+ *
+ * @param q the question
+ * @param key[out] set to the key
+ */
+static void
+get_cache_key (const struct GNUNET_DNSPARSER_Query *q,
+               struct GNUNET_HashCode *key)
+{
+  size_t nlen = strlen (q->name);
+  char buf[nlen + sizeof(uint16_t)];
+  uint16_t type = htons (q->type);
+
+  /* DNS names are case-insensitive */
+  for (size_t i = 0; i < nlen; i++)
+    buf[i] = tolower ((unsigned char) q->name[i]);
+  GNUNET_memcpy (&buf[nlen],
+                 &type,
+                 sizeof(type));
+  GNUNET_CRYPTO_hash (buf,
+                      sizeof(buf),
+                      key);
+}
+
+
+/**
+ * Get the absolute expiration time of @a rd.
+ *
+ * @param rd a record
+ * @return when @a rd expires
+ */
+static struct GNUNET_TIME_Absolute
+get_expiration (const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct GNUNET_TIME_Absolute at;
+
+  if (0 != (rd->flags & GNUNET_GNSRECORD_RF_RELATIVE_EXPIRATION))
+  {
+    struct GNUNET_TIME_Relative rt;
+
+    rt.rel_value_us = rd->expiration_time;
+    return GNUNET_TIME_relative_to_absolute (rt);
+  }
+  at.abs_value_us = rd->expiration_time;
+  return at;
+}
+
+
+/**
+ * Remember the answer from GNS for the question of @a request
+ * until the first of the records expires.  Relative expiration
+ * times are made absolute, so that the TTLs of cached answers
+ * shrink with the time the answer spent in the cache.
+ *
+ * @param request request the answer is for
+ * @param rd_count number of records in @a rd
+ * @param rd the records
+ */
+static void
+cache_answer (const struct Request *request,
+              uint32_t rd_count,
+              const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct CacheEntry *ce;
+  struct GNUNET_TIME_Absolute expiration;
+  struct GNUNET_GNSRECORD_Data rd_abs[GNUNET_NZL (rd_count)];
+  ssize_t rd_len;
+
+  if ((0 == cache_size) ||
+      (0 == rd_count))
+    return;
+  expiration = GNUNET_TIME_UNIT_FOREVER_ABS;
+  for (uint32_t i = 0; i < rd_count; i++)
+  {
+    struct GNUNET_TIME_Absolute at = get_expiration (&rd[i]);
+
+    rd_abs[i] = rd[i];
+    rd_abs[i].expiration_time = at.abs_value_us;
+    rd_abs[i].flags &= ~GNUNET_GNSRECORD_RF_RELATIVE_EXPIRATION;
+    expiration = GNUNET_TIME_absolute_min (expiration,
+                                           at);
+  }
+  if (0 == GNUNET_TIME_absolute_get_remaining (expiration).rel_value_us)
+    return;
+  rd_len = GNUNET_GNSRECORD_records_get_size (rd_count,
+                                              rd_abs);
+  if (rd_len < 0)
+  {
+    GNUNET_break (0);
+    return;
+  }
+  ce = GNUNET_CONTAINER_multihashmap_get (cache,
+                                          &request->cache_key);
+  if (NULL == ce)
+  {
+    while (GNUNET_CONTAINER_multihashmap_size (cache) >= cache_size)
+    {
+      struct CacheEntry *old = ce_tail;
+
+      GNUNET_assert (GNUNET_YES ==
+                     GNUNET_CONTAINER_multihashmap_remove (cache,
+                                                           &old->key,
+                                                           old));
+      GNUNET_CONTAINER_DLL_remove (ce_head,
+                                   ce_tail,
+                                   old);
+      GNUNET_free (old);
+    }
+  }
+  else
+  {
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (cache,
+                                                         &ce->key,
+                                                         ce));
+    GNUNET_CONTAINER_DLL_remove (ce_head,
+                                 ce_tail,
+                                 ce);
+    GNUNET_free (ce);
+  }
+  ce = GNUNET_malloc (sizeof(struct CacheEntry) + rd_len);
+  ce->key = request->cache_key;
+  ce->expiration = expiration;
+  ce->rd_count = rd_count;
+  ce->rd_len = rd_len;
+  ce->rd_ser = (const char *) &ce[1];
+  GNUNET_assert (rd_len ==
+                 GNUNET_GNSRECORD_records_serialize (rd_count,
+                                                     rd_abs,
+                                                     rd_len,
+                                                     (char *) &ce[1]));
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_multihashmap_put (cache,
+                                                    &ce->key,
+                                                    ce,
+                                                    GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  GNUNET_CONTAINER_DLL_insert (ce_head,
+                               ce_tail,
+                               ce);
+}
+
+
+/**
+ * Find a cached answer for the question of @a request.
+ *
+ * @param request the request
+ * @return NULL if we have no valid answer cached
+ */
+static struct CacheEntry *
+lookup_cache (const struct Request *request)
+{
+  struct CacheEntry *ce;
+
+  if (0 == cache_size)
+    return NULL;
+  ce = GNUNET_CONTAINER_multihashmap_get (cache,
+                                          &request->cache_key);
+  if (NULL == ce)
+    return NULL;
+  if (0 == GNUNET_TIME_absolute_get_remaining (ce->expiration).rel_value_us)
+  {
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (cache,
+                                                         &ce->key,
+                                                         ce));
+    GNUNET_CONTAINER_DLL_remove (ce_head,
+                                 ce_tail,
+                                 ce);
+    GNUNET_free (ce);
+    return NULL;
+  }
+  GNUNET_CONTAINER_DLL_remove (ce_head,
+                               ce_tail,
+                               ce);
+  GNUNET_CONTAINER_DLL_insert (ce_head,
+                               ce_tail,
+                               ce);
+  return ce;
+}
+
+
 /**
  * Shuffle answers
  * Fisher-Yates (aka Knuth) Shuffle
@@ -323,41 +617,21 @@ dns_result_processor (void *cls,
 
 
 /**
- * Iterator called on obtained result for a GNS lookup.
+ * Convert the records from GNS into the answer for @a request,
+ * then send the response.
  *
- * @param cls closure
- * @param was_gns #GNUNET_NO if the TLD is not configured for GNS
+ * @param request the request to answer
  * @param rd_count number of records in @a rd
  * @param rd the records in reply
  */
 static void
-result_processor (void *cls,
-                  int was_gns,
-                  uint32_t rd_count,
-                  const struct GNUNET_GNSRECORD_Data *rd)
+answer_from_records (struct Request *request,
+                     uint32_t rd_count,
+                     const struct GNUNET_GNSRECORD_Data *rd)
 {
-  struct Request *request = cls;
   struct GNUNET_DNSPARSER_Packet *packet;
   struct GNUNET_DNSPARSER_Record rec;
 
-  request->lookup = NULL;
-  if (GNUNET_NO == was_gns)
-  {
-    /* TLD not configured for GNS, fall back to DNS */
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                "Using DNS resolver IP `%s' to resolve `%s'\n",
-                dns_ip,
-                request->packet->queries[0].name);
-    request->original_request_id = request->packet->id;
-    GNUNET_DNSPARSER_free_packet (request->packet);
-    request->packet = NULL;
-    request->dns_lookup = GNUNET_DNSSTUB_resolve (dns_stub,
-                                                  request->udp_msg,
-                                                  request->udp_msg_size,
-                                                  &dns_result_processor,
-                                                  request);
-    return;
-  }
   packet = request->packet;
   packet->flags.query_or_response = 1;
   packet->flags.return_code = GNUNET_TUN_DNS_RETURN_CODE_NO_ERROR;
@@ -370,7 +644,7 @@ result_processor (void *cls,
   // packet->flags.opcode = GNUNET_TUN_DNS_OPCODE_STATUS; // ???
   for (uint32_t i = 0; i < rd_count; i++)
   {
-    rec.expiration_time.abs_value_us = rd[i].expiration_time;
+    rec.expiration_time = get_expiration (&rd[i]);
     switch (rd[i].record_type)
     {
     case GNUNET_DNSPARSER_TYPE_A:
@@ -425,6 +699,49 @@ result_processor (void *cls,
 }
 
 
+/**
+ * Iterator called on obtained result for a GNS lookup.
+ *
+ * @param cls closure
+ * @param was_gns #GNUNET_NO if the TLD is not configured for GNS
+ * @param rd_count number of records in @a rd
+ * @param rd the records in reply
+ */
+static void
+result_processor (void *cls,
+                  int was_gns,
+                  uint32_t rd_count,
+                  const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct Request *request = cls;
+
+  request->lookup = NULL;
+  if (GNUNET_NO == was_gns)
+  {
+    /* TLD not configured for GNS, fall back to DNS */
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Using DNS resolver IP `%s' to resolve `%s'\n",
+                dns_ip,
+                request->packet->queries[0].name);
+    request->original_request_id = request->packet->id;
+    GNUNET_DNSPARSER_free_packet (request->packet);
+    request->packet = NULL;
+    request->dns_lookup = GNUNET_DNSSTUB_resolve (dns_stub,
+                                                  request->udp_msg,
+                                                  request->udp_msg_size,
+                                                  &dns_result_processor,
+                                                  request);
+    return;
+  }
+  cache_answer (request,
+                rd_count,
+                rd);
+  answer_from_records (request,
+                       rd_count,
+                       rd);
+}
+
+
 /**
  * Handle DNS request.
  *
@@ -443,6 +760,7 @@ handle_request (struct GNUNET_NETWORK_Handle *lsock,
 {
   struct Request *request;
   struct GNUNET_DNSPARSER_Packet *packet;
+  struct CacheEntry *ce;
 
   packet = GNUNET_DNSPARSER_parse (udp_msg,
                                    udp_msg_size);
@@ -493,6 +811,28 @@ handle_request (struct GNUNET_NETWORK_Handle *lsock,
   request->timeout_task = GNUNET_SCHEDULER_add_delayed (TIMEOUT,
                                                         &do_timeout,
                                                         request);
+  get_cache_key (&packet->queries[0],
+                 &request->cache_key);
+  if (NULL != (ce = lookup_cache (request)))
+  {
+    struct GNUNET_GNSRECORD_Data rd[ce->rd_count];
+
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Answering `%s' from cache\n",
+                packet->queries[0].name);
+    if (GNUNET_OK ==
+        GNUNET_GNSRECORD_records_deserialize (ce->rd_len,
+                                              ce->rd_ser,
+                                              ce->rd_count,
+                                              rd))
+    {
+      answer_from_records (request,
+                           ce->rd_count,
+                           rd);
+      return;
+    }
+    GNUNET_break (0);
+  }
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Calling GNS on `%s'\n",
               packet->queries[0].name);
@@ -506,108 +846,160 @@ handle_request (struct GNUNET_NETWORK_Handle *lsock,
 
 
 /**
- * Task to read IPv4 DNS packets.
+ * Task to read DNS packets.  Reads up to #RECV_BATCH_SIZE
+ * packets per invocation, using a single system call if
+ * the platform supports it.
  *
- * @param cls the 'listen_socket4'
+ * @param cls the `struct ListenSocket` to read from
  */
 static void
-read_dns4 (void *cls)
+read_dns (void *cls)
 {
-  struct sockaddr_in v4;
-  socklen_t addrlen;
-  ssize_t size;
+  struct ListenSocket *ls = cls;
   const struct GNUNET_SCHEDULER_TaskContext *tc;
+  static char bufs[RECV_BATCH_SIZE][MAX_UDP_SIZE];
+  struct sockaddr_storage addrs[RECV_BATCH_SIZE];
 
-  GNUNET_assert (listen_socket4 == cls);
-  t4 = GNUNET_SCHEDULER_add_read_net (GNUNET_TIME_UNIT_FOREVER_REL,
-                                      listen_socket4,
-                                      &read_dns4,
-                                      listen_socket4);
+  ls->read_task = GNUNET_SCHEDULER_add_read_net (GNUNET_TIME_UNIT_FOREVER_REL,
+                                                 ls->sock,
+                                                 &read_dns,
+                                                 ls);
   tc = GNUNET_SCHEDULER_get_task_context ();
   if (0 == (GNUNET_SCHEDULER_REASON_READ_READY & tc->reason))
     return; /* shutdown? */
-  size = GNUNET_NETWORK_socket_recvfrom_amount (listen_socket4);
-  if (0 > size)
+#if HAVE_RECVMMSG
   {
-    GNUNET_break (0);
-    return;   /* read error!? */
+    struct mmsghdr msgs[RECV_BATCH_SIZE];
+    struct iovec iovs[RECV_BATCH_SIZE];
+    int n;
+
+    memset (msgs,
+            0,
+            sizeof(msgs));
+    for (unsigned int i = 0; i < RECV_BATCH_SIZE; i++)
+    {
+      iovs[i].iov_base = bufs[i];
+      iovs[i].iov_len = sizeof(bufs[i]);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+    n = recvmmsg (GNUNET_NETWORK_get_fd (ls->sock),
+                  msgs,
+                  RECV_BATCH_SIZE,
+                  MSG_DONTWAIT,
+                  NULL);
+    if (0 > n)
+    {
+      if ((EAGAIN != errno) &&
+          (EWOULDBLOCK != errno))
+        GNUNET_log_strerror (GNUNET_ERROR_TYPE_WARNING,
+                             "recvmmsg");
+      return;
+    }
+    for (int i = 0; i < n; i++)
+      handle_request (ls->sock,
+                      &addrs[i],
+                      msgs[i].msg_hdr.msg_namelen,
+                      bufs[i],
+                      msgs[i].msg_len);
   }
+#else
+  for (unsigned int i = 0; i < RECV_BATCH_SIZE; i++)
   {
-    char buf[size + 1];
+    socklen_t addrlen;
     ssize_t sret;
 
-    addrlen = sizeof(v4);
-    sret = GNUNET_NETWORK_socket_recvfrom (listen_socket4,
-                                           buf,
-                                           size + 1,
-                                           (struct sockaddr *) &v4,
+    addrlen = sizeof(addrs[0]);
+    sret = GNUNET_NETWORK_socket_recvfrom (ls->sock,
+                                           bufs[0],
+                                           sizeof(bufs[0]),
+                                           (struct sockaddr *) &addrs[0],
                                            &addrlen);
     if (0 > sret)
     {
-      GNUNET_log_strerror (GNUNET_ERROR_TYPE_WARNING,
-                           "recvfrom");
+      if ((EAGAIN != errno) &&
+          (EWOULDBLOCK != errno))
+        GNUNET_log_strerror (GNUNET_ERROR_TYPE_WARNING,
+                             "recvfrom");
       return;
     }
-    GNUNET_break (size == sret);
-    handle_request (listen_socket4,
-                    &v4,
+    handle_request (ls->sock,
+                    &addrs[0],
                     addrlen,
-                    buf,
-                    size);
+                    bufs[0],
+                    sret);
   }
+#endif
 }
 
 
 /**
- * Task to read IPv6 DNS packets.
+ * Open #num_sockets sockets bound to @a sa and start reading
+ * from them.  Where available, the sockets use SO_REUSEPORT, so
+ * that the kernel distributes the requests among them and among
+ * other dns2gns processes on the same port, even if each of them
+ * only opens one socket.
  *
- * @param cls the 'listen_socket6'
+ * @param pf protocol family of @a sa
+ * @param sa address to bind to
+ * @param sa_len number of bytes in @a sa
+ * @return number of sockets opened
  */
-static void
-read_dns6 (void *cls)
+static unsigned int
+open_listen_sockets (int pf,
+                     const struct sockaddr *sa,
+                     socklen_t sa_len)
 {
-  struct sockaddr_in6 v6;
-  socklen_t addrlen;
-  ssize_t size;
-  const struct GNUNET_SCHEDULER_TaskContext *tc;
+  unsigned int ret = 0;
 
-  GNUNET_assert (listen_socket6 == cls);
-  t6 = GNUNET_SCHEDULER_add_read_net (GNUNET_TIME_UNIT_FOREVER_REL,
-                                      listen_socket6,
-                                      &read_dns6,
-                                      listen_socket6);
-  tc = GNUNET_SCHEDULER_get_task_context ();
-  if (0 == (GNUNET_SCHEDULER_REASON_READ_READY & tc->reason))
-    return; /* shutdown? */
-  size = GNUNET_NETWORK_socket_recvfrom_amount (listen_socket6);
-  if (0 > size)
+  for (unsigned long long i = 0; i < num_sockets; i++)
   {
-    GNUNET_break (0);
-    return;   /* read error!? */
-  }
-  {
-    char buf[size];
-    ssize_t sret;
+    struct GNUNET_NETWORK_Handle *sock;
+    struct ListenSocket *ls;
 
-    addrlen = sizeof(v6);
-    sret = GNUNET_NETWORK_socket_recvfrom (listen_socket6,
-                                           buf,
-                                           size,
-                                           (struct sockaddr *) &v6,
-                                           &addrlen);
-    if (0 > sret)
+    sock = GNUNET_NETWORK_socket_create (pf,
+                                         SOCK_DGRAM,
+                                         IPPROTO_UDP);
+    if (NULL == sock)
+      break;
+#ifdef SO_REUSEPORT
     {
-      GNUNET_log_strerror (GNUNET_ERROR_TYPE_WARNING,
-                           "recvfrom");
-      return;
+      const int on = 1;
+
+      if (GNUNET_OK !=
+          GNUNET_NETWORK_socket_setsockopt (sock,
+                                            SOL_SOCKET,
+                                            SO_REUSEPORT,
+                                            &on,
+                                            sizeof(on)))
+        GNUNET_log_strerror (GNUNET_ERROR_TYPE_WARNING,
+                             "setsockopt");
     }
-    GNUNET_break (size == sret);
-    handle_request (listen_socket6,
-                    &v6,
-                    addrlen,
-                    buf,
-                    size);
+#endif
+    if (GNUNET_OK !=
+        GNUNET_NETWORK_socket_bind (sock,
+                                    sa,
+                                    sa_len))
+    {
+      GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "bind");
+      GNUNET_NETWORK_socket_close (sock);
+      break;
+    }
+    ls = GNUNET_new (struct ListenSocket);
+    ls->sock = sock;
+    ls->read_task = GNUNET_SCHEDULER_add_read_net (
+      GNUNET_TIME_UNIT_FOREVER_REL,
+      sock,
+      &read_dns,
+      ls);
+    GNUNET_CONTAINER_DLL_insert (ls_head,
+                                 ls_tail,
+                                 ls);
+    ret++;
   }
+  return ret;
 }
 
 
@@ -696,11 +1088,32 @@ run (void *cls,
     return;
   }
   GNUNET_free (addr_str);
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (c,
+                                             "dns2gns",
+                                             "LISTEN_SOCKETS",
+                                             &num_sockets))
+    num_sockets = 1;
+  if (0 == num_sockets)
+    num_sockets = 1;
+#ifndef SO_REUSEPORT
+  if (num_sockets > 1)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                "SO_REUSEPORT not supported, using one socket\n");
+    num_sockets = 1;
+  }
+#endif
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (c,
+                                             "dns2gns",
+                                             "CACHE_SIZE",
+                                             &cache_size))
+    cache_size = DEFAULT_CACHE_SIZE;
+  if (0 != cache_size)
+    cache = GNUNET_CONTAINER_multihashmap_create (1024,
+                                                  GNUNET_NO);
 
-  listen_socket4 = GNUNET_NETWORK_socket_create (PF_INET,
-                                                 SOCK_DGRAM,
-                                                 IPPROTO_UDP);
-  if (NULL != listen_socket4)
   {
     struct sockaddr_in v4;
 
@@ -711,20 +1124,10 @@ run (void *cls,
     v4.sin_len = sizeof(v4);
 #endif
     v4.sin_port = htons (listen_port);
-    if (GNUNET_OK !=
-        GNUNET_NETWORK_socket_bind (listen_socket4,
-                                    (struct sockaddr *) &v4,
-                                    sizeof(v4)))
-    {
-      GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "bind");
-      GNUNET_NETWORK_socket_close (listen_socket4);
-      listen_socket4 = NULL;
-    }
+    (void) open_listen_sockets (PF_INET,
+                                (struct sockaddr *) &v4,
+                                sizeof(v4));
   }
-  listen_socket6 = GNUNET_NETWORK_socket_create (PF_INET6,
-                                                 SOCK_DGRAM,
-                                                 IPPROTO_UDP);
-  if (NULL != listen_socket6)
   {
     struct sockaddr_in6 v6;
 
@@ -735,18 +1138,11 @@ run (void *cls,
     v6.sin6_len = sizeof(v6);
 #endif
     v6.sin6_port = htons (listen_port);
-    if (GNUNET_OK !=
-        GNUNET_NETWORK_socket_bind (listen_socket6,
-                                    (struct sockaddr *) &v6,
-                                    sizeof(v6)))
-    {
-      GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR, "bind");
-      GNUNET_NETWORK_socket_close (listen_socket6);
-      listen_socket6 = NULL;
-    }
+    (void) open_listen_sockets (PF_INET6,
+                                (struct sockaddr *) &v6,
+                                sizeof(v6));
   }
-  if ((NULL == listen_socket4) &&
-      (NULL == listen_socket6))
+  if (NULL == ls_head)
   {
     GNUNET_GNS_disconnect (gns);
     gns = NULL;
@@ -754,16 +1150,6 @@ run (void *cls,
     dns_stub = NULL;
     return;
   }
-  if (NULL != listen_socket4)
-    t4 = GNUNET_SCHEDULER_add_read_net (GNUNET_TIME_UNIT_FOREVER_REL,
-                                        listen_socket4,
-                                        &read_dns4,
-                                        listen_socket4);
-  if (NULL != listen_socket6)
-    t6 = GNUNET_SCHEDULER_add_read_net (GNUNET_TIME_UNIT_FOREVER_REL,
-                                        listen_socket6,
-                                        &read_dns6,
-                                        listen_socket6);
 }
 
 
@@ -26,6 +26,8 @@
 #include <gnunet_util_lib.h>
 #include <gnunet_gnsrecord_lib.h>
 #include <gnunet_gns_service.h>
+#include <gnunet_dnsparser_lib.h>
+#include <gnunet_dnsstub_lib.h>
 
 
 /**
@@ -79,6 +81,11 @@ struct Request
    */
   struct GNUNET_GNS_LookupWithTldRequest *lr;
 
+  /**
+   * DNS request if we query a DNS server, NULL if not active.
+   */
+  struct GNUNET_DNSSTUB_RequestSocket *rs;
+
   /**
    * Hostname we are resolving, allocated at the end of
    * this struct (optimizing memory consumption by reducing
@@ -97,10 +104,33 @@ struct Request
    */
   struct GNUNET_TIME_Relative latency;
 
+  /**
+   * Time the GNS service spent in each phase of the lookup,
+   * set once we got a reply with a trace.
+   */
+  struct GNUNET_TIME_Relative phase_time[GNUNET_GNS_PHASE_MAX];
+
   /**
    * Category of the request.
    */
   enum RequestCategory cat;
+
+  /**
+   * In which round do we issue this request?  Rounds after the
+   * first repeat the queries of the first round.
+   */
+  unsigned int round;
+
+  /**
+   * ID of the DNS request.
+   */
+  uint16_t dns_id;
+
+  /**
+   * Bitmask of the phases (1 << `enum GNUNET_GNS_LookupPhase`)
+   * the GNS service went through for the lookup.
+   */
+  uint8_t phases;
 };
 
 
@@ -109,6 +139,22 @@ struct Request
  */
 static struct GNUNET_GNS_Handle *gns;
 
+/**
+ * Address of the DNS server (e.g. dns2gns) to query instead
+ * of GNS, NULL to query GNS.
+ */
+static char *dns_server;
+
+/**
+ * Stub resolver to query the #dns_server.
+ */
+static struct GNUNET_DNSSTUB_Context *dns_stub;
+
+/**
+ * When did we start the first round?
+ */
+static struct GNUNET_TIME_Absolute bench_start;
+
 /**
  * Number of lookups we performed overall per category.
  */
@@ -124,6 +170,17 @@ static unsigned int replies[RC_MAX];
  */
 static unsigned int failures[RC_MAX];
 
+/**
+ * Number of replies the GNS service took from its cache, per category.
+ */
+static unsigned int cache_hits[RC_MAX];
+
+/**
+ * Number of replies for which the GNS service waited for an identical
+ * lookup, per category.
+ */
+static unsigned int coalesced[RC_MAX];
+
 /**
  * Sum of the observed latencies of successful queries,
  * per category.
@@ -185,6 +242,38 @@ static unsigned int active_cnt;
  */
 static int g2d;
 
+/**
+ * How often should we repeat all of the queries?
+ */
+static unsigned int repeat;
+
+/**
+ * Round we are currently processing.
+ */
+static unsigned int current_round;
+
+/**
+ * When did the current round start?
+ */
+static struct GNUNET_TIME_Absolute round_start;
+
+/**
+ * Number of lookups we performed in the current round.
+ */
+static unsigned int round_lookups;
+
+/**
+ * Number of replies we got in the current round.
+ */
+static unsigned int round_replies;
+
+/**
+ * Sum of the observed latencies of successful queries in
+ * the current round.
+ */
+static struct GNUNET_TIME_Relative round_latency_sum;
+
+
 /**
  * Free @a req and data structures reachable from it.
  *
@@ -195,10 +284,21 @@ free_request (struct Request *req)
 {
   if (NULL != req->lr)
     GNUNET_GNS_lookup_with_tld_cancel (req->lr);
+  if (NULL != req->rs)
+    GNUNET_DNSSTUB_resolve_cancel (req->rs);
   GNUNET_free (req);
 }
 
 
+/**
+ * We got a reply for @a req, update the statistics.
+ *
+ * @param req request that was answered
+ */
+static void
+complete_request (struct Request *req);
+
+
 /**
  * Function called with the result of a GNS resolution.
  *
@@ -214,15 +314,124 @@ process_result (void *cls,
                 const struct GNUNET_GNSRECORD_Data *rd)
 {
   struct Request *req = cls;
+  const struct GNUNET_GNS_LookupTrace *trace;
 
   (void) gns_tld;
   (void) rd_count;
   (void) rd;
+  trace = GNUNET_GNS_lookup_with_tld_get_trace (req->lr);
+  if (NULL != trace)
+  {
+    for (unsigned int i = 0; i < GNUNET_GNS_PHASE_MAX; i++)
+    {
+      if (0 == trace->phase_count[i])
+        continue;
+      req->phases |= (1 << i);
+      req->phase_time[i] = trace->phase_time[i];
+    }
+    if (GNUNET_YES == trace->cache_hit)
+      cache_hits[req->cat]++;
+    if (GNUNET_YES == trace->coalesced)
+      coalesced[req->cat]++;
+  }
+  req->lr = NULL;
+  complete_request (req);
+}
+
+
+/**
+ * Function called with the answer from the DNS server.
+ *
+ * @param cls closure with the `struct Request`
+ * @param dns the DNS answer, NULL if the stub gave up
+ * @param dns_len number of bytes in @a dns
+ */
+static void
+process_dns_result (void *cls,
+                    const struct GNUNET_TUN_DnsHeader *dns,
+                    size_t dns_len)
+{
+  struct Request *req = cls;
+
+  (void) dns_len;
+  if (NULL == dns)
+  {
+    /* stub gave up, leave it to the timeout */
+    req->rs = NULL;
+    return;
+  }
+  if (req->dns_id != dns->id)
+    return; /* answer for another query */
+  GNUNET_DNSSTUB_resolve_cancel (req->rs);
+  req->rs = NULL;
+  complete_request (req);
+}
+
+
+/**
+ * Start the lookup for @a req by sending a DNS query to
+ * the #dns_server.
+ *
+ * @param req request to start
+ */
+static void
+start_dns_request (struct Request *req)
+{
+  struct GNUNET_DNSPARSER_Query q;
+  struct GNUNET_DNSPARSER_Packet p;
+  char *buf;
+  size_t buf_len;
+
+  memset (&q,
+          0,
+          sizeof(q));
+  q.name = (char *) req->hostname;
+  q.type = g2d
+           ? GNUNET_GNSRECORD_TYPE_GNS2DNS
+           : GNUNET_DNSPARSER_TYPE_A;
+  q.dns_traffic_class = GNUNET_TUN_DNS_CLASS_INTERNET;
+  memset (&p,
+          0,
+          sizeof(p));
+  p.num_queries = 1;
+  p.queries = &q;
+  p.id = (uint16_t) GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_NONCE,
+                                              UINT16_MAX);
+  p.flags.opcode = GNUNET_TUN_DNS_OPCODE_QUERY;
+  p.flags.recursion_desired = 1;
+  if (GNUNET_OK !=
+      GNUNET_DNSPARSER_pack (&p,
+                             UINT16_MAX,
+                             &buf,
+                             &buf_len))
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                "Failed to pack DNS request for `%s'\n",
+                req->hostname);
+    return; /* will time out */
+  }
+  req->dns_id = p.id;
+  req->rs = GNUNET_DNSSTUB_resolve (dns_stub,
+                                    buf,
+                                    buf_len,
+                                    &process_dns_result,
+                                    req);
+  GNUNET_free (buf);
+}
+
+
+/**
+ * We got a reply for @a req, update the statistics.
+ *
+ * @param req request that was answered
+ */
+static void
+complete_request (struct Request *req)
+{
   active_cnt--;
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Got response for request `%s'\n",
               req->hostname);
-  req->lr = NULL;
   req->latency = GNUNET_TIME_absolute_get_duration (req->op_start_time);
   GNUNET_CONTAINER_DLL_remove (act_head,
                                act_tail,
@@ -234,6 +443,46 @@ process_result (void *cls,
   latency_sum[req->cat]
     = GNUNET_TIME_relative_add (latency_sum[req->cat],
                                 req->latency);
+  round_replies++;
+  round_latency_sum
+    = GNUNET_TIME_relative_add (round_latency_sum,
+                                req->latency);
+}
+
+
+/**
+ * Output statistics about the current round and reset them.
+ */
+static void
+report_round (void)
+{
+  struct GNUNET_TIME_Relative duration;
+  unsigned long long rate;
+
+  duration = GNUNET_TIME_absolute_get_duration (round_start);
+  rate = (0 == duration.rel_value_us)
+         ? 0
+         : (unsigned long long) round_lookups * 1000LL * 1000LL
+           / duration.rel_value_us;
+  fprintf (stdout,
+           "Round %u: lookups: %u replies: %u in %s (%llu lookups/s)\n",
+           current_round,
+           round_lookups,
+           round_replies,
+           GNUNET_STRINGS_relative_time_to_string (duration,
+                                                   GNUNET_YES),
+           rate);
+  if (0 != round_replies)
+    fprintf (stdout,
+             "\taverage: %s\n",
+             GNUNET_STRINGS_relative_time_to_string (
+               GNUNET_TIME_relative_divide (round_latency_sum,
+                                            round_replies),
+               GNUNET_YES));
+  round_lookups = 0;
+  round_replies = 0;
+  round_latency_sum = GNUNET_TIME_UNIT_ZERO;
+  round_start = GNUNET_TIME_absolute_get ();
 }
 
 
@@ -272,6 +521,8 @@ process_queue (void *cls)
 
     if (NULL == (req = act_head))
     {
+      if (0 != repeat)
+        report_round ();
       GNUNET_SCHEDULER_shutdown ();
       return;
     }
@@ -282,6 +533,20 @@ process_queue (void *cls)
                                  NULL);
     return;
   }
+  if (req->round != current_round)
+  {
+    /* let the previous round finish first, so that each
+       round measures the state the previous one left behind */
+    if (NULL != act_head)
+    {
+      t = GNUNET_SCHEDULER_add_delayed (request_delay,
+                                        &process_queue,
+                                        NULL);
+      return;
+    }
+    report_round ();
+    current_round = req->round;
+  }
   GNUNET_CONTAINER_DLL_remove (todo_head,
                                todo_tail,
                                req);
@@ -289,20 +554,25 @@ process_queue (void *cls)
                                     act_tail,
                                     req);
   lookups[req->cat]++;
+  round_lookups++;
   active_cnt++;
   req->op_start_time = GNUNET_TIME_absolute_get ();
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Starting request `%s' (%u in parallel)\n",
               req->hostname,
               active_cnt);
-  req->lr = GNUNET_GNS_lookup_with_tld (gns,
-                                        req->hostname,
-                                        g2d
-                                        ? GNUNET_GNSRECORD_TYPE_GNS2DNS
-                                        : GNUNET_GNSRECORD_TYPE_ANY,
-                                        GNUNET_GNS_LO_DEFAULT,
-                                        &process_result,
-                                        req);
+  if (NULL != dns_stub)
+    start_dns_request (req);
+  else
+    req->lr = GNUNET_GNS_lookup_with_tld (gns,
+                                          req->hostname,
+                                          g2d
+                                          ? GNUNET_GNSRECORD_TYPE_GNS2DNS
+                                          : GNUNET_GNSRECORD_TYPE_ANY,
+                                          GNUNET_GNS_LO_DEFAULT
+                                          | GNUNET_GNS_LO_TRACE,
+                                          &process_result,
+                                          req);
   t = GNUNET_SCHEDULER_add_delayed (request_delay,
                                     &process_queue,
                                     NULL);
@@ -331,6 +601,83 @@ compare_req (const void *c1,
 }
 
 
+/**
+ * Compare two relative times for qsort().
+ *
+ * @param c1 pointer to `struct GNUNET_TIME_Relative`
+ * @param c2 pointer to `struct GNUNET_TIME_Relative`
+ * @return -1 if c1<c2, 1 if c1>c2, 0 if c1==c2.
+ */
+static int
+compare_rel (const void *c1,
+             const void *c2)
+{
+  const struct GNUNET_TIME_Relative *t1 = c1;
+  const struct GNUNET_TIME_Relative *t2 = c2;
+
+  if (t1->rel_value_us < t2->rel_value_us)
+    return -1;
+  if (t1->rel_value_us > t2->rel_value_us)
+    return 1;
+  return 0;
+}
+
+
+/**
+ * Output the distribution of the time the GNS service spent in
+ * @a phase for the requests in @a ra.
+ *
+ * @param ra array of answered requests
+ * @param ra_len length of @a ra
+ * @param phase phase to report on
+ */
+static void
+report_phase (struct Request *const *ra,
+              unsigned int ra_len,
+              enum GNUNET_GNS_LookupPhase phase)
+{
+  struct GNUNET_TIME_Relative *pt;
+  unsigned int cnt;
+  unsigned int off;
+
+  pt = GNUNET_new_array (GNUNET_NZL (ra_len),
+                         struct GNUNET_TIME_Relative);
+  cnt = 0;
+  for (unsigned int i = 0; i < ra_len; i++)
+    if (0 != (ra[i]->phases & (1 << phase)))
+      pt[cnt++] = ra[i]->phase_time[phase];
+  if (0 == cnt)
+  {
+    GNUNET_free (pt);
+    return;
+  }
+  qsort (pt,
+         cnt,
+         sizeof(struct GNUNET_TIME_Relative),
+         &compare_rel);
+  fprintf (stdout,
+           "\t%s: %u lookups\n",
+           GNUNET_GNS_phase_to_string (phase),
+           cnt);
+  off = cnt * 50 / 100;
+  fprintf (stdout,
+           "\t\tmedian(50): %s\n",
+           GNUNET_STRINGS_relative_time_to_string (pt[off],
+                                                   GNUNET_YES));
+  off = cnt * 90 / 100;
+  fprintf (stdout,
+           "\t\tquantile(90): %s\n",
+           GNUNET_STRINGS_relative_time_to_string (pt[off],
+                                                   GNUNET_YES));
+  off = cnt * 99 / 100;
+  fprintf (stdout,
+           "\t\tquantile(99): %s\n",
+           GNUNET_STRINGS_relative_time_to_string (pt[off],
+                                                   GNUNET_YES));
+  GNUNET_free (pt);
+}
+
+
 /**
  * Output statistics, then clean up and terminate the process.
  *
@@ -344,6 +691,24 @@ do_shutdown (void *cls)
   unsigned int rp[RC_MAX];
 
   (void) cls;
+  if (0 != bench_start.abs_value_us)
+  {
+    struct GNUNET_TIME_Relative duration;
+    unsigned int total = 0;
+
+    duration = GNUNET_TIME_absolute_get_duration (bench_start);
+    for (enum RequestCategory rc = 0; rc < RC_MAX; rc++)
+      total += replies[rc];
+    fprintf (stdout,
+             "Total: %u replies in %s (%llu replies/s)\n",
+             total,
+             GNUNET_STRINGS_relative_time_to_string (duration,
+                                                     GNUNET_YES),
+             (0 == duration.rel_value_us)
+             ? 0LLU
+             : (unsigned long long) total * 1000LL * 1000LL
+             / duration.rel_value_us);
+  }
   for (enum RequestCategory rc = 0; rc < RC_MAX; rc++)
   {
     ra[rc] = GNUNET_new_array (replies[rc],
@@ -367,6 +732,11 @@ do_shutdown (void *cls)
              lookups[rc],
              replies[rc],
              failures[rc]);
+    if (NULL != gns)
+      fprintf (stdout,
+               "\tcache hits: %u coalesced: %u\n",
+               cache_hits[rc],
+               coalesced[rc]);
     if (0 == rp[rc])
       continue;
     qsort (ra[rc],
@@ -399,6 +769,12 @@ do_shutdown (void *cls)
              "\tquantile(99): %s\n",
              GNUNET_STRINGS_relative_time_to_string (ra[rc][off]->latency,
                                                      GNUNET_YES));
+    for (enum GNUNET_GNS_LookupPhase phase = 0;
+         phase < GNUNET_GNS_PHASE_MAX;
+         phase++)
+      report_phase (ra[rc],
+                    rp[rc],
+                    phase);
     GNUNET_free (ra[rc]);
   }
   if (NULL != t)
@@ -432,6 +808,11 @@ do_shutdown (void *cls)
     GNUNET_GNS_disconnect (gns);
     gns = NULL;
   }
+  if (NULL != dns_stub)
+  {
+    GNUNET_DNSSTUB_stop (dns_stub);
+    dns_stub = NULL;
+  }
 }
 
 
@@ -525,6 +906,34 @@ process_stdin (void *cls)
   fprintf (stderr,
            "Done reading %llu domain names\n",
            (unsigned long long) idot);
+  if (0 != repeat)
+  {
+    struct Request *last_req = todo_tail;
+
+    for (unsigned int r = 1; r <= repeat; r++)
+    {
+      for (struct Request *pos = todo_head; NULL != pos; pos = pos->next)
+      {
+        struct Request *req;
+        size_t hlen = strlen (pos->hostname) + 1;
+
+        req = GNUNET_malloc (sizeof(struct Request) + hlen);
+        req->cat = pos->cat;
+        req->round = r;
+        req->hostname = (char *) &req[1];
+        GNUNET_memcpy (&req[1],
+                       pos->hostname,
+                       hlen);
+        GNUNET_CONTAINER_DLL_insert_tail (todo_head,
+                                          todo_tail,
+                                          req);
+        if (pos == last_req)
+          break;
+      }
+    }
+  }
+  round_start = GNUNET_TIME_absolute_get ();
+  bench_start = round_start;
   t = GNUNET_SCHEDULER_add_now (&process_queue,
                                 NULL);
 }
@@ -550,12 +959,45 @@ run (void *cls,
   (void) cfgfile;
   GNUNET_SCHEDULER_add_shutdown (&do_shutdown,
                                  NULL);
-  gns = GNUNET_GNS_connect (cfg);
-  if (NULL == gns)
+  if (NULL != dns_server)
   {
-    GNUNET_break (0);
-    GNUNET_SCHEDULER_shutdown ();
-    return;
+    struct sockaddr_storage ss;
+
+    dns_stub = GNUNET_DNSSTUB_start (256);
+    if (GNUNET_OK ==
+        GNUNET_STRINGS_to_address_ip (dns_server,
+                                      strlen (dns_server),
+                                      &ss))
+    {
+      if (GNUNET_OK !=
+          GNUNET_DNSSTUB_add_dns_sa (dns_stub,
+                                     (const struct sockaddr *) &ss))
+      {
+        GNUNET_break (0);
+        GNUNET_SCHEDULER_shutdown ();
+        return;
+      }
+    }
+    else if (GNUNET_OK !=
+             GNUNET_DNSSTUB_add_dns_ip (dns_stub,
+                                        dns_server))
+    {
+      fprintf (stderr,
+               "Invalid DNS server address `%s'\n",
+               dns_server);
+      GNUNET_SCHEDULER_shutdown ();
+      return;
+    }
+  }
+  else
+  {
+    gns = GNUNET_GNS_connect (cfg);
+    if (NULL == gns)
+    {
+      GNUNET_break (0);
+      GNUNET_SCHEDULER_shutdown ();
+      return;
+    }
   }
   t = GNUNET_SCHEDULER_add_now (&process_stdin,
                                 NULL);
@@ -592,6 +1034,18 @@ main (int argc,
                                gettext_noop (
                                  "look for GNS2DNS records instead of ANY"),
                                &g2d),
+    GNUNET_GETOPT_option_uint ('r',
+                               "repeat",
+                               "COUNT",
+                               gettext_noop (
+                                 "repeat all queries COUNT times, reporting each round"),
+                               &repeat),
+    GNUNET_GETOPT_option_string ('s',
+                                 "server",
+                                 "ADDRESS",
+                                 gettext_noop (
+                                   "send the queries to the DNS server at ADDRESS (i.e. dns2gns, IP or IP:PORT) instead of GNS"),
+                                 &dns_server),
     GNUNET_GETOPT_OPTION_END
   };
 
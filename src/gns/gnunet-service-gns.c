@@ -38,6 +38,14 @@
 #include "gnunet_protocols.h"
 
 
+/**
+ * Number of buckets in the latency histograms we keep in the
+ * statistics.  Bucket i counts latencies of up to 4^i ms, the
+ * last one all others.
+ */
+#define LATENCY_BUCKETS 8
+
+
 /**
  * GnsClient prototype
  */
@@ -72,6 +80,11 @@ struct ClientLookupHandle
    * request id
    */
   uint32_t request_id;
+
+  /**
+   * #GNUNET_YES if the client asked for a trace of the lookup.
+   */
+  int trace;
 };
 
 
@@ -167,6 +180,13 @@ static struct GNS_TopLevelDomain *tld_head;
  */
 static struct GNS_TopLevelDomain *tld_tail;
 
+/**
+ * Names of the statistics of the latency histograms, one row for
+ * each `enum GNUNET_GNS_LookupPhase` and the last for the total
+ * latency of lookups.
+ */
+static char *latency_stats[GNUNET_GNS_PHASE_MAX + 1][LATENCY_BUCKETS];
+
 
 /**
  * Find GNS zone belonging to TLD @a tld.
@@ -243,6 +263,12 @@ shutdown_task (void *cls)
                                GNUNET_NO);
     statistics = NULL;
   }
+  for (unsigned int i = 0; i <= GNUNET_GNS_PHASE_MAX; i++)
+    for (unsigned int j = 0; j < LATENCY_BUCKETS; j++)
+    {
+      GNUNET_free (latency_stats[i][j]);
+      latency_stats[i][j] = NULL;
+    }
   if (NULL != namecache_handle)
   {
     GNUNET_NAMECACHE_disconnect (namecache_handle);
@@ -322,6 +348,80 @@ client_connect_cb (void *cls,
 }
 
 
+/**
+ * Count @a latency in the histogram @a row of #latency_stats.
+ *
+ * @param row phase of the latency, #GNUNET_GNS_PHASE_MAX for
+ *        the total latency of a lookup
+ * @param latency the latency
+ */
+static void
+update_latency_histogram (unsigned int row,
+                          struct GNUNET_TIME_Relative latency)
+{
+  uint64_t limit = 1;
+  unsigned int bucket;
+
+  for (bucket = 0; bucket < LATENCY_BUCKETS - 1; bucket++)
+  {
+    if (latency.rel_value_us <= limit * 1000LLU)
+      break;
+    limit *= 4;
+  }
+  GNUNET_STATISTICS_update (statistics,
+                            latency_stats[row][bucket],
+                            1,
+                            GNUNET_NO);
+}
+
+
+/**
+ * Tell the client where the time of the lookup of @a clh was
+ * spent and update the latency histograms.
+ *
+ * @param clh the lookup that finished
+ */
+static void
+report_trace (struct ClientLookupHandle *clh)
+{
+  struct GNUNET_GNS_LookupTrace trace;
+  struct GNUNET_MQ_Envelope *env;
+  struct LookupTraceMessage *tmsg;
+  uint32_t flags;
+
+  GNS_resolver_lookup_get_trace (clh->lookup,
+                                 &trace);
+  update_latency_histogram (GNUNET_GNS_PHASE_MAX,
+                            trace.total);
+  /* lookups that waited for another one did not do the work,
+     only count the phases once */
+  if (GNUNET_YES != trace.coalesced)
+    for (unsigned int i = 0; i < GNUNET_GNS_PHASE_MAX; i++)
+      if (0 != trace.phase_count[i])
+        update_latency_histogram (i,
+                                  trace.phase_time[i]);
+  if (GNUNET_YES != clh->trace)
+    return;
+  flags = 0;
+  if (GNUNET_YES == trace.cache_hit)
+    flags |= GNS_TRACE_FLAG_CACHE_HIT;
+  if (GNUNET_YES == trace.coalesced)
+    flags |= GNS_TRACE_FLAG_COALESCED;
+  env = GNUNET_MQ_msg (tmsg,
+                       GNUNET_MESSAGE_TYPE_GNS_LOOKUP_TRACE);
+  tmsg->id = clh->request_id;
+  tmsg->flags = htonl (flags);
+  tmsg->total = GNUNET_TIME_relative_hton (trace.total);
+  for (unsigned int i = 0; i < GNUNET_GNS_PHASE_MAX; i++)
+  {
+    tmsg->phase_time[i] = GNUNET_TIME_relative_hton (trace.phase_time[i]);
+    tmsg->phase_count[i] = htonl (trace.phase_count[i]);
+  }
+  GNUNET_MQ_send (GNUNET_SERVICE_client_get_mq (clh->gc->client),
+                  env);
+}
+
+
 /**
  * Reply to client with the result from our lookup.
  *
@@ -357,6 +457,8 @@ send_lookup_response (void *cls,
     GNUNET_SERVICE_client_drop (gc->client);
     return;
   }
+  if (NULL != clh->lookup)
+    report_trace (clh);
   env = GNUNET_MQ_msg_extra (rmsg,
                              len,
                              GNUNET_MESSAGE_TYPE_GNS_LOOKUP_RESULT);
@@ -424,6 +526,7 @@ handle_lookup (void *cls,
   struct ClientLookupHandle *clh;
   char *nameptr = name;
   const char *utf_in;
+  enum GNUNET_GNS_LocalOptions options;
 
   GNUNET_SERVICE_client_continue (gc->client);
   utf_in = (const char *) &sh_msg[1];
@@ -438,6 +541,14 @@ handle_lookup (void *cls,
                                clh);
   clh->gc = gc;
   clh->request_id = sh_msg->id;
+  options = (enum GNUNET_GNS_LocalOptions) ntohs (sh_msg->options);
+  if (0 != (options & GNUNET_GNS_LO_TRACE))
+  {
+    /* the resolver always keeps a trace, and must not treat
+       traced lookups differently from others */
+    clh->trace = GNUNET_YES;
+    options &= ~GNUNET_GNS_LO_TRACE;
+  }
   if ((GNUNET_DNSPARSER_TYPE_A == ntohl (sh_msg->type)) &&
       (GNUNET_OK != v4_enabled))
   {
@@ -461,8 +572,7 @@ handle_lookup (void *cls,
   clh->lookup = GNS_resolver_lookup (&sh_msg->zone,
                                      ntohl (sh_msg->type),
                                      name,
-                                     (enum GNUNET_GNS_LocalOptions) ntohs (
-                                       sh_msg->options),
+                                     options,
                                      ntohs (sh_msg->recursion_depth_limit),
                                      &send_lookup_response, clh);
   GNUNET_STATISTICS_update (statistics,
@@ -580,6 +690,26 @@ run (void *cls,
   }
   statistics = GNUNET_STATISTICS_create ("gns",
                                          c);
+  for (unsigned int i = 0; i <= GNUNET_GNS_PHASE_MAX; i++)
+  {
+    const char *what = (GNUNET_GNS_PHASE_MAX == i)
+                       ? "Lookup"
+                       : GNUNET_GNS_phase_to_string (i);
+    unsigned long long limit = 1;
+
+    for (unsigned int j = 0; j < LATENCY_BUCKETS - 1; j++)
+    {
+      GNUNET_asprintf (&latency_stats[i][j],
+                       "%s latency <= %llu ms",
+                       what,
+                       limit);
+      limit *= 4;
+    }
+    GNUNET_asprintf (&latency_stats[i][LATENCY_BUCKETS - 1],
+                     "%s latency > %llu ms",
+                     what,
+                     limit / 4);
+  }
   GNUNET_SCHEDULER_add_shutdown (&shutdown_task,
                                  NULL);
 }
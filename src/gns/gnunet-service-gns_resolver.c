@@ -43,6 +43,7 @@
 #include "gnunet_dht_service.h"
 #include "gnunet_gnsrecord_lib.h"
 #include "gnunet_namecache_service.h"
+#include "gnunet_namestore_service.h"
 #include "gnunet_dns_service.h"
 #include "gnunet_resolver_service.h"
 #include "gnunet_revocation_service.h"
@@ -77,6 +78,43 @@
  */
 #define DHT_GNS_REPLICATION_LEVEL 10
 
+/**
+ * Default number of resolution results we cache.
+ */
+#define DEFAULT_RESULT_CACHE_SIZE 4096
+
+/**
+ * How long do we cache failed lookups by default?
+ */
+#define DEFAULT_NEGATIVE_CACHE_TTL GNUNET_TIME_relative_multiply ( \
+    GNUNET_TIME_UNIT_SECONDS, 30)
+
+/**
+ * How long do we trust a revocation check by default?
+ */
+#define DEFAULT_REVOCATION_CACHE_TTL GNUNET_TIME_relative_multiply ( \
+    GNUNET_TIME_UNIT_MINUTES, 5)
+
+/**
+ * How long do we keep any cached result by default?  Changes in
+ * remote zones become visible after at most this time.
+ */
+#define DEFAULT_RESULT_CACHE_TTL GNUNET_TIME_UNIT_MINUTES
+
+/**
+ * For how long after a change in one of our zones do we not cache
+ * results from it?  The namestore tells monitors about a change
+ * before the new block is in the namecache.
+ */
+#define ZONE_CHANGE_GRACE GNUNET_TIME_relative_multiply ( \
+    GNUNET_TIME_UNIT_SECONDS, 5)
+
+/**
+ * How many changes may the namestore tell us about before it has
+ * to wait for us?
+ */
+#define NAMESTORE_QUEUE_LIMIT 50
+
 
 /**
  * DLL to hold the authority chain we had to pass in the resolution
@@ -286,6 +324,20 @@ struct VpnContext
 };
 
 
+/**
+ * A namecache or DHT lookup for a block that is shared by all
+ * resolutions that are waiting for the same block.
+ */
+struct PendingQuery;
+
+
+/**
+ * A DNS query that is shared by all resolutions that ask the
+ * same DNS servers for the same name and type.
+ */
+struct PendingDnsQuery;
+
+
 /**
  * Handle to a currently pending resolution.  On result (positive or
  * negative) the #GNS_ResultProcessor is called.
@@ -318,40 +370,91 @@ struct GNS_ResolverHandle
   void *proc_cls;
 
   /**
-   * Handle for DHT lookups. should be NULL if no lookups are in progress
+   * Function to pass the result to after caching it, if
+   * @e proc is #cache_lookup_result.
    */
-  struct GNUNET_DHT_GetHandle *get_handle;
+  GNS_ResultProcessor client_proc;
 
   /**
-   * Handle to a VPN request, NULL if none is active.
+   * closure passed to @e client_proc
    */
-  struct VpnContext *vpn_ctx;
+  void *client_proc_cls;
 
   /**
-   * Socket for a DNS request, NULL if none is active.
+   * Key under which we cache the result of the lookup.
    */
-  struct GNUNET_DNSSTUB_RequestSocket *dns_request;
+  struct GNUNET_HashCode result_key;
 
   /**
-   * Handle for standard DNS resolution, NULL if none is active.
+   * Resolution performing the same lookup that we are waiting
+   * for, NULL if we perform the lookup ourselves.
    */
-  struct GNUNET_RESOLVER_RequestHandle *std_resolve;
+  struct GNS_ResolverHandle *leader;
 
   /**
-   * Pending Namecache lookup task
+   * Resolutions waiting for the result of this one.
    */
-  struct GNUNET_NAMECACHE_QueueEntry *namecache_qe;
+  struct GNS_ResolverHandle *follower_head;
 
   /**
-   * Pending revocation check.
+   * Resolutions waiting for the result of this one.
    */
-  struct GNUNET_REVOCATION_Query *rev_check;
+  struct GNS_ResolverHandle *follower_tail;
 
   /**
-   * Heap node associated with this lookup.  Used to limit number of
-   * concurrent requests.
+   * Kept in a MDLL of the followers of @e leader.
    */
-  struct GNUNET_CONTAINER_HeapNode *dht_heap_node;
+  struct GNS_ResolverHandle *next_follower;
+
+  /**
+   * Kept in a MDLL of the followers of @e leader.
+   */
+  struct GNS_ResolverHandle *prev_follower;
+
+  /**
+   * Namecache or DHT lookup we are waiting for, NULL for none.
+   */
+  struct PendingQuery *pq;
+
+  /**
+   * Kept in a MDLL of the resolutions waiting for @e pq.
+   */
+  struct GNS_ResolverHandle *next_pq;
+
+  /**
+   * Kept in a MDLL of the resolutions waiting for @e pq.
+   */
+  struct GNS_ResolverHandle *prev_pq;
+
+  /**
+   * DNS query we are waiting for, NULL for none.
+   */
+  struct PendingDnsQuery *dq;
+
+  /**
+   * Kept in a MDLL of the resolutions waiting for @e dq.
+   */
+  struct GNS_ResolverHandle *next_dq;
+
+  /**
+   * Kept in a MDLL of the resolutions waiting for @e dq.
+   */
+  struct GNS_ResolverHandle *prev_dq;
+
+  /**
+   * Handle to a VPN request, NULL if none is active.
+   */
+  struct VpnContext *vpn_ctx;
+
+  /**
+   * Handle for standard DNS resolution, NULL if none is active.
+   */
+  struct GNUNET_RESOLVER_RequestHandle *std_resolve;
+
+  /**
+   * Pending revocation check.
+   */
+  struct GNUNET_REVOCATION_Query *rev_check;
 
   /**
    * DLL to store the authority chain
@@ -428,6 +531,108 @@ struct GNS_ResolverHandle
    */
   unsigned int loop_threshold;
 
+  /**
+   * When did the lookup start?
+   */
+  struct GNUNET_TIME_Absolute start_time;
+
+  /**
+   * When did we enter the phases we are currently in?  Zero
+   * for the phases we are not in.
+   */
+  struct GNUNET_TIME_Absolute phase_start[GNUNET_GNS_PHASE_MAX];
+
+  /**
+   * Time spent in the phases we already left.
+   */
+  struct GNUNET_GNS_LookupTrace trace;
+
+  /**
+   * #GNUNET_YES if the lookup failed (for example timed out) instead
+   * of finding that there are no records; the result is then not
+   * cached.
+   */
+  int failed;
+};
+
+
+/**
+ * A namecache or DHT lookup for a block that is shared by all
+ * resolutions that are waiting for the same block.
+ */
+struct PendingQuery
+{
+  /**
+   * Query hash of the block, key in #namecache_queries or
+   * #dht_queries.
+   */
+  struct GNUNET_HashCode query;
+
+  /**
+   * Resolutions waiting for the block.
+   */
+  struct GNS_ResolverHandle *rh_head;
+
+  /**
+   * Resolutions waiting for the block.
+   */
+  struct GNS_ResolverHandle *rh_tail;
+
+  /**
+   * Pending namecache lookup, NULL if this is a DHT lookup.
+   */
+  struct GNUNET_NAMECACHE_QueueEntry *namecache_qe;
+
+  /**
+   * Handle for the DHT lookup, NULL if this is a namecache lookup.
+   */
+  struct GNUNET_DHT_GetHandle *get_handle;
+
+  /**
+   * Heap node associated with the DHT lookup.  Used to limit
+   * number of concurrent requests.
+   */
+  struct GNUNET_CONTAINER_HeapNode *dht_heap_node;
+};
+
+
+/**
+ * A DNS query that is shared by all resolutions that ask the
+ * same DNS servers for the same name and type.
+ */
+struct PendingDnsQuery
+{
+  /**
+   * Key in #dns_queries.
+   */
+  struct GNUNET_HashCode key;
+
+  /**
+   * Resolutions waiting for the DNS answer.
+   */
+  struct GNS_ResolverHandle *rh_head;
+
+  /**
+   * Resolutions waiting for the DNS answer.
+   */
+  struct GNS_ResolverHandle *rh_tail;
+
+  /**
+   * Socket for the DNS request, NULL once we got the answer.
+   */
+  struct GNUNET_DNSSTUB_RequestSocket *dns_request;
+
+  /**
+   * Authority whose DNS stub we use for the request.  NULL if
+   * its resolution went away and we took over its @e dns_handle.
+   */
+  struct AuthorityChain *ac;
+
+  /**
+   * DNS stub we took over from @e ac, or NULL.
+   */
+  struct GNUNET_DNSSTUB_Context *dns_handle;
+
   /**
    * 16 bit random ID we used in the @e dns_request.
    */
@@ -435,6 +640,80 @@ struct GNS_ResolverHandle
 };
 
 
+/**
+ * Records we resolved recently.  Either the decrypted records of a
+ * label in a zone (keyed by the query hash of the label, so that
+ * delegations can be followed without going to the namecache or the
+ * DHT), or the final result of a lookup (keyed by zone, name, type
+ * and options).  Final results with no records are negative entries.
+ */
+struct CacheEntry
+{
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct CacheEntry *next;
+
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct CacheEntry *prev;
+
+  /**
+   * Key of the entry in #result_cache.
+   */
+  struct GNUNET_HashCode key;
+
+  /**
+   * When does the entry expire?
+   */
+  struct GNUNET_TIME_Absolute expiration;
+
+  /**
+   * Zones the result depends upon, allocated at the end of this
+   * struct; the entry is dropped if any of them is revoked.
+   */
+  const struct GNUNET_IDENTITY_PublicKey *zones;
+
+  /**
+   * Length of the @e zones array.
+   */
+  unsigned int zone_count;
+
+  /**
+   * Number of records in @e rd_ser, 0 for negative entries.
+   */
+  unsigned int rd_count;
+
+  /**
+   * Number of bytes in @e rd_ser.
+   */
+  size_t rd_len;
+
+  /**
+   * Serialized records, allocated at the end of this struct.
+   */
+  const char *rd_ser;
+};
+
+
+/**
+ * What we know about the revocation status of a zone.
+ */
+struct RevocationCacheEntry
+{
+  /**
+   * Until when may we assume that the zone is not revoked?
+   */
+  struct GNUNET_TIME_Absolute expiration;
+
+  /**
+   * #GNUNET_YES if the zone was revoked (forever).
+   */
+  int revoked;
+};
+
+
 /**
  * Active namestore caching operations.
  */
@@ -507,12 +786,557 @@ static struct CacheOps *co_tail;
  */
 static int disable_cache;
 
+/**
+ * Map from query hashes to the `struct PendingQuery` of namecache
+ * lookups in progress.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *namecache_queries;
+
+/**
+ * Map from query hashes to the `struct PendingQuery` of DHT lookups
+ * in progress.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *dht_queries;
+
+/**
+ * Map of the `struct PendingDnsQuery`s in progress.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *dns_queries;
+
+/**
+ * Map from lookup keys to the `struct GNS_ResolverHandle` performing
+ * the lookup on behalf of all clients asking for it.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *active_lookups;
+
+/**
+ * Map from query hashes to the `struct CacheEntry` with the result.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *result_cache;
+
+/**
+ * Map from hashes of zones to the `struct CacheEntry`s that
+ * depend on the zone.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *zone_deps;
+
+/**
+ * Map from hashes of zones to `struct RevocationCacheEntry`s.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *revocation_cache;
+
+/**
+ * Map from hashes of our own zones to the `struct
+ * GNUNET_TIME_Absolute` of their last change, for changes within
+ * the last #ZONE_CHANGE_GRACE.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *zone_changes;
+
+/**
+ * Monitor for changes in our own zones, NULL if we do not cache.
+ */
+static struct GNUNET_NAMESTORE_ZoneMonitor *zmon;
+
+/**
+ * Most recently used cache entry.
+ */
+static struct CacheEntry *ce_head;
+
+/**
+ * Least recently used cache entry.
+ */
+static struct CacheEntry *ce_tail;
+
+/**
+ * Maximum number of entries in #result_cache, 0 to disable caching
+ * of resolution results.
+ */
+static unsigned long long result_cache_size;
+
+/**
+ * How long do we cache failed lookups?
+ */
+static struct GNUNET_TIME_Relative negative_cache_ttl;
+
+/**
+ * How long do we trust a revocation check?
+ */
+static struct GNUNET_TIME_Relative revocation_cache_ttl;
+
+/**
+ * How long do we keep cached results at most?
+ */
+static struct GNUNET_TIME_Relative result_cache_ttl;
+
 /**
  * Global configuration.
  */
 static const struct GNUNET_CONFIGURATION_Handle *cfg;
 
 
+/**
+ * Compute the key of @a zone in #zone_deps and #revocation_cache.
+ *
+ * @param zone a zone
+ * @param key[out] set to the key
+ */
+static void
+get_zone_key (const struct GNUNET_IDENTITY_PublicKey *zone,
+              struct GNUNET_HashCode *key)
+{
+  GNUNET_CRYPTO_hash (zone,
+                      GNUNET_IDENTITY_key_get_length (zone),
+                      key);
+}
+
+
+/**
+ * Remove @a ce from the cache and free it.
+ *
+ * @param ce entry to free
+ */
+static void
+free_cache_entry (struct CacheEntry *ce)
+{
+  struct GNUNET_HashCode zkey;
+
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (result_cache,
+                                                       &ce->key,
+                                                       ce));
+  for (unsigned int i = 0; i < ce->zone_count; i++)
+  {
+    get_zone_key (&ce->zones[i],
+                  &zkey);
+    GNUNET_CONTAINER_multihashmap_remove (zone_deps,
+                                          &zkey,
+                                          ce);
+  }
+  GNUNET_CONTAINER_DLL_remove (ce_head,
+                               ce_tail,
+                               ce);
+  GNUNET_free (ce);
+}
+
+
+/**
+ * Drop all cached results that depend on @a zone.
+ *
+ * @param zone a zone that was revoked
+ */
+static void
+invalidate_zone (const struct GNUNET_IDENTITY_PublicKey *zone)
+{
+  struct GNUNET_HashCode zkey;
+  struct CacheEntry *ce;
+
+  if (NULL == zone_deps)
+    return;
+  get_zone_key (zone,
+                &zkey);
+  while (NULL != (ce = GNUNET_CONTAINER_multihashmap_get (zone_deps,
+                                                          &zkey)))
+    free_cache_entry (ce);
+}
+
+
+/**
+ * Check if @a zone is one of ours and changed so recently that the
+ * namecache may still have its old records.
+ *
+ * @param zone a zone
+ * @return #GNUNET_YES if results from @a zone must not be cached
+ */
+static int
+zone_recently_changed (const struct GNUNET_IDENTITY_PublicKey *zone)
+{
+  struct GNUNET_HashCode zkey;
+  struct GNUNET_TIME_Absolute *changed;
+
+  get_zone_key (zone,
+                &zkey);
+  changed = GNUNET_CONTAINER_multihashmap_get (zone_changes,
+                                               &zkey);
+  if (NULL == changed)
+    return GNUNET_NO;
+  if (GNUNET_TIME_absolute_get_duration (*changed).rel_value_us <
+      ZONE_CHANGE_GRACE.rel_value_us)
+    return GNUNET_YES;
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (zone_changes,
+                                                       &zkey,
+                                                       changed));
+  GNUNET_free (changed);
+  return GNUNET_NO;
+}
+
+
+/**
+ * Compute when the first of the records in @a rd expires.
+ *
+ * @param rd_count number of records in @a rd
+ * @param rd records
+ * @return earliest expiration time in @a rd
+ */
+static struct GNUNET_TIME_Absolute
+get_min_expiration (unsigned int rd_count,
+                    const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct GNUNET_TIME_Absolute expire;
+  struct GNUNET_TIME_Absolute at;
+
+  expire = GNUNET_TIME_UNIT_FOREVER_ABS;
+  for (unsigned int i = 0; i < rd_count; i++)
+  {
+    if (0 != (rd[i].flags & GNUNET_GNSRECORD_RF_RELATIVE_EXPIRATION))
+    {
+      struct GNUNET_TIME_Relative rt;
+
+      rt.rel_value_us = rd[i].expiration_time;
+      at = GNUNET_TIME_relative_to_absolute (rt);
+    }
+    else
+    {
+      at.abs_value_us = rd[i].expiration_time;
+    }
+    expire = GNUNET_TIME_absolute_min (expire,
+                                       at);
+  }
+  return expire;
+}
+
+
+/**
+ * Add records to the cache, replacing an existing entry
+ * under @a key.
+ *
+ * @param key key to cache the records under
+ * @param zone_count number of entries in @a zones
+ * @param zones zones the records depend upon
+ * @param expiration when does the entry expire
+ * @param rd_count number of records in @a rd, 0 for a negative entry
+ * @param rd the records
+ */
+static void
+cache_records (const struct GNUNET_HashCode *key,
+               unsigned int zone_count,
+               const struct GNUNET_IDENTITY_PublicKey *zones,
+               struct GNUNET_TIME_Absolute expiration,
+               unsigned int rd_count,
+               const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct CacheEntry *ce;
+  struct GNUNET_HashCode zkey;
+  ssize_t rd_len;
+
+  if (0 == result_cache_size)
+    return;
+  expiration = GNUNET_TIME_absolute_min (
+    expiration,
+    GNUNET_TIME_relative_to_absolute (result_cache_ttl));
+  if (0 == GNUNET_TIME_absolute_get_remaining (expiration).rel_value_us)
+    return;
+  for (unsigned int i = 0; i < zone_count; i++)
+    if (GNUNET_YES == zone_recently_changed (&zones[i]))
+      return;
+  rd_len = GNUNET_GNSRECORD_records_get_size (rd_count,
+                                              rd);
+  if (rd_len < 0)
+  {
+    GNUNET_break (0);
+    return;
+  }
+  ce = GNUNET_CONTAINER_multihashmap_get (result_cache,
+                                          key);
+  if (NULL != ce)
+    free_cache_entry (ce);
+  while (GNUNET_CONTAINER_multihashmap_size (result_cache) >=
+         result_cache_size)
+    free_cache_entry (ce_tail);
+  ce = GNUNET_malloc (sizeof(struct CacheEntry)
+                      + zone_count * sizeof(struct GNUNET_IDENTITY_PublicKey)
+                      + rd_len);
+  ce->key = *key;
+  ce->expiration = expiration;
+  ce->zone_count = zone_count;
+  ce->zones = (const struct GNUNET_IDENTITY_PublicKey *) &ce[1];
+  GNUNET_memcpy (&ce[1],
+                 zones,
+                 zone_count * sizeof(struct GNUNET_IDENTITY_PublicKey));
+  ce->rd_count = rd_count;
+  ce->rd_len = rd_len;
+  ce->rd_ser = (const char *) &ce->zones[zone_count];
+  GNUNET_assert (rd_len ==
+                 GNUNET_GNSRECORD_records_serialize (rd_count,
+                                                     rd,
+                                                     rd_len,
+                                                     (char *) ce->rd_ser));
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_multihashmap_put (result_cache,
+                                                    &ce->key,
+                                                    ce,
+                                                    GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  for (unsigned int i = 0; i < zone_count; i++)
+  {
+    get_zone_key (&zones[i],
+                  &zkey);
+    GNUNET_CONTAINER_multihashmap_put (zone_deps,
+                                       &zkey,
+                                       ce,
+                                       GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE);
+  }
+  GNUNET_CONTAINER_DLL_insert (ce_head,
+                               ce_tail,
+                               ce);
+}
+
+
+/**
+ * Find a cached result that did not expire yet.
+ *
+ * @param key key to look up
+ * @return NULL if we have no (valid) entry under @a key
+ */
+static struct CacheEntry *
+lookup_cache (const struct GNUNET_HashCode *key)
+{
+  struct CacheEntry *ce;
+
+  if (0 == result_cache_size)
+    return NULL;
+  ce = GNUNET_CONTAINER_multihashmap_get (result_cache,
+                                          key);
+  if (NULL == ce)
+    return NULL;
+  if (0 == GNUNET_TIME_absolute_get_remaining (ce->expiration).rel_value_us)
+  {
+    free_cache_entry (ce);
+    return NULL;
+  }
+  /* move to the front of the LRU list */
+  GNUNET_CONTAINER_DLL_remove (ce_head,
+                               ce_tail,
+                               ce);
+  GNUNET_CONTAINER_DLL_insert (ce_head,
+                               ce_tail,
+                               ce);
+  return ce;
+}
+
+
+/**
+ * Remember the result of a revocation check for @a zone.
+ *
+ * @param zone the zone that was checked
+ * @param revoked #GNUNET_YES if @a zone was revoked
+ */
+static void
+cache_revocation_status (const struct GNUNET_IDENTITY_PublicKey *zone,
+                         int revoked)
+{
+  struct RevocationCacheEntry *rce;
+  struct GNUNET_HashCode zkey;
+
+  if (0 == result_cache_size)
+    return;
+  get_zone_key (zone,
+                &zkey);
+  rce = GNUNET_CONTAINER_multihashmap_get (revocation_cache,
+                                           &zkey);
+  if (NULL == rce)
+  {
+    if ((GNUNET_YES != revoked) &&
+        (GNUNET_CONTAINER_multihashmap_size (revocation_cache) >=
+         result_cache_size))
+      return; /* full; revocations always get in, though */
+    rce = GNUNET_new (struct RevocationCacheEntry);
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multihashmap_put (revocation_cache,
+                                                      &zkey,
+                                                      rce,
+                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  }
+  rce->revoked = revoked;
+  rce->expiration = GNUNET_TIME_relative_to_absolute (revocation_cache_ttl);
+}
+
+
+/**
+ * Resolution @a rh enters @a phase.
+ *
+ * @param rh the resolution
+ * @param phase the phase it enters
+ */
+static void
+phase_begin (struct GNS_ResolverHandle *rh,
+             enum GNUNET_GNS_LookupPhase phase)
+{
+  if (0 != rh->phase_start[phase].abs_value_us)
+    return; /* already in it */
+  rh->phase_start[phase] = GNUNET_TIME_absolute_get ();
+  rh->trace.phase_count[phase]++;
+}
+
+
+/**
+ * Resolution @a rh leaves @a phase.
+ *
+ * @param rh the resolution
+ * @param phase the phase it leaves
+ */
+static void
+phase_end (struct GNS_ResolverHandle *rh,
+           enum GNUNET_GNS_LookupPhase phase)
+{
+  if (0 == rh->phase_start[phase].abs_value_us)
+    return;
+  rh->trace.phase_time[phase]
+    = GNUNET_TIME_relative_add (rh->trace.phase_time[phase],
+                                GNUNET_TIME_absolute_get_duration (
+                                  rh->phase_start[phase]));
+  rh->phase_start[phase] = GNUNET_TIME_UNIT_ZERO_ABS;
+}
+
+
+/**
+ * Get where @a rh spent its time so far, counting the phases it
+ * is still in up to now.
+ *
+ * @param rh the resolution
+ * @param[out] trace set to the trace of @a rh
+ */
+static void
+get_trace (const struct GNS_ResolverHandle *rh,
+           struct GNUNET_GNS_LookupTrace *trace)
+{
+  *trace = rh->trace;
+  for (unsigned int i = 0; i < GNUNET_GNS_PHASE_MAX; i++)
+    if (0 != rh->phase_start[i].abs_value_us)
+      trace->phase_time[i]
+        = GNUNET_TIME_relative_add (trace->phase_time[i],
+                                    GNUNET_TIME_absolute_get_duration (
+                                      rh->phase_start[i]));
+  trace->total = GNUNET_TIME_absolute_get_duration (rh->start_time);
+}
+
+
+/**
+ * Cleanup a handle.  Declared here as #deliver_lookup_result()
+ * schedules it for the resolutions waiting on a lookup.
+ *
+ * @param cls the `struct GNS_ResolverHandle`
+ */
+static void
+GNS_resolver_lookup_cancel_ (void *cls);
+
+
+/**
+ * Pass the result of a lookup to the client and to all resolutions
+ * that were waiting for the same lookup.
+ *
+ * @param rh the lookup that finished
+ * @param rd_count number of records in @a rd
+ * @param rd records returned for the lookup
+ */
+static void
+deliver_lookup_result (struct GNS_ResolverHandle *rh,
+                       uint32_t rd_count,
+                       const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct GNS_ResolverHandle *f;
+  struct GNUNET_GNS_LookupTrace trace;
+
+  GNUNET_CONTAINER_multihashmap_remove (active_lookups,
+                                        &rh->result_key,
+                                        rh);
+  if (NULL != rh->client_proc)
+    rh->client_proc (rh->client_proc_cls,
+                     rd_count,
+                     rd);
+  get_trace (rh,
+             &trace);
+  while (NULL != (f = rh->follower_head))
+  {
+    GNUNET_CONTAINER_MDLL_remove (follower,
+                                  rh->follower_head,
+                                  rh->follower_tail,
+                                  f);
+    f->leader = NULL;
+    f->trace = trace;
+    f->trace.coalesced = GNUNET_YES;
+    f->proc (f->proc_cls,
+             rd_count,
+             rd);
+    GNUNET_assert (NULL == f->task_id);
+    f->task_id = GNUNET_SCHEDULER_add_now (&GNS_resolver_lookup_cancel_,
+                                           f);
+  }
+}
+
+
+/**
+ * Function called with the result of a lookup made on behalf of
+ * clients.  Caches the result, then passes it on to the clients.
+ *
+ * @param cls the `struct GNS_ResolverHandle`
+ * @param rd_count number of records in @a rd
+ * @param rd records returned for the lookup
+ */
+static void
+cache_lookup_result (void *cls,
+                     uint32_t rd_count,
+                     const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct GNS_ResolverHandle *rh = cls;
+  struct GNUNET_TIME_Absolute expiration;
+  unsigned int zone_count;
+
+  if (GNUNET_YES == rh->failed)
+  {
+    /* may work next time, do not cache */
+    deliver_lookup_result (rh,
+                           rd_count,
+                           rd);
+    return;
+  }
+  zone_count = 0;
+  for (struct AuthorityChain *ac = rh->ac_head; NULL != ac; ac = ac->next)
+    if (GNUNET_YES == ac->gns_authority)
+      zone_count++;
+  {
+    struct GNUNET_IDENTITY_PublicKey zones[GNUNET_NZL (zone_count)];
+    unsigned int off;
+
+    off = 0;
+    for (struct AuthorityChain *ac = rh->ac_head; NULL != ac; ac = ac->next)
+      if (GNUNET_YES == ac->gns_authority)
+        zones[off++] = ac->authority_info.gns_authority;
+    if (0 == rd_count)
+    {
+      expiration = GNUNET_TIME_relative_to_absolute (negative_cache_ttl);
+    }
+    else
+    {
+      /* we do not check the zones for revocation on a cache hit,
+         so do not keep the result for longer than a revocation check */
+      expiration = GNUNET_TIME_absolute_min (
+        get_min_expiration (rd_count,
+                            rd),
+        GNUNET_TIME_relative_to_absolute (revocation_cache_ttl));
+    }
+    cache_records (&rh->result_key,
+                   zone_count,
+                   zones,
+                   expiration,
+                   rd_count,
+                   rd);
+  }
+  deliver_lookup_result (rh,
+                         rd_count,
+                         rd);
+}
+
+
 /**
  * Determine if this name is canonical (is a legal name in a zone, without delegation);
  * note that we do not test that the name does not contain illegal characters, we only
@@ -605,6 +1429,7 @@ GNS_resolver_lookup_cancel_ (void *cls)
 static void
 fail_resolution (struct GNS_ResolverHandle *rh)
 {
+  rh->failed = GNUNET_YES;
   rh->proc (rh->proc_cls,
             0,
             NULL);
@@ -846,6 +1671,8 @@ handle_dns_result (void *cls,
   if (NULL == addr)
   {
     rh->std_resolve = NULL;
+    phase_end (rh,
+               GNUNET_GNS_PHASE_DNS);
     transmit_lookup_dns_result (rh);
     return;
   }
@@ -900,44 +1727,92 @@ start_resolver_lookup (void *cls);
 
 
 /**
- * Function called with the result of a DNS resolution.
+ * Task to stop a DNS stub that a #PendingDnsQuery took over.
+ * Run as a task as we must not stop the stub from within its
+ * own callback.
  *
- * @param cls the request handle of the resolution that
- *        we were attempting to make
- * @param dns dns response, never NULL
- * @param dns_len number of bytes in @a dns
+ * @param cls the `struct GNUNET_DNSSTUB_Context` to stop
  */
 static void
-dns_result_parser (void *cls,
-                   const struct GNUNET_TUN_DnsHeader *dns,
-                   size_t dns_len)
+stop_dns_stub (void *cls)
 {
-  struct GNS_ResolverHandle *rh = cls;
-  struct GNUNET_DNSPARSER_Packet *p;
-  const struct GNUNET_DNSPARSER_Record *rec;
-  unsigned int rd_count;
+  struct GNUNET_DNSSTUB_Context *dns_handle = cls;
 
-  if (NULL == dns)
-  {
-    rh->dns_request = NULL;
-    GNUNET_SCHEDULER_cancel (rh->task_id);
-    rh->task_id = NULL;
-    fail_resolution (rh);
-    return;
-  }
-  if (rh->original_dns_id != dns->id)
+  GNUNET_DNSSTUB_stop (dns_handle);
+}
+
+
+/**
+ * Resolution @a rh no longer waits for its DNS query.  If it was
+ * the last one to wait, the query is cancelled.  If @a rh provided
+ * the DNS stub for the query, the query takes over the stub.
+ *
+ * @param rh resolution to remove from its #PendingDnsQuery
+ */
+static void
+leave_dns_query (struct GNS_ResolverHandle *rh)
+{
+  struct PendingDnsQuery *dq = rh->dq;
+
+  GNUNET_CONTAINER_MDLL_remove (dq,
+                                dq->rh_head,
+                                dq->rh_tail,
+                                rh);
+  rh->dq = NULL;
+  if (NULL == dq->dns_request)
+    return; /* answer is being processed, caller cleans up */
+  if (NULL == dq->rh_head)
   {
-    /* DNS answer, but for another query */
+    GNUNET_DNSSTUB_resolve_cancel (dq->dns_request);
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (dns_queries,
+                                                         &dq->key,
+                                                         dq));
+    if (NULL != dq->dns_handle)
+      GNUNET_DNSSTUB_stop (dq->dns_handle);
+    GNUNET_free (dq);
     return;
   }
-  p = GNUNET_DNSPARSER_parse ((const char *) dns,
-                              dns_len);
-  if (NULL == p)
+  if ((NULL != dq->ac) &&
+      (rh == dq->ac->rh))
   {
-    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
-                _ ("Failed to parse DNS response\n"));
-    return;
+    /* others still wait for the answer; keep the stub alive */
+    dq->dns_handle = dq->ac->authority_info.dns_authority.dns_handle;
+    dq->ac->authority_info.dns_authority.dns_handle = NULL;
+    dq->ac = NULL;
   }
+}
+
+
+/**
+ * Done with @a dq, which is no longer in #dns_queries and has
+ * no DNS request pending.
+ *
+ * @param dq query to free
+ */
+static void
+free_dns_query (struct PendingDnsQuery *dq)
+{
+  if (NULL != dq->dns_handle)
+    (void) GNUNET_SCHEDULER_add_now (&stop_dns_stub,
+                                     dq->dns_handle);
+  GNUNET_free (dq);
+}
+
+
+/**
+ * Process a DNS response for one of the resolutions waiting
+ * for it.
+ *
+ * @param rh resolution to process the response for
+ * @param p the parsed DNS response
+ */
+static void
+process_dns_response (struct GNS_ResolverHandle *rh,
+                      const struct GNUNET_DNSPARSER_Packet *p)
+{
+  const struct GNUNET_DNSPARSER_Record *rec;
+  unsigned int rd_count;
 
   /* We got a result from DNS */
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
@@ -984,14 +1859,13 @@ dns_result_parser (void *cls,
                       GNUNET_GNSRECORD_TYPE_LEHO,
                       strlen (rh->leho),
                       rh->leho);
+    phase_begin (rh,
+                 GNUNET_GNS_PHASE_DNS);
     rh->std_resolve = GNUNET_RESOLVER_ip_get (rh->name,
                                               af,
                                               DNS_LOOKUP_TIMEOUT,
                                               &handle_dns_result,
                                               rh);
-    GNUNET_DNSPARSER_free_packet (p);
-    GNUNET_DNSSTUB_resolve_cancel (rh->dns_request);
-    rh->dns_request = NULL;
     return;
   }
 
@@ -1152,14 +2026,140 @@ dns_result_parser (void *cls,
     rh->proc (rh->proc_cls,
               rd_count - skip,
               rd);
-    GNUNET_DNSSTUB_resolve_cancel (rh->dns_request);
-    rh->dns_request = NULL;
   }
-  GNUNET_DNSPARSER_free_packet (p);
-  if (NULL != rh->task_id)
-    GNUNET_SCHEDULER_cancel (rh->task_id); /* should be timeout task */
-  rh->task_id = GNUNET_SCHEDULER_add_now (&GNS_resolver_lookup_cancel_,
-                                          rh);
+  if (NULL != rh->task_id)
+    GNUNET_SCHEDULER_cancel (rh->task_id); /* should be timeout task */
+  rh->task_id = GNUNET_SCHEDULER_add_now (&GNS_resolver_lookup_cancel_,
+                                          rh);
+}
+
+
+/**
+ * Function called with the result of a DNS resolution.
+ * Passes the result to all resolutions waiting for it.
+ *
+ * @param cls the `struct PendingDnsQuery` of the request
+ * @param dns dns response, NULL on failure
+ * @param dns_len number of bytes in @a dns
+ */
+static void
+dns_result_parser (void *cls,
+                   const struct GNUNET_TUN_DnsHeader *dns,
+                   size_t dns_len)
+{
+  struct PendingDnsQuery *dq = cls;
+  struct GNS_ResolverHandle *rh;
+  struct GNUNET_DNSPARSER_Packet *p;
+
+  if (NULL == dns)
+  {
+    dq->dns_request = NULL;
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (dns_queries,
+                                                         &dq->key,
+                                                         dq));
+    while (NULL != (rh = dq->rh_head))
+    {
+      GNUNET_CONTAINER_MDLL_remove (dq,
+                                    dq->rh_head,
+                                    dq->rh_tail,
+                                    rh);
+      rh->dq = NULL;
+      GNUNET_SCHEDULER_cancel (rh->task_id);
+      rh->task_id = NULL;
+      phase_end (rh,
+                 GNUNET_GNS_PHASE_DNS);
+      fail_resolution (rh);
+    }
+    free_dns_query (dq);
+    return;
+  }
+  if (dq->original_dns_id != dns->id)
+  {
+    /* DNS answer, but for another query */
+    return;
+  }
+  p = GNUNET_DNSPARSER_parse ((const char *) dns,
+                              dns_len);
+  if (NULL == p)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                _ ("Failed to parse DNS response\n"));
+    return;
+  }
+  GNUNET_DNSSTUB_resolve_cancel (dq->dns_request);
+  dq->dns_request = NULL;
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (dns_queries,
+                                                       &dq->key,
+                                                       dq));
+  while (NULL != (rh = dq->rh_head))
+  {
+    GNUNET_CONTAINER_MDLL_remove (dq,
+                                  dq->rh_head,
+                                  dq->rh_tail,
+                                  rh);
+    rh->dq = NULL;
+    phase_end (rh,
+               GNUNET_GNS_PHASE_DNS);
+    process_dns_response (rh,
+                          p);
+  }
+  GNUNET_DNSPARSER_free_packet (p);
+  free_dns_query (dq);
+}
+
+
+/**
+ * Compute the key under which we share the DNS query of @a rh
+ * in #dns_queries.  Resolutions that came through the same GNS2DNS
+ * delegation ask the same DNS servers, so we combine the label of
+ * the delegation with the DNS name and record type.
+ *
+ * @param rh resolution with a DNS authority at the tail of its chain
+ * @param key[out] set to the key
+ */
+static void
+get_dns_query_key (const struct GNS_ResolverHandle *rh,
+                   struct GNUNET_HashCode *key)
+{
+  const struct AuthorityChain *ac = rh->ac_tail;
+  const struct AuthorityChain *gns_ac = ac->prev;
+  struct GNUNET_HashContext *hc;
+  uint32_t type = htonl ((uint32_t) rh->record_type);
+
+  hc = GNUNET_CRYPTO_hash_context_start ();
+  if ((NULL != gns_ac) &&
+      (GNUNET_YES == gns_ac->gns_authority))
+  {
+    GNUNET_CRYPTO_hash_context_read (
+      hc,
+      &gns_ac->authority_info.gns_authority,
+      GNUNET_IDENTITY_key_get_length (&gns_ac->authority_info.gns_authority));
+    GNUNET_CRYPTO_hash_context_read (hc,
+                                     gns_ac->label,
+                                     strlen (gns_ac->label) + 1);
+  }
+  else
+  {
+    /* no known delegation, share only with ourselves */
+    GNUNET_CRYPTO_hash_context_read (hc,
+                                     &rh,
+                                     sizeof(rh));
+  }
+  GNUNET_CRYPTO_hash_context_read (hc,
+                                   ac->authority_info.dns_authority.name,
+                                   strlen (
+                                     ac->authority_info.dns_authority.name)
+                                   + 1);
+  GNUNET_CRYPTO_hash_context_read (hc,
+                                   ac->label,
+                                   strlen (ac->label) + 1);
+  GNUNET_CRYPTO_hash_context_read (hc,
+                                   &type,
+                                   sizeof(type));
+  GNUNET_CRYPTO_hash_context_finish (hc,
+                                     key);
 }
 
 
@@ -1177,6 +2177,8 @@ recursive_dns_resolution (struct GNS_ResolverHandle *rh)
   struct AuthorityChain *ac;
   struct GNUNET_DNSPARSER_Query *query;
   struct GNUNET_DNSPARSER_Packet *p;
+  struct PendingDnsQuery *dq;
+  struct GNUNET_HashCode key;
   char *dns_request;
   size_t dns_request_length;
   int ret;
@@ -1187,6 +2189,29 @@ recursive_dns_resolution (struct GNS_ResolverHandle *rh)
               "Starting DNS lookup for `%s'\n",
               ac->label);
   GNUNET_assert (GNUNET_NO == ac->gns_authority);
+  GNUNET_assert (NULL == rh->dq);
+  phase_begin (rh,
+               GNUNET_GNS_PHASE_DNS);
+  get_dns_query_key (rh,
+                     &key);
+  dq = GNUNET_CONTAINER_multihashmap_get (dns_queries,
+                                          &key);
+  if (NULL != dq)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Joining pending DNS lookup for `%s'\n",
+                ac->label);
+    rh->leho = GNUNET_strdup (ac->label);
+    rh->dq = dq;
+    GNUNET_CONTAINER_MDLL_insert_tail (dq,
+                                       dq->rh_head,
+                                       dq->rh_tail,
+                                       rh);
+    rh->task_id = GNUNET_SCHEDULER_add_delayed (DNS_LOOKUP_TIMEOUT,
+                                                &timeout_resolution,
+                                                rh);
+    return;
+  }
   query = GNUNET_new (struct GNUNET_DNSPARSER_Query);
   query->name = GNUNET_strdup (ac->label);
   query->type = rh->record_type;
@@ -1205,6 +2230,7 @@ recursive_dns_resolution (struct GNS_ResolverHandle *rh)
   if (GNUNET_OK != ret)
   {
     GNUNET_break (0);
+    rh->failed = GNUNET_YES;
     rh->proc (rh->proc_cls,
               0,
               NULL);
@@ -1214,16 +2240,28 @@ recursive_dns_resolution (struct GNS_ResolverHandle *rh)
   }
   else
   {
-    rh->original_dns_id = p->id;
     GNUNET_assert (NULL != ac->authority_info.dns_authority.dns_handle);
-    GNUNET_assert (NULL == rh->dns_request);
-    rh->leho = GNUNET_strdup (ac->label);
-    rh->dns_request = GNUNET_DNSSTUB_resolve (
+    dq = GNUNET_new (struct PendingDnsQuery);
+    dq->key = key;
+    dq->ac = ac;
+    dq->original_dns_id = p->id;
+    dq->dns_request = GNUNET_DNSSTUB_resolve (
       ac->authority_info.dns_authority.dns_handle,
       dns_request,
       dns_request_length,
       &dns_result_parser,
-      rh);
+      dq);
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multihashmap_put (dns_queries,
+                                                      &dq->key,
+                                                      dq,
+                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+    rh->leho = GNUNET_strdup (ac->label);
+    rh->dq = dq;
+    GNUNET_CONTAINER_MDLL_insert_tail (dq,
+                                       dq->rh_head,
+                                       dq->rh_tail,
+                                       rh);
     rh->task_id = GNUNET_SCHEDULER_add_delayed (DNS_LOOKUP_TIMEOUT,
                                                 &timeout_resolution,
                                                 rh);
@@ -1357,7 +2395,8 @@ handle_gns_cname_result (struct GNS_ResolverHandle *rh,
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Doing standard DNS lookup for `%s'\n",
               rh->name);
-
+  phase_begin (rh,
+               GNUNET_GNS_PHASE_DNS);
   rh->std_resolve = GNUNET_RESOLVER_ip_get (rh->name,
                                             af,
                                             DNS_LOOKUP_TIMEOUT,
@@ -1405,6 +2444,8 @@ vpn_allocation_cb (void *cls,
 
   vpn_ctx->vpn_request = NULL;
   rh->vpn_ctx = NULL;
+  phase_end (rh,
+             GNUNET_GNS_PHASE_VPN);
   GNUNET_assert (GNUNET_OK ==
                  GNUNET_GNSRECORD_records_deserialize (
                    (size_t) vpn_ctx->rd_data_size,
@@ -2064,6 +3105,8 @@ handle_gns_resolution_result (void *cls,
                                                                (size_t) vpn_ctx
                                                                ->rd_data_size,
                                                                vpn_ctx->rd_data));
+            phase_begin (rh,
+                         GNUNET_GNS_PHASE_VPN);
             vpn_ctx->vpn_request = GNUNET_VPN_redirect_to_peer (vpn_handle,
                                                                 af,
                                                                 ntohs (
@@ -2435,6 +3478,131 @@ namecache_cache_continuation (void *cls,
 }
 
 
+/**
+ * Resolution @a rh no longer waits for its namecache or DHT lookup.
+ * If it was the last one to wait, the lookup is cancelled.
+ *
+ * @param rh resolution to remove from its #PendingQuery
+ */
+static void
+leave_pending_query (struct GNS_ResolverHandle *rh)
+{
+  struct PendingQuery *pq = rh->pq;
+
+  GNUNET_CONTAINER_MDLL_remove (pq,
+                                pq->rh_head,
+                                pq->rh_tail,
+                                rh);
+  rh->pq = NULL;
+  if (NULL != pq->rh_head)
+    return;
+  if (NULL != pq->namecache_qe)
+  {
+    GNUNET_NAMECACHE_cancel (pq->namecache_qe);
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (namecache_queries,
+                                                         &pq->query,
+                                                         pq));
+  }
+  else if (NULL != pq->get_handle)
+  {
+    GNUNET_DHT_get_stop (pq->get_handle);
+    GNUNET_CONTAINER_heap_remove_node (pq->dht_heap_node);
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (dht_queries,
+                                                         &pq->query,
+                                                         pq));
+  }
+  else
+  {
+    return; /* result is being processed, caller cleans up */
+  }
+  GNUNET_free (pq);
+}
+
+
+/**
+ * Fail all resolutions waiting for @a pq, then free it.  The
+ * lookup must have been stopped and removed from its map already.
+ *
+ * @param pq lookup that failed
+ */
+static void
+fail_pending_query (struct PendingQuery *pq)
+{
+  struct GNS_ResolverHandle *rh;
+
+  while (NULL != (rh = pq->rh_head))
+  {
+    GNUNET_CONTAINER_MDLL_remove (pq,
+                                  pq->rh_head,
+                                  pq->rh_tail,
+                                  rh);
+    rh->pq = NULL;
+    phase_end (rh,
+               GNUNET_GNS_PHASE_DHT);
+    fail_resolution (rh);
+  }
+  GNUNET_free (pq);
+}
+
+
+/**
+ * Remember the records of the current label of @a rh in the
+ * result cache, so that we do not need to decrypt them again.
+ *
+ * @param rh resolution handle, tail of the authority chain
+ *        must be a GNS authority
+ * @param rd_count number of entries in @a rd array
+ * @param rd array of records for the label
+ */
+static void
+cache_delegation (struct GNS_ResolverHandle *rh,
+                  unsigned int rd_count,
+                  const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct AuthorityChain *ac = rh->ac_tail;
+  struct GNUNET_HashCode query;
+
+  if (0 == rd_count)
+    return;
+  GNUNET_GNSRECORD_query_from_public_key (&ac->authority_info.gns_authority,
+                                          ac->label,
+                                          &query);
+  cache_records (&query,
+                 1,
+                 &ac->authority_info.gns_authority,
+                 get_min_expiration (rd_count,
+                                     rd),
+                 rd_count,
+                 rd);
+}
+
+
+/**
+ * Process records that were decrypted from a block that we got from
+ * the DHT.  Caches them, then calls #handle_gns_resolution_result().
+ *
+ * @param cls closure with the `struct GNS_ResolverHandle`
+ * @param rd_count number of entries in @a rd array
+ * @param rd array of records with data to store
+ */
+static void
+handle_gns_dht_resolution_result (void *cls,
+                                  unsigned int rd_count,
+                                  const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct GNS_ResolverHandle *rh = cls;
+
+  cache_delegation (rh,
+                    rd_count,
+                    rd);
+  handle_gns_resolution_result (rh,
+                                rd_count,
+                                rd);
+}
+
+
 /**
  * Iterator called on each result obtained for a DHT
  * operation that expects a reply
@@ -2464,55 +3632,64 @@ handle_dht_response (void *cls,
                      size_t size,
                      const void *data)
 {
-  struct GNS_ResolverHandle *rh = cls;
-  struct AuthorityChain *ac = rh->ac_tail;
+  struct PendingQuery *pq = cls;
+  struct GNS_ResolverHandle *rh;
+  struct AuthorityChain *ac;
   const struct GNUNET_GNSRECORD_Block *block;
   struct CacheOps *co;
 
-  (void) exp;
   (void) key;
   (void) get_path;
   (void) get_path_length;
   (void) put_path;
   (void) put_path_length;
   (void) type;
-  GNUNET_DHT_get_stop (rh->get_handle);
-  rh->get_handle = NULL;
-  GNUNET_CONTAINER_heap_remove_node (rh->dht_heap_node);
-  rh->dht_heap_node = NULL;
+  GNUNET_DHT_get_stop (pq->get_handle);
+  pq->get_handle = NULL;
+  GNUNET_CONTAINER_heap_remove_node (pq->dht_heap_node);
+  pq->dht_heap_node = NULL;
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (dht_queries,
+                                                       &pq->query,
+                                                       pq));
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Handling response from the DHT\n");
-  if (size < sizeof(struct GNUNET_GNSRECORD_Block))
-  {
-    /* how did this pass DHT block validation!? */
-    GNUNET_break (0);
-    fail_resolution (rh);
-    return;
-  }
   block = data;
-  if (size != GNUNET_GNSRECORD_block_get_size (block))
+  if ((size < sizeof(struct GNUNET_GNSRECORD_Block)) ||
+      (size != GNUNET_GNSRECORD_block_get_size (block)))
   {
     /* how did this pass DHT block validation!? */
     GNUNET_break (0);
-    fail_resolution (rh);
+    fail_pending_query (pq);
     return;
   }
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Decrypting DHT block of size %lu for `%s', expires %s\n",
               GNUNET_GNSRECORD_block_get_size (block),
-              rh->name,
+              GNUNET_h2s (&pq->query),
               GNUNET_STRINGS_absolute_time_to_string (exp));
-  if (GNUNET_OK !=
-      GNUNET_GNSRECORD_block_decrypt (block,
-                                      &ac->authority_info.gns_authority,
-                                      ac->label,
-                                      &handle_gns_resolution_result,
-                                      rh))
+  while (NULL != (rh = pq->rh_head))
   {
-    GNUNET_break_op (0);  /* block was ill-formed */
-    fail_resolution (rh);
-    return;
+    GNUNET_CONTAINER_MDLL_remove (pq,
+                                  pq->rh_head,
+                                  pq->rh_tail,
+                                  rh);
+    rh->pq = NULL;
+    phase_end (rh,
+               GNUNET_GNS_PHASE_DHT);
+    ac = rh->ac_tail;
+    if (GNUNET_OK !=
+        GNUNET_GNSRECORD_block_decrypt (block,
+                                        &ac->authority_info.gns_authority,
+                                        ac->label,
+                                        &handle_gns_dht_resolution_result,
+                                        rh))
+    {
+      GNUNET_break_op (0);  /* block was ill-formed */
+      fail_resolution (rh);
+    }
   }
+  GNUNET_free (pq);
   if (0 == GNUNET_TIME_absolute_get_remaining (
         GNUNET_GNSRECORD_block_get_expiration (block)).
       rel_value_us)
@@ -2548,35 +3725,70 @@ static void
 start_dht_request (struct GNS_ResolverHandle *rh,
                    const struct GNUNET_HashCode *query)
 {
-  struct GNS_ResolverHandle *rx;
-
-  GNUNET_assert (NULL == rh->get_handle);
-  rh->get_handle = GNUNET_DHT_get_start (dht_handle,
+  struct PendingQuery *pq;
+  struct PendingQuery *px;
+
+  GNUNET_assert (NULL == rh->pq);
+  phase_begin (rh,
+               GNUNET_GNS_PHASE_DHT);
+  pq = GNUNET_CONTAINER_multihashmap_get (dht_queries,
+                                          query);
+  if (NULL != pq)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Joining pending DHT lookup under key `%s'\n",
+                GNUNET_h2s (query));
+    rh->pq = pq;
+    GNUNET_CONTAINER_MDLL_insert_tail (pq,
+                                       pq->rh_head,
+                                       pq->rh_tail,
+                                       rh);
+    return;
+  }
+  pq = GNUNET_new (struct PendingQuery);
+  pq->query = *query;
+  pq->get_handle = GNUNET_DHT_get_start (dht_handle,
                                          GNUNET_BLOCK_TYPE_GNS_NAMERECORD,
                                          query,
                                          DHT_GNS_REPLICATION_LEVEL,
                                          GNUNET_DHT_RO_DEMULTIPLEX_EVERYWHERE,
                                          NULL, 0,
-                                         &handle_dht_response, rh);
-  rh->dht_heap_node = GNUNET_CONTAINER_heap_insert (dht_lookup_heap,
-                                                    rh,
+                                         &handle_dht_response, pq);
+  pq->dht_heap_node = GNUNET_CONTAINER_heap_insert (dht_lookup_heap,
+                                                    pq,
                                                     GNUNET_TIME_absolute_get ().
                                                     abs_value_us);
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_multihashmap_put (dht_queries,
+                                                    &pq->query,
+                                                    pq,
+                                                    GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  rh->pq = pq;
+  GNUNET_CONTAINER_MDLL_insert_tail (pq,
+                                     pq->rh_head,
+                                     pq->rh_tail,
+                                     rh);
   if (GNUNET_CONTAINER_heap_get_size (dht_lookup_heap) >
       max_allowed_background_queries)
   {
     /* fail longest-standing DHT request */
-    rx = GNUNET_CONTAINER_heap_remove_root (dht_lookup_heap);
-    rx->dht_heap_node = NULL;
-    GNUNET_assert (NULL != rx);
-    fail_resolution (rx);
+    px = GNUNET_CONTAINER_heap_remove_root (dht_lookup_heap);
+    GNUNET_assert (NULL != px);
+    px->dht_heap_node = NULL;
+    GNUNET_DHT_get_stop (px->get_handle);
+    px->get_handle = NULL;
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (dht_queries,
+                                                         &px->query,
+                                                         px));
+    fail_pending_query (px);
   }
 }
 
 
 /**
  * Process a records that were decrypted from a block that we got from
- * the namecache.  Simply calls #handle_gns_resolution_result().
+ * the namecache.  Caches them, then calls #handle_gns_resolution_result().
  *
  * @param cls closure with the `struct GNS_ResolverHandle`
  * @param rd_count number of entries in @a rd array
@@ -2593,6 +3805,9 @@ handle_gns_namecache_resolution_result (void *cls,
     GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
                 _ ("GNS namecache returned empty result for `%s'\n"),
                 rh->name);
+  cache_delegation (rh,
+                    rd_count,
+                    rd);
   handle_gns_resolution_result (rh,
                                 rd_count,
                                 rd);
@@ -2602,22 +3817,19 @@ handle_gns_namecache_resolution_result (void *cls,
 /**
  * Process a record that was stored in the namecache.
  *
- * @param cls closure with the `struct GNS_ResolverHandle`
+ * @param rh resolution that was waiting for the block
  * @param block block that was stored in the namecache
  */
 static void
-handle_namecache_block_response (void *cls,
-                                 const struct GNUNET_GNSRECORD_Block *block)
+process_namecache_block (struct GNS_ResolverHandle *rh,
+                         const struct GNUNET_GNSRECORD_Block *block)
 {
-  struct GNS_ResolverHandle *rh = cls;
   struct AuthorityChain *ac = rh->ac_tail;
   const char *label = ac->label;
   const struct GNUNET_IDENTITY_PublicKey *auth =
     &ac->authority_info.gns_authority;
   struct GNUNET_HashCode query;
 
-  GNUNET_assert (NULL != rh->namecache_qe);
-  rh->namecache_qe = NULL;
   if (((GNUNET_GNS_LO_DEFAULT == rh->options) ||
        ((GNUNET_GNS_LO_LOCAL_MASTER == rh->options) &&
         (ac != rh->ac_head))) &&
@@ -2679,6 +3891,42 @@ handle_namecache_block_response (void *cls,
 }
 
 
+/**
+ * Process a block from the namecache for all resolutions
+ * that were waiting for it.
+ *
+ * @param cls the `struct PendingQuery` of the lookup
+ * @param block block that was stored in the namecache
+ */
+static void
+handle_namecache_block_response (void *cls,
+                                 const struct GNUNET_GNSRECORD_Block *block)
+{
+  struct PendingQuery *pq = cls;
+  struct GNS_ResolverHandle *rh;
+
+  GNUNET_assert (NULL != pq->namecache_qe);
+  pq->namecache_qe = NULL;
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (namecache_queries,
+                                                       &pq->query,
+                                                       pq));
+  while (NULL != (rh = pq->rh_head))
+  {
+    GNUNET_CONTAINER_MDLL_remove (pq,
+                                  pq->rh_head,
+                                  pq->rh_tail,
+                                  rh);
+    rh->pq = NULL;
+    phase_end (rh,
+               GNUNET_GNS_PHASE_NAMECACHE);
+    process_namecache_block (rh,
+                             block);
+  }
+  GNUNET_free (pq);
+}
+
+
 /**
  * Lookup tail of our authority chain in the namecache.
  *
@@ -2689,6 +3937,7 @@ recursive_gns_resolution_namecache (struct GNS_ResolverHandle *rh)
 {
   struct AuthorityChain *ac = rh->ac_tail;
   struct GNUNET_HashCode query;
+  struct CacheEntry *ce;
 
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Starting GNS resolution for `%s' in zone %s\n",
@@ -2697,14 +3946,59 @@ recursive_gns_resolution_namecache (struct GNS_ResolverHandle *rh)
   GNUNET_GNSRECORD_query_from_public_key (&ac->authority_info.gns_authority,
                                           ac->label,
                                           &query);
+  if (NULL != (ce = lookup_cache (&query)))
+  {
+    struct GNUNET_GNSRECORD_Data rd[GNUNET_NZL (ce->rd_count)];
+
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Using cached records for label `%s'\n",
+                ac->label);
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_GNSRECORD_records_deserialize (ce->rd_len,
+                                                         ce->rd_ser,
+                                                         ce->rd_count,
+                                                         rd));
+    handle_gns_resolution_result (rh,
+                                  ce->rd_count,
+                                  rd);
+    return;
+  }
   if (GNUNET_YES != disable_cache)
   {
-    rh->namecache_qe
-      = GNUNET_NAMECACHE_lookup_block (namecache_handle,
-                                       &query,
-                                       &handle_namecache_block_response,
+    struct PendingQuery *pq;
+
+    GNUNET_assert (NULL == rh->pq);
+    phase_begin (rh,
+                 GNUNET_GNS_PHASE_NAMECACHE);
+    pq = GNUNET_CONTAINER_multihashmap_get (namecache_queries,
+                                            &query);
+    if (NULL == pq)
+    {
+      pq = GNUNET_new (struct PendingQuery);
+      pq->query = query;
+      pq->namecache_qe
+        = GNUNET_NAMECACHE_lookup_block (namecache_handle,
+                                         &query,
+                                         &handle_namecache_block_response,
+                                         pq);
+      GNUNET_assert (NULL != pq->namecache_qe);
+      GNUNET_assert (GNUNET_OK ==
+                     GNUNET_CONTAINER_multihashmap_put (namecache_queries,
+                                                        &pq->query,
+                                                        pq,
+                                                        GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+    }
+    else
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                  "Joining pending namecache lookup for `%s'\n",
+                  ac->label);
+    }
+    rh->pq = pq;
+    GNUNET_CONTAINER_MDLL_insert_tail (pq,
+                                       pq->rh_head,
+                                       pq->rh_tail,
                                        rh);
-    GNUNET_assert (NULL != rh->namecache_qe);
   }
   else
   {
@@ -2728,14 +4022,21 @@ handle_revocation_result (void *cls,
   struct AuthorityChain *ac = rh->ac_tail;
 
   rh->rev_check = NULL;
+  phase_end (rh,
+             GNUNET_GNS_PHASE_REVOCATION);
   if (GNUNET_YES != is_valid)
   {
     GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
                 _ ("Zone %s was revoked, resolution fails\n"),
                 GNUNET_GNSRECORD_z2s (&ac->authority_info.gns_authority));
+    cache_revocation_status (&ac->authority_info.gns_authority,
+                             GNUNET_YES);
+    invalidate_zone (&ac->authority_info.gns_authority);
     fail_resolution (rh);
     return;
   }
+  cache_revocation_status (&ac->authority_info.gns_authority,
+                           GNUNET_NO);
   recursive_gns_resolution_namecache (rh);
 }
 
@@ -2749,10 +4050,37 @@ static void
 recursive_gns_resolution_revocation (struct GNS_ResolverHandle *rh)
 {
   struct AuthorityChain *ac = rh->ac_tail;
+  struct RevocationCacheEntry *rce;
+  struct GNUNET_HashCode zkey;
 
+  if (0 != result_cache_size)
+  {
+    get_zone_key (&ac->authority_info.gns_authority,
+                  &zkey);
+    rce = GNUNET_CONTAINER_multihashmap_get (revocation_cache,
+                                             &zkey);
+    if ((NULL != rce) &&
+        (GNUNET_YES == rce->revoked))
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                  _ ("Zone %s was revoked, resolution fails\n"),
+                  GNUNET_GNSRECORD_z2s (&ac->authority_info.gns_authority));
+      fail_resolution (rh);
+      return;
+    }
+    if ((NULL != rce) &&
+        (0 != GNUNET_TIME_absolute_get_remaining (
+           rce->expiration).rel_value_us))
+    {
+      recursive_gns_resolution_namecache (rh);
+      return;
+    }
+  }
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Starting revocation check for zone %s\n",
               GNUNET_GNSRECORD_z2s (&ac->authority_info.gns_authority));
+  phase_begin (rh,
+               GNUNET_GNS_PHASE_REVOCATION);
   rh->rev_check = GNUNET_REVOCATION_query (cfg,
                                            &ac->authority_info.gns_authority,
                                            &handle_revocation_result,
@@ -2842,6 +4170,33 @@ start_resolver_lookup (void *cls)
                                             rh);
     return;
   }
+  if (&cache_lookup_result == rh->proc)
+  {
+    struct CacheEntry *ce;
+
+    ce = lookup_cache (&rh->result_key);
+    if (NULL != ce)
+    {
+      struct GNUNET_GNSRECORD_Data rd[GNUNET_NZL (ce->rd_count)];
+
+      GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                  "Using cached result for `%s'\n",
+                  rh->name);
+      GNUNET_assert (GNUNET_OK ==
+                     GNUNET_GNSRECORD_records_deserialize (ce->rd_len,
+                                                           ce->rd_ser,
+                                                           ce->rd_count,
+                                                           rd));
+      rh->trace.cache_hit = GNUNET_YES;
+      deliver_lookup_result (rh,
+                             ce->rd_count,
+                             rd);
+      GNUNET_assert (NULL == rh->task_id);
+      rh->task_id = GNUNET_SCHEDULER_add_now (&GNS_resolver_lookup_cancel_,
+                                              rh);
+      return;
+    }
+  }
 
   ac = GNUNET_new (struct AuthorityChain);
   ac->rh = rh;
@@ -2884,6 +4239,7 @@ GNS_resolver_lookup (const struct GNUNET_IDENTITY_PublicKey *zone,
                      void *proc_cls)
 {
   struct GNS_ResolverHandle *rh;
+  struct GNS_ResolverHandle *leader;
 
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Starting lookup for `%s'\n",
@@ -2900,6 +4256,58 @@ GNS_resolver_lookup (const struct GNUNET_IDENTITY_PublicKey *zone,
   rh->name = GNUNET_strdup (name);
   rh->name_resolution_pos = strlen (name);
   rh->loop_threshold = recursion_depth_limit;
+  rh->start_time = GNUNET_TIME_absolute_get ();
+  {
+    /* key the lookup by zone, type, options and name */
+    size_t klen = GNUNET_IDENTITY_key_get_length (zone);
+    size_t nlen = strlen (name);
+    char kbuf[klen + 2 * sizeof(uint32_t) + nlen];
+    uint32_t tmp;
+
+    GNUNET_memcpy (kbuf,
+                   zone,
+                   klen);
+    tmp = htonl (record_type);
+    GNUNET_memcpy (&kbuf[klen],
+                   &tmp,
+                   sizeof(tmp));
+    tmp = htonl ((uint32_t) options);
+    GNUNET_memcpy (&kbuf[klen + sizeof(tmp)],
+                   &tmp,
+                   sizeof(tmp));
+    GNUNET_memcpy (&kbuf[klen + 2 * sizeof(tmp)],
+                   name,
+                   nlen);
+    GNUNET_CRYPTO_hash (kbuf,
+                        sizeof(kbuf),
+                        &rh->result_key);
+  }
+  leader = GNUNET_CONTAINER_multihashmap_get (active_lookups,
+                                              &rh->result_key);
+  if ((NULL != leader) &&
+      (leader->loop_threshold == recursion_depth_limit))
+  {
+    /* same lookup is already in progress, wait for its result */
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Joining pending lookup for `%s'\n",
+                name);
+    rh->leader = leader;
+    GNUNET_CONTAINER_MDLL_insert_tail (follower,
+                                       leader->follower_head,
+                                       leader->follower_tail,
+                                       rh);
+    return rh;
+  }
+  if (NULL == leader)
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multihashmap_put (active_lookups,
+                                                      &rh->result_key,
+                                                      rh,
+                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  rh->client_proc = proc;
+  rh->client_proc_cls = proc_cls;
+  rh->proc = &cache_lookup_result;
+  rh->proc_cls = rh;
   rh->task_id = GNUNET_SCHEDULER_add_now (&start_resolver_lookup,
                                           rh);
   return rh;
@@ -2918,14 +4326,40 @@ GNS_resolver_lookup_cancel (struct GNS_ResolverHandle *rh)
   struct AuthorityChain *ac;
   struct VpnContext *vpn_ctx;
 
+  if (NULL != rh->leader)
+  {
+    struct GNS_ResolverHandle *leader = rh->leader;
+
+    GNUNET_CONTAINER_MDLL_remove (follower,
+                                  leader->follower_head,
+                                  leader->follower_tail,
+                                  rh);
+    rh->leader = NULL;
+    if ((NULL == leader->client_proc) &&
+        (NULL == leader->follower_head))
+    {
+      /* nobody is interested in the result anymore */
+      GNS_resolver_lookup_cancel (leader);
+    }
+  }
+  else if ((NULL != rh->follower_head) &&
+           (NULL != rh->client_proc))
+  {
+    /* our client is gone, but others still wait for the result */
+    rh->client_proc = NULL;
+    rh->client_proc_cls = NULL;
+    return;
+  }
+  GNUNET_CONTAINER_multihashmap_remove (active_lookups,
+                                        &rh->result_key,
+                                        rh);
   GNUNET_CONTAINER_DLL_remove (rlh_head,
                                rlh_tail,
                                rh);
-  if (NULL != rh->dns_request)
-  {
-    GNUNET_DNSSTUB_resolve_cancel (rh->dns_request);
-    rh->dns_request = NULL;
-  }
+  if (NULL != rh->dq)
+    leave_dns_query (rh);
+  if (NULL != rh->pq)
+    leave_pending_query (rh);
   while (NULL != (ac = rh->ac_head))
   {
     GNUNET_CONTAINER_DLL_remove (rh->ac_head,
@@ -2961,7 +4395,8 @@ GNS_resolver_lookup_cancel (struct GNS_ResolverHandle *rh)
         }
         GNUNET_free (gp);
       }
-      GNUNET_DNSSTUB_stop (ac->authority_info.dns_authority.dns_handle);
+      if (NULL != ac->authority_info.dns_authority.dns_handle)
+        GNUNET_DNSSTUB_stop (ac->authority_info.dns_authority.dns_handle);
     }
     GNUNET_free (ac->label);
     GNUNET_free (ac);
@@ -2971,27 +4406,12 @@ GNS_resolver_lookup_cancel (struct GNS_ResolverHandle *rh)
     GNUNET_SCHEDULER_cancel (rh->task_id);
     rh->task_id = NULL;
   }
-  if (NULL != rh->get_handle)
-  {
-    GNUNET_DHT_get_stop (rh->get_handle);
-    rh->get_handle = NULL;
-  }
-  if (NULL != rh->dht_heap_node)
-  {
-    GNUNET_CONTAINER_heap_remove_node (rh->dht_heap_node);
-    rh->dht_heap_node = NULL;
-  }
   if (NULL != (vpn_ctx = rh->vpn_ctx))
   {
     GNUNET_VPN_cancel_request (vpn_ctx->vpn_request);
     GNUNET_free (vpn_ctx->rd_data);
     GNUNET_free (vpn_ctx);
   }
-  if (NULL != rh->namecache_qe)
-  {
-    GNUNET_NAMECACHE_cancel (rh->namecache_qe);
-    rh->namecache_qe = NULL;
-  }
   if (NULL != rh->rev_check)
   {
     GNUNET_REVOCATION_query_cancel (rh->rev_check);
@@ -3017,9 +4437,91 @@ GNS_resolver_lookup_cancel (struct GNS_ResolverHandle *rh)
 }
 
 
+/**
+ * Get where the time of a resolution was spent.  Meant to be
+ * called from the #GNS_ResultProcessor of the resolution.
+ *
+ * @param rh the resolution
+ * @param[out] trace set to the trace of @a rh
+ */
+void
+GNS_resolver_lookup_get_trace (const struct GNS_ResolverHandle *rh,
+                               struct GNUNET_GNS_LookupTrace *trace)
+{
+  get_trace (rh,
+             trace);
+}
+
+
 /* ***************** Resolver initialization ********************* */
 
 
+/**
+ * A label in one of our zones changed.  Drop all cached results
+ * that depend on the zone.
+ *
+ * @param cls NULL
+ * @param zone private key of the zone
+ * @param label label of the records
+ * @param rd_count number of entries in @a rd array, 0 if label was deleted
+ * @param rd array of records
+ */
+static void
+handle_zone_change (void *cls,
+                    const struct GNUNET_IDENTITY_PrivateKey *zone,
+                    const char *label,
+                    unsigned int rd_count,
+                    const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct GNUNET_IDENTITY_PublicKey pub;
+  struct GNUNET_HashCode zkey;
+  struct GNUNET_TIME_Absolute *changed;
+
+  (void) cls;
+  (void) rd_count;
+  (void) rd;
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Label `%s' changed, dropping cached results of its zone\n",
+              label);
+  GNUNET_IDENTITY_key_get_public (zone,
+                                  &pub);
+  invalidate_zone (&pub);
+  get_zone_key (&pub,
+                &zkey);
+  changed = GNUNET_CONTAINER_multihashmap_get (zone_changes,
+                                               &zkey);
+  if (NULL == changed)
+  {
+    changed = GNUNET_new (struct GNUNET_TIME_Absolute);
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multihashmap_put (zone_changes,
+                                                      &zkey,
+                                                      changed,
+                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  }
+  *changed = GNUNET_TIME_absolute_get ();
+  GNUNET_NAMESTORE_zone_monitor_next (zmon,
+                                      1);
+}
+
+
+/**
+ * We lost the connection to the namestore and may have missed
+ * changes in our zones, so drop all cached results.
+ *
+ * @param cls NULL
+ */
+static void
+handle_zone_monitor_error (void *cls)
+{
+  (void) cls;
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Namestore monitor failed, dropping cached results\n");
+  while (NULL != ce_head)
+    free_cache_entry (ce_head);
+}
+
+
 /**
  * Initialize the resolver
  *
@@ -3034,6 +4536,8 @@ GNS_resolver_init (struct GNUNET_NAMECACHE_Handle *nc,
                    const struct GNUNET_CONFIGURATION_Handle *c,
                    unsigned long long max_bg_queries)
 {
+  unsigned long long key_cache_size;
+
   cfg = c;
   namecache_handle = nc;
   dht_handle = dht;
@@ -3046,10 +4550,120 @@ GNS_resolver_init (struct GNUNET_NAMECACHE_Handle *nc,
   if (GNUNET_YES == disable_cache)
     GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
                 "Namecache disabled\n");
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (cfg,
+                                             "gns",
+                                             "RESULT_CACHE_SIZE",
+                                             &result_cache_size))
+    result_cache_size = DEFAULT_RESULT_CACHE_SIZE;
+  if (GNUNET_OK ==
+      GNUNET_CONFIGURATION_get_value_number (cfg,
+                                             "gns",
+                                             "KEY_CACHE_SIZE",
+                                             &key_cache_size))
+    GNUNET_GNSRECORD_set_key_cache_size ((unsigned int) key_cache_size);
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_time (cfg,
+                                           "gns",
+                                           "NEGATIVE_CACHE_TTL",
+                                           &negative_cache_ttl))
+    negative_cache_ttl = DEFAULT_NEGATIVE_CACHE_TTL;
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_time (cfg,
+                                           "gns",
+                                           "REVOCATION_CACHE_TTL",
+                                           &revocation_cache_ttl))
+    revocation_cache_ttl = DEFAULT_REVOCATION_CACHE_TTL;
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_time (cfg,
+                                           "gns",
+                                           "RESULT_CACHE_TTL",
+                                           &result_cache_ttl))
+    result_cache_ttl = DEFAULT_RESULT_CACHE_TTL;
+  namecache_queries = GNUNET_CONTAINER_multihashmap_create (128,
+                                                           GNUNET_NO);
+  dht_queries = GNUNET_CONTAINER_multihashmap_create (128,
+                                                      GNUNET_NO);
+  dns_queries = GNUNET_CONTAINER_multihashmap_create (16,
+                                                      GNUNET_NO);
+  active_lookups = GNUNET_CONTAINER_multihashmap_create (128,
+                                                         GNUNET_NO);
+  if (0 != result_cache_size)
+  {
+    result_cache = GNUNET_CONTAINER_multihashmap_create (128,
+                                                         GNUNET_NO);
+    zone_deps = GNUNET_CONTAINER_multihashmap_create (128,
+                                                      GNUNET_NO);
+    revocation_cache = GNUNET_CONTAINER_multihashmap_create (16,
+                                                             GNUNET_NO);
+    zone_changes = GNUNET_CONTAINER_multihashmap_create (16,
+                                                         GNUNET_NO);
+    zmon = GNUNET_NAMESTORE_zone_monitor_start (cfg,
+                                                NULL,
+                                                GNUNET_NO,
+                                                &handle_zone_monitor_error,
+                                                NULL,
+                                                &handle_zone_change,
+                                                NULL,
+                                                NULL /* sync_cb */,
+                                                NULL);
+    GNUNET_break (NULL != zmon);
+    if (NULL != zmon)
+      GNUNET_NAMESTORE_zone_monitor_next (zmon,
+                                          NAMESTORE_QUEUE_LIMIT - 1);
+  }
   vpn_handle = GNUNET_VPN_connect (cfg);
 }
 
 
+/**
+ * Free an entry of the #revocation_cache.
+ *
+ * @param cls NULL
+ * @param key unused
+ * @param value the `struct RevocationCacheEntry` to free
+ * @return #GNUNET_OK (continue to iterate)
+ */
+static int
+free_revocation_entry (void *cls,
+                       const struct GNUNET_HashCode *key,
+                       void *value)
+{
+  struct RevocationCacheEntry *rce = value;
+
+  (void) cls;
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (revocation_cache,
+                                                       key,
+                                                       rce));
+  GNUNET_free (rce);
+  return GNUNET_OK;
+}
+
+
+/**
+ * Free an entry of the #zone_changes map.
+ *
+ * @param cls NULL
+ * @param key unused
+ * @param value the `struct GNUNET_TIME_Absolute` to free
+ * @return #GNUNET_OK (continue to iterate)
+ */
+static int
+free_zone_change (void *cls,
+                  const struct GNUNET_HashCode *key,
+                  void *value)
+{
+  (void) cls;
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (zone_changes,
+                                                       key,
+                                                       value));
+  GNUNET_free (value);
+  return GNUNET_OK;
+}
+
+
 /**
  * Shutdown resolver
  */
@@ -3075,6 +4689,53 @@ GNS_resolver_done ()
     GNUNET_NAMECACHE_cancel (co->namecache_qe_cache);
     GNUNET_free (co);
   }
+  GNUNET_break (0 ==
+                GNUNET_CONTAINER_multihashmap_size (namecache_queries));
+  GNUNET_CONTAINER_multihashmap_destroy (namecache_queries);
+  namecache_queries = NULL;
+  GNUNET_break (0 ==
+                GNUNET_CONTAINER_multihashmap_size (dht_queries));
+  GNUNET_CONTAINER_multihashmap_destroy (dht_queries);
+  dht_queries = NULL;
+  GNUNET_break (0 ==
+                GNUNET_CONTAINER_multihashmap_size (dns_queries));
+  GNUNET_CONTAINER_multihashmap_destroy (dns_queries);
+  dns_queries = NULL;
+  GNUNET_CONTAINER_multihashmap_destroy (active_lookups);
+  active_lookups = NULL;
+  if (NULL != zmon)
+  {
+    GNUNET_NAMESTORE_zone_monitor_stop (zmon);
+    zmon = NULL;
+  }
+  while (NULL != ce_head)
+    free_cache_entry (ce_head);
+  if (NULL != zone_changes)
+  {
+    GNUNET_CONTAINER_multihashmap_iterate (zone_changes,
+                                           &free_zone_change,
+                                           NULL);
+    GNUNET_CONTAINER_multihashmap_destroy (zone_changes);
+    zone_changes = NULL;
+  }
+  if (NULL != revocation_cache)
+  {
+    GNUNET_CONTAINER_multihashmap_iterate (revocation_cache,
+                                           &free_revocation_entry,
+                                           NULL);
+    GNUNET_CONTAINER_multihashmap_destroy (revocation_cache);
+    revocation_cache = NULL;
+  }
+  if (NULL != result_cache)
+  {
+    GNUNET_CONTAINER_multihashmap_destroy (result_cache);
+    result_cache = NULL;
+  }
+  if (NULL != zone_deps)
+  {
+    GNUNET_CONTAINER_multihashmap_destroy (zone_deps);
+    zone_deps = NULL;
+  }
   GNUNET_CONTAINER_heap_destroy (dht_lookup_heap);
   dht_lookup_heap = NULL;
   GNUNET_VPN_disconnect (vpn_handle);
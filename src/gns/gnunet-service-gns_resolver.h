@@ -103,4 +103,16 @@ GNS_resolver_lookup (const struct GNUNET_IDENTITY_PublicKey *zone,
 void
 GNS_resolver_lookup_cancel (struct GNS_ResolverHandle *rh);
 
+
+/**
+ * Get where the time of a resolution was spent.  Meant to be
+ * called from the #GNS_ResultProcessor of the resolution.
+ *
+ * @param rh the resolution
+ * @param[out] trace set to the trace of @a rh
+ */
+void
+GNS_resolver_lookup_get_trace (const struct GNS_ResolverHandle *rh,
+                               struct GNUNET_GNS_LookupTrace *trace);
+
 #endif
@@ -35,6 +35,8 @@
 #include "gnunet_tun_lib.h"
 
 
+#include <pthread.h>
+
 #define LOG(kind, ...) GNUNET_log_from (kind, "gnsrecord", __VA_ARGS__)
 
 ssize_t
@@ -132,35 +134,319 @@ eddsa_symmetric_encrypt (
 
 
 /**
- * Derive session key and iv from label and public key.
+ * Default number of (zone, label) pairs for which we cache the
+ * derived keys.
+ */
+#define DEFAULT_KEY_CACHE_SIZE 1024
+
+/**
+ * Length of the part of the IV / nonce that is derived from
+ * the zone and the label (the rest is the block expiration).
+ */
+#define DERIVED_IV_LENGTH (crypto_secretbox_NONCEBYTES - sizeof(uint64_t))
+
+
+/**
+ * Keys derived from a zone key and a label.  Computing these
+ * requires elliptic curve operations, so we keep them in an
+ * LRU cache for hot labels.
+ */
+struct DerivedKeys
+{
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct DerivedKeys *next;
+
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct DerivedKeys *prev;
+
+  /**
+   * Hash over the zone key and the label, key in #key_cache.
+   */
+  struct GNUNET_HashCode key;
+
+  /**
+   * DHT query (and namecache key) for the label in the zone.
+   */
+  struct GNUNET_HashCode query;
+
+  /**
+   * Label-specific public key derived from the zone key.
+   */
+  struct GNUNET_IDENTITY_PublicKey derived_key;
+
+  /**
+   * Symmetric key used to encrypt the records of the block.
+   */
+  unsigned char skey[crypto_secretbox_KEYBYTES];
+
+  /**
+   * Label-specific part of the IV (ECDSA, only the first 4
+   * bytes are used) or nonce (EDDSA) of the block.
+   */
+  unsigned char iv[DERIVED_IV_LENGTH];
+};
+
+
+/**
+ * Map from `struct DerivedKeys.key` to `struct DerivedKeys`,
+ * NULL if not yet used.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *key_cache;
+
+/**
+ * Head of the LRU list of #key_cache entries.
+ */
+static struct DerivedKeys *dk_head;
+
+/**
+ * Tail of the LRU list of #key_cache entries.
+ */
+static struct DerivedKeys *dk_tail;
+
+/**
+ * Maximum number of entries in #key_cache, 0 to disable caching.
+ */
+static unsigned int key_cache_size = DEFAULT_KEY_CACHE_SIZE;
+
+/**
+ * Protects #key_cache, as blocks may be created from several
+ * threads (i.e. by the zonemaster's signing workers).
+ */
+static pthread_mutex_t key_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * Remove the least recently used entries from the #key_cache
+ * until it has at most @a max entries.
  *
- * @param iv initialization vector to initialize
- * @param skey session key to initialize
- * @param label label to use for KDF
- * @param pub public key to use for KDF
+ * @param max number of entries to keep
  */
 static void
-derive_block_aes_key (unsigned char *ctr,
-                      unsigned char *key,
-                      const char *label,
-                      uint64_t exp,
-                      const struct GNUNET_CRYPTO_EcdsaPublicKey *pub)
+trim_key_cache (unsigned int max)
+{
+  struct DerivedKeys *dk;
+
+  while ( (NULL != (dk = dk_tail)) &&
+          (GNUNET_CONTAINER_multihashmap_size (key_cache) > max) )
+  {
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (key_cache,
+                                                         &dk->key,
+                                                         dk));
+    GNUNET_CONTAINER_DLL_remove (dk_head,
+                                 dk_tail,
+                                 dk);
+    GNUNET_free (dk);
+  }
+}
+
+
+/**
+ * Set how many (zone, label) pairs the library caches the derived
+ * keys for.
+ *
+ * @param size maximum number of cache entries, 0 to disable the cache
+ */
+void
+GNUNET_GNSRECORD_set_key_cache_size (unsigned int size)
+{
+  GNUNET_assert (0 == pthread_mutex_lock (&key_cache_lock));
+  key_cache_size = size;
+  if (NULL != key_cache)
+    trim_key_cache (size);
+  GNUNET_assert (0 == pthread_mutex_unlock (&key_cache_lock));
+}
+
+
+/**
+ * Compute the keys derived from @a pub and @a label.
+ *
+ * @param pub public key of the zone
+ * @param label label to derive the keys for
+ * @param[out] dk where to store the keys
+ */
+static void
+derive_keys (const struct GNUNET_IDENTITY_PublicKey *pub,
+             const char *label,
+             struct DerivedKeys *dk)
 {
   static const char ctx_key[] = "gns-aes-ctx-key";
   static const char ctx_iv[] = "gns-aes-ctx-iv";
 
-  GNUNET_CRYPTO_kdf (key, GNUNET_CRYPTO_AES_KEY_LENGTH,
-                     ctx_key, strlen (ctx_key),
-                     pub, sizeof(struct GNUNET_CRYPTO_EcdsaPublicKey),
-                     label, strlen (label),
-                     NULL, 0);
+  memset (dk->iv,
+          0,
+          sizeof (dk->iv));
+  dk->derived_key.type = pub->type;
+  switch (ntohl (pub->type))
+  {
+  case GNUNET_GNSRECORD_TYPE_PKEY:
+    GNUNET_CRYPTO_ecdsa_public_key_derive (&pub->ecdsa_key,
+                                           label,
+                                           "gns",
+                                           &dk->derived_key.ecdsa_key);
+    GNUNET_CRYPTO_hash (&dk->derived_key.ecdsa_key,
+                        sizeof (dk->derived_key.ecdsa_key),
+                        &dk->query);
+    GNUNET_CRYPTO_kdf (dk->skey, GNUNET_CRYPTO_AES_KEY_LENGTH,
+                       ctx_key, strlen (ctx_key),
+                       &pub->ecdsa_key,
+                       sizeof(struct GNUNET_CRYPTO_EcdsaPublicKey),
+                       label, strlen (label),
+                       NULL, 0);
+    /** 4 byte nonce **/
+    GNUNET_CRYPTO_kdf (dk->iv, 4,
+                       ctx_iv, strlen (ctx_iv),
+                       &pub->ecdsa_key,
+                       sizeof(struct GNUNET_CRYPTO_EcdsaPublicKey),
+                       label, strlen (label),
+                       NULL, 0);
+    break;
+  case GNUNET_GNSRECORD_TYPE_EDKEY:
+    GNUNET_CRYPTO_eddsa_public_key_derive (&pub->eddsa_key,
+                                           label,
+                                           "gns",
+                                           &dk->derived_key.eddsa_key);
+    GNUNET_CRYPTO_hash (&dk->derived_key.eddsa_key,
+                        sizeof (dk->derived_key.eddsa_key),
+                        &dk->query);
+    GNUNET_CRYPTO_kdf (dk->skey, crypto_secretbox_KEYBYTES,
+                       ctx_key, strlen (ctx_key),
+                       &pub->eddsa_key,
+                       sizeof(struct GNUNET_CRYPTO_EddsaPublicKey),
+                       label, strlen (label),
+                       NULL, 0);
+    /** 16 byte nonce **/
+    GNUNET_CRYPTO_kdf (dk->iv, DERIVED_IV_LENGTH,
+                       ctx_iv, strlen (ctx_iv),
+                       &pub->eddsa_key,
+                       sizeof(struct GNUNET_CRYPTO_EddsaPublicKey),
+                       label, strlen (label),
+                       NULL, 0);
+    break;
+  default:
+    GNUNET_assert (0);
+  }
+}
+
+
+/**
+ * Obtain the keys derived from @a pub and @a label, from the
+ * #key_cache if possible.
+ *
+ * @param pub public key of the zone, must be ECDSA or EDDSA
+ * @param label label to get the keys for
+ * @param[out] dk where to store the derived keys
+ */
+static void
+get_derived_keys (const struct GNUNET_IDENTITY_PublicKey *pub,
+                  const char *label,
+                  struct DerivedKeys *dk)
+{
+  size_t label_len = strlen (label);
+  char buf[sizeof (*pub) + label_len];
+  struct DerivedKeys *pos;
+
+  GNUNET_memcpy (buf,
+                 pub,
+                 sizeof (*pub));
+  GNUNET_memcpy (&buf[sizeof (*pub)],
+                 label,
+                 label_len);
+  GNUNET_CRYPTO_hash (buf,
+                      sizeof (buf),
+                      &dk->key);
+  GNUNET_assert (0 == pthread_mutex_lock (&key_cache_lock));
+  if (NULL != key_cache)
+  {
+    pos = GNUNET_CONTAINER_multihashmap_get (key_cache,
+                                             &dk->key);
+    if (NULL != pos)
+    {
+      /* cache hit, move to the front of the LRU list */
+      GNUNET_CONTAINER_DLL_remove (dk_head,
+                                   dk_tail,
+                                   pos);
+      GNUNET_CONTAINER_DLL_insert (dk_head,
+                                   dk_tail,
+                                   pos);
+      *dk = *pos;
+      GNUNET_assert (0 == pthread_mutex_unlock (&key_cache_lock));
+      return;
+    }
+  }
+  GNUNET_assert (0 == pthread_mutex_unlock (&key_cache_lock));
+  /* do the expensive part without holding the lock */
+  derive_keys (pub,
+               label,
+               dk);
+  GNUNET_assert (0 == pthread_mutex_lock (&key_cache_lock));
+  if (0 == key_cache_size)
+  {
+    GNUNET_assert (0 == pthread_mutex_unlock (&key_cache_lock));
+    return;
+  }
+  if (NULL == key_cache)
+    key_cache = GNUNET_CONTAINER_multihashmap_create (key_cache_size,
+                                                      GNUNET_NO);
+  if (NULL == GNUNET_CONTAINER_multihashmap_get (key_cache,
+                                                 &dk->key))
+  {
+    trim_key_cache (key_cache_size - 1);
+    pos = GNUNET_new (struct DerivedKeys);
+    *pos = *dk;
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multihashmap_put (key_cache,
+                                                      &pos->key,
+                                                      pos,
+                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+    GNUNET_CONTAINER_DLL_insert (dk_head,
+                                 dk_tail,
+                                 pos);
+  }
+  GNUNET_assert (0 == pthread_mutex_unlock (&key_cache_lock));
+}
+
+
+/**
+ * Free the #key_cache when the library is unloaded.
+ */
+void __attribute__ ((destructor))
+GNSRECORD_crypto_fini ()
+{
+  if (NULL == key_cache)
+    return;
+  trim_key_cache (0);
+  GNUNET_CONTAINER_multihashmap_destroy (key_cache);
+  key_cache = NULL;
+}
+
+
+/**
+ * Derive session key and iv for an ECDSA block.
+ *
+ * @param ctr initialization vector to initialize
+ * @param key session key to initialize
+ * @param exp block expiration in network byte order
+ * @param dk keys derived from the zone and the label
+ */
+static void
+derive_block_aes_key (unsigned char *ctr,
+                      unsigned char *key,
+                      uint64_t exp,
+                      const struct DerivedKeys *dk)
+{
+  GNUNET_memcpy (key,
+                 dk->skey,
+                 GNUNET_CRYPTO_AES_KEY_LENGTH);
   memset (ctr, 0, GNUNET_CRYPTO_AES_KEY_LENGTH / 2);
   /** 4 byte nonce **/
-  GNUNET_CRYPTO_kdf (ctr, 4,
-                     ctx_iv, strlen (ctx_iv),
-                     pub, sizeof(struct GNUNET_CRYPTO_EcdsaPublicKey),
-                     label, strlen (label),
-                     NULL, 0);
+  GNUNET_memcpy (ctr,
+                 dk->iv,
+                 4);
   /** Expiration time 64 bit. **/
   memcpy (ctr + 4, &exp, sizeof (exp));
   /** Set counter part to 1 **/
@@ -169,37 +455,28 @@ derive_block_aes_key (unsigned char *ctr,
 
 
 /**
- * Derive session key and iv from label and public key.
+ * Derive session key and nonce for an EDDSA block.
  *
  * @param nonce initialization vector to initialize
- * @param skey session key to initialize
- * @param label label to use for KDF
- * @param pub public key to use for KDF
+ * @param key session key to initialize
+ * @param exp block expiration in network byte order
+ * @param dk keys derived from the zone and the label
  */
 static void
 derive_block_xsalsa_key (unsigned char *nonce,
                          unsigned char *key,
-                         const char *label,
                          uint64_t exp,
-                         const struct GNUNET_CRYPTO_EddsaPublicKey *pub)
+                         const struct DerivedKeys *dk)
 {
-  static const char ctx_key[] = "gns-aes-ctx-key";
-  static const char ctx_iv[] = "gns-aes-ctx-iv";
-
-  GNUNET_CRYPTO_kdf (key, crypto_secretbox_KEYBYTES,
-                     ctx_key, strlen (ctx_key),
-                     pub, sizeof(struct GNUNET_CRYPTO_EddsaPublicKey),
-                     label, strlen (label),
-                     NULL, 0);
-  memset (nonce, 0, crypto_secretbox_NONCEBYTES);
+  GNUNET_memcpy (key,
+                 dk->skey,
+                 crypto_secretbox_KEYBYTES);
   /** 16 byte nonce **/
-  GNUNET_CRYPTO_kdf (nonce, (crypto_secretbox_NONCEBYTES - sizeof (exp)),
-                     ctx_iv, strlen (ctx_iv),
-                     pub, sizeof(struct GNUNET_CRYPTO_EddsaPublicKey),
-                     label, strlen (label),
-                     NULL, 0);
+  GNUNET_memcpy (nonce,
+                 dk->iv,
+                 DERIVED_IV_LENGTH);
   /** Expiration time 64 bit. **/
-  memcpy (nonce + (crypto_secretbox_NONCEBYTES - sizeof (exp)),
+  memcpy (nonce + DERIVED_IV_LENGTH,
           &exp, sizeof (exp));
 }
 
@@ -228,6 +505,8 @@ block_create_ecdsa (const struct GNUNET_CRYPTO_EcdsaPrivateKey *key,
   struct GNUNET_GNSRECORD_Block *block;
   struct GNUNET_GNSRECORD_EcdsaBlock *ecblock;
   struct GNUNET_CRYPTO_EcdsaPrivateKey *dkey;
+  struct GNUNET_IDENTITY_PublicKey zone_key;
+  struct DerivedKeys dk;
   unsigned char ctr[GNUNET_CRYPTO_AES_KEY_LENGTH / 2];
   unsigned char skey[GNUNET_CRYPTO_AES_KEY_LENGTH];
   struct GNUNET_GNSRECORD_Data rdc[GNUNET_NZL (rd_count)];
@@ -286,16 +565,19 @@ block_create_ecdsa (const struct GNUNET_CRYPTO_EcdsaPrivateKey *key,
     ecblock->purpose.purpose = htonl (GNUNET_SIGNATURE_PURPOSE_GNS_RECORD_SIGN);
     ecblock->expiration_time = GNUNET_TIME_absolute_hton (expire);
     /* encrypt and sign */
+    zone_key.type = htonl (GNUNET_IDENTITY_TYPE_ECDSA);
+    zone_key.ecdsa_key = *pkey;
+    get_derived_keys (&zone_key,
+                      label,
+                      &dk);
     dkey = GNUNET_CRYPTO_ecdsa_private_key_derive (key,
                                                    label,
                                                    "gns");
-    GNUNET_CRYPTO_ecdsa_key_get_public (dkey,
-                                        &ecblock->derived_key);
+    ecblock->derived_key = dk.derived_key.ecdsa_key;
     derive_block_aes_key (ctr,
                           skey,
-                          label,
                           ecblock->expiration_time.abs_value_us__,
-                          pkey);
+                          &dk);
     GNUNET_break (payload_len + sizeof(uint32_t) ==
                   ecdsa_symmetric_encrypt (payload,
                                            payload_len
@@ -343,6 +625,8 @@ block_create_eddsa (const struct GNUNET_CRYPTO_EddsaPrivateKey *key,
   struct GNUNET_GNSRECORD_Block *block;
   struct GNUNET_GNSRECORD_EddsaBlock *edblock;
   struct GNUNET_CRYPTO_EddsaPrivateScalar dkey;
+  struct GNUNET_IDENTITY_PublicKey zone_key;
+  struct DerivedKeys dk;
   unsigned char nonce[crypto_secretbox_NONCEBYTES];
   unsigned char skey[crypto_secretbox_KEYBYTES];
   struct GNUNET_GNSRECORD_Data rdc[GNUNET_NZL (rd_count)];
@@ -403,17 +687,20 @@ block_create_eddsa (const struct GNUNET_CRYPTO_EddsaPrivateKey *key,
     edblock->purpose.purpose = htonl (GNUNET_SIGNATURE_PURPOSE_GNS_RECORD_SIGN);
     edblock->expiration_time = GNUNET_TIME_absolute_hton (expire);
     /* encrypt and sign */
+    zone_key.type = htonl (GNUNET_IDENTITY_TYPE_EDDSA);
+    zone_key.eddsa_key = *pkey;
+    get_derived_keys (&zone_key,
+                      label,
+                      &dk);
     GNUNET_CRYPTO_eddsa_private_key_derive (key,
                                             label,
                                             "gns",
                                             &dkey);
-    GNUNET_CRYPTO_eddsa_key_get_public_from_scalar (&dkey,
-                                                    &edblock->derived_key);
+    edblock->derived_key = dk.derived_key.eddsa_key;
     derive_block_xsalsa_key (nonce,
                              skey,
-                             label,
                              edblock->expiration_time.abs_value_us__,
-                             pkey);
+                             &dk);
     GNUNET_break (GNUNET_OK ==
                   eddsa_symmetric_encrypt (payload,
                                            payload_len
@@ -583,9 +870,7 @@ GNUNET_GNSRECORD_block_verify (const struct GNUNET_GNSRECORD_Block *block)
 
 enum GNUNET_GenericReturnValue
 block_decrypt_ecdsa (const struct GNUNET_GNSRECORD_EcdsaBlock *block,
-                     const struct
-                     GNUNET_CRYPTO_EcdsaPublicKey *zone_key,
-                     const char *label,
+                     const struct DerivedKeys *dk,
                      GNUNET_GNSRECORD_RecordCallback proc,
                      void *proc_cls)
 {
@@ -604,9 +889,8 @@ block_decrypt_ecdsa (const struct GNUNET_GNSRECORD_EcdsaBlock *block,
   }
   derive_block_aes_key (ctr,
                         key,
-                        label,
                         block->expiration_time.abs_value_us__,
-                        zone_key);
+                        dk);
   {
     char payload[payload_len];
     uint32_t rd_count;
@@ -711,9 +995,7 @@ block_decrypt_ecdsa (const struct GNUNET_GNSRECORD_EcdsaBlock *block,
 
 enum GNUNET_GenericReturnValue
 block_decrypt_eddsa (const struct GNUNET_GNSRECORD_EddsaBlock *block,
-                     const struct
-                     GNUNET_CRYPTO_EddsaPublicKey *zone_key,
-                     const char *label,
+                     const struct DerivedKeys *dk,
                      GNUNET_GNSRECORD_RecordCallback proc,
                      void *proc_cls)
 {
@@ -732,9 +1014,8 @@ block_decrypt_eddsa (const struct GNUNET_GNSRECORD_EddsaBlock *block,
   }
   derive_block_xsalsa_key (nonce,
                            key,
-                           label,
                            block->expiration_time.abs_value_us__,
-                           zone_key);
+                           dk);
   {
     char payload[payload_len];
     uint32_t rd_count;
@@ -856,14 +1137,22 @@ GNUNET_GNSRECORD_block_decrypt (const struct GNUNET_GNSRECORD_Block *block,
                                 GNUNET_GNSRECORD_RecordCallback proc,
                                 void *proc_cls)
 {
+  struct DerivedKeys dk;
+
   switch (ntohl (zone_key->type))
   {
   case GNUNET_IDENTITY_TYPE_ECDSA:
+    get_derived_keys (zone_key,
+                      label,
+                      &dk);
     return block_decrypt_ecdsa (&block->ecdsa_block,
-                                &zone_key->ecdsa_key, label, proc, proc_cls);
+                                &dk, proc, proc_cls);
   case GNUNET_IDENTITY_TYPE_EDDSA:
+    get_derived_keys (zone_key,
+                      label,
+                      &dk);
     return block_decrypt_eddsa (&block->eddsa_block,
-                                &zone_key->eddsa_key, label, proc, proc_cls);
+                                &dk, proc, proc_cls);
   default:
     return GNUNET_SYSERR;
   }
@@ -915,29 +1204,16 @@ GNUNET_GNSRECORD_query_from_public_key (const struct
                                         const char *label,
                                         struct GNUNET_HashCode *query)
 {
-  struct GNUNET_IDENTITY_PublicKey pd;
+  struct DerivedKeys dk;
 
   switch (ntohl (pub->type))
   {
   case GNUNET_GNSRECORD_TYPE_PKEY:
-    pd.type = pub->type;
-    GNUNET_CRYPTO_ecdsa_public_key_derive (&pub->ecdsa_key,
-                                           label,
-                                           "gns",
-                                           &pd.ecdsa_key);
-    GNUNET_CRYPTO_hash (&pd.ecdsa_key,
-                        sizeof (pd.ecdsa_key),
-                        query);
-    break;
   case GNUNET_GNSRECORD_TYPE_EDKEY:
-    pd.type = pub->type;
-    GNUNET_CRYPTO_eddsa_public_key_derive (&pub->eddsa_key,
-                                           label,
-                                           "gns",
-                                           &(pd.eddsa_key));
-    GNUNET_CRYPTO_hash (&pd.eddsa_key,
-                        sizeof (pd.eddsa_key),
-                        query);
+    get_derived_keys (pub,
+                      label,
+                      &dk);
+    *query = dk.query;
     break;
   default:
     GNUNET_assert (0);
@@ -74,6 +74,7 @@ run (void *cls,
   const char *s_name;
   struct GNUNET_TIME_Absolute start_time;
   struct GNUNET_IDENTITY_PrivateKey privkey;
+  struct GNUNET_IDENTITY_PublicKey pubkey;
   struct GNUNET_TIME_Absolute expire;
 
   (void) cls;
@@ -107,6 +108,41 @@ run (void *cls,
              GNUNET_TIME_absolute_get_duration (start_time),
              GNUNET_YES),
            ROUNDS);
+
+  /* test block lookup and decryption, with and without key cache */
+  GNUNET_IDENTITY_key_get_public (&privkey,
+                                  &pubkey);
+  block = GNUNET_GNSRECORD_block_create2 (&privkey,
+                                          expire,
+                                          s_name,
+                                          s_rd,
+                                          RECORDS);
+  GNUNET_assert (NULL != block);
+  for (unsigned int cached = 0; cached < 2; cached++)
+  {
+    GNUNET_GNSRECORD_set_key_cache_size ((0 == cached) ? 0 : 1024);
+    start_time = GNUNET_TIME_absolute_get ();
+    for (unsigned int i = 0; i < ROUNDS; i++)
+    {
+      GNUNET_GNSRECORD_query_from_public_key (&pubkey,
+                                              s_name,
+                                              &query);
+      GNUNET_assert (GNUNET_OK ==
+                     GNUNET_GNSRECORD_block_decrypt (block,
+                                                     &pubkey,
+                                                     s_name,
+                                                     NULL,
+                                                     NULL));
+    }
+    fprintf (stderr,
+             "Took %s to look up and decrypt %u GNS blocks (key cache %s)\n",
+             GNUNET_STRINGS_relative_time_to_string (
+               GNUNET_TIME_absolute_get_duration (start_time),
+               GNUNET_YES),
+             ROUNDS,
+             (0 == cached) ? "off" : "on");
+  }
+  GNUNET_free (block);
   for (unsigned int i = 0; i < RECORDS; i++)
     GNUNET_free_nz ((void *) s_rd[i].data);
   GNUNET_free (s_rd);
@@ -144,6 +144,21 @@ test_with_type (struct GNUNET_IDENTITY_PrivateKey *privkey)
                                                  s_name,
                                                  &rd_decrypt_cb,
                                                  s_name));
+  /* the cached keys must match freshly derived ones */
+  GNUNET_GNSRECORD_set_key_cache_size (0);
+  GNUNET_GNSRECORD_query_from_public_key (&pubkey,
+                                          "testlabel",
+                                          &query_pub);
+  GNUNET_assert (0 == memcmp (&query_pub,
+                              &query_block,
+                              sizeof(struct GNUNET_HashCode)));
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_GNSRECORD_block_decrypt (block,
+                                                 &pubkey,
+                                                 s_name,
+                                                 &rd_decrypt_cb,
+                                                 s_name));
+  GNUNET_GNSRECORD_set_key_cache_size (1024);
   GNUNET_free (block);
 }
 
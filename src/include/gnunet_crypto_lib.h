@@ -814,6 +814,62 @@ GNUNET_CRYPTO_hmac (const struct GNUNET_CRYPTO_AuthKey *key,
                     struct GNUNET_HashCode *hmac);
 
 
+/**
+ * HMAC-SHA512 with a fixed key.  The inner and outer padded key
+ * blocks are hashed once when the context is initialized; every HMAC
+ * calculated with the context starts from a copy of that state.
+ */
+struct GNUNET_CRYPTO_HmacContext
+{
+  /**
+   * Inner and outer hash states after absorbing the padded key.
+   */
+  crypto_auth_hmacsha512_state state;
+};
+
+
+/**
+ * @ingroup hash
+ * Key an HMAC context.
+ *
+ * @param[out] hc context to initialize
+ * @param key secret key
+ * @param key_len secret key length
+ */
+void
+GNUNET_CRYPTO_hmac_context_init (struct GNUNET_CRYPTO_HmacContext *hc,
+                                 const void *key,
+                                 size_t key_len);
+
+
+/**
+ * @ingroup hash
+ * Calculate HMAC of a message (RFC 2104) with a keyed context.  The
+ * result is the same as #GNUNET_CRYPTO_hmac_raw() with the key of @a hc.
+ *
+ * @param hc keyed context, not modified
+ * @param plaintext input plaintext
+ * @param plaintext_len length of @a plaintext
+ * @param hmac where to store the hmac
+ */
+void
+GNUNET_CRYPTO_hmac_context_calculate (
+  const struct GNUNET_CRYPTO_HmacContext *hc,
+  const void *plaintext,
+  size_t plaintext_len,
+  struct GNUNET_HashCode *hmac);
+
+
+/**
+ * @ingroup hash
+ * Wipe the key material of an HMAC context.
+ *
+ * @param hc context to clear
+ */
+void
+GNUNET_CRYPTO_hmac_context_clear (struct GNUNET_CRYPTO_HmacContext *hc);
+
+
 /**
  * Function called once the hash computation over the
  * specified file has completed.
@@ -1155,6 +1211,81 @@ GNUNET_CRYPTO_kdf (void *result,
                    ...);
 
 
+/**
+ * #GNUNET_CRYPTO_kdf() with a fixed salt.  Useful if many keys are
+ * derived with the same salt, as the extraction HMAC is only keyed
+ * once.
+ */
+struct GNUNET_CRYPTO_KdfContext
+{
+  /**
+   * HMAC-SHA512 keyed with the salt, for the extraction phase.
+   */
+  struct GNUNET_CRYPTO_HmacContext xtr;
+};
+
+
+/**
+ * @ingroup hash
+ * @brief Initialize a KDF context for a salt
+ * @param[out] kc context to initialize
+ * @param xts salt
+ * @param xts_len length of @a xts
+ */
+void
+GNUNET_CRYPTO_kdf_context_init (struct GNUNET_CRYPTO_KdfContext *kc,
+                                const void *xts,
+                                size_t xts_len);
+
+
+/**
+ * @ingroup hash
+ * @brief Derive key, same result as #GNUNET_CRYPTO_kdf() with the salt of @a kc
+ * @param kc context with the salt, not modified
+ * @param result buffer for the derived key, allocated by caller
+ * @param out_len desired length of the derived key
+ * @param skm source key material
+ * @param skm_len length of @a skm
+ * @param ... void * & size_t pairs for context chunks, terminated by NULL
+ */
+void
+GNUNET_CRYPTO_kdf_context_derive (const struct GNUNET_CRYPTO_KdfContext *kc,
+                                  void *result,
+                                  size_t out_len,
+                                  const void *skm,
+                                  size_t skm_len,
+                                  ...);
+
+
+/**
+ * @ingroup hash
+ * @brief Derive key, same result as #GNUNET_CRYPTO_kdf_v() with the salt of @a kc
+ * @param kc context with the salt, not modified
+ * @param result buffer for the derived key, allocated by caller
+ * @param out_len desired length of the derived key
+ * @param skm source key material
+ * @param skm_len length of @a skm
+ * @param argp va_list of void * & size_t pairs for context chunks
+ */
+void
+GNUNET_CRYPTO_kdf_context_derive_v (const struct GNUNET_CRYPTO_KdfContext *kc,
+                                    void *result,
+                                    size_t out_len,
+                                    const void *skm,
+                                    size_t skm_len,
+                                    va_list argp);
+
+
+/**
+ * @ingroup hash
+ * Wipe the key material of a KDF context.
+ *
+ * @param kc context to clear
+ */
+void
+GNUNET_CRYPTO_kdf_context_clear (struct GNUNET_CRYPTO_KdfContext *kc);
+
+
 /**
  * @ingroup crypto
  * Extract the public key for the given private key.
@@ -1479,6 +1610,24 @@ GNUNET_CRYPTO_ecc_dlog_prepare (unsigned int max,
                                 unsigned int mem);
 
 
+/**
+ * Do pre-calculation for ECC discrete logarithm for small factors,
+ * keeping the pre-calculated values in a file.  If @a filename has
+ * the values for @a max and @a mem, they are mapped into memory
+ * instead of calculating them again; otherwise they are calculated
+ * and written to @a filename for the next time.
+ *
+ * @param max maximum value the factor can be
+ * @param mem memory to use (should be smaller than @a max), must not be zero.
+ * @param filename file with the pre-calculated values
+ * @return NULL on error
+ */
+struct GNUNET_CRYPTO_EccDlogContext *
+GNUNET_CRYPTO_ecc_dlog_prepare_file (unsigned int max,
+                                     unsigned int mem,
+                                     const char *filename);
+
+
 /**
  * Calculate ECC discrete logarithm for small factors.
  * Opposite of #GNUNET_CRYPTO_ecc_dexp().
@@ -2056,6 +2205,70 @@ GNUNET_CRYPTO_paillier_encrypt (
   struct GNUNET_CRYPTO_PaillierCiphertext *ciphertext);
 
 
+/**
+ * Pre-calculated values for encrypting many plaintexts with the same
+ * paillier public key.
+ */
+struct GNUNET_CRYPTO_PaillierContext;
+
+
+/**
+ * Create a context for encrypting many plaintexts with a paillier
+ * public key.
+ *
+ * @param public_key Public key to use.
+ * @return NULL if @a public_key is invalid
+ */
+struct GNUNET_CRYPTO_PaillierContext *
+GNUNET_CRYPTO_paillier_context_create (
+  const struct GNUNET_CRYPTO_PaillierPublicKey *public_key);
+
+
+/**
+ * Start calculating the randomness for @a count more encryptions
+ * with @a ctx in the background, so that a later
+ * #GNUNET_CRYPTO_paillier_encrypt_batch() is faster.
+ *
+ * @param ctx Context to calculate the randomness for.
+ * @param count Number of encryptions we expect.
+ */
+void
+GNUNET_CRYPTO_paillier_precompute (
+  struct GNUNET_CRYPTO_PaillierContext *ctx,
+  unsigned int count);
+
+
+/**
+ * Encrypt many plaintexts, using multiple threads and the randomness
+ * calculated by #GNUNET_CRYPTO_paillier_precompute().
+ *
+ * @param ctx Context of the public key to use.
+ * @param m Plaintexts to encrypt, must not be negative.
+ * @param count Number of plaintexts in @a m.
+ * @param desired_ops How many homomorphic ops the caller intends to use
+ * @param[out] ciphertexts Encryptions of @a m, @a count of them.
+ * @return guaranteed number of supported homomorphic operations of
+ *         all of @a ciphertexts, or desired_ops, in case that is lower
+ */
+int
+GNUNET_CRYPTO_paillier_encrypt_batch (
+  struct GNUNET_CRYPTO_PaillierContext *ctx,
+  const gcry_mpi_t *m,
+  unsigned int count,
+  int desired_ops,
+  struct GNUNET_CRYPTO_PaillierCiphertext *ciphertexts);
+
+
+/**
+ * Destroy a context for encrypting with a paillier public key.
+ *
+ * @param ctx Context to destroy.
+ */
+void
+GNUNET_CRYPTO_paillier_context_destroy (
+  struct GNUNET_CRYPTO_PaillierContext *ctx);
+
+
 /**
  * Decrypt a paillier ciphertext with a private key.
  *
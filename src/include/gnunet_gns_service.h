@@ -121,10 +121,103 @@ enum GNUNET_GNS_LocalOptions
    * For the rightmost label, only look in the cache (it
    * is our local namestore), for the others, the DHT is OK.
    */
-  GNUNET_GNS_LO_LOCAL_MASTER = 2
+  GNUNET_GNS_LO_LOCAL_MASTER = 2,
+
+  /**
+   * Flag that may be combined with any of the above: ask the
+   * service to report where the time of the lookup was spent,
+   * see #GNUNET_GNS_lookup_get_trace().
+   */
+  GNUNET_GNS_LO_TRACE = 4
 };
 
 
+/**
+ * Phases of a lookup the GNS service keeps timings for.
+ */
+enum GNUNET_GNS_LookupPhase
+{
+  /**
+   * Waiting for a block from the namecache.
+   */
+  GNUNET_GNS_PHASE_NAMECACHE = 0,
+
+  /**
+   * Waiting for a block from the DHT.
+   */
+  GNUNET_GNS_PHASE_DHT = 1,
+
+  /**
+   * Checking whether a zone was revoked.
+   */
+  GNUNET_GNS_PHASE_REVOCATION = 2,
+
+  /**
+   * Waiting for DNS, after a delegation to DNS or a CNAME
+   * pointing to a DNS name.
+   */
+  GNUNET_GNS_PHASE_DNS = 3,
+
+  /**
+   * Waiting for the VPN to allocate an address.
+   */
+  GNUNET_GNS_PHASE_VPN = 4,
+
+  /**
+   * Number of phases.
+   */
+  GNUNET_GNS_PHASE_MAX = 5
+};
+
+
+/**
+ * Where the GNS service spent the time of a lookup.
+ */
+struct GNUNET_GNS_LookupTrace
+{
+  /**
+   * Time between the service receiving the lookup and
+   * sending the result.
+   */
+  struct GNUNET_TIME_Relative total;
+
+  /**
+   * Time spent in each phase, summed over all labels of the name.
+   * Phases may overlap for lookups that joined an identical
+   * lookup that was already in progress.
+   */
+  struct GNUNET_TIME_Relative phase_time[GNUNET_GNS_PHASE_MAX];
+
+  /**
+   * How often the lookup entered each phase.
+   */
+  unsigned int phase_count[GNUNET_GNS_PHASE_MAX];
+
+  /**
+   * #GNUNET_YES if the result was taken from the result cache
+   * of the service.
+   */
+  int cache_hit;
+
+  /**
+   * #GNUNET_YES if the lookup waited for an identical lookup of
+   * another client instead of resolving the name itself.  The
+   * phases are then those of the other lookup.
+   */
+  int coalesced;
+};
+
+
+/**
+ * Get a human-readable name for a lookup phase.
+ *
+ * @param phase the phase
+ * @return name of the phase, e.g. "namecache"
+ */
+const char *
+GNUNET_GNS_phase_to_string (enum GNUNET_GNS_LookupPhase phase);
+
+
 /**
  * Perform an asynchronous lookup operation on the GNS.
  *
@@ -182,6 +275,18 @@ void *
 GNUNET_GNS_lookup_cancel (struct GNUNET_GNS_LookupRequest *lr);
 
 
+/**
+ * Get the trace of a lookup that was started with the
+ * #GNUNET_GNS_LO_TRACE option.  May only be called from
+ * within the result processor of the lookup.
+ *
+ * @param lr the lookup request
+ * @return the trace, NULL if the service did not provide one
+ */
+const struct GNUNET_GNS_LookupTrace *
+GNUNET_GNS_lookup_get_trace (const struct GNUNET_GNS_LookupRequest *lr);
+
+
 /**
  * Iterator called on obtained result for a GNS lookup
  * where "not GNS" is a valid answer.
@@ -231,6 +336,20 @@ void *
 GNUNET_GNS_lookup_with_tld_cancel (struct GNUNET_GNS_LookupWithTldRequest *ltr);
 
 
+/**
+ * Get the trace of a lookup that was started with the
+ * #GNUNET_GNS_LO_TRACE option.  May only be called from
+ * within the result processor of the lookup.
+ *
+ * @param ltr the lookup request
+ * @return the trace, NULL if the service did not provide one
+ *         (or no GNS lookup was made)
+ */
+const struct GNUNET_GNS_LookupTrace *
+GNUNET_GNS_lookup_with_tld_get_trace (
+  const struct GNUNET_GNS_LookupWithTldRequest *ltr);
+
+
 #if 0 /* keep Emacsens' auto-indent happy */
 {
 #endif
@@ -493,6 +493,19 @@ GNUNET_GNSRECORD_query_from_public_key (
   struct GNUNET_HashCode *query);
 
 
+/**
+ * Set for how many (zone, label) pairs the keys derived for
+ * DHT queries and block encryption are cached.  The cache is
+ * shared by #GNUNET_GNSRECORD_query_from_public_key(),
+ * #GNUNET_GNSRECORD_block_decrypt() and the block creation
+ * functions, so hot labels skip the elliptic curve derivation.
+ *
+ * @param size maximum number of cache entries, 0 to disable the cache
+ */
+void
+GNUNET_GNSRECORD_set_key_cache_size (unsigned int size);
+
+
 /**
  * Sign name and records
  *
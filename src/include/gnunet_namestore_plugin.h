@@ -150,6 +150,66 @@ struct GNUNET_NAMESTORE_PluginFunctions
                    const struct GNUNET_IDENTITY_PublicKey *value_zone,
                    GNUNET_NAMESTORE_RecordIterator iter,
                    void *iter_cls);
+
+
+  /**
+   * Iterate over the labels that changed after a given point in the
+   * change journal of the datastore.  For each label, the current
+   * records are returned (with an @a rd_count of zero if the label
+   * was deleted) together with the journal serial of its most recent
+   * change.  Will return at most @a limit results to the iterator.
+   *
+   * May be NULL if the plugin does not keep a change journal.
+   *
+   * @param cls closure (internal context for the plugin)
+   * @param zone private key of the zone, NULL for all zones
+   * @param since journal serial (to exclude); 0 to return all labels
+   *        in the journal; results must be returned ordered by serial
+   * @param limit maximum number of results to return to @a iter
+   * @param iter function to call with the result
+   * @param iter_cls closure for @a iter
+   * @return #GNUNET_OK on success, #GNUNET_NO if there were no more results, #GNUNET_SYSERR on error
+   */
+  int
+  (*iterate_changes) (void *cls,
+                      const struct GNUNET_IDENTITY_PrivateKey *zone,
+                      uint64_t since,
+                      uint64_t limit,
+                      GNUNET_NAMESTORE_RecordIterator iter,
+                      void *iter_cls);
+
+
+  /**
+   * Start a transaction, so that the following calls to
+   * @e store_records take effect together (or not at all).
+   *
+   * May be NULL if the plugin does not support transactions.
+   *
+   * @param cls closure (internal context for the plugin)
+   * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+   */
+  int
+  (*begin_transaction) (void *cls);
+
+
+  /**
+   * Commit the transaction started with @e begin_transaction.
+   *
+   * @param cls closure (internal context for the plugin)
+   * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+   */
+  int
+  (*commit_transaction) (void *cls);
+
+
+  /**
+   * Undo the transaction started with @e begin_transaction.
+   *
+   * @param cls closure (internal context for the plugin)
+   * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+   */
+  int
+  (*rollback_transaction) (void *cls);
 };
 
 
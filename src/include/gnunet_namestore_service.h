@@ -135,6 +135,61 @@ GNUNET_NAMESTORE_records_store (struct GNUNET_NAMESTORE_Handle *h,
                                 void *cont_cls);
 
 
+/**
+ * The records of one label, for #GNUNET_NAMESTORE_records_store_bulk().
+ */
+struct GNUNET_NAMESTORE_RecordInfo
+{
+  /**
+   * The label of the record set.
+   */
+  const char *a_label;
+
+  /**
+   * Number of records in @e a_rd, 0 to remove all records of the label.
+   */
+  unsigned int a_rd_count;
+
+  /**
+   * The records to store under @e a_label.
+   */
+  const struct GNUNET_GNSRECORD_Data *a_rd;
+};
+
+
+/**
+ * Store the records of several labels of a zone in the namestore,
+ * all in one database transaction.  If the database backend has no
+ * transactions, the labels stored before a failure remain stored
+ * (and monitors are told about them) even though @a cont reports
+ * the failure.  As many of the @a ri as fit into
+ * one message are sent; @a ri_sent tells how many that were, the
+ * caller should store the rest with another call once @a cont was
+ * called.  Otherwise like #GNUNET_NAMESTORE_records_store(), except
+ * that the namecache is updated in the background after @a cont was
+ * called.
+ *
+ * @param h handle to the namestore
+ * @param pkey private key of the zone
+ * @param ri_count number of entries in the @a ri array
+ * @param ri the labels and their records to store
+ * @param ri_sent[out] set to the number of @a ri that were sent
+ * @param cont continuation to call when done
+ * @param cont_cls closure for @a cont
+ * @return handle to abort the request, NULL if the first
+ *         entry of @a ri is malformed or too large
+ */
+struct GNUNET_NAMESTORE_QueueEntry *
+GNUNET_NAMESTORE_records_store_bulk (
+  struct GNUNET_NAMESTORE_Handle *h,
+  const struct GNUNET_IDENTITY_PrivateKey *pkey,
+  unsigned int ri_count,
+  const struct GNUNET_NAMESTORE_RecordInfo *ri,
+  unsigned int *ri_sent,
+  GNUNET_NAMESTORE_ContinuationWithStatus cont,
+  void *cont_cls);
+
+
 /**
  * Process a record that was stored in the namestore.
  *
@@ -255,6 +310,58 @@ GNUNET_NAMESTORE_zone_iteration_start (struct GNUNET_NAMESTORE_Handle *h,
                                        void *finish_cb_cls);
 
 
+/**
+ * Function called once an iteration over changes has completed.
+ *
+ * @param cls closure
+ * @param serial highest journal serial covered by the iteration; pass
+ *        it as @a since to the next #GNUNET_NAMESTORE_zone_changes_start().
+ *        Zero if the namestore keeps no change journal, in which case
+ *        the caller cannot know which labels changed
+ */
+typedef void
+(*GNUNET_NAMESTORE_ChangesFinishedCallback) (void *cls,
+                                             uint64_t serial);
+
+
+/**
+ * Starts a new iteration over the labels that changed since the
+ * journal serial @a since.  For each such label, @a proc is called
+ * with its current records (none if the label was deleted).  The
+ * iteration is otherwise handled just like one started with
+ * #GNUNET_NAMESTORE_zone_iteration_start(), using
+ * #GNUNET_NAMESTORE_zone_iterator_next() and
+ * #GNUNET_NAMESTORE_zone_iteration_stop().
+ *
+ * @param h handle to the namestore
+ * @param zone zone to access, NULL for all zones
+ * @param since journal serial to start after, 0 for all changes
+ *        the namestore remembers
+ * @param error_cb function to call on error (i.e. disconnect),
+ *        the handle is afterwards invalid
+ * @param error_cb_cls closure for @a error_cb
+ * @param proc function to call on each changed label; it
+ *        will be called repeatedly with a value (if available)
+ * @param proc_cls closure for @a proc
+ * @param finish_cb function to call on completion
+ *        the handle is afterwards invalid
+ * @param finish_cb_cls closure for @a finish_cb
+ * @return an iterator handle to use for iteration
+ */
+struct GNUNET_NAMESTORE_ZoneIterator *
+GNUNET_NAMESTORE_zone_changes_start (struct GNUNET_NAMESTORE_Handle *h,
+                                     const struct
+                                     GNUNET_IDENTITY_PrivateKey *zone,
+                                     uint64_t since,
+                                     GNUNET_SCHEDULER_TaskCallback error_cb,
+                                     void *error_cb_cls,
+                                     GNUNET_NAMESTORE_RecordMonitor proc,
+                                     void *proc_cls,
+                                     GNUNET_NAMESTORE_ChangesFinishedCallback
+                                     finish_cb,
+                                     void *finish_cb_cls);
+
+
 /**
  * Calls the record processor specified in #GNUNET_NAMESTORE_zone_iteration_start
  * for the next record.
@@ -1356,6 +1356,13 @@ extern "C" {
  */
 #define GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_ITERATION_START 445
 
+/**
+ * Client to service: please iterate over the labels that changed
+ * since a given journal serial; receives
+ * "GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_RESULT" messages in return.
+ */
+#define GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_CHANGES_START 446
+
 /**
  * Client to service: next record(s) in iteration please.
  */
@@ -1371,6 +1378,12 @@ extern "C" {
  */
 #define GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_RESULT_END 449
 
+/**
+ * Client to service: store the records of several labels; receives a
+ * #GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_STORE_RESPONSE in return.
+ */
+#define GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_STORE_BULK 453
+
 
 /*******************************************************************************
  * LOCKMANAGER message types
@@ -1571,6 +1584,12 @@ extern "C" {
  */
 #define GNUNET_MESSAGE_TYPE_GNS_LOOKUP_RESULT 501
 
+/**
+ * Service tells the client where the time of a lookup was spent;
+ * precedes the #GNUNET_MESSAGE_TYPE_GNS_LOOKUP_RESULT.
+ */
+#define GNUNET_MESSAGE_TYPE_GNS_LOOKUP_TRACE 502
+
 /**
  * Reverse lookup
  */
@@ -1790,6 +1809,25 @@ extern "C" {
 
 #define GNUNET_MESSAGE_TYPE_SETU_P2P_SEND_FULL 710
 
+/**
+ * Coded symbols of a rateless IBF.
+ */
+#define GNUNET_MESSAGE_TYPE_SETU_P2P_RATELESS_SYMBOLS 711
+
+/**
+ * Acknowledges coded symbols of a rateless IBF, and tells the
+ * sender whether to send more.
+ */
+#define GNUNET_MESSAGE_TYPE_SETU_P2P_RATELESS_ACK 712
+
+/**
+ * Request to start a set union with the rateless IBF protocol.  Same
+ * format as #GNUNET_MESSAGE_TYPE_SETU_P2P_OPERATION_REQUEST, only sent
+ * if the initiating client asked for the rateless protocol, as peers
+ * that do not support it drop the channel.
+ */
+#define GNUNET_MESSAGE_TYPE_SETU_P2P_OPERATION_REQUEST_RATELESS 713
+
 
 
 /*******************************************************************************
@@ -1849,6 +1887,8 @@ extern "C" {
 
 /**
  * Bloom filter message for intersection exchange started by Bob.
+ * Only sent by peers that do not partition their Bloom filters yet,
+ * see #GNUNET_MESSAGE_TYPE_SETI_P2P_BF_PARTITION.
  */
 #define GNUNET_MESSAGE_TYPE_SETI_P2P_BF 592
 
@@ -1862,6 +1902,13 @@ extern "C" {
  */
 #define GNUNET_MESSAGE_TYPE_SETI_P2P_OPERATION_REQUEST 594
 
+/**
+ * Bloom filter of one partition of the elements for the intersection
+ * exchange.  Replaces #GNUNET_MESSAGE_TYPE_SETI_P2P_BF, peers that only
+ * know that drop the channel.
+ */
+#define GNUNET_MESSAGE_TYPE_SETI_P2P_BF_PARTITION 714
+
 
 /*******************************************************************************
  * SET message types
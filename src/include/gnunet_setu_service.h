@@ -187,7 +187,17 @@ enum GNUNET_SETU_OptionType
    * This setting determines to how many IBF buckets an single elements
    * is mapped to.
    */
-    GNUNET_SETU_OPTION_CUSTOM_IBF_BUCKETS_PER_ELEMENT= 128
+    GNUNET_SETU_OPTION_CUSTOM_IBF_BUCKETS_PER_ELEMENT= 128,
+
+  /**
+   * Reconcile with a rateless IBF: the accepting peer streams coded
+   * symbols until the initiating peer has decoded the difference, so
+   * no strata estimator is exchanged and no IBF ever has to be resent.
+   * Only has an effect on the initiating peer, and only if the other
+   * peer supports the rateless protocol (older peers fail the
+   * operation).
+   */
+  GNUNET_SETU_OPTION_RATELESS = 256
 };
 
 
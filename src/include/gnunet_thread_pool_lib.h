@@ -0,0 +1,166 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2021 GNUnet e.V.
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+
+/**
+ * @file
+ * Pool of worker threads
+ *
+ * @defgroup thread_pool  Thread pool library
+ * Run CPU-heavy work in worker threads and continue in the
+ * scheduler once it is done.
+ *
+ * Jobs are started in the order in which they were submitted.  The
+ * work of a job runs in a worker thread and must not use the
+ * scheduler, logging or any other non-reentrant GNUnet API.  Its
+ * continuation (if any) is run by the scheduler in the main thread.
+ * All functions of this API must be called from the main thread.
+ * @{
+ */
+
+#ifndef GNUNET_THREAD_POOL_LIB_H
+#define GNUNET_THREAD_POOL_LIB_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#if 0                           /* keep Emacsens' auto-indent happy */
+}
+#endif
+#endif
+
+/**
+ * Handle for a pool of worker threads.
+ */
+struct GNUNET_THREAD_Pool;
+
+/**
+ * Handle for a job submitted to a pool.
+ */
+struct GNUNET_THREAD_Job;
+
+
+/**
+ * Work of a job, run in a worker thread.
+ *
+ * @param cls closure
+ */
+typedef void
+(*GNUNET_THREAD_JobWork) (void *cls);
+
+
+/**
+ * Continuation of a job, run in the main thread once the work is
+ * done.
+ *
+ * @param cls closure
+ */
+typedef void
+(*GNUNET_THREAD_JobDone) (void *cls);
+
+
+/**
+ * Create a pool of worker threads.  If fewer threads can be started
+ * than requested, the pool uses the ones it got.  A pool without any
+ * threads does the work of a job right when it is submitted.
+ *
+ * @param threads number of threads to start
+ * @return the pool
+ */
+struct GNUNET_THREAD_Pool *
+GNUNET_THREAD_pool_create (unsigned int threads);
+
+
+/**
+ * Get the number of worker threads of a pool.
+ *
+ * @param pool the pool
+ * @return number of threads of @a pool, 0 if it does the work itself
+ */
+unsigned int
+GNUNET_THREAD_pool_get_size (const struct GNUNET_THREAD_Pool *pool);
+
+
+/**
+ * Submit a job to a pool.  Once a worker thread ran @a work, @a done
+ * is run from the scheduler.  This is also the case for pools without
+ * threads.  The job handle is valid until @a done ran, or until it is
+ * passed to GNUNET_THREAD_pool_wait() or GNUNET_THREAD_pool_cancel().
+ *
+ * @param pool pool to run the job
+ * @param work work to do in a worker thread
+ * @param done continuation, NULL if the caller will wait for the
+ *        job with GNUNET_THREAD_pool_wait() (then the pool does
+ *        not need the scheduler)
+ * @param cls closure for @a work and @a done
+ * @return handle for the job
+ */
+struct GNUNET_THREAD_Job *
+GNUNET_THREAD_pool_submit (struct GNUNET_THREAD_Pool *pool,
+                           GNUNET_THREAD_JobWork work,
+                           GNUNET_THREAD_JobDone done,
+                           void *cls);
+
+
+/**
+ * Wait until the work of a job is done.  Then run its continuation
+ * (if any) right away and release the job.
+ *
+ * @param job the job to wait for
+ */
+void
+GNUNET_THREAD_pool_wait (struct GNUNET_THREAD_Job *job);
+
+
+/**
+ * Cancel a job.  Its continuation will not be run.  If a worker
+ * thread is doing the work of the job, wait for it to finish, so that
+ * the caller may release whatever state the job uses.
+ *
+ * @param job the job to cancel
+ */
+void
+GNUNET_THREAD_pool_cancel (struct GNUNET_THREAD_Job *job);
+
+
+/**
+ * Stop the worker threads of a pool and release it.  Jobs that are
+ * being worked on are finished first.  All jobs that are still
+ * outstanding are cancelled, their handles become invalid.  Must
+ * not be called from a continuation of a job of @a pool.
+ *
+ * @param pool the pool to destroy
+ */
+void
+GNUNET_THREAD_pool_destroy (struct GNUNET_THREAD_Pool *pool);
+
+
+#if 0                           /* keep Emacsens' auto-indent happy */
+{
+#endif
+#ifdef __cplusplus
+}
+#endif
+
+/* ifndef GNUNET_THREAD_POOL_LIB_H */
+#endif
+
+/** @} */  /* end of group */
+
+/* end of gnunet_thread_pool_lib.h */
@@ -50,7 +50,47 @@ extern "C"
 /**
  * Version number of the transport API.
  */
-#define GNUNET_TRANSPORT_MONITOR_VERSION 0x00000000
+#define GNUNET_TRANSPORT_MONITOR_VERSION 0x00000001
+
+
+/**
+ * Traffic classes TRANSPORT schedules between on each queue.  The
+ * class of a message is derived from its
+ * `enum GNUNET_MQ_PriorityPreferences`.
+ */
+enum GNUNET_TRANSPORT_TrafficClass
+{
+  /**
+   * Interactive traffic, i.e. messages with
+   * #GNUNET_MQ_PREF_LOW_LATENCY or critical control traffic.
+   */
+  GNUNET_TRANSPORT_TRAFFIC_LATENCY = 0,
+
+  /**
+   * Regular (best-effort and urgent) traffic.
+   */
+  GNUNET_TRANSPORT_TRAFFIC_RELIABILITY = 1,
+
+  /**
+   * Bulk and background traffic, i.e. messages with
+   * #GNUNET_MQ_PREF_GOODPUT or #GNUNET_MQ_PREF_CORK_ALLOWED.
+   */
+  GNUNET_TRANSPORT_TRAFFIC_BANDWIDTH = 2,
+
+  /**
+   * Number of traffic classes.
+   */
+  GNUNET_TRANSPORT_TRAFFIC_CLASS_COUNT = 3
+};
+
+
+/**
+ * Number of buckets in the per-class latency histograms.  Bucket
+ * @e i counts messages that were delayed by less than 2^i ms before
+ * they were given to the communicator, the last bucket counts all
+ * messages delayed for longer.
+ */
+#define GNUNET_TRANSPORT_MONITOR_LATENCY_BUCKETS 16
 
 
 /**
@@ -102,6 +142,13 @@ struct GNUNET_TRANSPORT_MonitorInformation
    * Current estimate of the RTT.
    */
   struct GNUNET_TIME_Relative rtt;
+
+  /**
+   * Histograms of how long messages of each traffic class waited
+   * for transmission on this @e address.
+   */
+  uint32_t latency_histogram[GNUNET_TRANSPORT_TRAFFIC_CLASS_COUNT][
+    GNUNET_TRANSPORT_MONITOR_LATENCY_BUCKETS];
 };
 
 
@@ -82,6 +82,7 @@ extern "C"
 #include "gnunet_service_lib.h"
 #include "gnunet_signal_lib.h"
 #include "gnunet_strings_lib.h"
+#include "gnunet_thread_pool_lib.h"
 #include "gnunet_tun_lib.h"
 #include "gnunet_dnsstub_lib.h"
 #include "gnunet_dnsparser_lib.h"
@@ -35,6 +35,7 @@
 #include "gnunet_signatures.h"
 #include "gnunet_namecache_service.h"
 #include "namecache.h"
+#include "namecache_mmap.h"
 
 
 #define LOG(kind, ...) GNUNET_log_from (kind, "namecache-api", __VA_ARGS__)
@@ -81,6 +82,17 @@ struct GNUNET_NAMECACHE_QueueEntry
    */
   void *block_proc_cls;
 
+  /**
+   * Task to return a result that we found in the memory-mapped
+   * database, NULL if the request went to the service.
+   */
+  struct GNUNET_SCHEDULER_Task *task;
+
+  /**
+   * Block found in the memory-mapped database, NULL for none.
+   */
+  struct GNUNET_GNSRECORD_Block *block;
+
   /**
    * The operation id this zone iteration operation has
    */
@@ -118,6 +130,27 @@ struct GNUNET_NAMECACHE_Handle
    */
   struct GNUNET_NAMECACHE_QueueEntry *op_tail;
 
+  /**
+   * Head of lookups answered from the memory-mapped database
+   */
+  struct GNUNET_NAMECACHE_QueueEntry *local_head;
+
+  /**
+   * Tail of lookups answered from the memory-mapped database
+   */
+  struct GNUNET_NAMECACHE_QueueEntry *local_tail;
+
+  /**
+   * Name of the database file if the service uses the "mmap"
+   * backend, which we can then read directly; NULL otherwise.
+   */
+  char *mmap_fn;
+
+  /**
+   * Our mapping of @e mmap_fn, NULL if not (yet) mapped.
+   */
+  struct NamecacheMmap *mmap;
+
   /**
    * Reconnect task
    */
@@ -407,6 +440,8 @@ GNUNET_NAMECACHE_connect (const struct GNUNET_CONFIGURATION_Handle *cfg)
 {
   struct GNUNET_NAMECACHE_Handle *h;
 
+  char *database = NULL;
+
   h = GNUNET_new (struct GNUNET_NAMECACHE_Handle);
   h->cfg = cfg;
   reconnect (h);
@@ -415,6 +450,20 @@ GNUNET_NAMECACHE_connect (const struct GNUNET_CONFIGURATION_Handle *cfg)
     GNUNET_free (h);
     return NULL;
   }
+  if ((GNUNET_OK ==
+       GNUNET_CONFIGURATION_get_value_string (cfg,
+                                              "namecache",
+                                              "DATABASE",
+                                              &database)) &&
+      (0 == strcasecmp (database,
+                        "mmap")) &&
+      (GNUNET_OK !=
+       GNUNET_CONFIGURATION_get_value_filename (cfg,
+                                                "namecache-mmap",
+                                                "FILENAME",
+                                                &h->mmap_fn)))
+    h->mmap_fn = NULL;
+  GNUNET_free (database);
   return h;
 }
 
@@ -438,6 +487,15 @@ GNUNET_NAMECACHE_disconnect (struct GNUNET_NAMECACHE_Handle *h)
                                  q);
     GNUNET_free (q);
   }
+  GNUNET_break (NULL == h->local_head);
+  while (NULL != (q = h->local_head))
+    GNUNET_NAMECACHE_cancel (q);
+  if (NULL != h->mmap)
+  {
+    NAMECACHE_mmap_close (h->mmap);
+    h->mmap = NULL;
+  }
+  GNUNET_free (h->mmap_fn);
   if (NULL != h->mq)
   {
     GNUNET_MQ_destroy (h->mq);
@@ -500,6 +558,68 @@ GNUNET_NAMECACHE_block_cache (struct GNUNET_NAMECACHE_Handle *h,
 }
 
 
+/**
+ * Return the result of a lookup that we answered from the
+ * memory-mapped database.
+ *
+ * @param cls the `struct GNUNET_NAMECACHE_QueueEntry`
+ */
+static void
+return_local_result (void *cls)
+{
+  struct GNUNET_NAMECACHE_QueueEntry *qe = cls;
+  struct GNUNET_NAMECACHE_Handle *h = qe->nsh;
+
+  qe->task = NULL;
+  GNUNET_CONTAINER_DLL_remove (h->local_head,
+                               h->local_tail,
+                               qe);
+  if (NULL != qe->block_proc)
+    qe->block_proc (qe->block_proc_cls,
+                    qe->block);
+  GNUNET_free (qe->block);
+  GNUNET_free (qe);
+}
+
+
+/**
+ * Look for the block under @a query in the memory-mapped database
+ * of the service, mapping it first if needed.
+ *
+ * @param h handle to the namecache
+ * @param query query to look for
+ * @param[out] block set to the block if one was found
+ * @return #GNUNET_YES if a block was found, #GNUNET_NO if the
+ *         database has no block, #GNUNET_SYSERR if we must ask
+ *         the service
+ */
+static enum GNUNET_GenericReturnValue
+lookup_mmap (struct GNUNET_NAMECACHE_Handle *h,
+             const struct GNUNET_HashCode *query,
+             struct GNUNET_GNSRECORD_Block **block)
+{
+  enum GNUNET_GenericReturnValue ret;
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    if (NULL == h->mmap)
+      h->mmap = NAMECACHE_mmap_open (h->mmap_fn,
+                                     GNUNET_NO);
+    if (NULL == h->mmap)
+      return GNUNET_SYSERR; /* not yet created by the service */
+    ret = NAMECACHE_mmap_lookup (h->mmap,
+                                 query,
+                                 block);
+    if (GNUNET_SYSERR != ret)
+      return ret;
+    /* the service may have replaced the file, map it again */
+    NAMECACHE_mmap_close (h->mmap);
+    h->mmap = NULL;
+  }
+  return GNUNET_SYSERR;
+}
+
+
 /**
  * Get a result for a particular key from the namecache.  The processor
  * will only be called once.
@@ -520,8 +640,30 @@ GNUNET_NAMECACHE_lookup_block (struct GNUNET_NAMECACHE_Handle *h,
   struct GNUNET_NAMECACHE_QueueEntry *qe;
   struct LookupBlockMessage *msg;
   struct GNUNET_MQ_Envelope *env;
+  struct GNUNET_GNSRECORD_Block *block;
   uint32_t rid;
 
+  if ((NULL != h->mmap_fn) &&
+      (GNUNET_SYSERR != lookup_mmap (h,
+                                     derived_hash,
+                                     &block)))
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "Found block under %s in the mapped database: %s\n",
+         GNUNET_h2s (derived_hash),
+         (NULL != block) ? "yes" : "no");
+    qe = GNUNET_new (struct GNUNET_NAMECACHE_QueueEntry);
+    qe->nsh = h;
+    qe->block_proc = proc;
+    qe->block_proc_cls = proc_cls;
+    qe->block = block;
+    GNUNET_CONTAINER_DLL_insert_tail (h->local_head,
+                                      h->local_tail,
+                                      qe);
+    qe->task = GNUNET_SCHEDULER_add_now (&return_local_result,
+                                         qe);
+    return qe;
+  }
   if (NULL == h->mq)
     return NULL;
   LOG (GNUNET_ERROR_TYPE_DEBUG,
@@ -557,6 +699,16 @@ GNUNET_NAMECACHE_cancel (struct GNUNET_NAMECACHE_QueueEntry *qe)
 {
   struct GNUNET_NAMECACHE_Handle *h = qe->nsh;
 
+  if (NULL != qe->task)
+  {
+    GNUNET_SCHEDULER_cancel (qe->task);
+    GNUNET_CONTAINER_DLL_remove (h->local_head,
+                                 h->local_tail,
+                                 qe);
+    GNUNET_free (qe->block);
+    GNUNET_free (qe);
+    return;
+  }
   GNUNET_CONTAINER_DLL_remove (h->op_head,
                                h->op_tail,
                                qe);
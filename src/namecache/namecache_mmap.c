@@ -0,0 +1,250 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2021 GNUnet e.V.
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+
+/**
+ * @file namecache/namecache_mmap.c
+ * @brief mapping of and lock-free lookups in the memory-mapped
+ *        namecache database
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "gnunet_gnsrecord_lib.h"
+#include "namecache_mmap.h"
+
+
+#define LOG(kind, ...) GNUNET_log_from (kind, "namecache-mmap", __VA_ARGS__)
+
+/**
+ * How often do we retry reading a slot that the writer is
+ * changing before we give up?
+ */
+#define MAX_READ_RETRIES 1024
+
+
+/**
+ * Offset of the hash table in the file.  Aligned to a cache line.
+ */
+#define SLOTS_OFFSET ((sizeof(struct NamecacheMmapHeader) + 63) & ~((size_t) 63))
+
+
+size_t
+NAMECACHE_mmap_file_size (uint32_t num_slots,
+                          uint64_t data_size)
+{
+  return SLOTS_OFFSET
+         + num_slots * sizeof(struct NamecacheMmapSlot)
+         + data_size;
+}
+
+
+enum GNUNET_GenericReturnValue
+NAMECACHE_mmap_setup (struct NamecacheMmap *m)
+{
+  const struct NamecacheMmapHeader *hdr = m->header;
+
+  if ((m->map_size < SLOTS_OFFSET) ||
+      (NAMECACHE_MMAP_MAGIC != hdr->magic) ||
+      (NAMECACHE_MMAP_VERSION != hdr->version) ||
+      (0 == hdr->num_slots) ||
+      (0 != (hdr->num_slots & (hdr->num_slots - 1))) ||
+      (0 != (hdr->data_size % 8)) ||
+      (m->map_size != NAMECACHE_mmap_file_size (hdr->num_slots,
+                                                hdr->data_size)))
+    return GNUNET_SYSERR;
+  m->slots = (struct NamecacheMmapSlot *) &((char *) m->header)[SLOTS_OFFSET];
+  m->data = (char *) &m->slots[hdr->num_slots];
+  return GNUNET_OK;
+}
+
+
+struct NamecacheMmap *
+NAMECACHE_mmap_open (const char *filename,
+                     int writable)
+{
+  struct NamecacheMmap *m;
+  off_t size;
+
+  m = GNUNET_new (struct NamecacheMmap);
+  m->fh = GNUNET_DISK_file_open (filename,
+                                 (GNUNET_YES == writable)
+                                 ? GNUNET_DISK_OPEN_READWRITE
+                                 : GNUNET_DISK_OPEN_READ,
+                                 GNUNET_DISK_PERM_NONE);
+  if (NULL == m->fh)
+  {
+    GNUNET_free (m);
+    return NULL;
+  }
+  if ((GNUNET_OK !=
+       GNUNET_DISK_file_handle_size (m->fh,
+                                     &size)) ||
+      (size < (off_t) SLOTS_OFFSET))
+  {
+    GNUNET_DISK_file_close (m->fh);
+    GNUNET_free (m);
+    return NULL;
+  }
+  m->map_size = (size_t) size;
+  m->header = GNUNET_DISK_file_map (m->fh,
+                                    &m->map,
+                                    (GNUNET_YES == writable)
+                                    ? GNUNET_DISK_MAP_TYPE_READWRITE
+                                    : GNUNET_DISK_MAP_TYPE_READ,
+                                    m->map_size);
+  if (NULL == m->header)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
+                              "mmap",
+                              filename);
+    GNUNET_DISK_file_close (m->fh);
+    GNUNET_free (m);
+    return NULL;
+  }
+  if (GNUNET_OK != NAMECACHE_mmap_setup (m))
+  {
+    LOG (GNUNET_ERROR_TYPE_WARNING,
+         "File `%s' is not a valid namecache database\n",
+         filename);
+    NAMECACHE_mmap_close (m);
+    return NULL;
+  }
+  return m;
+}
+
+
+void
+NAMECACHE_mmap_close (struct NamecacheMmap *m)
+{
+  if (NULL != m->map)
+    GNUNET_break (GNUNET_OK ==
+                  GNUNET_DISK_file_unmap (m->map));
+  if (NULL != m->fh)
+    GNUNET_break (GNUNET_OK ==
+                  GNUNET_DISK_file_close (m->fh));
+  GNUNET_free (m);
+}
+
+
+/**
+ * Read a consistent copy of a slot.
+ *
+ * @param slot slot in the mapping
+ * @param[out] copy where to copy the slot to
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the writer
+ *         kept changing the slot
+ */
+static enum GNUNET_GenericReturnValue
+read_slot (const struct NamecacheMmapSlot *slot,
+           struct NamecacheMmapSlot *copy)
+{
+  for (unsigned int i = 0; i < MAX_READ_RETRIES; i++)
+  {
+    copy->seq = __atomic_load_n (&slot->seq,
+                                 __ATOMIC_ACQUIRE);
+    if (0 != (copy->seq & 1))
+      continue; /* writer is busy with this slot */
+    GNUNET_memcpy (&copy->query,
+                   &slot->query,
+                   sizeof(copy->query));
+    copy->expiration = slot->expiration;
+    copy->offset = slot->offset;
+    copy->size = slot->size;
+    copy->state = slot->state;
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    if (copy->seq == __atomic_load_n (&slot->seq,
+                                      __ATOMIC_RELAXED))
+      return GNUNET_OK;
+  }
+  return GNUNET_SYSERR;
+}
+
+
+enum GNUNET_GenericReturnValue
+NAMECACHE_mmap_lookup (const struct NamecacheMmap *m,
+                       const struct GNUNET_HashCode *query,
+                       struct GNUNET_GNSRECORD_Block **block)
+{
+  const struct NamecacheMmapHeader *hdr = m->header;
+  uint32_t mask = hdr->num_slots - 1;
+  uint32_t idx;
+  unsigned int retries = 0;
+
+  *block = NULL;
+  if (0 != __atomic_load_n (&hdr->stale,
+                            __ATOMIC_ACQUIRE))
+    return GNUNET_SYSERR;
+  GNUNET_memcpy (&idx,
+                 query,
+                 sizeof(idx));
+  for (uint32_t i = 0; i < hdr->num_slots; i++)
+  {
+    const struct NamecacheMmapSlot *slot = &m->slots[(idx + i) & mask];
+    struct NamecacheMmapSlot copy;
+    struct GNUNET_GNSRECORD_Block *b;
+
+    if (GNUNET_OK != read_slot (slot,
+                                &copy))
+      return GNUNET_SYSERR;
+    if (NAMECACHE_MMAP_SLOT_EMPTY == copy.state)
+      return GNUNET_NO;
+    if ((NAMECACHE_MMAP_SLOT_USED != copy.state) ||
+        (0 != GNUNET_memcmp (&copy.query,
+                             query)))
+      continue;
+    if (copy.expiration < GNUNET_TIME_absolute_get ().abs_value_us)
+      return GNUNET_NO; /* expired, the writer will drop it */
+    if ((copy.offset > hdr->data_size) ||
+        (sizeof(struct NamecacheMmapRecord) + (uint64_t) copy.size
+         > hdr->data_size - copy.offset))
+    {
+      GNUNET_break (0);
+      return GNUNET_SYSERR;
+    }
+    b = GNUNET_malloc (copy.size);
+    GNUNET_memcpy (b,
+                   &m->data[copy.offset
+                            + sizeof(struct NamecacheMmapRecord)],
+                   copy.size);
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    if (copy.seq != __atomic_load_n (&slot->seq,
+                                     __ATOMIC_RELAXED))
+    {
+      /* block was replaced while we copied it, read the slot again */
+      GNUNET_free (b);
+      if (++retries > MAX_READ_RETRIES)
+        return GNUNET_SYSERR;
+      i--;
+      continue;
+    }
+    if ((copy.size < sizeof(struct GNUNET_GNSRECORD_Block)) ||
+        (GNUNET_GNSRECORD_block_get_size (b) != copy.size))
+    {
+      GNUNET_break (0);
+      GNUNET_free (b);
+      return GNUNET_SYSERR;
+    }
+    *block = b;
+    return GNUNET_YES;
+  }
+  return GNUNET_NO;
+}
+
+
+/* end of namecache_mmap.c */
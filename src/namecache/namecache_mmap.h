@@ -0,0 +1,289 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2021 GNUnet e.V.
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+
+/**
+ * @file namecache/namecache_mmap.h
+ * @brief layout of the memory-mapped namecache database, shared
+ *        between the "mmap" plugin (the only writer) and the
+ *        namecache API (which reads it without asking the service)
+ *
+ * The file starts with a `struct NamecacheMmapHeader`, followed by
+ * an open-addressing hash table of `struct NamecacheMmapSlot`s and
+ * the data area.  The data area is a ring buffer of records, each
+ * a `struct NamecacheMmapRecord` followed by the block.  When the
+ * ring is full, the oldest records are dropped.
+ *
+ * Readers do not take locks.  Every slot carries a sequence number
+ * which the writer makes odd while it changes the slot.  The writer
+ * removes the slot pointing to a record before it overwrites the
+ * record, so a reader that sees the same even sequence number before
+ * and after copying a block knows the copy is consistent.
+ */
+#ifndef NAMECACHE_MMAP_H
+#define NAMECACHE_MMAP_H
+
+#include "gnunet_util_lib.h"
+#include "gnunet_gnsrecord_lib.h"
+
+/**
+ * Magic number at the beginning of the file ("GNSC").
+ */
+#define NAMECACHE_MMAP_MAGIC 0x47534e43
+
+/**
+ * Version of the file layout.
+ */
+#define NAMECACHE_MMAP_VERSION 1
+
+/**
+ * Slot has never been used; ends the probe sequence.
+ */
+#define NAMECACHE_MMAP_SLOT_EMPTY 0
+
+/**
+ * Slot contains a block.
+ */
+#define NAMECACHE_MMAP_SLOT_USED 1
+
+/**
+ * Slot contained a block that was removed; probing continues.
+ */
+#define NAMECACHE_MMAP_SLOT_DELETED 2
+
+/**
+ * Value of `struct NamecacheMmapRecord.slot` for padding records.
+ */
+#define NAMECACHE_MMAP_NO_SLOT UINT32_MAX
+
+
+/**
+ * Header of the database file.  The file is only used on the
+ * local host, so all values are in host byte order.
+ */
+struct NamecacheMmapHeader
+{
+  /**
+   * Must be #NAMECACHE_MMAP_MAGIC; written last when the file is
+   * created.
+   */
+  uint32_t magic;
+
+  /**
+   * Must be #NAMECACHE_MMAP_VERSION.
+   */
+  uint32_t version;
+
+  /**
+   * Number of slots in the hash table, a power of two.
+   */
+  uint32_t num_slots;
+
+  /**
+   * Set to 1 by the writer when it replaced the file with a new
+   * one; readers must then map the file again.
+   */
+  uint32_t stale;
+
+  /**
+   * Size of the data area in bytes.
+   */
+  uint64_t data_size;
+
+  /**
+   * Offset in the data area where the next record is written.
+   * Only used by the writer.
+   */
+  uint64_t head;
+
+  /**
+   * Offset of the oldest record in the data area.  Only used by
+   * the writer.
+   */
+  uint64_t tail;
+
+  /**
+   * Number of bytes in the data area used by records.  Only used
+   * by the writer.
+   */
+  uint64_t used_bytes;
+
+  /**
+   * Number of slots in state #NAMECACHE_MMAP_SLOT_USED.  Only used
+   * by the writer.
+   */
+  uint64_t used_slots;
+};
+
+
+/**
+ * Slot of the hash table, maps a query to a record.
+ */
+struct NamecacheMmapSlot
+{
+  /**
+   * Sequence number, odd while the writer changes the slot.
+   */
+  uint64_t seq;
+
+  /**
+   * Query hash of the block.
+   */
+  struct GNUNET_HashCode query;
+
+  /**
+   * Expiration time of the block, so that readers can skip
+   * expired blocks without copying them.
+   */
+  uint64_t expiration;
+
+  /**
+   * Offset of the record in the data area.
+   */
+  uint64_t offset;
+
+  /**
+   * Size of the block (without the record header).
+   */
+  uint32_t size;
+
+  /**
+   * One of the NAMECACHE_MMAP_SLOT_* values.
+   */
+  uint32_t state;
+};
+
+
+/**
+ * Header of a record in the data area, followed by the block.
+ */
+struct NamecacheMmapRecord
+{
+  /**
+   * Size of the record including this header and padding to a
+   * multiple of 8 bytes.
+   */
+  uint32_t size;
+
+  /**
+   * Index of the slot that was created for this record, or
+   * #NAMECACHE_MMAP_NO_SLOT for padding at the end of the ring.
+   */
+  uint32_t slot;
+};
+
+
+/**
+ * Handle to a mapped namecache database.
+ */
+struct NamecacheMmap
+{
+  /**
+   * File we mapped.
+   */
+  struct GNUNET_DISK_FileHandle *fh;
+
+  /**
+   * Mapping of the file.
+   */
+  struct GNUNET_DISK_MapHandle *map;
+
+  /**
+   * Header at the beginning of the mapping.
+   */
+  struct NamecacheMmapHeader *header;
+
+  /**
+   * Hash table, `header->num_slots` entries.
+   */
+  struct NamecacheMmapSlot *slots;
+
+  /**
+   * Start of the data area, `header->data_size` bytes.
+   */
+  char *data;
+
+  /**
+   * Size of the mapping.
+   */
+  size_t map_size;
+};
+
+
+/**
+ * Compute the size of a database file.
+ *
+ * @param num_slots number of slots in the hash table
+ * @param data_size size of the data area
+ * @return size of the file in bytes
+ */
+size_t
+NAMECACHE_mmap_file_size (uint32_t num_slots,
+                          uint64_t data_size);
+
+
+/**
+ * Map an existing database file.
+ *
+ * @param filename name of the file
+ * @param writable #GNUNET_YES to map it for writing
+ * @return NULL if the file does not exist or is not a valid database
+ */
+struct NamecacheMmap *
+NAMECACHE_mmap_open (const char *filename,
+                     int writable);
+
+
+/**
+ * Set up the pointers of @a m after the mapping was established.
+ *
+ * @param m the mapping, with @e map_size and the header set
+ * @return #GNUNET_OK if the header is consistent with the mapping
+ */
+enum GNUNET_GenericReturnValue
+NAMECACHE_mmap_setup (struct NamecacheMmap *m);
+
+
+/**
+ * Unmap a database file.
+ *
+ * @param m mapping to release
+ */
+void
+NAMECACHE_mmap_close (struct NamecacheMmap *m);
+
+
+/**
+ * Find the block for @a query.  Does not take any locks and may
+ * be called while another process changes the database.
+ *
+ * @param m the mapped database
+ * @param query query hash to look for
+ * @param[out] block set to a copy of the block (to be freed by the
+ *             caller) if one was found
+ * @return #GNUNET_YES if a block was found, #GNUNET_NO if not,
+ *         #GNUNET_SYSERR if the mapping is stale or corrupt
+ */
+enum GNUNET_GenericReturnValue
+NAMECACHE_mmap_lookup (const struct NamecacheMmap *m,
+                       const struct GNUNET_HashCode *query,
+                       struct GNUNET_GNSRECORD_Block **block);
+
+
+#endif
@@ -327,6 +327,7 @@ namecache_cache_block (void *cls,
   entry = GNUNET_malloc (sizeof(struct FlatFileEntry));
   entry->block = GNUNET_malloc (block_size);
   GNUNET_memcpy (entry->block, block, block_size);
+  entry->query = query;
   GNUNET_CONTAINER_multihashmap_remove_all (plugin->hm, &query);
   if (GNUNET_OK !=
       GNUNET_CONTAINER_multihashmap_put (plugin->hm,
@@ -361,15 +362,15 @@ namecache_lookup_block (void *cls,
                         GNUNET_NAMECACHE_BlockCallback iter, void *iter_cls)
 {
   struct Plugin *plugin = cls;
-  const struct GNUNET_GNSRECORD_Block *block;
+  const struct FlatFileEntry *entry;
 
-  block = GNUNET_CONTAINER_multihashmap_get (plugin->hm, query);
-  if (NULL == block)
+  entry = GNUNET_CONTAINER_multihashmap_get (plugin->hm, query);
+  if (NULL == entry)
     return GNUNET_NO;
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Found block under derived key `%s'\n",
               GNUNET_h2s_full (query));
-  iter (iter_cls, block);
+  iter (iter_cls, entry->block);
   return GNUNET_YES;
 }
 
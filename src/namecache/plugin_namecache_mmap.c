@@ -0,0 +1,684 @@
+/*
+ * This file is part of GNUnet
+ * Copyright (C) 2021 GNUnet e.V.
+ *
+ * GNUnet is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * GNUnet is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    SPDX-License-Identifier: AGPL3.0-or-later
+ */
+
+/**
+ * @file namecache/plugin_namecache_mmap.c
+ * @brief namecache backend in a memory-mapped file, which the
+ *        namecache API of other processes reads directly
+ */
+
+#include "platform.h"
+#include "gnunet_namecache_plugin.h"
+#include "gnunet_namecache_service.h"
+#include "gnunet_gnsrecord_lib.h"
+#include "namecache.h"
+#include "namecache_mmap.h"
+
+/**
+ * Default number of blocks we can cache.
+ */
+#define DEFAULT_CAPACITY 65536
+
+/**
+ * Default size of the data area.
+ */
+#define DEFAULT_DATA_SIZE (64 * 1024 * 1024)
+
+/**
+ * How many slots do we check for expired blocks whenever we
+ * cache a block?
+ */
+#define EXPIRE_BATCH 16
+
+
+/**
+ * Context for all functions in this plugin.
+ */
+struct Plugin
+{
+  const struct GNUNET_CONFIGURATION_Handle *cfg;
+
+  /**
+   * Database filename.
+   */
+  char *fn;
+
+  /**
+   * Our mapping of the database.
+   */
+  struct NamecacheMmap *m;
+
+  /**
+   * Maximum number of blocks in the database.
+   */
+  unsigned long long capacity;
+
+  /**
+   * Next slot to check for expired blocks.
+   */
+  uint32_t expire_pos;
+};
+
+
+/**
+ * Mark @a slot as being changed by the writer.
+ *
+ * @param slot slot to change
+ */
+static void
+slot_begin_write (struct NamecacheMmapSlot *slot)
+{
+  __atomic_store_n (&slot->seq,
+                    slot->seq + 1,
+                    __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+
+/**
+ * Mark @a slot as consistent again.
+ *
+ * @param slot slot that was changed
+ */
+static void
+slot_end_write (struct NamecacheMmapSlot *slot)
+{
+  __atomic_store_n (&slot->seq,
+                    slot->seq + 1,
+                    __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Remove the block in @a slot from the hash table.
+ *
+ * @param plugin the plugin
+ * @param slot slot to clear
+ */
+static void
+delete_slot (struct Plugin *plugin,
+             struct NamecacheMmapSlot *slot)
+{
+  struct NamecacheMmap *m = plugin->m;
+  uint32_t mask = m->header->num_slots - 1;
+  uint32_t idx = (uint32_t) (slot - m->slots);
+
+  slot_begin_write (slot);
+  slot->state = NAMECACHE_MMAP_SLOT_DELETED;
+  slot_end_write (slot);
+  m->header->used_slots--;
+  /* no probe sequence can continue past an empty slot, so the
+     deleted slots right before one can become empty, too; this
+     keeps lookups of missing queries short */
+  if (NAMECACHE_MMAP_SLOT_EMPTY != m->slots[(idx + 1) & mask].state)
+    return;
+  while (NAMECACHE_MMAP_SLOT_DELETED == m->slots[idx].state)
+  {
+    slot = &m->slots[idx];
+    slot_begin_write (slot);
+    slot->state = NAMECACHE_MMAP_SLOT_EMPTY;
+    slot_end_write (slot);
+    idx = (idx - 1) & mask;
+  }
+}
+
+
+/**
+ * Drop the oldest record in the data area.
+ *
+ * @param plugin the plugin
+ */
+static void
+evict_oldest (struct Plugin *plugin)
+{
+  struct NamecacheMmap *m = plugin->m;
+  struct NamecacheMmapHeader *hdr = m->header;
+  const struct NamecacheMmapRecord *rec;
+
+  GNUNET_assert (0 != hdr->used_bytes);
+  rec = (const struct NamecacheMmapRecord *) &m->data[hdr->tail];
+  if (NAMECACHE_MMAP_NO_SLOT != rec->slot)
+  {
+    struct NamecacheMmapSlot *slot = &m->slots[rec->slot];
+
+    /* the slot may have been reused for a newer block */
+    if ((NAMECACHE_MMAP_SLOT_USED == slot->state) &&
+        (hdr->tail == slot->offset))
+      delete_slot (plugin,
+                   slot);
+  }
+  hdr->used_bytes -= rec->size;
+  hdr->tail += rec->size;
+  if (hdr->tail == hdr->data_size)
+    hdr->tail = 0;
+}
+
+
+/**
+ * Make room for a record of @a rec_size bytes at the head of the
+ * data area, dropping old records as needed.
+ *
+ * @param plugin the plugin
+ * @param rec_size size of the record
+ */
+static void
+make_room (struct Plugin *plugin,
+           uint64_t rec_size)
+{
+  struct NamecacheMmap *m = plugin->m;
+  struct NamecacheMmapHeader *hdr = m->header;
+
+  for (;;)
+  {
+    if (0 == hdr->used_bytes)
+      hdr->head = hdr->tail = 0;
+    if ((0 == hdr->used_bytes) ||
+        (hdr->head > hdr->tail))
+    {
+      struct NamecacheMmapRecord *pad;
+
+      /* live records are in [tail, head) */
+      if (hdr->data_size - hdr->head >= rec_size)
+        return;
+      /* not enough room at the end, pad and wrap around */
+      if (hdr->data_size > hdr->head)
+      {
+        pad = (struct NamecacheMmapRecord *) &m->data[hdr->head];
+        pad->size = (uint32_t) (hdr->data_size - hdr->head);
+        pad->slot = NAMECACHE_MMAP_NO_SLOT;
+        hdr->used_bytes += pad->size;
+      }
+      hdr->head = 0;
+      continue;
+    }
+    /* live records wrap around, free space is [head, tail) */
+    if (hdr->tail - hdr->head >= rec_size)
+      return;
+    evict_oldest (plugin);
+  }
+}
+
+
+/**
+ * Drop expired blocks from some slots, continuing where we
+ * stopped the last time.
+ *
+ * @param plugin the plugin
+ */
+static void
+expire_blocks (struct Plugin *plugin)
+{
+  struct NamecacheMmap *m = plugin->m;
+  uint64_t now = GNUNET_TIME_absolute_get ().abs_value_us;
+  uint32_t mask = m->header->num_slots - 1;
+
+  for (unsigned int i = 0; i < EXPIRE_BATCH; i++)
+  {
+    struct NamecacheMmapSlot *slot = &m->slots[plugin->expire_pos];
+
+    plugin->expire_pos = (plugin->expire_pos + 1) & mask;
+    if ((NAMECACHE_MMAP_SLOT_USED == slot->state) &&
+        (slot->expiration < now))
+      delete_slot (plugin,
+                   slot);
+  }
+}
+
+
+/**
+ * Find the slot for @a query in the hash table.
+ *
+ * @param plugin the plugin
+ * @param query query to look for
+ * @param[out] free_slot set to the first slot on the probe sequence
+ *             that can take a new block (NULL if there is none)
+ * @return slot with the block for @a query, NULL if there is none
+ */
+static struct NamecacheMmapSlot *
+find_slot (struct Plugin *plugin,
+           const struct GNUNET_HashCode *query,
+           struct NamecacheMmapSlot **free_slot)
+{
+  struct NamecacheMmap *m = plugin->m;
+  uint32_t mask = m->header->num_slots - 1;
+  uint32_t idx;
+
+  GNUNET_memcpy (&idx,
+                 query,
+                 sizeof(idx));
+  *free_slot = NULL;
+  for (uint32_t i = 0; i < m->header->num_slots; i++)
+  {
+    struct NamecacheMmapSlot *pos = &m->slots[(idx + i) & mask];
+
+    if (NAMECACHE_MMAP_SLOT_EMPTY == pos->state)
+    {
+      if (NULL == *free_slot)
+        *free_slot = pos;
+      return NULL;
+    }
+    if (NAMECACHE_MMAP_SLOT_DELETED == pos->state)
+    {
+      if (NULL == *free_slot)
+        *free_slot = pos;
+      continue;
+    }
+    if (0 == GNUNET_memcmp (&pos->query,
+                            query))
+      return pos;
+  }
+  return NULL;
+}
+
+
+/**
+ * Create a new, empty database file.  The file is created under
+ * a temporary name and then renamed, so that readers never see
+ * a partially initialized database.
+ *
+ * @param plugin the plugin
+ * @param num_slots size of the hash table
+ * @param data_size size of the data area
+ * @return #GNUNET_OK on success
+ */
+static enum GNUNET_GenericReturnValue
+create_database (struct Plugin *plugin,
+                 uint32_t num_slots,
+                 uint64_t data_size)
+{
+  struct GNUNET_DISK_FileHandle *fh;
+  char *tmp;
+  size_t size;
+
+  size = NAMECACHE_mmap_file_size (num_slots,
+                                   data_size);
+  GNUNET_asprintf (&tmp,
+                   "%s.tmp",
+                   plugin->fn);
+  fh = GNUNET_DISK_file_open (tmp,
+                              GNUNET_DISK_OPEN_CREATE
+                              | GNUNET_DISK_OPEN_TRUNCATE
+                              | GNUNET_DISK_OPEN_READWRITE,
+                              GNUNET_DISK_PERM_USER_WRITE
+                              | GNUNET_DISK_PERM_USER_READ
+                              | GNUNET_DISK_PERM_GROUP_READ);
+  if (NULL == fh)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                _ ("Unable to initialize file: %s.\n"),
+                tmp);
+    GNUNET_free (tmp);
+    return GNUNET_SYSERR;
+  }
+  /* the file is sparse, the kernel zero-fills the pages */
+  if (0 != ftruncate (fh->fd,
+                      (off_t) size))
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "ftruncate",
+                              tmp);
+    GNUNET_DISK_file_close (fh);
+    GNUNET_free (tmp);
+    return GNUNET_SYSERR;
+  }
+  plugin->m = GNUNET_new (struct NamecacheMmap);
+  plugin->m->fh = fh;
+  plugin->m->map_size = size;
+  plugin->m->header = GNUNET_DISK_file_map (fh,
+                                            &plugin->m->map,
+                                            GNUNET_DISK_MAP_TYPE_READWRITE,
+                                            size);
+  if (NULL == plugin->m->header)
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "mmap",
+                              tmp);
+    NAMECACHE_mmap_close (plugin->m);
+    plugin->m = NULL;
+    GNUNET_free (tmp);
+    return GNUNET_SYSERR;
+  }
+  plugin->m->header->version = NAMECACHE_MMAP_VERSION;
+  plugin->m->header->num_slots = num_slots;
+  plugin->m->header->data_size = data_size;
+  plugin->m->header->magic = NAMECACHE_MMAP_MAGIC;
+  GNUNET_assert (GNUNET_OK ==
+                 NAMECACHE_mmap_setup (plugin->m));
+  if (0 != rename (tmp,
+                   plugin->fn))
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "rename",
+                              plugin->fn);
+    NAMECACHE_mmap_close (plugin->m);
+    plugin->m = NULL;
+    GNUNET_free (tmp);
+    return GNUNET_SYSERR;
+  }
+  GNUNET_free (tmp);
+  return GNUNET_OK;
+}
+
+
+/**
+ * Drop blocks from slots that we were changing when we crashed,
+ * as readers would never accept them.
+ *
+ * @param plugin the plugin
+ */
+static void
+repair_slots (struct Plugin *plugin)
+{
+  struct NamecacheMmap *m = plugin->m;
+
+  for (uint32_t i = 0; i < m->header->num_slots; i++)
+  {
+    struct NamecacheMmapSlot *slot = &m->slots[i];
+
+    if (0 == (slot->seq & 1))
+      continue;
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                "Dropping block that was being written on shutdown\n");
+    if (NAMECACHE_MMAP_SLOT_USED == slot->state)
+      m->header->used_slots--;
+    slot->state = NAMECACHE_MMAP_SLOT_DELETED;
+    slot_end_write (slot);
+  }
+}
+
+
+/**
+ * Initialize the database, reusing an existing file if it matches
+ * our configuration.
+ *
+ * @param plugin the plugin context (state for this module)
+ * @return #GNUNET_OK on success
+ */
+static enum GNUNET_GenericReturnValue
+database_setup (struct Plugin *plugin)
+{
+  char *afsdir;
+  unsigned long long data_size;
+  uint32_t num_slots;
+
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_filename (plugin->cfg,
+                                               "namecache-mmap",
+                                               "FILENAME",
+                                               &afsdir))
+  {
+    GNUNET_log_config_missing (GNUNET_ERROR_TYPE_ERROR,
+                               "namecache-mmap", "FILENAME");
+    return GNUNET_SYSERR;
+  }
+  if (GNUNET_OK != GNUNET_DISK_directory_create_for_file (afsdir))
+  {
+    GNUNET_break (0);
+    GNUNET_free (afsdir);
+    return GNUNET_SYSERR;
+  }
+  plugin->fn = afsdir;
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (plugin->cfg,
+                                             "namecache-mmap",
+                                             "CAPACITY",
+                                             &plugin->capacity))
+    plugin->capacity = DEFAULT_CAPACITY;
+  if ((0 == plugin->capacity) ||
+      (plugin->capacity > UINT32_MAX / 4))
+  {
+    GNUNET_log_config_invalid (GNUNET_ERROR_TYPE_ERROR,
+                               "namecache-mmap",
+                               "CAPACITY",
+                               _ ("out of range"));
+    return GNUNET_SYSERR;
+  }
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_size (plugin->cfg,
+                                           "namecache-mmap",
+                                           "SIZE",
+                                           &data_size))
+    data_size = DEFAULT_DATA_SIZE;
+  data_size &= ~7LLU;
+  if (data_size < 2 * GNUNET_MAX_MESSAGE_SIZE)
+    data_size = 2 * GNUNET_MAX_MESSAGE_SIZE;
+  /* keep the hash table at most half full */
+  num_slots = 1;
+  while (num_slots < 2 * plugin->capacity)
+    num_slots *= 2;
+  plugin->m = NAMECACHE_mmap_open (afsdir,
+                                   GNUNET_YES);
+  if (NULL != plugin->m)
+  {
+    if ((plugin->m->header->num_slots == num_slots) &&
+        (plugin->m->header->data_size == data_size))
+    {
+      repair_slots (plugin);
+      return GNUNET_OK;
+    }
+    GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+                "Configuration of `%s' changed, creating new database\n",
+                afsdir);
+    /* tell readers to map the new file */
+    __atomic_store_n (&plugin->m->header->stale,
+                      1,
+                      __ATOMIC_RELEASE);
+    NAMECACHE_mmap_close (plugin->m);
+    plugin->m = NULL;
+  }
+  return create_database (plugin,
+                          num_slots,
+                          data_size);
+}
+
+
+/**
+ * Shutdown database connection and associate data
+ * structures.
+ *
+ * @param plugin the plugin context (state for this module)
+ */
+static void
+database_shutdown (struct Plugin *plugin)
+{
+  if (NULL != plugin->m)
+  {
+    GNUNET_break (GNUNET_OK ==
+                  GNUNET_DISK_file_sync (plugin->m->fh));
+    NAMECACHE_mmap_close (plugin->m);
+    plugin->m = NULL;
+  }
+  GNUNET_free (plugin->fn);
+}
+
+
+/**
+ * Cache a block in the datastore.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @param block block to cache
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+namecache_cache_block (void *cls,
+                       const struct GNUNET_GNSRECORD_Block *block)
+{
+  struct Plugin *plugin = cls;
+  struct NamecacheMmap *m = plugin->m;
+  struct NamecacheMmapHeader *hdr = m->header;
+  struct GNUNET_HashCode query;
+  struct NamecacheMmapRecord *rec;
+  struct NamecacheMmapSlot *slot;
+  struct NamecacheMmapSlot *free_slot;
+  struct GNUNET_TIME_Absolute expiration;
+  uint64_t rec_size;
+  size_t block_size;
+
+  block_size = GNUNET_GNSRECORD_block_get_size (block);
+  rec_size = (sizeof(struct NamecacheMmapRecord) + block_size + 7) & ~7LLU;
+  if ((0 == block_size) ||
+      (rec_size > hdr->data_size / 2))
+  {
+    GNUNET_break (0);
+    return GNUNET_SYSERR;
+  }
+  GNUNET_GNSRECORD_query_from_block (block,
+                                     &query);
+  expiration = GNUNET_GNSRECORD_block_get_expiration (block);
+  slot = find_slot (plugin,
+                    &query,
+                    &free_slot);
+  if ((NULL != slot) &&
+      (slot->expiration > expiration.abs_value_us))
+  {
+    /* like the other backends, keep the block that expires last */
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Keeping newer block under derived key `%s'\n",
+                GNUNET_h2s_full (&query));
+    return GNUNET_OK;
+  }
+  expire_blocks (plugin);
+  while ((hdr->used_slots >= plugin->capacity) &&
+         (0 != hdr->used_bytes))
+    evict_oldest (plugin);
+  make_room (plugin,
+             rec_size);
+  /* dropping old records may have changed the hash table */
+  slot = find_slot (plugin,
+                    &query,
+                    &free_slot);
+  if (NULL == slot)
+  {
+    /* at most half of the slots are used, so there is a free one */
+    GNUNET_assert (NULL != free_slot);
+    slot = free_slot;
+    hdr->used_slots++;
+  }
+  rec = (struct NamecacheMmapRecord *) &m->data[hdr->head];
+  rec->size = (uint32_t) rec_size;
+  rec->slot = (uint32_t) (slot - m->slots);
+  GNUNET_memcpy (&rec[1],
+                 block,
+                 block_size);
+  /* publish the record */
+  slot_begin_write (slot);
+  slot->query = query;
+  slot->expiration = expiration.abs_value_us;
+  slot->offset = hdr->head;
+  slot->size = (uint32_t) block_size;
+  slot->state = NAMECACHE_MMAP_SLOT_USED;
+  slot_end_write (slot);
+  hdr->head += rec_size;
+  hdr->used_bytes += rec_size;
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Caching block under derived key `%s'\n",
+              GNUNET_h2s_full (&query));
+  return GNUNET_OK;
+}
+
+
+/**
+ * Get the block for a particular zone and label in the
+ * datastore.  Will return at most one result to the iterator.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @param query hash of public key derived from the zone and the label
+ * @param iter function to call with the result
+ * @param iter_cls closure for @a iter
+ * @return #GNUNET_OK on success, #GNUNET_NO if there were no results, #GNUNET_SYSERR on error
+ */
+static int
+namecache_lookup_block (void *cls,
+                        const struct GNUNET_HashCode *query,
+                        GNUNET_NAMECACHE_BlockCallback iter, void *iter_cls)
+{
+  struct Plugin *plugin = cls;
+  struct GNUNET_GNSRECORD_Block *block;
+  enum GNUNET_GenericReturnValue ret;
+
+  ret = NAMECACHE_mmap_lookup (plugin->m,
+                               query,
+                               &block);
+  if (GNUNET_YES != ret)
+    return ret;
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Found block under derived key `%s'\n",
+              GNUNET_h2s_full (query));
+  iter (iter_cls, block);
+  GNUNET_free (block);
+  return GNUNET_YES;
+}
+
+
+/**
+ * Entry point for the plugin.
+ *
+ * @param cls the "struct GNUNET_NAMECACHE_PluginEnvironment*"
+ * @return NULL on error, otherwise the plugin context
+ */
+void *
+libgnunet_plugin_namecache_mmap_init (void *cls)
+{
+  static struct Plugin plugin;
+  const struct GNUNET_CONFIGURATION_Handle *cfg = cls;
+  struct GNUNET_NAMECACHE_PluginFunctions *api;
+
+  if (NULL != plugin.cfg)
+    return NULL;                /* can only initialize once! */
+  memset (&plugin, 0, sizeof(struct Plugin));
+  plugin.cfg = cfg;
+  if (GNUNET_OK != database_setup (&plugin))
+  {
+    database_shutdown (&plugin);
+    plugin.cfg = NULL;
+    return NULL;
+  }
+  api = GNUNET_new (struct GNUNET_NAMECACHE_PluginFunctions);
+  api->cls = &plugin;
+  api->cache_block = &namecache_cache_block;
+  api->lookup_block = &namecache_lookup_block;
+  GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+              _ ("mmap plugin running\n"));
+  return api;
+}
+
+
+/**
+ * Exit point from the plugin.
+ *
+ * @param cls the plugin context (as returned by "init")
+ * @return always NULL
+ */
+void *
+libgnunet_plugin_namecache_mmap_done (void *cls)
+{
+  struct GNUNET_NAMECACHE_PluginFunctions *api = cls;
+  struct Plugin *plugin = api->cls;
+
+  database_shutdown (plugin);
+  plugin->cfg = NULL;
+  GNUNET_free (api);
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "mmap plugin is finished\n");
+  return NULL;
+}
+
+
+/* end of plugin_namecache_mmap.c */
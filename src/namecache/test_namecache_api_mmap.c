@@ -0,0 +1,516 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2021 GNUnet e.V.
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+/**
+ * @file namecache/test_namecache_api_mmap.c
+ * @brief testcase for the lookups that namecache_api.c answers from
+ *        the memory-mapped database
+ *
+ * The service runs with the sqlite backend, while the API is told
+ * that the database is the mmap file that this test writes with the
+ * "mmap" plugin.  So the two have different blocks under the same
+ * query, and we can tell which one answered a lookup.
+ */
+#include "platform.h"
+#include "gnunet_namecache_service.h"
+#include "gnunet_namecache_plugin.h"
+#include "gnunet_testing_lib.h"
+#include "gnunet_dnsparser_lib.h"
+#include "namecache_mmap.h"
+
+#define TEST_RECORD_TYPE GNUNET_DNSPARSER_TYPE_TXT
+
+#define TEST_RECORD_DATALEN 123
+
+#define TIMEOUT GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 100)
+
+#define PLUGIN_NAME "libgnunet_plugin_namecache_mmap"
+
+
+/**
+ * Blocks used by the test.
+ */
+enum TestBlock
+{
+  /**
+   * Label "a", only known to the service.
+   */
+  BLOCK_SERVICE_A,
+
+  /**
+   * Label "a", only in the mapped database.
+   */
+  BLOCK_MMAP_A,
+
+  /**
+   * Label "b", only known to the service.
+   */
+  BLOCK_SERVICE_B,
+
+  /**
+   * Label "c", only in the mapped database after it was recreated.
+   */
+  BLOCK_MMAP_C,
+
+  BLOCK_COUNT
+};
+
+
+static const char *const labels[BLOCK_COUNT] = {
+  "a",
+  "a",
+  "b",
+  "c"
+};
+
+static struct GNUNET_GNSRECORD_Block *blocks[BLOCK_COUNT];
+
+static struct GNUNET_HashCode queries[BLOCK_COUNT];
+
+static struct GNUNET_NAMECACHE_Handle *nsh;
+
+static struct GNUNET_CONFIGURATION_Handle *mmap_cfg;
+
+static struct GNUNET_NAMECACHE_PluginFunctions *plugin;
+
+static struct GNUNET_SCHEDULER_Task *endbadly_task;
+
+static struct GNUNET_NAMECACHE_QueueEntry *nsqe;
+
+static int res;
+
+/**
+ * Block the current lookup should return, NULL for none.
+ */
+static const struct GNUNET_GNSRECORD_Block *expected;
+
+/**
+ * What to do once the current lookup returned the expected block.
+ */
+static GNUNET_SCHEDULER_TaskCallback next_step;
+
+
+static void
+cleanup (void)
+{
+  if (NULL != nsqe)
+  {
+    GNUNET_NAMECACHE_cancel (nsqe);
+    nsqe = NULL;
+  }
+  if (NULL != nsh)
+  {
+    GNUNET_NAMECACHE_disconnect (nsh);
+    nsh = NULL;
+  }
+  if (NULL != plugin)
+  {
+    GNUNET_break (NULL == GNUNET_PLUGIN_unload (PLUGIN_NAME,
+                                                plugin));
+    plugin = NULL;
+  }
+  if (NULL != mmap_cfg)
+  {
+    GNUNET_CONFIGURATION_destroy (mmap_cfg);
+    mmap_cfg = NULL;
+  }
+  for (unsigned int i = 0; i < BLOCK_COUNT; i++)
+  {
+    GNUNET_free (blocks[i]);
+    blocks[i] = NULL;
+  }
+  GNUNET_SCHEDULER_shutdown ();
+}
+
+
+static void
+endbadly (void *cls)
+{
+  (void) cls;
+  endbadly_task = NULL;
+  cleanup ();
+  res = 1;
+}
+
+
+static void
+end (void *cls)
+{
+  (void) cls;
+  if (NULL != endbadly_task)
+  {
+    GNUNET_SCHEDULER_cancel (endbadly_task);
+    endbadly_task = NULL;
+  }
+  cleanup ();
+  res = 0;
+}
+
+
+static void
+fail (const char *msg)
+{
+  GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+              "%s\n",
+              msg);
+  if (NULL != endbadly_task)
+    GNUNET_SCHEDULER_cancel (endbadly_task);
+  endbadly_task = GNUNET_SCHEDULER_add_now (&endbadly,
+                                            NULL);
+}
+
+
+static void
+lookup_proc (void *cls,
+             const struct GNUNET_GNSRECORD_Block *block)
+{
+  const char *step = cls;
+
+  nsqe = NULL;
+  if ((NULL == block) != (NULL == expected))
+  {
+    fail (step);
+    return;
+  }
+  if ((NULL != block) &&
+      ((GNUNET_GNSRECORD_block_get_size (block) !=
+        GNUNET_GNSRECORD_block_get_size (expected)) ||
+       (0 != memcmp (block,
+                     expected,
+                     GNUNET_GNSRECORD_block_get_size (expected)))))
+  {
+    fail (step);
+    return;
+  }
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Passed: %s\n",
+              step);
+  GNUNET_SCHEDULER_add_now (next_step,
+                            NULL);
+}
+
+
+/**
+ * Look up @a query and expect @a block as result, then continue
+ * with @a next.
+ *
+ * @param query query to look up
+ * @param block expected result, NULL for none
+ * @param next what to do afterwards
+ * @param step description of the step, for failures
+ */
+static void
+expect_lookup (const struct GNUNET_HashCode *query,
+               const struct GNUNET_GNSRECORD_Block *block,
+               GNUNET_SCHEDULER_TaskCallback next,
+               const char *step)
+{
+  expected = block;
+  next_step = next;
+  nsqe = GNUNET_NAMECACHE_lookup_block (nsh,
+                                        query,
+                                        &lookup_proc,
+                                        (void *) step);
+  if (NULL == nsqe)
+    fail (step);
+}
+
+
+/**
+ * Load the "mmap" plugin with #mmap_cfg and cache @a block with it.
+ *
+ * @param block block to cache
+ * @return #GNUNET_OK on success
+ */
+static enum GNUNET_GenericReturnValue
+plugin_cache (const struct GNUNET_GNSRECORD_Block *block)
+{
+  if ((NULL == plugin) &&
+      (NULL == (plugin = GNUNET_PLUGIN_load (PLUGIN_NAME,
+                                             mmap_cfg))))
+    return GNUNET_SYSERR;
+  if (GNUNET_OK != plugin->cache_block (plugin->cls,
+                                        block))
+    return GNUNET_SYSERR;
+  return GNUNET_OK;
+}
+
+
+/**
+ * Make the slot of @a query look busy to readers, as if the writer
+ * was changing it, or undo that.
+ *
+ * @param query query whose slot to change
+ * @param busy #GNUNET_YES to make the slot busy, #GNUNET_NO to
+ *        release it again
+ * @return #GNUNET_OK on success
+ */
+static enum GNUNET_GenericReturnValue
+set_slot_busy (const struct GNUNET_HashCode *query,
+               int busy)
+{
+  struct NamecacheMmap *m;
+  char *fn;
+  enum GNUNET_GenericReturnValue ret = GNUNET_SYSERR;
+
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_filename (mmap_cfg,
+                                               "namecache-mmap",
+                                               "FILENAME",
+                                               &fn))
+    return GNUNET_SYSERR;
+  m = NAMECACHE_mmap_open (fn,
+                           GNUNET_YES);
+  GNUNET_free (fn);
+  if (NULL == m)
+    return GNUNET_SYSERR;
+  for (uint32_t i = 0; i < m->header->num_slots; i++)
+  {
+    struct NamecacheMmapSlot *slot = &m->slots[i];
+
+    if ((NAMECACHE_MMAP_SLOT_USED != slot->state) ||
+        (0 != GNUNET_memcmp (&slot->query,
+                             query)))
+      continue;
+    if (GNUNET_YES == busy)
+      slot->seq |= 1;
+    else
+      slot->seq++;
+    ret = GNUNET_OK;
+    break;
+  }
+  NAMECACHE_mmap_close (m);
+  return ret;
+}
+
+
+static void
+release_slot (void *cls)
+{
+  (void) cls;
+  if (GNUNET_OK != set_slot_busy (&queries[BLOCK_MMAP_A],
+                                  GNUNET_NO))
+  {
+    fail ("release slot");
+    return;
+  }
+  expect_lookup (&queries[BLOCK_MMAP_A],
+                 blocks[BLOCK_MMAP_A],
+                 &end,
+                 "hit after the writer released the slot");
+}
+
+
+static void
+test_busy_slot (void *cls)
+{
+  (void) cls;
+  if (GNUNET_OK != set_slot_busy (&queries[BLOCK_MMAP_A],
+                                  GNUNET_YES))
+  {
+    fail ("make slot busy");
+    return;
+  }
+  expect_lookup (&queries[BLOCK_MMAP_A],
+                 blocks[BLOCK_SERVICE_A],
+                 &release_slot,
+                 "busy slot falls back to the service");
+}
+
+
+static void
+test_recreated (void *cls)
+{
+  (void) cls;
+  /* a larger database makes the plugin replace the file and mark
+     the one the API has mapped as stale */
+  GNUNET_break (NULL == GNUNET_PLUGIN_unload (PLUGIN_NAME,
+                                              plugin));
+  plugin = NULL;
+  GNUNET_CONFIGURATION_set_value_string (mmap_cfg,
+                                         "namecache-mmap",
+                                         "SIZE",
+                                         "2 MiB");
+  if ((GNUNET_OK != plugin_cache (blocks[BLOCK_MMAP_A])) ||
+      (GNUNET_OK != plugin_cache (blocks[BLOCK_MMAP_C])))
+  {
+    fail ("recreate mmap database");
+    return;
+  }
+  expect_lookup (&queries[BLOCK_MMAP_C],
+                 blocks[BLOCK_MMAP_C],
+                 &test_busy_slot,
+                 "hit in the recreated database");
+}
+
+
+static void
+test_miss (void *cls)
+{
+  (void) cls;
+  /* the mapped database is the one of the service, so a miss is
+     final even though this service happens to have the block */
+  expect_lookup (&queries[BLOCK_SERVICE_B],
+                 NULL,
+                 &test_recreated,
+                 "miss in the mapped database");
+}
+
+
+static void
+test_hit (void *cls)
+{
+  (void) cls;
+  if (GNUNET_OK != plugin_cache (blocks[BLOCK_MMAP_A]))
+  {
+    fail ("create mmap database");
+    return;
+  }
+  expect_lookup (&queries[BLOCK_MMAP_A],
+                 blocks[BLOCK_MMAP_A],
+                 &test_miss,
+                 "hit in the mapped database");
+}
+
+
+static void
+test_no_file (void *cls)
+{
+  (void) cls;
+  expect_lookup (&queries[BLOCK_SERVICE_A],
+                 blocks[BLOCK_SERVICE_A],
+                 &test_hit,
+                 "missing database falls back to the service");
+}
+
+
+static void
+cache_b_cont (void *cls,
+              int32_t success,
+              const char *emsg)
+{
+  (void) cls;
+  nsqe = NULL;
+  if (GNUNET_OK != success)
+  {
+    fail ((NULL != emsg) ? emsg : "cache block in service");
+    return;
+  }
+  test_no_file (NULL);
+}
+
+
+static void
+cache_a_cont (void *cls,
+              int32_t success,
+              const char *emsg)
+{
+  (void) cls;
+  nsqe = NULL;
+  if (GNUNET_OK != success)
+  {
+    fail ((NULL != emsg) ? emsg : "cache block in service");
+    return;
+  }
+  nsqe = GNUNET_NAMECACHE_block_cache (nsh,
+                                       blocks[BLOCK_SERVICE_B],
+                                       &cache_b_cont,
+                                       NULL);
+}
+
+
+static void
+run (void *cls,
+     const struct GNUNET_CONFIGURATION_Handle *cfg,
+     struct GNUNET_TESTING_Peer *peer)
+{
+  struct GNUNET_IDENTITY_PrivateKey privkey;
+  struct GNUNET_IDENTITY_PublicKey pubkey;
+  struct GNUNET_GNSRECORD_Data rd;
+  char data[TEST_RECORD_DATALEN];
+
+  (void) cls;
+  (void) peer;
+  endbadly_task = GNUNET_SCHEDULER_add_delayed (TIMEOUT,
+                                                &endbadly,
+                                                NULL);
+  privkey.type = htonl (GNUNET_GNSRECORD_TYPE_PKEY);
+  GNUNET_CRYPTO_ecdsa_key_create (&privkey.ecdsa_key);
+  GNUNET_IDENTITY_key_get_public (&privkey,
+                                  &pubkey);
+  rd.expiration_time = GNUNET_TIME_absolute_get ().abs_value_us + 10000000000;
+  rd.record_type = TEST_RECORD_TYPE;
+  rd.data_size = TEST_RECORD_DATALEN;
+  rd.data = data;
+  rd.flags = 0;
+  for (unsigned int i = 0; i < BLOCK_COUNT; i++)
+  {
+    /* different data, so that blocks under the same label differ */
+    memset (data,
+            'a' + i,
+            sizeof(data));
+    blocks[i] = GNUNET_GNSRECORD_block_create (&privkey,
+                                               GNUNET_TIME_UNIT_FOREVER_ABS,
+                                               labels[i],
+                                               &rd,
+                                               1);
+    GNUNET_assert (NULL != blocks[i]);
+    GNUNET_GNSRECORD_query_from_public_key (&pubkey,
+                                            labels[i],
+                                            &queries[i]);
+  }
+  /* the API reads the mmap database we write, while the service
+     keeps its own (sqlite) database */
+  mmap_cfg = GNUNET_CONFIGURATION_dup (cfg);
+  GNUNET_CONFIGURATION_set_value_string (mmap_cfg,
+                                         "namecache",
+                                         "DATABASE",
+                                         "mmap");
+  nsh = GNUNET_NAMECACHE_connect (mmap_cfg);
+  if (NULL == nsh)
+  {
+    fail ("connect to namecache");
+    return;
+  }
+  nsqe = GNUNET_NAMECACHE_block_cache (nsh,
+                                       blocks[BLOCK_SERVICE_A],
+                                       &cache_a_cont,
+                                       NULL);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  (void) argv;
+  GNUNET_DISK_directory_remove ("/tmp/test-gnunet-namecache/");
+  res = 1;
+  if (0 !=
+      GNUNET_TESTING_service_run ("test-namecache-api-mmap",
+                                  "namecache",
+                                  "test_namecache_api_mmap.conf",
+                                  &run,
+                                  NULL))
+    return 1;
+  return res;
+}
+
+
+/* end of test_namecache_api_mmap.c */
@@ -25,8 +25,13 @@
 #include "platform.h"
 #include "gnunet_util_lib.h"
 #include "gnunet_namecache_plugin.h"
+#include "gnunet_gnsrecord_lib.h"
 #include "gnunet_testing_lib.h"
 
+#define TEST_RECORD_TYPE 1234
+
+#define TEST_RECORD_DATALEN 123
+
 
 static int ok;
 
@@ -79,6 +84,76 @@ load_plugin (const struct GNUNET_CONFIGURATION_Handle *cfg)
 }
 
 
+/**
+ * Function called with the block we looked up.
+ *
+ * @param cls the block we cached
+ * @param block the block we found
+ */
+static void
+check_block (void *cls,
+             const struct GNUNET_GNSRECORD_Block *block)
+{
+  const struct GNUNET_GNSRECORD_Block *cached = cls;
+  size_t size = GNUNET_GNSRECORD_block_get_size (cached);
+
+  if ((size == GNUNET_GNSRECORD_block_get_size (block)) &&
+      (0 == memcmp (cached,
+                    block,
+                    size)))
+    ok = 0;
+}
+
+
+/**
+ * Cache a block and look it up again.
+ *
+ * @param nsp plugin to test
+ */
+static void
+test_cache_and_lookup (struct GNUNET_NAMECACHE_PluginFunctions *nsp)
+{
+  struct GNUNET_IDENTITY_PrivateKey zone;
+  struct GNUNET_GNSRECORD_Data rd;
+  struct GNUNET_GNSRECORD_Block *block;
+  struct GNUNET_HashCode query;
+  struct GNUNET_TIME_Absolute expire;
+  char data[TEST_RECORD_DATALEN];
+
+  zone.type = htonl (GNUNET_GNSRECORD_TYPE_PKEY);
+  GNUNET_CRYPTO_ecdsa_key_create (&zone.ecdsa_key);
+  expire = GNUNET_TIME_relative_to_absolute (GNUNET_TIME_UNIT_HOURS);
+  memset (data,
+          'a',
+          sizeof(data));
+  memset (&rd,
+          0,
+          sizeof(rd));
+  rd.data = data;
+  rd.data_size = sizeof(data);
+  rd.record_type = TEST_RECORD_TYPE;
+  rd.expiration_time = expire.abs_value_us;
+  block = GNUNET_GNSRECORD_block_create (&zone,
+                                         expire,
+                                         "test",
+                                         &rd,
+                                         1);
+  GNUNET_assert (NULL != block);
+  GNUNET_GNSRECORD_query_from_private_key (&zone,
+                                           "test",
+                                           &query);
+  ok = 1;
+  if ((GNUNET_OK == nsp->cache_block (nsp->cls,
+                                      block)) &&
+      (GNUNET_OK != nsp->lookup_block (nsp->cls,
+                                       &query,
+                                       &check_block,
+                                       block)))
+    ok = 2;
+  GNUNET_free (block);
+}
+
+
 static void
 run (void *cls, char *const *args, const char *cfgfile,
      const struct GNUNET_CONFIGURATION_Handle *cfg)
@@ -94,7 +169,7 @@ run (void *cls, char *const *args, const char *cfgfile,
              "Failed to initialize namecache.  Database likely not setup, skipping test.\n");
     return;
   }
-
+  test_cache_and_lookup (nsp);
   unload_plugin (nsp);
 }
 
@@ -112,19 +187,24 @@ main (int argc, char *argv[])
   struct GNUNET_GETOPT_CommandLineOption options[] = {
     GNUNET_GETOPT_OPTION_END
   };
+  char test_dir[PATH_MAX];
 
-  GNUNET_DISK_directory_remove ("/tmp/gnunet-test-plugin-namecache-sqlite");
+  plugin_name = GNUNET_TESTING_get_testname_from_underscore (argv[0]);
+  GNUNET_snprintf (test_dir,
+                   sizeof(test_dir),
+                   "/tmp/gnunet-test-plugin-namecache-%s",
+                   plugin_name);
+  GNUNET_DISK_directory_remove (test_dir);
   GNUNET_log_setup ("test-plugin-namecache",
                     "WARNING",
                     NULL);
-  plugin_name = GNUNET_TESTING_get_testname_from_underscore (argv[0]);
   GNUNET_snprintf (cfg_name, sizeof(cfg_name), "test_plugin_namecache_%s.conf",
                    plugin_name);
   GNUNET_PROGRAM_run ((sizeof(xargv) / sizeof(char *)) - 1, xargv,
                       "test-plugin-namecache", "nohelp", options, &run, NULL);
   if (ok != 0)
     fprintf (stderr, "Missed some testcases: %d\n", ok);
-  GNUNET_DISK_directory_remove ("/tmp/gnunet-test-plugin-namecache-sqlite");
+  GNUNET_DISK_directory_remove (test_dir);
   return ok;
 }
 
@@ -48,6 +48,18 @@
  */
 #define NC_SIZE 16
 
+/**
+ * How many namecache blocks do we refresh in the background at most
+ * before yielding to other requests?
+ */
+#define REFRESH_BATCH_SIZE 16
+
+/**
+ * How many namecache operations may be pending before we stop
+ * refreshing blocks in the background?
+ */
+#define REFRESH_WINDOW 64
+
 /**
  * A namestore client
  */
@@ -93,6 +105,12 @@ struct ZoneIteration
    */
   uint64_t seq;
 
+  /**
+   * #GNUNET_YES if we iterate over the change journal starting after
+   * @e seq, #GNUNET_NO if we iterate over all records.
+   */
+  int changes;
+
   /**
    * The operation id for the zone iteration in the response for the client
    */
@@ -284,7 +302,9 @@ struct StoreActivity
   struct StoreActivity *prev;
 
   /**
-   * Which client triggered the store activity?
+   * Which client triggered the store activity?  NULL if the client
+   * already got its response (bulk store), in which case the block
+   * is refreshed in the background.
    */
   struct NamestoreClient *nc;
 
@@ -306,6 +326,33 @@ struct StoreActivity
 };
 
 
+/**
+ * A label whose block we still need to refresh in the namecache.
+ */
+struct RefreshJob
+{
+  /**
+   * Kept in a DLL.
+   */
+  struct RefreshJob *next;
+
+  /**
+   * Kept in a DLL.
+   */
+  struct RefreshJob *prev;
+
+  /**
+   * Zone of the label.
+   */
+  struct GNUNET_IDENTITY_PrivateKey zone;
+
+  /**
+   * The label, allocated at the end of this struct.
+   */
+  const char *label;
+};
+
+
 /**
  * Entry in list of cached nick resolutions.
  */
@@ -393,6 +440,26 @@ static struct StoreActivity *sa_head;
  */
 static struct StoreActivity *sa_tail;
 
+/**
+ * Head of DLL of blocks to refresh in the background.
+ */
+static struct RefreshJob *refresh_head;
+
+/**
+ * Tail of DLL of blocks to refresh in the background.
+ */
+static struct RefreshJob *refresh_tail;
+
+/**
+ * Task refreshing blocks in the background.
+ */
+static struct GNUNET_SCHEDULER_Task *refresh_task;
+
+/**
+ * Number of entries in the #cop_head DLL.
+ */
+static unsigned int cop_count;
+
 /**
  * Notification context shared by all monitors.
  */
@@ -420,6 +487,7 @@ static void
 cleanup_task (void *cls)
 {
   struct CacheOperation *cop;
+  struct RefreshJob *rj;
 
   (void) cls;
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "Stopping namestore service\n");
@@ -431,6 +499,16 @@ cleanup_task (void *cls)
     GNUNET_CONTAINER_DLL_remove (cop_head, cop_tail, cop);
     GNUNET_free (cop);
   }
+  while (NULL != (rj = refresh_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (refresh_head, refresh_tail, rj);
+    GNUNET_free (rj);
+  }
+  if (NULL != refresh_task)
+  {
+    GNUNET_SCHEDULER_cancel (refresh_task);
+    refresh_task = NULL;
+  }
   if (NULL != namecache)
   {
     GNUNET_NAMECACHE_disconnect (namecache);
@@ -838,14 +916,16 @@ static void
 zone_iteration_done_client_continue (struct ZoneIteration *zi)
 {
   struct GNUNET_MQ_Envelope *env;
-  struct GNUNET_NAMESTORE_Header *em;
+  struct RecordResultEndMessage *em;
 
   GNUNET_SERVICE_client_continue (zi->nc->client);
   if (! zi->send_end)
     return;
   /* send empty response to indicate end of list */
   env = GNUNET_MQ_msg (em, GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_RESULT_END);
-  em->r_id = htonl (zi->request_id);
+  em->gns_header.r_id = htonl (zi->request_id);
+  if (GNUNET_YES == zi->changes)
+    em->serial = GNUNET_htonll (zi->seq);
   GNUNET_MQ_send (zi->nc->mq, env);
 
   GNUNET_CONTAINER_DLL_remove (zi->nc->op_head, zi->nc->op_tail, zi);
@@ -853,6 +933,15 @@ zone_iteration_done_client_continue (struct ZoneIteration *zi)
 }
 
 
+/**
+ * Refresh the namecache blocks of the labels in the #refresh_head DLL.
+ *
+ * @param cls NULL
+ */
+static void
+run_refresh_jobs (void *cls);
+
+
 /**
  * Cache operation complete, clean up.
  *
@@ -873,6 +962,11 @@ finish_cache_operation (void *cls, int32_t success, const char *emsg)
   else
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "CACHE operation completed\n");
   GNUNET_CONTAINER_DLL_remove (cop_head, cop_tail, cop);
+  cop_count--;
+  if ((NULL != refresh_head) &&
+      (NULL == refresh_task))
+    refresh_task = GNUNET_SCHEDULER_add_now (&run_refresh_jobs,
+                                             NULL);
   if (NULL != cop->nc)
     send_store_response (cop->nc, success, cop->rid);
   if (NULL != (zi = cop->zi))
@@ -975,6 +1069,7 @@ refresh_block (struct NamestoreClient *nc,
     zi->cache_ops++;
   cop->rid = rid;
   GNUNET_CONTAINER_DLL_insert (cop_head, cop_tail, cop);
+  cop_count++;
   cop->qe = GNUNET_NAMECACHE_block_cache (namecache,
                                           block,
                                           &finish_cache_operation,
@@ -985,6 +1080,102 @@ refresh_block (struct NamestoreClient *nc,
 }
 
 
+/**
+ * Function called with the current records of a label we
+ * need to refresh the namecache block of.
+ *
+ * @param cls NULL
+ * @param seq sequence number of the record, MUST NOT BE ZERO
+ * @param zone_key the zone key
+ * @param name name
+ * @param rd_count number of records in @a rd
+ * @param rd record data
+ */
+static void
+refresh_job_it (void *cls,
+                uint64_t seq,
+                const struct GNUNET_IDENTITY_PrivateKey *zone_key,
+                const char *name,
+                unsigned int rd_count,
+                const struct GNUNET_GNSRECORD_Data *rd)
+{
+  (void) cls;
+  (void) seq;
+  refresh_block (NULL, NULL, 0, zone_key, name, rd_count, rd);
+}
+
+
+/**
+ * Refresh the namecache blocks of the labels in the #refresh_head DLL.
+ * We look up the records again instead of remembering the ones that
+ * were stored, as the label may have changed in the meantime and we
+ * must not put an outdated block into the namecache.
+ *
+ * @param cls NULL
+ */
+static void
+run_refresh_jobs (void *cls)
+{
+  struct RefreshJob *rj;
+
+  (void) cls;
+  refresh_task = NULL;
+  for (unsigned int i = 0; i < REFRESH_BATCH_SIZE; i++)
+  {
+    if (cop_count >= REFRESH_WINDOW)
+      return; /* resumed from #finish_cache_operation */
+    if (NULL == (rj = refresh_head))
+      return;
+    GNUNET_CONTAINER_DLL_remove (refresh_head, refresh_tail, rj);
+    if (GNUNET_SYSERR ==
+        GSN_database->lookup_records (GSN_database->cls,
+                                      &rj->zone,
+                                      rj->label,
+                                      &refresh_job_it,
+                                      NULL))
+      GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                  "Failed to look up label `%s' to refresh its block\n",
+                  rj->label);
+    GNUNET_STATISTICS_update (statistics,
+                              "Namecache blocks refreshed in background",
+                              1,
+                              GNUNET_NO);
+    GNUNET_free (rj);
+  }
+  if (NULL != refresh_head)
+    refresh_task = GNUNET_SCHEDULER_add_now (&run_refresh_jobs,
+                                             NULL);
+}
+
+
+/**
+ * Remember to refresh the namecache block of @a label in @a zone
+ * in the background.
+ *
+ * @param zone private key of the zone
+ * @param label label to refresh
+ */
+static void
+queue_refresh_job (const struct GNUNET_IDENTITY_PrivateKey *zone,
+                   const char *label)
+{
+  struct RefreshJob *rj;
+  size_t label_len;
+
+  if (GNUNET_YES == disable_namecache)
+    return;
+  label_len = strlen (label) + 1;
+  rj = GNUNET_malloc (sizeof(struct RefreshJob) + label_len);
+  rj->zone = *zone;
+  rj->label = (const char *) &rj[1];
+  GNUNET_memcpy (&rj[1], label, label_len);
+  GNUNET_CONTAINER_DLL_insert_tail (refresh_head, refresh_tail, rj);
+  if (NULL == refresh_task)
+    refresh_task = GNUNET_SCHEDULER_add_now (&run_refresh_jobs,
+                                             NULL);
+}
+
+
 /**
  * Print a warning that one of our monitors is no longer reacting.
  *
@@ -1066,6 +1257,14 @@ continue_store_activity (struct StoreActivity *sa)
                             rd);
       sa->zm_pos = zm->next;
     }
+    if (NULL == sa->nc)
+    {
+      /* bulk store, client already got its response */
+      queue_refresh_job (&rp_msg->private_key,
+                         sa->conv_name);
+      free_store_activity (sa);
+      return;
+    }
     /* great, done with the monitors, unpack (again) for refresh_block operation */
     refresh_block (sa->nc,
                    NULL,
@@ -1449,6 +1648,72 @@ check_record_store (void *cls, const struct RecordStoreMessage *rp_msg)
 }
 
 
+/**
+ * Store the record set @a rd under @a conv_name in @a zone,
+ * updating the nick cache as needed.
+ *
+ * @param zone private key of the zone
+ * @param conv_name normalized label to store the records under
+ * @param rd_count number of records in @a rd, 0 to remove the label
+ * @param rd records to store
+ * @return #GNUNET_OK on success, #GNUNET_NO if there was nothing
+ *         to remove, #GNUNET_SYSERR on database errors
+ */
+static int
+store_record_set (const struct GNUNET_IDENTITY_PrivateKey *zone,
+                  const char *conv_name,
+                  unsigned int rd_count,
+                  const struct GNUNET_GNSRECORD_Data *rd)
+{
+  /* remove "NICK" records, unless this is for the
+     #GNUNET_GNS_EMPTY_LABEL_AT label */
+  struct GNUNET_GNSRECORD_Data rd_clean[GNUNET_NZL (rd_count)];
+  unsigned int rd_clean_off;
+  int have_nick;
+
+  if ((0 == rd_count) &&
+      (GNUNET_NO == GSN_database->lookup_records (GSN_database->cls,
+                                                  zone,
+                                                  conv_name,
+                                                  NULL,
+                                                  0)))
+  {
+    /* This name does not exist, so cannot be removed */
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Name `%s' does not exist, no deletion required\n",
+                conv_name);
+    return GNUNET_NO;
+  }
+  rd_clean_off = 0;
+  have_nick = GNUNET_NO;
+  for (unsigned int i = 0; i < rd_count; i++)
+  {
+    rd_clean[rd_clean_off] = rd[i];
+    if ((0 == strcmp (GNUNET_GNS_EMPTY_LABEL_AT, conv_name)) ||
+        (GNUNET_GNSRECORD_TYPE_NICK != rd[i].record_type))
+      rd_clean_off++;
+
+    if ((0 == strcmp (GNUNET_GNS_EMPTY_LABEL_AT, conv_name)) &&
+        (GNUNET_GNSRECORD_TYPE_NICK == rd[i].record_type))
+    {
+      cache_nick (zone, &rd[i]);
+      have_nick = GNUNET_YES;
+    }
+  }
+  if ((0 == strcmp (GNUNET_GNS_EMPTY_LABEL_AT, conv_name)) &&
+      (GNUNET_NO == have_nick))
+  {
+    /* remove nick record from cache, in case we have one there */
+    cache_nick (zone, NULL);
+  }
+  return GSN_database->store_records (GSN_database->cls,
+                                      zone,
+                                      conv_name,
+                                      rd_clean_off,
+                                      rd_clean);
+}
+
+
 /**
  * Handles a #GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_STORE message
  *
@@ -1507,56 +1772,10 @@ handle_record_store (void *cls, const struct RecordStoreMessage *rp_msg)
                 "Creating %u records for name `%s'\n",
                 (unsigned int) rd_count,
                 conv_name);
-    if ((0 == rd_count) &&
-        (GNUNET_NO == GSN_database->lookup_records (GSN_database->cls,
-                                                    &rp_msg->private_key,
-                                                    conv_name,
-                                                    NULL,
-                                                    0)))
-    {
-      /* This name does not exist, so cannot be removed */
-      GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                  "Name `%s' does not exist, no deletion required\n",
-                  conv_name);
-      res = GNUNET_NO;
-    }
-    else
-    {
-      /* remove "NICK" records, unless this is for the
-       #GNUNET_GNS_EMPTY_LABEL_AT label */
-      struct GNUNET_GNSRECORD_Data rd_clean[GNUNET_NZL (rd_count)];
-      unsigned int rd_clean_off;
-      int have_nick;
-
-      rd_clean_off = 0;
-      have_nick = GNUNET_NO;
-      for (unsigned int i = 0; i < rd_count; i++)
-      {
-        rd_clean[rd_clean_off] = rd[i];
-        if ((0 == strcmp (GNUNET_GNS_EMPTY_LABEL_AT, conv_name)) ||
-            (GNUNET_GNSRECORD_TYPE_NICK != rd[i].record_type))
-          rd_clean_off++;
-
-        if ((0 == strcmp (GNUNET_GNS_EMPTY_LABEL_AT, conv_name)) &&
-            (GNUNET_GNSRECORD_TYPE_NICK == rd[i].record_type))
-        {
-          cache_nick (&rp_msg->private_key, &rd[i]);
-          have_nick = GNUNET_YES;
-        }
-      }
-      if ((0 == strcmp (GNUNET_GNS_EMPTY_LABEL_AT, conv_name)) &&
-          (GNUNET_NO == have_nick))
-      {
-        /* remove nick record from cache, in case we have one there */
-        cache_nick (&rp_msg->private_key, NULL);
-      }
-      res = GSN_database->store_records (GSN_database->cls,
-                                         &rp_msg->private_key,
-                                         conv_name,
-                                         rd_clean_off,
-                                         rd_clean);
-    }
-
+    res = store_record_set (&rp_msg->private_key,
+                            conv_name,
+                            rd_count,
+                            rd);
     if (GNUNET_OK != res)
     {
       /* store not successful, not need to tell monitors */
@@ -1579,6 +1798,235 @@ handle_record_store (void *cls, const struct RecordStoreMessage *rp_msg)
 }
 
 
+/**
+ * Checks a #GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_STORE_BULK message
+ *
+ * @param cls client sending the message
+ * @param rb_msg message of type `struct RecordStoreBulkMessage`
+ * @return #GNUNET_OK if @a rb_msg is well-formed
+ */
+static int
+check_record_store_bulk (void *cls,
+                         const struct RecordStoreBulkMessage *rb_msg)
+{
+  const char *pos;
+  size_t left;
+  unsigned int rd_set_count;
+
+  (void) cls;
+  rd_set_count = ntohs (rb_msg->rd_set_count);
+  pos = (const char *) &rb_msg[1];
+  left = ntohs (rb_msg->gns_header.header.size) - sizeof(*rb_msg);
+  for (unsigned int i = 0; i < rd_set_count; i++)
+  {
+    const struct RecordSet *rs = (const struct RecordSet *) pos;
+    size_t name_len;
+    size_t rd_ser_len;
+    const char *name_tmp;
+
+    if (left < sizeof(struct RecordSet))
+    {
+      GNUNET_break (0);
+      return GNUNET_SYSERR;
+    }
+    name_len = ntohs (rs->name_len);
+    rd_ser_len = ntohs (rs->rd_len);
+    if (left < sizeof(struct RecordSet) + name_len + rd_ser_len)
+    {
+      GNUNET_break (0);
+      return GNUNET_SYSERR;
+    }
+    if ((0 == name_len) || (name_len > MAX_NAME_LEN))
+    {
+      GNUNET_break (0);
+      return GNUNET_SYSERR;
+    }
+    name_tmp = (const char *) &rs[1];
+    if ('\0' != name_tmp[name_len - 1])
+    {
+      GNUNET_break (0);
+      return GNUNET_SYSERR;
+    }
+    pos += sizeof(struct RecordSet) + name_len + rd_ser_len;
+    left -= sizeof(struct RecordSet) + name_len + rd_ser_len;
+  }
+  if (0 != left)
+  {
+    GNUNET_break (0);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Handles a #GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_STORE_BULK message.
+ * All record sets are stored in one database transaction (if the
+ * plugin supports them), and the client gets its response as soon
+ * as the transaction was committed.  Monitors are then notified as
+ * usual, while the namecache is updated in the background.  Without
+ * transactions, the record sets stored before a failure remain in
+ * the database, so monitors and the namecache learn about those.
+ *
+ * @param cls client sending the message
+ * @param rb_msg message of type `struct RecordStoreBulkMessage`
+ */
+static void
+handle_record_store_bulk (void *cls,
+                          const struct RecordStoreBulkMessage *rb_msg)
+{
+  struct NamestoreClient *nc = cls;
+  unsigned int rd_set_count;
+  uint32_t rid;
+  const char *pos;
+  int res;
+  int have_transaction;
+  int drop;
+
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Received NAMESTORE_RECORD_STORE_BULK message\n");
+  rid = ntohl (rb_msg->gns_header.r_id);
+  rd_set_count = ntohs (rb_msg->rd_set_count);
+  GNUNET_break (0 == ntohs (rb_msg->reserved));
+  have_transaction = GNUNET_NO;
+  if ((NULL != GSN_database->begin_transaction) &&
+      (GNUNET_OK == GSN_database->begin_transaction (GSN_database->cls)))
+    have_transaction = GNUNET_YES;
+  {
+    /* whether the i-th record set was stored and needs to be
+       announced to the monitors */
+    int stored[GNUNET_NZL (rd_set_count)];
+
+    res = GNUNET_OK;
+    drop = GNUNET_NO;
+    for (unsigned int i = 0; i < rd_set_count; i++)
+      stored[i] = GNUNET_NO;
+    pos = (const char *) &rb_msg[1];
+    for (unsigned int i = 0; i < rd_set_count; i++)
+    {
+      const struct RecordSet *rs = (const struct RecordSet *) pos;
+      size_t name_len = ntohs (rs->name_len);
+      size_t rd_ser_len = ntohs (rs->rd_len);
+      unsigned int rd_count = ntohs (rs->rd_count);
+      const char *name_tmp = (const char *) &rs[1];
+      const char *rd_ser = &name_tmp[name_len];
+      char *conv_name;
+      struct GNUNET_GNSRECORD_Data rd[GNUNET_NZL (rd_count)];
+      int ret;
+
+      pos = &rd_ser[rd_ser_len];
+      if (GNUNET_OK !=
+          GNUNET_GNSRECORD_records_deserialize (rd_ser_len,
+                                                rd_ser,
+                                                rd_count,
+                                                rd))
+      {
+        GNUNET_break (0);
+        res = GNUNET_SYSERR;
+        drop = GNUNET_YES;
+        break;
+      }
+      conv_name = GNUNET_GNSRECORD_string_to_lowercase (name_tmp);
+      if (NULL == conv_name)
+      {
+        GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                    "Error converting name `%s'\n",
+                    name_tmp);
+        res = GNUNET_SYSERR;
+        drop = GNUNET_YES;
+        break;
+      }
+      GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                  "Creating %u records for name `%s'\n",
+                  (unsigned int) rd_count,
+                  conv_name);
+      ret = store_record_set (&rb_msg->private_key,
+                              conv_name,
+                              rd_count,
+                              rd);
+      GNUNET_free (conv_name);
+      if (GNUNET_SYSERR == ret)
+      {
+        res = GNUNET_SYSERR;
+        break;
+      }
+      if (GNUNET_OK == ret)
+        stored[i] = GNUNET_YES;
+    }
+    if (GNUNET_YES == have_transaction)
+    {
+      if (GNUNET_OK == res)
+        res = GSN_database->commit_transaction (GSN_database->cls);
+      else
+        GSN_database->rollback_transaction (GSN_database->cls);
+      if (GNUNET_OK != res)
+      {
+        /* nothing was stored, no need to tell monitors */
+        for (unsigned int i = 0; i < rd_set_count; i++)
+          stored[i] = GNUNET_NO;
+      }
+    }
+    if (GNUNET_OK != res)
+    {
+      /* our nick cache may be ahead of the database now */
+      cache_nick (&rb_msg->private_key, NULL);
+    }
+    else
+    {
+      GNUNET_STATISTICS_update (statistics,
+                                "Record sets stored in bulk",
+                                rd_set_count,
+                                GNUNET_NO);
+    }
+    if (GNUNET_YES != drop)
+    {
+      send_store_response (nc, res, rid);
+      GNUNET_SERVICE_client_continue (nc->client);
+    }
+
+    /* tell the monitors about the record sets that were stored
+       (without transactions, also those before a failure), then
+       refresh the namecache in the background */
+    pos = (const char *) &rb_msg[1];
+    for (unsigned int i = 0; i < rd_set_count; i++)
+    {
+      const struct RecordSet *rs = (const struct RecordSet *) pos;
+      size_t name_len = ntohs (rs->name_len);
+      size_t rd_ser_len = ntohs (rs->rd_len);
+      struct RecordStoreMessage *rsm;
+      struct StoreActivity *sa;
+
+      pos += sizeof(struct RecordSet) + name_len + rd_ser_len;
+      if (GNUNET_YES != stored[i])
+        continue;
+      sa = GNUNET_malloc (sizeof(struct StoreActivity)
+                          + sizeof(struct RecordStoreMessage)
+                          + name_len + rd_ser_len);
+      GNUNET_CONTAINER_DLL_insert (sa_head, sa_tail, sa);
+      rsm = (struct RecordStoreMessage *) &sa[1];
+      rsm->gns_header.header.type =
+        htons (GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_STORE);
+      rsm->gns_header.header.size =
+        htons (sizeof(struct RecordStoreMessage) + name_len + rd_ser_len);
+      rsm->gns_header.r_id = htonl (rid);
+      rsm->name_len = rs->name_len;
+      rsm->rd_count = rs->rd_count;
+      rsm->rd_len = rs->rd_len;
+      rsm->private_key = rb_msg->private_key;
+      GNUNET_memcpy (&rsm[1], &rs[1], name_len + rd_ser_len);
+      sa->nc = NULL;
+      sa->rsm = rsm;
+      sa->zm_pos = monitor_head;
+      sa->conv_name =
+        GNUNET_GNSRECORD_string_to_lowercase ((const char *) &rs[1]);
+      continue_store_activity (sa);
+    }
+    if (GNUNET_YES == drop)
+      GNUNET_SERVICE_client_drop (nc->client);
+  }
+}
+
+
 /**
  * Context for record remove operations passed from #handle_zone_to_name to
  * #handle_zone_to_name_it as closure
@@ -1819,16 +2267,28 @@ run_zone_iteration_round (struct ZoneIteration *zi, uint64_t limit)
   proc.zi = zi;
   proc.limit = limit;
   start = GNUNET_TIME_absolute_get ();
-  GNUNET_break (GNUNET_SYSERR !=
-                GSN_database->iterate_records (GSN_database->cls,
-                                               (GNUNET_YES == GNUNET_is_zero (
-                                                  &zi->zone))
-                                               ? NULL
-                                               : &zi->zone,
-                                               zi->seq,
-                                               limit,
-                                               &zone_iterate_proc,
-                                               &proc));
+  if (GNUNET_YES == zi->changes)
+    GNUNET_break (GNUNET_SYSERR !=
+                  GSN_database->iterate_changes (GSN_database->cls,
+                                                 (GNUNET_YES == GNUNET_is_zero (
+                                                    &zi->zone))
+                                                 ? NULL
+                                                 : &zi->zone,
+                                                 zi->seq,
+                                                 limit,
+                                                 &zone_iterate_proc,
+                                                 &proc));
+  else
+    GNUNET_break (GNUNET_SYSERR !=
+                  GSN_database->iterate_records (GSN_database->cls,
+                                                 (GNUNET_YES == GNUNET_is_zero (
+                                                    &zi->zone))
+                                                 ? NULL
+                                                 : &zi->zone,
+                                                 zi->seq,
+                                                 limit,
+                                                 &zone_iterate_proc,
+                                                 &proc));
   duration = GNUNET_TIME_absolute_get_duration (start);
   duration = GNUNET_TIME_relative_divide (duration, limit - proc.limit);
   GNUNET_STATISTICS_set (statistics,
@@ -1871,6 +2331,44 @@ handle_iteration_start (void *cls,
 }
 
 
+/**
+ * Handles a #GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_CHANGES_START message
+ *
+ * @param cls the client sending the message
+ * @param zis_msg message from the client
+ */
+static void
+handle_changes_start (void *cls,
+                      const struct ZoneIterationStartMessage *zis_msg)
+{
+  struct NamestoreClient *nc = cls;
+  struct ZoneIteration *zi;
+
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Received ZONE_CHANGES_START message\n");
+  zi = GNUNET_new (struct ZoneIteration);
+  zi->request_id = ntohl (zis_msg->gns_header.r_id);
+  zi->offset = 0;
+  zi->nc = nc;
+  zi->zone = zis_msg->zone;
+  zi->seq = GNUNET_ntohll (zis_msg->since);
+  zi->changes = GNUNET_YES;
+  GNUNET_CONTAINER_DLL_insert (nc->op_head, nc->op_tail, zi);
+  if (NULL == GSN_database->iterate_changes)
+  {
+    /* backend keeps no journal; an end with serial zero tells the
+       client that it cannot know what changed */
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Database has no change journal\n");
+    zi->seq = 0;
+    zi->send_end = GNUNET_YES;
+    zone_iteration_done_client_continue (zi);
+    return;
+  }
+  run_zone_iteration_round (zi, 1);
+}
+
+
 /**
  * Handles a #GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_ITERATION_STOP message
  *
@@ -2242,6 +2740,10 @@ GNUNET_SERVICE_MAIN (
                          GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_STORE,
                          struct RecordStoreMessage,
                          NULL),
+  GNUNET_MQ_hd_var_size (record_store_bulk,
+                         GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_STORE_BULK,
+                         struct RecordStoreBulkMessage,
+                         NULL),
   GNUNET_MQ_hd_var_size (record_lookup,
                          GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_LOOKUP,
                          struct LabelLookupMessage,
@@ -2254,6 +2756,10 @@ GNUNET_SERVICE_MAIN (
                            GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_ITERATION_START,
                            struct ZoneIterationStartMessage,
                            NULL),
+  GNUNET_MQ_hd_fixed_size (changes_start,
+                           GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_CHANGES_START,
+                           struct ZoneIterationStartMessage,
+                           NULL),
   GNUNET_MQ_hd_fixed_size (iteration_next,
                            GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_ITERATION_NEXT,
                            struct ZoneIterationNextMessage,
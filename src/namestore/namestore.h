@@ -99,6 +99,69 @@ struct RecordStoreMessage
 };
 
 
+/**
+ * Store the records of several labels.
+ */
+struct RecordStoreBulkMessage
+{
+  /**
+   * Type will be #GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_STORE_BULK
+   */
+  struct GNUNET_NAMESTORE_Header gns_header;
+
+  /**
+   * Number of record sets that follow
+   */
+  uint16_t rd_set_count GNUNET_PACKED;
+
+  /**
+   * always zero (for alignment)
+   */
+  uint16_t reserved GNUNET_PACKED;
+
+  /**
+   * The private key of the authority.
+   */
+  struct GNUNET_IDENTITY_PrivateKey private_key;
+
+  /* followed by:
+   * rd_set_count record sets (struct RecordSet)
+   */
+};
+
+
+/**
+ * The records of one label in a #RecordStoreBulkMessage.
+ */
+struct RecordSet
+{
+  /**
+   * Name length
+   */
+  uint16_t name_len GNUNET_PACKED;
+
+  /**
+   * Length of serialized record data
+   */
+  uint16_t rd_len GNUNET_PACKED;
+
+  /**
+   * Number of records contained
+   */
+  uint16_t rd_count GNUNET_PACKED;
+
+  /**
+   * always zero (for alignment)
+   */
+  uint16_t reserved GNUNET_PACKED;
+
+  /* followed by:
+   * name with length name_len
+   * serialized record data with rd_count records
+   */
+};
+
+
 /**
  * Response to a record storage request.
  */
@@ -292,6 +355,25 @@ struct RecordResultMessage
 };
 
 
+/**
+ * End of the results of a zone iteration.
+ */
+struct RecordResultEndMessage
+{
+  /**
+   * Type will be #GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_RESULT_END
+   */
+  struct GNUNET_NAMESTORE_Header gns_header;
+
+  /**
+   * Highest journal serial covered by an iteration over changes, in
+   * NBO.  Zero for iterations over all records, and if the database
+   * keeps no change journal.
+   */
+  uint64_t serial GNUNET_PACKED;
+};
+
+
 /**
  * Start monitoring a zone.
  */
@@ -346,6 +428,7 @@ struct ZoneIterationStartMessage
 {
   /**
    * Type will be #GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_ITERATION_START
+   * or #GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_CHANGES_START
    */
   struct GNUNET_NAMESTORE_Header gns_header;
 
@@ -353,6 +436,12 @@ struct ZoneIterationStartMessage
    * Zone key.  All zeros for "all zones".
    */
   struct GNUNET_IDENTITY_PrivateKey zone;
+
+  /**
+   * Journal serial to return changes after, in NBO.  Only used
+   * with #GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_CHANGES_START.
+   */
+  uint64_t since GNUNET_PACKED;
 };
 
 
@@ -145,6 +145,11 @@ struct GNUNET_NAMESTORE_ZoneIterator
    */
   void *finish_cb_cls;
 
+  /**
+   * Function to call on completion of an iteration over changes.
+   */
+  GNUNET_NAMESTORE_ChangesFinishedCallback changes_cb;
+
   /**
    * The continuation to call with the results
    */
@@ -601,15 +606,15 @@ handle_record_result (void *cls, const struct RecordResultMessage *msg)
  * @param msg the message we received
  */
 static void
-handle_record_result_end (void *cls, const struct GNUNET_NAMESTORE_Header *msg)
+handle_record_result_end (void *cls, const struct RecordResultEndMessage *msg)
 {
   struct GNUNET_NAMESTORE_Handle *h = cls;
   struct GNUNET_NAMESTORE_QueueEntry *qe;
   struct GNUNET_NAMESTORE_ZoneIterator *ze;
 
   LOG (GNUNET_ERROR_TYPE_DEBUG, "Received RECORD_RESULT_END\n");
-  ze = find_zi (h, ntohl (msg->r_id));
-  qe = find_qe (h, ntohl (msg->r_id));
+  ze = find_zi (h, ntohl (msg->gns_header.r_id));
+  qe = find_qe (h, ntohl (msg->gns_header.r_id));
   if ((NULL == ze) && (NULL == qe))
     return; /* rid not found */
   if ((NULL != ze) && (NULL != qe))
@@ -627,6 +632,9 @@ handle_record_result_end (void *cls, const struct GNUNET_NAMESTORE_Header *msg)
   }
   if (NULL != ze->finish_cb)
     ze->finish_cb (ze->finish_cb_cls);
+  if (NULL != ze->changes_cb)
+    ze->changes_cb (ze->finish_cb_cls,
+                    GNUNET_ntohll (msg->serial));
   free_ze (ze);
 }
 
@@ -789,7 +797,7 @@ reconnect (struct GNUNET_NAMESTORE_Handle *h)
                            h),
     GNUNET_MQ_hd_fixed_size (record_result_end,
                              GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_RESULT_END,
-                             struct GNUNET_NAMESTORE_Header,
+                             struct RecordResultEndMessage,
                              h),
     GNUNET_MQ_hd_var_size (lookup_result,
                            GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_LOOKUP_RESPONSE,
@@ -1071,6 +1079,130 @@ GNUNET_NAMESTORE_records_store (
 }
 
 
+/**
+ * Store the records of several labels of a zone in the namestore.
+ *
+ * @param h handle to the namestore
+ * @param pkey private key of the zone
+ * @param ri_count number of entries in the @a ri array
+ * @param ri the labels and their records to store
+ * @param ri_sent[out] set to the number of @a ri that were sent
+ * @param cont continuation to call when done
+ * @param cont_cls closure for @a cont
+ * @return handle to abort the request
+ */
+struct GNUNET_NAMESTORE_QueueEntry *
+GNUNET_NAMESTORE_records_store_bulk (
+  struct GNUNET_NAMESTORE_Handle *h,
+  const struct GNUNET_IDENTITY_PrivateKey *pkey,
+  unsigned int ri_count,
+  const struct GNUNET_NAMESTORE_RecordInfo *ri,
+  unsigned int *ri_sent,
+  GNUNET_NAMESTORE_ContinuationWithStatus cont,
+  void *cont_cls)
+{
+  struct GNUNET_NAMESTORE_QueueEntry *qe;
+  struct GNUNET_MQ_Envelope *env;
+  struct RecordStoreBulkMessage *msg;
+  ssize_t *rd_ser_len;
+  size_t total;
+  unsigned int cnt;
+  uint32_t rid;
+  char *pos;
+
+  *ri_sent = 0;
+  if (0 == ri_count)
+    return NULL;
+  /* figure out how many record sets fit into one message */
+  rd_ser_len = GNUNET_new_array (GNUNET_MIN (ri_count,
+                                             UINT16_MAX),
+                                 ssize_t);
+  total = 0;
+  for (cnt = 0; (cnt < ri_count) && (cnt < UINT16_MAX); cnt++)
+  {
+    size_t name_len = strlen (ri[cnt].a_label) + 1;
+    size_t set_len;
+
+    if (name_len > MAX_NAME_LEN)
+    {
+      GNUNET_break (0);
+      break;
+    }
+    rd_ser_len[cnt] = GNUNET_GNSRECORD_records_get_size (ri[cnt].a_rd_count,
+                                                         ri[cnt].a_rd);
+    if ((rd_ser_len[cnt] < 0) ||
+        (rd_ser_len[cnt] > UINT16_MAX))
+    {
+      GNUNET_break (0);
+      break;
+    }
+    set_len = sizeof(struct RecordSet) + name_len + rd_ser_len[cnt];
+    if (sizeof(*msg) + total + set_len >= GNUNET_MAX_MESSAGE_SIZE)
+      break;
+    total += set_len;
+  }
+  if (0 == cnt)
+  {
+    GNUNET_free (rd_ser_len);
+    return NULL;
+  }
+  rid = get_op_id (h);
+  qe = GNUNET_new (struct GNUNET_NAMESTORE_QueueEntry);
+  qe->h = h;
+  qe->cont = cont;
+  qe->cont_cls = cont_cls;
+  qe->op_id = rid;
+  GNUNET_CONTAINER_DLL_insert_tail (h->op_head, h->op_tail, qe);
+
+  /* setup msg */
+  env = GNUNET_MQ_msg_extra (msg,
+                             total,
+                             GNUNET_MESSAGE_TYPE_NAMESTORE_RECORD_STORE_BULK);
+  msg->gns_header.r_id = htonl (rid);
+  msg->rd_set_count = htons ((uint16_t) cnt);
+  msg->reserved = htons (0);
+  msg->private_key = *pkey;
+  pos = (char *) &msg[1];
+  for (unsigned int i = 0; i < cnt; i++)
+  {
+    struct RecordSet *rs = (struct RecordSet *) pos;
+    size_t name_len = strlen (ri[i].a_label) + 1;
+
+    rs->name_len = htons (name_len);
+    rs->rd_count = htons (ri[i].a_rd_count);
+    rs->rd_len = htons (rd_ser_len[i]);
+    rs->reserved = htons (0);
+    pos = (char *) &rs[1];
+    GNUNET_memcpy (pos, ri[i].a_label, name_len);
+    pos += name_len;
+    GNUNET_assert (rd_ser_len[i] ==
+                   GNUNET_GNSRECORD_records_serialize (ri[i].a_rd_count,
+                                                       ri[i].a_rd,
+                                                       rd_ser_len[i],
+                                                       pos));
+    pos += rd_ser_len[i];
+  }
+  GNUNET_free (rd_ser_len);
+  *ri_sent = cnt;
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Sending NAMESTORE_RECORD_STORE_BULK message with %u record sets\n",
+       cnt);
+  qe->timeout_task =
+    GNUNET_SCHEDULER_add_delayed (NAMESTORE_DELAY_TOLERANCE, &warn_delay, qe);
+  if (NULL == h->mq)
+  {
+    qe->env = env;
+    LOG (GNUNET_ERROR_TYPE_WARNING,
+         "Delaying NAMESTORE_RECORD_STORE_BULK message as namestore is not ready!\n");
+  }
+  else
+  {
+    GNUNET_MQ_send (h->mq, env);
+  }
+  return qe;
+}
+
+
 /**
  * Lookup an item in the namestore.
  *
@@ -1241,6 +1373,67 @@ GNUNET_NAMESTORE_zone_iteration_start (
 }
 
 
+/**
+ * Starts a new iteration over the labels that changed since the
+ * journal serial @a since.
+ *
+ * @param h handle to the namestore
+ * @param zone zone to access, NULL for all zones
+ * @param since journal serial to start after, 0 for all changes
+ * @param error_cb function to call on error (i.e. disconnect)
+ * @param error_cb_cls closure for @a error_cb
+ * @param proc function to call on each changed label
+ * @param proc_cls closure for @a proc
+ * @param finish_cb function to call on completion
+ * @param finish_cb_cls closure for @a finish_cb
+ * @return an iterator handle to use for iteration
+ */
+struct GNUNET_NAMESTORE_ZoneIterator *
+GNUNET_NAMESTORE_zone_changes_start (
+  struct GNUNET_NAMESTORE_Handle *h,
+  const struct GNUNET_IDENTITY_PrivateKey *zone,
+  uint64_t since,
+  GNUNET_SCHEDULER_TaskCallback error_cb,
+  void *error_cb_cls,
+  GNUNET_NAMESTORE_RecordMonitor proc,
+  void *proc_cls,
+  GNUNET_NAMESTORE_ChangesFinishedCallback finish_cb,
+  void *finish_cb_cls)
+{
+  struct GNUNET_NAMESTORE_ZoneIterator *it;
+  struct GNUNET_MQ_Envelope *env;
+  struct ZoneIterationStartMessage *msg;
+  uint32_t rid;
+
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "Sending ZONE_CHANGES_START message (since %llu)\n",
+       (unsigned long long) since);
+  rid = get_op_id (h);
+  it = GNUNET_new (struct GNUNET_NAMESTORE_ZoneIterator);
+  it->h = h;
+  it->error_cb = error_cb;
+  it->error_cb_cls = error_cb_cls;
+  it->changes_cb = finish_cb;
+  it->finish_cb_cls = finish_cb_cls;
+  it->proc = proc;
+  it->proc_cls = proc_cls;
+  it->op_id = rid;
+  if (NULL != zone)
+    it->zone = *zone;
+  GNUNET_CONTAINER_DLL_insert_tail (h->z_head, h->z_tail, it);
+  env = GNUNET_MQ_msg (msg, GNUNET_MESSAGE_TYPE_NAMESTORE_ZONE_CHANGES_START);
+  msg->gns_header.r_id = htonl (rid);
+  if (NULL != zone)
+    msg->zone = *zone;
+  msg->since = GNUNET_htonll (since);
+  if (NULL == h->mq)
+    it->env = env;
+  else
+    GNUNET_MQ_send (h->mq, env);
+  return it;
+}
+
+
 /**
  * Calls the record processor specified in #GNUNET_NAMESTORE_zone_iteration_start
  * for the next record.
@@ -0,0 +1,324 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2021 GNUnet e.V.
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+/**
+ * @file namestore/perf_namestore_api_import.c
+ * @brief benchmark for importing a zone, one label at a time
+ *        and using bulk stores
+ */
+#include "platform.h"
+#include "gnunet_namestore_service.h"
+#include "gnunet_testing_lib.h"
+#include "namestore.h"
+#include "gnunet_dnsparser_lib.h"
+
+#define TEST_RECORD_TYPE GNUNET_DNSPARSER_TYPE_TXT
+
+/**
+ * Benchmarks must not fail hard on slow systems.
+ */
+#define TIMEOUT GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_MINUTES, 30)
+
+/**
+ * How many labels do we import in each phase?
+ */
+#define BENCHMARK_SIZE 1000
+
+/**
+ * Maximum record size
+ */
+#define MAX_REC_SIZE 500
+
+/**
+ * How many labels do we offer in one bulk store?
+ */
+#define BULK_SIZE 100
+
+static struct GNUNET_NAMESTORE_Handle *nsh;
+
+static struct GNUNET_SCHEDULER_Task *timeout_task;
+
+static struct GNUNET_SCHEDULER_Task *t;
+
+static struct GNUNET_IDENTITY_PrivateKey privkey;
+
+static struct GNUNET_IDENTITY_PrivateKey privkey2;
+
+static struct GNUNET_NAMESTORE_QueueEntry *qe;
+
+static int res;
+
+static unsigned int off;
+
+static struct GNUNET_TIME_Absolute start;
+
+
+/**
+ * Terminate everything
+ *
+ * @param cls NULL
+ */
+static void
+end (void *cls)
+{
+  (void) cls;
+  if (NULL != qe)
+  {
+    GNUNET_NAMESTORE_cancel (qe);
+    qe = NULL;
+  }
+  if (NULL != nsh)
+  {
+    GNUNET_NAMESTORE_disconnect (nsh);
+    nsh = NULL;
+  }
+  if (NULL != t)
+  {
+    GNUNET_SCHEDULER_cancel (t);
+    t = NULL;
+  }
+  if (NULL != timeout_task)
+  {
+    GNUNET_SCHEDULER_cancel (timeout_task);
+    timeout_task = NULL;
+  }
+}
+
+
+/**
+ * End with timeout. As this is a benchmark, we do not
+ * fail hard but return "skipped".
+ */
+static void
+timeout (void *cls)
+{
+  (void) cls;
+  timeout_task = NULL;
+  GNUNET_SCHEDULER_shutdown ();
+  res = 77;
+}
+
+
+static struct GNUNET_GNSRECORD_Data *
+create_record (unsigned int count)
+{
+  struct GNUNET_GNSRECORD_Data *rd;
+
+  rd = GNUNET_malloc (count + sizeof(struct GNUNET_GNSRECORD_Data));
+  rd->expiration_time = GNUNET_TIME_relative_to_absolute (
+    GNUNET_TIME_UNIT_HOURS).abs_value_us;
+  rd->record_type = TEST_RECORD_TYPE;
+  rd->data_size = count;
+  rd->data = (void *) &rd[1];
+  rd->flags = 0;
+  memset (&rd[1],
+          'a',
+          count);
+  return rd;
+}
+
+
+static void
+publish_bulk (void *cls);
+
+
+static void
+bulk_cont (void *cls,
+           int32_t success,
+           const char *emsg)
+{
+  (void) cls;
+  qe = NULL;
+  if (GNUNET_OK != success)
+  {
+    GNUNET_break (0);
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  t = GNUNET_SCHEDULER_add_now (&publish_bulk,
+                                NULL);
+}
+
+
+static void
+publish_bulk (void *cls)
+{
+  struct GNUNET_NAMESTORE_RecordInfo ri[BULK_SIZE];
+  struct GNUNET_GNSRECORD_Data *rd[BULK_SIZE];
+  char *label[BULK_SIZE];
+  unsigned int ri_count;
+  unsigned int ri_sent;
+
+  (void) cls;
+  t = NULL;
+  if (BENCHMARK_SIZE == off)
+  {
+    struct GNUNET_TIME_Relative delay;
+
+    delay = GNUNET_TIME_absolute_get_duration (start);
+    fprintf (stdout,
+             "Inserting %u records in bulk took %s\n",
+             off,
+             GNUNET_STRINGS_relative_time_to_string (delay,
+                                                     GNUNET_YES));
+    res = 0;
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  ri_count = GNUNET_MIN (BULK_SIZE,
+                         BENCHMARK_SIZE - off);
+  for (unsigned int i = 0; i < ri_count; i++)
+  {
+    rd[i] = create_record ((off + i + 1) % MAX_REC_SIZE);
+    GNUNET_asprintf (&label[i],
+                     "l%u",
+                     off + i + 1);
+    ri[i].a_label = label[i];
+    ri[i].a_rd_count = 1;
+    ri[i].a_rd = rd[i];
+  }
+  qe = GNUNET_NAMESTORE_records_store_bulk (nsh,
+                                            &privkey2,
+                                            ri_count,
+                                            ri,
+                                            &ri_sent,
+                                            &bulk_cont,
+                                            NULL);
+  GNUNET_assert (NULL != qe);
+  off += ri_sent;
+  for (unsigned int i = 0; i < ri_count; i++)
+  {
+    GNUNET_free (label[i]);
+    GNUNET_free (rd[i]);
+  }
+}
+
+
+static void
+publish_record (void *cls);
+
+
+static void
+put_cont (void *cls,
+          int32_t success,
+          const char *emsg)
+{
+  (void) cls;
+  qe = NULL;
+  if (GNUNET_OK != success)
+  {
+    GNUNET_break (0);
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  t = GNUNET_SCHEDULER_add_now (&publish_record,
+                                NULL);
+}
+
+
+static void
+publish_record (void *cls)
+{
+  struct GNUNET_GNSRECORD_Data *rd;
+  char *label;
+
+  (void) cls;
+  t = NULL;
+  if (BENCHMARK_SIZE == off)
+  {
+    struct GNUNET_TIME_Relative delay;
+
+    delay = GNUNET_TIME_absolute_get_duration (start);
+    fprintf (stdout,
+             "Inserting %u records one by one took %s\n",
+             off,
+             GNUNET_STRINGS_relative_time_to_string (delay,
+                                                     GNUNET_YES));
+    /* now import the same zone again, but in bulk */
+    start = GNUNET_TIME_absolute_get ();
+    off = 0;
+    t = GNUNET_SCHEDULER_add_now (&publish_bulk,
+                                  NULL);
+    return;
+  }
+  rd = create_record ((++off) % MAX_REC_SIZE);
+  GNUNET_asprintf (&label,
+                   "l%u",
+                   off);
+  qe = GNUNET_NAMESTORE_records_store (nsh,
+                                       &privkey,
+                                       label,
+                                       1, rd,
+                                       &put_cont,
+                                       NULL);
+  GNUNET_free (label);
+  GNUNET_free (rd);
+}
+
+
+static void
+run (void *cls,
+     const struct GNUNET_CONFIGURATION_Handle *cfg,
+     struct GNUNET_TESTING_Peer *peer)
+{
+  GNUNET_SCHEDULER_add_shutdown (&end,
+                                 NULL);
+  timeout_task = GNUNET_SCHEDULER_add_delayed (TIMEOUT,
+                                               &timeout,
+                                               NULL);
+  nsh = GNUNET_NAMESTORE_connect (cfg);
+  GNUNET_assert (NULL != nsh);
+  privkey.type = htonl (GNUNET_GNSRECORD_TYPE_PKEY);
+  GNUNET_CRYPTO_ecdsa_key_create (&privkey.ecdsa_key);
+  privkey2.type = htonl (GNUNET_GNSRECORD_TYPE_PKEY);
+  GNUNET_CRYPTO_ecdsa_key_create (&privkey2.ecdsa_key);
+  start = GNUNET_TIME_absolute_get ();
+  t = GNUNET_SCHEDULER_add_now (&publish_record,
+                                NULL);
+}
+
+
+#include "test_common.c"
+
+
+int
+main (int argc,
+      char *argv[])
+{
+  const char *plugin_name;
+  char *cfg_name;
+
+  SETUP_CFG (plugin_name, cfg_name);
+  res = 1;
+  if (0 !=
+      GNUNET_TESTING_peer_run ("perf-namestore-api-import",
+                               cfg_name,
+                               &run,
+                               NULL))
+  {
+    res = 1;
+  }
+  GNUNET_DISK_purge_cfg_dir (cfg_name,
+                             "GNUNET_TEST_HOME");
+  GNUNET_free (cfg_name);
+  return res;
+}
+
+
+/* end of perf_namestore_api_import.c */
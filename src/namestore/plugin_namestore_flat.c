@@ -22,6 +22,16 @@
  * @brief file-based namestore backend
  * @author Martin Schanzenbach
  * @author Christian Grothoff
+ *
+ * The database is an append-only log of `struct LogRecord`s, each
+ * giving the new record set of one label (or an empty set if the
+ * label was removed) and the serial of the change.  The log is
+ * replayed into memory on startup, and rewritten with only the
+ * current record sets once it contains mostly outdated entries.
+ * Removed labels are kept as empty record sets, so that the entries
+ * ordered by serial double as the change journal.  As every change is written before we
+ * return, a crash loses at most the record being written, which is
+ * detected by its checksum and dropped on the next start.
  */
 
 #include "platform.h"
@@ -31,50 +41,220 @@
 #include "namestore.h"
 
 /**
- * Context for all functions in this plugin.
+ * Magic value at the beginning of the database file.
  */
-struct Plugin
+#define LOG_MAGIC "GNSFLAT2"
+
+/**
+ * Length of #LOG_MAGIC (without the 0-terminator).
+ */
+#define LOG_MAGIC_LEN 8
+
+/**
+ * Logs smaller than this are never compacted.
+ */
+#define COMPACT_MIN_SIZE (1024 * 1024)
+
+
+GNUNET_NETWORK_STRUCT_BEGIN
+
+/**
+ * Entry in the database file.
+ */
+struct LogRecord
 {
-  const struct GNUNET_CONFIGURATION_Handle *cfg;
+  /**
+   * Total size of this entry, including this header.
+   */
+  uint32_t size GNUNET_PACKED;
 
   /**
-   * Database filename.
+   * CRC32 over the entry, starting after this field.
    */
-  char *fn;
+  uint32_t crc GNUNET_PACKED;
 
   /**
-   * HashMap
+   * Zone of the label.
    */
-  struct GNUNET_CONTAINER_MultiHashMap *hm;
+  struct GNUNET_IDENTITY_PrivateKey private_key;
+
+  /**
+   * Length of the label, including the 0-terminator.
+   */
+  uint16_t label_len GNUNET_PACKED;
+
+  /**
+   * Number of records, 0 if the label was removed.
+   */
+  uint16_t record_count GNUNET_PACKED;
+
+  /**
+   * Length of the serialized records.
+   */
+  uint32_t rd_len GNUNET_PACKED;
+
+  /**
+   * Serial of the change, grows with each entry in the file.
+   */
+  uint64_t serial GNUNET_PACKED;
+
+  /* followed by the label and the serialized records */
+};
+
+GNUNET_NETWORK_STRUCT_END
+
+
+struct FlatFileEntry;
+
+
+/**
+ * The entries of one zone, ordered by serial.
+ */
+struct ZoneEntries
+{
+  /**
+   * Entry with the lowest serial.
+   */
+  struct FlatFileEntry *head;
+
+  /**
+   * Entry with the highest serial.
+   */
+  struct FlatFileEntry *tail;
+
+  /**
+   * The zone.
+   */
+  struct GNUNET_IDENTITY_PrivateKey zone;
 };
 
 
 struct FlatFileEntry
 {
+  /**
+   * Kept in a DLL of all entries, ordered by serial.
+   */
+  struct FlatFileEntry *next;
+
+  /**
+   * Kept in a DLL of all entries, ordered by serial.
+   */
+  struct FlatFileEntry *prev;
+
+  /**
+   * Kept in a DLL of the entries of the zone, ordered by serial.
+   */
+  struct FlatFileEntry *next_zone;
+
+  /**
+   * Kept in a DLL of the entries of the zone, ordered by serial.
+   */
+  struct FlatFileEntry *prev_zone;
+
+  /**
+   * The entries of our zone.
+   */
+  struct ZoneEntries *ze;
+
   /**
    * Entry zone
    */
   struct GNUNET_IDENTITY_PrivateKey private_key;
 
   /**
-   * Record count.
+   * Serial of the entry, grows with each change.
+   */
+  uint64_t serial;
+
+  /**
+   * Record count, 0 if the label was removed.
    */
   uint32_t record_count;
 
   /**
-   * Rvalue
+   * Length of @e rd_ser.
    */
-  uint64_t rvalue;
+  size_t rd_len;
 
   /**
-   * Record data
+   * Serialized record data, allocated at the end of this struct.
    */
-  struct GNUNET_GNSRECORD_Data *record_data;
+  const char *rd_ser;
 
   /**
-   * Label
+   * Label, allocated at the end of this struct.
    */
-  char *label;
+  const char *label;
+};
+
+
+/**
+ * Context for all functions in this plugin.
+ */
+struct Plugin
+{
+  const struct GNUNET_CONFIGURATION_Handle *cfg;
+
+  /**
+   * Database filename.
+   */
+  char *fn;
+
+  /**
+   * Database file, open for appending.
+   */
+  struct GNUNET_DISK_FileHandle *fh;
+
+  /**
+   * Map from hash of zone and label to `struct FlatFileEntry`.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap *hm;
+
+  /**
+   * Map from hash of zone to `struct ZoneEntries`.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap *zones;
+
+  /**
+   * Map from hash of zone and delegation target to the
+   * `struct FlatFileEntry` with the delegation.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap *ztn;
+
+  /**
+   * Map from the (truncated) serial to the `struct FlatFileEntry`.
+   */
+  struct GNUNET_CONTAINER_MultiHashMap32 *serials;
+
+  /**
+   * Entry with the lowest serial.
+   */
+  struct FlatFileEntry *head;
+
+  /**
+   * Entry with the highest serial.
+   */
+  struct FlatFileEntry *tail;
+
+  /**
+   * Serial of the last entry we created.
+   */
+  uint64_t last_serial;
+
+  /**
+   * Current size of the database file.
+   */
+  uint64_t log_size;
+
+  /**
+   * Size the database file would have after compaction.
+   */
+  uint64_t live_size;
+
+  /**
+   * Synchronize the file to disk after each change?
+   */
+  int sync;
 };
 
 
@@ -111,117 +291,352 @@ hash_pkey_and_label (const struct GNUNET_IDENTITY_PrivateKey *pkey,
 
 
 /**
- * Initialize the database connections and associated
- * data structures (create tables and indices
- * as needed as well).
+ * Hash the delegation from @a pkey to the zone given by
+ * @a data of type @a type into @a h.
  *
- * @param plugin the plugin context (state for this module)
- * @return #GNUNET_OK on success
+ * @param pkey a key
+ * @param type record type of the delegation
+ * @param data record data of the delegation
+ * @param data_size number of bytes in @a data
+ * @param h[out] initialized hash
  */
-static int
-database_setup (struct Plugin *plugin)
+static void
+hash_pkey_and_value (const struct GNUNET_IDENTITY_PrivateKey *pkey,
+                     uint32_t type,
+                     const void *data,
+                     size_t data_size,
+                     struct GNUNET_HashCode *h)
 {
-  char *flatdbfile;
-  char *record_data;
-  char *zone_private_key;
-  char *record_data_b64;
-  char *buffer;
-  char *line;
-  char *label;
-  char *rvalue;
-  char *record_count;
-  size_t record_data_size;
-  uint64_t size;
+  char key[sizeof(*pkey) + sizeof(type) + data_size];
+  uint32_t ntype = htonl (type);
+
+  GNUNET_memcpy (key,
+                 pkey,
+                 sizeof(*pkey));
+  GNUNET_memcpy (&key[sizeof(*pkey)],
+                 &ntype,
+                 sizeof(ntype));
+  GNUNET_memcpy (&key[sizeof(*pkey) + sizeof(ntype)],
+                 data,
+                 data_size);
+  GNUNET_CRYPTO_hash (key,
+                      sizeof(key),
+                      h);
+}
+
+
+/**
+ * Update the zone-to-name index for the delegations in @a entry.
+ *
+ * @param plugin the plugin context
+ * @param entry entry to index
+ * @param add #GNUNET_YES to add @a entry to the index,
+ *            #GNUNET_NO to remove it
+ */
+static void
+index_delegations (struct Plugin *plugin,
+                   struct FlatFileEntry *entry,
+                   int add)
+{
+  struct GNUNET_GNSRECORD_Data rd[GNUNET_NZL (entry->record_count)];
   struct GNUNET_HashCode hkey;
-  struct GNUNET_DISK_FileHandle *fh;
-  struct FlatFileEntry *entry;
-  struct GNUNET_DISK_MapHandle *mh;
 
   if (GNUNET_OK !=
-      GNUNET_CONFIGURATION_get_value_filename (plugin->cfg,
-                                               "namestore-flat",
-                                               "FILENAME",
-                                               &flatdbfile))
+      GNUNET_GNSRECORD_records_deserialize (entry->rd_len,
+                                            entry->rd_ser,
+                                            entry->record_count,
+                                            rd))
   {
-    GNUNET_log_config_missing (GNUNET_ERROR_TYPE_ERROR,
-                               "namestore-flat",
-                               "FILENAME");
-    return GNUNET_SYSERR;
+    GNUNET_break (0);
+    return;
   }
-  if (GNUNET_OK !=
-      GNUNET_DISK_file_test (flatdbfile))
+  for (unsigned int i = 0; i < entry->record_count; i++)
   {
-    if (GNUNET_OK !=
-        GNUNET_DISK_directory_create_for_file (flatdbfile))
-    {
-      GNUNET_break (0);
-      GNUNET_free (flatdbfile);
-      return GNUNET_SYSERR;
-    }
+    if (GNUNET_NO ==
+        GNUNET_GNSRECORD_is_zonekey_type (rd[i].record_type))
+      continue;
+    hash_pkey_and_value (&entry->private_key,
+                         rd[i].record_type,
+                         rd[i].data,
+                         rd[i].data_size,
+                         &hkey);
+    if (GNUNET_YES == add)
+      GNUNET_CONTAINER_multihashmap_put (plugin->ztn,
+                                         &hkey,
+                                         entry,
+                                         GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE);
+    else
+      GNUNET_CONTAINER_multihashmap_remove (plugin->ztn,
+                                            &hkey,
+                                            entry);
   }
-  /* flatdbfile should be UTF-8-encoded. If it isn't, it's a bug */
-  plugin->fn = flatdbfile;
+}
 
-  /* Load data from file into hashmap */
-  plugin->hm = GNUNET_CONTAINER_multihashmap_create (10,
-                                                     GNUNET_NO);
-  fh = GNUNET_DISK_file_open (flatdbfile,
-                              GNUNET_DISK_OPEN_CREATE
-                              | GNUNET_DISK_OPEN_READWRITE,
-                              GNUNET_DISK_PERM_USER_WRITE
-                              | GNUNET_DISK_PERM_USER_READ);
-  if (NULL == fh)
-  {
-    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
-                _ ("Unable to initialize file: %s.\n"),
-                flatdbfile);
-    return GNUNET_SYSERR;
-  }
-  if (GNUNET_SYSERR ==
-      GNUNET_DISK_file_size (flatdbfile,
-                             &size,
-                             GNUNET_YES,
-                             GNUNET_YES))
-  {
-    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
-                _ ("Unable to get filesize: %s.\n"),
-                flatdbfile);
-    GNUNET_DISK_file_close (fh);
-    return GNUNET_SYSERR;
-  }
-  if (size > SIZE_MAX)
-  {
-    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
-                _ ("File too big to map: %llu bytes.\n"),
-                (unsigned long long) size);
-    GNUNET_DISK_file_close (fh);
-    return GNUNET_SYSERR;
-  }
-  if (0 == size)
-  {
-    GNUNET_DISK_file_close (fh);
-    return GNUNET_OK;
-  }
-  buffer = GNUNET_DISK_file_map (fh,
-                                 &mh,
-                                 GNUNET_DISK_MAP_TYPE_READ,
-                                 size);
-  if (NULL == buffer)
+
+/**
+ * Number of bytes the log entry for @a entry takes.
+ *
+ * @param entry an entry
+ * @return size of the log entry
+ */
+static size_t
+entry_log_size (const struct FlatFileEntry *entry)
+{
+  return sizeof(struct LogRecord) + strlen (entry->label) + 1
+         + entry->rd_len;
+}
+
+
+/**
+ * Remove @a entry from all of our indices and free it.
+ *
+ * @param plugin the plugin context
+ * @param hkey hash of the zone and label of @a entry
+ * @param entry entry to remove
+ */
+static void
+remove_entry (struct Plugin *plugin,
+              const struct GNUNET_HashCode *hkey,
+              struct FlatFileEntry *entry)
+{
+  struct ZoneEntries *ze = entry->ze;
+
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (plugin->hm,
+                                                       hkey,
+                                                       entry));
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap32_remove (plugin->serials,
+                                                         (uint32_t) entry->
+                                                         serial,
+                                                         entry));
+  index_delegations (plugin,
+                     entry,
+                     GNUNET_NO);
+  GNUNET_CONTAINER_DLL_remove (plugin->head,
+                               plugin->tail,
+                               entry);
+  GNUNET_CONTAINER_MDLL_remove (zone,
+                                ze->head,
+                                ze->tail,
+                                entry);
+  if (NULL == ze->head)
   {
-    GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR,
-                         "mmap");
-    GNUNET_DISK_file_close (fh);
-    return GNUNET_SYSERR;
+    struct GNUNET_HashCode zkey;
+
+    GNUNET_CRYPTO_hash (&ze->zone,
+                        sizeof(ze->zone),
+                        &zkey);
+    GNUNET_assert (GNUNET_YES ==
+                   GNUNET_CONTAINER_multihashmap_remove (plugin->zones,
+                                                         &zkey,
+                                                         ze));
+    GNUNET_free (ze);
   }
-  if ('\0' != buffer[size - 1])
+  plugin->live_size -= entry_log_size (entry);
+  GNUNET_free (entry);
+}
+
+
+/**
+ * Replace the records of @a label in @a zone in memory.  A removed
+ * label keeps an entry without records, so that the removal shows
+ * up in the change journal.
+ *
+ * @param plugin the plugin context
+ * @param zone private key of the zone
+ * @param label name of the record set
+ * @param serial serial of the change, must be above all earlier ones
+ * @param record_count number of records, 0 to remove the label
+ * @param rd_ser serialized records
+ * @param rd_len number of bytes in @a rd_ser
+ */
+static void
+apply_change (struct Plugin *plugin,
+              const struct GNUNET_IDENTITY_PrivateKey *zone,
+              const char *label,
+              uint64_t serial,
+              uint32_t record_count,
+              const char *rd_ser,
+              size_t rd_len)
+{
+  struct GNUNET_HashCode hkey;
+  struct GNUNET_HashCode zkey;
+  struct FlatFileEntry *entry;
+  struct ZoneEntries *ze;
+  size_t label_len;
+
+  hash_pkey_and_label (zone,
+                       label,
+                       &hkey);
+  entry = GNUNET_CONTAINER_multihashmap_get (plugin->hm,
+                                             &hkey);
+  if (NULL != entry)
+    remove_entry (plugin,
+                  &hkey,
+                  entry);
+  GNUNET_CRYPTO_hash (zone,
+                      sizeof(*zone),
+                      &zkey);
+  ze = GNUNET_CONTAINER_multihashmap_get (plugin->zones,
+                                          &zkey);
+  if (NULL == ze)
   {
-    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
-                _ ("Namestore database file `%s' malformed\n"),
-                flatdbfile);
-    GNUNET_DISK_file_unmap (mh);
-    GNUNET_DISK_file_close (fh);
-    return GNUNET_SYSERR;
+    ze = GNUNET_new (struct ZoneEntries);
+    ze->zone = *zone;
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multihashmap_put (plugin->zones,
+                                                      &zkey,
+                                                      ze,
+                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
   }
+  label_len = strlen (label) + 1;
+  entry = GNUNET_malloc (sizeof(struct FlatFileEntry) + rd_len + label_len);
+  entry->ze = ze;
+  entry->private_key = *zone;
+  GNUNET_assert (serial > plugin->last_serial);
+  plugin->last_serial = serial;
+  entry->serial = serial;
+  entry->record_count = record_count;
+  entry->rd_len = rd_len;
+  entry->rd_ser = (const char *) &entry[1];
+  GNUNET_memcpy (&entry[1],
+                 rd_ser,
+                 rd_len);
+  entry->label = &entry->rd_ser[rd_len];
+  GNUNET_memcpy ((char *) entry->label,
+                 label,
+                 label_len);
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CONTAINER_multihashmap_put (plugin->hm,
+                                                    &hkey,
+                                                    entry,
+                                                    GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  GNUNET_CONTAINER_multihashmap32_put (plugin->serials,
+                                       (uint32_t) entry->serial,
+                                       entry,
+                                       GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE);
+  index_delegations (plugin,
+                     entry,
+                     GNUNET_YES);
+  GNUNET_CONTAINER_DLL_insert_tail (plugin->head,
+                                    plugin->tail,
+                                    entry);
+  GNUNET_CONTAINER_MDLL_insert_tail (zone,
+                                     ze->head,
+                                     ze->tail,
+                                     entry);
+  plugin->live_size += entry_log_size (entry);
+}
+
+
+/**
+ * Build the log entry for a change of the records of @a label.
+ *
+ * @param zone private key of the zone
+ * @param label name of the record set
+ * @param serial serial of the change
+ * @param record_count number of records, 0 to remove the label
+ * @param rd_ser serialized records
+ * @param rd_len number of bytes in @a rd_ser
+ * @return the log entry, to be freed by the caller
+ */
+static struct LogRecord *
+make_log_record (const struct GNUNET_IDENTITY_PrivateKey *zone,
+                 const char *label,
+                 uint64_t serial,
+                 uint32_t record_count,
+                 const char *rd_ser,
+                 size_t rd_len)
+{
+  struct LogRecord *lr;
+  size_t label_len = strlen (label) + 1;
+  size_t size = sizeof(struct LogRecord) + label_len + rd_len;
+  char *pos;
+
+  lr = GNUNET_malloc (size);
+  lr->size = htonl ((uint32_t) size);
+  lr->private_key = *zone;
+  lr->label_len = htons ((uint16_t) label_len);
+  lr->record_count = htons ((uint16_t) record_count);
+  lr->rd_len = htonl ((uint32_t) rd_len);
+  lr->serial = GNUNET_htonll (serial);
+  pos = (char *) &lr[1];
+  GNUNET_memcpy (pos,
+                 label,
+                 label_len);
+  GNUNET_memcpy (&pos[label_len],
+                 rd_ser,
+                 rd_len);
+  lr->crc = htonl (GNUNET_CRYPTO_crc32_n (((const char *) lr)
+                                          + 2 * sizeof(uint32_t),
+                                          size - 2 * sizeof(uint32_t)));
+  return lr;
+}
+
+
+/**
+ * Check that @a buf starts with a well-formed log entry.
+ *
+ * @param buf data from the database file
+ * @param left number of bytes in @a buf
+ * @param[out] lr set to the header of the entry; entries in the
+ *             file are not aligned, so we return a copy
+ * @return #GNUNET_OK if @a buf starts with a complete,
+ *         well-formed entry
+ */
+static int
+check_log_record (const char *buf,
+                  size_t left,
+                  struct LogRecord *lr)
+{
+  size_t size;
+  size_t label_len;
+  const char *label;
+
+  if (left < sizeof(struct LogRecord))
+    return GNUNET_NO;
+  GNUNET_memcpy (lr,
+                 buf,
+                 sizeof(*lr));
+  size = ntohl (lr->size);
+  label_len = ntohs (lr->label_len);
+  if ((size > left) ||
+      (size != sizeof(struct LogRecord) + label_len + ntohl (lr->rd_len)) ||
+      (0 == label_len))
+    return GNUNET_NO;
+  if (ntohl (lr->crc) !=
+      GNUNET_CRYPTO_crc32_n (&buf[2 * sizeof(uint32_t)],
+                             size - 2 * sizeof(uint32_t)))
+    return GNUNET_NO;
+  label = &buf[sizeof(struct LogRecord)];
+  if ('\0' != label[label_len - 1])
+    return GNUNET_NO;
+  return GNUNET_OK;
+}
+
+
+/**
+ * Load a database file in the (text-based) format used by earlier
+ * versions of this plugin.
+ *
+ * @param plugin the plugin context
+ * @param buffer 0-terminated file contents (modified)
+ * @return #GNUNET_OK on success
+ */
+static int
+load_legacy_file (struct Plugin *plugin,
+                  char *buffer)
+{
+  char *record_data;
+  char *zone_private_key;
+  char *record_data_b64;
+  char *line;
+  char *label;
+  char *rvalue;
+  char *record_count;
+  size_t record_data_size;
+  unsigned int rd_count;
 
   line = strtok (buffer, "\n");
   while (NULL != line)
@@ -242,163 +657,407 @@ database_setup (struct Plugin *plugin)
     if (NULL == label)
       break;
     line = strtok (NULL, "\n");
-    entry = GNUNET_new (struct FlatFileEntry);
+    if ((1 != sscanf (record_count,
+                      "%u",
+                      &rd_count)) ||
+        (rd_count > UINT16_MAX))
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                  "Error parsing entry\n");
+      break;
+    }
+    record_data_size
+      = GNUNET_STRINGS_base64_decode (record_data_b64,
+                                      strlen (record_data_b64),
+                                      (void **) &record_data);
     {
-      unsigned long long ll;
+      struct GNUNET_GNSRECORD_Data rd[GNUNET_NZL (rd_count)];
 
-      if (1 != sscanf (rvalue,
-                       "%llu",
-                       &ll))
+      if (GNUNET_OK !=
+          GNUNET_GNSRECORD_records_deserialize (record_data_size,
+                                                record_data,
+                                                rd_count,
+                                                rd))
       {
         GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
-                    "Error parsing entry\n");
-        GNUNET_free (entry);
+                    "Unable to deserialize record %s\n",
+                    label);
+        GNUNET_free (record_data);
         break;
       }
-      entry->rvalue = (uint64_t) ll;
     }
     {
-      unsigned int ui;
+      struct GNUNET_IDENTITY_PrivateKey *private_key;
 
-      if (1 != sscanf (record_count,
-                       "%u",
-                       &ui))
+      if (sizeof(struct GNUNET_IDENTITY_PrivateKey) !=
+          GNUNET_STRINGS_base64_decode (zone_private_key,
+                                        strlen (zone_private_key),
+                                        (void **) &private_key))
       {
         GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
                     "Error parsing entry\n");
-        GNUNET_free (entry);
+        GNUNET_free (private_key);
+        GNUNET_free (record_data);
         break;
       }
-      entry->record_count = (uint32_t) ui;
+      apply_change (plugin,
+                    private_key,
+                    label,
+                    plugin->last_serial + 1,
+                    rd_count,
+                    record_data,
+                    record_data_size);
+      GNUNET_free (private_key);
     }
-    entry->label = GNUNET_strdup (label);
-    record_data_size
-      = GNUNET_STRINGS_base64_decode (record_data_b64,
-                                      strlen (record_data_b64),
-                                      (void **) &record_data);
-    entry->record_data =
-      GNUNET_new_array (entry->record_count,
-                        struct GNUNET_GNSRECORD_Data);
-    if (GNUNET_OK !=
-        GNUNET_GNSRECORD_records_deserialize (record_data_size,
-                                              record_data,
-                                              entry->record_count,
-                                              entry->record_data))
+    GNUNET_free (record_data);
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Replay the database file in @a buffer into memory.
+ *
+ * @param plugin the plugin context
+ * @param buffer file contents
+ * @param size number of bytes in @a buffer
+ * @return number of bytes of @a buffer with well-formed entries
+ */
+static uint64_t
+load_log (struct Plugin *plugin,
+          const char *buffer,
+          uint64_t size)
+{
+  uint64_t off;
+  struct LogRecord lr;
+
+  off = LOG_MAGIC_LEN;
+  while (GNUNET_OK ==
+         check_log_record (&buffer[off],
+                           size - off,
+                           &lr))
+  {
+    const char *label = &buffer[off + sizeof(struct LogRecord)];
+    size_t label_len = ntohs (lr.label_len);
+    uint64_t serial = GNUNET_ntohll (lr.serial);
+
+    if (serial <= plugin->last_serial)
     {
-      GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
-                  "Unable to deserialize record %s\n",
-                  label);
-      GNUNET_free (entry->label);
-      GNUNET_free (entry);
-      GNUNET_free (record_data);
+      /* entries are written in serial order */
+      GNUNET_break_op (0);
       break;
     }
-    GNUNET_free (record_data);
+    apply_change (plugin,
+                  &lr.private_key,
+                  label,
+                  serial,
+                  ntohs (lr.record_count),
+                  &label[label_len],
+                  ntohl (lr.rd_len));
+    off += ntohl (lr.size);
+  }
+  return off;
+}
 
-    {
-      struct GNUNET_IDENTITY_PrivateKey *private_key;
 
-      GNUNET_STRINGS_base64_decode (zone_private_key,
-                                    strlen (zone_private_key),
-                                    (void **) &private_key);
-      entry->private_key = *private_key;
-      GNUNET_free (private_key);
+/**
+ * Open the database file for appending.
+ *
+ * @param plugin the plugin context
+ * @return #GNUNET_OK on success
+ */
+static int
+open_log (struct Plugin *plugin)
+{
+  plugin->fh = GNUNET_DISK_file_open (plugin->fn,
+                                      GNUNET_DISK_OPEN_CREATE
+                                      | GNUNET_DISK_OPEN_READWRITE,
+                                      GNUNET_DISK_PERM_USER_WRITE
+                                      | GNUNET_DISK_PERM_USER_READ);
+  if (NULL == plugin->fh)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                _ ("Unable to initialize file: %s.\n"),
+                plugin->fn);
+    return GNUNET_SYSERR;
+  }
+  if (GNUNET_SYSERR ==
+      GNUNET_DISK_file_seek (plugin->fh,
+                             plugin->log_size,
+                             GNUNET_DISK_SEEK_SET))
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "seek",
+                              plugin->fn);
+    GNUNET_DISK_file_close (plugin->fh);
+    plugin->fh = NULL;
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Rewrite the database file with only the current record sets.
+ * The new file is written next to the old one and then renamed,
+ * so that a crash during compaction leaves the old file intact.
+ *
+ * @param plugin the plugin context
+ * @return #GNUNET_OK on success
+ */
+static int
+compact_log (struct Plugin *plugin)
+{
+  struct GNUNET_DISK_FileHandle *fh;
+  char *tmp;
+  uint64_t size;
+
+  GNUNET_asprintf (&tmp,
+                   "%s~",
+                   plugin->fn);
+  fh = GNUNET_DISK_file_open (tmp,
+                              GNUNET_DISK_OPEN_CREATE
+                              | GNUNET_DISK_OPEN_TRUNCATE
+                              | GNUNET_DISK_OPEN_WRITE,
+                              GNUNET_DISK_PERM_USER_WRITE
+                              | GNUNET_DISK_PERM_USER_READ);
+  if (NULL == fh)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                _ ("Unable to initialize file: %s.\n"),
+                tmp);
+    GNUNET_free (tmp);
+    return GNUNET_SYSERR;
+  }
+  size = LOG_MAGIC_LEN;
+  if (LOG_MAGIC_LEN !=
+      GNUNET_DISK_file_write (fh,
+                              LOG_MAGIC,
+                              LOG_MAGIC_LEN))
+    goto fail;
+  /* write in serial order, reloading expects ascending serials */
+  for (struct FlatFileEntry *entry = plugin->head;
+       NULL != entry;
+       entry = entry->next)
+  {
+    struct LogRecord *lr;
+    size_t lr_size;
+
+    lr = make_log_record (&entry->private_key,
+                          entry->label,
+                          entry->serial,
+                          entry->record_count,
+                          entry->rd_ser,
+                          entry->rd_len);
+    lr_size = ntohl (lr->size);
+    if (lr_size !=
+        GNUNET_DISK_file_write (fh,
+                                lr,
+                                lr_size))
+    {
+      GNUNET_free (lr);
+      goto fail;
     }
+    GNUNET_free (lr);
+    size += lr_size;
+  }
+  if (GNUNET_OK !=
+      GNUNET_DISK_file_sync (fh))
+    goto fail;
+  GNUNET_DISK_file_close (fh);
+  if (0 != rename (tmp,
+                   plugin->fn))
+  {
+    GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                              "rename",
+                              tmp);
+    GNUNET_break (0 == unlink (tmp));
+    GNUNET_free (tmp);
+    return GNUNET_SYSERR;
+  }
+  GNUNET_free (tmp);
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Compacted flat database from %llu to %llu bytes\n",
+              (unsigned long long) plugin->log_size,
+              (unsigned long long) size);
+  if (NULL != plugin->fh)
+    GNUNET_DISK_file_close (plugin->fh);
+  plugin->log_size = size;
+  return open_log (plugin);
+fail:
+  GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                            "write",
+                            tmp);
+  GNUNET_DISK_file_close (fh);
+  GNUNET_break (0 == unlink (tmp));
+  GNUNET_free (tmp);
+  return GNUNET_SYSERR;
+}
 
-    hash_pkey_and_label (&entry->private_key,
-                         label,
-                         &hkey);
+
+/**
+ * Initialize the database connections and associated
+ * data structures (create tables and indices
+ * as needed as well).
+ *
+ * @param plugin the plugin context (state for this module)
+ * @return #GNUNET_OK on success
+ */
+static int
+database_setup (struct Plugin *plugin)
+{
+  char *flatdbfile;
+  char *buffer;
+  uint64_t size;
+  uint64_t valid;
+  struct GNUNET_DISK_FileHandle *fh;
+  struct GNUNET_DISK_MapHandle *mh;
+  int legacy;
+
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_filename (plugin->cfg,
+                                               "namestore-flat",
+                                               "FILENAME",
+                                               &flatdbfile))
+  {
+    GNUNET_log_config_missing (GNUNET_ERROR_TYPE_ERROR,
+                               "namestore-flat",
+                               "FILENAME");
+    return GNUNET_SYSERR;
+  }
+  if (GNUNET_OK !=
+      GNUNET_DISK_file_test (flatdbfile))
+  {
     if (GNUNET_OK !=
-        GNUNET_CONTAINER_multihashmap_put (plugin->hm,
-                                           &hkey,
-                                           entry,
-                                           GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY))
+        GNUNET_DISK_directory_create_for_file (flatdbfile))
     {
-      GNUNET_free (entry);
       GNUNET_break (0);
+      GNUNET_free (flatdbfile);
+      return GNUNET_SYSERR;
     }
   }
-  GNUNET_DISK_file_unmap (mh);
-  GNUNET_DISK_file_close (fh);
-  return GNUNET_OK;
-}
-
+  /* flatdbfile should be UTF-8-encoded. If it isn't, it's a bug */
+  plugin->fn = flatdbfile;
+  plugin->sync = GNUNET_CONFIGURATION_get_value_yesno (plugin->cfg,
+                                                       "namestore-flat",
+                                                       "SYNC");
 
-/**
- * Store values in hashmap in file and free data
- *
- * @param plugin the plugin context
- * @param key key in the map
- * @param value a `struct FlatFileEntry`
- */
-static int
-store_and_free_entries (void *cls,
-                        const struct GNUNET_HashCode *key,
-                        void *value)
-{
-  struct GNUNET_DISK_FileHandle *fh = cls;
-  struct FlatFileEntry *entry = value;
-  char *line;
-  char *zone_private_key;
-  char *record_data_b64;
-  ssize_t data_size;
+  plugin->hm = GNUNET_CONTAINER_multihashmap_create (10,
+                                                     GNUNET_NO);
+  plugin->zones = GNUNET_CONTAINER_multihashmap_create (4,
+                                                        GNUNET_NO);
+  plugin->ztn = GNUNET_CONTAINER_multihashmap_create (10,
+                                                      GNUNET_NO);
+  plugin->serials = GNUNET_CONTAINER_multihashmap32_create (10);
 
-  (void) key;
-  GNUNET_STRINGS_base64_encode (&entry->private_key,
-                                sizeof(struct GNUNET_IDENTITY_PrivateKey),
-                                &zone_private_key);
-  data_size = GNUNET_GNSRECORD_records_get_size (entry->record_count,
-                                                 entry->record_data);
-  if (data_size < 0)
+  /* Replay the log from the file */
+  fh = GNUNET_DISK_file_open (flatdbfile,
+                              GNUNET_DISK_OPEN_CREATE
+                              | GNUNET_DISK_OPEN_READWRITE,
+                              GNUNET_DISK_PERM_USER_WRITE
+                              | GNUNET_DISK_PERM_USER_READ);
+  if (NULL == fh)
   {
-    GNUNET_break (0);
-    GNUNET_free (zone_private_key);
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                _ ("Unable to initialize file: %s.\n"),
+                flatdbfile);
     return GNUNET_SYSERR;
   }
-  if (data_size >= UINT16_MAX)
+  if (GNUNET_SYSERR ==
+      GNUNET_DISK_file_size (flatdbfile,
+                             &size,
+                             GNUNET_YES,
+                             GNUNET_YES))
   {
-    GNUNET_break (0);
-    GNUNET_free (zone_private_key);
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                _ ("Unable to get filesize: %s.\n"),
+                flatdbfile);
+    GNUNET_DISK_file_close (fh);
     return GNUNET_SYSERR;
   }
+  if (size > SIZE_MAX)
   {
-    char data[data_size];
-    ssize_t ret;
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                _ ("File too big to map: %llu bytes.\n"),
+                (unsigned long long) size);
+    GNUNET_DISK_file_close (fh);
+    return GNUNET_SYSERR;
+  }
+  if (0 == size)
+  {
+    GNUNET_DISK_file_close (fh);
+    /* fresh database, start with the magic */
+    return compact_log (plugin);
+  }
+  buffer = GNUNET_DISK_file_map (fh,
+                                 &mh,
+                                 GNUNET_DISK_MAP_TYPE_READ,
+                                 size);
+  if (NULL == buffer)
+  {
+    GNUNET_log_strerror (GNUNET_ERROR_TYPE_ERROR,
+                         "mmap");
+    GNUNET_DISK_file_close (fh);
+    return GNUNET_SYSERR;
+  }
+  legacy = ((size < LOG_MAGIC_LEN) ||
+            (0 != memcmp (buffer,
+                          LOG_MAGIC,
+                          LOG_MAGIC_LEN)));
+  if (legacy)
+  {
+    char *copy;
 
-    ret = GNUNET_GNSRECORD_records_serialize (entry->record_count,
-                                              entry->record_data,
-                                              data_size,
-                                              data);
-    if ((ret < 0) ||
-        (data_size != ret))
+    if ('\0' != buffer[size - 1])
     {
-      GNUNET_break (0);
-      GNUNET_free (zone_private_key);
+      GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                  _ ("Namestore database file `%s' malformed\n"),
+                  flatdbfile);
+      GNUNET_DISK_file_unmap (mh);
+      GNUNET_DISK_file_close (fh);
       return GNUNET_SYSERR;
     }
-    GNUNET_STRINGS_base64_encode (data,
-                                  data_size,
-                                  &record_data_b64);
-  }
-  GNUNET_asprintf (&line,
-                   "%s,%llu,%u,%s,%s\n",
-                   zone_private_key,
-                   (unsigned long long) entry->rvalue,
-                   (unsigned int) entry->record_count,
-                   record_data_b64,
-                   entry->label);
-  GNUNET_free (record_data_b64);
-  GNUNET_free (zone_private_key);
-
-  GNUNET_DISK_file_write (fh,
-                          line,
-                          strlen (line));
-
-  GNUNET_free (line);
-  GNUNET_free (entry->label);
-  GNUNET_free (entry->record_data);
-  GNUNET_free (entry);
-  return GNUNET_YES;
+    GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+                "Converting namestore database file `%s' to the new format\n",
+                flatdbfile);
+    copy = GNUNET_malloc (size);
+    GNUNET_memcpy (copy,
+                   buffer,
+                   size);
+    load_legacy_file (plugin,
+                      copy);
+    GNUNET_free (copy);
+    valid = size;
+  }
+  else
+  {
+    valid = load_log (plugin,
+                      buffer,
+                      size);
+  }
+  GNUNET_DISK_file_unmap (mh);
+  if (valid < size)
+  {
+    /* partially written entry from a crash, drop it */
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                _ ("Dropping %llu bytes of malformed data at the end of `%s'\n"),
+                (unsigned long long) (size - valid),
+                flatdbfile);
+    if (0 != ftruncate (fh->fd,
+                        (off_t) valid))
+    {
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                                "ftruncate",
+                                flatdbfile);
+      GNUNET_DISK_file_close (fh);
+      return GNUNET_SYSERR;
+    }
+  }
+  GNUNET_DISK_file_close (fh);
+  plugin->log_size = valid;
+  if (legacy)
+    return compact_log (plugin);
+  return open_log (plugin);
 }
 
 
@@ -410,31 +1069,53 @@ store_and_free_entries (void *cls,
 static void
 database_shutdown (struct Plugin *plugin)
 {
-  struct GNUNET_DISK_FileHandle *fh;
+  struct FlatFileEntry *entry;
+  struct ZoneEntries *ze;
 
-  fh = GNUNET_DISK_file_open (plugin->fn,
-                              GNUNET_DISK_OPEN_CREATE
-                              | GNUNET_DISK_OPEN_TRUNCATE
-                              | GNUNET_DISK_OPEN_READWRITE,
-                              GNUNET_DISK_PERM_USER_WRITE
-                              | GNUNET_DISK_PERM_USER_READ);
-  if (NULL == fh)
+  if ((NULL != plugin->fh) &&
+      (plugin->log_size > COMPACT_MIN_SIZE) &&
+      (plugin->log_size > 2 * plugin->live_size))
+    (void) compact_log (plugin);
+  if (NULL != plugin->fh)
   {
-    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
-                _ ("Unable to initialize file: %s.\n"),
-                plugin->fn);
-    return;
+    GNUNET_DISK_file_close (plugin->fh);
+    plugin->fh = NULL;
   }
-
-  GNUNET_CONTAINER_multihashmap_iterate (plugin->hm,
-                                         &store_and_free_entries,
-                                         fh);
-  GNUNET_CONTAINER_multihashmap_destroy (plugin->hm);
-  /* append 0-terminator */
-  GNUNET_DISK_file_write (fh,
-                          "",
-                          1);
-  GNUNET_DISK_file_close (fh);
+  while (NULL != (entry = plugin->head))
+  {
+    ze = entry->ze;
+    GNUNET_CONTAINER_DLL_remove (plugin->head,
+                                 plugin->tail,
+                                 entry);
+    GNUNET_CONTAINER_MDLL_remove (zone,
+                                  ze->head,
+                                  ze->tail,
+                                  entry);
+    if (NULL == ze->head)
+      GNUNET_free (ze);
+    GNUNET_free (entry);
+  }
+  if (NULL != plugin->hm)
+  {
+    GNUNET_CONTAINER_multihashmap_destroy (plugin->hm);
+    plugin->hm = NULL;
+  }
+  if (NULL != plugin->zones)
+  {
+    GNUNET_CONTAINER_multihashmap_destroy (plugin->zones);
+    plugin->zones = NULL;
+  }
+  if (NULL != plugin->ztn)
+  {
+    GNUNET_CONTAINER_multihashmap_destroy (plugin->ztn);
+    plugin->ztn = NULL;
+  }
+  if (NULL != plugin->serials)
+  {
+    GNUNET_CONTAINER_multihashmap32_destroy (plugin->serials);
+    plugin->serials = NULL;
+  }
+  GNUNET_free (plugin->fn);
 }
 
 
@@ -458,50 +1139,134 @@ namestore_flat_store_records (void *cls,
                               const struct GNUNET_GNSRECORD_Data *rd)
 {
   struct Plugin *plugin = cls;
-  uint64_t rvalue;
-  struct GNUNET_HashCode hkey;
-  struct FlatFileEntry *entry;
+  struct LogRecord *lr;
+  ssize_t data_size;
+  size_t lr_size;
 
-  rvalue = GNUNET_CRYPTO_random_u64 (GNUNET_CRYPTO_QUALITY_WEAK,
-                                     UINT64_MAX);
-  hash_pkey_and_label (zone_key,
-                       label,
-                       &hkey);
-  GNUNET_CONTAINER_multihashmap_remove_all (plugin->hm,
-                                            &hkey);
-  if (0 == rd_count)
+  if (NULL == plugin->fh)
+    return GNUNET_SYSERR; /* failed to reopen the log after compaction */
+  if ((rd_count > UINT16_MAX) ||
+      (strlen (label) >= UINT16_MAX))
+  {
+    GNUNET_break (0);
+    return GNUNET_SYSERR;
+  }
+  data_size = GNUNET_GNSRECORD_records_get_size (rd_count,
+                                                 rd);
+  if (data_size < 0)
+  {
+    GNUNET_break (0);
+    return GNUNET_SYSERR;
+  }
+  if (data_size >= UINT16_MAX)
+  {
+    GNUNET_break (0);
+    return GNUNET_SYSERR;
+  }
   {
+    char data[GNUNET_NZL (data_size)];
+    ssize_t ret;
+
+    ret = GNUNET_GNSRECORD_records_serialize (rd_count,
+                                              rd,
+                                              data_size,
+                                              data);
+    if ((ret < 0) ||
+        (data_size != ret))
+    {
+      GNUNET_break (0);
+      return GNUNET_SYSERR;
+    }
+    /* write the change to disk before we report success */
+    lr = make_log_record (zone_key,
+                          label,
+                          plugin->last_serial + 1,
+                          rd_count,
+                          data,
+                          data_size);
+    lr_size = ntohl (lr->size);
+    if (lr_size !=
+        GNUNET_DISK_file_write (plugin->fh,
+                                lr,
+                                lr_size))
+    {
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                                "write",
+                                plugin->fn);
+      GNUNET_free (lr);
+      /* undo a partial write, if any */
+      if (0 != ftruncate (plugin->fh->fd,
+                          (off_t) plugin->log_size))
+        GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_ERROR,
+                                  "ftruncate",
+                                  plugin->fn);
+      (void) GNUNET_DISK_file_seek (plugin->fh,
+                                    plugin->log_size,
+                                    GNUNET_DISK_SEEK_SET);
+      return GNUNET_SYSERR;
+    }
+    GNUNET_free (lr);
+    if ((GNUNET_YES == plugin->sync) &&
+        (GNUNET_OK !=
+         GNUNET_DISK_file_sync (plugin->fh)))
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
+                                "sync",
+                                plugin->fn);
+    plugin->log_size += lr_size;
+    apply_change (plugin,
+                  zone_key,
+                  label,
+                  plugin->last_serial + 1,
+                  rd_count,
+                  data,
+                  data_size);
+  }
+  if (0 == rd_count)
     GNUNET_log_from (GNUNET_ERROR_TYPE_DEBUG,
-                     "sqlite",
+                     "flat",
                      "Record deleted\n");
-    return GNUNET_OK;
-  }
-  entry = GNUNET_new (struct FlatFileEntry);
-  GNUNET_asprintf (&entry->label,
-                   label,
-                   strlen (label));
-  GNUNET_memcpy (&entry->private_key,
-                 zone_key,
-                 sizeof(struct GNUNET_IDENTITY_PrivateKey));
-  entry->rvalue = rvalue;
-  entry->record_count = rd_count;
-  entry->record_data = GNUNET_new_array (rd_count,
-                                         struct GNUNET_GNSRECORD_Data);
-  for (unsigned int i = 0; i < rd_count; i++)
-  {
-    entry->record_data[i].expiration_time = rd[i].expiration_time;
-    entry->record_data[i].record_type = rd[i].record_type;
-    entry->record_data[i].flags = rd[i].flags;
-    entry->record_data[i].data_size = rd[i].data_size;
-    entry->record_data[i].data = GNUNET_malloc (rd[i].data_size);
-    GNUNET_memcpy ((char *) entry->record_data[i].data,
-                   rd[i].data,
-                   rd[i].data_size);
-  }
-  return GNUNET_CONTAINER_multihashmap_put (plugin->hm,
-                                            &hkey,
-                                            entry,
-                                            GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY);
+  if ((plugin->log_size > COMPACT_MIN_SIZE) &&
+      (plugin->log_size > 2 * plugin->live_size))
+  {
+    if (GNUNET_OK != compact_log (plugin))
+    {
+      /* the change is in the log, but we can no longer append */
+      GNUNET_break (0);
+      return (NULL == plugin->fh) ? GNUNET_SYSERR : GNUNET_OK;
+    }
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Call @a iter with the records of @a entry.
+ *
+ * @param entry entry to return
+ * @param zone zone to pass to @a iter
+ * @param iter function to call with the result
+ * @param iter_cls closure for @a iter
+ */
+static void
+call_iterator (const struct FlatFileEntry *entry,
+               const struct GNUNET_IDENTITY_PrivateKey *zone,
+               GNUNET_NAMESTORE_RecordIterator iter,
+               void *iter_cls)
+{
+  struct GNUNET_GNSRECORD_Data rd[GNUNET_NZL (entry->record_count)];
+
+  /* we checked the data when it was added */
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_GNSRECORD_records_deserialize (entry->rd_len,
+                                                       entry->rd_ser,
+                                                       entry->record_count,
+                                                       rd));
+  iter (iter_cls,
+        entry->serial,
+        zone,
+        entry->label,
+        entry->record_count,
+        rd);
 }
 
 
@@ -537,104 +1302,140 @@ namestore_flat_lookup_records (void *cls,
   entry = GNUNET_CONTAINER_multihashmap_get (plugin->hm,
                                              &hkey);
 
-  if (NULL == entry)
+  if ((NULL == entry) ||
+      (0 == entry->record_count))
     return GNUNET_NO;
   if (NULL != iter)
-    iter (iter_cls,
-          1, /* zero is illegal */
-          &entry->private_key,
-          entry->label,
-          entry->record_count,
-          entry->record_data);
+    call_iterator (entry,
+                   &entry->private_key,
+                   iter,
+                   iter_cls);
   return GNUNET_YES;
 }
 
 
 /**
- * Closure for #iterate_zones.
+ * Closure for #find_serial.
  */
-struct IterateContext
+struct FindSerialContext
 {
   /**
-   * How many more records should we skip before returning results?
-   */
-  uint64_t offset;
-
-  /**
-   * How many more records should we return?
-   */
-  uint64_t limit;
-
-  /**
-   * What is the position of the current entry, counting
-   * starts from 1.
-   */
-  uint64_t pos;
-
-  /**
-   * Target zone.
+   * Serial we are looking for.
    */
-  const struct GNUNET_IDENTITY_PrivateKey *zone;
+  uint64_t serial;
 
   /**
-   * Function to call on each record.
+   * Set to the entry with @e serial, if found.
    */
-  GNUNET_NAMESTORE_RecordIterator iter;
-
-  /**
-   * Closure for @e iter.
-   */
-  void *iter_cls;
+  struct FlatFileEntry *entry;
 };
 
 
 /**
- * Helper function for #namestore_flat_iterate_records().
+ * Check if @a value is the entry with the serial we look for.
  *
- * @param cls a `struct IterateContext`
- * @param key unused
+ * @param cls a `struct FindSerialContext`
+ * @param key truncated serial
  * @param value a `struct FlatFileEntry`
- * @return #GNUNET_YES to continue the iteration
+ * @return #GNUNET_NO if we found the entry
  */
 static int
-iterate_zones (void *cls,
-               const struct GNUNET_HashCode *key,
-               void *value)
+find_serial (void *cls,
+             uint32_t key,
+             void *value)
 {
-  struct IterateContext *ic = cls;
+  struct FindSerialContext *fsc = cls;
   struct FlatFileEntry *entry = value;
 
   (void) key;
-  if (0 == ic->limit)
-    return GNUNET_NO;
-  if ((NULL != ic->zone) &&
-      (0 != GNUNET_memcmp (&entry->private_key,
-                           ic->zone)))
+  if (entry->serial != fsc->serial)
     return GNUNET_YES;
-  ic->pos++;
-  if (ic->offset > 0)
+  fsc->entry = entry;
+  return GNUNET_NO;
+}
+
+
+/**
+ * Call @a iter with the entries that follow @a serial, in the order
+ * of their serials.  Will return at most @a limit results.
+ *
+ * @param plugin the plugin context
+ * @param zone zone to iterate, NULL to iterate over all zones
+ * @param serial serial of the entry to start after
+ * @param limit maximum number of results to return to @a iter
+ * @param removed #GNUNET_YES to also return removed labels
+ * @param iter function to call with the result
+ * @param iter_cls closure for @a iter
+ * @return #GNUNET_OK on success, #GNUNET_NO if there were no more results
+ */
+static int
+iterate_entries (struct Plugin *plugin,
+                 const struct GNUNET_IDENTITY_PrivateKey *zone,
+                 uint64_t serial,
+                 uint64_t limit,
+                 int removed,
+                 GNUNET_NAMESTORE_RecordIterator iter,
+                 void *iter_cls)
+{
+  struct ZoneEntries *ze;
+  struct FlatFileEntry *pos;
+  struct FindSerialContext fsc = {
+    .serial = serial
+  };
+
+  ze = NULL;
+  if (NULL != zone)
   {
-    ic->offset--;
-    return GNUNET_YES;
+    struct GNUNET_HashCode zkey;
+
+    GNUNET_CRYPTO_hash (zone,
+                        sizeof(*zone),
+                        &zkey);
+    ze = GNUNET_CONTAINER_multihashmap_get (plugin->zones,
+                                            &zkey);
+    if (NULL == ze)
+      return GNUNET_NO;
   }
-  ic->iter (ic->iter_cls,
-            ic->pos,
-            (NULL == ic->zone)
-            ? &entry->private_key
-            : ic->zone,
-            entry->label,
-            entry->record_count,
-            entry->record_data);
-  ic->limit--;
-  if (0 == ic->limit)
-    return GNUNET_NO;
-  return GNUNET_YES;
+  /* usually, @a serial is the last entry we returned */
+  if (0 != serial)
+    GNUNET_CONTAINER_multihashmap32_get_multiple (plugin->serials,
+                                                  (uint32_t) serial,
+                                                  &find_serial,
+                                                  &fsc);
+  if ((NULL != fsc.entry) &&
+      ((NULL == ze) || (ze == fsc.entry->ze)))
+  {
+    pos = (NULL == ze) ? fsc.entry->next : fsc.entry->next_zone;
+  }
+  else
+  {
+    /* entry changed in the meantime, find the next one */
+    pos = (NULL == ze) ? plugin->head : ze->head;
+    while ((NULL != pos) &&
+           (pos->serial <= serial))
+      pos = (NULL == ze) ? pos->next : pos->next_zone;
+  }
+  while ((0 < limit) &&
+         (NULL != pos))
+  {
+    if ((GNUNET_YES == removed) ||
+        (0 != pos->record_count))
+    {
+      call_iterator (pos,
+                     (NULL == zone) ? &pos->private_key : zone,
+                     iter,
+                     iter_cls);
+      limit--;
+    }
+    pos = (NULL == ze) ? pos->next : pos->next_zone;
+  }
+  return (0 == limit) ? GNUNET_OK : GNUNET_NO;
 }
 
 
 /**
  * Iterate over the results for a particular key and zone in the
- * datastore.  Will return at most one result to the iterator.
+ * datastore.  Will return at most @a limit results to the iterator.
  *
  * @param cls closure (internal context for the plugin)
  * @param zone hash of public key of the zone, NULL to iterate over all zones
@@ -653,70 +1454,46 @@ namestore_flat_iterate_records (void *cls,
                                 GNUNET_NAMESTORE_RecordIterator iter,
                                 void *iter_cls)
 {
-  struct Plugin *plugin = cls;
-  struct IterateContext ic;
-
-  ic.offset = serial;
-  ic.pos = 0;
-  ic.limit = limit;
-  ic.iter = iter;
-  ic.iter_cls = iter_cls;
-  ic.zone = zone;
-  GNUNET_CONTAINER_multihashmap_iterate (plugin->hm,
-                                         &iterate_zones,
-                                         &ic);
-  return (0 == ic.limit) ? GNUNET_OK : GNUNET_NO;
+  return iterate_entries (cls,
+                          zone,
+                          serial,
+                          limit,
+                          GNUNET_NO,
+                          iter,
+                          iter_cls);
 }
 
 
 /**
- * Closure for #zone_to_name.
+ * Iterate over the labels that changed after @a since.  The serials
+ * of our entries grow with each change and removed labels keep an
+ * empty entry, so the entries themselves are the change journal.
+ * Will return at most @a limit results to the iterator.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @param zone private key of the zone, NULL to iterate over all zones
+ * @param since journal serial number to exclude
+ * @param limit maximum number of results to return
+ * @param iter function to call with the result
+ * @param iter_cls closure for @a iter
+ * @return #GNUNET_OK on success, #GNUNET_NO if there were no more results, #GNUNET_SYSERR on error
  */
-struct ZoneToNameContext
-{
-  const struct GNUNET_IDENTITY_PrivateKey *zone;
-  const struct GNUNET_IDENTITY_PublicKey *value_zone;
-  GNUNET_NAMESTORE_RecordIterator iter;
-  void *iter_cls;
-
-  int result_found;
-};
-
-
 static int
-zone_to_name (void *cls,
-              const struct GNUNET_HashCode *key,
-              void *value)
+namestore_flat_iterate_changes (void *cls,
+                                const struct
+                                GNUNET_IDENTITY_PrivateKey *zone,
+                                uint64_t since,
+                                uint64_t limit,
+                                GNUNET_NAMESTORE_RecordIterator iter,
+                                void *iter_cls)
 {
-  struct ZoneToNameContext *ztn = cls;
-  struct FlatFileEntry *entry = value;
-
-  (void) key;
-  if (0 != GNUNET_memcmp (&entry->private_key,
-                          ztn->zone))
-    return GNUNET_YES;
-
-  for (unsigned int i = 0; i < entry->record_count; i++)
-  {
-    if (GNUNET_NO ==
-        GNUNET_GNSRECORD_is_zonekey_type (entry->record_data[i].record_type))
-      continue;
-    if (ztn->value_zone->type != entry->record_data[i].record_type)
-      continue;
-    if (0 == memcmp (ztn->value_zone,
-                     entry->record_data[i].data,
-                     entry->record_data[i].data_size))
-    {
-      ztn->iter (ztn->iter_cls,
-                 i + 1,    /* zero is illegal! */
-                 &entry->private_key,
-                 entry->label,
-                 entry->record_count,
-                 entry->record_data);
-      ztn->result_found = GNUNET_YES;
-    }
-  }
-  return GNUNET_YES;
+  return iterate_entries (cls,
+                          zone,
+                          since,
+                          limit,
+                          GNUNET_YES,
+                          iter,
+                          iter_cls);
 }
 
 
@@ -740,21 +1517,36 @@ namestore_flat_zone_to_name (void *cls,
                              void *iter_cls)
 {
   struct Plugin *plugin = cls;
-  struct ZoneToNameContext ztn = {
-    .iter = iter,
-    .iter_cls = iter_cls,
-    .zone = zone,
-    .value_zone = value_zone,
-    .result_found = GNUNET_NO
-  };
+  struct GNUNET_HashCode hkey;
+  struct FlatFileEntry *entry;
+  char *data;
+  size_t data_size;
+  uint32_t type;
 
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Performing reverse lookup for `%s'\n",
               GNUNET_GNSRECORD_z2s (value_zone));
-  GNUNET_CONTAINER_multihashmap_iterate (plugin->hm,
-                                         &zone_to_name,
-                                         &ztn);
-  return ztn.result_found;
+  if (GNUNET_OK !=
+      GNUNET_GNSRECORD_data_from_identity (value_zone,
+                                           &data,
+                                           &data_size,
+                                           &type))
+    return GNUNET_SYSERR;
+  hash_pkey_and_value (zone,
+                       type,
+                       data,
+                       data_size,
+                       &hkey);
+  GNUNET_free (data);
+  entry = GNUNET_CONTAINER_multihashmap_get (plugin->ztn,
+                                             &hkey);
+  if (NULL == entry)
+    return GNUNET_NO;
+  call_iterator (entry,
+                 &entry->private_key,
+                 iter,
+                 iter_cls);
+  return GNUNET_YES;
 }
 
 
@@ -780,12 +1572,14 @@ libgnunet_plugin_namestore_flat_init (void *cls)
   if (GNUNET_OK != database_setup (&plugin))
   {
     database_shutdown (&plugin);
+    plugin.cfg = NULL;
     return NULL;
   }
   api = GNUNET_new (struct GNUNET_NAMESTORE_PluginFunctions);
   api->cls = &plugin;
   api->store_records = &namestore_flat_store_records;
   api->iterate_records = &namestore_flat_iterate_records;
+  api->iterate_changes = &namestore_flat_iterate_changes;
   api->zone_to_name = &namestore_flat_zone_to_name;
   api->lookup_records = &namestore_flat_lookup_records;
   GNUNET_log (GNUNET_ERROR_TYPE_INFO,
@@ -48,6 +48,12 @@ struct Plugin
    * Postgres database handle.
    */
   struct GNUNET_PQ_Context *dbh;
+
+  /**
+   * #GNUNET_YES while a transaction started with
+   * #namestore_postgres_begin_transaction() is open.
+   */
+  int in_transaction;
 };
 
 
@@ -85,7 +91,23 @@ database_setup (struct Plugin *plugin)
                             " label TEXT NOT NULL DEFAULT '',"
                             " CONSTRAINT zl UNIQUE (zone_private_key,label)"
                             ")");
+  struct GNUNET_PQ_ExecuteStatement ec_temporary =
+    GNUNET_PQ_make_execute (
+      "CREATE TEMPORARY TABLE IF NOT EXISTS ns098changes ("
+      " seq BIGSERIAL PRIMARY KEY,"
+      " zone_private_key BYTEA NOT NULL DEFAULT '',"
+      " label TEXT NOT NULL DEFAULT '',"
+      " CONSTRAINT zlc UNIQUE (zone_private_key,label)"
+      ")");
+  struct GNUNET_PQ_ExecuteStatement ec_default =
+    GNUNET_PQ_make_execute ("CREATE TABLE IF NOT EXISTS ns098changes ("
+                            " seq BIGSERIAL PRIMARY KEY,"
+                            " zone_private_key BYTEA NOT NULL DEFAULT '',"
+                            " label TEXT NOT NULL DEFAULT '',"
+                            " CONSTRAINT zlc UNIQUE (zone_private_key,label)"
+                            ")");
   const struct GNUNET_PQ_ExecuteStatement *cr;
+  const struct GNUNET_PQ_ExecuteStatement *cc;
   struct GNUNET_PQ_ExecuteStatement sc = GNUNET_PQ_EXECUTE_STATEMENT_END;
 
   if (GNUNET_YES ==
@@ -94,10 +116,12 @@ database_setup (struct Plugin *plugin)
                                             "TEMPORARY_TABLE"))
   {
     cr = &es_temporary;
+    cc = &ec_temporary;
   }
   else
   {
     cr = &es_default;
+    cc = &ec_default;
   }
 
   if (GNUNET_YES ==
@@ -117,6 +141,9 @@ database_setup (struct Plugin *plugin)
                                   "ON ns098records (label)"),
       GNUNET_PQ_make_try_execute ("CREATE INDEX IF NOT EXISTS zone_label "
                                   "ON ns098records (zone_private_key,label)"),
+      *cc,
+      GNUNET_PQ_make_try_execute ("CREATE INDEX IF NOT EXISTS ic_iter "
+                                  "ON ns098changes (zone_private_key,seq)"),
       sc,
       GNUNET_PQ_EXECUTE_STATEMENT_END
     };
@@ -151,6 +178,37 @@ database_setup (struct Plugin *plugin)
                               "SELECT seq,record_count,record_data,label "
                               "FROM ns098records WHERE zone_private_key=$1 AND label=$2",
                               2),
+      GNUNET_PQ_make_prepare ("note_change",
+                              "INSERT INTO ns098changes"
+                              " (zone_private_key, label)"
+                              " VALUES ($1, $2)"
+                              " ON CONFLICT ON CONSTRAINT zlc"
+                              " DO UPDATE"
+                              "    SET seq=nextval('ns098changes_seq_seq')",
+                              2),
+      GNUNET_PQ_make_prepare ("iterate_zone_changes",
+                              "SELECT c.seq AS seq,"
+                              " COALESCE(r.record_count,0) AS record_count,"
+                              " COALESCE(r.record_data,''::BYTEA) AS record_data,"
+                              " c.label AS label"
+                              " FROM ns098changes c"
+                              " LEFT JOIN ns098records r"
+                              " ON (r.zone_private_key=c.zone_private_key AND r.label=c.label)"
+                              " WHERE c.zone_private_key=$1 AND c.seq > $2"
+                              " ORDER BY c.seq ASC LIMIT $3",
+                              3),
+      GNUNET_PQ_make_prepare ("iterate_all_changes",
+                              "SELECT c.seq AS seq,"
+                              " COALESCE(r.record_count,0) AS record_count,"
+                              " COALESCE(r.record_data,''::BYTEA) AS record_data,"
+                              " c.label AS label,"
+                              " c.zone_private_key AS zone_private_key"
+                              " FROM ns098changes c"
+                              " LEFT JOIN ns098records r"
+                              " ON (r.zone_private_key=c.zone_private_key AND r.label=c.label)"
+                              " WHERE c.seq > $1"
+                              " ORDER BY c.seq ASC LIMIT $2",
+                              2),
       GNUNET_PQ_PREPARED_STATEMENT_END
     };
 
@@ -167,10 +225,43 @@ database_setup (struct Plugin *plugin)
 
 
 /**
- * Store a record in the datastore.  Removes any existing record in the
- * same zone with the same name.
+ * Record in the change journal that @a label in @a zone_key changed,
+ * giving it the next journal serial number.
  *
- * @param cls closure (internal context for the plugin)
+ * @param plugin the plugin context
+ * @param zone_key private key of the zone
+ * @param label name that changed
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+note_change (struct Plugin *plugin,
+             const struct GNUNET_IDENTITY_PrivateKey *zone_key,
+             const char *label)
+{
+  struct GNUNET_PQ_QueryParam params[] = {
+    GNUNET_PQ_query_param_auto_from_type (zone_key),
+    GNUNET_PQ_query_param_string (label),
+    GNUNET_PQ_query_param_end
+  };
+  enum GNUNET_DB_QueryStatus res;
+
+  res = GNUNET_PQ_eval_prepared_non_select (plugin->dbh,
+                                            "note_change",
+                                            params);
+  if (GNUNET_DB_STATUS_SUCCESS_ONE_RESULT != res)
+  {
+    GNUNET_break (0);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Replace the records in the same zone with the same name and note
+ * the change in the journal.  Must be run inside a transaction.
+ *
+ * @param plugin the plugin context
  * @param zone_key private key of the zone
  * @param label name that is being mapped (at most 255 characters long)
  * @param rd_count number of entries in @a rd array
@@ -178,14 +269,12 @@ database_setup (struct Plugin *plugin)
  * @return #GNUNET_OK on success, else #GNUNET_SYSERR
  */
 static int
-namestore_postgres_store_records (void *cls,
-                                  const struct
-                                  GNUNET_IDENTITY_PrivateKey *zone_key,
-                                  const char *label,
-                                  unsigned int rd_count,
-                                  const struct GNUNET_GNSRECORD_Data *rd)
+store_and_note_change (struct Plugin *plugin,
+                       const struct GNUNET_IDENTITY_PrivateKey *zone_key,
+                       const char *label,
+                       unsigned int rd_count,
+                       const struct GNUNET_GNSRECORD_Data *rd)
 {
-  struct Plugin *plugin = cls;
   struct GNUNET_IDENTITY_PublicKey pkey;
   uint64_t rvalue;
   uint32_t rd_count32 = (uint32_t) rd_count;
@@ -241,7 +330,9 @@ namestore_postgres_store_records (void *cls,
     GNUNET_log_from (GNUNET_ERROR_TYPE_DEBUG,
                      "postgres",
                      "Record deleted\n");
-    return GNUNET_OK;
+    return note_change (plugin,
+                        zone_key,
+                        label);
   }
   /* otherwise, UPSERT (i.e. UPDATE if exists, otherwise INSERT) */
   {
@@ -275,7 +366,9 @@ namestore_postgres_store_records (void *cls,
     if (GNUNET_DB_STATUS_SUCCESS_ONE_RESULT != res)
       return GNUNET_SYSERR;
   }
-  return GNUNET_OK;
+  return note_change (plugin,
+                      zone_key,
+                      label);
 }
 
 
@@ -511,6 +604,75 @@ namestore_postgres_iterate_records (void *cls,
 }
 
 
+/**
+ * Iterate over the labels that changed after @a since, as recorded
+ * in the change journal.  Will return at most @a limit results to
+ * the iterator.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @param zone private key of the zone, NULL to iterate over all zones
+ * @param since journal serial number to exclude
+ * @param limit maximum number of results to fetch
+ * @param iter function to call with the result
+ * @param iter_cls closure for @a iter
+ * @return #GNUNET_OK on success, #GNUNET_NO if there were no more results, #GNUNET_SYSERR on error
+ */
+static int
+namestore_postgres_iterate_changes (void *cls,
+                                    const struct
+                                    GNUNET_IDENTITY_PrivateKey *zone,
+                                    uint64_t since,
+                                    uint64_t limit,
+                                    GNUNET_NAMESTORE_RecordIterator iter,
+                                    void *iter_cls)
+{
+  struct Plugin *plugin = cls;
+  enum GNUNET_DB_QueryStatus res;
+  struct ParserContext pc;
+
+  pc.iter = iter;
+  pc.iter_cls = iter_cls;
+  pc.zone_key = zone;
+  pc.limit = limit;
+  if (NULL == zone)
+  {
+    struct GNUNET_PQ_QueryParam params_without_zone[] = {
+      GNUNET_PQ_query_param_uint64 (&since),
+      GNUNET_PQ_query_param_uint64 (&limit),
+      GNUNET_PQ_query_param_end
+    };
+
+    res = GNUNET_PQ_eval_prepared_multi_select (plugin->dbh,
+                                                "iterate_all_changes",
+                                                params_without_zone,
+                                                &parse_result_call_iterator,
+                                                &pc);
+  }
+  else
+  {
+    struct GNUNET_PQ_QueryParam params_with_zone[] = {
+      GNUNET_PQ_query_param_auto_from_type (zone),
+      GNUNET_PQ_query_param_uint64 (&since),
+      GNUNET_PQ_query_param_uint64 (&limit),
+      GNUNET_PQ_query_param_end
+    };
+
+    res = GNUNET_PQ_eval_prepared_multi_select (plugin->dbh,
+                                                "iterate_zone_changes",
+                                                params_with_zone,
+                                                &parse_result_call_iterator,
+                                                &pc);
+  }
+  if (res < 0)
+    return GNUNET_SYSERR;
+
+  if ((GNUNET_DB_STATUS_SUCCESS_NO_RESULTS == res) ||
+      (pc.limit > 0))
+    return GNUNET_NO;
+  return GNUNET_OK;
+}
+
+
 /**
  * Look for an existing PKEY delegation record for a given public key.
  * Returns at most one result to the iterator.
@@ -554,6 +716,137 @@ namestore_postgres_zone_to_name (void *cls,
 }
 
 
+/**
+ * Run a single transaction control statement.
+ *
+ * @param plugin the plugin context
+ * @param sql statement to run
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+run_transaction_stmt (struct Plugin *plugin,
+                      const char *sql)
+{
+  struct GNUNET_PQ_ExecuteStatement es[] = {
+    GNUNET_PQ_make_execute (sql),
+    GNUNET_PQ_EXECUTE_STATEMENT_END
+  };
+
+  if (GNUNET_OK !=
+      GNUNET_PQ_exec_statements (plugin->dbh,
+                                 es))
+  {
+    GNUNET_break (0);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Store a record in the datastore.  Removes any existing record in the
+ * same zone with the same name.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @param zone_key private key of the zone
+ * @param label name that is being mapped (at most 255 characters long)
+ * @param rd_count number of entries in @a rd array
+ * @param rd array of records with data to store
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+namestore_postgres_store_records (void *cls,
+                                  const struct
+                                  GNUNET_IDENTITY_PrivateKey *zone_key,
+                                  const char *label,
+                                  unsigned int rd_count,
+                                  const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct Plugin *plugin = cls;
+  int ret;
+
+  /* The records and the journal entry must change together.  Bulk
+     stores already run inside a transaction of their own. */
+  if (GNUNET_YES == plugin->in_transaction)
+    return store_and_note_change (plugin,
+                                  zone_key,
+                                  label,
+                                  rd_count,
+                                  rd);
+  if (GNUNET_OK !=
+      run_transaction_stmt (plugin,
+                            "START TRANSACTION ISOLATION LEVEL READ COMMITTED"))
+    return GNUNET_SYSERR;
+  ret = store_and_note_change (plugin,
+                               zone_key,
+                               label,
+                               rd_count,
+                               rd);
+  if ( (GNUNET_OK == ret) &&
+       (GNUNET_OK ==
+        run_transaction_stmt (plugin,
+                              "COMMIT")) )
+    return GNUNET_OK;
+  (void) run_transaction_stmt (plugin,
+                               "ROLLBACK");
+  return GNUNET_SYSERR;
+}
+
+
+/**
+ * Start a transaction.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+namestore_postgres_begin_transaction (void *cls)
+{
+  struct Plugin *plugin = cls;
+
+  if (GNUNET_OK !=
+      run_transaction_stmt (plugin,
+                            "START TRANSACTION ISOLATION LEVEL READ COMMITTED"))
+    return GNUNET_SYSERR;
+  plugin->in_transaction = GNUNET_YES;
+  return GNUNET_OK;
+}
+
+
+/**
+ * Commit the current transaction.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+namestore_postgres_commit_transaction (void *cls)
+{
+  struct Plugin *plugin = cls;
+
+  plugin->in_transaction = GNUNET_NO;
+  return run_transaction_stmt (plugin,
+                               "COMMIT");
+}
+
+
+/**
+ * Roll back the current transaction.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+namestore_postgres_rollback_transaction (void *cls)
+{
+  struct Plugin *plugin = cls;
+
+  plugin->in_transaction = GNUNET_NO;
+  return run_transaction_stmt (plugin,
+                               "ROLLBACK");
+}
+
+
 /**
  * Shutdown database connection and associate data
  * structures.
@@ -596,6 +889,10 @@ libgnunet_plugin_namestore_postgres_init (void *cls)
   api->iterate_records = &namestore_postgres_iterate_records;
   api->zone_to_name = &namestore_postgres_zone_to_name;
   api->lookup_records = &namestore_postgres_lookup_records;
+  api->iterate_changes = &namestore_postgres_iterate_changes;
+  api->begin_transaction = &namestore_postgres_begin_transaction;
+  api->commit_transaction = &namestore_postgres_commit_transaction;
+  api->rollback_transaction = &namestore_postgres_rollback_transaction;
   LOG (GNUNET_ERROR_TYPE_INFO,
        "Postgres namestore plugin running\n");
   return api;
@@ -108,6 +108,36 @@ struct Plugin
    * Precompiled SQL to lookup records based on label.
    */
   sqlite3_stmt *lookup_label;
+
+  /**
+   * Precompiled SQL to record a label change in the journal.
+   */
+  sqlite3_stmt *note_change;
+
+  /**
+   * Precompiled SQL to iterate the journal of a zone.
+   */
+  sqlite3_stmt *iterate_zone_changes;
+
+  /**
+   * Precompiled SQL to iterate the journal of all zones.
+   */
+  sqlite3_stmt *iterate_all_changes;
+
+  /**
+   * Precompiled SQL to start a transaction.
+   */
+  sqlite3_stmt *begin_transaction;
+
+  /**
+   * Precompiled SQL to commit a transaction.
+   */
+  sqlite3_stmt *commit_transaction;
+
+  /**
+   * Precompiled SQL to roll back a transaction.
+   */
+  sqlite3_stmt *rollback_transaction;
 };
 
 
@@ -145,6 +175,15 @@ database_setup (struct Plugin *plugin)
                                 "ON ns098records (zone_private_key,pkey)"),
     GNUNET_SQ_make_try_execute ("CREATE INDEX IF NOT EXISTS ir_pkey_iter "
                                 "ON ns098records (zone_private_key,uid)"),
+    GNUNET_SQ_make_execute ("CREATE TABLE IF NOT EXISTS ns098changes ("
+                            " seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+                            " zone_private_key BLOB NOT NULL,"
+                            " label TEXT NOT NULL"
+                            ")"),
+    GNUNET_SQ_make_try_execute ("CREATE UNIQUE INDEX IF NOT EXISTS ic_label "
+                                "ON ns098changes (zone_private_key,label)"),
+    GNUNET_SQ_make_try_execute ("CREATE INDEX IF NOT EXISTS ic_iter "
+                                "ON ns098changes (zone_private_key,seq)"),
     GNUNET_SQ_EXECUTE_STATEMENT_END
   };
   struct GNUNET_SQ_PrepareStatement ps[] = {
@@ -176,6 +215,36 @@ database_setup (struct Plugin *plugin)
                             " FROM ns098records"
                             " WHERE zone_private_key=? AND label=?",
                             &plugin->lookup_label),
+    GNUNET_SQ_make_prepare ("INSERT OR REPLACE INTO ns098changes "
+                            "(zone_private_key,label)"
+                            " VALUES (?, ?)",
+                            &plugin->note_change),
+    GNUNET_SQ_make_prepare (
+      "SELECT c.seq,COALESCE(r.record_count,0),"
+      "r.record_data,c.label"
+      " FROM ns098changes c"
+      " LEFT JOIN ns098records r"
+      " ON (r.zone_private_key=c.zone_private_key AND r.label=c.label)"
+      " WHERE c.zone_private_key=? AND c.seq > ?"
+      " ORDER BY c.seq ASC"
+      " LIMIT ?",
+      &plugin->iterate_zone_changes),
+    GNUNET_SQ_make_prepare (
+      "SELECT c.seq,COALESCE(r.record_count,0),"
+      "r.record_data,c.label,c.zone_private_key"
+      " FROM ns098changes c"
+      " LEFT JOIN ns098records r"
+      " ON (r.zone_private_key=c.zone_private_key AND r.label=c.label)"
+      " WHERE c.seq > ?"
+      " ORDER BY c.seq ASC"
+      " LIMIT ?",
+      &plugin->iterate_all_changes),
+    GNUNET_SQ_make_prepare ("BEGIN IMMEDIATE TRANSACTION",
+                            &plugin->begin_transaction),
+    GNUNET_SQ_make_prepare ("COMMIT TRANSACTION",
+                            &plugin->commit_transaction),
+    GNUNET_SQ_make_prepare ("ROLLBACK TRANSACTION",
+                            &plugin->rollback_transaction),
     GNUNET_SQ_PREPARE_END
   };
 
@@ -265,6 +334,18 @@ database_shutdown (struct Plugin *plugin)
     sqlite3_finalize (plugin->zone_to_name);
   if (NULL != plugin->lookup_label)
     sqlite3_finalize (plugin->lookup_label);
+  if (NULL != plugin->note_change)
+    sqlite3_finalize (plugin->note_change);
+  if (NULL != plugin->iterate_zone_changes)
+    sqlite3_finalize (plugin->iterate_zone_changes);
+  if (NULL != plugin->iterate_all_changes)
+    sqlite3_finalize (plugin->iterate_all_changes);
+  if (NULL != plugin->begin_transaction)
+    sqlite3_finalize (plugin->begin_transaction);
+  if (NULL != plugin->commit_transaction)
+    sqlite3_finalize (plugin->commit_transaction);
+  if (NULL != plugin->rollback_transaction)
+    sqlite3_finalize (plugin->rollback_transaction);
   result = sqlite3_close (plugin->dbh);
   if (result == SQLITE_BUSY)
   {
@@ -301,25 +382,24 @@ database_shutdown (struct Plugin *plugin)
 
 
 /**
- * Store a record in the datastore.  Removes any existing record in the
- * same zone with the same name.
+ * Replace the records in the same zone with the same name and note
+ * the change in the journal.  Must be run inside a transaction.
  *
- * @param cls closure (internal context for the plugin)
+ * @param plugin the plugin context
  * @param zone_key private key of the zone
  * @param label name that is being mapped (at most 255 characters long)
  * @param rd_count number of entries in @a rd array
  * @param rd array of records with data to store
- * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ * @return #GNUNET_OK on success, #GNUNET_NO if the database was busy,
+ *         else #GNUNET_SYSERR
  */
 static int
-namestore_sqlite_store_records (void *cls,
-                                const struct
-                                GNUNET_IDENTITY_PrivateKey *zone_key,
-                                const char *label,
-                                unsigned int rd_count,
-                                const struct GNUNET_GNSRECORD_Data *rd)
+store_and_note_change (struct Plugin *plugin,
+                       const struct GNUNET_IDENTITY_PrivateKey *zone_key,
+                       const char *label,
+                       unsigned int rd_count,
+                       const struct GNUNET_GNSRECORD_Data *rd)
 {
-  struct Plugin *plugin = cls;
   int n;
   struct GNUNET_IDENTITY_PublicKey pkey;
   uint64_t rvalue;
@@ -387,7 +467,8 @@ namestore_sqlite_store_records (void *cls,
     GNUNET_SQ_reset (plugin->dbh,
                      plugin->delete_records);
 
-    if (0 != rd_count)
+    if ((SQLITE_DONE == n) &&
+        (0 != rd_count))
     {
       uint32_t rd_count32 = (uint32_t) rd_count;
       struct GNUNET_SQ_QueryParam sparams[] = {
@@ -415,6 +496,24 @@ namestore_sqlite_store_records (void *cls,
       GNUNET_SQ_reset (plugin->dbh,
                        plugin->store_records);
     }
+    if (SQLITE_DONE == n)
+    {
+      /* Finally, remember that the label changed */
+      if (GNUNET_OK !=
+          GNUNET_SQ_bind (plugin->note_change,
+                          dparams))
+      {
+        LOG_SQLITE (plugin,
+                    GNUNET_ERROR_TYPE_ERROR | GNUNET_ERROR_TYPE_BULK,
+                    "sqlite3_bind_XXXX");
+        GNUNET_SQ_reset (plugin->dbh,
+                         plugin->note_change);
+        return GNUNET_SYSERR;
+      }
+      n = sqlite3_step (plugin->note_change);
+      GNUNET_SQ_reset (plugin->dbh,
+                       plugin->note_change);
+    }
   }
   switch (n)
   {
@@ -682,6 +781,75 @@ namestore_sqlite_iterate_records (void *cls,
 }
 
 
+/**
+ * Iterate over the labels that changed after @a since, as recorded
+ * in the change journal.  Will return at most @a limit results to
+ * the iterator.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @param zone private key of the zone, NULL to iterate over all zones
+ * @param since journal serial number to exclude
+ * @param limit maximum number of results to return
+ * @param iter function to call with the result
+ * @param iter_cls closure for @a iter
+ * @return #GNUNET_OK on success, #GNUNET_NO if there were no more results, #GNUNET_SYSERR on error
+ */
+static int
+namestore_sqlite_iterate_changes (void *cls,
+                                  const struct
+                                  GNUNET_IDENTITY_PrivateKey *zone,
+                                  uint64_t since,
+                                  uint64_t limit,
+                                  GNUNET_NAMESTORE_RecordIterator iter,
+                                  void *iter_cls)
+{
+  struct Plugin *plugin = cls;
+  sqlite3_stmt *stmt;
+  int err;
+
+  if (NULL == zone)
+  {
+    struct GNUNET_SQ_QueryParam params[] = {
+      GNUNET_SQ_query_param_uint64 (&since),
+      GNUNET_SQ_query_param_uint64 (&limit),
+      GNUNET_SQ_query_param_end
+    };
+
+    stmt = plugin->iterate_all_changes;
+    err = GNUNET_SQ_bind (stmt,
+                          params);
+  }
+  else
+  {
+    struct GNUNET_SQ_QueryParam params[] = {
+      GNUNET_SQ_query_param_auto_from_type (zone),
+      GNUNET_SQ_query_param_uint64 (&since),
+      GNUNET_SQ_query_param_uint64 (&limit),
+      GNUNET_SQ_query_param_end
+    };
+
+    stmt = plugin->iterate_zone_changes;
+    err = GNUNET_SQ_bind (stmt,
+                          params);
+  }
+  if (GNUNET_OK != err)
+  {
+    LOG_SQLITE (plugin,
+                GNUNET_ERROR_TYPE_ERROR | GNUNET_ERROR_TYPE_BULK,
+                "sqlite3_bind_XXXX");
+    GNUNET_SQ_reset (plugin->dbh,
+                     stmt);
+    return GNUNET_SYSERR;
+  }
+  return get_records_and_call_iterator (plugin,
+                                        stmt,
+                                        zone,
+                                        limit,
+                                        iter,
+                                        iter_cls);
+}
+
+
 /**
  * Look for an existing PKEY delegation record for a given public key.
  * Returns at most one result to the iterator.
@@ -731,6 +899,130 @@ namestore_sqlite_zone_to_name (void *cls,
 }
 
 
+/**
+ * Run one of the (parameterless) transaction control statements.
+ *
+ * @param plugin the plugin context
+ * @param stmt statement to run
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+run_transaction_stmt (struct Plugin *plugin,
+                      sqlite3_stmt *stmt)
+{
+  int n;
+
+  n = sqlite3_step (stmt);
+  GNUNET_SQ_reset (plugin->dbh,
+                   stmt);
+  if (SQLITE_DONE != n)
+  {
+    LOG_SQLITE (plugin,
+                GNUNET_ERROR_TYPE_ERROR | GNUNET_ERROR_TYPE_BULK,
+                "sqlite3_step");
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Store a record in the datastore.  Removes any existing record in the
+ * same zone with the same name.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @param zone_key private key of the zone
+ * @param label name that is being mapped (at most 255 characters long)
+ * @param rd_count number of entries in @a rd array
+ * @param rd array of records with data to store
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+namestore_sqlite_store_records (void *cls,
+                                const struct
+                                GNUNET_IDENTITY_PrivateKey *zone_key,
+                                const char *label,
+                                unsigned int rd_count,
+                                const struct GNUNET_GNSRECORD_Data *rd)
+{
+  struct Plugin *plugin = cls;
+  int own_transaction;
+  int ret;
+
+  /* The records and the journal entry must change together.  Bulk
+     stores already run inside a transaction of their own. */
+  own_transaction = (0 != sqlite3_get_autocommit (plugin->dbh));
+  if ( (own_transaction) &&
+       (GNUNET_OK !=
+        run_transaction_stmt (plugin,
+                              plugin->begin_transaction)) )
+    return GNUNET_SYSERR;
+  ret = store_and_note_change (plugin,
+                               zone_key,
+                               label,
+                               rd_count,
+                               rd);
+  if (! own_transaction)
+    return ret;
+  if ( (GNUNET_OK == ret) &&
+       (GNUNET_OK ==
+        run_transaction_stmt (plugin,
+                              plugin->commit_transaction)) )
+    return GNUNET_OK;
+  (void) run_transaction_stmt (plugin,
+                               plugin->rollback_transaction);
+  return (GNUNET_OK == ret) ? GNUNET_SYSERR : ret;
+}
+
+
+/**
+ * Start a transaction.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+namestore_sqlite_begin_transaction (void *cls)
+{
+  struct Plugin *plugin = cls;
+
+  return run_transaction_stmt (plugin,
+                               plugin->begin_transaction);
+}
+
+
+/**
+ * Commit the current transaction.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+namestore_sqlite_commit_transaction (void *cls)
+{
+  struct Plugin *plugin = cls;
+
+  return run_transaction_stmt (plugin,
+                               plugin->commit_transaction);
+}
+
+
+/**
+ * Roll back the current transaction.
+ *
+ * @param cls closure (internal context for the plugin)
+ * @return #GNUNET_OK on success, else #GNUNET_SYSERR
+ */
+static int
+namestore_sqlite_rollback_transaction (void *cls)
+{
+  struct Plugin *plugin = cls;
+
+  return run_transaction_stmt (plugin,
+                               plugin->rollback_transaction);
+}
+
+
 /**
  * Entry point for the plugin.
  *
@@ -761,6 +1053,10 @@ libgnunet_plugin_namestore_sqlite_init (void *cls)
   api->iterate_records = &namestore_sqlite_iterate_records;
   api->zone_to_name = &namestore_sqlite_zone_to_name;
   api->lookup_records = &namestore_sqlite_lookup_records;
+  api->iterate_changes = &namestore_sqlite_iterate_changes;
+  api->begin_transaction = &namestore_sqlite_begin_transaction;
+  api->commit_transaction = &namestore_sqlite_commit_transaction;
+  api->rollback_transaction = &namestore_sqlite_rollback_transaction;
   LOG (GNUNET_ERROR_TYPE_INFO,
        _ ("Sqlite database running\n"));
   return api;
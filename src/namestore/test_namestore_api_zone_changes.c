@@ -0,0 +1,314 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2021 GNUnet e.V.
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+/**
+ * @file namestore/test_namestore_api_zone_changes.c
+ * @brief testcase for iterating over the namestore change journal
+ */
+#include "platform.h"
+#include "gnunet_namestore_service.h"
+#include "gnunet_testing_lib.h"
+#include "namestore.h"
+#include "gnunet_dnsparser_lib.h"
+
+#define TEST_RECORD_TYPE GNUNET_DNSPARSER_TYPE_TXT
+
+#define TIMEOUT GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 100)
+
+static struct GNUNET_NAMESTORE_Handle *nsh;
+
+static struct GNUNET_IDENTITY_PrivateKey privkey;
+
+static struct GNUNET_NAMESTORE_ZoneIterator *zi;
+
+static struct GNUNET_SCHEDULER_Task *endbadly_task;
+
+static int res;
+
+/**
+ * Which step of the test are we in?
+ */
+static unsigned int phase;
+
+/**
+ * Number of changed labels returned in the current phase.
+ */
+static unsigned int returned_changes;
+
+/**
+ * Journal serial returned at the end of the last phase.
+ */
+static uint64_t last_serial;
+
+static struct GNUNET_GNSRECORD_Data rd;
+
+static char rd_data[50];
+
+
+static void
+endbadly (void *cls)
+{
+  endbadly_task = NULL;
+  GNUNET_break (0);
+  GNUNET_SCHEDULER_shutdown ();
+  res = 1;
+}
+
+
+static void
+end (void *cls)
+{
+  if (NULL != zi)
+  {
+    GNUNET_NAMESTORE_zone_iteration_stop (zi);
+    zi = NULL;
+  }
+  if (NULL != endbadly_task)
+  {
+    GNUNET_SCHEDULER_cancel (endbadly_task);
+    endbadly_task = NULL;
+  }
+  if (NULL != nsh)
+  {
+    GNUNET_NAMESTORE_disconnect (nsh);
+    nsh = NULL;
+  }
+}
+
+
+static void
+fail_cb (void *cls)
+{
+  GNUNET_assert (0);
+}
+
+
+static void
+start_phase (void);
+
+
+static void
+change_proc (void *cls,
+             const struct GNUNET_IDENTITY_PrivateKey *zone,
+             const char *label,
+             unsigned int rd_count,
+             const struct GNUNET_GNSRECORD_Data *rd_res)
+{
+  GNUNET_assert (NULL != zone);
+  GNUNET_assert (0 == GNUNET_memcmp (zone, &privkey));
+  returned_changes++;
+  switch (phase)
+  {
+  case 1:
+    /* both labels were created */
+    if ((1 != rd_count) ||
+        (GNUNET_YES != GNUNET_GNSRECORD_records_cmp (rd_res, &rd)))
+    {
+      GNUNET_break (0);
+      GNUNET_SCHEDULER_shutdown ();
+      return;
+    }
+    break;
+  case 2:
+    /* "a" was updated, "b" was deleted */
+    if (((0 == strcmp (label, "a")) && (1 != rd_count)) ||
+        ((0 == strcmp (label, "b")) && (0 != rd_count)))
+    {
+      GNUNET_break (0);
+      GNUNET_SCHEDULER_shutdown ();
+      return;
+    }
+    break;
+  default:
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                "Unexpected change of label `%s' in phase %u\n",
+                label,
+                phase);
+    GNUNET_break (0);
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  GNUNET_NAMESTORE_zone_iterator_next (zi,
+                                       1);
+}
+
+
+static void
+change_proc_end (void *cls,
+                 uint64_t serial)
+{
+  zi = NULL;
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Phase %u returned %u changes up to serial %llu\n",
+              phase,
+              returned_changes,
+              (unsigned long long) serial);
+  switch (phase)
+  {
+  case 0:
+    GNUNET_break (0 == returned_changes);
+    break;
+  case 1:
+  case 2:
+    if ((2 != returned_changes) ||
+        (serial <= last_serial))
+    {
+      GNUNET_break (0);
+      GNUNET_SCHEDULER_shutdown ();
+      return;
+    }
+    break;
+  case 3:
+    if ((0 != returned_changes) ||
+        (serial != last_serial))
+    {
+      GNUNET_break (0);
+      GNUNET_SCHEDULER_shutdown ();
+      return;
+    }
+    res = 0;
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  last_serial = serial;
+  phase++;
+  start_phase ();
+}
+
+
+static void
+put_cont (void *cls,
+          int32_t success,
+          const char *emsg)
+{
+  static unsigned int c;
+
+  if (GNUNET_OK != success)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                "Failed to store records: `%s'\n",
+                emsg);
+    GNUNET_break (0);
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
+  if (0 != ++c % 2)
+    return;
+  returned_changes = 0;
+  zi = GNUNET_NAMESTORE_zone_changes_start (nsh,
+                                            &privkey,
+                                            last_serial,
+                                            &fail_cb,
+                                            NULL,
+                                            &change_proc,
+                                            NULL,
+                                            &change_proc_end,
+                                            NULL);
+}
+
+
+static void
+start_phase ()
+{
+  switch (phase)
+  {
+  case 1:
+    GNUNET_NAMESTORE_records_store (nsh, &privkey, "a", 1, &rd, &put_cont,
+                                    NULL);
+    GNUNET_NAMESTORE_records_store (nsh, &privkey, "b", 1, &rd, &put_cont,
+                                    NULL);
+    break;
+  case 2:
+    rd_data[0] = 'b';
+    GNUNET_NAMESTORE_records_store (nsh, &privkey, "a", 1, &rd, &put_cont,
+                                    NULL);
+    GNUNET_NAMESTORE_records_store (nsh, &privkey, "b", 0, NULL, &put_cont,
+                                    NULL);
+    break;
+  default:
+    /* nothing changed since the last phase */
+    returned_changes = 0;
+    zi = GNUNET_NAMESTORE_zone_changes_start (nsh,
+                                              &privkey,
+                                              last_serial,
+                                              &fail_cb,
+                                              NULL,
+                                              &change_proc,
+                                              NULL,
+                                              &change_proc_end,
+                                              NULL);
+    break;
+  }
+}
+
+
+static void
+run (void *cls,
+     const struct GNUNET_CONFIGURATION_Handle *cfg,
+     struct GNUNET_TESTING_Peer *peer)
+{
+  endbadly_task = GNUNET_SCHEDULER_add_delayed (TIMEOUT,
+                                                &endbadly,
+                                                NULL);
+  GNUNET_SCHEDULER_add_shutdown (&end,
+                                 NULL);
+  privkey.type = htonl (GNUNET_GNSRECORD_TYPE_PKEY);
+  GNUNET_CRYPTO_ecdsa_key_create (&privkey.ecdsa_key);
+  memset (rd_data, 'a', sizeof(rd_data));
+  rd.expiration_time = GNUNET_TIME_relative_to_absolute (
+    GNUNET_TIME_UNIT_HOURS).abs_value_us;
+  rd.record_type = TEST_RECORD_TYPE;
+  rd.data_size = sizeof(rd_data);
+  rd.data = rd_data;
+  rd.flags = 0;
+  nsh = GNUNET_NAMESTORE_connect (cfg);
+  GNUNET_break (NULL != nsh);
+  /* first, look at the journal of the empty namestore */
+  phase = 0;
+  start_phase ();
+}
+
+
+#include "test_common.c"
+
+
+int
+main (int argc, char *argv[])
+{
+  const char *plugin_name;
+  char *cfg_name;
+
+  SETUP_CFG (plugin_name, cfg_name);
+  res = 1;
+  if (0 !=
+      GNUNET_TESTING_peer_run ("test-namestore-api-zone-changes",
+                               cfg_name,
+                               &run,
+                               NULL))
+  {
+    res = 1;
+  }
+  GNUNET_DISK_purge_cfg_dir (cfg_name,
+                             "GNUNET_TEST_HOME");
+  GNUNET_free (cfg_name);
+  return res;
+}
+
+
+/* end of test_namestore_api_zone_changes.c */
@@ -169,6 +169,21 @@ run (void *cls,
   get_record (nsp, 1);
 #ifndef DARWIN // #5582
   unload_plugin (nsp);
+  if (GNUNET_YES ==
+      GNUNET_CONFIGURATION_get_value_yesno (cfg,
+                                            "namestore-postgres",
+                                            "TEMPORARY_TABLE"))
+    return; /* nothing survives a restart */
+  /* the records must still be there after a restart */
+  nsp = load_plugin (cfg);
+  if (NULL == nsp)
+  {
+    GNUNET_break (0);
+    ok = 1;
+    return;
+  }
+  get_record (nsp, 1);
+  unload_plugin (nsp);
 #endif
 }
 
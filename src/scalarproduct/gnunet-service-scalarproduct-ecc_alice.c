@@ -54,6 +54,13 @@
  */
 #define MAX_RAM (1024)
 
+/**
+ * How many values should DLOG store if we keep them in the file
+ * given by the DLOG_TABLE option.  They are calculated only once,
+ * so we can afford many more (36 bytes on disk per value).
+ */
+#define MAX_TABLE_RAM (64 * 1024)
+
 /**
  * An encrypted element key-value pair.
  */
@@ -1105,9 +1112,30 @@ run (void *cls,
      const struct GNUNET_CONFIGURATION_Handle *c,
      struct GNUNET_SERVICE_Handle *service)
 {
+  char *dlog_table;
+
   cfg = c;
-  edc = GNUNET_CRYPTO_ecc_dlog_prepare (MAX_RESULT,
-                                        MAX_RAM);
+  if (GNUNET_OK ==
+      GNUNET_CONFIGURATION_get_value_filename (cfg,
+                                               "scalarproduct-alice",
+                                               "DLOG_TABLE",
+                                               &dlog_table))
+  {
+    edc = GNUNET_CRYPTO_ecc_dlog_prepare_file (MAX_RESULT,
+                                               MAX_TABLE_RAM,
+                                               dlog_table);
+    GNUNET_free (dlog_table);
+  }
+  if (NULL == edc)
+    edc = GNUNET_CRYPTO_ecc_dlog_prepare (MAX_RESULT,
+                                          MAX_RAM);
+  if (NULL == edc)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                _ ("Failed to prepare DLOG calculation\n"));
+    GNUNET_SCHEDULER_shutdown ();
+    return;
+  }
   /* Select a random 'a' value for Alice */
   GNUNET_CRYPTO_ecc_rnd_mpi (&my_privkey,
                              &my_privkey_inv);
@@ -203,6 +203,12 @@ static struct GNUNET_CRYPTO_PaillierPublicKey my_pubkey;
  */
 static struct GNUNET_CRYPTO_PaillierPrivateKey my_privkey;
 
+/**
+ * Context for encrypting with #my_pubkey, keeps randomness for
+ * the encryptions of the next sessions.
+ */
+static struct GNUNET_CRYPTO_PaillierContext *my_ctx;
+
 /**
  * Service's offset for values that could possibly be negative but are plaintext for encryption.
  */
@@ -836,9 +842,10 @@ send_alices_cryptodata_message (struct AliceServiceSession *s)
   struct AliceCryptodataMessage *msg;
   struct GNUNET_MQ_Envelope *e;
   struct GNUNET_CRYPTO_PaillierCiphertext *payload;
+  struct GNUNET_CRYPTO_PaillierCiphertext *ciphertexts;
+  gcry_mpi_t *a;
   unsigned int i;
   uint32_t todo_count;
-  gcry_mpi_t a;
   uint32_t off;
 
   s->sorted_elements = GNUNET_malloc (
@@ -855,6 +862,24 @@ send_alices_cryptodata_message (struct AliceServiceSession *s)
          s->used_element_count,
          sizeof(struct MpiElement),
          &element_cmp);
+  a = GNUNET_new_array (s->used_element_count,
+                        gcry_mpi_t);
+  for (i = 0; i < s->used_element_count; i++)
+  {
+    GNUNET_assert (NULL != (a[i] = gcry_mpi_new (0)));
+    gcry_mpi_add (a[i], s->sorted_elements[i].value, my_offset);
+  }
+  ciphertexts = GNUNET_new_array (s->used_element_count,
+                                  struct GNUNET_CRYPTO_PaillierCiphertext);
+  GNUNET_assert (3 ==
+                 GNUNET_CRYPTO_paillier_encrypt_batch (my_ctx,
+                                                       a,
+                                                       s->used_element_count,
+                                                       3,
+                                                       ciphertexts));
+  for (i = 0; i < s->used_element_count; i++)
+    gcry_mpi_release (a[i]);
+  GNUNET_free (a);
   off = 0;
   while (off < s->used_element_count)
   {
@@ -873,18 +898,14 @@ send_alices_cryptodata_message (struct AliceServiceSession *s)
                            GNUNET_MESSAGE_TYPE_SCALARPRODUCT_ALICE_CRYPTODATA);
     msg->contained_element_count = htonl (todo_count);
     payload = (struct GNUNET_CRYPTO_PaillierCiphertext *) &msg[1];
-    a = gcry_mpi_new (0);
-    for (i = off; i < off + todo_count; i++)
-    {
-      gcry_mpi_add (a, s->sorted_elements[i].value, my_offset);
-      GNUNET_assert (
-        3 ==
-        GNUNET_CRYPTO_paillier_encrypt (&my_pubkey, a, 3, &payload[i - off]));
-    }
-    gcry_mpi_release (a);
+    GNUNET_memcpy (payload,
+                   &ciphertexts[off],
+                   todo_count
+                   * sizeof(struct GNUNET_CRYPTO_PaillierCiphertext));
     off += todo_count;
     GNUNET_MQ_send (s->cadet_mq, e);
   }
+  GNUNET_free (ciphertexts);
 }
 
 
@@ -1035,6 +1056,10 @@ client_request_complete_alice (struct AliceServiceSession *s)
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Creating new channel for session with key %s.\n",
               GNUNET_h2s (&s->session_id));
+  /* we will have to encrypt at most all of our elements, do
+     the expensive part while the set intersection runs */
+  GNUNET_CRYPTO_paillier_precompute (my_ctx,
+                                     s->total);
   s->channel = GNUNET_CADET_channel_create (my_cadet,
                                             s,
                                             &s->peer,
@@ -1278,6 +1303,11 @@ shutdown_task (void *cls)
     GNUNET_CADET_disconnect (my_cadet);
     my_cadet = NULL;
   }
+  if (NULL != my_ctx)
+  {
+    GNUNET_CRYPTO_paillier_context_destroy (my_ctx);
+    my_ctx = NULL;
+  }
 }
 
 
@@ -1351,6 +1381,8 @@ run (void *cls,
   my_offset = gcry_mpi_new (GNUNET_CRYPTO_PAILLIER_BITS / 3);
   gcry_mpi_set_bit (my_offset, GNUNET_CRYPTO_PAILLIER_BITS / 3);
   GNUNET_CRYPTO_paillier_create (&my_pubkey, &my_privkey);
+  GNUNET_assert (NULL !=
+                 (my_ctx = GNUNET_CRYPTO_paillier_context_create (&my_pubkey)));
   my_cadet = GNUNET_CADET_connect (cfg);
   GNUNET_SCHEDULER_add_shutdown (&shutdown_task, NULL);
   if (NULL == my_cadet)
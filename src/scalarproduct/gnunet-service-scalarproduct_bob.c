@@ -195,6 +195,11 @@ struct BobServiceSession
    */
   struct GNUNET_CRYPTO_PaillierPublicKey remote_pubkey;
 
+  /**
+   * Context for encrypting with @e remote_pubkey.
+   */
+  struct GNUNET_CRYPTO_PaillierContext *remote_ctx;
+
   /**
    * The message queue for this channel.
    */
@@ -307,6 +312,11 @@ destroy_service_session (struct BobServiceSession *s)
     GNUNET_free (s->r_prime);
     s->r_prime = NULL;
   }
+  if (NULL != s->remote_ctx)
+  {
+    GNUNET_CRYPTO_paillier_context_destroy (s->remote_ctx);
+    s->remote_ctx = NULL;
+  }
   if (NULL != s->port)
   {
     GNUNET_CADET_close_port (s->port);
@@ -574,12 +584,20 @@ compute_service_response (struct BobServiceSession *session)
   unsigned int *q;
   uint32_t count;
   gcry_mpi_t *rand;
+  gcry_mpi_t *tmp_p;
+  gcry_mpi_t *tmp_q;
   gcry_mpi_t tmp;
   const struct MpiElement *b;
   struct GNUNET_CRYPTO_PaillierCiphertext *a;
   struct GNUNET_CRYPTO_PaillierCiphertext *r;
   struct GNUNET_CRYPTO_PaillierCiphertext *r_prime;
 
+  if (NULL == session->remote_ctx)
+  {
+    /* Alice never told us her public key */
+    GNUNET_break_op (0);
+    return GNUNET_SYSERR;
+  }
   count = session->used_element_count;
   a = session->e_a;
   b = session->sorted_elements;
@@ -609,23 +627,48 @@ compute_service_response (struct BobServiceSession *session)
       rand[i] = gcry_mpi_set_ui (rand[i], svalue);
   }
 
-  tmp = gcry_mpi_new (0);
   // encrypt the element
   // for the sake of readability I decided to have dedicated permutation
   // vectors, which get rid of all the lookups in p/q.
   // however, ap/aq are not absolutely necessary but are just abstraction
-  // Calculate Kp = E(S + a_pi) (+) E(S - r_pi - b_pi)
+  tmp_p = GNUNET_new_array (count,
+                            gcry_mpi_t);
+  tmp_q = GNUNET_new_array (count,
+                            gcry_mpi_t);
+  for (i = 0; i < count; i++)
+  {
+    // S - r_pi - b_pi
+    GNUNET_assert (NULL != (tmp_p[i] = gcry_mpi_new (0)));
+    gcry_mpi_sub (tmp_p[i], my_offset, rand[p[i]]);
+    gcry_mpi_sub (tmp_p[i], tmp_p[i], b[p[i]].value);
+    // S - r_qi
+    GNUNET_assert (NULL != (tmp_q[i] = gcry_mpi_new (0)));
+    gcry_mpi_sub (tmp_q[i], my_offset, rand[q[i]]);
+  }
+  // E(S - r_pi - b_pi) and E(S - r_qi), all at once
+  GNUNET_assert (2 ==
+                 GNUNET_CRYPTO_paillier_encrypt_batch (session->remote_ctx,
+                                                       tmp_p,
+                                                       count,
+                                                       2,
+                                                       r));
+  GNUNET_assert (2 ==
+                 GNUNET_CRYPTO_paillier_encrypt_batch (session->remote_ctx,
+                                                       tmp_q,
+                                                       count,
+                                                       2,
+                                                       r_prime));
   for (i = 0; i < count; i++)
   {
-    // E(S - r_pi - b_pi)
-    gcry_mpi_sub (tmp, my_offset, rand[p[i]]);
-    gcry_mpi_sub (tmp, tmp, b[p[i]].value);
-    GNUNET_assert (2 ==
-                   GNUNET_CRYPTO_paillier_encrypt (&session->remote_pubkey,
-                                                   tmp,
-                                                   2,
-                                                   &r[i]));
+    gcry_mpi_release (tmp_p[i]);
+    gcry_mpi_release (tmp_q[i]);
+  }
+  GNUNET_free (tmp_p);
+  GNUNET_free (tmp_q);
 
+  // Calculate Kp = E(S + a_pi) (+) E(S - r_pi - b_pi)
+  for (i = 0; i < count; i++)
+  {
     // E(S - r_pi - b_pi) * E(S + a_pi) ==  E(2*S + a - r - b)
     if (GNUNET_OK !=
         GNUNET_CRYPTO_paillier_hom_add (&session->remote_pubkey,
@@ -641,14 +684,6 @@ compute_service_response (struct BobServiceSession *session)
   // Calculate Kq = E(S + a_qi) (+) E(S - r_qi)
   for (i = 0; i < count; i++)
   {
-    // E(S - r_qi)
-    gcry_mpi_sub (tmp, my_offset, rand[q[i]]);
-    GNUNET_assert (2 ==
-                   GNUNET_CRYPTO_paillier_encrypt (&session->remote_pubkey,
-                                                   tmp,
-                                                   2,
-                                                   &r_prime[i]));
-
     // E(S - r_qi) * E(S + a_qi) == E(2*S + a_qi - r_qi)
     if (GNUNET_OK !=
         GNUNET_CRYPTO_paillier_hom_add (&session->remote_pubkey,
@@ -660,7 +695,6 @@ compute_service_response (struct BobServiceSession *session)
       goto error_cleanup;
     }
   }
-  gcry_mpi_release (tmp);
 
   // Calculate S' =  E(SUM( r_i^2 ))
   tmp = compute_square_sum (rand, count);
@@ -697,7 +731,6 @@ compute_service_response (struct BobServiceSession *session)
 error_cleanup:
   GNUNET_free (r);
   GNUNET_free (r_prime);
-  gcry_mpi_release (tmp);
   GNUNET_free (p);
   GNUNET_free (q);
   for (i = 0; i < count; i++)
@@ -967,6 +1000,11 @@ start_intersection (struct BobServiceSession *s)
               "Got session with key %s and %u elements, starting intersection.\n",
               GNUNET_h2s (&s->session_id),
               (unsigned int) s->total);
+  /* we will have to encrypt at most two values per element, do
+     the expensive part while the set intersection runs */
+  if (NULL != s->remote_ctx)
+    GNUNET_CRYPTO_paillier_precompute (s->remote_ctx,
+                                       2 * s->total);
 
   s->intersection_op
     = GNUNET_SETI_prepare (&s->peer,
@@ -1003,6 +1041,15 @@ handle_alices_computation_request (void *cls,
 
   s->session_id = msg->session_id; // ??
   s->remote_pubkey = msg->public_key;
+  if (NULL != s->remote_ctx)
+    GNUNET_CRYPTO_paillier_context_destroy (s->remote_ctx);
+  s->remote_ctx = GNUNET_CRYPTO_paillier_context_create (&s->remote_pubkey);
+  if (NULL == s->remote_ctx)
+  {
+    s->status = GNUNET_SCALARPRODUCT_STATUS_FAILURE;
+    prepare_client_end_notification (s);
+    return;
+  }
   if (s->client_received_element_count == s->total)
     start_intersection (s);
 }
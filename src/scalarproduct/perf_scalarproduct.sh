@@ -26,8 +26,8 @@
 
 #
 #
-# Configure benchmark size:
-SIZE=800
+# Configure benchmark size (first argument, default 800):
+SIZE=${1:-800}
 #
 # Construct input vectors:
 INPUTALICE="-k CCC -e '"
@@ -64,7 +64,10 @@ PEERIDBOB=`gnunet-peerinfo -qs $CFGBOB`
 
 echo "Running problem of size $SIZE"
 gnunet-scalarproduct $CFGBOB $INPUTBOB &
+START=`date +%s.%N`
 time RESULT=`gnunet-scalarproduct $CFGALICE $INPUTALICE -p $PEERIDBOB`
+END=`date +%s.%N`
+echo "$SIZE elements in `echo "$END - $START" | bc` s, `echo "$SIZE / ($END - $START)" | bc` elements/s"
 gnunet-statistics $CFGALICE -s core | grep "bytes encrypted"
 gnunet-statistics $CFGBOB -s core | grep "bytes encrypted"
 
@@ -43,6 +43,12 @@ static unsigned int threshold = 2;
  */
 static int decrypt = GNUNET_NO;
 
+/**
+ * How many worker threads should the services use?
+ * UINT_MAX to leave the configuration alone.
+ */
+static unsigned int num_workers = UINT_MAX;
+
 /**
  * When would we like to see the operation finished?
  */
@@ -103,6 +109,26 @@ static struct GNUNET_TIME_Absolute decrypt_start;
 
 static struct GNUNET_TIME_Absolute decrypt_deadline;
 
+/**
+ * When did we connect to the services for the key generation?
+ */
+static struct GNUNET_TIME_Absolute dkg_connect_time;
+
+/**
+ * When did we connect to the services for the decryption?
+ */
+static struct GNUNET_TIME_Absolute decrypt_connect_time;
+
+/**
+ * How long did it take until the first peer had its share?
+ */
+static struct GNUNET_TIME_Relative dkg_first_duration;
+
+/**
+ * How long did it take until the first peer decrypted?
+ */
+static struct GNUNET_TIME_Relative decrypt_first_duration;
+
 /**
  * Connect operations, one for every peer.
  */
@@ -201,6 +227,32 @@ decrypt_connect_complete (void *cls,
 }
 
 
+/**
+ * Print how long a phase took.
+ *
+ * @param phase name of the phase
+ * @param first time until the first peer was done
+ * @param start when did the phase start
+ */
+static void
+print_phase (const char *phase,
+             struct GNUNET_TIME_Relative first,
+             struct GNUNET_TIME_Absolute start)
+{
+  struct GNUNET_TIME_Relative duration;
+
+  duration = GNUNET_TIME_absolute_get_duration (start);
+  printf ("%s with %u peers took %s",
+          phase,
+          num_peers,
+          GNUNET_STRINGS_relative_time_to_string (duration,
+                                                  GNUNET_YES));
+  printf (" (first peer after %s)\n",
+          GNUNET_STRINGS_relative_time_to_string (first,
+                                                  GNUNET_YES));
+}
+
+
 /**
  * Called when a decryption has succeeded.
  *
@@ -215,6 +267,9 @@ decrypt_cb (void *cls,
   unsigned int n = dhp - decrypt_handles;
 
   num_decrypted++;
+  if (1 == num_decrypted)
+    decrypt_first_duration =
+      GNUNET_TIME_absolute_get_duration (decrypt_connect_time);
 
   *dhp = NULL;
 
@@ -238,6 +293,9 @@ decrypt_cb (void *cls,
   if (num_decrypted == num_peers)
   {
     GNUNET_log (GNUNET_ERROR_TYPE_INFO, "every peer decrypted\n");
+    print_phase ("decryption",
+                 decrypt_first_duration,
+                 decrypt_connect_time);
     GNUNET_SCHEDULER_shutdown ();
   }
 
@@ -313,6 +371,9 @@ secret_ready_cb (void *cls,
   char *ret;
 
   num_generated++;
+  if (1 == num_generated)
+    dkg_first_duration =
+      GNUNET_TIME_absolute_get_duration (dkg_connect_time);
   *sp = NULL;
   shares[n] = my_share;
   if (NULL == my_share)
@@ -415,6 +476,10 @@ session_disconnect_adapter (void *cls, void *op_result)
   {
     int i;
 
+    print_phase ("key generation",
+                 dkg_first_duration,
+                 dkg_connect_time);
+
     // only do decryption if requested by the user
     if (GNUNET_NO == decrypt)
     {
@@ -432,6 +497,7 @@ session_disconnect_adapter (void *cls, void *op_result)
     GNUNET_SECRETSHARING_encrypt (&common_pubkey, &reference_plaintext,
                                   &ciphertext);
 
+    decrypt_connect_time = GNUNET_TIME_absolute_get ();
     for (i = 0; i < num_peers; i++)
       connect_ops[i] =
         GNUNET_TESTBED_service_connect (NULL, peers[i], "secretsharing",
@@ -470,6 +536,8 @@ peer_info_cb (void *cb_cls,
     *p = *pinfo->result.id;
     num_retrieved_peer_ids++;
     if (num_retrieved_peer_ids == num_peers)
+    {
+      dkg_connect_time = GNUNET_TIME_absolute_get ();
       for (i = 0; i < num_peers; i++)
         connect_ops[i] =
           GNUNET_TESTBED_service_connect (NULL, peers[i], "secretsharing",
@@ -477,6 +545,7 @@ peer_info_cb (void *cb_cls,
                                           session_connect_adapter,
                                           session_disconnect_adapter,
                                           &session_handles[i]);
+    }
   }
   else
   {
@@ -572,6 +641,7 @@ run (void *cls, char *const *args, const char *cfgfile,
 {
   static char *session_str = "gnunet-secretsharing/test";
   char *topology;
+  char *workers_cfgfile = NULL;
   int topology_cmp_result;
 
   dkg_start = GNUNET_TIME_absolute_add (GNUNET_TIME_absolute_get (), delay);
@@ -603,6 +673,34 @@ run (void *cls, char *const *args, const char *cfgfile,
 
   GNUNET_CRYPTO_hash (session_str, strlen (session_str), &session_id);
 
+  if (UINT_MAX != num_workers)
+  {
+    struct GNUNET_CONFIGURATION_Handle *wcfg;
+
+    /* the peers get their configuration from the file */
+    wcfg = GNUNET_CONFIGURATION_dup (cfg);
+    GNUNET_CONFIGURATION_set_value_number (wcfg,
+                                           "secretsharing",
+                                           "WORKERS",
+                                           num_workers);
+    workers_cfgfile = GNUNET_DISK_mktemp ("gnunet-secretsharing-profiler");
+    if ((NULL == workers_cfgfile) ||
+        (GNUNET_OK != GNUNET_CONFIGURATION_write (wcfg,
+                                                  workers_cfgfile)))
+    {
+      fprintf (stderr,
+               "Failed to write configuration with %u workers\n",
+               num_workers);
+      GNUNET_CONFIGURATION_destroy (wcfg);
+      GNUNET_free (workers_cfgfile);
+      return;
+    }
+    GNUNET_CONFIGURATION_destroy (wcfg);
+    cfgfile = workers_cfgfile;
+    printf ("using %u worker threads per peer\n",
+            num_workers);
+  }
+
   (void) GNUNET_TESTBED_test_run ("gnunet-secretsharing-profiler",
                                   cfgfile,
                                   num_peers,
@@ -611,6 +709,15 @@ run (void *cls, char *const *args, const char *cfgfile,
                                   NULL,
                                   test_master,
                                   NULL);
+
+  if (NULL != workers_cfgfile)
+  {
+    if (0 != unlink (workers_cfgfile))
+      GNUNET_log_strerror_file (GNUNET_ERROR_TYPE_WARNING,
+                                "unlink",
+                                workers_cfgfile);
+    GNUNET_free (workers_cfgfile);
+  }
 }
 
 
@@ -647,6 +754,13 @@ main (int argc, char **argv)
                                gettext_noop ("also profile decryption"),
                                &decrypt),
 
+    GNUNET_GETOPT_option_uint ('w',
+                               "workers",
+                               NULL,
+                               gettext_noop (
+                                 "number of worker threads per peer, 0 to do the work in the main thread"),
+                               &num_workers),
+
 
     GNUNET_GETOPT_option_verbose (&verbose),
 
@@ -35,6 +35,12 @@
 
 #define EXTRA_CHECKS 1
 
+/**
+ * Upper limit for the number of worker threads we start when the
+ * configuration does not say how many we should use.
+ */
+#define MAX_WORKERS 16
+
 
 /**
  * Info about a peer in a key generation session.
@@ -114,6 +120,18 @@ struct DecryptPeerInfo
 struct ClientState;
 
 
+/**
+ * Fair encryption of a pre-share, done by a worker.
+ */
+struct EncryptJob;
+
+
+/**
+ * Verification of a round 2 element, done by a worker.
+ */
+struct VerifyJob;
+
+
 /**
  * Session to establish a threshold-shared secret.
  */
@@ -205,6 +223,42 @@ struct KeygenSession
    * Public key, will be updated when a round2 element arrives.
    */
   gcry_mpi_t public_key;
+
+  /**
+   * Our round 2 element while the workers compute it.
+   */
+  struct GNUNET_SET_Element *round2_element;
+
+  /**
+   * Pending encryptions of our pre-shares.
+   */
+  struct EncryptJob *encrypt_head;
+
+  /**
+   * Pending encryptions of our pre-shares.
+   */
+  struct EncryptJob *encrypt_tail;
+
+  /**
+   * Pending verifications of round 2 elements.
+   */
+  struct VerifyJob *verify_head;
+
+  /**
+   * Pending verifications of round 2 elements.
+   */
+  struct VerifyJob *verify_tail;
+
+  /**
+   * When did the second round start?
+   */
+  struct GNUNET_TIME_Absolute round2_start;
+
+  /**
+   * #GNUNET_YES if the round 2 consensus concluded while
+   * verifications were still pending.
+   */
+  int round2_concluded;
 };
 
 
@@ -253,6 +307,115 @@ struct DecryptSession
 };
 
 
+/**
+ * Fair encryption of the pre-share for one peer, which is part of
+ * our round 2 element.
+ */
+struct EncryptJob
+{
+  /**
+   * Kept in a DLL.
+   */
+  struct EncryptJob *next;
+
+  /**
+   * Kept in a DLL.
+   */
+  struct EncryptJob *prev;
+
+  /**
+   * Session the job belongs to.
+   */
+  struct KeygenSession *ks;
+
+  /**
+   * Job handed to the workers.
+   */
+  struct GNUNET_THREAD_Job *job;
+
+  /**
+   * Index of the peer the pre-share is for.
+   */
+  unsigned int peer_idx;
+
+  /**
+   * Where to write the encryption, points into the
+   * round 2 element of @e ks.
+   */
+  struct GNUNET_SECRETSHARING_FairEncryption *fe;
+};
+
+
+/**
+ * Verification of the round 2 element of a peer.
+ */
+struct VerifyJob
+{
+  /**
+   * Kept in a DLL.
+   */
+  struct VerifyJob *next;
+
+  /**
+   * Kept in a DLL.
+   */
+  struct VerifyJob *prev;
+
+  /**
+   * Session the job belongs to.
+   */
+  struct KeygenSession *ks;
+
+  /**
+   * Job handed to the workers.
+   */
+  struct GNUNET_THREAD_Job *job;
+
+  /**
+   * Peer that sent the element.
+   */
+  struct KeygenPeerInfo *info;
+
+  /**
+   * Copy of the element data, allocated with the job.
+   */
+  struct GNUNET_SECRETSHARING_KeygenRevealData *d;
+
+  /**
+   * Share of the public key of the peer.
+   */
+  gcry_mpi_t public_key_share;
+
+  /**
+   * Commitment to the pre-share for our peer.
+   */
+  gcry_mpi_t preshare_commitment;
+
+  /**
+   * Decrypted pre-share for our peer.
+   */
+  gcry_mpi_t preshare;
+
+  /**
+   * #GNUNET_YES if @e preshare matches @e preshare_commitment.
+   */
+  int preshare_valid;
+
+  /**
+   * Index of the first peer whose exponentiated pre-share does not
+   * match the exponentiated coefficients, number of peers if all
+   * match.
+   */
+  unsigned int bad_sharing;
+
+  /**
+   * Index of the first peer with an invalid proof of fair
+   * encryption, number of peers if all proofs are valid.
+   */
+  unsigned int bad_encryption;
+};
+
+
 /**
  * State we keep per client.
  */
@@ -313,6 +476,58 @@ static struct GNUNET_CRYPTO_EddsaPrivateKey *my_peer_private_key;
  */
 static const struct GNUNET_CONFIGURATION_Handle *cfg;
 
+/**
+ * Number of worker threads, 0 to do the work in the main thread.
+ */
+static unsigned long long worker_count;
+
+/**
+ * Our worker threads, NULL after shutdown.
+ */
+static struct GNUNET_THREAD_Pool *crypto_pool;
+
+
+/**
+ * Hand work to the workers.  If we have no workers, the work is
+ * done right away, but @a done is still only run from the
+ * scheduler.  After shutdown, the work is not done at all.
+ *
+ * @param work work to do in a worker thread
+ * @param done continuation to run in the main thread
+ * @param cls closure for @a work and @a done
+ * @return handle to cancel the job
+ */
+static struct GNUNET_THREAD_Job *
+crypto_job_submit (GNUNET_THREAD_JobWork work,
+                   GNUNET_THREAD_JobDone done,
+                   void *cls)
+{
+  if (NULL == crypto_pool)
+    return NULL;
+  return GNUNET_THREAD_pool_submit (crypto_pool,
+                                    work,
+                                    done,
+                                    cls);
+}
+
+
+/**
+ * Cancel a job.  Its continuation will not be run.  If a worker is
+ * running the job, wait for it to finish, so that the caller may
+ * release whatever state the job uses.
+ *
+ * @param job job to cancel, NULL if it was submitted after shutdown
+ */
+static void
+crypto_job_cancel (struct GNUNET_THREAD_Job *job)
+{
+  /* after shutdown, the pool took its jobs along */
+  if ((NULL == job) ||
+      (NULL == crypto_pool))
+    return;
+  GNUNET_THREAD_pool_cancel (job);
+}
+
 
 /**
  * Get the peer info belonging to a peer identity in a keygen session.
@@ -573,6 +788,24 @@ decrypt_session_destroy (struct DecryptSession *ds)
 }
 
 
+/**
+ * Free a round 2 verification and the results it holds.
+ *
+ * @param vj verification to free
+ */
+static void
+verify_job_free (struct VerifyJob *vj)
+{
+  if (NULL != vj->public_key_share)
+    gcry_mpi_release (vj->public_key_share);
+  if (NULL != vj->preshare_commitment)
+    gcry_mpi_release (vj->preshare_commitment);
+  if (NULL != vj->preshare)
+    gcry_mpi_release (vj->preshare);
+  GNUNET_free (vj);
+}
+
+
 static void
 keygen_info_destroy (struct KeygenPeerInfo *info)
 {
@@ -597,6 +830,9 @@ keygen_info_destroy (struct KeygenPeerInfo *info)
 static void
 keygen_session_destroy (struct KeygenSession *ks)
 {
+  struct EncryptJob *ej;
+  struct VerifyJob *vj;
+
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "destroying keygen session\n");
 
@@ -605,6 +841,24 @@ keygen_session_destroy (struct KeygenSession *ks)
     ks->cs->keygen_session = NULL;
     ks->cs = NULL;
   }
+  /* workers may still use the session, stop them first */
+  while (NULL != (ej = ks->encrypt_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (ks->encrypt_head,
+                                 ks->encrypt_tail,
+                                 ej);
+    crypto_job_cancel (ej->job);
+    GNUNET_free (ej);
+  }
+  while (NULL != (vj = ks->verify_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (ks->verify_head,
+                                 ks->verify_tail,
+                                 vj);
+    crypto_job_cancel (vj->job);
+    verify_job_free (vj);
+  }
+  GNUNET_free (ks->round2_element);
   if (NULL != ks->info)
   {
     for (unsigned int i = 0; i < ks->num_peers; i++)
@@ -658,7 +912,11 @@ keygen_session_destroy (struct KeygenSession *ks)
 static void
 cleanup_task (void *cls)
 {
-  /* Nothing to do! */
+  if (NULL != crypto_pool)
+  {
+    GNUNET_THREAD_pool_destroy (crypto_pool);
+    crypto_pool = NULL;
+  }
 }
 
 
@@ -792,10 +1050,15 @@ horner_eval (gcry_mpi_t z, gcry_mpi_t *coeff, unsigned int num_coeff, gcry_mpi_t
 }
 
 
+/**
+ * Send the share to the client, once the second round concluded
+ * and all round 2 elements are verified.
+ *
+ * @param ks the session
+ */
 static void
-keygen_round2_conclude (void *cls)
+keygen_send_share (struct KeygenSession *ks)
 {
-  struct KeygenSession *ks = cls;
   struct GNUNET_SECRETSHARING_SecretReadyMessage *m;
   struct GNUNET_MQ_Envelope *ev;
   size_t share_size;
@@ -803,10 +1066,12 @@ keygen_round2_conclude (void *cls)
   unsigned int j;
   struct GNUNET_SECRETSHARING_Share *share;
 
-  GNUNET_log (GNUNET_ERROR_TYPE_INFO, "round2 conclude\n");
-
-  GNUNET_CONSENSUS_destroy (ks->consensus);
-  ks->consensus = NULL;
+  GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+              "P%u: round 2 took %s\n",
+              ks->local_peer_idx,
+              GNUNET_STRINGS_relative_time_to_string (
+                GNUNET_TIME_absolute_get_duration (ks->round2_start),
+                GNUNET_YES));
 
   share = GNUNET_new (struct GNUNET_SECRETSHARING_Share);
 
@@ -883,6 +1148,31 @@ keygen_round2_conclude (void *cls)
 }
 
 
+/**
+ * Called when the second consensus round has concluded.
+ *
+ * @param cls closure (keygen session)
+ */
+static void
+keygen_round2_conclude (void *cls)
+{
+  struct KeygenSession *ks = cls;
+
+  GNUNET_log (GNUNET_ERROR_TYPE_INFO, "round2 conclude\n");
+
+  GNUNET_CONSENSUS_destroy (ks->consensus);
+  ks->consensus = NULL;
+
+  if (NULL != ks->verify_head)
+  {
+    /* the last verification will send the share */
+    ks->round2_concluded = GNUNET_YES;
+    return;
+  }
+  keygen_send_share (ks);
+}
+
+
 static void
 restore_fair (const struct GNUNET_CRYPTO_PaillierPublicKey *ppub,
               const struct GNUNET_SECRETSHARING_FairEncryption *fe,
@@ -1029,6 +1319,14 @@ get_fair_encryption_challenge (const struct
 }
 
 
+/**
+ * Verify the proof that a Paillier encryption is fair.
+ * Run by the workers, thus must not log.
+ *
+ * @param ppub Paillier public key of the receiver
+ * @param fe the fair encryption
+ * @return #GNUNET_YES if the proof is valid
+ */
 static int
 verify_fair (const struct GNUNET_CRYPTO_PaillierPublicKey *ppub,
              const struct GNUNET_SECRETSHARING_FairEncryption *fe)
@@ -1080,7 +1378,6 @@ verify_fair (const struct GNUNET_CRYPTO_PaillierPublicKey *ppub,
 
   if (0 == gcry_mpi_cmp (t1, tmp1))
   {
-    GNUNET_log (GNUNET_ERROR_TYPE_ERROR, "fair encryption invalid (t1)\n");
     res = GNUNET_NO;
     goto cleanup;
   }
@@ -1099,7 +1396,6 @@ verify_fair (const struct GNUNET_CRYPTO_PaillierPublicKey *ppub,
 
   if (0 == gcry_mpi_cmp (t2, tmp1))
   {
-    GNUNET_log (GNUNET_ERROR_TYPE_ERROR, "fair encryption invalid (t2)\n");
     res = GNUNET_NO;
     goto cleanup;
   }
@@ -1246,13 +1542,111 @@ encrypt_fair (gcry_mpi_t v,
 
 
 /**
- * Insert round 2 element in the consensus, consisting of
+ * Sign our round 2 element, insert it in the consensus and conclude
+ * the second round.  Called once the workers encrypted all
+ * pre-shares.
+ *
+ * @param ks session to use
+ */
+static void
+finish_round2_element (struct KeygenSession *ks)
+{
+  struct GNUNET_SET_Element *element = ks->round2_element;
+  struct GNUNET_SECRETSHARING_KeygenRevealData *d;
+
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "P%u: computed enc preshares\n",
+              ks->local_peer_idx);
+
+  d = (void *) element->data;
+  d->purpose.size = htonl (element->size - offsetof (struct
+                                                     GNUNET_SECRETSHARING_KeygenRevealData,
+                                                     purpose));
+  d->purpose.purpose = htonl (GNUNET_SIGNATURE_PURPOSE_SECRETSHARING_DKG2);
+  GNUNET_assert (GNUNET_OK ==
+                 GNUNET_CRYPTO_eddsa_sign_ (my_peer_private_key,
+                                            &d->purpose,
+                                            &d->signature));
+
+  GNUNET_CONSENSUS_insert (ks->consensus, element, NULL, NULL);
+  GNUNET_free (element);
+  ks->round2_element = NULL;
+
+  GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+              "P%u: round 2 element ready after %s\n",
+              ks->local_peer_idx,
+              GNUNET_STRINGS_relative_time_to_string (
+                GNUNET_TIME_absolute_get_duration (ks->round2_start),
+                GNUNET_YES));
+
+  GNUNET_CONSENSUS_conclude (ks->consensus,
+                             keygen_round2_conclude,
+                             ks);
+}
+
+
+/**
+ * Evaluate our pre-secret polynomial for a peer and encrypt
+ * the result.  Run by a worker.  The polynomial and the Paillier
+ * keys do not change after the first round, so we can read them
+ * from the session.
+ *
+ * @param cls the `struct EncryptJob`
+ */
+static void
+encrypt_preshare (void *cls)
+{
+  struct EncryptJob *ej = cls;
+  struct KeygenSession *ks = ej->ks;
+  gcry_mpi_t idx;
+  gcry_mpi_t v;
+
+  GNUNET_assert (NULL != (v = gcry_mpi_new (
+                            GNUNET_SECRETSHARING_ELGAMAL_BITS)));
+  GNUNET_assert (NULL != (idx = gcry_mpi_new (
+                            GNUNET_SECRETSHARING_ELGAMAL_BITS)));
+  gcry_mpi_set_ui (idx, ej->peer_idx + 1);
+  // evaluate the polynomial
+  horner_eval (v, ks->presecret_polynomial, ks->threshold, idx,
+               elgamal_q);
+  // encrypt the result
+  encrypt_fair (v, &ks->info[ej->peer_idx].paillier_public_key, ej->fe);
+  gcry_mpi_release (v);
+  gcry_mpi_release (idx);
+}
+
+
+/**
+ * A worker encrypted one of our pre-shares.
+ *
+ * @param cls the `struct EncryptJob`
+ */
+static void
+encrypt_preshare_done (void *cls)
+{
+  struct EncryptJob *ej = cls;
+  struct KeygenSession *ks = ej->ks;
+
+  GNUNET_CONTAINER_DLL_remove (ks->encrypt_head,
+                               ks->encrypt_tail,
+                               ej);
+  GNUNET_free (ej);
+  if (NULL == ks->encrypt_head)
+    finish_round2_element (ks);
+}
+
+
+/**
+ * Start computing our round 2 element, consisting of
  * (1) The exponentiated pre-share polynomial coefficients A_{i,l}=g^{a_{i,l}}
  * (2) The exponentiated pre-shares y_{i,j}=g^{s_{i,j}}
  * (3) The encrypted pre-shares Y_{i,j}
  * (4) The zero knowledge proof for fairness of
  *     the encryption
  *
+ * The encryptions are done by the workers, one job per peer, while
+ * the round 2 consensus is already running; the element is inserted
+ * by #finish_round2_element() once they are all done.
+ *
  * @param ks session to use
  */
 static void
@@ -1264,7 +1658,6 @@ insert_round2_element (struct KeygenSession *ks)
   unsigned char *last_pos;
   size_t element_size;
   unsigned int i;
-  gcry_mpi_t idx;
   gcry_mpi_t v;
 
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "P%u: Inserting round2 element\n",
@@ -1272,8 +1665,6 @@ insert_round2_element (struct KeygenSession *ks)
 
   GNUNET_assert (NULL != (v = gcry_mpi_new (
                             GNUNET_SECRETSHARING_ELGAMAL_BITS)));
-  GNUNET_assert (NULL != (idx = gcry_mpi_new (
-                            GNUNET_SECRETSHARING_ELGAMAL_BITS)));
 
   element_size = (sizeof(struct GNUNET_SECRETSHARING_KeygenRevealData)
                   + sizeof(struct GNUNET_SECRETSHARING_FairEncryption)
@@ -1283,6 +1674,7 @@ insert_round2_element (struct KeygenSession *ks)
   element = GNUNET_malloc (sizeof(struct GNUNET_SET_Element) + element_size);
   element->size = element_size;
   element->data = (void *) &element[1];
+  ks->round2_element = element;
 
   d = (void *) element->data;
   d->peer = my_peer;
@@ -1292,36 +1684,34 @@ insert_round2_element (struct KeygenSession *ks)
   pos = (void *) &d[1];
   last_pos = pos + element_size;
 
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "P%u: computed exp preshares\n",
-              ks->local_peer_idx);
-
   // encrypted pre-shares
   // and fair encryption proof
+  for (i = 0; i < ks->num_peers; i++)
   {
-    for (i = 0; i < ks->num_peers; i++)
-    {
-      ptrdiff_t remaining = last_pos - pos;
-      struct GNUNET_SECRETSHARING_FairEncryption *fe = (void *) pos;
+    ptrdiff_t remaining = last_pos - pos;
+    struct GNUNET_SECRETSHARING_FairEncryption *fe = (void *) pos;
 
-      GNUNET_assert (remaining > 0);
-      memset (fe, 0, sizeof *fe);
-      if (GNUNET_YES == ks->info[i].round1_valid)
-      {
-        gcry_mpi_set_ui (idx, i + 1);
-        // evaluate the polynomial
-        horner_eval (v, ks->presecret_polynomial, ks->threshold, idx,
-                     elgamal_q);
-        // encrypt the result
-        encrypt_fair (v, &ks->info[i].paillier_public_key, fe);
-      }
-      pos += sizeof *fe;
+    GNUNET_assert (remaining > 0);
+    memset (fe, 0, sizeof *fe);
+    if (GNUNET_YES == ks->info[i].round1_valid)
+    {
+      struct EncryptJob *ej;
+
+      ej = GNUNET_new (struct EncryptJob);
+      ej->ks = ks;
+      ej->peer_idx = i;
+      ej->fe = fe;
+      GNUNET_CONTAINER_DLL_insert_tail (ks->encrypt_head,
+                                        ks->encrypt_tail,
+                                        ej);
+      ej->job = crypto_job_submit (&encrypt_preshare,
+                                   &encrypt_preshare_done,
+                                   ej);
     }
+    pos += sizeof *fe;
   }
 
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "P%u: computed enc preshares\n",
-              ks->local_peer_idx);
-
-  // exponentiated coefficients
+  // exponentiated coefficients, computed while the workers encrypt
   for (i = 0; i < ks->threshold; i++)
   {
     ptrdiff_t remaining = last_pos - pos;
@@ -1335,21 +1725,10 @@ insert_round2_element (struct KeygenSession *ks)
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "P%u: computed exp coefficients\n",
               ks->local_peer_idx);
 
-
-  d->purpose.size = htonl (element_size - offsetof (struct
-                                                    GNUNET_SECRETSHARING_KeygenRevealData,
-                                                    purpose));
-  d->purpose.purpose = htonl (GNUNET_SIGNATURE_PURPOSE_SECRETSHARING_DKG2);
-  GNUNET_assert (GNUNET_OK ==
-                 GNUNET_CRYPTO_eddsa_sign_ (my_peer_private_key,
-                                            &d->purpose,
-                                            &d->signature));
-
-  GNUNET_CONSENSUS_insert (ks->consensus, element, NULL, NULL);
-  GNUNET_free (element);  /* FIXME: maybe stack-allocate instead? */
-
   gcry_mpi_release (v);
-  gcry_mpi_release (idx);
+
+  if (NULL == ks->encrypt_head)
+    finish_round2_element (ks);
 }
 
 
@@ -1410,6 +1789,187 @@ keygen_reveal_get_exp_preshare (struct KeygenSession *ks,
 }
 
 
+/**
+ * Verify a round 2 element.  Run by a worker.  Only uses parts of
+ * the session that do not change after the first round.
+ *
+ * @param cls the `struct VerifyJob`
+ */
+static void
+verify_round2_element (void *cls)
+{
+  struct VerifyJob *vj = cls;
+  struct KeygenSession *ks = vj->ks;
+  const struct GNUNET_SECRETSHARING_KeygenRevealData *d = vj->d;
+  unsigned int j;
+  gcry_mpi_t tmp;
+  gcry_mpi_t prod;
+  gcry_mpi_t j_to_k;
+
+  vj->bad_sharing = ks->num_peers;
+  vj->bad_encryption = ks->num_peers;
+  vj->public_key_share = keygen_reveal_get_exp_coeff (ks, d, 0);
+  vj->preshare_commitment = keygen_reveal_get_exp_preshare (ks, d,
+                                                            ks->local_peer_idx);
+
+  {
+    struct GNUNET_SECRETSHARING_FairEncryption *fe =
+      keygen_reveal_get_enc_preshare (ks, d, ks->local_peer_idx);
+    GNUNET_assert (NULL != (vj->preshare = gcry_mpi_new (0)));
+    GNUNET_CRYPTO_paillier_decrypt (&ks->paillier_private_key,
+                                    &ks->info[ks->local_peer_idx].
+                                    paillier_public_key,
+                                    &fe->c,
+                                    vj->preshare);
+
+    // FIXME: not doing the restoration is less expensive
+    restore_fair (&ks->info[ks->local_peer_idx].paillier_public_key,
+                  fe,
+                  vj->preshare,
+                  vj->preshare);
+  }
+
+  GNUNET_assert (NULL != (tmp = gcry_mpi_new (0)));
+  gcry_mpi_powm (tmp, elgamal_g, vj->preshare, elgamal_p);
+  vj->preshare_valid = (0 == gcry_mpi_cmp (tmp, vj->preshare_commitment))
+                       ? GNUNET_YES : GNUNET_NO;
+  gcry_mpi_release (tmp);
+  if (GNUNET_YES != vj->preshare_valid)
+    return;
+
+  GNUNET_assert (NULL != (prod = gcry_mpi_new (0)));
+  GNUNET_assert (NULL != (j_to_k = gcry_mpi_new (0)));
+  // validate that the polynomial sharing matches the additive sharing
+  for (j = 0; j < ks->num_peers; j++)
+  {
+    unsigned int k;
+    int cmp_result;
+    gcry_mpi_t exp_preshare;
+    gcry_mpi_set_ui (prod, 1);
+    for (k = 0; k < ks->threshold; k++)
+    {
+      // Using pow(double,double) is a bit sketchy.
+      // We count players from 1, but shares from 0.
+      gcry_mpi_t tmp;
+      gcry_mpi_set_ui (j_to_k, (unsigned int) pow (j + 1, k));
+      tmp = keygen_reveal_get_exp_coeff (ks, d, k);
+      gcry_mpi_powm (tmp, tmp, j_to_k, elgamal_p);
+      gcry_mpi_mulm (prod, prod, tmp, elgamal_p);
+      gcry_mpi_release (tmp);
+    }
+    exp_preshare = keygen_reveal_get_exp_preshare (ks, d, j);
+    gcry_mpi_mod (exp_preshare, exp_preshare, elgamal_p);
+    cmp_result = gcry_mpi_cmp (prod, exp_preshare);
+    gcry_mpi_release (exp_preshare);
+    exp_preshare = NULL;
+    if (0 != cmp_result)
+    {
+      /* no need for further verification, round2 stays invalid ... */
+      vj->bad_sharing = j;
+      break;
+    }
+  }
+  gcry_mpi_release (prod);
+  gcry_mpi_release (j_to_k);
+  if (vj->bad_sharing < ks->num_peers)
+    return;
+
+  for (j = 0; j < ks->num_peers; j++)
+  {
+    struct GNUNET_SECRETSHARING_FairEncryption *fe =
+      keygen_reveal_get_enc_preshare (ks, d, j);
+    if (GNUNET_YES != verify_fair (&ks->info[j].paillier_public_key, fe))
+    {
+      vj->bad_encryption = j;
+      break;
+    }
+  }
+}
+
+
+/**
+ * A worker verified a round 2 element.  Add the peer's
+ * contribution to the key and our share.
+ *
+ * @param cls the `struct VerifyJob`
+ */
+static void
+verify_round2_element_done (void *cls)
+{
+  struct VerifyJob *vj = cls;
+  struct KeygenSession *ks = vj->ks;
+  struct KeygenPeerInfo *info = vj->info;
+  unsigned int j;
+
+  GNUNET_CONTAINER_DLL_remove (ks->verify_head,
+                               ks->verify_tail,
+                               vj);
+  if (NULL != info->preshare_commitment)
+    gcry_mpi_release (info->preshare_commitment);
+  info->preshare_commitment = vj->preshare_commitment;
+  vj->preshare_commitment = NULL;
+
+  if (NULL == ks->public_key)
+  {
+    GNUNET_assert (NULL != (ks->public_key = gcry_mpi_new (0)));
+    gcry_mpi_set_ui (ks->public_key, 1);
+  }
+  gcry_mpi_mulm (ks->public_key, ks->public_key, vj->public_key_share,
+                 elgamal_p);
+
+  if (GNUNET_YES != vj->preshare_valid)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                "P%u: Got invalid presecret from P%u\n",
+                (unsigned int) ks->local_peer_idx, (unsigned int) (info
+                                                                   - ks->info));
+    goto done;
+  }
+
+  if (NULL == ks->my_share)
+  {
+    GNUNET_assert (NULL != (ks->my_share = gcry_mpi_new (0)));
+  }
+  gcry_mpi_addm (ks->my_share, ks->my_share, vj->preshare, elgamal_q);
+
+  for (j = 0; j < ks->num_peers; j++)
+  {
+    gcry_mpi_t presigma;
+    if (NULL == ks->info[j].sigma)
+    {
+      GNUNET_assert (NULL != (ks->info[j].sigma = gcry_mpi_new (0)));
+      gcry_mpi_set_ui (ks->info[j].sigma, 1);
+    }
+    presigma = keygen_reveal_get_exp_preshare (ks, vj->d, j);
+    gcry_mpi_mulm (ks->info[j].sigma, ks->info[j].sigma, presigma, elgamal_p);
+    gcry_mpi_release (presigma);
+  }
+
+  if (vj->bad_sharing < ks->num_peers)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                "P%u: reveal data from P%u incorrect\n",
+                ks->local_peer_idx, vj->bad_sharing);
+    goto done;
+  }
+  if (vj->bad_encryption < ks->num_peers)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                "P%u: reveal data from P%u incorrect (fair encryption)\n",
+                ks->local_peer_idx, vj->bad_encryption);
+    goto done;
+  }
+
+  info->round2_valid = GNUNET_YES;
+
+done:
+  verify_job_free (vj);
+  if ((NULL == ks->verify_head) &&
+      (GNUNET_YES == ks->round2_concluded))
+    keygen_send_share (ks);
+}
+
+
 static void
 keygen_round2_new_element (void *cls,
                            const struct GNUNET_SET_Element *element)
@@ -1417,12 +1977,8 @@ keygen_round2_new_element (void *cls,
   struct KeygenSession *ks = cls;
   const struct GNUNET_SECRETSHARING_KeygenRevealData *d;
   struct KeygenPeerInfo *info;
+  struct VerifyJob *vj;
   size_t expected_element_size;
-  unsigned int j;
-  int cmp_result;
-  gcry_mpi_t tmp;
-  gcry_mpi_t public_key_share;
-  gcry_mpi_t preshare;
 
   if (NULL == element)
   {
@@ -1466,7 +2022,11 @@ keygen_round2_new_element (void *cls,
     return;
   }
 
-  if (GNUNET_YES == info->round2_valid)
+  for (vj = ks->verify_head; NULL != vj; vj = vj->next)
+    if (vj->info == info)
+      break;
+  if ((GNUNET_YES == info->round2_valid) ||
+      (NULL != vj))
   {
     GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
                 "ignoring duplicate round2 element (%s)\n",
@@ -1495,127 +2055,20 @@ keygen_round2_new_element (void *cls,
     return;
   }
 
-  public_key_share = keygen_reveal_get_exp_coeff (ks, d, 0);
-  info->preshare_commitment = keygen_reveal_get_exp_preshare (ks, d,
-                                                              ks->local_peer_idx);
-
-  if (NULL == ks->public_key)
-  {
-    GNUNET_assert (NULL != (ks->public_key = gcry_mpi_new (0)));
-    gcry_mpi_set_ui (ks->public_key, 1);
-  }
-  gcry_mpi_mulm (ks->public_key, ks->public_key, public_key_share, elgamal_p);
-
-  gcry_mpi_release (public_key_share);
-  public_key_share = NULL;
-
-  {
-    struct GNUNET_SECRETSHARING_FairEncryption *fe =
-      keygen_reveal_get_enc_preshare (ks, d, ks->local_peer_idx);
-    GNUNET_assert (NULL != (preshare = gcry_mpi_new (0)));
-    GNUNET_CRYPTO_paillier_decrypt (&ks->paillier_private_key,
-                                    &ks->info[ks->local_peer_idx].
-                                    paillier_public_key,
-                                    &fe->c,
-                                    preshare);
-
-    // FIXME: not doing the restoration is less expensive
-    restore_fair (&ks->info[ks->local_peer_idx].paillier_public_key,
-                  fe,
-                  preshare,
-                  preshare);
-  }
-
-  GNUNET_assert (NULL != (tmp = gcry_mpi_new (0)));
-  gcry_mpi_powm (tmp, elgamal_g, preshare, elgamal_p);
-
-  cmp_result = gcry_mpi_cmp (tmp, info->preshare_commitment);
-  gcry_mpi_release (tmp);
-  tmp = NULL;
-  if (0 != cmp_result)
-  {
-    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
-                "P%u: Got invalid presecret from P%u\n",
-                (unsigned int) ks->local_peer_idx, (unsigned int) (info
-                                                                   - ks->info));
-    return;
-  }
-
-  if (NULL == ks->my_share)
-  {
-    GNUNET_assert (NULL != (ks->my_share = gcry_mpi_new (0)));
-  }
-  gcry_mpi_addm (ks->my_share, ks->my_share, preshare, elgamal_q);
-
-  for (j = 0; j < ks->num_peers; j++)
-  {
-    gcry_mpi_t presigma;
-    if (NULL == ks->info[j].sigma)
-    {
-      GNUNET_assert (NULL != (ks->info[j].sigma = gcry_mpi_new (0)));
-      gcry_mpi_set_ui (ks->info[j].sigma, 1);
-    }
-    presigma = keygen_reveal_get_exp_preshare (ks, d, j);
-    gcry_mpi_mulm (ks->info[j].sigma, ks->info[j].sigma, presigma, elgamal_p);
-    gcry_mpi_release (presigma);
-  }
-
-  gcry_mpi_t prod;
-  GNUNET_assert (NULL != (prod = gcry_mpi_new (0)));
-  gcry_mpi_t j_to_k;
-  GNUNET_assert (NULL != (j_to_k = gcry_mpi_new (0)));
-  // validate that the polynomial sharing matches the additive sharing
-  for (j = 0; j < ks->num_peers; j++)
-  {
-    unsigned int k;
-    int cmp_result;
-    gcry_mpi_t exp_preshare;
-    gcry_mpi_set_ui (prod, 1);
-    for (k = 0; k < ks->threshold; k++)
-    {
-      // Using pow(double,double) is a bit sketchy.
-      // We count players from 1, but shares from 0.
-      gcry_mpi_t tmp;
-      gcry_mpi_set_ui (j_to_k, (unsigned int) pow (j + 1, k));
-      tmp = keygen_reveal_get_exp_coeff (ks, d, k);
-      gcry_mpi_powm (tmp, tmp, j_to_k, elgamal_p);
-      gcry_mpi_mulm (prod, prod, tmp, elgamal_p);
-      gcry_mpi_release (tmp);
-    }
-    exp_preshare = keygen_reveal_get_exp_preshare (ks, d, j);
-    gcry_mpi_mod (exp_preshare, exp_preshare, elgamal_p);
-    cmp_result = gcry_mpi_cmp (prod, exp_preshare);
-    gcry_mpi_release (exp_preshare);
-    exp_preshare = NULL;
-    if (0 != cmp_result)
-    {
-      GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
-                  "P%u: reveal data from P%u incorrect\n",
-                  ks->local_peer_idx, j);
-      /* no need for further verification, round2 stays invalid ... */
-      return;
-    }
-  }
-
-  // TODO: verify proof of fair encryption (once implemented)
-  for (j = 0; j < ks->num_peers; j++)
-  {
-    struct GNUNET_SECRETSHARING_FairEncryption *fe =
-      keygen_reveal_get_enc_preshare (ks, d, j);
-    if (GNUNET_YES != verify_fair (&ks->info[j].paillier_public_key, fe))
-    {
-      GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
-                  "P%u: reveal data from P%u incorrect (fair encryption)\n",
-                  ks->local_peer_idx, j);
-      return;
-    }
-  }
-
-  info->round2_valid = GNUNET_YES;
-
-  gcry_mpi_release (preshare);
-  gcry_mpi_release (prod);
-  gcry_mpi_release (j_to_k);
+  /* the expensive checks are done by the workers */
+  vj = GNUNET_malloc (sizeof(struct VerifyJob) + element->size);
+  vj->ks = ks;
+  vj->info = info;
+  vj->d = (struct GNUNET_SECRETSHARING_KeygenRevealData *) &vj[1];
+  GNUNET_memcpy (vj->d,
+                 element->data,
+                 element->size);
+  GNUNET_CONTAINER_DLL_insert_tail (ks->verify_head,
+                                    ks->verify_tail,
+                                    vj);
+  vj->job = crypto_job_submit (&verify_round2_element,
+                               &verify_round2_element_done,
+                               vj);
 }
 
 
@@ -1639,11 +2092,8 @@ keygen_round1_conclude (void *cls)
                                            ks->deadline,
                                            keygen_round2_new_element, ks);
 
+  ks->round2_start = GNUNET_TIME_absolute_get ();
   insert_round2_element (ks);
-
-  GNUNET_CONSENSUS_conclude (ks->consensus,
-                             keygen_round2_conclude,
-                             ks);
 }
 
 
@@ -2345,6 +2795,20 @@ run (void *cls,
     GNUNET_SCHEDULER_shutdown ();
     return;
   }
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (c,
+                                             "secretsharing",
+                                             "WORKERS",
+                                             &worker_count))
+  {
+    long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+
+    worker_count = (cpus > 0) ? GNUNET_MIN (cpus, MAX_WORKERS) : 1;
+  }
+  crypto_pool = GNUNET_THREAD_pool_create (worker_count);
+  GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+              "doing cryptographic work with %u worker threads\n",
+              GNUNET_THREAD_pool_get_size (crypto_pool));
   GNUNET_SCHEDULER_add_shutdown (&cleanup_task,
                                  NULL);
 }
@@ -760,6 +760,7 @@ execute_add (struct Set *set, const struct GNUNET_SET_ElementMessage *msg)
     ee->mutations = NULL;
     ee->mutations_size = 0;
     ee->element_hash = hash;
+    ee->have_ibf_key = GNUNET_NO;
     GNUNET_break (GNUNET_YES ==
                   GNUNET_CONTAINER_multihashmap_put (
                     set->content->elements,
@@ -270,6 +270,18 @@ struct ElementEntry
    * to the operation's set.
    */
   int remote;
+
+  /**
+   * Unsalted IBF key of the element, only valid if @e have_ibf_key
+   * is #GNUNET_YES.  Set union derives it once and keeps it here,
+   * since every operation on the element needs it.
+   */
+  uint64_t ibf_key;
+
+  /**
+   * #GNUNET_YES if @e ibf_key has been computed.
+   */
+  int have_ibf_key;
 };
 
 
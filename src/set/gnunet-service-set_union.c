@@ -70,6 +70,12 @@
  */
 #define IBF_ALPHA 4
 
+/**
+ * Maximum number of IBFs of the local elements we keep per set for
+ * reuse by later operations.
+ */
+#define MAX_BASE_IBFS 8
+
 
 /**
  * Current phase we are in for a union operation.
@@ -210,6 +216,61 @@ struct OperationState
    * the operation started.
    */
   uint64_t initial_size;
+
+  /**
+   * Version of the set's content at the time the operation
+   * started, see `struct SetState`.
+   */
+  uint64_t set_version;
+
+  /**
+   * Unsalted IBF keys of the elements we received from the other
+   * peer, which are not part of the base IBFs of the set.
+   */
+  struct IBF_Key *received_keys;
+
+  /**
+   * Number of entries in @e received_keys.
+   */
+  unsigned int received_keys_len;
+
+  /**
+   * Allocated length of @e received_keys.
+   */
+  unsigned int received_keys_size;
+};
+
+
+/**
+ * IBF of the local elements of a set, kept so that operations on
+ * an unchanged set do not have to insert all elements again.
+ */
+struct BaseIBF
+{
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct BaseIBF *next;
+
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct BaseIBF *prev;
+
+  /**
+   * The IBF.
+   */
+  struct InvertibleBloomFilter *ibf;
+
+  /**
+   * Salt of the keys in @e ibf.
+   */
+  uint32_t salt;
+
+  /**
+   * Version of the set the IBF was computed for.
+   */
+  uint64_t version;
 };
 
 
@@ -273,6 +334,28 @@ struct SetState
    * salt=0.
    */
   struct StrataEstimator *se;
+
+  /**
+   * Incremented whenever an element is added to or removed from
+   * the set, so that an operation can tell whether an IBF computed
+   * by another operation is still valid for it.
+   */
+  uint64_t version;
+
+  /**
+   * Head of the IBFs of the set's elements kept for reuse.
+   */
+  struct BaseIBF *base_head;
+
+  /**
+   * Tail of the IBFs of the set's elements kept for reuse.
+   */
+  struct BaseIBF *base_tail;
+
+  /**
+   * Number of entries in the @e base_head DLL.
+   */
+  unsigned int base_count;
 };
 
 
@@ -345,6 +428,9 @@ union_op_cancel (struct Operation *op)
     GNUNET_CONTAINER_multihashmap32_destroy (op->state->key_to_element);
     op->state->key_to_element = NULL;
   }
+  GNUNET_array_grow (op->state->received_keys,
+                     op->state->received_keys_size,
+                     0);
   GNUNET_free (op->state);
   op->state = NULL;
   LOG (GNUNET_ERROR_TYPE_DEBUG,
@@ -398,6 +484,29 @@ get_ibf_key (const struct GNUNET_HashCode *src)
 }
 
 
+/**
+ * Get the unsalted IBF key of an element, deriving it only
+ * the first time.
+ *
+ * @param ee the element
+ * @return the IBF key of @a ee
+ */
+static struct IBF_Key
+get_element_ibf_key (struct ElementEntry *ee)
+{
+  struct IBF_Key key;
+
+  if (GNUNET_YES != ee->have_ibf_key)
+  {
+    key = get_ibf_key (&ee->element_hash);
+    ee->ibf_key = key.key_val;
+    ee->have_ibf_key = GNUNET_YES;
+  }
+  key.key_val = ee->ibf_key;
+  return key;
+}
+
+
 /**
  * Context for #op_get_element_iterator
  */
@@ -500,7 +609,7 @@ op_register_element (struct Operation *op,
   struct IBF_Key ibf_key;
   struct KeyEntry *k;
 
-  ibf_key = get_ibf_key (&ee->element_hash);
+  ibf_key = get_element_ibf_key (ee);
   k = GNUNET_new (struct KeyEntry);
   k->element = ee;
   k->ibf_key = ibf_key;
@@ -510,6 +619,14 @@ op_register_element (struct Operation *op,
                                                       (uint32_t) ibf_key.key_val,
                                                       k,
                                                       GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+  if (GNUNET_YES == received)
+  {
+    if (op->state->received_keys_len == op->state->received_keys_size)
+      GNUNET_array_grow (op->state->received_keys,
+                         op->state->received_keys_size,
+                         op->state->received_keys_size * 2 + 16);
+    op->state->received_keys[op->state->received_keys_len++] = ibf_key;
+  }
 }
 
 
@@ -547,7 +664,7 @@ unsalt_key (const struct IBF_Key *k_in,
 
 
 /**
- * Insert a key into an ibf.
+ * Insert the key of a local element into an ibf.
  *
  * @param cls the ibf
  * @param key unused
@@ -562,6 +679,9 @@ prepare_ibf_iterator (void *cls,
   struct KeyEntry *ke = value;
   struct IBF_Key salted_key;
 
+  if (GNUNET_YES == ke->element->remote)
+    return GNUNET_YES; /* in op->state->received_keys */
+
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "[OP %p] inserting %lx (hash %s) into ibf\n",
        op,
@@ -627,10 +747,96 @@ initialize_key_to_element (struct Operation *op)
 }
 
 
+/**
+ * Destroy an IBF kept for reuse by a set.
+ *
+ * @param set_state the set
+ * @param base the IBF to destroy
+ */
+static void
+base_ibf_destroy (struct SetState *set_state,
+                  struct BaseIBF *base)
+{
+  GNUNET_CONTAINER_DLL_remove (set_state->base_head,
+                               set_state->base_tail,
+                               base);
+  set_state->base_count--;
+  ibf_destroy (base->ibf);
+  GNUNET_free (base);
+}
+
+
+/**
+ * Find or compute the IBF of the local elements of the operation's
+ * set of the specified size.  The IBF remains owned by the set.
+ *
+ * @param op the union operation
+ * @param size size of the ibf
+ * @return the IBF, NULL if we are out of memory
+ */
+static const struct InvertibleBloomFilter *
+get_base_ibf (struct Operation *op,
+              uint32_t size)
+{
+  struct SetState *set_state = op->set->state;
+  struct BaseIBF *base;
+
+  for (base = set_state->base_head; NULL != base; base = base->next)
+    if ((base->ibf->size == size) &&
+        (base->salt == op->state->salt_send) &&
+        (base->version == op->state->set_version))
+      break;
+  if (NULL != base)
+  {
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# base IBFs reused",
+                              1,
+                              GNUNET_NO);
+    GNUNET_CONTAINER_DLL_remove (set_state->base_head,
+                                 set_state->base_tail,
+                                 base);
+    GNUNET_CONTAINER_DLL_insert (set_state->base_head,
+                                 set_state->base_tail,
+                                 base);
+    return base->ibf;
+  }
+  base = GNUNET_new (struct BaseIBF);
+  base->ibf = ibf_create (size, SE_IBF_HASH_NUM);
+  if (NULL == base->ibf)
+  {
+    GNUNET_free (base);
+    return NULL;
+  }
+  base->salt = op->state->salt_send;
+  base->version = op->state->set_version;
+  op->state->local_ibf = base->ibf;
+  GNUNET_CONTAINER_multihashmap32_iterate (op->state->key_to_element,
+                                           &prepare_ibf_iterator,
+                                           op);
+  op->state->local_ibf = NULL;
+  GNUNET_STATISTICS_update (_GSS_statistics,
+                            "# base IBFs created",
+                            1,
+                            GNUNET_NO);
+  if (MAX_BASE_IBFS == set_state->base_count)
+    base_ibf_destroy (set_state,
+                      set_state->base_tail);
+  GNUNET_CONTAINER_DLL_insert (set_state->base_head,
+                               set_state->base_tail,
+                               base);
+  set_state->base_count++;
+  return base->ibf;
+}
+
+
 /**
  * Create an ibf with the operation's elements
  * of the specified size
  *
+ * The local elements come from an IBF shared with other operations
+ * on the same version of the set, only the elements received in
+ * this operation are inserted here.
+ *
  * @param op the union operation
  * @param size size of the ibf to create
  * @return #GNUNET_OK on success, #GNUNET_SYSERR on failure
@@ -639,20 +845,33 @@ static int
 prepare_ibf (struct Operation *op,
              uint32_t size)
 {
+  const struct InvertibleBloomFilter *base;
+  struct IBF_Key salted_key;
+
   GNUNET_assert (NULL != op->state->key_to_element);
 
   if (NULL != op->state->local_ibf)
+  {
     ibf_destroy (op->state->local_ibf);
-  op->state->local_ibf = ibf_create (size, SE_IBF_HASH_NUM);
+    op->state->local_ibf = NULL;
+  }
+  base = get_base_ibf (op,
+                       size);
+  if (NULL != base)
+    op->state->local_ibf = ibf_dup (base);
   if (NULL == op->state->local_ibf)
   {
     GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
                 "Failed to allocate local IBF\n");
     return GNUNET_SYSERR;
   }
-  GNUNET_CONTAINER_multihashmap32_iterate (op->state->key_to_element,
-                                           &prepare_ibf_iterator,
-                                           op);
+  for (unsigned int i = 0; i < op->state->received_keys_len; i++)
+  {
+    salt_key (&op->state->received_keys[i],
+              op->state->salt_send,
+              &salted_key);
+    ibf_insert (op->state->local_ibf, salted_key);
+  }
   return GNUNET_OK;
 }
 
@@ -2240,6 +2459,7 @@ union_evaluate (struct Operation *op,
   /* we started the operation, thus we have to send the operation request */
   state->phase = PHASE_EXPECT_SE;
   state->salt_receive = state->salt_send = 42; // FIXME?????
+  state->set_version = op->set->state->version;
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Initiating union operation evaluation\n");
   GNUNET_STATISTICS_update (_GSS_statistics,
@@ -2302,6 +2522,7 @@ union_accept (struct Operation *op)
   state->demanded_hashes = GNUNET_CONTAINER_multihashmap_create (32,
                                                                  GNUNET_NO);
   state->salt_receive = state->salt_send = 42; // FIXME?????
+  state->set_version = op->set->state->version;
   op->state = state;
   initialize_key_to_element (op);
   state->initial_size = GNUNET_CONTAINER_multihashmap32_size (
@@ -2373,7 +2594,8 @@ union_add (struct SetState *set_state,
            struct ElementEntry *ee)
 {
   strata_estimator_insert (set_state->se,
-                           get_ibf_key (&ee->element_hash));
+                           get_element_ibf_key (ee));
+  set_state->version++;
 }
 
 
@@ -2389,7 +2611,8 @@ union_remove (struct SetState *set_state,
               struct ElementEntry *ee)
 {
   strata_estimator_remove (set_state->se,
-                           get_ibf_key (&ee->element_hash));
+                           get_element_ibf_key (ee));
+  set_state->version++;
 }
 
 
@@ -2406,6 +2629,9 @@ union_set_destroy (struct SetState *set_state)
     strata_estimator_destroy (set_state->se);
     set_state->se = NULL;
   }
+  while (NULL != set_state->base_head)
+    base_ibf_destroy (set_state,
+                      set_state->base_head);
   GNUNET_free (set_state);
 }
 
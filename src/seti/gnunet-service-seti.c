@@ -36,6 +36,23 @@
  */
 #define INCOMING_CHANNEL_TIMEOUT GNUNET_TIME_UNIT_MINUTES
 
+/**
+ * Maximum size of the Bloom filter of one partition, so that
+ * it fits into a single message.
+ */
+#define MAX_BF_SIZE (60 * 1024 - sizeof(struct BFPartitionMessage))
+
+/**
+ * Maximum number of partitions of the Bloom filter of one round.
+ */
+#define MAX_BF_PARTITIONS (1 << 16)
+
+/**
+ * Maximum number of bits per element that later rounds add to
+ * the Bloom filters of the first round.
+ */
+#define MAX_BF_CASCADE_BITS 8
+
 
 /**
  * Current phase we are in for a intersection operation.
@@ -249,10 +266,16 @@ struct Operation
   struct GNUNET_CONTAINER_MultiHashMapIterator *full_result_iter;
 
   /**
-   * For multipart BF transmissions, we have to store the
-   * bloomfilter-data until we fully received it.
+   * Elements to build or test the Bloom filters of the current
+   * round with, grouped by partition, see @e bf_offsets.
+   */
+  struct ElementEntry **bf_elements;
+
+  /**
+   * Index of the first element of each partition in @e bf_elements,
+   * @e bf_partition_count + 1 entries.
    */
-  char *bf_data;
+  uint32_t *bf_offsets;
 
   /**
    * Timeout task, if the incoming peer has not been accepted
@@ -261,9 +284,21 @@ struct Operation
   struct GNUNET_SCHEDULER_Task *timeout_task;
 
   /**
-   * How many bytes of @e bf_data are valid?
+   * Number of partitions of the Bloom filter of the current round.
    */
-  uint32_t bf_data_offset;
+  uint32_t bf_partition_count;
+
+  /**
+   * Next partition of the current round to send or receive.
+   */
+  uint32_t bf_partition;
+
+  /**
+   * #GNUNET_YES while we are still sending the partitions of our
+   * Bloom filter.  The partition state then belongs to the sender,
+   * and our peer must not send us a filter before it got all of ours.
+   */
+  int bf_sending;
 
   /**
    * Current element count contained within @e my_elements.
@@ -272,14 +307,15 @@ struct Operation
   uint32_t my_element_count;
 
   /**
-   * size of the bloomfilter in @e bf_data.
+   * Number of bits per element of the Bloom filters we send
+   * in the current round.
    */
-  uint32_t bf_data_size;
+  uint32_t bf_bits_per_element;
 
   /**
-   * size of the bloomfilter
+   * Number of Bloom filter rounds we started so far.
    */
-  uint32_t bf_bits_per_element;
+  unsigned int bf_rounds;
 
   /**
    * Salt currently used for BF construction (by us or the other peer,
@@ -722,6 +758,122 @@ iterator_bf_create (void *cls,
 }
 
 
+/**
+ * Get the partition of the Bloom filter of the current round an
+ * element belongs to.
+ *
+ * @param op the intersection operation
+ * @param ee the element
+ * @return the partition
+ */
+static uint32_t
+get_bf_partition (const struct Operation *op,
+                  const struct ElementEntry *ee)
+{
+  return ntohl (ee->element_hash.bits[0]) % op->bf_partition_count;
+}
+
+
+/**
+ * Count an element for the partition it belongs to.
+ *
+ * @param cls the `struct Operation *`
+ * @param key current key code
+ * @param value the `struct ElementEntry` to process
+ * @return #GNUNET_YES (we should continue to iterate)
+ */
+static int
+iterator_bf_count (void *cls,
+                   const struct GNUNET_HashCode *key,
+                   void *value)
+{
+  struct Operation *op = cls;
+  struct ElementEntry *ee = value;
+
+  op->bf_offsets[get_bf_partition (op, ee)]++;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Store an element with the other elements of its partition.
+ *
+ * @param cls the `struct Operation *`
+ * @param key current key code
+ * @param value the `struct ElementEntry` to process
+ * @return #GNUNET_YES (we should continue to iterate)
+ */
+static int
+iterator_bf_partition (void *cls,
+                       const struct GNUNET_HashCode *key,
+                       void *value)
+{
+  struct Operation *op = cls;
+  struct ElementEntry *ee = value;
+
+  op->bf_elements[--op->bf_offsets[get_bf_partition (op, ee)]] = ee;
+  return GNUNET_YES;
+}
+
+
+/**
+ * Group elements by the partition of the Bloom filter of the
+ * current round they belong to, so that each partition can be
+ * built or tested without going over all elements.
+ *
+ * @param op the intersection operation, with @e bf_partition_count set
+ * @param elements the elements
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if we are out of memory
+ */
+static enum GNUNET_GenericReturnValue
+partition_elements (struct Operation *op,
+                    struct GNUNET_CONTAINER_MultiHashMap *elements)
+{
+  uint32_t size;
+
+  GNUNET_assert (NULL == op->bf_elements);
+  size = GNUNET_CONTAINER_multihashmap_size (elements);
+  op->bf_elements = GNUNET_malloc_large ((size + 1)
+                                         * sizeof(struct ElementEntry *));
+  if (NULL == op->bf_elements)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                "Failed to allocate partitions for %u elements\n",
+                (unsigned int) size);
+    return GNUNET_SYSERR;
+  }
+  op->bf_offsets = GNUNET_new_array (op->bf_partition_count + 1,
+                                     uint32_t);
+  GNUNET_CONTAINER_multihashmap_iterate (elements,
+                                         &iterator_bf_count,
+                                         op);
+  /* make every offset point past the end of its partition, storing
+     the elements then moves it back to the start */
+  for (uint32_t i = 1; i < op->bf_partition_count; i++)
+    op->bf_offsets[i] += op->bf_offsets[i - 1];
+  op->bf_offsets[op->bf_partition_count] = size;
+  GNUNET_CONTAINER_multihashmap_iterate (elements,
+                                         &iterator_bf_partition,
+                                         op);
+  op->bf_partition = 0;
+  return GNUNET_OK;
+}
+
+
+/**
+ * Forget the partitions of the current round.
+ *
+ * @param op the intersection operation
+ */
+static void
+release_partitions (struct Operation *op)
+{
+  GNUNET_free (op->bf_elements);
+  GNUNET_free (op->bf_offsets);
+  op->bf_partition = 0;
+}
+
+
 /**
  * Destroy the given operation.  Used for any operation where both
  * peers were known and that thus actually had a vt and channel.  Must
@@ -752,6 +904,7 @@ _GSS_operation_destroy (struct Operation *op)
     GNUNET_CONTAINER_bloomfilter_free (op->local_bf);
     op->local_bf = NULL;
   }
+  release_partitions (op);
   if (NULL != op->my_elements)
   {
     GNUNET_CONTAINER_multihashmap_destroy (op->my_elements);
@@ -934,22 +1087,96 @@ fail_intersection_operation (struct Operation *op)
 }
 
 
+/**
+ * Send the Bloom filter of the next partition of the current round
+ * to our peer.  The following partition is only built once the
+ * message is out, so that we never keep more than one partition's
+ * filter in memory.
+ *
+ * @param cls the `struct Operation *`
+ */
+static void
+send_bf_partition (void *cls)
+{
+  struct Operation *op = cls;
+  struct GNUNET_MQ_Envelope *ev;
+  struct BFPartitionMessage *msg;
+  uint32_t partition;
+  uint32_t bf_size;
+
+  partition = op->bf_partition;
+  /* optimize BF-size to ~50% of bits set */
+  bf_size = GNUNET_MIN (ceil ((double) (op->bf_offsets[partition + 1]
+                                         - op->bf_offsets[partition])
+                              * op->bf_bits_per_element / log (2)),
+                        MAX_BF_SIZE);
+  /* Partitions vary in size; a full partition just gets a higher
+     false-positive rate, an empty one still needs a filter. */
+  bf_size = GNUNET_MAX (bf_size, 1);
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Sending Bloom filter (%u) of partition %u/%u of size %u bytes\n",
+              (unsigned int) op->bf_bits_per_element,
+              (unsigned int) partition,
+              (unsigned int) op->bf_partition_count,
+              (unsigned int) bf_size);
+  op->local_bf = GNUNET_CONTAINER_bloomfilter_init (NULL,
+                                                    bf_size,
+                                                    op->bf_bits_per_element);
+  for (uint32_t i = op->bf_offsets[partition];
+       i < op->bf_offsets[partition + 1];
+       i++)
+    iterator_bf_create (op,
+                        &op->bf_elements[i]->element_hash,
+                        op->bf_elements[i]);
+  ev = GNUNET_MQ_msg_extra (msg,
+                            bf_size,
+                            GNUNET_MESSAGE_TYPE_SETI_P2P_BF_PARTITION);
+  GNUNET_assert (GNUNET_SYSERR !=
+                 GNUNET_CONTAINER_bloomfilter_get_raw_data (
+                   op->local_bf,
+                   (char *) &msg[1],
+                   bf_size));
+  GNUNET_CONTAINER_bloomfilter_free (op->local_bf);
+  op->local_bf = NULL;
+  msg->sender_element_count = htonl (op->my_element_count);
+  msg->bloomfilter_total_length = htonl (bf_size);
+  msg->bits_per_element = htonl (op->bf_bits_per_element);
+  msg->sender_mutator = htonl (op->salt);
+  msg->element_xor_hash = op->my_xor;
+  msg->partition = htonl (partition);
+  msg->partition_count = htonl (op->bf_partition_count);
+  op->bf_partition++;
+  if (op->bf_partition < op->bf_partition_count)
+  {
+    GNUNET_MQ_notify_sent (ev,
+                           &send_bf_partition,
+                           op);
+  }
+  else
+  {
+    op->bf_sending = GNUNET_NO;
+    release_partitions (op);
+  }
+  GNUNET_MQ_send (op->mq, ev);
+}
+
+
 /**
  * Send a bloomfilter to our peer.  After the result done message has
  * been sent to the client, destroy the evaluate operation.
  *
+ * The filter is split into partitions by element hash, each of which
+ * fits into one message, so that our peer can reduce its set while
+ * the rest of the filter is still being transmitted.
+ *
  * @param op intersection operation
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if we are out of memory
  */
-static void
+static enum GNUNET_GenericReturnValue
 send_bloomfilter (struct Operation *op)
 {
-  struct GNUNET_MQ_Envelope *ev;
-  struct BFMessage *msg;
-  uint32_t bf_size;
+  uint64_t bf_size;
   uint32_t bf_elementbits;
-  uint32_t chunk_size;
-  char *bf_data;
-  uint32_t offset;
 
   /* We consider the ratio of the set sizes to determine
      the number of bits per element, as the smaller set
@@ -960,79 +1187,39 @@ send_bloomfilter (struct Operation *op)
                                     / (double) op->my_element_count)));
   if (bf_elementbits < 1)
     bf_elementbits = 1; /* make sure k is not 0 */
-  /* optimize BF-size to ~50% of bits set */
-  bf_size = ceil ((double) (op->my_element_count
-                            * bf_elementbits / log (2)));
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-              "Sending Bloom filter (%u) of size %u bytes\n",
-              (unsigned int) bf_elementbits,
-              (unsigned int) bf_size);
-  op->local_bf = GNUNET_CONTAINER_bloomfilter_init (NULL,
-                                                    bf_size,
-                                                    bf_elementbits);
+  /* Each round uses more bits per element than the previous one: the
+     first filters are cheap and remove most of the difference, the
+     later ones have a lower false-positive rate on the smaller sets
+     that are left. */
+  bf_elementbits += GNUNET_MIN (op->bf_rounds,
+                                MAX_BF_CASCADE_BITS);
+  op->bf_rounds++;
+  bf_size = ceil ((double) op->my_element_count
+                  * bf_elementbits / log (2));
+  /* aim for partitions that fill about half a message */
+  op->bf_partition_count = 1 + bf_size / (MAX_BF_SIZE / 2);
+  op->bf_partition_count = GNUNET_MIN (op->bf_partition_count,
+                                       MAX_BF_PARTITIONS);
+  op->bf_bits_per_element = bf_elementbits;
   op->salt = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_NONCE,
                                        UINT32_MAX);
-  GNUNET_CONTAINER_multihashmap_iterate (op->my_elements,
-                                         &iterator_bf_create,
-                                         op);
+  if (GNUNET_OK !=
+      partition_elements (op,
+                          op->my_elements))
+    return GNUNET_SYSERR;
 
   /* send our Bloom filter */
   GNUNET_STATISTICS_update (_GSS_statistics,
                             "# Intersection Bloom filters sent",
                             1,
                             GNUNET_NO);
-  chunk_size = 60 * 1024 - sizeof(struct BFMessage);
-  if (bf_size <= chunk_size)
-  {
-    /* singlepart */
-    chunk_size = bf_size;
-    ev = GNUNET_MQ_msg_extra (msg,
-                              chunk_size,
-                              GNUNET_MESSAGE_TYPE_SETI_P2P_BF);
-    GNUNET_assert (GNUNET_SYSERR !=
-                   GNUNET_CONTAINER_bloomfilter_get_raw_data (
-                     op->local_bf,
-                     (char *) &msg[1],
-                     bf_size));
-    msg->sender_element_count = htonl (op->my_element_count);
-    msg->bloomfilter_total_length = htonl (bf_size);
-    msg->bits_per_element = htonl (bf_elementbits);
-    msg->sender_mutator = htonl (op->salt);
-    msg->element_xor_hash = op->my_xor;
-    GNUNET_MQ_send (op->mq, ev);
-  }
-  else
-  {
-    /* multipart */
-    bf_data = GNUNET_malloc (bf_size);
-    GNUNET_assert (GNUNET_SYSERR !=
-                   GNUNET_CONTAINER_bloomfilter_get_raw_data (
-                     op->local_bf,
-                     bf_data,
-                     bf_size));
-    offset = 0;
-    while (offset < bf_size)
-    {
-      if (bf_size - chunk_size < offset)
-        chunk_size = bf_size - offset;
-      ev = GNUNET_MQ_msg_extra (msg,
-                                chunk_size,
-                                GNUNET_MESSAGE_TYPE_SETI_P2P_BF);
-      GNUNET_memcpy (&msg[1],
-                     &bf_data[offset],
-                     chunk_size);
-      offset += chunk_size;
-      msg->sender_element_count = htonl (op->my_element_count);
-      msg->bloomfilter_total_length = htonl (bf_size);
-      msg->bits_per_element = htonl (bf_elementbits);
-      msg->sender_mutator = htonl (op->salt);
-      msg->element_xor_hash = op->my_xor;
-      GNUNET_MQ_send (op->mq, ev);
-    }
-    GNUNET_free (bf_data);
-  }
-  GNUNET_CONTAINER_bloomfilter_free (op->local_bf);
-  op->local_bf = NULL;
+  GNUNET_STATISTICS_update (_GSS_statistics,
+                            "# Intersection Bloom filter partitions sent",
+                            op->bf_partition_count,
+                            GNUNET_NO);
+  op->bf_sending = GNUNET_YES;
+  send_bf_partition (op);
+  return GNUNET_OK;
 }
 
 
@@ -1217,15 +1404,16 @@ send_element_count (struct Operation *op)
  * send the first Bloom filter.
  *
  * @param op operation to start exchange for
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if we are out of memory
  */
-static void
+static enum GNUNET_GenericReturnValue
 begin_bf_exchange (struct Operation *op)
 {
   op->phase = PHASE_BF_EXCHANGE;
   GNUNET_CONTAINER_multihashmap_iterate (op->set->content->elements,
                                          &initialize_map_unfiltered,
                                          op);
-  send_bloomfilter (op);
+  return send_bloomfilter (op);
 }
 
 
@@ -1250,6 +1438,7 @@ handle_intersection_p2p_element_info (void *cls,
               op->my_element_count);
   if (((PHASE_INITIAL != op->phase) &&
        (PHASE_COUNT_SENT != op->phase)) ||
+      (0 != op->bf_partition) ||
       (op->my_element_count > op->remote_element_count) ||
       (0 == op->my_element_count) ||
       (0 == op->remote_element_count))
@@ -1259,21 +1448,32 @@ handle_intersection_p2p_element_info (void *cls,
     return;
   }
   GNUNET_break (NULL == op->remote_bf);
-  begin_bf_exchange (op);
+  if (GNUNET_OK != begin_bf_exchange (op))
+  {
+    fail_intersection_operation (op);
+    return;
+  }
   GNUNET_CADET_receive_done (op->channel);
 }
 
 
 /**
- * Process a Bloomfilter once we got all the chunks.
+ * Process the Bloom filter of the next partition of the current
+ * round, and once we got all partitions, continue with the next
+ * round or finish.
  *
  * @param op the intersection operation
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if the operation failed
  */
-static void
+static enum GNUNET_GenericReturnValue
 process_bf (struct Operation *op)
 {
+  uint32_t partition = op->bf_partition;
+
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-              "Received BF in phase %u, foreign count is %u, my element count is %u/%u\n",
+              "Received BF partition %u/%u in phase %u, foreign count is %u, my element count is %u/%u\n",
+              (unsigned int) partition,
+              (unsigned int) op->bf_partition_count,
               op->phase,
               op->remote_element_count,
               op->my_element_count,
@@ -1283,36 +1483,45 @@ process_bf (struct Operation *op)
   case PHASE_INITIAL:
     GNUNET_break_op (0);
     fail_intersection_operation (op);
-    return;
+    return GNUNET_SYSERR;
   case PHASE_COUNT_SENT:
     /* This is the first BF being sent, build our initial map with
        filtering in place */
-    op->my_element_count = 0;
-    GNUNET_CONTAINER_multihashmap_iterate (op->set->content->elements,
-                                           &filtered_map_initialization,
-                                           op);
+    for (uint32_t i = op->bf_offsets[partition];
+         i < op->bf_offsets[partition + 1];
+         i++)
+      filtered_map_initialization (op,
+                                   &op->bf_elements[i]->element_hash,
+                                   op->bf_elements[i]);
     break;
   case PHASE_BF_EXCHANGE:
     /* Update our set by reduction */
-    GNUNET_CONTAINER_multihashmap_iterate (op->my_elements,
-                                           &iterator_bf_reduce,
-                                           op);
+    for (uint32_t i = op->bf_offsets[partition];
+         i < op->bf_offsets[partition + 1];
+         i++)
+      iterator_bf_reduce (op,
+                          &op->bf_elements[i]->element_hash,
+                          op->bf_elements[i]);
     break;
   case PHASE_MUST_SEND_DONE:
     GNUNET_break_op (0);
     fail_intersection_operation (op);
-    return;
+    return GNUNET_SYSERR;
   case PHASE_DONE_RECEIVED:
     GNUNET_break_op (0);
     fail_intersection_operation (op);
-    return;
+    return GNUNET_SYSERR;
   case PHASE_FINISHED:
     GNUNET_break_op (0);
     fail_intersection_operation (op);
-    return;
+    return GNUNET_SYSERR;
   }
   GNUNET_CONTAINER_bloomfilter_free (op->remote_bf);
   op->remote_bf = NULL;
+  op->bf_partition++;
+  if (op->bf_partition < op->bf_partition_count)
+    return GNUNET_OK; /* wait for the other partitions */
+  release_partitions (op);
 
   if ((0 == op->my_element_count) ||  /* fully disjoint */
       ((op->my_element_count == op->remote_element_count) &&
@@ -1334,13 +1543,18 @@ process_bf (struct Operation *op)
         = GNUNET_CONTAINER_multihashmap_iterator_create (
             op->my_elements);
       send_remaining_elements (op);
-      return;
+      return GNUNET_OK;
     }
     send_p2p_done (op);
-    return;
+    return GNUNET_OK;
   }
   op->phase = PHASE_BF_EXCHANGE;
-  send_bloomfilter (op);
+  if (GNUNET_OK != send_bloomfilter (op))
+  {
+    fail_intersection_operation (op);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
 }
 
 
@@ -1353,7 +1567,7 @@ process_bf (struct Operation *op)
  */
 static int
 check_intersection_p2p_bf (void *cls,
-                           const struct BFMessage *msg)
+                           const struct BFPartitionMessage *msg)
 {
   struct Operation *op = cls;
 
@@ -1370,12 +1584,15 @@ check_intersection_p2p_bf (void *cls,
  */
 static void
 handle_intersection_p2p_bf (void *cls,
-                            const struct BFMessage *msg)
+                            const struct BFPartitionMessage *msg)
 {
   struct Operation *op = cls;
   uint32_t bf_size;
   uint32_t chunk_size;
   uint32_t bf_bits_per_element;
+  uint32_t partition;
+  uint32_t partition_count;
+  enum GNUNET_GenericReturnValue res;
 
   switch (op->phase)
   {
@@ -1386,69 +1603,74 @@ handle_intersection_p2p_bf (void *cls,
 
   case PHASE_COUNT_SENT:
   case PHASE_BF_EXCHANGE:
+    if (GNUNET_YES == op->bf_sending)
+    {
+      /* our peer cannot have seen all of our filter yet */
+      GNUNET_break_op (0);
+      fail_intersection_operation (op);
+      return;
+    }
     bf_size = ntohl (msg->bloomfilter_total_length);
     bf_bits_per_element = ntohl (msg->bits_per_element);
-    chunk_size = htons (msg->header.size) - sizeof(struct BFMessage);
-    op->other_xor = msg->element_xor_hash;
-    if (bf_size == chunk_size)
+    chunk_size = htons (msg->header.size) - sizeof(struct BFPartitionMessage);
+    partition = ntohl (msg->partition);
+    partition_count = ntohl (msg->partition_count);
+    if ((bf_size != chunk_size) ||
+        (partition != op->bf_partition) ||
+        (0 == partition_count) ||
+        (partition_count > MAX_BF_PARTITIONS))
     {
-      if (NULL != op->bf_data)
-      {
-        GNUNET_break_op (0);
-        fail_intersection_operation (op);
-        return;
-      }
-      /* single part, done here immediately */
-      op->remote_bf
-        = GNUNET_CONTAINER_bloomfilter_init ((const char *) &msg[1],
-                                             bf_size,
-                                             bf_bits_per_element);
-      op->salt = ntohl (msg->sender_mutator);
-      op->remote_element_count = ntohl (msg->sender_element_count);
-      process_bf (op);
-      break;
+      GNUNET_break_op (0);
+      fail_intersection_operation (op);
+      return;
     }
-    /* multipart chunk */
-    if (NULL == op->bf_data)
+    if (0 == partition)
     {
-      /* first chunk, initialize */
-      op->bf_data = GNUNET_malloc (bf_size);
-      op->bf_data_size = bf_size;
-      op->bf_bits_per_element = bf_bits_per_element;
-      op->bf_data_offset = 0;
+      /* first partition of a new round */
+      op->other_xor = msg->element_xor_hash;
       op->salt = ntohl (msg->sender_mutator);
       op->remote_element_count = ntohl (msg->sender_element_count);
-    }
-    else
-    {
-      /* increment */
-      if ((op->bf_data_size != bf_size) ||
-          (op->bf_bits_per_element != bf_bits_per_element) ||
-          (op->bf_data_offset + chunk_size > bf_size) ||
-          (op->salt != ntohl (msg->sender_mutator)) ||
-          (op->remote_element_count != ntohl (msg->sender_element_count)))
+      op->bf_partition_count = partition_count;
+      if (PHASE_COUNT_SENT == op->phase)
+      {
+        op->my_element_count = 0;
+        res = partition_elements (op,
+                                  op->set->content->elements);
+      }
+      else
+      {
+        res = partition_elements (op,
+                                  op->my_elements);
+      }
+      if (GNUNET_OK != res)
       {
-        GNUNET_break_op (0);
         fail_intersection_operation (op);
         return;
       }
     }
-    GNUNET_memcpy (&op->bf_data[op->bf_data_offset],
-                   (const char *) &msg[1],
-                   chunk_size);
-    op->bf_data_offset += chunk_size;
-    if (op->bf_data_offset == bf_size)
+    else if ((op->bf_partition_count != partition_count) ||
+             (op->salt != ntohl (msg->sender_mutator)) ||
+             (op->remote_element_count != ntohl (msg->sender_element_count))
+             ||
+             (0 != GNUNET_memcmp (&op->other_xor,
+                                  &msg->element_xor_hash)))
+    {
+      GNUNET_break_op (0);
+      fail_intersection_operation (op);
+      return;
+    }
+    op->remote_bf
+      = GNUNET_CONTAINER_bloomfilter_init ((const char *) &msg[1],
+                                           bf_size,
+                                           bf_bits_per_element);
+    if (NULL == op->remote_bf)
     {
-      /* last chunk, run! */
-      op->remote_bf
-        = GNUNET_CONTAINER_bloomfilter_init (op->bf_data,
-                                             bf_size,
-                                             bf_bits_per_element);
-      GNUNET_free (op->bf_data);
-      op->bf_data = NULL;
-      op->bf_data_size = 0;
-      process_bf (op);
+      GNUNET_break_op (0);
+      fail_intersection_operation (op);
+      return;
     }
+    if (GNUNET_OK != process_bf (op))
+      return;
     break;
 
   default:
@@ -1963,8 +2185,8 @@ handle_client_listen (void *cls,
                              struct IntersectionElementInfoMessage,
                              NULL),
     GNUNET_MQ_hd_var_size (intersection_p2p_bf,
-                           GNUNET_MESSAGE_TYPE_SETI_P2P_BF,
-                           struct BFMessage,
+                           GNUNET_MESSAGE_TYPE_SETI_P2P_BF_PARTITION,
+                           struct BFPartitionMessage,
                            NULL),
     GNUNET_MQ_hd_fixed_size (intersection_p2p_done,
                              GNUNET_MESSAGE_TYPE_SETI_P2P_DONE,
@@ -2177,8 +2399,8 @@ handle_client_evaluate (void *cls,
                              struct IntersectionElementInfoMessage,
                              op),
     GNUNET_MQ_hd_var_size (intersection_p2p_bf,
-                           GNUNET_MESSAGE_TYPE_SETI_P2P_BF,
-                           struct BFMessage,
+                           GNUNET_MESSAGE_TYPE_SETI_P2P_BF_PARTITION,
+                           struct BFPartitionMessage,
                            op),
     GNUNET_MQ_hd_fixed_size (intersection_p2p_done,
                              GNUNET_MESSAGE_TYPE_SETI_P2P_DONE,
@@ -2404,7 +2626,12 @@ handle_client_accept (void *cls,
     else
     {
       /* We have fewer elements, so we start with the BF */
-      begin_bf_exchange (op);
+      if (GNUNET_OK != begin_bf_exchange (op))
+      {
+        fail_intersection_operation (op);
+        GNUNET_SERVICE_client_continue (cs->client);
+        return;
+      }
     }
   }
   /* Now allow CADET to continue, as we did not do this in
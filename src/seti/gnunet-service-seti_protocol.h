@@ -74,11 +74,16 @@ struct IntersectionElementInfoMessage
 
 /**
  * Bloom filter messages exchanged for set intersection calculation.
+ *
+ * The Bloom filter of one round is split into partitions by element
+ * hash, and every message carries the complete filter of one
+ * partition, so that the receiver can process it right away.  The
+ * partitions of a round are sent in order.
  */
-struct BFMessage
+struct BFPartitionMessage
 {
   /**
-   * Type: #GNUNET_MESSAGE_TYPE_SET_INTERSECTION_P2P_BF
+   * Type: #GNUNET_MESSAGE_TYPE_SETI_P2P_BF_PARTITION
    */
   struct GNUNET_MessageHeader header;
 
@@ -99,7 +104,7 @@ struct BFMessage
   uint32_t sender_mutator GNUNET_PACKED;
 
   /**
-   * Total length of the bloomfilter data.
+   * Length of the bloomfilter data of this partition.
    */
   uint32_t bloomfilter_total_length GNUNET_PACKED;
 
@@ -108,6 +113,16 @@ struct BFMessage
    */
   uint32_t bits_per_element GNUNET_PACKED;
 
+  /**
+   * Partition of the elements this bloomfilter is for.
+   */
+  uint32_t partition GNUNET_PACKED;
+
+  /**
+   * Number of partitions of the bloomfilter of this round.
+   */
+  uint32_t partition_count GNUNET_PACKED;
+
   /**
    * rest: the sender's bloomfilter
    */
@@ -36,6 +36,35 @@ static unsigned int num_a = 5;
 static unsigned int num_b = 5;
 static unsigned int num_c = 20;
 
+/**
+ * Name of a predefined scenario that sets the set sizes,
+ * NULL to use the sizes given on the command line.
+ */
+static char *scenario_name;
+
+/**
+ * Set sizes of a predefined scenario.
+ */
+struct Scenario
+{
+  const char *name;
+  unsigned int num_a;
+  unsigned int num_b;
+  unsigned int num_c;
+};
+
+/**
+ * Predefined scenarios, the large ones exercise Bloom filters
+ * that span many messages.
+ */
+static const struct Scenario scenarios[] = {
+  { "small", 5, 5, 20 },
+  { "large-overlap", 10000, 10000, 1000000 },
+  { "large-disjoint", 1000000, 1000000, 10000 },
+  { "huge-overlap", 100000, 100000, 10000000 },
+  { NULL, 0, 0, 0 }
+};
+
 const static struct GNUNET_CONFIGURATION_Handle *config;
 
 struct SetInfo
@@ -45,9 +74,16 @@ struct SetInfo
   struct GNUNET_SETI_OperationHandle *oh;
   struct GNUNET_CONTAINER_MultiHashMap *sent;
   struct GNUNET_CONTAINER_MultiHashMap *received;
+  struct GNUNET_TIME_Absolute first_result;
+  struct GNUNET_TIME_Absolute done_time;
   int done;
 } info1, info2;
 
+/**
+ * When did we start the operation?
+ */
+static struct GNUNET_TIME_Absolute start_time;
+
 static struct GNUNET_CONTAINER_MultiHashMap *common_sent;
 
 static struct GNUNET_HashCode app_id;
@@ -132,6 +168,25 @@ statistics_done (void *cls,
 }
 
 
+static void
+print_timing (const struct SetInfo *info)
+{
+  if (0 != info->first_result.abs_value_us)
+    printf ("set %s: first result after %s\n",
+            info->id,
+            GNUNET_STRINGS_relative_time_to_string (
+              GNUNET_TIME_absolute_get_difference (start_time,
+                                                   info->first_result),
+              GNUNET_YES));
+  printf ("set %s: done after %s\n",
+          info->id,
+          GNUNET_STRINGS_relative_time_to_string (
+            GNUNET_TIME_absolute_get_difference (start_time,
+                                                 info->done_time),
+            GNUNET_YES));
+}
+
+
 static void
 check_all_done (void)
 {
@@ -147,6 +202,8 @@ check_all_done (void)
             info1.sent));
   printf ("set b: %d missing elements\n", GNUNET_CONTAINER_multihashmap_size (
             info2.sent));
+  print_timing (&info1);
+  print_timing (&info2);
 
   if (NULL == statistics_filename)
   {
@@ -171,10 +228,14 @@ set_result_cb (void *cls,
   struct GNUNET_HashCode hash;
 
   GNUNET_assert (GNUNET_NO == info->done);
+  if ((GNUNET_SETI_STATUS_DONE != status) &&
+      (0 == info->first_result.abs_value_us))
+    info->first_result = GNUNET_TIME_absolute_get ();
   switch (status)
   {
   case GNUNET_SETI_STATUS_DONE:
     info->done = GNUNET_YES;
+    info->done_time = GNUNET_TIME_absolute_get ();
     GNUNET_log (GNUNET_ERROR_TYPE_INFO,
                 "set intersection done\n");
     check_all_done ();
@@ -405,6 +466,7 @@ run (void *cls,
   }
   opts[n_opts].type = GNUNET_SETI_OPTION_END;
 
+  start_time = GNUNET_TIME_absolute_get ();
   info1.oh = GNUNET_SETI_prepare (&local_peer,
                                   &app_id,
                                   NULL,
@@ -424,6 +486,32 @@ pre_run (void *cls,
          const char *cfgfile,
          const struct GNUNET_CONFIGURATION_Handle *cfg)
 {
+  if (NULL != scenario_name)
+  {
+    const struct Scenario *sc;
+
+    for (sc = scenarios; NULL != sc->name; sc++)
+      if (0 == strcmp (sc->name, scenario_name))
+        break;
+    if (NULL == sc->name)
+    {
+      fprintf (stderr,
+               "Unknown scenario `%s', known scenarios are:\n",
+               scenario_name);
+      for (sc = scenarios; NULL != sc->name; sc++)
+        fprintf (stderr,
+                 "  %s (A=%u, B=%u, C=%u)\n",
+                 sc->name,
+                 sc->num_a,
+                 sc->num_b,
+                 sc->num_c);
+      ret = 1;
+      return;
+    }
+    num_a = sc->num_a;
+    num_b = sc->num_b;
+    num_c = sc->num_c;
+  }
   if (0 != GNUNET_TESTING_peer_run ("set-profiler",
                                     cfgfile,
                                     &run, NULL))
@@ -450,6 +538,12 @@ main (int argc, char **argv)
                                NULL,
                                gettext_noop ("number of values"),
                                &num_c),
+    GNUNET_GETOPT_option_string ('S',
+                                 "scenario",
+                                 "NAME",
+                                 gettext_noop (
+                                   "use the set sizes of a predefined scenario (small, large-overlap, large-disjoint, huge-overlap)"),
+                                 &scenario_name),
     GNUNET_GETOPT_option_uint ('i',
                                "use-intersection",
                                NULL,
@@ -32,6 +32,7 @@
 #include "gnunet_applications.h"
 #include "gnunet_cadet_service.h"
 #include "gnunet-service-setu_strata_estimator.h"
+#include "gnunet-service-setu_rateless.h"
 #include "gnunet-service-setu_protocol.h"
 #include "gnunet_statistics_service.h"
 #include <gcrypt.h>
@@ -82,6 +83,45 @@
  */
 #define IBF_MIN_SIZE 37
 
+/**
+ * How many base IBFs (IBFs of the local set for a given size and
+ * salt) do we keep per set for reuse by later operations?
+ */
+#define BASE_IBF_CACHE_SIZE 8
+
+/**
+ * How much memory may the base IBFs of a set use at most?  Enough
+ * for two IBFs of #MAX_IBF_SIZE.
+ */
+#define BASE_IBF_CACHE_BYTES (2 * MAX_IBF_SIZE * sizeof(struct IBF_Bucket))
+
+/**
+ * Minimal number of symbols in a message of a rateless IBF.  Later
+ * messages carry a quarter of the symbols sent so far, so that the
+ * number of round trips only grows logarithmically with the
+ * difference.
+ */
+#define RATELESS_MIN_BATCH 64
+
+/**
+ * Number of messages with rateless IBF symbols that we keep in flight
+ * while waiting for acknowledgements.
+ */
+#define RATELESS_WINDOW 2
+
+/**
+ * Number of rateless IBF symbols that fit into one message.
+ */
+#define RATELESS_MAX_SYMBOLS_PER_MESSAGE \
+  ((GNUNET_MAX_MESSAGE_SIZE - 1 - sizeof(struct RatelessSymbolsMessage)) \
+   / RATELESS_SYMBOL_SIZE)
+
+/**
+ * Maximum number of rateless IBF symbols we send for one operation,
+ * enough for about as large a difference as an IBF of #MAX_IBF_SIZE.
+ */
+#define MAX_RATELESS_SYMBOLS MAX_IBF_SIZE
+
 /**
  * AVG RTT for differential sync when k=2 and Factor = 2
  * Based on the bsc thesis of Elias Summermatter (2021)
@@ -172,7 +212,13 @@ enum UnionOperationPhase
    * Phase that receives full set first and then sends elements that are
    * the local peer missing
    */
-  PHASE_FULL_RECEIVING
+  PHASE_FULL_RECEIVING,
+
+  /**
+   * We receive the symbols of a rateless IBF and decode them while
+   * they arrive.
+   */
+  PHASE_RATELESS_DECODING
 };
 
 /**
@@ -218,6 +264,12 @@ struct ElementEntry
    */
   struct GNUNET_HashCode element_hash;
 
+  /**
+   * IBF key derived from @e element_hash with salt 0.  Computed once
+   * when the element enters the set or the operation.
+   */
+  struct IBF_Key ibf_key;
+
   /**
    * First generation that includes this element.
    */
@@ -347,6 +399,28 @@ struct Operation
    */
   struct GNUNET_CONTAINER_MultiHashMap32 *key_to_element;
 
+  /**
+   * IBF keys of the elements we received from the other peer, to be
+   * added to the base IBF of the set when we build @e local_ibf.
+   */
+  struct IBF_Key *remote_keys;
+
+  /**
+   * Number of entries used in @e remote_keys.
+   */
+  unsigned int remote_keys_len;
+
+  /**
+   * Allocated length of @e remote_keys.
+   */
+  unsigned int remote_keys_size;
+
+  /**
+   * Number of entries of the set's `element_keys` that belong
+   * to the generation of this operation.
+   */
+  unsigned int set_keys_len;
+
   /**
    * Timeout task, if the incoming peer has not been accepted
    * after the timeout, it will be disconnected.
@@ -433,6 +507,29 @@ struct Operation
    */
   int symmetric;
 
+  /**
+   * #GNUNET_YES to reconcile with a rateless IBF instead of a strata
+   * estimator and IBFs.
+   */
+  int rateless;
+
+  /**
+   * Produces the rateless IBF symbols we send, NULL once the other
+   * peer decoded the difference.
+   */
+  struct RatelessEncoder *rateless_encoder;
+
+  /**
+   * Decodes the rateless IBF symbols we receive, NULL once we decoded
+   * the difference.
+   */
+  struct RatelessDecoder *rateless_decoder;
+
+  /**
+   * Number of rateless IBF symbols we received.
+   */
+  uint32_t rateless_symbols;
+
   /**
    * Lower bound for the set size, used only when
    * byzantine mode is enabled.
@@ -553,6 +650,23 @@ struct SetContent
    */
   uint64_t elements_randomized_salt;
 
+  /**
+   * IBF keys of all elements in the order in which they were added.
+   * As generations only grow, the elements of any generation are a
+   * prefix of this array.
+   */
+  struct IBF_Key *element_keys;
+
+  /**
+   * Number of entries used in @e element_keys.
+   */
+  unsigned int element_keys_len;
+
+  /**
+   * Allocated length of @e element_keys.
+   */
+  unsigned int element_keys_size;
+
   /**
    * Number of references to the content.
    */
@@ -570,6 +684,40 @@ struct SetContent
 };
 
 
+/**
+ * IBF of a prefix of the set's elements for one combination of
+ * size, salt and number of hash functions.  Kept on the set so that
+ * operations do not have to insert every element of the set again.
+ */
+struct BaseIBF
+{
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct BaseIBF *next;
+
+  /**
+   * Kept in a DLL, most recently used first.
+   */
+  struct BaseIBF *prev;
+
+  /**
+   * The IBF, with salted keys.
+   */
+  struct InvertibleBloomFilter *ibf;
+
+  /**
+   * Salt applied to the keys in @e ibf.
+   */
+  uint32_t salt;
+
+  /**
+   * Number of entries of the set's `element_keys` in @e ibf.
+   */
+  unsigned int num_keys;
+};
+
+
 /**
  * A set that supports a specific operation with other peers.
  */
@@ -603,6 +751,26 @@ struct Set
    */
   struct MultiStrataEstimator *se;
 
+  /**
+   * Base IBFs of this set, most recently used first.
+   */
+  struct BaseIBF *base_ibf_head;
+
+  /**
+   * Base IBFs of this set, most recently used first.
+   */
+  struct BaseIBF *base_ibf_tail;
+
+  /**
+   * Number of entries in the @e base_ibf_head DLL.
+   */
+  unsigned int base_ibf_count;
+
+  /**
+   * Memory used by the buckets of the IBFs in the @e base_ibf_head DLL.
+   */
+  size_t base_ibf_bytes;
+
   /**
    * Evaluate operations are held in a linked list.
    */
@@ -1597,6 +1765,16 @@ _GSS_operation_destroy (struct Operation *op)
     strata_estimator_destroy (op->se);
     op->se = NULL;
   }
+  if (NULL != op->rateless_encoder)
+  {
+    rateless_encoder_destroy (op->rateless_encoder);
+    op->rateless_encoder = NULL;
+  }
+  if (NULL != op->rateless_decoder)
+  {
+    rateless_decoder_destroy (op->rateless_decoder);
+    op->rateless_decoder = NULL;
+  }
   if (NULL != op->key_to_element)
   {
     GNUNET_CONTAINER_multihashmap32_iterate (op->key_to_element,
@@ -1605,6 +1783,9 @@ _GSS_operation_destroy (struct Operation *op)
     GNUNET_CONTAINER_multihashmap32_destroy (op->key_to_element);
     op->key_to_element = NULL;
   }
+  GNUNET_free (op->remote_keys);
+  op->remote_keys_len = 0;
+  op->remote_keys_size = 0;
   if (NULL != set)
   {
     GNUNET_CONTAINER_DLL_remove (set->ops_head,
@@ -1917,6 +2098,32 @@ op_get_element (struct Operation *op,
 }
 
 
+/**
+ * Append @a key to an array of IBF keys, growing it as needed.
+ *
+ * @param[in,out] keys the array
+ * @param[in,out] len number of keys in @a keys
+ * @param[in,out] size allocated length of @a keys
+ * @param key key to append
+ */
+static void
+append_key (struct IBF_Key **keys,
+            unsigned int *len,
+            unsigned int *size,
+            struct IBF_Key key)
+{
+  if (*len == *size)
+  {
+    GNUNET_assert (*size < UINT_MAX / 2 / sizeof(struct IBF_Key));
+    *size = GNUNET_MAX (16, *size * 2);
+    /* not GNUNET_array_grow(), large sets exceed its allocation limit */
+    *keys = GNUNET_realloc (*keys,
+                            *size * sizeof(struct IBF_Key));
+  }
+  (*keys)[(*len)++] = key;
+}
+
+
 /**
  * Insert an element into the union operation's
  * key-to-element mapping. Takes ownership of 'ee'.
@@ -1936,19 +2143,23 @@ op_register_element (struct Operation *op,
                      struct ElementEntry *ee,
                      int received)
 {
-  struct IBF_Key ibf_key;
   struct KeyEntry *k;
 
-  ibf_key = get_ibf_key (&ee->element_hash);
   k = GNUNET_new (struct KeyEntry);
   k->element = ee;
-  k->ibf_key = ibf_key;
+  k->ibf_key = ee->ibf_key;
   k->received = received;
   GNUNET_assert (GNUNET_OK ==
                  GNUNET_CONTAINER_multihashmap32_put (op->key_to_element,
-                                                      (uint32_t) ibf_key.key_val,
+                                                      (uint32_t) ee->ibf_key.
+                                                      key_val,
                                                       k,
                                                       GNUNET_CONTAINER_MULTIHASHMAPOPTION_MULTIPLE));
+  if (GNUNET_YES == ee->remote)
+    append_key (&op->remote_keys,
+                &op->remote_keys_len,
+                &op->remote_keys_size,
+                ee->ibf_key);
 }
 
 
@@ -1987,31 +2198,150 @@ unsalt_key (const struct IBF_Key *k_in,
 
 
 /**
- * Insert a key into an ibf.
+ * Insert salted keys into an ibf, or remove them from it.
  *
- * @param cls the ibf
- * @param key unused
- * @param value the key entry to get the key from
+ * @param ibf the ibf to change
+ * @param keys the unsalted keys
+ * @param num_keys number of keys in @a keys
+ * @param salt salt to apply to the keys
+ * @param insert #GNUNET_YES to insert the keys, #GNUNET_NO to remove them
  */
-static int
-prepare_ibf_iterator (void *cls,
-                      uint32_t key,
-                      void *value)
+static void
+ibf_update_keys (struct InvertibleBloomFilter *ibf,
+                 const struct IBF_Key *keys,
+                 unsigned int num_keys,
+                 uint32_t salt,
+                 int insert)
 {
-  struct Operation *op = cls;
-  struct KeyEntry *ke = value;
   struct IBF_Key salted_key;
 
-  LOG (GNUNET_ERROR_TYPE_DEBUG,
-       "[OP %p] inserting %lx (hash %s) into ibf\n",
-       op,
-       (unsigned long) ke->ibf_key.key_val,
-       GNUNET_h2s (&ke->element->element_hash));
-  salt_key (&ke->ibf_key,
-            op->salt_send,
-            &salted_key);
-  ibf_insert (op->local_ibf, salted_key);
-  return GNUNET_YES;
+  for (unsigned int i = 0; i < num_keys; i++)
+  {
+    salt_key (&keys[i],
+              salt,
+              &salted_key);
+    if (GNUNET_YES == insert)
+      ibf_insert (ibf, salted_key);
+    else
+      ibf_remove (ibf, salted_key);
+  }
+}
+
+
+/**
+ * Free a base IBF of a set.
+ *
+ * @param set the set
+ * @param base the base IBF to remove from @a set and free
+ */
+static void
+base_ibf_destroy (struct Set *set,
+                  struct BaseIBF *base)
+{
+  GNUNET_CONTAINER_DLL_remove (set->base_ibf_head,
+                               set->base_ibf_tail,
+                               base);
+  set->base_ibf_count--;
+  set->base_ibf_bytes -= base->ibf->size * sizeof(struct IBF_Bucket);
+  ibf_destroy (base->ibf);
+  GNUNET_free (base);
+}
+
+
+/**
+ * Get the base IBF of the set of @a op for the given parameters,
+ * creating it or bringing it up to the generation of @a op.  The
+ * result may contain more keys than @a op has in its generation.
+ *
+ * @param op the union operation
+ * @param size size of the ibf
+ * @param hash_num number of buckets per element
+ * @return NULL if we failed to allocate the ibf
+ */
+static struct BaseIBF *
+get_base_ibf (struct Operation *op,
+              uint32_t size,
+              uint8_t hash_num)
+{
+  struct Set *set = op->set;
+  const struct IBF_Key *keys = set->content->element_keys;
+  struct BaseIBF *base;
+
+  for (base = set->base_ibf_head; NULL != base; base = base->next)
+    if ((base->ibf->size == size) &&
+        (base->ibf->hash_num == hash_num) &&
+        (base->salt == op->salt_send))
+      break;
+  if (NULL == base)
+  {
+    struct InvertibleBloomFilter *ibf;
+
+    ibf = ibf_create (size,
+                      hash_num);
+    if (NULL == ibf)
+      return NULL;
+    while ((NULL != set->base_ibf_tail) &&
+           ((BASE_IBF_CACHE_SIZE == set->base_ibf_count) ||
+            (set->base_ibf_bytes + size * sizeof(struct IBF_Bucket) >
+             BASE_IBF_CACHE_BYTES)))
+      base_ibf_destroy (set,
+                        set->base_ibf_tail);
+    base = GNUNET_new (struct BaseIBF);
+    base->ibf = ibf;
+    base->salt = op->salt_send;
+    GNUNET_CONTAINER_DLL_insert (set->base_ibf_head,
+                                 set->base_ibf_tail,
+                                 base);
+    set->base_ibf_count++;
+    set->base_ibf_bytes += size * sizeof(struct IBF_Bucket);
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# base IBFs created",
+                              1,
+                              GNUNET_NO);
+  }
+  else
+  {
+    GNUNET_CONTAINER_DLL_remove (set->base_ibf_head,
+                                 set->base_ibf_tail,
+                                 base);
+    GNUNET_CONTAINER_DLL_insert (set->base_ibf_head,
+                                 set->base_ibf_tail,
+                                 base);
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# base IBFs reused",
+                              1,
+                              GNUNET_NO);
+  }
+  if (base->num_keys < op->set_keys_len)
+  {
+    ibf_update_keys (base->ibf,
+                     &keys[base->num_keys],
+                     op->set_keys_len - base->num_keys,
+                     base->salt,
+                     GNUNET_YES);
+    base->num_keys = op->set_keys_len;
+  }
+  return base;
+}
+
+
+/**
+ * Round an IBF size up to the next size of a fixed geometric
+ * series (about 12% apart), so that operations with similar set
+ * differences use the same IBF sizes and can share base IBFs.
+ *
+ * @param size the size the operation needs
+ * @return the size to use, at least @a size and odd
+ */
+static uint32_t
+round_ibf_size (uint32_t size)
+{
+  uint32_t rounded = IBF_MIN_SIZE;
+
+  while ((rounded < size) &&
+         (rounded < UINT32_MAX / 2))
+    rounded = (rounded + rounded / 8) | 1;
+  return GNUNET_MAX (rounded, size | 1);
 }
 
 
@@ -2026,7 +2356,7 @@ static int
 _GSS_is_element_of_operation (struct ElementEntry *ee,
                               struct Operation *op)
 {
-  return ee->generation >= op->generation_created;
+  return ee->generation <= op->generation_created;
 }
 
 
@@ -2073,6 +2403,7 @@ initialize_key_to_element (struct Operation *op)
   unsigned int len;
 
   GNUNET_assert (NULL == op->key_to_element);
+  op->set_keys_len = op->set->content->element_keys_len;
   len = GNUNET_CONTAINER_multihashmap_size (op->set->content->elements);
   op->key_to_element = GNUNET_CONTAINER_multihashmap32_create (len + 1);
   GNUNET_CONTAINER_multihashmap_iterate (op->set->content->elements,
@@ -2093,22 +2424,38 @@ static int
 prepare_ibf (struct Operation *op,
              uint32_t size)
 {
+  struct BaseIBF *base;
+
   GNUNET_assert (NULL != op->key_to_element);
 
   if (NULL != op->local_ibf)
+  {
     ibf_destroy (op->local_ibf);
-  // op->local_ibf = ibf_create (size, SE_IBF_HASH_NUM);
-  op->local_ibf = ibf_create (size,
-                              ((uint8_t) op->ibf_number_buckets_per_element));
+    op->local_ibf = NULL;
+  }
+  base = get_base_ibf (op,
+                       size,
+                       (uint8_t) op->ibf_number_buckets_per_element);
+  if (NULL != base)
+    op->local_ibf = ibf_dup (base->ibf);
   if (NULL == op->local_ibf)
   {
     GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
                 "Failed to allocate local IBF\n");
     return GNUNET_SYSERR;
   }
-  GNUNET_CONTAINER_multihashmap32_iterate (op->key_to_element,
-                                           &prepare_ibf_iterator,
-                                           op);
+  /* later operations may already have added their elements */
+  if (base->num_keys > op->set_keys_len)
+    ibf_update_keys (op->local_ibf,
+                     &op->set->content->element_keys[op->set_keys_len],
+                     base->num_keys - op->set_keys_len,
+                     op->salt_send,
+                     GNUNET_NO);
+  ibf_update_keys (op->local_ibf,
+                   op->remote_keys,
+                   op->remote_keys_len,
+                   op->salt_send,
+                   GNUNET_YES);
   return GNUNET_OK;
 }
 
@@ -2139,6 +2486,10 @@ send_ibf (struct Operation *op,
   {
     ibf_size = ibf_min_size;
   }
+  ibf_size = round_ibf_size (ibf_size);
+  /* rounding may take us beyond what the other peer accepts */
+  if (ibf_size > MAX_IBF_SIZE)
+    ibf_size = MAX_IBF_SIZE;
   if (GNUNET_OK !=
       prepare_ibf (op, ibf_size))
   {
@@ -2204,6 +2555,116 @@ send_ibf (struct Operation *op,
 }
 
 
+/**
+ * Create a rateless IBF encoder for the elements of an operation.
+ *
+ * @param op the union operation
+ * @param salt salt to apply to the keys
+ * @return NULL if we failed to allocate the encoder
+ */
+static struct RatelessEncoder *
+create_rateless_encoder (struct Operation *op,
+                         uint32_t salt)
+{
+  const struct IBF_Key *keys = op->set->content->element_keys;
+  struct RatelessEncoder *enc;
+  struct IBF_Key salted_key;
+
+  enc = rateless_encoder_create (op->set_keys_len + op->remote_keys_len);
+  if (NULL == enc)
+    return NULL;
+  for (unsigned int i = 0; i < op->set_keys_len; i++)
+  {
+    salt_key (&keys[i],
+              salt,
+              &salted_key);
+    rateless_encoder_add (enc,
+                          salted_key);
+  }
+  for (unsigned int i = 0; i < op->remote_keys_len; i++)
+  {
+    salt_key (&op->remote_keys[i],
+              salt,
+              &salted_key);
+    rateless_encoder_add (enc,
+                          salted_key);
+  }
+  return enc;
+}
+
+
+/**
+ * Send the next message with rateless IBF symbols.
+ *
+ * @param op the union operation
+ */
+static void
+send_rateless_symbols (struct Operation *op)
+{
+  struct GNUNET_MQ_Envelope *ev;
+  struct RatelessSymbolsMessage *msg;
+  struct IBF_Bucket *symbols;
+  uint32_t offset;
+  unsigned int num_symbols;
+
+  offset = rateless_encoder_get_count (op->rateless_encoder);
+  num_symbols = GNUNET_MAX (RATELESS_MIN_BATCH,
+                            offset / 4);
+  if (num_symbols > RATELESS_MAX_SYMBOLS_PER_MESSAGE)
+    num_symbols = RATELESS_MAX_SYMBOLS_PER_MESSAGE;
+  symbols = GNUNET_new_array (num_symbols,
+                              struct IBF_Bucket);
+  for (unsigned int i = 0; i < num_symbols; i++)
+    rateless_encoder_next (op->rateless_encoder,
+                           &symbols[i]);
+  ev = GNUNET_MQ_msg_extra (msg,
+                            num_symbols * RATELESS_SYMBOL_SIZE,
+                            GNUNET_MESSAGE_TYPE_SETU_P2P_RATELESS_SYMBOLS);
+  msg->offset = htonl (offset);
+  msg->salt = htonl (op->salt_send);
+  rateless_write_symbols (symbols,
+                          num_symbols,
+                          &msg[1]);
+  GNUNET_free (symbols);
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "sending rateless symbols %u-%u\n",
+       (unsigned int) offset,
+       (unsigned int) (offset + num_symbols - 1));
+  GNUNET_MQ_send (op->mq,
+                  ev);
+}
+
+
+/**
+ * Start streaming rateless IBF symbols of our set to the other peer,
+ * which decodes the difference.
+ *
+ * @param op the union operation
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR on failure
+ */
+static int
+start_rateless (struct Operation *op)
+{
+  op->rateless_encoder = create_rateless_encoder (op,
+                                                  op->salt_send);
+  if (NULL == op->rateless_encoder)
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                "Failed to allocate rateless IBF encoder\n");
+    return GNUNET_SYSERR;
+  }
+  GNUNET_STATISTICS_update (_GSS_statistics,
+                            "# of rateless union operations",
+                            1,
+                            GNUNET_NO);
+  for (unsigned int i = 0; i < RATELESS_WINDOW; i++)
+    send_rateless_symbols (op);
+  /* The other peer decodes, so we're passive. */
+  op->phase = PHASE_PASSIVE_DECODING;
+  return GNUNET_OK;
+}
+
+
 /**
  * Compute the necessary order of an ibf
  * from the size of the symmetric set difference.
@@ -2439,8 +2900,15 @@ handle_union_p2p_strata_estimator (void *cls,
     return;
   }
   GNUNET_assert (NULL != op->se);
-  strata_estimator_difference (remote_se,
-                               op->se);
+  if (GNUNET_OK !=
+      strata_estimator_difference (remote_se,
+                                   op->se))
+  {
+    /* insufficient resources, fail */
+    strata_estimator_destroy (remote_se);
+    fail_union_operation (op);
+    return;
+  }
 
   /* Calculate remote local diff */
   long diff_remote = remote_se->stratas[0]->strata[0]->remote_decoded_count;
@@ -2719,6 +3187,58 @@ send_offers_for_key (struct Operation *op,
 }
 
 
+/**
+ * Ask the remote peer for the elements of an IBF key that only it has.
+ *
+ * @param op union operation
+ * @param key the salted IBF key
+ */
+static void
+send_inquiry (struct Operation *op,
+              struct IBF_Key key)
+{
+  struct GNUNET_MQ_Envelope *ev;
+  struct InquiryMessage *msg;
+
+#if MEASURE_PERFORMANCE
+  perf_store.inquery.sent += 1;
+  perf_store.inquery.sent_var_bytes += sizeof(struct IBF_Key);
+#endif
+
+  /** Add sent inquiries to hashmap for flow control **/
+  struct GNUNET_HashContext *hashed_key_context =
+    GNUNET_CRYPTO_hash_context_start ();
+  struct GNUNET_HashCode *hashed_key = (struct
+                                        GNUNET_HashCode*) GNUNET_malloc (
+    sizeof(struct GNUNET_HashCode));
+  enum MESSAGE_CONTROL_FLOW_STATE mcfs = MSG_CFS_SENT;
+  GNUNET_CRYPTO_hash_context_read (hashed_key_context,
+                                   &key,
+                                   sizeof(struct IBF_Key));
+  GNUNET_CRYPTO_hash_context_finish (hashed_key_context,
+                                     hashed_key);
+  GNUNET_CONTAINER_multihashmap_put (op->inquiries_sent,
+                                     hashed_key,
+                                     &mcfs,
+                                     GNUNET_CONTAINER_MULTIHASHMAPOPTION_REPLACE
+                                     );
+
+  /* It may be nice to merge multiple requests, but with CADET's corking it is not worth
+   * the effort additional complexity. */
+  ev = GNUNET_MQ_msg_extra (msg,
+                            sizeof(struct IBF_Key),
+                            GNUNET_MESSAGE_TYPE_SETU_P2P_INQUIRY);
+  msg->salt = htonl (op->salt_receive);
+  GNUNET_memcpy (&msg[1],
+                 &key,
+                 sizeof(struct IBF_Key));
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "sending element inquiry for IBF key %lx\n",
+       (unsigned long) key.key_val);
+  GNUNET_MQ_send (op->mq, ev);
+}
+
+
 /**
  * Decode which elements are missing on each side, and
  * send the appropriate offers and inquiries.
@@ -2747,8 +3267,21 @@ decode_and_send (struct Operation *op)
   }
 
   diff_ibf = ibf_dup (op->local_ibf);
+  if (NULL == diff_ibf)
+  {
+    GNUNET_break (0);
+    /* allocation failed */
+    return GNUNET_SYSERR;
+  }
   ibf_subtract (diff_ibf,
                 op->remote_ibf);
+  if (GNUNET_OK != ibf_peel_init (diff_ibf))
+  {
+    GNUNET_break (0);
+    /* allocation failed */
+    ibf_destroy (diff_ibf);
+    return GNUNET_SYSERR;
+  }
 
   ibf_destroy (op->remote_ibf);
   op->remote_ibf = NULL;
@@ -2872,45 +3405,8 @@ decode_and_send (struct Operation *op)
     }
     else if (-1 == side)
     {
-      struct GNUNET_MQ_Envelope *ev;
-      struct InquiryMessage *msg;
-
-#if MEASURE_PERFORMANCE
-      perf_store.inquery.sent += 1;
-      perf_store.inquery.sent_var_bytes += sizeof(struct IBF_Key);
-#endif
-
-      /** Add sent inquiries to hashmap for flow control **/
-      struct GNUNET_HashContext *hashed_key_context =
-        GNUNET_CRYPTO_hash_context_start ();
-      struct GNUNET_HashCode *hashed_key = (struct
-                                            GNUNET_HashCode*) GNUNET_malloc (
-        sizeof(struct GNUNET_HashCode));
-      enum MESSAGE_CONTROL_FLOW_STATE mcfs = MSG_CFS_SENT;
-      GNUNET_CRYPTO_hash_context_read (hashed_key_context,
-                                       &key,
-                                       sizeof(struct IBF_Key));
-      GNUNET_CRYPTO_hash_context_finish (hashed_key_context,
-                                         hashed_key);
-      GNUNET_CONTAINER_multihashmap_put (op->inquiries_sent,
-                                         hashed_key,
-                                         &mcfs,
-                                         GNUNET_CONTAINER_MULTIHASHMAPOPTION_REPLACE
-                                         );
-
-      /* It may be nice to merge multiple requests, but with CADET's corking it is not worth
-       * the effort additional complexity. */
-      ev = GNUNET_MQ_msg_extra (msg,
-                                sizeof(struct IBF_Key),
-                                GNUNET_MESSAGE_TYPE_SETU_P2P_INQUIRY);
-      msg->salt = htonl (op->salt_receive);
-      GNUNET_memcpy (&msg[1],
-                     &key,
-                     sizeof(struct IBF_Key));
-      LOG (GNUNET_ERROR_TYPE_DEBUG,
-           "sending element inquiry for IBF key %lx\n",
-           (unsigned long) key.key_val);
-      GNUNET_MQ_send (op->mq, ev);
+      send_inquiry (op,
+                    key);
     }
     else
     {
@@ -3046,6 +3542,19 @@ check_union_p2p_ibf (void *cls,
     GNUNET_break_op (0);
     return GNUNET_SYSERR;
   }
+  if (msg->ibf_counter_bit_length > IBF_MAX_COUNTER_LENGTH)
+  {
+    GNUNET_break_op (0);
+    return GNUNET_SYSERR;
+  }
+  if ((0 == msg->ibf_size) ||
+      (msg->ibf_size > MAX_IBF_SIZE) ||
+      ((uint64_t) ntohl (msg->offset) + buckets_in_message >
+       msg->ibf_size))
+  {
+    GNUNET_break_op (0);
+    return GNUNET_SYSERR;
+  }
   if (op->phase == PHASE_EXPECT_IBF_LAST)
   {
     if (ntohl (msg->offset) != op->ibf_buckets_received)
@@ -3177,6 +3686,261 @@ handle_union_p2p_ibf (void *cls,
 }
 
 
+/**
+ * Send offers and inquiries for the difference we decoded from the
+ * rateless IBF symbols, followed by a DONE message.
+ *
+ * @param op the union operation
+ */
+static void
+send_rateless_decoded (struct Operation *op)
+{
+  struct GNUNET_MQ_Envelope *ev;
+  struct IBF_Key key;
+  int side;
+  unsigned int i;
+
+  for (i = 0;
+       GNUNET_YES ==
+       rateless_decoder_get_decoded (op->rateless_decoder,
+                                     i,
+                                     &side,
+                                     &key);
+       i++)
+  {
+    if (1 == side)
+    {
+      struct IBF_Key unsalted_key;
+
+      unsalt_key (&key,
+                  op->salt_receive,
+                  &unsalted_key);
+      send_offers_for_key (op,
+                           unsalted_key);
+    }
+    else
+    {
+      send_inquiry (op,
+                    key);
+    }
+  }
+  LOG (GNUNET_ERROR_TYPE_DEBUG,
+       "decoded %u elements from %u rateless symbols, sending DONE\n",
+       i,
+       (unsigned int) op->rateless_symbols);
+  rateless_decoder_destroy (op->rateless_decoder);
+  op->rateless_decoder = NULL;
+#if MEASURE_PERFORMANCE
+  perf_store.done.sent += 1;
+#endif
+  ev = GNUNET_MQ_msg_header (GNUNET_MESSAGE_TYPE_SETU_P2P_DONE);
+  GNUNET_MQ_send (op->mq,
+                  ev);
+}
+
+
+/**
+ * Check rateless IBF symbols from a remote peer.
+ *
+ * @param cls the union operation
+ * @param msg the header of the message
+ * @return #GNUNET_OK if @a msg is well-formed
+ */
+static int
+check_union_p2p_rateless_symbols (void *cls,
+                                  const struct RatelessSymbolsMessage *msg)
+{
+  size_t size = ntohs (msg->header.size) - sizeof(*msg);
+
+  if ((0 == size) ||
+      (0 != size % RATELESS_SYMBOL_SIZE))
+  {
+    GNUNET_break_op (0);
+    return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Handle rateless IBF symbols from a remote peer.  Decodes the
+ * difference while the symbols arrive, and acknowledges every
+ * message so that the remote peer sends more or stops.
+ *
+ * @param cls the union operation
+ * @param msg the header of the message
+ */
+static void
+handle_union_p2p_rateless_symbols (void *cls,
+                                   const struct RatelessSymbolsMessage *msg)
+{
+  struct Operation *op = cls;
+  struct GNUNET_MQ_Envelope *ev;
+  struct RatelessAckMessage *ack;
+  struct IBF_Bucket *symbols;
+  unsigned int num_symbols;
+  enum GNUNET_GenericReturnValue res;
+  /**
+   * Check that the message is received only in supported phase
+   */
+  uint8_t allowed_phases[] = {PHASE_EXPECT_SE, PHASE_RATELESS_DECODING,
+                              PHASE_ACTIVE_DECODING};
+
+  if (GNUNET_OK !=
+      check_valid_phase (allowed_phases,sizeof(allowed_phases),op))
+  {
+    GNUNET_break (0);
+    fail_union_operation (op);
+    return;
+  }
+  num_symbols = (ntohs (msg->header.size) - sizeof(*msg))
+                / RATELESS_SYMBOL_SIZE;
+  if (PHASE_ACTIVE_DECODING == op->phase)
+  {
+    /* symbols the other peer sent before it got our last ack */
+    if ((0 == op->rateless_symbols) ||
+        (NULL != op->rateless_decoder))
+    {
+      GNUNET_break_op (0);
+      fail_union_operation (op);
+      return;
+    }
+    GNUNET_CADET_receive_done (op->channel);
+    return;
+  }
+  if (PHASE_EXPECT_SE == op->phase)
+  {
+    struct RatelessEncoder *local;
+
+    /* the other peer accepted the rateless protocol we asked for */
+    if ((GNUNET_YES != op->rateless) ||
+        (0 != ntohl (msg->offset)))
+    {
+      GNUNET_break_op (0);
+      fail_union_operation (op);
+      return;
+    }
+    op->salt_receive = ntohl (msg->salt);
+    local = create_rateless_encoder (op,
+                                     op->salt_receive);
+    if (NULL == local)
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                  "Failed to allocate rateless IBF decoder\n");
+      fail_union_operation (op);
+      return;
+    }
+    op->rateless_decoder = rateless_decoder_create (local);
+    op->phase = PHASE_RATELESS_DECODING;
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# of rateless union operations",
+                              1,
+                              GNUNET_NO);
+  }
+  else if ((ntohl (msg->offset) != op->rateless_symbols) ||
+           (ntohl (msg->salt) != op->salt_receive))
+  {
+    GNUNET_break_op (0);
+    fail_union_operation (op);
+    return;
+  }
+  if (op->rateless_symbols + num_symbols > MAX_RATELESS_SYMBOLS)
+  {
+    GNUNET_break_op (0);
+    fail_union_operation (op);
+    return;
+  }
+  symbols = GNUNET_new_array (num_symbols,
+                              struct IBF_Bucket);
+  rateless_read_symbols (&msg[1],
+                         num_symbols,
+                         symbols);
+  res = GNUNET_NO;
+  for (unsigned int i = 0; (i < num_symbols) && (GNUNET_NO == res); i++)
+    res = rateless_decoder_add_symbol (op->rateless_decoder,
+                                       &symbols[i]);
+  GNUNET_free (symbols);
+  op->rateless_symbols += num_symbols;
+  if (GNUNET_SYSERR == res)
+  {
+    GNUNET_break_op (0);
+    fail_union_operation (op);
+    return;
+  }
+  ev = GNUNET_MQ_msg (ack,
+                      GNUNET_MESSAGE_TYPE_SETU_P2P_RATELESS_ACK);
+  ack->symbols_received = htonl (op->rateless_symbols);
+  ack->decoded = htonl ((GNUNET_YES == res) ? GNUNET_YES : GNUNET_NO);
+  GNUNET_MQ_send (op->mq,
+                  ev);
+  if (GNUNET_YES == res)
+  {
+    op->phase = PHASE_ACTIVE_DECODING;
+    send_rateless_decoded (op);
+  }
+  GNUNET_CADET_receive_done (op->channel);
+}
+
+
+/**
+ * Handle the acknowledgement of rateless IBF symbols we sent.
+ *
+ * @param cls the union operation
+ * @param msg the message
+ */
+static void
+handle_union_p2p_rateless_ack (void *cls,
+                               const struct RatelessAckMessage *msg)
+{
+  struct Operation *op = cls;
+  /**
+   * Check that the message is received only in supported phase
+   */
+  uint8_t allowed_phases[] = {PHASE_PASSIVE_DECODING};
+
+  if (GNUNET_OK !=
+      check_valid_phase (allowed_phases,sizeof(allowed_phases),op))
+  {
+    GNUNET_break (0);
+    fail_union_operation (op);
+    return;
+  }
+  if ((NULL == op->rateless_encoder) ||
+      (ntohl (msg->symbols_received) >
+       rateless_encoder_get_count (op->rateless_encoder)))
+  {
+    GNUNET_break_op (0);
+    fail_union_operation (op);
+    return;
+  }
+  if (GNUNET_YES == ntohl (msg->decoded))
+  {
+    LOG (GNUNET_ERROR_TYPE_DEBUG,
+         "other peer decoded the difference from %u rateless symbols\n",
+         (unsigned int) ntohl (msg->symbols_received));
+    rateless_encoder_destroy (op->rateless_encoder);
+    op->rateless_encoder = NULL;
+  }
+  else if (rateless_encoder_get_count (op->rateless_encoder)
+           >= MAX_RATELESS_SYMBOLS)
+  {
+    GNUNET_STATISTICS_update (_GSS_statistics,
+                              "# of failed union operations (too large)",
+                              1,
+                              GNUNET_NO);
+    LOG (GNUNET_ERROR_TYPE_ERROR,
+         "set union failed: reached rateless symbol limit\n");
+    fail_union_operation (op);
+    return;
+  }
+  else
+  {
+    send_rateless_symbols (op);
+  }
+  GNUNET_CADET_receive_done (op->channel);
+}
+
+
 /**
  * Send a result message to the client indicating
  * that there is a new element.
@@ -3339,6 +4103,7 @@ handle_union_p2p_elements (void *cls,
   ee->remote = GNUNET_YES;
   GNUNET_SETU_element_hash (&ee->element,
                             &ee->element_hash);
+  ee->ibf_key = get_ibf_key (&ee->element_hash);
   if (GNUNET_NO ==
       GNUNET_CONTAINER_multihashmap_remove (op->demanded_hashes,
                                             &ee->element_hash,
@@ -3481,6 +4246,7 @@ handle_union_p2p_full_element (void *cls,
   ee->remote = GNUNET_YES;
   GNUNET_SETU_element_hash (&ee->element,
                             &ee->element_hash);
+  ee->ibf_key = get_ibf_key (&ee->element_hash);
   LOG (GNUNET_ERROR_TYPE_DEBUG,
        "Got element (full diff, size %u, hash %s) from peer\n",
        (unsigned int) element_size,
@@ -4367,6 +5133,9 @@ client_disconnect_cb (void *cls,
       strata_estimator_destroy (set->se);
       set->se = NULL;
     }
+    while (NULL != set->base_ibf_head)
+      base_ibf_destroy (set,
+                        set->base_ibf_head);
     /* free set content (or at least decrement RC) */
     set->content = NULL;
     GNUNET_assert (0 != content->refcount);
@@ -4379,6 +5148,7 @@ client_disconnect_cb (void *cls,
                                              NULL);
       GNUNET_CONTAINER_multihashmap_destroy (content->elements);
       content->elements = NULL;
+      GNUNET_free (content->element_keys);
       GNUNET_free (content);
     }
     GNUNET_free (set);
@@ -4488,6 +5258,8 @@ handle_incoming_msg (void *cls,
   if (NULL != nested_context)
     op->context_msg = GNUNET_copy_message (nested_context);
   op->remote_element_count = ntohl (msg->element_count);
+  op->rateless = (GNUNET_MESSAGE_TYPE_SETU_P2P_OPERATION_REQUEST_RATELESS ==
+                  ntohs (msg->header.type)) ? GNUNET_YES : GNUNET_NO;
   GNUNET_log (
     GNUNET_ERROR_TYPE_DEBUG,
     "Received P2P operation request (port %s) for active listener\n",
@@ -4699,6 +5471,10 @@ handle_client_listen (void *cls,
                            GNUNET_MESSAGE_TYPE_SETU_P2P_OPERATION_REQUEST,
                            struct OperationRequestMessage,
                            NULL),
+    GNUNET_MQ_hd_var_size (incoming_msg,
+                           GNUNET_MESSAGE_TYPE_SETU_P2P_OPERATION_REQUEST_RATELESS,
+                           struct OperationRequestMessage,
+                           NULL),
     GNUNET_MQ_hd_var_size (union_p2p_ibf,
                            GNUNET_MESSAGE_TYPE_SETU_P2P_IBF,
                            struct IBFMessage,
@@ -4751,6 +5527,14 @@ handle_client_listen (void *cls,
                            GNUNET_MESSAGE_TYPE_SETU_P2P_SEND_FULL,
                            struct TransmitFullMessage,
                            NULL),
+    GNUNET_MQ_hd_var_size (union_p2p_rateless_symbols,
+                           GNUNET_MESSAGE_TYPE_SETU_P2P_RATELESS_SYMBOLS,
+                           struct RatelessSymbolsMessage,
+                           NULL),
+    GNUNET_MQ_hd_fixed_size (union_p2p_rateless_ack,
+                             GNUNET_MESSAGE_TYPE_SETU_P2P_RATELESS_ACK,
+                             struct RatelessAckMessage,
+                             NULL),
     GNUNET_MQ_handler_end ()
   };
   struct Listener *listener;
@@ -4878,6 +5662,7 @@ handle_client_set_add (void *cls,
     ee->remote = GNUNET_NO;
     ee->generation = set->current_generation;
     ee->element_hash = hash;
+    ee->ibf_key = get_ibf_key (&hash);
     GNUNET_break (GNUNET_YES ==
                   GNUNET_CONTAINER_multihashmap_put (
                     set->content->elements,
@@ -4894,8 +5679,12 @@ handle_client_set_add (void *cls,
     /* same element inserted twice */
     return;
   }
+  append_key (&set->content->element_keys,
+              &set->content->element_keys_len,
+              &set->content->element_keys_size,
+              ee->ibf_key);
   strata_estimator_insert (set->se,
-                           get_ibf_key (&ee->element_hash));
+                           ee->ibf_key);
 }
 
 
@@ -5004,6 +5793,14 @@ handle_client_evaluate (void *cls,
                            GNUNET_MESSAGE_TYPE_SETU_P2P_SEND_FULL,
                            struct TransmitFullMessage,
                            NULL),
+    GNUNET_MQ_hd_var_size (union_p2p_rateless_symbols,
+                           GNUNET_MESSAGE_TYPE_SETU_P2P_RATELESS_SYMBOLS,
+                           struct RatelessSymbolsMessage,
+                           op),
+    GNUNET_MQ_hd_fixed_size (union_p2p_rateless_ack,
+                             GNUNET_MESSAGE_TYPE_SETU_P2P_RATELESS_ACK,
+                             struct RatelessAckMessage,
+                             op),
     GNUNET_MQ_handler_end ()
   };
   struct Set *set;
@@ -5025,6 +5822,8 @@ handle_client_evaluate (void *cls,
   op->force_full = msg->force_full;
   op->force_delta = msg->force_delta;
   op->symmetric = msg->symmetric;
+  op->rateless = ((GNUNET_YES == msg->rateless) &&
+                  (GNUNET_YES != msg->force_full)) ? GNUNET_YES : GNUNET_NO;
   op->rtt_bandwidth_tradeoff = msg->bandwidth_latency_tradeoff;
   op->ibf_bucket_number_factor = msg->ibf_bucket_number_factor;
   op->ibf_number_buckets_per_element = msg->ibf_number_of_buckets_per_element;
@@ -5064,12 +5863,19 @@ handle_client_evaluate (void *cls,
   {
     struct GNUNET_MQ_Envelope *ev;
     struct OperationRequestMessage *msg;
+    uint16_t type;
 
 #if MEASURE_PERFORMANCE
     perf_store.operation_request.sent += 1;
 #endif
+    /* only peers that support the rateless protocol know its
+       request, so we do not send it unless asked to */
+    if (GNUNET_YES == op->rateless)
+      type = GNUNET_MESSAGE_TYPE_SETU_P2P_OPERATION_REQUEST_RATELESS;
+    else
+      type = GNUNET_MESSAGE_TYPE_SETU_P2P_OPERATION_REQUEST;
     ev = GNUNET_MQ_msg_nested_mh (msg,
-                                  GNUNET_MESSAGE_TYPE_SETU_P2P_OPERATION_REQUEST,
+                                  type,
                                   context);
     if (NULL == ev)
     {
@@ -5232,6 +6038,10 @@ handle_client_accept (void *cls,
   op->force_full = msg->force_full;
   op->force_delta = msg->force_delta;
   op->symmetric = msg->symmetric;
+  /* op->rateless was set by #handle_incoming_msg(), only an
+     initiating peer that supports the rateless protocol asks for it */
+  if (GNUNET_YES == op->force_full)
+    op->rateless = GNUNET_NO;
   op->rtt_bandwidth_tradeoff = msg->bandwidth_latency_tradeoff;
   op->ibf_bucket_number_factor = msg->ibf_bucket_number_factor;
   op->ibf_number_buckets_per_element = msg->ibf_number_of_buckets_per_element;
@@ -5271,7 +6081,6 @@ handle_client_accept (void *cls,
     size_t len;
     uint16_t type;
 
-    op->se = strata_estimator_dup (op->set->se);
     op->demanded_hashes = GNUNET_CONTAINER_multihashmap_create (32,
                                                                 GNUNET_NO);
     op->salt_receive = (op->peer_site + 1) % 2;
@@ -5280,6 +6089,21 @@ handle_client_accept (void *cls,
     op->initial_size = GNUNET_CONTAINER_multihashmap32_size (
       op->key_to_element);
 
+    if (GNUNET_YES == op->rateless)
+    {
+      if (GNUNET_OK !=
+          start_rateless (op))
+      {
+        fail_union_operation (op);
+        GNUNET_SERVICE_client_continue (cs->client);
+        return;
+      }
+      GNUNET_CADET_receive_done (op->channel);
+      GNUNET_SERVICE_client_continue (cs->client);
+      return;
+    }
+    op->se = strata_estimator_dup (op->set->se);
+
     /* kick off the operation */
     se = op->se;
 
@@ -35,7 +35,8 @@ GNUNET_NETWORK_STRUCT_BEGIN
 struct OperationRequestMessage
 {
   /**
-   * Type: #GNUNET_MESSAGE_TYPE_SET_P2P_OPERATION_REQUEST
+   * Type: #GNUNET_MESSAGE_TYPE_SET_P2P_OPERATION_REQUEST or
+   * #GNUNET_MESSAGE_TYPE_SETU_P2P_OPERATION_REQUEST_RATELESS
    */
   struct GNUNET_MessageHeader header;
 
@@ -222,6 +223,54 @@ struct StrataEstimatorMessage
 };
 
 
+/**
+ * Coded symbols of a rateless IBF.  The symbols of one operation are
+ * split over many messages.
+ */
+struct RatelessSymbolsMessage
+{
+  /**
+   * Type: #GNUNET_MESSAGE_TYPE_SETU_P2P_RATELESS_SYMBOLS
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Index of the first symbol in this message.
+   */
+  uint32_t offset GNUNET_PACKED;
+
+  /**
+   * Salt used for the keys of the elements.
+   */
+  uint32_t salt GNUNET_PACKED;
+
+  /* rest: symbols */
+};
+
+
+/**
+ * Acknowledges received rateless IBF symbols.
+ */
+struct RatelessAckMessage
+{
+  /**
+   * Type: #GNUNET_MESSAGE_TYPE_SETU_P2P_RATELESS_ACK
+   */
+  struct GNUNET_MessageHeader header;
+
+  /**
+   * Number of symbols received so far.
+   */
+  uint32_t symbols_received GNUNET_PACKED;
+
+  /**
+   * #GNUNET_YES if the difference is decoded and no more symbols
+   * are needed.
+   */
+  uint32_t decoded GNUNET_PACKED;
+};
+
+
 /**
  * Message which signals to other peer that we are sending full set
  *
@@ -0,0 +1,685 @@
+/*
+      This file is part of GNUnet
+      Copyright (C) 2021 GNUnet e.V.
+
+      GNUnet is free software: you can redistribute it and/or modify it
+      under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License,
+      or (at your option) any later version.
+
+      GNUnet is distributed in the hope that it will be useful, but
+      WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+      Affero General Public License for more details.
+
+      You should have received a copy of the GNU Affero General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+/**
+ * @file setu/gnunet-service-setu_rateless.c
+ * @brief rateless invertible bloom lookup tables, following
+ *        "Practical Rateless Set Reconciliation" by Yang et al. (2024)
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "ibf.h"
+#include "gnunet-service-setu_rateless.h"
+
+
+/**
+ * Index used for elements that will not be part of any further
+ * symbol, beyond the largest symbol index we can produce.
+ */
+#define RATELESS_INDEX_END (((uint64_t) UINT32_MAX) + 1)
+
+/**
+ * Initial number of symbols an encoder keeps mappings for.
+ */
+#define RATELESS_MIN_SLOTS 1024
+
+
+/**
+ * State of the mapping of one element to the symbols it is part of.
+ */
+struct RatelessMapping
+{
+  /**
+   * Key of the element.
+   */
+  struct IBF_Key key;
+
+  /**
+   * State of the pseudo-random generator for the next index.
+   */
+  uint64_t prng;
+
+  /**
+   * Index of the next symbol the element is part of.
+   */
+  uint64_t index;
+
+  /**
+   * Hash of @e key.
+   */
+  struct IBF_KeyHash key_hash;
+
+  /**
+   * Added to the count of the symbols; 1 for elements of the set,
+   * the negated side for elements a decoder has peeled.
+   */
+  int32_t side;
+};
+
+
+/**
+ * The mappings whose next symbol is the same.
+ */
+struct RatelessSlot
+{
+  /**
+   * The mappings.
+   */
+  struct RatelessMapping *maps;
+
+  /**
+   * Number of entries in @e maps.
+   */
+  unsigned int maps_len;
+
+  /**
+   * Allocated length of @e maps.
+   */
+  unsigned int maps_size;
+};
+
+
+/**
+ * Produces coded symbols for a set.
+ */
+struct RatelessEncoder
+{
+  /**
+   * For each symbol index below @e slots_len, the mappings whose next
+   * symbol it is.  Elements are part of few symbols, so this is much
+   * cheaper than keeping the mappings in a priority queue, and the
+   * mappings of a symbol are read sequentially.
+   */
+  struct RatelessSlot *slots;
+
+  /**
+   * Number of entries in @e slots.
+   */
+  uint32_t slots_len;
+
+  /**
+   * The mappings whose next symbol is beyond @e slots_len.
+   */
+  struct RatelessSlot far;
+
+  /**
+   * Number of symbols produced so far.
+   */
+  uint32_t count;
+};
+
+
+/**
+ * An element of the difference found by a decoder.
+ */
+struct RatelessDecodedKey
+{
+  /**
+   * Key of the element.
+   */
+  struct IBF_Key key;
+
+  /**
+   * 1 if the local set has the element, -1 if the remote set has it.
+   */
+  int side;
+};
+
+
+/**
+ * Decodes the difference between the local set and a remote set.
+ */
+struct RatelessDecoder
+{
+  /**
+   * Encoder of the local set, plus the elements peeled so far with
+   * their side negated, so that its symbols cancel them out.
+   */
+  struct RatelessEncoder *local;
+
+  /**
+   * Differences between local and remote symbols, with the elements
+   * decoded so far removed.
+   */
+  struct IBF_Bucket *symbols;
+
+  /**
+   * Number of entries in @e symbols.
+   */
+  unsigned int symbols_len;
+
+  /**
+   * Allocated length of @e symbols.
+   */
+  unsigned int symbols_size;
+
+  /**
+   * Stack of indices of @e symbols that may be pure.
+   */
+  uint32_t *pure;
+
+  /**
+   * Number of entries in @e pure.
+   */
+  unsigned int pure_len;
+
+  /**
+   * Allocated length of @e pure.
+   */
+  unsigned int pure_size;
+
+  /**
+   * Elements decoded so far.
+   */
+  struct RatelessDecodedKey *decoded;
+
+  /**
+   * Number of entries in @e decoded.
+   */
+  unsigned int decoded_len;
+
+  /**
+   * Allocated length of @e decoded.
+   */
+  unsigned int decoded_size;
+};
+
+
+/**
+ * Make sure an array has room for one more entry.
+ *
+ * @param arr the array
+ * @param len number of entries in @a arr
+ * @param[in,out] size allocated length of @a arr
+ * @param elem_size size of an entry
+ * @return the (possibly moved) array
+ */
+static void *
+grow_array (void *arr,
+            unsigned int len,
+            unsigned int *size,
+            size_t elem_size)
+{
+  if (len < *size)
+    return arr;
+  GNUNET_assert (*size < UINT_MAX / 2 / elem_size);
+  *size = GNUNET_MAX (16, *size * 2);
+  /* not GNUNET_array_grow(), large sets exceed its allocation limit */
+  return GNUNET_realloc (arr,
+                         *size * elem_size);
+}
+
+
+/**
+ * Compute the hash of a key.  Must not be linear (like a CRC), as
+ * otherwise the xor of the hashes of any odd number of keys is the
+ * hash of the xor of the keys, and such symbols would look pure.
+ *
+ * @param key the key
+ * @return the hash
+ */
+static struct IBF_KeyHash
+key_hash (struct IBF_Key key)
+{
+  struct IBF_KeyHash h;
+  uint64_t x = key.key_val;
+
+  /* finalizer of MurmurHash3 */
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdLLU;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53LLU;
+  x ^= x >> 33;
+  h.key_hash_val = (uint32_t) x;
+  return h;
+}
+
+
+/**
+ * Move a mapping to the next symbol its element is part of.  The gap
+ * grows with the index, so that an element is part of symbol i with
+ * probability about 1 / (1 + i / 2).
+ *
+ * @param m the mapping
+ */
+static void
+mapping_advance (struct RatelessMapping *m)
+{
+  double step;
+
+  m->prng *= 0xda942042e4dd58b5LLU;
+  step = ceil (((double) m->index + 1.5)
+               * (4294967296.0 / sqrt ((double) m->prng + 1.0) - 1.0));
+  if (step < 1.0)
+    step = 1.0;
+  if (step >= (double) (RATELESS_INDEX_END - m->index))
+    m->index = RATELESS_INDEX_END;
+  else
+    m->index += (uint64_t) step;
+}
+
+
+/**
+ * Start the mapping of an element at symbol 0.
+ *
+ * @param[out] m the mapping to initialize
+ * @param key key of the element
+ * @param side value to add to the count of the symbols
+ */
+static void
+mapping_init (struct RatelessMapping *m,
+              struct IBF_Key key,
+              int32_t side)
+{
+  m->key = key;
+  m->prng = key.key_val;
+  m->index = 0;
+  m->key_hash = key_hash (key);
+  m->side = side;
+}
+
+
+/**
+ * Append a mapping to a slot.
+ *
+ * @param slot the slot
+ * @param m the mapping
+ */
+static void
+slot_append (struct RatelessSlot *slot,
+             const struct RatelessMapping *m)
+{
+  slot->maps = grow_array (slot->maps,
+                           slot->maps_len,
+                           &slot->maps_size,
+                           sizeof(struct RatelessMapping));
+  slot->maps[slot->maps_len++] = *m;
+}
+
+
+/**
+ * Put a mapping into the slot of its next symbol.
+ *
+ * @param enc the encoder
+ * @param m the mapping
+ */
+static void
+encoder_schedule (struct RatelessEncoder *enc,
+                  const struct RatelessMapping *m)
+{
+  if (RATELESS_INDEX_END == m->index)
+    return;
+  if (m->index < enc->slots_len)
+    slot_append (&enc->slots[m->index],
+                 m);
+  else
+    slot_append (&enc->far,
+                 m);
+}
+
+
+/**
+ * Quadruple the number of symbols the encoder keeps slots for, and move
+ * the far mappings that now fit.
+ *
+ * @param enc the encoder
+ */
+static void
+encoder_grow_slots (struct RatelessEncoder *enc)
+{
+  uint32_t old_len = enc->slots_len;
+  struct RatelessSlot far = enc->far;
+
+  GNUNET_assert (old_len < UINT32_MAX);
+  if (old_len >= UINT32_MAX / 4)
+    enc->slots_len = UINT32_MAX;
+  else
+    enc->slots_len = 4 * old_len;
+  enc->slots = GNUNET_realloc (enc->slots,
+                               (size_t) enc->slots_len
+                               * sizeof(struct RatelessSlot));
+  memset (&enc->slots[old_len],
+          0,
+          (size_t) (enc->slots_len - old_len) * sizeof(struct RatelessSlot));
+  memset (&enc->far,
+          0,
+          sizeof(enc->far));
+  for (unsigned int i = 0; i < far.maps_len; i++)
+    encoder_schedule (enc,
+                      &far.maps[i]);
+  GNUNET_free (far.maps);
+}
+
+
+/**
+ * Add a mapping to an encoder.  The mapping is first moved past the
+ * symbols the encoder already produced.
+ *
+ * @param enc the encoder
+ * @param m the mapping
+ */
+static void
+encoder_insert (struct RatelessEncoder *enc,
+                struct RatelessMapping *m)
+{
+  while (m->index < enc->count)
+    mapping_advance (m);
+  encoder_schedule (enc,
+                    m);
+}
+
+
+struct RatelessEncoder *
+rateless_encoder_create (unsigned int capacity)
+{
+  struct RatelessEncoder *enc;
+
+  enc = GNUNET_new (struct RatelessEncoder);
+  enc->slots_len = RATELESS_MIN_SLOTS;
+  enc->slots = GNUNET_new_array (RATELESS_MIN_SLOTS,
+                                 struct RatelessSlot);
+  if (0 == capacity)
+    return enc;
+  /* all elements start in the slot of symbol 0 */
+  if (capacity > SIZE_MAX / sizeof(struct RatelessMapping))
+  {
+    rateless_encoder_destroy (enc);
+    return NULL;
+  }
+  enc->slots[0].maps
+    = GNUNET_malloc_large (capacity * sizeof(struct RatelessMapping));
+  if (NULL == enc->slots[0].maps)
+  {
+    rateless_encoder_destroy (enc);
+    return NULL;
+  }
+  enc->slots[0].maps_size = capacity;
+  return enc;
+}
+
+
+void
+rateless_encoder_add (struct RatelessEncoder *enc,
+                      struct IBF_Key key)
+{
+  struct RatelessMapping m;
+
+  mapping_init (&m,
+                key,
+                1);
+  encoder_insert (enc,
+                  &m);
+}
+
+
+void
+rateless_encoder_next (struct RatelessEncoder *enc,
+                       struct IBF_Bucket *symbol)
+{
+  struct RatelessSlot slot;
+
+  GNUNET_assert (enc->count < UINT32_MAX);
+  memset (symbol,
+          0,
+          sizeof(*symbol));
+  if (enc->count == enc->slots_len)
+    encoder_grow_slots (enc);
+  slot = enc->slots[enc->count];
+  memset (&enc->slots[enc->count],
+          0,
+          sizeof(struct RatelessSlot));
+  for (unsigned int i = 0; i < slot.maps_len; i++)
+  {
+    struct RatelessMapping *m = &slot.maps[i];
+
+    symbol->key_sum.key_val ^= m->key.key_val;
+    symbol->key_hash_sum.key_hash_val ^= m->key_hash.key_hash_val;
+    symbol->count += m->side;
+    /* the next index is always larger, so this does not touch the
+       slot we are reading */
+    mapping_advance (m);
+    encoder_schedule (enc,
+                      m);
+  }
+  GNUNET_free (slot.maps);
+  enc->count++;
+}
+
+
+uint32_t
+rateless_encoder_get_count (const struct RatelessEncoder *enc)
+{
+  return enc->count;
+}
+
+
+void
+rateless_encoder_destroy (struct RatelessEncoder *enc)
+{
+  for (uint32_t i = enc->count; i < enc->slots_len; i++)
+    GNUNET_free (enc->slots[i].maps);
+  GNUNET_free (enc->slots);
+  GNUNET_free (enc->far.maps);
+  GNUNET_free (enc);
+}
+
+
+void
+rateless_write_symbols (const struct IBF_Bucket *symbols,
+                        unsigned int count,
+                        void *buf)
+{
+  char *p = buf;
+
+  for (unsigned int i = 0; i < count; i++)
+  {
+    uint64_t key = GNUNET_htonll (symbols[i].key_sum.key_val);
+    uint32_t hash = htonl (symbols[i].key_hash_sum.key_hash_val);
+    uint32_t cnt = htonl ((uint32_t) symbols[i].count);
+
+    GNUNET_memcpy (p, &key, sizeof(key));
+    p += sizeof(key);
+    GNUNET_memcpy (p, &hash, sizeof(hash));
+    p += sizeof(hash);
+    GNUNET_memcpy (p, &cnt, sizeof(cnt));
+    p += sizeof(cnt);
+  }
+}
+
+
+void
+rateless_read_symbols (const void *buf,
+                       unsigned int count,
+                       struct IBF_Bucket *symbols)
+{
+  const char *p = buf;
+
+  for (unsigned int i = 0; i < count; i++)
+  {
+    uint64_t key;
+    uint32_t hash;
+    uint32_t cnt;
+
+    GNUNET_memcpy (&key, p, sizeof(key));
+    p += sizeof(key);
+    GNUNET_memcpy (&hash, p, sizeof(hash));
+    p += sizeof(hash);
+    GNUNET_memcpy (&cnt, p, sizeof(cnt));
+    p += sizeof(cnt);
+    symbols[i].key_sum.key_val = GNUNET_ntohll (key);
+    symbols[i].key_hash_sum.key_hash_val = ntohl (hash);
+    symbols[i].count = (int32_t) ntohl (cnt);
+  }
+}
+
+
+struct RatelessDecoder *
+rateless_decoder_create (struct RatelessEncoder *local)
+{
+  struct RatelessDecoder *dec;
+
+  GNUNET_assert (0 == local->count);
+  dec = GNUNET_new (struct RatelessDecoder);
+  dec->local = local;
+  return dec;
+}
+
+
+/**
+ * Is a symbol of the difference made up of a single element?
+ *
+ * @param symbol the symbol
+ * @return #GNUNET_YES if the symbol is pure
+ */
+static int
+symbol_is_pure (const struct IBF_Bucket *symbol)
+{
+  if ((1 != symbol->count) &&
+      (-1 != symbol->count))
+    return GNUNET_NO;
+  return (key_hash (symbol->key_sum).key_hash_val ==
+          symbol->key_hash_sum.key_hash_val) ? GNUNET_YES : GNUNET_NO;
+}
+
+
+/**
+ * Remember that a symbol of the difference may be pure.
+ *
+ * @param dec the decoder
+ * @param idx index of the symbol
+ */
+static void
+push_pure (struct RatelessDecoder *dec,
+           uint32_t idx)
+{
+  dec->pure = grow_array (dec->pure,
+                          dec->pure_len,
+                          &dec->pure_size,
+                          sizeof(uint32_t));
+  dec->pure[dec->pure_len++] = idx;
+}
+
+
+enum GNUNET_GenericReturnValue
+rateless_decoder_add_symbol (struct RatelessDecoder *dec,
+                             const struct IBF_Bucket *remote)
+{
+  struct IBF_Bucket *symbol;
+  const struct IBF_Bucket *first;
+
+  dec->symbols = grow_array (dec->symbols,
+                             dec->symbols_len,
+                             &dec->symbols_size,
+                             sizeof(struct IBF_Bucket));
+  symbol = &dec->symbols[dec->symbols_len];
+  rateless_encoder_next (dec->local,
+                         symbol);
+  symbol->key_sum.key_val ^= remote->key_sum.key_val;
+  symbol->key_hash_sum.key_hash_val ^= remote->key_hash_sum.key_hash_val;
+  symbol->count = (int32_t) ((uint32_t) symbol->count
+                             - (uint32_t) remote->count);
+  if (symbol_is_pure (symbol))
+    push_pure (dec,
+               dec->symbols_len);
+  dec->symbols_len++;
+
+  while (dec->pure_len > 0)
+  {
+    const struct IBF_Bucket *pure;
+    struct RatelessMapping m;
+    struct IBF_Key key;
+    int32_t side;
+
+    pure = &dec->symbols[dec->pure[--dec->pure_len]];
+    if (! symbol_is_pure (pure))
+      continue;
+    /* every symbol yields at most one element of a real difference */
+    if (dec->decoded_len == dec->symbols_len)
+      return GNUNET_SYSERR;
+    key = pure->key_sum;
+    side = pure->count;
+    dec->decoded = grow_array (dec->decoded,
+                               dec->decoded_len,
+                               &dec->decoded_size,
+                               sizeof(struct RatelessDecodedKey));
+    dec->decoded[dec->decoded_len].key = key;
+    dec->decoded[dec->decoded_len].side = side;
+    dec->decoded_len++;
+    /* remove the element from all symbols we have ... */
+    mapping_init (&m,
+                  key,
+                  -side);
+    while (m.index < dec->symbols_len)
+    {
+      struct IBF_Bucket *s = &dec->symbols[m.index];
+
+      s->key_sum.key_val ^= key.key_val;
+      s->key_hash_sum.key_hash_val ^= m.key_hash.key_hash_val;
+      s->count = (int32_t) ((uint32_t) s->count - (uint32_t) side);
+      if (symbol_is_pure (s))
+        push_pure (dec,
+                   (uint32_t) m.index);
+      mapping_advance (&m);
+    }
+    /* ... and from the ones still to come */
+    encoder_insert (dec->local,
+                    &m);
+  }
+  first = &dec->symbols[0];
+  if ((0 == first->count) &&
+      (0 == first->key_sum.key_val) &&
+      (0 == first->key_hash_sum.key_hash_val))
+    return GNUNET_YES;
+  return GNUNET_NO;
+}
+
+
+uint32_t
+rateless_decoder_get_count (const struct RatelessDecoder *dec)
+{
+  return dec->symbols_len;
+}
+
+
+enum GNUNET_GenericReturnValue
+rateless_decoder_get_decoded (const struct RatelessDecoder *dec,
+                              unsigned int i,
+                              int *side,
+                              struct IBF_Key *key)
+{
+  if (i >= dec->decoded_len)
+    return GNUNET_NO;
+  *side = dec->decoded[i].side;
+  *key = dec->decoded[i].key;
+  return GNUNET_YES;
+}
+
+
+void
+rateless_decoder_destroy (struct RatelessDecoder *dec)
+{
+  rateless_encoder_destroy (dec->local);
+  GNUNET_free (dec->symbols);
+  GNUNET_free (dec->pure);
+  GNUNET_free (dec->decoded);
+  GNUNET_free (dec);
+}
+
+
+/* end of gnunet-service-setu_rateless.c */
@@ -0,0 +1,203 @@
+/*
+      This file is part of GNUnet
+      Copyright (C) 2021 GNUnet e.V.
+
+      GNUnet is free software: you can redistribute it and/or modify it
+      under the terms of the GNU Affero General Public License as published
+      by the Free Software Foundation, either version 3 of the License,
+      or (at your option) any later version.
+
+      GNUnet is distributed in the hope that it will be useful, but
+      WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+      Affero General Public License for more details.
+
+      You should have received a copy of the GNU Affero General Public License
+      along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+
+/**
+ * @file setu/gnunet-service-setu_rateless.h
+ * @brief rateless invertible bloom lookup tables
+ *
+ * An encoder turns a set into an endless sequence of coded symbols.
+ * Every element is part of symbol 0, and of later symbols with a
+ * probability that decreases with the index of the symbol, so that
+ * any prefix of the sequence can be decoded once it is a bit longer
+ * than the set difference.  The receiver subtracts the symbols of
+ * its own set and peels the difference while symbols arrive; there
+ * is no need to know the size of the difference in advance.
+ */
+
+#ifndef GNUNET_SERVICE_SETU_RATELESS_H
+#define GNUNET_SERVICE_SETU_RATELESS_H
+
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include "ibf.h"
+
+
+/**
+ * Size of a coded symbol on the wire.
+ */
+#define RATELESS_SYMBOL_SIZE (sizeof(struct IBF_Key) \
+                              + sizeof(struct IBF_KeyHash) \
+                              + sizeof(int32_t))
+
+
+/**
+ * Produces coded symbols for a set.
+ */
+struct RatelessEncoder;
+
+
+/**
+ * Decodes the difference between the local set and a remote set
+ * from the remote set's coded symbols.
+ */
+struct RatelessDecoder;
+
+
+/**
+ * Create an encoder for an empty set.
+ *
+ * @param capacity number of elements to reserve space for
+ * @return the encoder, NULL if we are out of memory
+ */
+struct RatelessEncoder *
+rateless_encoder_create (unsigned int capacity);
+
+
+/**
+ * Add an element to the set of an encoder.  The element is only
+ * part of symbols that the encoder did not produce yet.
+ *
+ * @param enc the encoder
+ * @param key key of the element
+ */
+void
+rateless_encoder_add (struct RatelessEncoder *enc,
+                      struct IBF_Key key);
+
+
+/**
+ * Produce the next coded symbol.
+ *
+ * @param enc the encoder
+ * @param[out] symbol where to write the symbol
+ */
+void
+rateless_encoder_next (struct RatelessEncoder *enc,
+                       struct IBF_Bucket *symbol);
+
+
+/**
+ * Get the number of symbols the encoder has produced so far.
+ *
+ * @param enc the encoder
+ * @return index of the next symbol
+ */
+uint32_t
+rateless_encoder_get_count (const struct RatelessEncoder *enc);
+
+
+/**
+ * Destroy an encoder.
+ *
+ * @param enc encoder to destroy
+ */
+void
+rateless_encoder_destroy (struct RatelessEncoder *enc);
+
+
+/**
+ * Write coded symbols to a buffer in network byte order.
+ *
+ * @param symbols the symbols
+ * @param count number of symbols
+ * @param buf buffer of @a count * #RATELESS_SYMBOL_SIZE bytes
+ */
+void
+rateless_write_symbols (const struct IBF_Bucket *symbols,
+                        unsigned int count,
+                        void *buf);
+
+
+/**
+ * Read coded symbols written with #rateless_write_symbols().
+ *
+ * @param buf buffer of @a count * #RATELESS_SYMBOL_SIZE bytes
+ * @param count number of symbols
+ * @param[out] symbols where to store the symbols
+ */
+void
+rateless_read_symbols (const void *buf,
+                       unsigned int count,
+                       struct IBF_Bucket *symbols);
+
+
+/**
+ * Create a decoder.
+ *
+ * @param local encoder of the local set which has not produced any
+ *        symbols yet, the decoder takes ownership of it
+ * @return the decoder
+ */
+struct RatelessDecoder *
+rateless_decoder_create (struct RatelessEncoder *local);
+
+
+/**
+ * Add the next coded symbol of the remote set and decode as much of
+ * the difference as possible.
+ *
+ * @param dec the decoder
+ * @param remote the symbol
+ * @return #GNUNET_YES if the difference is now fully decoded,
+ *         #GNUNET_NO if more symbols are needed,
+ *         #GNUNET_SYSERR if the symbols are inconsistent
+ */
+enum GNUNET_GenericReturnValue
+rateless_decoder_add_symbol (struct RatelessDecoder *dec,
+                             const struct IBF_Bucket *remote);
+
+
+/**
+ * Get the number of symbols added to a decoder so far.
+ *
+ * @param dec the decoder
+ * @return number of symbols
+ */
+uint32_t
+rateless_decoder_get_count (const struct RatelessDecoder *dec);
+
+
+/**
+ * Get a decoded element of the difference.
+ *
+ * @param dec the decoder
+ * @param i index of the element
+ * @param[out] side 1 if the local set has the element, -1 if the
+ *             remote set has it
+ * @param[out] key key of the element
+ * @return #GNUNET_NO if fewer than @a i + 1 elements were decoded
+ */
+enum GNUNET_GenericReturnValue
+rateless_decoder_get_decoded (const struct RatelessDecoder *dec,
+                              unsigned int i,
+                              int *side,
+                              struct IBF_Key *key);
+
+
+/**
+ * Destroy a decoder and its encoder.
+ *
+ * @param dec decoder to destroy
+ */
+void
+rateless_decoder_destroy (struct RatelessDecoder *dec);
+
+
+#endif
@@ -346,9 +346,9 @@ strata_estimator_create (unsigned int strata_count,
  *
  * @param se1 first strata estimator
  * @param se2 second strata estimator
- * @return the estimated difference
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if out of memory
  */
-void
+int
 strata_estimator_difference (const struct MultiStrataEstimator *se1,
                              const struct MultiStrataEstimator *se2)
 {
@@ -369,10 +369,17 @@ strata_estimator_difference (const struct MultiStrataEstimator *se1,
 
       /* FIXME: implement this without always allocating new IBFs */
       diff = ibf_dup (se1->stratas[strata_ctr]->strata[i]);
+      if (NULL == diff)
+        return GNUNET_SYSERR;
       diff->local_decoded_count = 0;
       diff->remote_decoded_count = 0;
 
       ibf_subtract (diff, se2->stratas[strata_ctr]->strata[i]);
+      if (GNUNET_OK != ibf_peel_init (diff))
+      {
+        ibf_destroy (diff);
+        return GNUNET_SYSERR;
+      }
 
       for (int ibf_count = 0; GNUNET_YES; ibf_count++)
       {
@@ -413,6 +420,7 @@ break_all_counting_loops:;
                                                     / number_of_estimators;
   se1->stratas[0]->strata[0]->remote_decoded_count = avg_remote_diff
                                                      / number_of_estimators;
+  return GNUNET_OK;
 }
 
 
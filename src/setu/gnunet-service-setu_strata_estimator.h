@@ -141,9 +141,9 @@ strata_estimator_create (unsigned int strata_count,
  *
  * @param se1 first strata estimator
  * @param se2 second strata estimator
- * @return nothing
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if out of memory
  */
-void
+int
 strata_estimator_difference (const struct MultiStrataEstimator *se1,
                              const struct MultiStrataEstimator *se2);
 
@@ -35,6 +35,12 @@ static unsigned int csize = 10;
 static unsigned int hash_num = 4;
 static unsigned int ibf_size = 80;
 
+/**
+ * Measure decode throughput for large differences instead of
+ * decoding the sets given with -A/-B/-C.
+ */
+static int throughput;
+
 /* FIXME: add parameter for this */
 static enum GNUNET_CRYPTO_Quality random_quality = GNUNET_CRYPTO_QUALITY_WEAK;
 
@@ -101,6 +107,81 @@ remove_iterator (void *cls, const struct GNUNET_HashCode *key, void *value)
 }
 
 
+/**
+ * Create two IBFs whose symmetric difference has @a diff elements
+ * (plus #csize common elements) and report how fast they are
+ * subtracted and decoded.  Does not keep track of the elements,
+ * so that differences of millions of elements can be measured.
+ *
+ * @param diff number of elements in the symmetric difference
+ */
+static void
+measure_throughput (unsigned int diff)
+{
+  struct InvertibleBloomFilter *a;
+  struct InvertibleBloomFilter *b;
+  struct IBF_Key key;
+  struct GNUNET_TIME_Absolute start_time;
+  struct GNUNET_TIME_Relative subtract_time;
+  struct GNUNET_TIME_Relative decode_time;
+  unsigned int size;
+  unsigned int decoded;
+  int side;
+  int res;
+
+  size = diff / 2 * 3;
+  a = ibf_create (size, hash_num);
+  b = ibf_create (size, hash_num);
+  if ((NULL == a) || (NULL == b))
+  {
+    /* insufficient memory */
+    GNUNET_break (0);
+    if (NULL != a)
+      ibf_destroy (a);
+    if (NULL != b)
+      ibf_destroy (b);
+    return;
+  }
+  for (unsigned int i = 0; i < diff + csize; i++)
+  {
+    key.key_val = GNUNET_CRYPTO_random_u64 (random_quality,
+                                            UINT64_MAX);
+    if (i >= diff)
+    {
+      ibf_insert (a, key);
+      ibf_insert (b, key);
+    }
+    else if (0 == i % 2)
+      ibf_insert (a, key);
+    else
+      ibf_insert (b, key);
+  }
+
+  start_time = GNUNET_TIME_absolute_get ();
+  ibf_subtract (a, b);
+  subtract_time = GNUNET_TIME_absolute_get_duration (start_time);
+
+  decoded = 0;
+  start_time = GNUNET_TIME_absolute_get ();
+  while (GNUNET_YES == (res = ibf_decode (a, &side, &key)))
+    decoded++;
+  decode_time = GNUNET_TIME_absolute_get_duration (start_time);
+
+  printf ("diff=%u, size=%u: subtracted in %s, ",
+          diff,
+          size,
+          GNUNET_STRINGS_relative_time_to_string (subtract_time, GNUNET_YES));
+  printf ("decoded %u elements in %s (%llu elements/s)%s\n",
+          decoded,
+          GNUNET_STRINGS_relative_time_to_string (decode_time, GNUNET_YES),
+          (unsigned long long) decoded * 1000LL * 1000LL
+          / GNUNET_MAX (1, decode_time.rel_value_us),
+          (GNUNET_NO == res) ? "" : ", decode failed");
+  ibf_destroy (a);
+  ibf_destroy (b);
+}
+
+
 static void
 run (void *cls,
      char *const *args,
@@ -115,6 +196,16 @@ run (void *cls,
   struct GNUNET_TIME_Absolute start_time;
   struct GNUNET_TIME_Relative delta_time;
 
+  if (throughput)
+  {
+    printf ("hash-num=%u, #(A&B)=%u\n",
+            hash_num,
+            csize);
+    for (unsigned int diff = 100000; diff <= 10000000; diff *= 10)
+      measure_throughput (diff);
+    return;
+  }
+
   set_a =
     GNUNET_CONTAINER_multihashmap_create (((asize == 0) ? 1 : (asize + csize)),
                                           GNUNET_NO);
@@ -293,6 +384,12 @@ main (int argc, char **argv)
                                gettext_noop ("ibf size"),
                                &ibf_size),
 
+    GNUNET_GETOPT_option_flag ('T',
+                               "throughput",
+                               gettext_noop (
+                                 "measure decode throughput for differences of 10^5 to 10^7 elements"),
+                               &throughput),
+
     GNUNET_GETOPT_OPTION_END
   };
 
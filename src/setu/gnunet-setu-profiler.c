@@ -59,6 +59,7 @@ static struct GNUNET_PeerIdentity local_peer;
 static struct GNUNET_SETU_ListenHandle *set_listener;
 
 static int byzantine;
+static int rateless;
 static unsigned int force_delta;
 static unsigned int force_full;
 static unsigned int element_size = 32;
@@ -222,7 +223,7 @@ set_listen_cb (void *cls,
                struct GNUNET_SETU_Request *request)
 {
   /* max. 2 options plus terminator */
-  struct GNUNET_SETU_Option opts[3] = { { 0 } };
+  struct GNUNET_SETU_Option opts[4] = { { 0 } };
   unsigned int n_opts = 0;
 
   if (NULL == request)
@@ -250,6 +251,11 @@ set_listen_cb (void *cls,
     opts[n_opts++] = (struct GNUNET_SETU_Option) { .type =
                                                      GNUNET_SETU_OPTION_FORCE_DELTA };
   }
+  if (rateless)
+  {
+    opts[n_opts++] = (struct GNUNET_SETU_Option) { .type =
+                                                     GNUNET_SETU_OPTION_RATELESS };
+  }
 
   opts[n_opts].type = 0;
   info2.oh = GNUNET_SETU_accept (request,
@@ -317,7 +323,7 @@ run (void *cls,
   unsigned int i;
   struct GNUNET_HashCode hash;
   /* max. 2 options plus terminator */
-  struct GNUNET_SETU_Option opts[3] = { { 0 } };
+  struct GNUNET_SETU_Option opts[4] = { { 0 } };
   unsigned int n_opts = 0;
 
   config = cfg;
@@ -409,6 +415,11 @@ run (void *cls,
     opts[n_opts++] = (struct GNUNET_SETU_Option) { .type =
                                                      GNUNET_SETU_OPTION_FORCE_DELTA };
   }
+  if (rateless)
+  {
+    opts[n_opts++] = (struct GNUNET_SETU_Option) { .type =
+                                                     GNUNET_SETU_OPTION_RATELESS };
+  }
 
   opts[n_opts].type = 0;
 
@@ -453,6 +464,11 @@ main (int argc, char **argv)
                                gettext_noop ("use byzantine mode"),
                                &byzantine),
 
+    GNUNET_GETOPT_option_flag ('r',
+                               "rateless",
+                               gettext_noop ("reconcile with a rateless IBF"),
+                               &rateless),
+
     GNUNET_GETOPT_option_uint ('f',
                                "force-full",
                                NULL,
@@ -37,6 +37,20 @@
 #define IBF_KEY_HASH_VAL(k) (GNUNET_CRYPTO_crc32_n (&(k), sizeof(struct \
                                                                  IBF_KeyHash)))
 
+/**
+ * Alignment of the bucket array, the size of a cache line.
+ */
+#define IBF_ALIGNMENT 64
+
+
+/**
+ * A bucket seen as four 32-bit lanes: two for the key sum, one for
+ * the key hash sum and one for the count.  The compiler maps
+ * operations on it to SIMD instructions where available.
+ */
+typedef uint32_t IBF_BucketVector __attribute__ ((vector_size (16)));
+
+
 /**
  * Create a key from a hashcode.
  *
@@ -72,6 +86,27 @@ ibf_hashcode_from_key (struct IBF_Key key,
 }
 
 
+/**
+ * Allocate zeroed, cache-aligned buckets for @a ibf.
+ *
+ * @param ibf the IBF, with the size set
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if out of memory
+ */
+static int
+ibf_alloc_buckets (struct InvertibleBloomFilter *ibf)
+{
+  ibf->buckets_mem = GNUNET_malloc_large (ibf->size
+                                          * sizeof(struct IBF_Bucket)
+                                          + IBF_ALIGNMENT - 1);
+  if (NULL == ibf->buckets_mem)
+    return GNUNET_SYSERR;
+  ibf->buckets = (struct IBF_Bucket *)
+                 (((uintptr_t) ibf->buckets_mem + IBF_ALIGNMENT - 1)
+                  & ~((uintptr_t) IBF_ALIGNMENT - 1));
+  return GNUNET_OK;
+}
+
+
 /**
  * Create an invertible bloom filter.
  *
@@ -84,33 +119,19 @@ ibf_create (uint32_t size, uint8_t hash_num)
 {
   struct InvertibleBloomFilter *ibf;
 
+  /* the lanes of IBF_BucketVector must match the bucket layout */
+  GNUNET_static_assert (sizeof(struct IBF_Bucket) == sizeof(IBF_BucketVector));
+  GNUNET_static_assert (offsetof (struct IBF_Bucket, count) == 12);
   GNUNET_assert (0 != size);
 
   ibf = GNUNET_new (struct InvertibleBloomFilter);
-  ibf->count = GNUNET_malloc_large (size * sizeof(uint64_t));
-  if (NULL == ibf->count)
-  {
-    GNUNET_free (ibf);
-    return NULL;
-  }
-  ibf->key_sum = GNUNET_malloc_large (size * sizeof(struct IBF_Key));
-  if (NULL == ibf->key_sum)
-  {
-    GNUNET_free (ibf->count);
-    GNUNET_free (ibf);
-    return NULL;
-  }
-  ibf->key_hash_sum = GNUNET_malloc_large (size * sizeof(struct IBF_KeyHash));
-  if (NULL == ibf->key_hash_sum)
+  ibf->size = size;
+  ibf->hash_num = hash_num;
+  if (GNUNET_OK != ibf_alloc_buckets (ibf))
   {
-    GNUNET_free (ibf->key_sum);
-    GNUNET_free (ibf->count);
     GNUNET_free (ibf);
     return NULL;
   }
-  ibf->size = size;
-  ibf->hash_num = hash_num;
-
   return ibf;
 }
 
@@ -143,20 +164,104 @@ try_next:
 }
 
 
+/**
+ * Remember that @a bucket of @a ibf may have become pure.
+ *
+ * @param ibf the IBF
+ * @param bucket index of the bucket
+ */
+static void
+ibf_peel_push (struct InvertibleBloomFilter *ibf,
+               uint32_t bucket)
+{
+  if (0 != (ibf->peel_queued[bucket / 8] & (1 << (bucket % 8))))
+    return;
+  GNUNET_assert (ibf->peel_len < ibf->size);
+  ibf->peel_queued[bucket / 8] |= (1 << (bucket % 8));
+  ibf->peel_queue[(ibf->peel_head + ibf->peel_len) % ibf->size] = bucket;
+  ibf->peel_len++;
+}
+
+
+/**
+ * Take the next bucket to look at from the peel queue of @a ibf.
+ *
+ * @param ibf the IBF, with a non-empty peel queue
+ * @return index of the bucket
+ */
+static uint32_t
+ibf_peel_pop (struct InvertibleBloomFilter *ibf)
+{
+  uint32_t bucket;
+
+  GNUNET_assert (0 != ibf->peel_len);
+  bucket = ibf->peel_queue[ibf->peel_head];
+  ibf->peel_head = (ibf->peel_head + 1) % ibf->size;
+  ibf->peel_len--;
+  ibf->peel_queued[bucket / 8] &= ~(1 << (bucket % 8));
+  return bucket;
+}
+
+
+/**
+ * Fill the peel queue of @a ibf with all buckets that may be pure.
+ *
+ * @param ibf the IBF
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if out of memory
+ */
+int
+ibf_peel_init (struct InvertibleBloomFilter *ibf)
+{
+  if (NULL == ibf->peel_queue)
+  {
+    ibf->peel_queue = GNUNET_malloc_large (ibf->size * sizeof(uint32_t));
+    ibf->peel_queued = GNUNET_malloc_large ((ibf->size + 7) / 8);
+    if ((NULL == ibf->peel_queue) ||
+        (NULL == ibf->peel_queued))
+    {
+      GNUNET_free (ibf->peel_queue);
+      GNUNET_free (ibf->peel_queued);
+      return GNUNET_SYSERR;
+    }
+  }
+  else
+  {
+    memset (ibf->peel_queued,
+            0,
+            (ibf->size + 7) / 8);
+  }
+  ibf->peel_head = 0;
+  ibf->peel_len = 0;
+  for (uint32_t i = 0; i < ibf->size; i++)
+    if ((1 == ibf->buckets[i].count) ||
+        (-1 == ibf->buckets[i].count))
+      ibf_peel_push (ibf,
+                     i);
+  ibf->peel_ready = GNUNET_YES;
+  return GNUNET_OK;
+}
+
+
 static void
 ibf_insert_into (struct InvertibleBloomFilter *ibf,
                  struct IBF_Key key,
                  const int *buckets,
                  int side)
 {
+  const uint32_t key_hash = IBF_KEY_HASH_VAL (key);
+
   for (unsigned int i = 0; i < ibf->hash_num; i++)
   {
-    const int bucket = buckets[i];
-
-    ibf->count[bucket].count_val += side;
-    ibf->key_sum[bucket].key_val ^= key.key_val;
-    ibf->key_hash_sum[bucket].key_hash_val
-      ^= IBF_KEY_HASH_VAL (key);
+    struct IBF_Bucket *b = &ibf->buckets[buckets[i]];
+
+    b->count += side;
+    b->key_sum.key_val ^= key.key_val;
+    b->key_hash_sum.key_hash_val ^= key_hash;
+    if ((GNUNET_YES == ibf->peel_ready) &&
+        ((1 == b->count) ||
+         (-1 == b->count)))
+      ibf_peel_push (ibf,
+                     buckets[i]);
   }
 }
 
@@ -201,23 +306,29 @@ ibf_remove (struct InvertibleBloomFilter *ibf,
  * Test is the IBF is empty, i.e. all counts, keys and key hashes are zero.
  */
 static int
-ibf_is_empty (struct InvertibleBloomFilter *ibf)
+ibf_is_empty (const struct InvertibleBloomFilter *ibf)
 {
+  IBF_BucketVector acc = { 0, 0, 0, 0 };
+
   for (uint32_t i = 0; i < ibf->size; i++)
   {
-    if (0 != ibf->count[i].count_val)
-      return GNUNET_NO;
-    if (0 != ibf->key_hash_sum[i].key_hash_val)
-      return GNUNET_NO;
-    if (0 != ibf->key_sum[i].key_val)
-      return GNUNET_NO;
+    IBF_BucketVector v;
+
+    memcpy (&v,
+            &ibf->buckets[i],
+            sizeof(v));
+    acc |= v;
   }
+  if (0 != (acc[0] | acc[1] | acc[2] | acc[3]))
+    return GNUNET_NO;
   return GNUNET_YES;
 }
 
 
 /**
  * Decode and remove an element from the IBF, if possible.
+ * Remembers which buckets changed, so that decoding all elements
+ * takes time linear in the number of elements and buckets.
  *
  * @param ibf the invertible bloom filter to decode
  * @param ret_side sign of the cell's count where the decoded element came from.
@@ -236,25 +347,32 @@ ibf_decode (struct InvertibleBloomFilter *ibf,
   struct IBF_KeyHash hash;
   int buckets[ibf->hash_num];
 
-  for (uint32_t i = 0; i < ibf->size; i++)
+  if ((GNUNET_YES != ibf->peel_ready) &&
+      (GNUNET_OK != ibf_peel_init (ibf)))
+    return GNUNET_SYSERR;
+  while (0 != ibf->peel_len)
   {
+    uint32_t i = ibf_peel_pop (ibf);
+    const struct IBF_Bucket *b = &ibf->buckets[i];
+    struct IBF_Key key;
+    int side;
     int hit;
 
     /* we can only decode from pure buckets */
-    if ( (1 != ibf->count[i].count_val) &&
-         (-1 != ibf->count[i].count_val) )
+    if ( (1 != b->count) &&
+         (-1 != b->count) )
       continue;
 
-    hash.key_hash_val = IBF_KEY_HASH_VAL (ibf->key_sum[i]);
+    hash.key_hash_val = IBF_KEY_HASH_VAL (b->key_sum);
 
     /* test if the hash matches the key */
-    if (hash.key_hash_val != ibf->key_hash_sum[i].key_hash_val)
+    if (hash.key_hash_val != b->key_hash_sum.key_hash_val)
       continue;
 
     /* test if key in bucket hits its own location,
      * if not, the key hash was subject to collision */
     hit = GNUNET_NO;
-    ibf_get_indices (ibf, ibf->key_sum[i], buckets);
+    ibf_get_indices (ibf, b->key_sum, buckets);
     for (int j = 0; j < ibf->hash_num; j++)
       if (buckets[j] == i)
         hit = GNUNET_YES;
@@ -262,7 +380,9 @@ ibf_decode (struct InvertibleBloomFilter *ibf,
     if (GNUNET_NO == hit)
       continue;
 
-    if (1 == ibf->count[i].count_val)
+    side = b->count;
+    key = b->key_sum;
+    if (1 == side)
     {
       ibf->remote_decoded_count++;
     }
@@ -273,12 +393,12 @@ ibf_decode (struct InvertibleBloomFilter *ibf,
 
 
     if (NULL != ret_side)
-      *ret_side = ibf->count[i].count_val;
+      *ret_side = side;
     if (NULL != ret_id)
-      *ret_id = ibf->key_sum[i];
+      *ret_id = key;
 
     /* insert on the opposite side, effectively removing the element */
-    ibf_insert_into (ibf, ibf->key_sum[i], buckets, -ibf->count[i].count_val);
+    ibf_insert_into (ibf, key, buckets, -side);
 
     return GNUNET_YES;
   }
@@ -297,15 +417,14 @@ ibf_decode (struct InvertibleBloomFilter *ibf,
 uint8_t
 ibf_get_max_counter (struct InvertibleBloomFilter *ibf)
 {
-  long long max_counter = 0;
-  for (uint64_t i = 0; i < ibf->size; i++)
-  {
-    if (ibf->count[i].count_val > max_counter)
-    {
-      max_counter = ibf->count[i].count_val;
-    }
-  }
-  return 64 - __builtin_clzll (max_counter);
+  int32_t max_counter = 0;
+
+  for (uint32_t i = 0; i < ibf->size; i++)
+    if (ibf->buckets[i].count > max_counter)
+      max_counter = ibf->buckets[i].count;
+  if (0 == max_counter)
+    return 0;
+  return 64 - __builtin_clzll ((unsigned long long) max_counter);
 }
 
 
@@ -333,15 +452,13 @@ ibf_write_slice (const struct InvertibleBloomFilter *ibf,
 
   /* copy keys */
   key_dst = (struct IBF_Key *) buf;
-  GNUNET_memcpy (key_dst,
-                 ibf->key_sum + start,
-                 count * sizeof(*key_dst));
+  for (uint64_t i = 0; i < count; i++)
+    key_dst[i] = ibf->buckets[start + i].key_sum;
   key_dst += count;
   /* copy key hashes */
   key_hash_dst = (struct IBF_KeyHash *) key_dst;
-  GNUNET_memcpy (key_hash_dst,
-                 ibf->key_hash_sum + start,
-                 count * sizeof(*key_hash_dst));
+  for (uint64_t i = 0; i < count; i++)
+    key_hash_dst[i] = ibf->buckets[start + i].key_hash_sum;
   key_hash_dst += count;
 
   /* pack and copy counter */
@@ -372,59 +489,33 @@ pack_counter (const struct InvertibleBloomFilter *ibf,
               uint8_t *buf,
               uint8_t counter_max_length)
 {
-  uint8_t store_size = 0;
-  uint8_t store = 0;
-  uint16_t byte_ctr = 0;
+  const uint64_t mask = (1ULL << counter_max_length) - 1;
+  uint64_t store = 0;
+  unsigned int store_size = 0;
+  uint64_t byte_ctr = 0;
 
+  GNUNET_assert (counter_max_length <= IBF_MAX_COUNTER_LENGTH);
   /**
-  * Iterate over IBF bucket
+  * Append the counters to a bit accumulator, most significant
+  * bit first, and flush it a byte at a time
   */
-  for (uint64_t i = start; i< (count + start);)
+  for (uint64_t i = start; i < count + start; i++)
   {
-    uint64_t count_val_to_write = ibf->count[i].count_val;
-    uint8_t count_len_to_write = counter_max_length;
-
-    /**
-    * Pack and compose counters to byte values
-    */
-    while ((count_len_to_write + store_size) >= 8)
+    store = (store << counter_max_length)
+            | ((uint64_t) (uint32_t) ibf->buckets[i].count & mask);
+    store_size += counter_max_length;
+    while (store_size >= 8)
     {
-      uint8_t bit_shift = 0;
-
-      /**
-      * Shift bits if more than a byte has to be written
-       * or the store size is not empty
-      */
-      if ((store_size > 0) || (count_len_to_write > 8))
-      {
-        uint8_t bit_unused = 8 - store_size;
-        bit_shift = count_len_to_write - bit_unused;
-        store = store << bit_unused;
-      }
-
-      buf[byte_ctr] = ((count_val_to_write >> bit_shift) | store) & 0xFF;
-      byte_ctr++;
-      count_len_to_write -= (8 - store_size);
-      count_val_to_write = count_val_to_write & ((1ULL <<
-                                                  count_len_to_write) - 1);
-      store = 0;
-      store_size = 0;
+      store_size -= 8;
+      buf[byte_ctr++] = (uint8_t) (store >> store_size);
     }
-    store = (store << count_len_to_write) | count_val_to_write;
-    store_size = store_size + count_len_to_write;
-    count_len_to_write = 0;
-    i++;
   }
 
   /**
   * Pack data left in story before finishing
   */
   if (store_size > 0)
-  {
-    buf[byte_ctr] = store << (8 - store_size);
-    byte_ctr++;
-  }
-
+    buf[byte_ctr] = (uint8_t) (store << (8 - store_size));
 }
 
 
@@ -445,67 +536,25 @@ unpack_counter (const struct InvertibleBloomFilter *ibf,
                 uint8_t *buf,
                 uint8_t counter_max_length)
 {
-  uint64_t ibf_counter_ctr = 0;
+  const uint64_t mask = (1ULL << counter_max_length) - 1;
   uint64_t store = 0;
-  uint64_t store_bit_ctr = 0;
+  unsigned int store_size = 0;
   uint64_t byte_ctr = 0;
 
+  GNUNET_assert (counter_max_length <= IBF_MAX_COUNTER_LENGTH);
   /**
-  * Iterate over received bytes
+  * Refill the bit accumulator a byte at a time and take the
+  * counters from its most significant bits
   */
-  while (true)
+  for (uint64_t i = start; i < count + start; i++)
   {
-    uint8_t byte_read = buf[byte_ctr];
-    uint8_t bit_to_read_left = 8;
-    byte_ctr++;
-
-    /**
-    * Pack data left in story before finishing
-    */
-    while (true)
+    while (store_size < counter_max_length)
     {
-      /**
-       * Stop decoding when end is reached
-       */
-      if (ibf_counter_ctr > (count - 1))
-        return;
-
-      /*
-       * Unpack the counter
-       */
-      if ((store_bit_ctr + bit_to_read_left) >= counter_max_length)
-      {
-        uint8_t bytes_used = counter_max_length - store_bit_ctr;
-        if (store_bit_ctr > 0)
-        {
-          store = store << bytes_used;
-        }
-
-        uint8_t bytes_to_shift = bit_to_read_left - bytes_used;
-        uint64_t counter_part = byte_read >> bytes_to_shift;
-        store = store | counter_part;
-        ibf->count[ibf_counter_ctr + start].count_val = store;
-        byte_read = byte_read & ((1 << bytes_to_shift) - 1);
-        bit_to_read_left -= bytes_used;
-        ibf_counter_ctr++;
-        store = 0;
-        store_bit_ctr = 0;
-      }
-      else
-      {
-        store_bit_ctr += bit_to_read_left;
-        if (0 == store)
-        {
-          store = byte_read;
-        }
-        else
-        {
-          store = store << bit_to_read_left;
-          store = store | byte_read;
-        }
-        break;
-      }
+      store = (store << 8) | buf[byte_ctr++];
+      store_size += 8;
     }
+    store_size -= counter_max_length;
+    ibf->buckets[i].count = (int32_t) (uint32_t) ((store >> store_size) & mask);
   }
 }
 
@@ -526,29 +575,30 @@ ibf_read_slice (const void *buf,
                 struct InvertibleBloomFilter *ibf,
                 uint8_t counter_max_length)
 {
-  struct IBF_Key *key_src;
-  struct IBF_KeyHash *key_hash_src;
-  struct IBF_Count *count_src;
+  const struct IBF_Key *key_src;
+  const struct IBF_KeyHash *key_hash_src;
 
   GNUNET_assert (count > 0);
   GNUNET_assert (start + count <= ibf->size);
 
+  ibf->peel_ready = GNUNET_NO;
   /* copy keys */
-  key_src = (struct IBF_Key *) buf;
-  GNUNET_memcpy (ibf->key_sum + start,
-                 key_src,
-                 count * sizeof *key_src);
+  key_src = (const struct IBF_Key *) buf;
+  for (uint64_t i = 0; i < count; i++)
+    ibf->buckets[start + i].key_sum = key_src[i];
   key_src += count;
   /* copy key hashes */
-  key_hash_src = (struct IBF_KeyHash *) key_src;
-  GNUNET_memcpy (ibf->key_hash_sum + start,
-                 key_hash_src,
-                 count * sizeof *key_hash_src);
+  key_hash_src = (const struct IBF_KeyHash *) key_src;
+  for (uint64_t i = 0; i < count; i++)
+    ibf->buckets[start + i].key_hash_sum = key_hash_src[i];
   key_hash_src += count;
 
   /* copy and unpack counts  */
-  count_src = (struct IBF_Count *) key_hash_src;
-  unpack_counter (ibf,start,count,(uint8_t *) count_src,counter_max_length);
+  unpack_counter (ibf,
+                  start,
+                  count,
+                  (uint8_t *) key_hash_src,
+                  counter_max_length);
 }
 
 
@@ -563,14 +613,28 @@ void
 ibf_subtract (struct InvertibleBloomFilter *ibf1,
               const struct InvertibleBloomFilter *ibf2)
 {
+  /* the count is subtracted, the other lanes are xor-ed */
+  const IBF_BucketVector count_lane = { 0, 0, 0, UINT32_MAX };
+
   GNUNET_assert (ibf1->size == ibf2->size);
   GNUNET_assert (ibf1->hash_num == ibf2->hash_num);
 
+  ibf1->peel_ready = GNUNET_NO;
   for (uint32_t i = 0; i < ibf1->size; i++)
   {
-    ibf1->count[i].count_val -= ibf2->count[i].count_val;
-    ibf1->key_hash_sum[i].key_hash_val ^= ibf2->key_hash_sum[i].key_hash_val;
-    ibf1->key_sum[i].key_val ^= ibf2->key_sum[i].key_val;
+    IBF_BucketVector a;
+    IBF_BucketVector b;
+
+    memcpy (&a,
+            &ibf1->buckets[i],
+            sizeof(a));
+    memcpy (&b,
+            &ibf2->buckets[i],
+            sizeof(b));
+    a = ((a ^ b) & ~count_lane) | ((a - b) & count_lane);
+    memcpy (&ibf1->buckets[i],
+            &a,
+            sizeof(a));
   }
 }
 
@@ -579,6 +643,7 @@ ibf_subtract (struct InvertibleBloomFilter *ibf1,
  * Create a copy of an IBF, the copy has to be destroyed properly.
  *
  * @param ibf the IBF to copy
+ * @return the copy, NULL if out of memory
  */
 struct InvertibleBloomFilter *
 ibf_dup (const struct InvertibleBloomFilter *ibf)
@@ -588,12 +653,14 @@ ibf_dup (const struct InvertibleBloomFilter *ibf)
   copy = GNUNET_malloc (sizeof *copy);
   copy->hash_num = ibf->hash_num;
   copy->size = ibf->size;
-  copy->key_hash_sum = GNUNET_memdup (ibf->key_hash_sum,
-                                      ibf->size * sizeof(struct IBF_KeyHash));
-  copy->key_sum = GNUNET_memdup (ibf->key_sum,
-                                 ibf->size * sizeof(struct IBF_Key));
-  copy->count = GNUNET_memdup (ibf->count,
-                               ibf->size * sizeof(struct IBF_Count));
+  if (GNUNET_OK != ibf_alloc_buckets (copy))
+  {
+    GNUNET_free (copy);
+    return NULL;
+  }
+  GNUNET_memcpy (copy->buckets,
+                 ibf->buckets,
+                 ibf->size * sizeof(struct IBF_Bucket));
   return copy;
 }
 
@@ -607,8 +674,8 @@ ibf_dup (const struct InvertibleBloomFilter *ibf)
 void
 ibf_destroy (struct InvertibleBloomFilter *ibf)
 {
-  GNUNET_free (ibf->key_sum);
-  GNUNET_free (ibf->key_hash_sum);
-  GNUNET_free (ibf->count);
+  GNUNET_free (ibf->buckets_mem);
+  GNUNET_free (ibf->peel_queue);
+  GNUNET_free (ibf->peel_queued);
   GNUNET_free (ibf);
 }
@@ -59,7 +59,7 @@ struct IBF_KeyHash
 
 
 /**
- * Type of the count field of IBF buckets.
+ * Type of the count field of IBF buckets on the wire.
  */
 struct IBF_Count
 {
@@ -68,12 +68,44 @@ struct IBF_Count
 
 
 /**
- * Size of one ibf bucket in bytes
+ * Size of one ibf bucket in bytes, as transmitted
  */
 #define IBF_BUCKET_SIZE (sizeof(struct IBF_Count) + sizeof(struct IBF_Key)   \
                          + sizeof(struct IBF_KeyHash))
 
 
+/**
+ * Maximum bit length of a packed counter.  Counts are kept in 32
+ * bits in memory, so an IBF cannot hold more than 2^31 elements.
+ */
+#define IBF_MAX_COUNTER_LENGTH 32
+
+
+/**
+ * Bucket of an IBF.  Buckets are 16 bytes, so that four of them
+ * fit into a cache line and all fields of a bucket can be combined
+ * with another bucket by a single vector operation.
+ */
+struct IBF_Bucket
+{
+  /**
+   * Xor sum of the keys of the elements in the bucket.
+   */
+  struct IBF_Key key_sum;
+
+  /**
+   * Xor sum of the hashes of the keys of the elements in the bucket.
+   */
+  struct IBF_KeyHash key_hash_sum;
+
+  /**
+   * How many times has the bucket been hit?
+   * Can be negative, as a result of IBF subtraction.
+   */
+  int32_t count;
+};
+
+
 /**
  * Invertible bloom filter (IBF).
  *
@@ -108,23 +140,42 @@ struct InvertibleBloomFilter
   int remote_decoded_count;
 
   /**
-   * Xor sums of the elements' keys, used to identify the elements.
-   * Array of 'size' elements.
+   * The buckets, aligned to a cache line.  Array of 'size' elements.
    */
-  struct IBF_Key *key_sum;
+  struct IBF_Bucket *buckets;
 
   /**
-   * Xor sums of the hashes of the keys of inserted elements.
-   * Array of 'size' elements.
+   * Allocation @e buckets points into.
    */
-  struct IBF_KeyHash *key_hash_sum;
+  void *buckets_mem;
 
   /**
-   * How many times has a bucket been hit?
-   * Can be negative, as a result of IBF subtraction.
-   * Array of 'size' elements.
+   * Ring buffer of buckets #ibf_decode() has to look at, because
+   * they may have become pure since it last looked at them.
+   * Array of 'size' elements, allocated by the first #ibf_decode().
    */
-  struct IBF_Count *count;
+  uint32_t *peel_queue;
+
+  /**
+   * Bitmap of the buckets that are in @e peel_queue.
+   */
+  uint8_t *peel_queued;
+
+  /**
+   * Index of the first entry in @e peel_queue.
+   */
+  uint32_t peel_head;
+
+  /**
+   * Number of entries in @e peel_queue.
+   */
+  uint32_t peel_len;
+
+  /**
+   * #GNUNET_YES if every bucket that may be pure is in @e peel_queue.
+   * Reset by operations that change many buckets at once.
+   */
+  int peel_ready;
 };
 
 
@@ -225,8 +276,22 @@ ibf_subtract (struct InvertibleBloomFilter *ibf1,
               const struct InvertibleBloomFilter *ibf2);
 
 
+/**
+ * Prepare @a ibf for decoding.  #ibf_decode() does this itself if
+ * needed; call it first to tell running out of memory apart from
+ * a failed decoding.
+ *
+ * @param ibf the IBF
+ * @return #GNUNET_OK on success, #GNUNET_SYSERR if out of memory
+ */
+int
+ibf_peel_init (struct InvertibleBloomFilter *ibf);
+
+
 /**
  * Decode and remove an element from the IBF, if possible.
+ * Remembers which buckets changed, so that decoding all elements
+ * takes time linear in the number of elements and buckets.
  *
  * @param ibf the invertible bloom filter to decode
  * @param ret_side sign of the cell's count where the decoded element came from.
@@ -247,6 +312,7 @@ ibf_decode (struct InvertibleBloomFilter *ibf,
  * Create a copy of an IBF, the copy has to be destroyed properly.
  *
  * @param ibf the IBF to copy
+ * @return the copy, NULL if out of memory
  */
 struct InvertibleBloomFilter *
 ibf_dup (const struct InvertibleBloomFilter *ibf);
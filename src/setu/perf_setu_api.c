@@ -52,6 +52,26 @@ static int ret;
 
 static struct GNUNET_SCHEDULER_Task *tt;
 
+/**
+ * #GNUNET_YES to reconcile with a rateless IBF.
+ */
+static int rateless;
+
+/**
+ * Options for the set operations with the IBF protocol.
+ */
+static struct GNUNET_SETU_Option ibf_options[] = {
+  { .type = GNUNET_SETU_OPTION_END }
+};
+
+/**
+ * Options for the set operations with the rateless IBF protocol.
+ */
+static struct GNUNET_SETU_Option rateless_options[] = {
+  { .type = GNUNET_SETU_OPTION_RATELESS },
+  { .type = GNUNET_SETU_OPTION_END }
+};
+
 
 /**
  * Handles configuration file for setu performance test
@@ -156,7 +176,7 @@ listen_cb (void *cls,
   GNUNET_assert (ntohs (context_msg->type) == GNUNET_MESSAGE_TYPE_DUMMY);
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "listen cb called\n");
   oh2 = GNUNET_SETU_accept (request,
-                            (struct GNUNET_SETU_Option[]){ 0 },
+                            rateless ? rateless_options : ibf_options,
                             &result_cb_set2,
                             NULL);
   GNUNET_SETU_commit (oh2, set2);
@@ -183,7 +203,7 @@ start (void *cls)
   oh1 = GNUNET_SETU_prepare (&local_id,
                              &app_id,
                              &context_msg,
-                             (struct GNUNET_SETU_Option[]){ 0 },
+                             rateless ? rateless_options : ibf_options,
                              &result_cb_set1,
                              NULL);
   GNUNET_SETU_commit (oh1, set1);
@@ -453,7 +473,20 @@ execute_perf ()
         GNUNET_log (
           GNUNET_ERROR_TYPE_ERROR,
           _ ("Failed to write subsystem default identifier map'.\n"));
-      run_petf_thread (100);
+      /* compare the IBF protocol with the rateless one */
+      for (rateless = GNUNET_NO; rateless <= GNUNET_YES; rateless++)
+      {
+        struct GNUNET_TIME_Absolute start_time;
+
+        start_time = GNUNET_TIME_absolute_get ();
+        run_petf_thread (100);
+        fprintf (stdout,
+                 "%s: 100 runs took %s\n",
+                 rateless ? "rateless IBF" : "IBF",
+                 GNUNET_STRINGS_relative_time_to_string (
+                   GNUNET_TIME_absolute_get_duration (start_time),
+                   GNUNET_NO));
+      }
     }
 
   }
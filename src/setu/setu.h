@@ -245,6 +245,11 @@ struct GNUNET_SETU_EvaluateMessage
    */
   uint8_t symmetric;
 
+  /**
+   * #GNUNET_YES to reconcile with a rateless IBF.
+   */
+  uint8_t rateless;
+
   /**
    * Lower bound for the set size, used only when
    * byzantine mode is enabled.
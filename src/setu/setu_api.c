@@ -564,6 +564,9 @@ GNUNET_SETU_prepare (const struct GNUNET_PeerIdentity *other_peer,
     case GNUNET_SETU_OPTION_SYMMETRIC:
       msg->symmetric = GNUNET_YES;
       break;
+    case GNUNET_SETU_OPTION_RATELESS:
+      msg->rateless = GNUNET_YES;
+      break;
     default:
       LOG (GNUNET_ERROR_TYPE_ERROR,
            "Option with type %d not recognized\n",
@@ -845,6 +848,9 @@ GNUNET_SETU_accept (struct GNUNET_SETU_Request *request,
     case GNUNET_SETU_OPTION_SYMMETRIC:
       msg->symmetric = GNUNET_YES;
       break;
+    case GNUNET_SETU_OPTION_RATELESS:
+      /* chosen by the initiating peer */
+      break;
     default:
       LOG (GNUNET_ERROR_TYPE_ERROR,
            "Option with type %d not recognized\n",
@@ -79,6 +79,11 @@
  */
 #define REKEY_MAX_BYTES (1024LLU * 1024 * 1024 * 4LLU)
 
+/**
+ * Maximum number of threads for encrypting and decrypting.
+ */
+#define MAX_CRYPTO_WORKERS 16
+
 /**
  * Size of the initial key exchange message sent first in both
  * directions.
@@ -478,12 +483,12 @@ struct Queue
   unsigned long long bytes_in_queue;
 
   /**
-   * Buffer for reading ciphertext from network into.
+   * Ring buffer for reading ciphertext from network into.
    */
   char cread_buf[BUF_SIZE];
 
   /**
-   * buffer for writing ciphertext to network.
+   * Ring buffer for writing ciphertext to network.
    */
   char cwrite_buf[BUF_SIZE];
 
@@ -498,14 +503,26 @@ struct Queue
   char pwrite_buf[UINT16_MAX + 1 + sizeof(struct TCPBox)];
 
   /**
-   * At which offset in the ciphertext read buffer should we
-   * append more ciphertext for transmission next?
+   * Offset of the first byte of ciphertext in the read ring buffer
+   * that we have not yet decrypted.
+   */
+  size_t cread_start;
+
+  /**
+   * How many bytes of ciphertext are in the read ring buffer,
+   * starting at @e cread_start?
    */
   size_t cread_off;
 
   /**
-   * At which offset in the ciphertext write buffer should we
-   * append more ciphertext from reading next?
+   * Offset of the first byte of ciphertext in the write ring buffer
+   * that we have not yet transmitted.
+   */
+  size_t cwrite_start;
+
+  /**
+   * How many bytes of ciphertext are in the write ring buffer,
+   * starting at @e cwrite_start?
    */
   size_t cwrite_off;
 
@@ -623,6 +640,74 @@ struct Queue
    * Store Context for retrieving the monotonic time send with the handshake ack.
    */
   struct GNUNET_PEERSTORE_StoreContext *handshake_ack_monotime_sc;
+
+  /**
+   * How many bytes of plaintext boxes follow the ciphertext in the
+   * write ring buffer, waiting to be MACed and encrypted by a crypto
+   * worker?
+   */
+  size_t cplain_off;
+
+  /**
+   * Offset in the write ring buffer of the first box of the current
+   * encryption job.
+   */
+  size_t crypto_out_tail;
+
+  /**
+   * Number of bytes of plaintext the current encryption job covers.
+   */
+  size_t crypto_out_size;
+
+  /**
+   * Encryption job with the crypto workers, NULL for none.  While
+   * set, the worker owns @e out_cipher, @e out_hmac, @e crypto_out_md
+   * and the part of the write ring buffer the job covers.
+   */
+  struct GNUNET_THREAD_Job *crypto_out_job;
+
+  /**
+   * HMAC context for the encryption jobs, opened with the first job.
+   */
+  gcry_md_hd_t crypto_out_md;
+
+  /**
+   * How many bytes at the start of the read ring buffer did the
+   * crypto workers already decrypt in place?
+   */
+  size_t cread_plain;
+
+  /**
+   * How many bytes at the start of the read ring buffer form complete
+   * decrypted messages (with verified HMAC, for boxes)?
+   */
+  size_t cread_ready;
+
+  /**
+   * Number of bytes at the start of the read ring buffer the current
+   * decryption job may look at.
+   */
+  size_t crypto_in_avail;
+
+  /**
+   * #GNUNET_YES if the last decryption job stopped at a message that
+   * is not a box, #GNUNET_SYSERR if it found a malformed message or a
+   * wrong HMAC, #GNUNET_NO otherwise.
+   */
+  int crypto_in_status;
+
+  /**
+   * Decryption job with the crypto workers, NULL for none.  While
+   * set, the worker owns @e in_cipher, @e in_hmac, @e crypto_in_md,
+   * @e cread_plain, @e cread_ready, @e crypto_in_status and the first
+   * @e crypto_in_avail bytes of the read ring buffer.
+   */
+  struct GNUNET_THREAD_Job *crypto_in_job;
+
+  /**
+   * HMAC context for the decryption jobs, opened with the first job.
+   */
+  gcry_md_hd_t crypto_in_md;
 };
 
 
@@ -845,6 +930,12 @@ size_t unverified_size;
  */
 static struct GNUNET_PEERSTORE_Handle *peerstore;
 
+/**
+ * Threads encrypting and MACing outgoing boxes and verifying and
+ * decrypting incoming ones, NULL if we do that in the main thread.
+ */
+static struct GNUNET_THREAD_Pool *crypto_pool;
+
 /**
  * A flag indicating we are already doing a shutdown.
  */
@@ -865,6 +956,315 @@ unsigned int bind_port;
 static void
 listen_cb (void *cls);
 
+/**
+ * Copy @a size bytes starting at offset @a off (modulo #BUF_SIZE) of
+ * the ring buffer @a ring to @a out.
+ *
+ * @param ring ring buffer of #BUF_SIZE bytes
+ * @param off offset of the first byte to copy
+ * @param[out] out where to copy to
+ * @param size number of bytes to copy
+ */
+static void
+ring_read (const char *ring,
+           size_t off,
+           void *out,
+           size_t size)
+{
+  size_t first;
+
+  off %= BUF_SIZE;
+  first = GNUNET_MIN (size, BUF_SIZE - off);
+  memcpy (out, &ring[off], first);
+  memcpy ((char *) out + first, ring, size - first);
+}
+
+
+/**
+ * Copy @a size bytes from @a in to offset @a off (modulo #BUF_SIZE)
+ * of the ring buffer @a ring.
+ *
+ * @param ring ring buffer of #BUF_SIZE bytes
+ * @param off offset of the first byte to write
+ * @param in what to copy
+ * @param size number of bytes to copy
+ */
+static void
+ring_write (char *ring,
+            size_t off,
+            const void *in,
+            size_t size)
+{
+  size_t first;
+
+  off %= BUF_SIZE;
+  first = GNUNET_MIN (size, BUF_SIZE - off);
+  memcpy (&ring[off], in, first);
+  memcpy (ring, (const char *) in + first, size - first);
+}
+
+
+/**
+ * Encrypt or decrypt @a size bytes starting at offset @a off (modulo
+ * #BUF_SIZE) of the ring buffer @a ring in place.
+ *
+ * @param cipher cipher to use
+ * @param decrypt #GNUNET_YES to decrypt, #GNUNET_NO to encrypt
+ * @param ring ring buffer of #BUF_SIZE bytes
+ * @param off offset of the first byte to transform
+ * @param size number of bytes to transform
+ */
+static void
+ring_crypt (gcry_cipher_hd_t cipher,
+            int decrypt,
+            char *ring,
+            size_t off,
+            size_t size)
+{
+  size_t first;
+
+  off %= BUF_SIZE;
+  first = GNUNET_MIN (size, BUF_SIZE - off);
+  /* CTR mode is a stream cipher, so we can simply split at the
+     end of the ring */
+  if (GNUNET_YES == decrypt)
+  {
+    GNUNET_assert (0 ==
+                   gcry_cipher_decrypt (cipher, &ring[off], first, NULL, 0));
+    if (first < size)
+      GNUNET_assert (0 ==
+                     gcry_cipher_decrypt (cipher, ring, size - first, NULL, 0));
+  }
+  else
+  {
+    GNUNET_assert (0 ==
+                   gcry_cipher_encrypt (cipher, &ring[off], first, NULL, 0));
+    if (first < size)
+      GNUNET_assert (0 ==
+                     gcry_cipher_encrypt (cipher, ring, size - first, NULL, 0));
+  }
+}
+
+
+/**
+ * Compute the HMAC over @a size bytes starting at offset @a off
+ * (modulo #BUF_SIZE) of the ring buffer @a ring, and ratchet the
+ * @a hmac_secret.  Same as #calculate_hmac(), but with an HMAC
+ * context of our own, as #GNUNET_CRYPTO_hmac_raw() may not be used
+ * by the crypto workers.
+ *
+ * @param md HMAC context to use
+ * @param[in,out] hmac_secret secret for HMAC calculation
+ * @param ring ring buffer of #BUF_SIZE bytes
+ * @param off offset of the first byte to MAC
+ * @param size number of bytes to MAC
+ * @param smac[out] where to write the HMAC
+ */
+static void
+ring_hmac (gcry_md_hd_t md,
+           struct GNUNET_HashCode *hmac_secret,
+           const char *ring,
+           size_t off,
+           size_t size,
+           struct GNUNET_ShortHashCode *smac)
+{
+  const unsigned char *mc;
+  size_t first;
+
+  off %= BUF_SIZE;
+  first = GNUNET_MIN (size, BUF_SIZE - off);
+  gcry_md_reset (md);
+  gcry_md_setkey (md,
+                  hmac_secret,
+                  sizeof(struct GNUNET_HashCode));
+  gcry_md_write (md, &ring[off], first);
+  gcry_md_write (md, ring, size - first);
+  mc = gcry_md_read (md, GCRY_MD_SHA512);
+  GNUNET_assert (NULL != mc);
+  /* truncate to `struct GNUNET_ShortHashCode` */
+  memcpy (smac, mc, sizeof(struct GNUNET_ShortHashCode));
+  /* ratchet hmac key */
+  GNUNET_CRYPTO_hash (hmac_secret,
+                      sizeof(struct GNUNET_HashCode),
+                      hmac_secret);
+}
+
+
+/**
+ * Open the HMAC context @a md of a crypto worker job if necessary.
+ *
+ * @param[in,out] md HMAC context
+ */
+static void
+crypto_md_open (gcry_md_hd_t *md)
+{
+  if (NULL != *md)
+    return;
+  GNUNET_assert (GPG_ERR_NO_ERROR ==
+                 gcry_md_open (md,
+                               GCRY_MD_SHA512,
+                               GCRY_MD_FLAG_HMAC));
+}
+
+
+/**
+ * We have been notified that our socket is ready to write.
+ * Then reschedule this function to be called again once more is available.
+ *
+ * @param cls a `struct Queue`
+ */
+static void
+queue_write (void *cls);
+
+
+/**
+ * MAC and encrypt the boxes the current job of a queue covers in the
+ * write ring buffer in place.  Run by a crypto worker, must not use
+ * the scheduler, logging or any other non-reentrant GNUnet API.
+ *
+ * @param cls the `struct Queue`
+ */
+static void
+crypto_encrypt (void *cls)
+{
+  struct Queue *queue = cls;
+  size_t off = 0;
+
+  while (off < queue->crypto_out_size)
+  {
+    struct TCPBox box;
+    size_t pos = queue->crypto_out_tail + off;
+
+    ring_read (queue->cwrite_buf, pos, &box, sizeof(box));
+    ring_hmac (queue->crypto_out_md,
+               &queue->out_hmac,
+               queue->cwrite_buf,
+               pos + sizeof(box),
+               ntohs (box.header.size),
+               &box.hmac);
+    ring_write (queue->cwrite_buf, pos, &box, sizeof(box));
+    off += sizeof(box) + ntohs (box.header.size);
+  }
+  GNUNET_assert (off == queue->crypto_out_size);
+  ring_crypt (queue->out_cipher,
+              GNUNET_NO,
+              queue->cwrite_buf,
+              queue->crypto_out_tail,
+              queue->crypto_out_size);
+}
+
+
+/**
+ * Commit the ciphertext produced by a crypto worker to the write
+ * ring buffer, hand the worker the plaintext that was appended in
+ * the meantime and make sure #queue_write() runs to transmit it.
+ *
+ * @param cls queue whose job was completed
+ */
+static void
+crypto_commit (void *cls);
+
+
+/**
+ * Hand all the plaintext boxes in the write ring buffer of @a queue
+ * to a crypto worker.  The worker computes the HMAC of each box,
+ * ratchets the HMAC secret and encrypts the boxes in place.
+ *
+ * @param queue queue to encrypt for
+ */
+static void
+crypto_encrypt_submit (struct Queue *queue)
+{
+  GNUNET_assert (NULL == queue->crypto_out_job);
+  GNUNET_assert (0 < queue->cplain_off);
+  crypto_md_open (&queue->crypto_out_md);
+  queue->crypto_out_tail = (queue->cwrite_start + queue->cwrite_off)
+                           % BUF_SIZE;
+  queue->crypto_out_size = queue->cplain_off;
+  queue->crypto_out_job = GNUNET_THREAD_pool_submit (crypto_pool,
+                                                     &crypto_encrypt,
+                                                     &crypto_commit,
+                                                     queue);
+}
+
+
+static void
+crypto_commit (void *cls)
+{
+  struct Queue *queue = cls;
+
+  queue->crypto_out_job = NULL;
+  GNUNET_assert (queue->crypto_out_tail ==
+                 (queue->cwrite_start + queue->cwrite_off) % BUF_SIZE);
+  queue->cwrite_off += queue->crypto_out_size;
+  queue->cplain_off -= queue->crypto_out_size;
+  queue->crypto_out_size = 0;
+  if (0 < queue->cplain_off)
+    crypto_encrypt_submit (queue);
+  if (NULL == queue->write_task)
+    queue->write_task =
+      GNUNET_SCHEDULER_add_write_net (GNUNET_TIME_UNIT_FOREVER_REL,
+                                      queue->sock,
+                                      &queue_write,
+                                      queue);
+}
+
+
+/**
+ * Wait until the crypto workers have MACed and encrypted all the
+ * plaintext in the write ring buffer of @a queue.  Afterwards, the
+ * main thread again owns the outgoing cipher and HMAC secret of
+ * @a queue and may append ciphertext to the ring itself.
+ *
+ * @param queue queue to synchronize
+ */
+static void
+crypto_sync (struct Queue *queue)
+{
+  /* #crypto_commit() hands the plaintext appended while a job was in
+     flight to a new job, so wait until no plaintext is left. */
+  while ((NULL != queue->crypto_out_job) ||
+         (0 < queue->cplain_off))
+  {
+    if (NULL == queue->crypto_out_job)
+      crypto_encrypt_submit (queue);
+    GNUNET_THREAD_pool_wait (queue->crypto_out_job);
+  }
+}
+
+
+/**
+ * Cancel the crypto worker jobs of @a queue, if any, and release
+ * the HMAC contexts of the workers.
+ *
+ * @param queue queue that is being destroyed
+ */
+static void
+crypto_cancel (struct Queue *queue)
+{
+  if (NULL != queue->crypto_out_job)
+  {
+    GNUNET_THREAD_pool_cancel (queue->crypto_out_job);
+    queue->crypto_out_job = NULL;
+  }
+  if (NULL != queue->crypto_in_job)
+  {
+    GNUNET_THREAD_pool_cancel (queue->crypto_in_job);
+    queue->crypto_in_job = NULL;
+  }
+  if (NULL != queue->crypto_out_md)
+  {
+    gcry_md_close (queue->crypto_out_md);
+    queue->crypto_out_md = NULL;
+  }
+  if (NULL != queue->crypto_in_md)
+  {
+    gcry_md_close (queue->crypto_in_md);
+    queue->crypto_in_md = NULL;
+  }
+}
+
+
 /**
  * Functions with this signature are called whenever we need
  * to close a queue due to a disconnect or failure to
@@ -879,6 +1279,7 @@ queue_destroy (struct Queue *queue)
   struct GNUNET_HashCode h_sock;
   int sockfd;
 
+  crypto_cancel (queue);
   if (NULL != queue->listen_sock)
   {
     sockfd = GNUNET_NETWORK_get_fd (queue->listen_sock);
@@ -1016,6 +1417,7 @@ queue_finish (struct Queue *queue)
 {
   struct TCPFinish fin;
 
+  crypto_sync (queue);
   memset (&fin, 0, sizeof(fin));
   fin.header.size = htons (sizeof(fin));
   fin.header.type = htons (GNUNET_MESSAGE_TYPE_COMMUNICATOR_TCP_FINISH);
@@ -1048,6 +1450,186 @@ reschedule_queue_timeout (struct Queue *queue)
 }
 
 
+/**
+ * Encrypt @a in_size bytes from @a in with the outgoing cipher of
+ * @a queue, placing the ciphertext directly at the end of the
+ * write ring buffer.  The caller must make sure that there is
+ * enough space left in the ring.
+ *
+ * @param queue queue to append ciphertext to
+ * @param in plaintext to encrypt
+ * @param in_size number of bytes in @a in
+ */
+static void
+cwrite_encrypt (struct Queue *queue,
+                const void *in,
+                size_t in_size)
+{
+  size_t tail = (queue->cwrite_start + queue->cwrite_off) % BUF_SIZE;
+  size_t first = GNUNET_MIN (in_size, BUF_SIZE - tail);
+
+  GNUNET_assert (0 == queue->cplain_off);
+  GNUNET_assert (queue->cwrite_off + in_size <= BUF_SIZE);
+  /* CTR mode is a stream cipher, so we can simply split at the
+     end of the ring */
+  GNUNET_assert (0 ==
+                 gcry_cipher_encrypt (queue->out_cipher,
+                                      &queue->cwrite_buf[tail],
+                                      first,
+                                      in,
+                                      first));
+  if (first < in_size)
+    GNUNET_assert (0 ==
+                   gcry_cipher_encrypt (queue->out_cipher,
+                                        queue->cwrite_buf,
+                                        in_size - first,
+                                        (const char *) in + first,
+                                        in_size - first));
+  queue->cwrite_off += in_size;
+}
+
+
+/**
+ * Transmit as much ciphertext from the write ring buffer of
+ * @a queue as the socket will take, using a single gather write.
+ *
+ * @param queue queue to transmit for
+ * @param more #GNUNET_YES if we know that more data will follow
+ *        shortly and the kernel should try to coalesce segments
+ * @return number of bytes transmitted, -1 on error (see errno)
+ */
+static ssize_t
+cwrite_transmit (struct Queue *queue,
+                 int more)
+{
+  struct iovec iov[2];
+  struct msghdr mh;
+  int flags;
+  ssize_t sent;
+
+  iov[0].iov_base = &queue->cwrite_buf[queue->cwrite_start];
+  iov[0].iov_len = GNUNET_MIN (queue->cwrite_off,
+                               BUF_SIZE - queue->cwrite_start);
+  iov[1].iov_base = queue->cwrite_buf;
+  iov[1].iov_len = queue->cwrite_off - iov[0].iov_len;
+  memset (&mh, 0, sizeof (mh));
+  mh.msg_iov = iov;
+  mh.msg_iovlen = (0 == iov[1].iov_len) ? 1 : 2;
+  flags = 0;
+#ifdef MSG_DONTWAIT
+  flags |= MSG_DONTWAIT;
+#endif
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_MORE
+  if (GNUNET_YES == more)
+    flags |= MSG_MORE;
+#else
+  (void) more;
+#endif
+  sent = sendmsg (GNUNET_NETWORK_get_fd (queue->sock),
+                  &mh,
+                  flags);
+  if (sent > 0)
+  {
+    queue->cwrite_off -= (size_t) sent;
+    if ((0 == queue->cwrite_off) &&
+        (0 == queue->cplain_off))
+      queue->cwrite_start = 0;
+    else
+      queue->cwrite_start = (queue->cwrite_start + (size_t) sent) % BUF_SIZE;
+  }
+  return sent;
+}
+
+
+/**
+ * Receive as much ciphertext as fits into the free space of
+ * the read ring buffer of @a queue, using a single scatter read.
+ *
+ * @param queue queue to receive for
+ * @return number of bytes received, -1 on error (see errno)
+ */
+static ssize_t
+cread_receive (struct Queue *queue)
+{
+  struct iovec iov[2];
+  struct msghdr mh;
+  size_t tail;
+  size_t space;
+  ssize_t rcvd;
+
+  if (0 == queue->cread_off)
+    queue->cread_start = 0;
+  tail = (queue->cread_start + queue->cread_off) % BUF_SIZE;
+  space = BUF_SIZE - queue->cread_off;
+  iov[0].iov_base = &queue->cread_buf[tail];
+  iov[0].iov_len = GNUNET_MIN (space, BUF_SIZE - tail);
+  iov[1].iov_base = queue->cread_buf;
+  iov[1].iov_len = space - iov[0].iov_len;
+  memset (&mh, 0, sizeof (mh));
+  mh.msg_iov = iov;
+  mh.msg_iovlen = (0 == iov[1].iov_len) ? 1 : 2;
+  rcvd = recvmsg (GNUNET_NETWORK_get_fd (queue->sock),
+                  &mh,
+                  MSG_DONTWAIT);
+  if (rcvd > 0)
+    queue->cread_off += (size_t) rcvd;
+  return rcvd;
+}
+
+
+/**
+ * Decrypt @a size bytes from the front of the read ring buffer
+ * of @a queue into @a out.  Does not consume the ciphertext, see
+ * #cread_consume().
+ *
+ * @param queue queue to decrypt for
+ * @param[out] out where to write the plaintext
+ * @param size number of bytes to decrypt
+ */
+static void
+cread_decrypt (struct Queue *queue,
+               void *out,
+               size_t size)
+{
+  size_t first = GNUNET_MIN (size, BUF_SIZE - queue->cread_start);
+
+  GNUNET_assert (size <= queue->cread_off);
+  GNUNET_assert (0 ==
+                 gcry_cipher_decrypt (queue->in_cipher,
+                                      out,
+                                      first,
+                                      &queue->cread_buf[queue->cread_start],
+                                      first));
+  if (first < size)
+    GNUNET_assert (0 ==
+                   gcry_cipher_decrypt (queue->in_cipher,
+                                        (char *) out + first,
+                                        size - first,
+                                        queue->cread_buf,
+                                        size - first));
+}
+
+
+/**
+ * Drop @a size bytes from the front of the read ring buffer
+ * of @a queue.
+ *
+ * @param queue queue to drop ciphertext from
+ * @param size number of bytes to drop
+ */
+static void
+cread_consume (struct Queue *queue,
+               size_t size)
+{
+  GNUNET_assert (size <= queue->cread_off);
+  queue->cread_off -= size;
+  queue->cread_start = (queue->cread_start + size) % BUF_SIZE;
+}
+
+
 /**
  * Queue read task. If we hit the timeout, disconnect it
  *
@@ -1446,6 +2028,7 @@ send_challenge (struct ChallengeNonceP challenge, struct Queue *queue)
   struct TCPConfirmationAck tca;
   struct TcpHandshakeAckSignature thas;
 
+  crypto_sync (queue);
   GNUNET_log_from_nocheck (GNUNET_ERROR_TYPE_DEBUG,
                            "transport",
                            "sending challenge\n");
@@ -1467,13 +2050,7 @@ send_challenge (struct ChallengeNonceP challenge, struct Queue *queue)
   GNUNET_CRYPTO_eddsa_sign (my_private_key,
                             &thas,
                             &tca.sender_sig);
-  GNUNET_assert (0 ==
-                 gcry_cipher_encrypt (queue->out_cipher,
-                                      &queue->cwrite_buf[queue->cwrite_off],
-                                      sizeof(tca),
-                                      &tca,
-                                      sizeof(tca)));
-  queue->cwrite_off += sizeof(tca);
+  cwrite_encrypt (queue, &tca, sizeof(tca));
   GNUNET_log_from_nocheck (GNUNET_ERROR_TYPE_DEBUG,
                            "transport",
                            "sending challenge done\n");
@@ -1513,7 +2090,8 @@ inject_rekey (struct Queue *queue)
   struct TCPRekey rekey;
   struct TcpRekeySignature thp;
 
-  GNUNET_assert (0 == queue->pwrite_off);
+  GNUNET_assert ((0 == queue->pwrite_off) ||
+                 (NULL != crypto_pool));
   memset (&rekey, 0, sizeof(rekey));
   GNUNET_CRYPTO_ecdhe_key_create (&queue->ephemeral);
   rekey.header.type = ntohs (GNUNET_MESSAGE_TYPE_COMMUNICATOR_TCP_REKEY);
@@ -1548,13 +2126,7 @@ inject_rekey (struct Queue *queue)
                             &rekey.sender_sig);
   calculate_hmac (&queue->out_hmac, &rekey, sizeof(rekey), &rekey.hmac);
   /* Encrypt rekey message with 'old' cipher */
-  GNUNET_assert (0 ==
-                 gcry_cipher_encrypt (queue->out_cipher,
-                                      &queue->cwrite_buf[queue->cwrite_off],
-                                      sizeof(rekey),
-                                      &rekey,
-                                      sizeof(rekey)));
-  queue->cwrite_off += sizeof(rekey);
+  cwrite_encrypt (queue, &rekey, sizeof(rekey));
   /* Setup new cipher for successive messages */
   gcry_cipher_close (queue->out_cipher);
   setup_out_cipher (queue);
@@ -1572,58 +2144,80 @@ queue_write (void *cls)
 {
   struct Queue *queue = cls;
   ssize_t sent;
+  int more;
+
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG, "In queue write\n");
   queue->write_task = NULL;
-  if (0 != queue->cwrite_off)
+  /* can we encrypt more? (always encrypt full messages, needed
+     such that #mq_cancel() can work!)  We encrypt before sending
+     so that the gather write below picks up the new ciphertext
+     together with whatever is still pending in the ring. */
+  if ((NULL != crypto_pool) &&
+      (0 < queue->rekey_left_bytes) &&
+      (0 != GNUNET_TIME_absolute_get_remaining (
+         queue->rekey_time).rel_value_us) &&
+      (queue->pwrite_off > 0) &&
+      (queue->cwrite_off + queue->cplain_off + queue->pwrite_off <=
+       BUF_SIZE) &&
+      (! queue->finishing))
   {
-    sent = GNUNET_NETWORK_socket_send (queue->sock,
-                                       queue->cwrite_buf,
-                                       queue->cwrite_off);
+    /* append the box to the plaintext in the ring; the workers MAC
+       and encrypt it while we transmit and the MQ continues */
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                "Sent %lu bytes to TCP queue\n", sent);
-    if ((-1 == sent) && (EAGAIN != errno) && (EINTR != errno))
-    {
-      GNUNET_log_strerror (GNUNET_ERROR_TYPE_WARNING, "send");
-      queue_destroy (queue);
-      return;
-    }
-    if (sent > 0)
-    {
-      size_t usent = (size_t) sent;
-      queue->cwrite_off -= usent;
-      memmove (queue->cwrite_buf,
-               &queue->cwrite_buf[usent],
-               queue->cwrite_off);
-      reschedule_queue_timeout (queue);
-    }
+                "Passing %lu bytes to crypto worker\n", queue->pwrite_off);
+    ring_write (queue->cwrite_buf,
+                queue->cwrite_start + queue->cwrite_off + queue->cplain_off,
+                queue->pwrite_buf,
+                queue->pwrite_off);
+    queue->cplain_off += queue->pwrite_off;
+    if (queue->rekey_left_bytes > queue->pwrite_off)
+      queue->rekey_left_bytes -= queue->pwrite_off;
+    else
+      queue->rekey_left_bytes = 0;
+    queue->pwrite_off = 0;
+    if (NULL == queue->crypto_out_job)
+      crypto_encrypt_submit (queue);
   }
-  /* can we encrypt more? (always encrypt full messages, needed
-     such that #mq_cancel() can work!) */
-  if ((0 < queue->rekey_left_bytes) &&
-      (queue->pwrite_off > 0) &&
-      (queue->cwrite_off + queue->pwrite_off <= BUF_SIZE))
+  else if ((0 == queue->cplain_off) &&
+           (NULL == queue->crypto_out_job) &&
+           ((0 < queue->rekey_left_bytes) || (queue->finishing)) &&
+           (queue->pwrite_off > 0) &&
+           (queue->cwrite_off + queue->pwrite_off <= BUF_SIZE))
   {
     GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
                 "Encrypting %lu bytes\n", queue->pwrite_off);
-    GNUNET_assert (0 ==
-                   gcry_cipher_encrypt (queue->out_cipher,
-                                        &queue->cwrite_buf[queue->cwrite_off],
-                                        queue->pwrite_off,
-                                        queue->pwrite_buf,
-                                        queue->pwrite_off));
+    if ((NULL != crypto_pool) && (! queue->finishing))
+    {
+      /* #mq_send() left the HMAC of the box to the crypto workers,
+         but they are idle and we own the HMAC secret */
+      struct TCPBox *box = (struct TCPBox *) queue->pwrite_buf;
+
+      calculate_hmac (&queue->out_hmac,
+                      &box[1],
+                      ntohs (box->header.size),
+                      &box->hmac);
+    }
+    cwrite_encrypt (queue,
+                    queue->pwrite_buf,
+                    queue->pwrite_off);
     if (queue->rekey_left_bytes > queue->pwrite_off)
       queue->rekey_left_bytes -= queue->pwrite_off;
     else
       queue->rekey_left_bytes = 0;
-    queue->cwrite_off += queue->pwrite_off;
     queue->pwrite_off = 0;
   }
   // if ((-1 != unverified_size)&& ((0 == queue->pwrite_off) &&
-  if (((0 == queue->pwrite_off) &&
-       ((0 == queue->rekey_left_bytes) ||
-        (0 ==
-         GNUNET_TIME_absolute_get_remaining (
-           queue->rekey_time).rel_value_us))))
+  /* with the crypto workers, boxes waiting in pwrite_buf are not
+     MACed yet and may follow the rekey */
+  if (((0 == queue->pwrite_off) ||
+       ((NULL != crypto_pool) && (! queue->finishing))) &&
+      (0 == queue->cplain_off) &&
+      (NULL == queue->crypto_out_job) &&
+      (queue->cwrite_off + sizeof(struct TCPRekey) <= BUF_SIZE) &&
+      ((0 == queue->rekey_left_bytes) ||
+       (0 ==
+        GNUNET_TIME_absolute_get_remaining (
+          queue->rekey_time).rel_value_us)))
   {
     inject_rekey (queue);
   }
@@ -1633,6 +2227,29 @@ queue_write (void *cls)
     queue->mq_awaits_continue = GNUNET_NO;
     GNUNET_MQ_impl_send_continue (queue->mq);
   }
+  if (0 != queue->cwrite_off)
+  {
+    /* If we already know that more plaintext is waiting (because
+       the ring was too full to take it, or because the MQ has more
+       messages lined up), let the kernel coalesce segments. */
+    more = ((0 < queue->pwrite_off) ||
+            ((NULL != queue->mq) &&
+             (0 < GNUNET_MQ_get_length (queue->mq))))
+           ? GNUNET_YES
+           : GNUNET_NO;
+    sent = cwrite_transmit (queue,
+                            more);
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Sent %lu bytes to TCP queue\n", sent);
+    if ((-1 == sent) && (EAGAIN != errno) && (EINTR != errno))
+    {
+      GNUNET_log_strerror (GNUNET_ERROR_TYPE_WARNING, "send");
+      queue_destroy (queue);
+      return;
+    }
+    if (sent > 0)
+      reschedule_queue_timeout (queue);
+  }
   /* did we just finish writing 'finish'? */
   if ((0 == queue->cwrite_off) && (GNUNET_YES == queue->finishing))
   {
@@ -1641,8 +2258,10 @@ queue_write (void *cls)
     queue_destroy (queue);
     return;
   }
-  /* do we care to write more? */
-  if ((0 < queue->cwrite_off) || (0 < queue->pwrite_off))
+  /* do we care to write more? (if the crypto workers are busy
+     with our plaintext, #crypto_commit() will reschedule us) */
+  if ((0 < queue->cwrite_off) ||
+      ((0 < queue->pwrite_off) && (NULL == queue->crypto_out_job)))
     queue->write_task =
       GNUNET_SCHEDULER_add_write_net (GNUNET_TIME_UNIT_FOREVER_REL,
                                       queue->sock,
@@ -1761,11 +2380,13 @@ try_handle_plaintext (struct Queue *queue)
     if (GNUNET_TRANSPORT_CS_INBOUND ==     queue->cs)
     {
       send_challenge (queue->challenge_received, queue);
-      queue->write_task =
-        GNUNET_SCHEDULER_add_write_net (GNUNET_TIME_UNIT_FOREVER_REL,
-                                        queue->sock,
-                                        &queue_write,
-                                        queue);
+      /* #crypto_commit() may have scheduled us already */
+      if (NULL == queue->write_task)
+        queue->write_task =
+          GNUNET_SCHEDULER_add_write_net (GNUNET_TIME_UNIT_FOREVER_REL,
+                                          queue->sock,
+                                          &queue_write,
+                                          queue);
     }
 
     unverified_size = -1;
@@ -1885,6 +2506,229 @@ try_handle_plaintext (struct Queue *queue)
 }
 
 
+/**
+ * Decrypt the messages in the read ring buffer of a queue in place
+ * and verify the HMACs of the boxes.  Stops after the first complete
+ * message that is not a box, as the main thread has to handle it
+ * before we can go on (a rekey changes the cipher).  Run by a crypto
+ * worker, must not use the scheduler, logging or any other
+ * non-reentrant GNUnet API.
+ *
+ * @param cls the `struct Queue`
+ */
+static void
+crypto_decrypt (void *cls)
+{
+  struct Queue *queue = cls;
+
+  while (queue->cread_ready < queue->crypto_in_avail)
+  {
+    struct TCPBox box;
+    struct GNUNET_ShortHashCode tmac;
+    size_t start = queue->cread_start + queue->cread_ready;
+    size_t have = queue->crypto_in_avail - queue->cread_ready;
+    size_t msize;
+    uint16_t type;
+
+    /* we need the header to find the end of the message */
+    msize = GNUNET_MIN (have,
+                        sizeof(struct GNUNET_MessageHeader));
+    if (queue->cread_plain < queue->cread_ready + msize)
+    {
+      ring_crypt (queue->in_cipher,
+                  GNUNET_YES,
+                  queue->cread_buf,
+                  queue->cread_start + queue->cread_plain,
+                  queue->cread_ready + msize - queue->cread_plain);
+      queue->cread_plain = queue->cread_ready + msize;
+    }
+    if (have < sizeof(struct GNUNET_MessageHeader))
+      return;
+    ring_read (queue->cread_buf,
+               start,
+               &box.header,
+               sizeof(box.header));
+    type = ntohs (box.header.type);
+    msize = ntohs (box.header.size);
+    /* Special case: header size of a box excludes box itself! */
+    if (GNUNET_MESSAGE_TYPE_COMMUNICATOR_TCP_BOX == type)
+      msize += sizeof(struct TCPBox);
+    else if (sizeof(struct GNUNET_MessageHeader) > msize)
+    {
+      queue->crypto_in_status = GNUNET_SYSERR;
+      return;
+    }
+    if (queue->cread_plain < queue->cread_ready + GNUNET_MIN (have, msize))
+    {
+      ring_crypt (queue->in_cipher,
+                  GNUNET_YES,
+                  queue->cread_buf,
+                  queue->cread_start + queue->cread_plain,
+                  queue->cread_ready + GNUNET_MIN (have, msize)
+                  - queue->cread_plain);
+      queue->cread_plain = queue->cread_ready + GNUNET_MIN (have, msize);
+    }
+    if (have < msize)
+      return;
+    if (GNUNET_MESSAGE_TYPE_COMMUNICATOR_TCP_BOX != type)
+    {
+      queue->cread_ready += msize;
+      queue->crypto_in_status = GNUNET_YES;
+      return;
+    }
+    ring_read (queue->cread_buf,
+               start,
+               &box,
+               sizeof(box));
+    ring_hmac (queue->crypto_in_md,
+               &queue->in_hmac,
+               queue->cread_buf,
+               start + sizeof(box),
+               ntohs (box.header.size),
+               &tmac);
+    if (0 != memcmp (&tmac, &box.hmac, sizeof(tmac)))
+    {
+      queue->crypto_in_status = GNUNET_SYSERR;
+      return;
+    }
+    queue->cread_ready += msize;
+  }
+}
+
+
+/**
+ * Hand the ciphertext received on @a queue that the crypto workers
+ * have not yet looked at to a crypto worker, unless one is already
+ * busy with it.
+ *
+ * @param queue queue to decrypt for
+ */
+static void
+crypto_decrypt_submit (struct Queue *queue);
+
+
+/**
+ * A crypto worker decrypted messages received on a queue.  Pass the
+ * boxes to CORE and handle the other messages, in order, and hand
+ * the rest of the ciphertext to the workers.
+ *
+ * @param cls queue whose job was completed
+ */
+static void
+crypto_deliver (void *cls)
+{
+  struct Queue *queue = cls;
+  struct GNUNET_MessageHeader hdr;
+  size_t msize;
+
+  queue->crypto_in_job = NULL;
+  while (0 < queue->cread_ready)
+  {
+    ring_read (queue->cread_buf,
+               queue->cread_start,
+               &hdr,
+               sizeof(hdr));
+    msize = ntohs (hdr.size);
+    if (GNUNET_MESSAGE_TYPE_COMMUNICATOR_TCP_BOX == ntohs (hdr.type))
+    {
+      const void *payload;
+
+      if ((-1 != unverified_size) && (unverified_size > INITIAL_CORE_KX_SIZE))
+      {
+        GNUNET_log (GNUNET_ERROR_TYPE_ERROR,
+                    "Already received data of size %lu bigger than KX size %lu!\n",
+                    unverified_size,
+                    INITIAL_CORE_KX_SIZE);
+        queue->crypto_in_status = GNUNET_SYSERR;
+        break;
+      }
+      /* the HMAC was already checked by #crypto_decrypt() */
+      if (queue->cread_start + sizeof(struct TCPBox) + msize <= BUF_SIZE)
+      {
+        payload = &queue->cread_buf[queue->cread_start
+                                    + sizeof(struct TCPBox)];
+      }
+      else
+      {
+        ring_read (queue->cread_buf,
+                   queue->cread_start + sizeof(struct TCPBox),
+                   queue->pread_buf,
+                   msize);
+        payload = queue->pread_buf;
+      }
+      pass_plaintext_to_core (queue, payload, msize);
+      msize += sizeof(struct TCPBox);
+      if (-1 != unverified_size)
+        unverified_size += msize;
+    }
+    else
+    {
+      GNUNET_assert (0 == queue->pread_off);
+      ring_read (queue->cread_buf,
+                 queue->cread_start,
+                 queue->pread_buf,
+                 msize);
+      queue->pread_off = msize;
+      if (GNUNET_MESSAGE_TYPE_COMMUNICATOR_TCP_FINISH == ntohs (hdr.type))
+      {
+        /* handling the finish destroys the queue, stop here for good */
+        queue->crypto_in_status = GNUNET_SYSERR;
+        (void) try_handle_plaintext (queue);
+        return;
+      }
+      if (0 == try_handle_plaintext (queue))
+      {
+        /* the queue is finishing already */
+        queue->pread_off = 0;
+        queue->crypto_in_status = GNUNET_SYSERR;
+        return;
+      }
+      /* no need to re-decrypt, #crypto_decrypt() stopped right
+         after this message */
+      queue->rekeyed = GNUNET_NO;
+      queue->pread_off = 0;
+    }
+    cread_consume (queue, msize);
+    queue->cread_ready -= msize;
+    queue->cread_plain -= msize;
+  }
+  if (GNUNET_SYSERR == queue->crypto_in_status)
+  {
+    GNUNET_break_op (0);
+    queue_finish (queue);
+    return;
+  }
+  queue->crypto_in_status = GNUNET_NO;
+  crypto_decrypt_submit (queue);
+  /* possibly resume reading, now that there is space in the ring */
+  if ((NULL == queue->read_task) &&
+      (BUF_SIZE > queue->cread_off) &&
+      (max_queue_length > queue->backpressure))
+    queue->read_task =
+      GNUNET_SCHEDULER_add_read_net (GNUNET_TIME_absolute_get_remaining (
+                                       queue->timeout),
+                                     queue->sock,
+                                     &queue_read,
+                                     queue);
+}
+
+
+static void
+crypto_decrypt_submit (struct Queue *queue)
+{
+  if ((NULL != queue->crypto_in_job) ||
+      (GNUNET_SYSERR == queue->crypto_in_status) ||
+      (queue->cread_off == queue->cread_plain))
+    return;
+  crypto_md_open (&queue->crypto_in_md);
+  queue->crypto_in_avail = queue->cread_off;
+  queue->crypto_in_job = GNUNET_THREAD_pool_submit (crypto_pool,
+                                                    &crypto_decrypt,
+                                                    &crypto_deliver,
+                                                    queue);
+}
+
+
 /**
  * Queue read task. If we hit the timeout, disconnect it
  *
@@ -1898,9 +2742,7 @@ queue_read (void *cls)
   ssize_t rcvd;
 
   queue->read_task = NULL;
-  rcvd = GNUNET_NETWORK_socket_recv (queue->sock,
-                                     &queue->cread_buf[queue->cread_off],
-                                     BUF_SIZE - queue->cread_off);
+  rcvd = cread_receive (queue);
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Received %lu bytes from TCP queue\n", rcvd);
   GNUNET_log_from_nocheck (GNUNET_ERROR_TYPE_DEBUG,
@@ -1922,8 +2764,10 @@ queue_read (void *cls)
   }
   if (0 != rcvd)
     reschedule_queue_timeout (queue);
-  queue->cread_off += rcvd;
-  while ((queue->pread_off < sizeof(queue->pread_buf)) &&
+  if (NULL != crypto_pool)
+    crypto_decrypt_submit (queue);
+  while ((NULL == crypto_pool) &&
+         (queue->pread_off < sizeof(queue->pread_buf)) &&
          (queue->cread_off > 0))
   {
     size_t max = GNUNET_MIN (sizeof(queue->pread_buf) - queue->pread_off,
@@ -1932,12 +2776,9 @@ queue_read (void *cls)
     size_t total;
     size_t old_pread_off = queue->pread_off;
 
-    GNUNET_assert (0 ==
-                   gcry_cipher_decrypt (queue->in_cipher,
-                                        &queue->pread_buf[queue->pread_off],
-                                        max,
-                                        queue->cread_buf,
-                                        max));
+    cread_decrypt (queue,
+                   &queue->pread_buf[queue->pread_off],
+                   max);
     queue->pread_off += max;
     total = 0;
     while (0 != (done = try_handle_plaintext (queue)))
@@ -1969,8 +2810,7 @@ queue_read (void *cls)
       queue->rekeyed = GNUNET_NO;
       queue->pread_off = 0;
     }
-    memmove (queue->cread_buf, &queue->cread_buf[max], queue->cread_off - max);
-    queue->cread_off -= max;
+    cread_consume (queue, max);
   }
   if (BUF_SIZE == queue->cread_off)
     return; /* buffer full, suspend reading */
@@ -2331,7 +3171,11 @@ mq_send (struct GNUNET_MQ_Handle *mq,
   GNUNET_assert (0 == queue->pwrite_off);
   box.header.type = htons (GNUNET_MESSAGE_TYPE_COMMUNICATOR_TCP_BOX);
   box.header.size = htons (msize);
-  calculate_hmac (&queue->out_hmac, msg, msize, &box.hmac);
+  /* with the crypto workers, the HMAC is computed by #crypto_encrypt() */
+  if (NULL != crypto_pool)
+    memset (&box.hmac, 0, sizeof(box.hmac));
+  else
+    calculate_hmac (&queue->out_hmac, msg, msize, &box.hmac);
   memcpy (&queue->pwrite_buf[queue->pwrite_off], &box, sizeof(box));
   queue->pwrite_off += sizeof(box);
   memcpy (&queue->pwrite_buf[queue->pwrite_off], msg, msize);
@@ -2457,7 +3301,9 @@ transmit_kx (struct Queue *queue,
   struct TcpHandshakeSignature ths;
   struct TCPConfirmation tc;
 
+  GNUNET_assert (0 == queue->cwrite_off);
   memcpy (queue->cwrite_buf, epub, sizeof(*epub));
+  queue->cwrite_start = 0;
   queue->cwrite_off = sizeof(*epub);
   /* compute 'tc' and append in encrypted format to cwrite_buf */
   tc.sender = my_identity;
@@ -2476,14 +3322,8 @@ transmit_kx (struct Queue *queue,
   GNUNET_CRYPTO_eddsa_sign (my_private_key,
                             &ths,
                             &tc.sender_sig);
-  GNUNET_assert (0 ==
-                 gcry_cipher_encrypt (queue->out_cipher,
-                                      &queue->cwrite_buf[queue->cwrite_off],
-                                      sizeof(tc),
-                                      &tc,
-                                      sizeof(tc)));
+  cwrite_encrypt (queue, &tc, sizeof(tc));
   queue->challenge = tc.challenge;
-  queue->cwrite_off += sizeof(tc);
 
   GNUNET_log_from_nocheck (GNUNET_ERROR_TYPE_DEBUG,
                            "transport",
@@ -2827,9 +3667,7 @@ queue_read_kx (void *cls)
     queue_destroy (queue);
     return;
   }
-  rcvd = GNUNET_NETWORK_socket_recv (queue->sock,
-                                     &queue->cread_buf[queue->cread_off],
-                                     BUF_SIZE - queue->cread_off);
+  rcvd = cread_receive (queue);
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Received %lu bytes for KX\n",
               rcvd);
@@ -2849,7 +3687,6 @@ queue_read_kx (void *cls)
       GNUNET_SCHEDULER_add_read_net (left, queue->sock, &queue_read_kx, queue);
     return;
   }
-  queue->cread_off += rcvd;
   if (queue->cread_off < INITIAL_KX_SIZE)
   {
     /* read more */
@@ -2858,6 +3695,7 @@ queue_read_kx (void *cls)
     return;
   }
   /* we got all the data, let's find out who we are talking to! */
+  GNUNET_assert (0 == queue->cread_start);
   setup_in_cipher ((const struct GNUNET_CRYPTO_EcdhePublicKey *)
                    queue->cread_buf,
                    queue);
@@ -2888,13 +3726,10 @@ queue_read_kx (void *cls)
   /* update queue timeout */
   reschedule_queue_timeout (queue);
   /* prepare to continue with regular read task immediately */
-  memmove (queue->cread_buf,
-           &queue->cread_buf[INITIAL_KX_SIZE],
-           queue->cread_off - (INITIAL_KX_SIZE));
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "cread_off is %lu bytes before adjusting\n",
               queue->cread_off);
-  queue->cread_off -= INITIAL_KX_SIZE;
+  cread_consume (queue, INITIAL_KX_SIZE);
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "cread_off set to %lu bytes\n",
               queue->cread_off);
@@ -3085,6 +3920,11 @@ do_shutdown (void *cls)
   GNUNET_CONTAINER_multihashmap_iterate (lt_map, &get_lt_delete_it, NULL);
   GNUNET_CONTAINER_multipeermap_iterate (queue_map, &get_queue_delete_it, NULL);
   GNUNET_CONTAINER_multipeermap_destroy (queue_map);
+  if (NULL != crypto_pool)
+  {
+    GNUNET_THREAD_pool_destroy (crypto_pool);
+    crypto_pool = NULL;
+  }
   if (NULL != ch)
   {
     GNUNET_TRANSPORT_communicator_address_remove_all (ch);
@@ -3526,6 +4366,7 @@ run (void *cls,
   struct PortOnlyIpv4Ipv6 *po;
   socklen_t addr_len_ipv4;
   socklen_t addr_len_ipv6;
+  unsigned long long crypto_workers;
 
   (void) cls;
   cfg = c;
@@ -3552,6 +4393,22 @@ run (void *cls,
                                            "REKEY_INTERVAL",
                                            &rekey_interval))
     rekey_interval = DEFAULT_REKEY_INTERVAL;
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (cfg,
+                                             COMMUNICATOR_CONFIG_SECTION,
+                                             "CRYPTO_WORKERS",
+                                             &crypto_workers))
+    crypto_workers = 0;
+  if (0 != crypto_workers)
+  {
+    crypto_pool = GNUNET_THREAD_pool_create (
+      GNUNET_MIN (crypto_workers, MAX_CRYPTO_WORKERS));
+    if (0 == GNUNET_THREAD_pool_get_size (crypto_pool))
+    {
+      GNUNET_THREAD_pool_destroy (crypto_pool);
+      crypto_pool = NULL;
+    }
+  }
 
   peerstore = GNUNET_PEERSTORE_connect (cfg);
   if (NULL == peerstore)
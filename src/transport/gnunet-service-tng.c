@@ -170,6 +170,13 @@
  */
 #define MAX_DV_PATHS_TO_TARGET 3
 
+/**
+ * How often do we at most rebuild the alias table of a DV route
+ * because the performance of one of its paths changed?
+ */
+#define DV_ALIAS_REBUILD_FREQUENCY \
+  GNUNET_TIME_relative_multiply (GNUNET_TIME_UNIT_SECONDS, 1)
+
 /**
  * If a queue delays the next message by more than this number
  * of seconds we log a warning. Note: this is for testing,
@@ -302,6 +309,35 @@
  */
 #define QUEUE_LENGTH_LIMIT 32
 
+/**
+ * How many bytes of credit does the traffic class with the lowest
+ * weight get per round of the deficit round robin scheduler of a
+ * queue?  The other classes get multiples of this, see
+ * #traffic_class_weight.
+ */
+#define DRR_QUANTUM 4096
+
+/**
+ * Virtual time a byte of the traffic class with weight 1 costs in
+ * the weighted fair queueing between the queues of a communicator.
+ * A byte of a class costs this divided by its #traffic_class_weight,
+ * so this must be a multiple of all the weights.
+ */
+#define WFQ_BYTE_COST 4
+
+/**
+ * Which fraction of the RTT do we tolerate as reordering before the
+ * loss detector declares a transmission lost that was sent before
+ * another transmission that was already acknowledged?
+ */
+#define RACK_REORDER_DIVISOR 4
+
+/**
+ * After how many RTTs without any acknowledgement for the most recent
+ * transmission on a queue do we send a tail loss probe?
+ */
+#define TLP_RTT_FACTOR 2
+
 
 GNUNET_NETWORK_STRUCT_BEGIN
 
@@ -1492,6 +1528,13 @@ struct PendingAcknowledgement
    * Number of bytes of the original message (to calculate bandwidth).
    */
   uint16_t message_size;
+
+  /**
+   * Set to #GNUNET_YES once the loss detector declared this
+   * transmission lost (and triggered a retransmission).  We keep
+   * the entry around in case the ACK was merely late.
+   */
+  int lost;
 };
 
 
@@ -1576,6 +1619,58 @@ struct DistanceVectorHop
 };
 
 
+/**
+ * Alias table (Walker/Vose) over the paths of a `struct DistanceVector`,
+ * allowing us to pick a path weighted by distance and performance
+ * in constant time.
+ */
+struct DVAliasTable
+{
+  /**
+   * Paths in the table, @e len entries.
+   */
+  struct DistanceVectorHop **hops;
+
+  /**
+   * Probability (in units of @e total) of picking the path at the
+   * same offset in @e hops instead of its alias.
+   */
+  uint64_t *prob;
+
+  /**
+   * Offset of the alternative path in @e hops for each slot.
+   */
+  unsigned int *alias;
+
+  /**
+   * Weight of each path in @e hops, used to pick among the paths
+   * not yet picked once the table yields a duplicate.
+   */
+  uint64_t *weight;
+
+  /**
+   * Sum of the weights of all paths in the table.
+   */
+  uint64_t total;
+
+  /**
+   * Number of entries in the table.
+   */
+  unsigned int len;
+
+  /**
+   * When was the table last built?
+   */
+  struct GNUNET_TIME_Absolute built_at;
+
+  /**
+   * When do we need to rebuild the table?  Set to zero if the set
+   * of paths changed.
+   */
+  struct GNUNET_TIME_Absolute rebuild_at;
+};
+
+
 /**
  * Entry in our #dv_routes table, representing a (set of) distance
  * vector routes to a particular peer.
@@ -1633,6 +1728,18 @@ struct DistanceVector
    * Our private ephemeral key.
    */
   struct GNUNET_CRYPTO_EcdhePrivateKey private_key;
+
+  /**
+   * Result of the ECDH between @e private_key and @e target, the
+   * master secret for all DV boxes we send with @e ephemeral_key.
+   */
+  struct GNUNET_HashCode km;
+
+  /**
+   * Alias tables to pick paths from, at offset 0 only confirmed
+   * paths, at offset 1 all paths.
+   */
+  struct DVAliasTable alias[2];
 };
 
 
@@ -1741,6 +1848,24 @@ struct Queue
    */
   struct GNUNET_SCHEDULER_Task *transmit_task;
 
+  /**
+   * Task scheduled to run the time-based loss detection (and tail
+   * loss probe) for the transmissions in the @e pa_head DLL.
+   */
+  struct GNUNET_SCHEDULER_Task *rack_task;
+
+  /**
+   * When is @e rack_task going to run?
+   */
+  struct GNUNET_TIME_Absolute rack_time;
+
+  /**
+   * Transmission time of the most recently sent message on this
+   * queue that was acknowledged.  Unacknowledged transmissions sent
+   * sufficiently before this time are considered lost.
+   */
+  struct GNUNET_TIME_Absolute rack_xmit_time;
+
   /**
    * How long do *we* consider this @e address to be valid?  In the past or
    * zero if we have not yet validated it.  Can be updated based on
@@ -1806,6 +1931,33 @@ struct Queue
    * virtual link to give it a pending message.
    */
   int idle;
+
+  /**
+   * Traffic class currently served by the deficit round robin
+   * scheduler of this queue.
+   */
+  enum GNUNET_TRANSPORT_TrafficClass drr_class;
+
+  /**
+   * Remaining credit (in bytes) of each traffic class in the current
+   * round of the deficit round robin scheduler.  Can become negative
+   * if a class sent a message larger than its credit.
+   */
+  int64_t drr_deficit[GNUNET_TRANSPORT_TRAFFIC_CLASS_COUNT];
+
+  /**
+   * How long did messages of each traffic class wait before we gave
+   * them to the communicator via this queue?
+   */
+  uint32_t latency_histogram[GNUNET_TRANSPORT_TRAFFIC_CLASS_COUNT][
+    GNUNET_TRANSPORT_MONITOR_LATENCY_BUCKETS];
+
+  /**
+   * Virtual finish time of the last message we gave to the
+   * communicator via this queue, see @e wfq_vtime of the
+   * communicator.
+   */
+  uint64_t wfq_finish;
 };
 
 
@@ -2161,6 +2313,14 @@ struct PendingMessage
    */
   struct GNUNET_TIME_Absolute next_attempt;
 
+  /**
+   * When did CORE give us this message?  Reset to zero once we
+   * accounted for the delay until the first transmission in the
+   * latency histogram of the queue.  Zero for messages we do not
+   * track (i.e. those not from CORE).
+   */
+  struct GNUNET_TIME_Absolute queued_at;
+
   /**
    * UUID to use for this message (used for reassembly of fragments, only
    * initialized if @e msg_uuid_set is #GNUNET_YES).
@@ -2179,8 +2339,8 @@ struct PendingMessage
   enum PendingMessageType pmt;
 
   /**
-   * Preferences for this message.
-   * TODO: actually use this!
+   * Preferences for this message.  Determine the traffic class
+   * (see #get_traffic_class()) the message is scheduled in.
    */
   enum GNUNET_MQ_PriorityPreferences prefs;
 
@@ -2424,6 +2584,16 @@ struct TransportClient
        */
       unsigned int total_queue_length;
 
+      /**
+       * Virtual time of the weighted fair queueing between the queues
+       * of this communicator: the virtual start time of the last
+       * message given to it.  The queues are kept sorted by their
+       * @e wfq_finish, so once the communicator is no longer
+       * throttled, the queue that is furthest behind its fair share
+       * gets the first free slot.
+       */
+      uint64_t wfq_vtime;
+
       /**
        * Characteristics of this communicator.
        */
@@ -3047,6 +3217,11 @@ struct MonitorEvent
    * Bytes pending.
    */
   uint32_t num_bytes_pending;
+
+  /**
+   * Per traffic class latency histograms, NULL for none.
+   */
+  const uint32_t (*latency_histogram)[GNUNET_TRANSPORT_MONITOR_LATENCY_BUCKETS];
 };
 
 
@@ -3072,6 +3247,8 @@ free_distance_vector_hop (struct DistanceVectorHop *dvh)
   }
   GNUNET_CONTAINER_MDLL_remove (neighbour, n->dv_head, n->dv_tail, dvh);
   GNUNET_CONTAINER_MDLL_remove (dv, dv->dv_head, dv->dv_tail, dvh);
+  dv->alias[0].rebuild_at = GNUNET_TIME_UNIT_ZERO_ABS;
+  dv->alias[1].rebuild_at = GNUNET_TIME_UNIT_ZERO_ABS;
   GNUNET_free (dvh);
 }
 
@@ -3153,6 +3330,13 @@ free_dv_route (struct DistanceVector *dv)
       GNUNET_SCHEDULER_cancel (dv->timeout_task);
       dv->timeout_task = NULL;
     }
+    for (unsigned int i = 0; i < 2; i++)
+    {
+      GNUNET_free (dv->alias[i].hops);
+      GNUNET_free (dv->alias[i].prob);
+      GNUNET_free (dv->alias[i].alias);
+      GNUNET_free (dv->alias[i].weight);
+    }
     GNUNET_free (dv);
   }
 }
@@ -3194,6 +3378,16 @@ notify_monitor (struct TransportClient *tc,
   md->cs = htonl ((uint32_t) me->cs);
   md->num_msg_pending = htonl (me->num_msg_pending);
   md->num_bytes_pending = htonl (me->num_bytes_pending);
+  GNUNET_static_assert (MONITOR_LATENCY_CLASSES ==
+                        GNUNET_TRANSPORT_TRAFFIC_CLASS_COUNT);
+  GNUNET_static_assert (MONITOR_LATENCY_BUCKETS ==
+                        GNUNET_TRANSPORT_MONITOR_LATENCY_BUCKETS);
+  if (NULL != me->latency_histogram)
+    for (unsigned int i = 0; i < GNUNET_TRANSPORT_TRAFFIC_CLASS_COUNT; i++)
+      for (unsigned int j = 0; j < GNUNET_TRANSPORT_MONITOR_LATENCY_BUCKETS;
+           j++)
+        md->latency_histogram[i * GNUNET_TRANSPORT_MONITOR_LATENCY_BUCKETS + j]
+          = htonl (me->latency_histogram[i][j]);
   memcpy (&md[1], address, addr_len);
   GNUNET_MQ_send (tc->mq, env);
 }
@@ -3568,6 +3762,11 @@ free_queue (struct Queue *queue)
     GNUNET_SCHEDULER_cancel (queue->transmit_task);
     queue->transmit_task = NULL;
   }
+  if (NULL != queue->rack_task)
+  {
+    GNUNET_SCHEDULER_cancel (queue->rack_task);
+    queue->rack_task = NULL;
+  }
   while (NULL != (pa = queue->pa_head))
   {
     GNUNET_CONTAINER_MDLL_remove (queue, queue->pa_head, queue->pa_tail, pa);
@@ -3610,6 +3809,7 @@ free_queue (struct Queue *queue)
          s = s->next_client)
       schedule_transmit_on_queue (s, GNUNET_SCHEDULER_PRIORITY_DEFAULT);
   }
+  me.latency_histogram = queue->latency_histogram;
   notify_monitors (&neighbour->pid, queue->address, queue->nt, &me);
   GNUNET_free (queue);
 
@@ -3903,7 +4103,126 @@ client_send_response (struct PendingMessage *pm)
 
 
 /**
- * Pick @a hops_array_length random DV paths satisfying @a options
+ * Compute the weight of @a dvh for path selection, giving more
+ * weight to shorter paths and paths with a lower RTT.
+ *
+ * @param dvh path to weigh
+ * @return weight of the path, always positive
+ */
+static uint64_t
+get_dvh_weight (const struct DistanceVectorHop *dvh)
+{
+  struct GNUNET_TIME_Relative rtt = dvh->pd.aged_rtt;
+  uint64_t rtt_ms;
+
+  if (GNUNET_TIME_UNIT_FOREVER_REL.rel_value_us == rtt.rel_value_us)
+    rtt = DV_QUALITY_RTT_THRESHOLD;
+  rtt_ms = GNUNET_MAX (rtt.rel_value_us / 1000LL, 10);
+  return (uint64_t) (MAX_DV_HOPS_ALLOWED - dvh->distance)
+         * (1 + 1000LL * 1000LL / rtt_ms);
+}
+
+
+/**
+ * (Re)build the alias table @a at over the paths of @a dv.
+ *
+ * @param dv route to build the table for
+ * @param at table to build
+ * @param confirmed_only #GNUNET_YES to only include confirmed paths
+ */
+static void
+build_dv_alias_table (const struct DistanceVector *dv,
+                      struct DVAliasTable *at,
+                      int confirmed_only)
+{
+  struct GNUNET_TIME_Absolute now = GNUNET_TIME_absolute_get ();
+  unsigned int n;
+
+  GNUNET_free (at->hops);
+  GNUNET_free (at->prob);
+  GNUNET_free (at->alias);
+  GNUNET_free (at->weight);
+  at->built_at = now;
+  at->rebuild_at = GNUNET_TIME_UNIT_FOREVER_ABS;
+  at->total = 0;
+  n = 0;
+  for (struct DistanceVectorHop *pos = dv->dv_head; NULL != pos;
+       pos = pos->next_dv)
+  {
+    if ((GNUNET_YES == confirmed_only) &&
+        (pos->path_valid_until.abs_value_us <= now.abs_value_us))
+      continue;   /* pos unconfirmed and confirmed required */
+    n++;
+  }
+  at->len = n;
+  if (0 == n)
+    return;
+  at->hops = GNUNET_new_array (n, struct DistanceVectorHop *);
+  at->prob = GNUNET_new_array (n, uint64_t);
+  at->alias = GNUNET_new_array (n, unsigned int);
+  at->weight = GNUNET_new_array (n, uint64_t);
+  {
+    uint64_t scaled[n];
+    unsigned int small[n];
+    unsigned int large[n];
+    unsigned int ns;
+    unsigned int nl;
+
+    n = 0;
+    for (struct DistanceVectorHop *pos = dv->dv_head; NULL != pos;
+         pos = pos->next_dv)
+    {
+      if ((GNUNET_YES == confirmed_only) &&
+          (pos->path_valid_until.abs_value_us <= now.abs_value_us))
+        continue;
+      if (GNUNET_YES == confirmed_only)
+        at->rebuild_at = GNUNET_TIME_absolute_min (at->rebuild_at,
+                                                   pos->path_valid_until);
+      at->hops[n] = pos;
+      at->weight[n] = get_dvh_weight (pos);
+      scaled[n] = at->weight[n];
+      at->total += scaled[n];
+      n++;
+    }
+    ns = 0;
+    nl = 0;
+    for (unsigned int i = 0; i < n; i++)
+    {
+      scaled[i] *= n;
+      at->alias[i] = i;
+      if (scaled[i] < at->total)
+        small[ns++] = i;
+      else
+        large[nl++] = i;
+    }
+    while ((0 < ns) && (0 < nl))
+    {
+      unsigned int s = small[--ns];
+      unsigned int l = large[--nl];
+
+      at->prob[s] = scaled[s];
+      at->alias[s] = l;
+      scaled[l] = scaled[l] + scaled[s] - at->total;
+      if (scaled[l] < at->total)
+        small[ns++] = l;
+      else
+        large[nl++] = l;
+    }
+    while (0 < nl)
+      at->prob[large[--nl]] = at->total;
+    while (0 < ns)
+      at->prob[small[--ns]] = at->total;   /* only due to rounding */
+  }
+}
+
+
+/**
+ * Pick @a hops_array_length random DV paths satisfying @a options,
+ * weighted by distance and performance of the paths, without
+ * replacement.  Each path is first drawn from the alias table; if
+ * that yields a path we already picked, we draw from the remaining
+ * paths with their weights renormalised, so we always return
+ * @a hops_array_length paths if that many exist.
  *
  * @param dv data structure to pick paths from
  * @param options constraints to satisfy
@@ -3912,71 +4231,68 @@ client_send_response (struct PendingMessage *pm)
  * @return number of entries set in @a hops_array
  */
 static unsigned int
-pick_random_dv_hops (const struct DistanceVector *dv,
+pick_random_dv_hops (struct DistanceVector *dv,
                      enum RouteMessageOptions options,
                      struct DistanceVectorHop **hops_array,
                      unsigned int hops_array_length)
 {
-  uint64_t choices[hops_array_length];
-  uint64_t num_dv;
+  int confirmed_only = (0 == (options & RMO_UNCONFIRMED_ALLOWED))
+                       ? GNUNET_YES
+                       : GNUNET_NO;
+  struct DVAliasTable *at = &dv->alias[(GNUNET_YES == confirmed_only) ? 0 : 1];
   unsigned int dv_count;
 
-  /* Pick random vectors, but weighted by distance, giving more weight
-     to shorter vectors */
-  num_dv = 0;
-  dv_count = 0;
-  for (struct DistanceVectorHop *pos = dv->dv_head; NULL != pos;
-       pos = pos->next_dv)
-  {
-    if ((0 == (options & RMO_UNCONFIRMED_ALLOWED)) &&
-        (GNUNET_TIME_absolute_get_remaining (pos->path_valid_until)
-         .rel_value_us == 0))
-      continue;   /* pos unconfirmed and confirmed required */
-    num_dv += MAX_DV_HOPS_ALLOWED - pos->distance;
-    dv_count++;
-  }
-  if (0 == dv_count)
-    return 0;
-  if (dv_count <= hops_array_length)
+  if (GNUNET_TIME_absolute_get_remaining (at->rebuild_at).rel_value_us == 0)
+    build_dv_alias_table (dv, at, confirmed_only);
+  if (at->len <= hops_array_length)
   {
-    dv_count = 0;
-    for (struct DistanceVectorHop *pos = dv->dv_head; NULL != pos;
-         pos = pos->next_dv)
-      hops_array[dv_count++] = pos;
-    return dv_count;
+    memcpy (hops_array, at->hops, at->len * sizeof(*hops_array));
+    return at->len;
   }
-  for (unsigned int i = 0; i < hops_array_length; i++)
   {
-    int ok = GNUNET_NO;
-    while (GNUNET_NO == ok)
+    unsigned int picked[hops_array_length];
+    uint64_t picked_weight;
+
+    picked_weight = 0;
+    for (dv_count = 0; dv_count < hops_array_length; dv_count++)
     {
-      choices[i] =
-        GNUNET_CRYPTO_random_u64 (GNUNET_CRYPTO_QUALITY_WEAK, num_dv);
-      ok = GNUNET_YES;
-      for (unsigned int j = 0; j < i; j++)
-        if (choices[i] == choices[j])
+      unsigned int i;
+      int dup;
+
+      i = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK, at->len);
+      if (GNUNET_CRYPTO_random_u64 (GNUNET_CRYPTO_QUALITY_WEAK, at->total) >=
+          at->prob[i])
+        i = at->alias[i];
+      dup = GNUNET_NO;
+      for (unsigned int j = 0; j < dv_count; j++)
+        if (picked[j] == i)
+          dup = GNUNET_YES;
+      if (GNUNET_YES == dup)
+      {
+        uint64_t r;
+
+        /* draw from the paths not yet picked */
+        r = GNUNET_CRYPTO_random_u64 (GNUNET_CRYPTO_QUALITY_WEAK,
+                                      at->total - picked_weight);
+        for (i = 0; i < at->len; i++)
         {
-          ok = GNUNET_NO;
-          break;
+          dup = GNUNET_NO;
+          for (unsigned int j = 0; j < dv_count; j++)
+            if (picked[j] == i)
+              dup = GNUNET_YES;
+          if (GNUNET_YES == dup)
+            continue;
+          if (r < at->weight[i])
+            break;
+          r -= at->weight[i];
         }
+        GNUNET_assert (i < at->len);
+      }
+      picked[dv_count] = i;
+      picked_weight += at->weight[i];
+      hops_array[dv_count] = at->hops[i];
     }
   }
-  dv_count = 0;
-  num_dv = 0;
-  for (struct DistanceVectorHop *pos = dv->dv_head; NULL != pos;
-       pos = pos->next_dv)
-  {
-    uint32_t delta = MAX_DV_HOPS_ALLOWED - pos->distance;
-
-    if ((0 == (options & RMO_UNCONFIRMED_ALLOWED)) &&
-        (GNUNET_TIME_absolute_get_remaining (pos->path_valid_until)
-         .rel_value_us == 0))
-      continue;   /* pos unconfirmed and confirmed required */
-    for (unsigned int i = 0; i < hops_array_length; i++)
-      if ((num_dv <= choices[i]) && (num_dv + delta > choices[i]))
-        hops_array[dv_count++] = pos;
-    num_dv += delta;
-  }
   return dv_count;
 }
 
@@ -4170,6 +4486,10 @@ update_ephemeral (struct DistanceVector *dv)
     GNUNET_TIME_absolute_add (dv->monotime, EPHEMERAL_VALIDITY);
   GNUNET_CRYPTO_ecdhe_key_create (&dv->private_key);
   GNUNET_CRYPTO_ecdhe_key_get_public (&dv->private_key, &dv->ephemeral_key);
+  /* must match #dh_key_derive_eph_pub */
+  GNUNET_assert (GNUNET_YES == GNUNET_CRYPTO_ecdh_eddsa (&dv->private_key,
+                                                         &dv->target.public_key,
+                                                         &dv->km));
   ec.purpose.purpose = htonl (GNUNET_SIGNATURE_PURPOSE_TRANSPORT_EPHEMERAL);
   ec.purpose.size = htonl (sizeof(ec));
   ec.target = dv->target;
@@ -4367,14 +4687,13 @@ dv_setup_key_state_from_km (const struct GNUNET_HashCode *km,
                             const struct GNUNET_ShortHashCode *iv,
                             struct DVKeyState *key)
 {
-  /* must match #dh_key_derive_eph_pub */
   GNUNET_assert (GNUNET_YES ==
                  GNUNET_CRYPTO_kdf (&key->material,
                                     sizeof(key->material),
                                     "transport-backchannel-key",
                                     strlen ("transport-backchannel-key"),
-                                    &km,
-                                    sizeof(km),
+                                    km,
+                                    sizeof(*km),
                                     iv,
                                     sizeof(*iv)));
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
@@ -4394,31 +4713,6 @@ dv_setup_key_state_from_km (const struct GNUNET_HashCode *km,
 }
 
 
-/**
- * Derive backchannel encryption key material from @a priv_ephemeral
- * and @a target and @a iv.
- *
- * @param priv_ephemeral ephemeral private key to use
- * @param target the target peer to encrypt to
- * @param iv unique IV to use
- * @param key[out] set to the key material
- */
-static void
-dh_key_derive_eph_pid (
-  const struct GNUNET_CRYPTO_EcdhePrivateKey *priv_ephemeral,
-  const struct GNUNET_PeerIdentity *target,
-  const struct GNUNET_ShortHashCode *iv,
-  struct DVKeyState *key)
-{
-  struct GNUNET_HashCode km;
-
-  GNUNET_assert (GNUNET_YES == GNUNET_CRYPTO_ecdh_eddsa (priv_ephemeral,
-                                                         &target->public_key,
-                                                         &km));
-  dv_setup_key_state_from_km (&km, iv, key);
-}
-
-
 /**
  * Derive backchannel encryption key material from #GST_my_private_key
  * and @a pub_ephemeral and @a iv.
@@ -4566,7 +4860,7 @@ encapsulate_for_dv (struct DistanceVector *dv,
   GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_NONCE,
                               &box_hdr.iv,
                               sizeof(box_hdr.iv));
-  dh_key_derive_eph_pid (&dv->private_key, &dv->target, &box_hdr.iv, &key);
+  dv_setup_key_state_from_km (&dv->km, &box_hdr.iv, &key);
   payload_hdr.sender = GST_my_identity;
   payload_hdr.monotonic_time = GNUNET_TIME_absolute_hton (dv->monotime);
   dv_encrypt (&key, &payload_hdr, enc_payload_hdr, sizeof(payload_hdr));
@@ -4956,6 +5250,7 @@ handle_client_send (void *cls, const struct OutboundMessage *obm)
   pm = GNUNET_malloc (sizeof(struct PendingMessage) + bytes_msg);
   pm->logging_uuid = logging_uuid_gen++;
   pm->prefs = pp;
+  pm->queued_at = GNUNET_TIME_absolute_get ();
   pm->client = tc;
   pm->vl = vl;
   pm->bytes_msg = bytes_msg;
@@ -5425,7 +5720,7 @@ transmit_cummulative_ack_cb (void *cls)
 {
   struct AcknowledgementCummulator *ac = cls;
   char buf[sizeof(struct TransportReliabilityAckMessage)
-           + ac->ack_counter
+           + ac->num_acks
            * sizeof(struct TransportCummulativeAckPayloadP)] GNUNET_ALIGN;
   struct TransportReliabilityAckMessage *ack =
     (struct TransportReliabilityAckMessage *) buf;
@@ -5434,16 +5729,17 @@ transmit_cummulative_ack_cb (void *cls)
   ac->task = NULL;
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Sending ACK with %u components to %s\n",
-              ac->ack_counter,
+              ac->num_acks,
               GNUNET_i2s (&ac->target));
-  GNUNET_assert (0 < ac->ack_counter);
+  GNUNET_assert (0 < ac->num_acks);
   ack->header.type = htons (GNUNET_MESSAGE_TYPE_TRANSPORT_RELIABILITY_ACK);
   ack->header.size =
     htons (sizeof(*ack)
-           + ac->ack_counter * sizeof(struct TransportCummulativeAckPayloadP));
-  ack->ack_counter = htonl (ac->ack_counter++);
+           + ac->num_acks * sizeof(struct TransportCummulativeAckPayloadP));
+  ack->ack_counter = htonl (ac->ack_counter);
+  ac->ack_counter += ac->num_acks;
   ap = (struct TransportCummulativeAckPayloadP *) &ack[1];
-  for (unsigned int i = 0; i < ac->ack_counter; i++)
+  for (unsigned int i = 0; i < ac->num_acks; i++)
   {
     ap[i].ack_uuid = ac->ack_uuids[i].ack_uuid;
     ap[i].ack_delay = GNUNET_TIME_relative_hton (
@@ -5852,6 +6148,15 @@ update_dvh_performance (struct DistanceVectorHop *dvh,
                         uint16_t bytes_transmitted_ok)
 {
   update_performance_data (&dvh->pd, rtt, bytes_transmitted_ok);
+  /* path weights changed, rebuild alias tables eventually */
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    struct DVAliasTable *at = &dvh->dv->alias[i];
+
+    at->rebuild_at = GNUNET_TIME_absolute_min (
+      at->rebuild_at,
+      GNUNET_TIME_absolute_add (at->built_at, DV_ALIAS_REBUILD_FREQUENCY));
+  }
 }
 
 
@@ -5866,6 +6171,7 @@ static void
 completed_pending_message (struct PendingMessage *pm)
 {
   struct PendingMessage *pos;
+  struct PendingAcknowledgement *pa;
 
   switch (pm->pmt)
   {
@@ -5878,14 +6184,24 @@ completed_pending_message (struct PendingMessage *pm)
   case PMT_FRAGMENT_BOX:
     /* Fragment sent over reliabile channel */
     free_fragment_tree (pm);
+    while (NULL != (pa = pm->pa_head))
+    {
+      GNUNET_CONTAINER_MDLL_remove (pm, pm->pa_head, pm->pa_tail, pa);
+      pa->pm = NULL;
+    }
     pos = pm->frag_parent;
     GNUNET_CONTAINER_MDLL_remove (frag, pos->head_frag, pos->tail_frag, pm);
     GNUNET_free (pm);
     /* check if subtree is done */
     while ((NULL == pos->head_frag) && (pos->frag_off == pos->bytes_msg) &&
-           (pos != pm))
+           (NULL != pos->frag_parent))
     {
       pm = pos;
+      while (NULL != (pa = pm->pa_head))
+      {
+        GNUNET_CONTAINER_MDLL_remove (pm, pm->pa_head, pm->pa_tail, pa);
+        pa->pm = NULL;
+      }
       pos = pm->frag_parent;
       GNUNET_CONTAINER_MDLL_remove (frag, pos->head_frag, pos->tail_frag, pm);
       GNUNET_free (pm);
@@ -5907,6 +6223,159 @@ completed_pending_message (struct PendingMessage *pm)
 }
 
 
+/**
+ * Change the value of the `next_attempt` field of @a pm
+ * to @a next_attempt and re-order @a pm in the transmission
+ * list as required by the new timestamp.
+ *
+ * @param pm a pending message to update
+ * @param next_attempt timestamp to use
+ */
+static void
+update_pm_next_attempt (struct PendingMessage *pm,
+                        struct GNUNET_TIME_Absolute next_attempt);
+
+
+/**
+ * The transmission tracked by @a pa was declared lost.  Make the
+ * message (or fragment) that was covered by @a pa eligible for
+ * retransmission right now.  For fragments, only the missing
+ * fragment is retransmitted; its ancestors in the fragment tree
+ * are merely moved forward so that it is picked next.
+ *
+ * @param pa the transmission that was lost
+ */
+static void
+retransmit_lost (struct PendingAcknowledgement *pa)
+{
+  struct GNUNET_TIME_Absolute now = GNUNET_TIME_absolute_get ();
+  struct PendingMessage *pm = pa->pm;
+  struct PendingMessage *root;
+
+  pa->lost = GNUNET_YES;
+  GNUNET_STATISTICS_update (GST_stats,
+                            "# transmissions declared lost before timeout",
+                            1,
+                            GNUNET_NO);
+  if ((NULL == pm) || (NULL == pm->vl))
+    return; /* message gone, or DV box: leave it to the regular timeout */
+  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+              "Transmission `%s' of <%llu> considered lost, retransmitting\n",
+              GNUNET_uuid2s (&pa->ack_uuid.value),
+              pm->logging_uuid);
+  root = pm;
+  for (struct PendingMessage *pos = pm; NULL != pos; pos = pos->frag_parent)
+  {
+    if (pos->next_attempt.abs_value_us > now.abs_value_us)
+      update_pm_next_attempt (pos, now);
+    root = pos;
+  }
+  check_vl_transmission (root->vl);
+}
+
+
+/**
+ * Run the loss detection for @a queue (in the style of RACK, RFC 8985).
+ * Any unacknowledged transmission that was sent before the most
+ * recently acknowledged one and is older than the RTT plus a reordering
+ * window is considered lost.  If no ACK arrived for the most recent
+ * transmission for #TLP_RTT_FACTOR RTTs, the most recent transmission
+ * is retransmitted as a tail loss probe, so that the receiver ACKs
+ * and the detector can work again.  Reschedules itself for the
+ * earliest time at which another transmission may be declared lost.
+ *
+ * @param cls the `struct Queue` to check
+ */
+static void
+rack_detect_losses (void *cls)
+{
+  struct Queue *queue = cls;
+  struct GNUNET_TIME_Absolute now = GNUNET_TIME_absolute_get ();
+  struct GNUNET_TIME_Relative rtt = queue->pd.aged_rtt;
+  struct GNUNET_TIME_Relative reo_wnd;
+  struct GNUNET_TIME_Absolute next = GNUNET_TIME_UNIT_FOREVER_ABS;
+  struct PendingAcknowledgement *pa;
+  struct PendingAcknowledgement *prev;
+
+  queue->rack_task = NULL;
+  if (GNUNET_TIME_UNIT_FOREVER_REL.rel_value_us == rtt.rel_value_us)
+    return; /* no RTT estimate yet, rely on regular timeouts */
+  reo_wnd = GNUNET_TIME_relative_divide (rtt, RACK_REORDER_DIVISOR);
+  /* the queue's DLL is sorted by transmission time, newest first */
+  for (pa = queue->pa_tail; NULL != pa; pa = prev)
+  {
+    struct GNUNET_TIME_Absolute deadline;
+
+    prev = pa->prev_queue;
+    if (pa->transmission_time.abs_value_us >=
+        queue->rack_xmit_time.abs_value_us)
+      break; /* sent after the most recently ACKed message */
+    if (GNUNET_YES == pa->lost)
+      continue;
+    deadline = GNUNET_TIME_absolute_add (
+      pa->transmission_time,
+      GNUNET_TIME_relative_add (rtt, reo_wnd));
+    if (deadline.abs_value_us <= now.abs_value_us)
+      retransmit_lost (pa);
+    else
+      next = GNUNET_TIME_absolute_min (next, deadline);
+  }
+  pa = queue->pa_head;
+  if ((NULL != pa) && (GNUNET_YES != pa->lost) &&
+      (pa->transmission_time.abs_value_us >
+       queue->rack_xmit_time.abs_value_us))
+  {
+    struct GNUNET_TIME_Absolute pto;
+
+    pto = GNUNET_TIME_absolute_add (
+      pa->transmission_time,
+      GNUNET_TIME_relative_multiply (rtt, TLP_RTT_FACTOR));
+    if (pto.abs_value_us <= now.abs_value_us)
+    {
+      GNUNET_STATISTICS_update (GST_stats,
+                                "# tail loss probes",
+                                1,
+                                GNUNET_NO);
+      retransmit_lost (pa);
+    }
+    else
+    {
+      next = GNUNET_TIME_absolute_min (next, pto);
+    }
+  }
+  if (GNUNET_TIME_UNIT_FOREVER_ABS.abs_value_us == next.abs_value_us)
+    return;
+  queue->rack_time = next;
+  queue->rack_task = GNUNET_SCHEDULER_add_at (next,
+                                              &rack_detect_losses,
+                                              queue);
+}
+
+
+/**
+ * Make sure the loss detection for @a queue runs at @a at
+ * or earlier.
+ *
+ * @param queue the queue to check for losses
+ * @param at latest time when to run the loss detection
+ */
+static void
+schedule_rack (struct Queue *queue,
+               struct GNUNET_TIME_Absolute at)
+{
+  if (NULL != queue->rack_task)
+  {
+    if (queue->rack_time.abs_value_us <= at.abs_value_us)
+      return;
+    GNUNET_SCHEDULER_cancel (queue->rack_task);
+  }
+  queue->rack_time = at;
+  queue->rack_task = GNUNET_SCHEDULER_add_at (at,
+                                              &rack_detect_losses,
+                                              queue);
+}
+
+
 /**
  * The @a pa was acknowledged, process the acknowledgement.
  *
@@ -5921,12 +6390,21 @@ handle_acknowledged (struct PendingAcknowledgement *pa,
   struct GNUNET_TIME_Relative delay;
 
   delay = GNUNET_TIME_absolute_get_duration (pa->transmission_time);
-  if (delay.rel_value_us > ack_delay.rel_value_us)
-    delay = GNUNET_TIME_UNIT_ZERO;
-  else
-    delay = GNUNET_TIME_relative_subtract (delay, ack_delay);
+  delay = GNUNET_TIME_relative_subtract (delay, ack_delay);
   if (NULL != pa->queue)
-    update_queue_performance (pa->queue, delay, pa->message_size);
+  {
+    struct Queue *queue = pa->queue;
+
+    update_queue_performance (queue, delay, pa->message_size);
+    if (pa->transmission_time.abs_value_us >
+        queue->rack_xmit_time.abs_value_us)
+    {
+      /* Defer loss detection until all ACKs in the current
+         message have been processed */
+      queue->rack_xmit_time = pa->transmission_time;
+      schedule_rack (queue, GNUNET_TIME_UNIT_ZERO_ABS);
+    }
+  }
   if (NULL != pa->dvh)
     update_dvh_performance (pa->dvh, delay, pa->message_size);
   if (NULL != pa->pm)
@@ -6310,6 +6788,7 @@ learn_dv_path (const struct GNUNET_PeerIdentity *path,
           GNUNET_TIME_relative_to_absolute (DV_PATH_VALIDITY_TIMEOUT);
         pos->path_valid_until =
           GNUNET_TIME_absolute_max (pos->path_valid_until, path_valid_until);
+        dv->alias[0].rebuild_at = GNUNET_TIME_UNIT_ZERO_ABS;
         GNUNET_CONTAINER_MDLL_remove (dv, dv->dv_head, dv->dv_tail, pos);
         GNUNET_CONTAINER_MDLL_insert (dv, dv->dv_head, dv->dv_tail, pos);
         if (0 <
@@ -6360,6 +6839,8 @@ learn_dv_path (const struct GNUNET_PeerIdentity *path,
   hop->distance = path_len - 2;
   hop->pd.aged_rtt = network_latency;
   GNUNET_CONTAINER_MDLL_insert (dv, dv->dv_head, dv->dv_tail, hop);
+  dv->alias[0].rebuild_at = GNUNET_TIME_UNIT_ZERO_ABS;
+  dv->alias[1].rebuild_at = GNUNET_TIME_UNIT_ZERO_ABS;
   GNUNET_CONTAINER_MDLL_insert (neighbour,
                                 next_hop->dv_head,
                                 next_hop->dv_tail,
@@ -8417,7 +8898,6 @@ fragment_message (struct Queue *queue,
               pm->logging_uuid,
               GNUNET_i2s (&pm->vl->target),
               (unsigned int) mtu);
-  pa = prepare_pending_acknowledgement (queue, dvh, pm);
 
   /* This invariant is established in #handle_add_queue_message() */
   GNUNET_assert (mtu > sizeof(struct TransportFragmentBoxMessage));
@@ -8471,7 +8951,7 @@ fragment_message (struct Queue *queue,
     tfb.header.type = htons (GNUNET_MESSAGE_TYPE_TRANSPORT_FRAGMENT);
     tfb.header.size =
       htons (sizeof(struct TransportFragmentBoxMessage) + fragsize);
-    tfb.ack_uuid = pa->ack_uuid;
+    memset (&tfb.ack_uuid, 0, sizeof(tfb.ack_uuid)); /* set below */
     tfb.msg_uuid = pm->msg_uuid;
     tfb.frag_off = htons (ff->frag_off + xoff);
     tfb.msg_size = htons (pm->bytes_msg);
@@ -8482,6 +8962,13 @@ fragment_message (struct Queue *queue,
     ff = frag;
   }
 
+  /* Each transmission of a fragment gets a fresh ACK UUID, so that
+     ACKs identify the transmission unambiguously and only fragments
+     that were actually lost need to be retransmitted */
+  pa = prepare_pending_acknowledgement (queue, dvh, ff);
+  GNUNET_assert (PMT_FRAGMENT_BOX == ff->pmt);
+  ((struct TransportFragmentBoxMessage *) &ff[1])->ack_uuid = pa->ack_uuid;
+
   /* Move head to the tail and return it */
   GNUNET_CONTAINER_MDLL_remove (frag,
                                 ff->frag_parent->head_frag,
@@ -8653,9 +9140,74 @@ struct PendingMessageScoreContext
    * Did we have to reliability box?
    */
   int relb;
+
+  /**
+   * Only consider messages of this traffic class, -1 for any.
+   */
+  int tclass;
+};
+
+
+/**
+ * Relative weights of the traffic classes: in multiples of
+ * #DRR_QUANTUM in the deficit round robin scheduler of a queue, and
+ * as divisors of #WFQ_BYTE_COST in the weighted fair queueing between
+ * the queues of a communicator.
+ */
+static const unsigned int
+  traffic_class_weight[GNUNET_TRANSPORT_TRAFFIC_CLASS_COUNT] = {
+  [GNUNET_TRANSPORT_TRAFFIC_LATENCY] = 4,
+  [GNUNET_TRANSPORT_TRAFFIC_RELIABILITY] = 2,
+  [GNUNET_TRANSPORT_TRAFFIC_BANDWIDTH] = 1
 };
 
 
+/**
+ * Determine the traffic class of a message based on its
+ * preferences.
+ *
+ * @param prefs preferences of the message
+ * @return traffic class the message belongs to
+ */
+static enum GNUNET_TRANSPORT_TrafficClass
+get_traffic_class (enum GNUNET_MQ_PriorityPreferences prefs)
+{
+  enum GNUNET_MQ_PriorityPreferences prio = prefs & GNUNET_MQ_PRIORITY_MASK;
+
+  if ((0 != (prefs & GNUNET_MQ_PREF_LOW_LATENCY)) ||
+      (GNUNET_MQ_PRIO_CRITICAL_CONTROL == prio))
+    return GNUNET_TRANSPORT_TRAFFIC_LATENCY;
+  if ((0 != (prefs & (GNUNET_MQ_PREF_GOODPUT | GNUNET_MQ_PREF_CORK_ALLOWED)))
+      ||
+      (GNUNET_MQ_PRIO_BACKGROUND == prio))
+    return GNUNET_TRANSPORT_TRAFFIC_BANDWIDTH;
+  return GNUNET_TRANSPORT_TRAFFIC_RELIABILITY;
+}
+
+
+/**
+ * Account for a message of traffic class @a tclass that waited
+ * @a delay before being given to the communicator via @a queue.
+ *
+ * @param queue queue the message was transmitted on
+ * @param tclass traffic class of the message
+ * @param delay how long the message waited
+ */
+static void
+update_latency_histogram (struct Queue *queue,
+                          enum GNUNET_TRANSPORT_TrafficClass tclass,
+                          struct GNUNET_TIME_Relative delay)
+{
+  uint64_t delay_ms = delay.rel_value_us / 1000LLU;
+  unsigned int bucket = 0;
+
+  while ((bucket < GNUNET_TRANSPORT_MONITOR_LATENCY_BUCKETS - 1) &&
+         (delay_ms >= (1LLU << bucket)))
+    bucket++;
+  queue->latency_histogram[tclass][bucket]++;
+}
+
+
 /**
  * Select the best pending message from @a vl for transmission
  * via @a queue.
@@ -8690,6 +9242,9 @@ select_best_pending_from_link (struct PendingMessageScoreContext *sc,
       break;   /* too early for all messages, they are sorted by next_attempt */
     if (NULL != pos->qe)
       continue;   /* not eligible */
+    if ((0 <= sc->tclass) &&
+        (sc->tclass != (int) get_traffic_class (pos->prefs)))
+      continue;   /* not the traffic class we are serving right now */
     sc->consideration_counter++;
     /* determine if we have to fragment, if so add fragmentation
        overhead! */
@@ -8808,6 +9363,126 @@ extract_box_cb (void *cls,
 }
 
 
+/**
+ * Select the best pending message for transmission via @a queue,
+ * first from the virtual link of the queue's neighbour and then
+ * from virtual links that would use the neighbour as first DV hop.
+ *
+ * @param sc[in,out] scoring context, @e tclass must be set
+ * @param queue the queue that will be used for transmission
+ */
+static void
+select_best_pending_for_queue (struct PendingMessageScoreContext *sc,
+                               struct Queue *queue)
+{
+  struct Neighbour *n = queue->neighbour;
+
+  select_best_pending_from_link (sc, queue, n->vl, NULL, 0);
+  if (NULL != sc->best)
+    return;
+  /* Also look at DVH that have the n as first hop! */
+  for (struct DistanceVectorHop *dvh = n->dv_head; NULL != dvh;
+       dvh = dvh->next_neighbour)
+  {
+    select_best_pending_from_link (sc,
+                                   queue,
+                                   dvh->dv->vl,
+                                   dvh,
+                                   sizeof(struct GNUNET_PeerIdentity)
+                                   * (1 + dvh->distance)
+                                   + sizeof(struct TransportDVBoxMessage)
+                                   + sizeof(struct TransportDVBoxPayloadP));
+  }
+}
+
+
+/**
+ * Charge @a queue for passing @a size bytes of traffic class @a tclass
+ * to its communicator, in the weighted fair queueing between the
+ * queues of the communicator.  A queue that was idle starts at the
+ * current virtual time, so it cannot save up credit.  The queue then
+ * moves back in the communicator's list, behind all queues with an
+ * earlier virtual finish time.
+ *
+ * @param queue queue that transmitted
+ * @param tclass traffic class of the message
+ * @param size number of bytes of the message
+ */
+static void
+wfq_charge (struct Queue *queue,
+            enum GNUNET_TRANSPORT_TrafficClass tclass,
+            size_t size)
+{
+  struct TransportClient *tc = queue->tc;
+  struct Queue *pos;
+
+  tc->details.communicator.wfq_vtime =
+    GNUNET_MAX (queue->wfq_finish,
+                tc->details.communicator.wfq_vtime);
+  queue->wfq_finish = tc->details.communicator.wfq_vtime
+                      + (uint64_t) size * WFQ_BYTE_COST
+                      / traffic_class_weight[tclass];
+  pos = queue;
+  while ((NULL != pos->next_client) &&
+         (pos->next_client->wfq_finish <= queue->wfq_finish))
+    pos = pos->next_client;
+  if (pos == queue)
+    return;
+  GNUNET_CONTAINER_MDLL_remove (client,
+                                tc->details.communicator.queue_head,
+                                tc->details.communicator.queue_tail,
+                                queue);
+  GNUNET_CONTAINER_MDLL_insert_after (client,
+                                      tc->details.communicator.queue_head,
+                                      tc->details.communicator.queue_tail,
+                                      pos,
+                                      queue);
+}
+
+
+/**
+ * Run the deficit round robin scheduler of @a queue to select the
+ * next message to transmit.  Traffic classes take turns; in its
+ * turn, a class may transmit as long as it has credit left, and it
+ * gets credit proportional to its weight at the start of each turn.
+ * Classes without pending messages lose their credit.  If no class
+ * with credit has anything to send, we pick the best message of any
+ * class (without charging it), so the scheduler is work-conserving.
+ *
+ * @param sc[out] scoring context to fill
+ * @param queue the queue that will be used for transmission
+ * @return #GNUNET_YES if the traffic class of the selected message
+ *         must be charged for the transmission
+ */
+static int
+select_best_pending_drr (struct PendingMessageScoreContext *sc,
+                         struct Queue *queue)
+{
+  memset (sc, 0, sizeof(*sc));
+  for (unsigned int i = 0; i < GNUNET_TRANSPORT_TRAFFIC_CLASS_COUNT; i++)
+  {
+    enum GNUNET_TRANSPORT_TrafficClass tclass = queue->drr_class;
+
+    if (queue->drr_deficit[tclass] > 0)
+    {
+      sc->tclass = (int) tclass;
+      select_best_pending_for_queue (sc, queue);
+      if (NULL != sc->best)
+        return GNUNET_YES;
+      /* idle classes must not accumulate credit */
+      queue->drr_deficit[tclass] = 0;
+    }
+    /* turn over to the next class */
+    queue->drr_class = (tclass + 1) % GNUNET_TRANSPORT_TRAFFIC_CLASS_COUNT;
+    queue->drr_deficit[queue->drr_class] +=
+      (int64_t) traffic_class_weight[queue->drr_class] * DRR_QUANTUM;
+  }
+  sc->tclass = -1;
+  select_best_pending_for_queue (sc, queue);
+  return GNUNET_NO;
+}
+
+
 /**
  * We believe we are ready to transmit a `struct PendingMessage` on a
  * queue, the big question is which one!  We need to see if there is
@@ -8830,6 +9505,8 @@ transmit_on_queue (void *cls)
   struct Neighbour *n = queue->neighbour;
   struct PendingMessageScoreContext sc;
   struct PendingMessage *pm;
+  enum GNUNET_TRANSPORT_TrafficClass tclass;
+  int charge;
 
   queue->transmit_task = NULL;
   if (NULL == n->vl)
@@ -8841,24 +9518,7 @@ transmit_on_queue (void *cls)
     queue->idle = GNUNET_YES;
     return;
   }
-  memset (&sc, 0, sizeof(sc));
-  select_best_pending_from_link (&sc, queue, n->vl, NULL, 0);
-  if (NULL == sc.best)
-  {
-    /* Also look at DVH that have the n as first hop! */
-    for (struct DistanceVectorHop *dvh = n->dv_head; NULL != dvh;
-         dvh = dvh->next_neighbour)
-    {
-      select_best_pending_from_link (&sc,
-                                     queue,
-                                     dvh->dv->vl,
-                                     dvh,
-                                     sizeof(struct GNUNET_PeerIdentity)
-                                     * (1 + dvh->distance)
-                                     + sizeof(struct TransportDVBoxMessage)
-                                     + sizeof(struct TransportDVBoxPayloadP));
-    }
-  }
+  charge = select_best_pending_drr (&sc, queue);
   if (NULL == sc.best)
   {
     /* no message pending, nothing to do here! */
@@ -8926,6 +9586,22 @@ transmit_on_queue (void *cls)
     }
   }
 
+  /* Account for the transmission with the scheduler of the queue */
+  tclass = get_traffic_class (sc.best->prefs);
+  if (GNUNET_YES == charge)
+    queue->drr_deficit[tclass] -= pm->bytes_msg;
+  if (0 != sc.best->queued_at.abs_value_us)
+  {
+    update_latency_histogram (queue,
+                              tclass,
+                              GNUNET_TIME_absolute_get_duration (
+                                sc.best->queued_at));
+    sc.best->queued_at = GNUNET_TIME_UNIT_ZERO_ABS;
+  }
+  wfq_charge (queue,
+              tclass,
+              pm->bytes_msg);
+
   /* Pass 'pm' for transission to the communicator */
   GNUNET_log (
     GNUNET_ERROR_TYPE_DEBUG,
@@ -8984,6 +9660,15 @@ transmit_on_queue (void *cls)
                             GNUNET_TIME_relative_to_absolute (
                               GNUNET_TIME_relative_multiply (queue->pd.aged_rtt,
                                                              4)));
+    /* Loss detection will usually trigger the retransmission much
+       earlier; make sure we probe if the tail of our transmissions
+       goes unacknowledged. */
+    if (GNUNET_TIME_UNIT_FOREVER_REL.rel_value_us !=
+        queue->pd.aged_rtt.rel_value_us)
+      schedule_rack (queue,
+                     GNUNET_TIME_relative_to_absolute (
+                       GNUNET_TIME_relative_multiply (queue->pd.aged_rtt,
+                                                      TLP_RTT_FACTOR)));
   }
   /* finally, re-schedule queue transmission task itself */
   schedule_transmit_on_queue (queue, GNUNET_SCHEDULER_PRIORITY_DEFAULT);
@@ -9167,7 +9852,8 @@ notify_client_queues (void *cls,
     struct MonitorEvent me = { .rtt = q->pd.aged_rtt,
                                .cs = q->cs,
                                .num_msg_pending = q->num_msg_pending,
-                               .num_bytes_pending = q->num_bytes_pending };
+                               .num_bytes_pending = q->num_bytes_pending,
+                               .latency_histogram = q->latency_histogram };
 
     notify_monitor (tc, pid, q->address, q->nt, &me);
   }
@@ -0,0 +1,210 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2021 GNUnet e.V.
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+/**
+ * @file transport/test_communicator_tcp_crypto.c
+ * @brief testcase for the crypto workers of the TCP communicator:
+ *        plaintext queued while a worker job is in flight must be
+ *        encrypted before the main thread writes ciphertext itself
+ */
+#define main communicator_tcp_main
+#include "gnunet-communicator-tcp.c"
+#undef main
+
+/**
+ * Number of boxes we queue.
+ */
+#define BOXES 8
+
+static int ok;
+
+
+/**
+ * Size of the payload of box @a i.
+ *
+ * @param i index of the box
+ * @return payload size
+ */
+static size_t
+box_size (unsigned int i)
+{
+  return 100 + 977 * i;
+}
+
+
+/**
+ * Append box @a i as plaintext to the write ring buffer of @a queue,
+ * the way #queue_write() does it when crypto workers are used.
+ *
+ * @param queue queue to append to
+ * @param i index of the box
+ */
+static void
+append_box (struct Queue *queue,
+            unsigned int i)
+{
+  struct TCPBox box;
+  char payload[box_size (i)];
+
+  memset (&box, 0, sizeof(box));
+  box.header.type = htons (GNUNET_MESSAGE_TYPE_COMMUNICATOR_TCP_BOX);
+  box.header.size = htons (box_size (i));
+  memset (payload, (int) i, sizeof(payload));
+  ring_write (queue->cwrite_buf,
+              queue->cwrite_start + queue->cwrite_off + queue->cplain_off,
+              &box,
+              sizeof(box));
+  queue->cplain_off += sizeof(box);
+  ring_write (queue->cwrite_buf,
+              queue->cwrite_start + queue->cwrite_off + queue->cplain_off,
+              payload,
+              sizeof(payload));
+  queue->cplain_off += sizeof(payload);
+}
+
+
+/**
+ * Decrypt the ciphertext in the write ring buffer of @a queue and
+ * check the boxes and their HMACs.
+ *
+ * @param queue queue to check
+ * @param in_cipher cipher of the receiver
+ * @param in_hmac HMAC secret of the receiver
+ * @return #GNUNET_OK if all boxes arrived intact
+ */
+static int
+check_boxes (struct Queue *queue,
+             gcry_cipher_hd_t in_cipher,
+             struct GNUNET_HashCode *in_hmac)
+{
+  char *plain;
+  size_t off = 0;
+
+  plain = GNUNET_malloc (queue->cwrite_off);
+  ring_read (queue->cwrite_buf,
+             queue->cwrite_start,
+             plain,
+             queue->cwrite_off);
+  GNUNET_assert (0 ==
+                 gcry_cipher_decrypt (in_cipher,
+                                      plain,
+                                      queue->cwrite_off,
+                                      NULL,
+                                      0));
+  for (unsigned int i = 0; i < BOXES; i++)
+  {
+    struct TCPBox box;
+    struct GNUNET_ShortHashCode hmac;
+    char expected[box_size (i)];
+
+    memcpy (&box, &plain[off], sizeof(box));
+    off += sizeof(box);
+    if (box_size (i) != ntohs (box.header.size))
+      break;
+    calculate_hmac (in_hmac,
+                    &plain[off],
+                    box_size (i),
+                    &hmac);
+    if (0 != GNUNET_memcmp (&hmac,
+                            &box.hmac))
+      break;
+    memset (expected, (int) i, sizeof(expected));
+    if (0 != memcmp (expected,
+                     &plain[off],
+                     sizeof(expected)))
+      break;
+    off += box_size (i);
+  }
+  GNUNET_free (plain);
+  return (off == queue->cwrite_off) ? GNUNET_OK : GNUNET_SYSERR;
+}
+
+
+static void
+run_test (void *cls)
+{
+  struct Queue *queue;
+  struct GNUNET_HashCode dh;
+  gcry_cipher_hd_t in_cipher;
+  struct GNUNET_HashCode in_hmac;
+  int sv[2];
+
+  crypto_pool = GNUNET_THREAD_pool_create (2);
+  GNUNET_assert (0 == socketpair (AF_UNIX, SOCK_STREAM, 0, sv));
+  queue = GNUNET_new (struct Queue);
+  queue->sock = GNUNET_NETWORK_socket_box_native (sv[0]);
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                              &dh,
+                              sizeof(dh));
+  setup_cipher (&dh, &my_identity, &queue->out_cipher, &queue->out_hmac);
+  setup_cipher (&dh, &my_identity, &in_cipher, &in_hmac);
+  /* a job is in flight ... */
+  append_box (queue, 0);
+  crypto_encrypt_submit (queue);
+  /* ... while the MQ queues more plaintext */
+  for (unsigned int i = 1; i < BOXES; i++)
+    append_box (queue, i);
+  crypto_sync (queue);
+  if ((NULL != queue->crypto_out_job) ||
+      (0 != queue->cplain_off))
+  {
+    fprintf (stderr,
+             "Plaintext left after sync\n");
+    ok = 1;
+  }
+  else if (GNUNET_OK !=
+           check_boxes (queue,
+                        in_cipher,
+                        &in_hmac))
+  {
+    fprintf (stderr,
+             "Boxes corrupted\n");
+    ok = 1;
+  }
+  if (NULL != queue->write_task)
+    GNUNET_SCHEDULER_cancel (queue->write_task);
+  crypto_cancel (queue);
+  gcry_cipher_close (queue->out_cipher);
+  gcry_cipher_close (in_cipher);
+  GNUNET_break (GNUNET_OK ==
+                GNUNET_NETWORK_socket_close (queue->sock));
+  GNUNET_break (0 == close (sv[1]));
+  GNUNET_free (queue);
+  GNUNET_THREAD_pool_destroy (crypto_pool);
+  crypto_pool = NULL;
+}
+
+
+int
+main (int argc,
+      char *argv[])
+{
+  GNUNET_log_setup ("test-communicator-tcp-crypto",
+                    "WARNING",
+                    NULL);
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                              &my_identity,
+                              sizeof(my_identity));
+  GNUNET_SCHEDULER_run (&run_test,
+                        NULL);
+  return ok;
+}
+
+
+/* end of test_communicator_tcp_crypto.c */
@@ -1102,6 +1102,25 @@ struct GNUNET_TRANSPORT_MonitorStart
 };
 
 
+/**
+ * Number of traffic classes with a latency histogram in a monitor
+ * data message, must equal #GNUNET_TRANSPORT_TRAFFIC_CLASS_COUNT.
+ */
+#define MONITOR_LATENCY_CLASSES 3
+
+/**
+ * Number of (log2 ms) buckets of each latency histogram in a monitor
+ * data message, must equal #GNUNET_TRANSPORT_MONITOR_LATENCY_BUCKETS.
+ */
+#define MONITOR_LATENCY_BUCKETS 16
+
+/**
+ * Number of latency histogram entries in a monitor data message.
+ */
+#define MONITOR_LATENCY_HISTOGRAM_SIZE \
+  (MONITOR_LATENCY_CLASSES * MONITOR_LATENCY_BUCKETS)
+
+
 /**
  * Monitoring data.
  */
@@ -1149,6 +1168,12 @@ struct GNUNET_TRANSPORT_MonitorData
    */
   uint32_t num_bytes_pending GNUNET_PACKED;
 
+  /**
+   * Per traffic class latency histograms (in NBO), see
+   * #MONITOR_LATENCY_HISTOGRAM_SIZE.
+   */
+  uint32_t latency_histogram[MONITOR_LATENCY_HISTOGRAM_SIZE] GNUNET_PACKED;
+
   /* Followed by 0-terminated address of the peer */
 };
 
@@ -161,6 +161,8 @@ handle_monitor_data (void *cls, const struct GNUNET_TRANSPORT_MonitorData *md)
   struct GNUNET_TRANSPORT_MonitorContext *mc = cls;
   struct GNUNET_TRANSPORT_MonitorInformation mi;
 
+  GNUNET_static_assert (sizeof (mi.latency_histogram)
+                        == sizeof (md->latency_histogram));
   mi.address = (const char *) &md[1];
   mi.nt = (enum GNUNET_NetworkType) ntohl (md->nt);
   mi.cs = (enum GNUNET_TRANSPORT_ConnectionStatus) ntohl (md->cs);
@@ -170,6 +172,11 @@ handle_monitor_data (void *cls, const struct GNUNET_TRANSPORT_MonitorData *md)
   mi.valid_until = GNUNET_TIME_absolute_ntoh (md->valid_until);
   mi.next_validation = GNUNET_TIME_absolute_ntoh (md->next_validation);
   mi.rtt = GNUNET_TIME_relative_ntoh (md->rtt);
+  for (unsigned int i = 0; i < GNUNET_TRANSPORT_TRAFFIC_CLASS_COUNT; i++)
+    for (unsigned int j = 0; j < GNUNET_TRANSPORT_MONITOR_LATENCY_BUCKETS; j++)
+      mi.latency_histogram[i][j] =
+        ntohl (md->latency_histogram[i * GNUNET_TRANSPORT_MONITOR_LATENCY_BUCKETS
+                                     + j]);
   mc->cb (mc->cb_cls, &md->peer, &mi);
 }
 
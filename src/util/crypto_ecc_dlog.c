@@ -29,6 +29,85 @@
 #include <gcrypt.h>
 #include "gnunet_crypto_lib.h"
 #include "gnunet_container_lib.h"
+#include "gnunet_disk_lib.h"
+#include "gnunet_thread_pool_lib.h"
+
+
+/**
+ * Magic value at the start of a file with pre-calculated values.
+ */
+#define DLOG_TABLE_MAGIC "GNDLOG\0\1"
+
+/**
+ * How many entries of a table loaded from disk do we check by
+ * calculating them again?
+ */
+#define DLOG_SPOT_CHECKS 16
+
+/**
+ * Minimum number of points a thread should go over, splitting
+ * the work more finely costs more than it saves.
+ */
+#define DLOG_MIN_STEPS_PER_THREAD 128
+
+/**
+ * Maximum number of threads for the DLOG calculation.
+ */
+#define DLOG_MAX_THREADS 16
+
+
+GNUNET_NETWORK_STRUCT_BEGIN
+
+/**
+ * Header of the pre-calculated values, both in memory and on disk.
+ * Followed by @e count `struct DlogEntry`, sorted by point.
+ */
+struct DlogTableHeader
+{
+  /**
+   * Must be #DLOG_TABLE_MAGIC.
+   */
+  char magic[8];
+
+  /**
+   * Maximum absolute value the table supports, in NBO.
+   */
+  uint32_t max GNUNET_PACKED;
+
+  /**
+   * Memory parameter the table was calculated for, in NBO.
+   */
+  uint32_t mem GNUNET_PACKED;
+
+  /**
+   * Number of entries following the header, in NBO.
+   */
+  uint32_t count GNUNET_PACKED;
+
+  /**
+   * Always zero.
+   */
+  uint32_t reserved GNUNET_PACKED;
+};
+
+
+/**
+ * Pre-calculated point.
+ */
+struct DlogEntry
+{
+  /**
+   * The point K*i*G.
+   */
+  struct GNUNET_CRYPTO_EccPoint point;
+
+  /**
+   * The multiple i of K, in NBO.
+   */
+  int32_t i GNUNET_PACKED;
+};
+
+GNUNET_NETWORK_STRUCT_END
 
 
 /**
@@ -47,12 +126,52 @@ struct GNUNET_CRYPTO_EccDlogContext
   unsigned int mem;
 
   /**
-   * Map mapping points (here "interpreted" as EdDSA public keys) to
-   * a "void * = long" which corresponds to the numeric value of the
-   * point.  As NULL is used to represent "unknown", the actual value
-   * represented by the entry in the map is the "long" minus @e max.
+   * The pre-calculated values, either in memory or mapped from disk.
+   */
+  const struct DlogTableHeader *header;
+
+  /**
+   * The entries following @e header, sorted by point, so that we can
+   * keep them in a flat array and look them up via @e index.
+   */
+  const struct DlogEntry *table;
+
+  /**
+   * Number of entries in @e table.
+   */
+  uint32_t count;
+
+  /**
+   * Maps the top @e index_bits bits of a point to the first entry
+   * in @e table with these bits.  Has 2^index_bits + 1 entries.
+   */
+  uint32_t *index;
+
+  /**
+   * Number of bits of a point used by @e index.
+   */
+  unsigned int index_bits;
+
+  /**
+   * Worker threads for the DLOG calculation, shared by all calls of
+   * #GNUNET_CRYPTO_ecc_dlog() with this context.
+   */
+  struct GNUNET_THREAD_Pool *pool;
+
+  /**
+   * Memory we allocated for @e header, NULL if it is mapped.
    */
-  struct GNUNET_CONTAINER_MultiPeerMap *map;
+  void *buf;
+
+  /**
+   * File with the pre-calculated values, NULL if they are in memory.
+   */
+  struct GNUNET_DISK_FileHandle *fh;
+
+  /**
+   * Mapping of @e fh.
+   */
+  struct GNUNET_DISK_MapHandle *mh;
 
   /**
    * Context to use for operations on the elliptic curve.
@@ -61,133 +180,609 @@ struct GNUNET_CRYPTO_EccDlogContext
 };
 
 
+/**
+ * Work of one thread, either for calculating entries of the table
+ * or for calculating a DLOG.
+ */
+struct DlogWorker
+{
+  /**
+   * The job doing this part, NULL for the calling thread.
+   */
+  struct GNUNET_THREAD_Job *job;
+
+  /**
+   * The context.
+   */
+  const struct GNUNET_CRYPTO_EccDlogContext *edc;
+
+  /**
+   * Table to fill, when calculating entries.
+   */
+  struct DlogEntry *entries;
+
+  /**
+   * Point to take the DLOG of, when calculating a DLOG.
+   */
+  const struct GNUNET_CRYPTO_EccPoint *input;
+
+  /**
+   * First step of the thread.
+   */
+  int start;
+
+  /**
+   * Last step of the thread.
+   */
+  int end;
+
+  /**
+   * Result, INT_MAX if not found (yet).
+   */
+  int res;
+};
+
+
+/**
+ * Get the number of the multiplier K the table contains the
+ * multiples of.
+ *
+ * @param max maximum value the calculation supports
+ * @param mem memory parameter of the calculation
+ * @return K
+ */
+static unsigned int
+get_k (unsigned int max,
+       unsigned int mem)
+{
+  return (max + (mem - 1)) / mem;
+}
+
+
+/**
+ * Calculate @a val * G.
+ *
+ * @param val the factor
+ * @param[out] r where to write the point
+ */
+static void
+calc_point (int val,
+            struct GNUNET_CRYPTO_EccPoint *r)
+{
+  struct GNUNET_CRYPTO_EccScalar s;
+
+  if (0 == val) /* libsodium does not like to multiply with zero */
+  {
+    /* the neutral element, y = 1 */
+    memset (r,
+            0,
+            sizeof (*r));
+    r->v[0] = 1;
+    return;
+  }
+  GNUNET_CRYPTO_ecc_scalar_from_int (val,
+                                     &s);
+  GNUNET_assert (
+    0 ==
+    crypto_scalarmult_ed25519_base_noclamp (r->v,
+                                            s.v));
+}
+
+
+/**
+ * Get the bucket of @a p in the index of @a edc.
+ *
+ * @param edc the context
+ * @param p the point
+ * @return the bucket
+ */
+static uint32_t
+get_bucket (const struct GNUNET_CRYPTO_EccDlogContext *edc,
+            const struct GNUNET_CRYPTO_EccPoint *p)
+{
+  uint32_t prefix;
+
+  if (0 == edc->index_bits)
+    return 0;
+  GNUNET_memcpy (&prefix,
+                 p->v,
+                 sizeof (prefix));
+  return ntohl (prefix) >> (32 - edc->index_bits);
+}
+
+
+/**
+ * Look up a point in the table of pre-calculated values.
+ *
+ * @param edc the context
+ * @param p the point
+ * @param[out] i set to the multiple of K of @a p if found
+ * @return #GNUNET_YES if @a p is in the table
+ */
+static enum GNUNET_GenericReturnValue
+lookup_point (const struct GNUNET_CRYPTO_EccDlogContext *edc,
+              const struct GNUNET_CRYPTO_EccPoint *p,
+              int *i)
+{
+  uint32_t bucket = get_bucket (edc,
+                                p);
+
+  for (uint32_t off = edc->index[bucket];
+       off < edc->index[bucket + 1];
+       off++)
+  {
+    int cmp = memcmp (&edc->table[off].point,
+                      p,
+                      sizeof (*p));
+
+    if (0 == cmp)
+    {
+      *i = (int32_t) ntohl (edc->table[off].i);
+      return GNUNET_YES;
+    }
+    if (cmp > 0)
+      break;
+  }
+  return GNUNET_NO;
+}
+
+
+/**
+ * Compare two entries of the table by point, for qsort().
+ */
+static int
+cmp_entry (const void *a,
+           const void *b)
+{
+  const struct DlogEntry *ea = a;
+  const struct DlogEntry *eb = b;
+
+  return memcmp (&ea->point,
+                 &eb->point,
+                 sizeof (ea->point));
+}
+
+
+/**
+ * Run @a cb in the calling thread and the threads of @a tp, splitting
+ * the steps from @a start to @a end (inclusive) evenly among them.
+ *
+ * @param tp pool with the other threads to use
+ * @param start first step
+ * @param end last step
+ * @param proto initial state of every worker
+ * @param cb function doing the work of one worker
+ * @return INT_MAX, or the last result found by a worker
+ */
+static int
+run_workers (struct GNUNET_THREAD_Pool *tp,
+             int start,
+             int end,
+             const struct DlogWorker *proto,
+             GNUNET_THREAD_JobWork cb)
+{
+  struct DlogWorker workers[DLOG_MAX_THREADS];
+  unsigned int threads = 1 + GNUNET_THREAD_pool_get_size (tp);
+  unsigned int steps = end - start + 1;
+  int res = INT_MAX;
+
+  threads = GNUNET_MIN (threads,
+                        steps / DLOG_MIN_STEPS_PER_THREAD);
+  threads = GNUNET_MAX (threads,
+                        1);
+  for (unsigned int t = 0; t < threads; t++)
+  {
+    workers[t] = *proto;
+    workers[t].start = start + (int) ((uint64_t) steps * t / threads);
+    workers[t].end = start + (int) ((uint64_t) steps * (t + 1) / threads) - 1;
+    workers[t].res = INT_MAX;
+  }
+  /* the calling thread does the first part of the work */
+  for (unsigned int t = 1; t < threads; t++)
+    workers[t].job = GNUNET_THREAD_pool_submit (tp,
+                                                cb,
+                                                NULL,
+                                                &workers[t]);
+  cb (&workers[0]);
+  for (unsigned int t = 1; t < threads; t++)
+    GNUNET_THREAD_pool_wait (workers[t].job);
+  for (unsigned int t = 0; t < threads; t++)
+    if (INT_MAX != workers[t].res)
+      res = workers[t].res;
+  return res;
+}
+
+
+/**
+ * Calculate the entries of the table from the worker's
+ * @e start to its @e end.
+ *
+ * @param cls the `struct DlogWorker`
+ */
+static void
+calc_entries (void *cls)
+{
+  struct DlogWorker *w = cls;
+  unsigned int K = get_k (w->edc->max,
+                          w->edc->mem);
+
+  for (int i = w->start; i <= w->end; i++)
+  {
+    struct DlogEntry *e = &w->entries[i + (int) w->edc->mem];
+
+    calc_point ((int) K * i,
+                &e->point);
+    e->i = htonl ((uint32_t) i);
+  }
+}
+
+
+/**
+ * Create the pool of worker threads for the DLOG calculation, with
+ * one thread less than there are CPUs on this system, as the calling
+ * thread also does some of the work.
+ *
+ * @return the pool
+ */
+static struct GNUNET_THREAD_Pool *
+create_pool (void)
+{
+  long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+
+  if (ncpu < 1)
+    ncpu = 1;
+  return GNUNET_THREAD_pool_create (
+    GNUNET_MIN ((unsigned long) ncpu,
+                DLOG_MAX_THREADS) - 1);
+}
+
+
+/**
+ * Create a context for a table of pre-calculated values.
+ *
+ * @param header the table
+ * @param tp worker threads for the context, which takes them over
+ * @return the context
+ */
+static struct GNUNET_CRYPTO_EccDlogContext *
+create_context (const struct DlogTableHeader *header,
+                struct GNUNET_THREAD_Pool *tp)
+{
+  struct GNUNET_CRYPTO_EccDlogContext *edc;
+  uint32_t buckets;
+
+  edc = GNUNET_new (struct GNUNET_CRYPTO_EccDlogContext);
+  edc->max = ntohl (header->max);
+  edc->mem = ntohl (header->mem);
+  edc->header = header;
+  edc->table = (const struct DlogEntry *) &header[1];
+  edc->count = ntohl (header->count);
+  edc->pool = tp;
+  /* about one entry per bucket */
+  while ( (edc->index_bits < 24) &&
+          ((1u << edc->index_bits) < edc->count) )
+    edc->index_bits++;
+  buckets = 1u << edc->index_bits;
+  edc->index = GNUNET_new_array (buckets + 1,
+                                 uint32_t);
+  for (uint32_t off = 0; off < edc->count; off++)
+    edc->index[get_bucket (edc,
+                           &edc->table[off].point) + 1]++;
+  for (uint32_t b = 0; b < buckets; b++)
+    edc->index[b + 1] += edc->index[b];
+  return edc;
+}
+
+
+/**
+ * Calculate the table of pre-calculated values in memory.
+ *
+ * @param max maximum value the factor can be
+ * @param mem memory to use
+ * @param tp worker threads to use
+ * @return the table, NULL if we are out of memory
+ */
+static struct DlogTableHeader *
+calc_table (unsigned int max,
+            unsigned int mem,
+            struct GNUNET_THREAD_Pool *tp)
+{
+  struct DlogTableHeader *header;
+  struct GNUNET_CRYPTO_EccDlogContext tmp;
+  struct DlogWorker proto;
+  uint32_t count = 2 * mem + 1;
+
+  header = GNUNET_malloc_large (sizeof (*header)
+                                + count * sizeof (struct DlogEntry));
+  if (NULL == header)
+    return NULL;
+  GNUNET_memcpy (header->magic,
+                 DLOG_TABLE_MAGIC,
+                 sizeof (header->magic));
+  header->max = htonl (max);
+  header->mem = htonl (mem);
+  header->count = htonl (count);
+  header->reserved = htonl (0);
+  memset (&tmp,
+          0,
+          sizeof (tmp));
+  tmp.max = max;
+  tmp.mem = mem;
+  memset (&proto,
+          0,
+          sizeof (proto));
+  proto.edc = &tmp;
+  proto.entries = (struct DlogEntry *) &header[1];
+  (void) run_workers (tp,
+                      -(int) mem,
+                      (int) mem,
+                      &proto,
+                      &calc_entries);
+  qsort (&header[1],
+         count,
+         sizeof (struct DlogEntry),
+         &cmp_entry);
+  return header;
+}
+
+
 struct GNUNET_CRYPTO_EccDlogContext *
 GNUNET_CRYPTO_ecc_dlog_prepare (unsigned int max,
                                 unsigned int mem)
 {
   struct GNUNET_CRYPTO_EccDlogContext *edc;
-  int K = ((max + (mem - 1)) / mem);
+  struct GNUNET_THREAD_Pool *tp;
+  struct DlogTableHeader *header;
 
   GNUNET_assert (max < INT32_MAX);
-  edc = GNUNET_new (struct GNUNET_CRYPTO_EccDlogContext);
-  edc->max = max;
-  edc->mem = mem;
-  edc->map = GNUNET_CONTAINER_multipeermap_create (mem * 2,
-                                                   GNUNET_NO);
-  for (int i = -(int) mem; i <= (int) mem; i++)
+  GNUNET_assert (mem < INT32_MAX / 2);
+  tp = create_pool ();
+  header = calc_table (max,
+                       mem,
+                       tp);
+  if (NULL == header)
   {
-    struct GNUNET_CRYPTO_EccScalar Ki;
-    struct GNUNET_PeerIdentity key;
-
-    GNUNET_CRYPTO_ecc_scalar_from_int (K * i,
-                                       &Ki);
-    if (0 == i) /* libsodium does not like to multiply with zero */
-      GNUNET_assert (
-        0 ==
-        crypto_core_ed25519_sub ((unsigned char *) &key,
-                                 (unsigned char *) &key,
-                                 (unsigned char *) &key));
-    else
-      GNUNET_assert (
-        0 ==
-        crypto_scalarmult_ed25519_base_noclamp ((unsigned char*) &key,
-                                                Ki.v));
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                "K*i: %d (mem=%u, i=%d) => %s\n",
-                K * i,
-                mem,
-                i,
-                GNUNET_i2s (&key));
-    GNUNET_assert (GNUNET_OK ==
-                   GNUNET_CONTAINER_multipeermap_put (edc->map,
-                                                      &key,
-                                                      (void *) (long) i + max,
-                                                      GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+    GNUNET_THREAD_pool_destroy (tp);
+    return NULL;
   }
+  edc = create_context (header,
+                        tp);
+  edc->buf = header;
   return edc;
 }
 
 
-int
-GNUNET_CRYPTO_ecc_dlog (struct GNUNET_CRYPTO_EccDlogContext *edc,
-                        const struct GNUNET_CRYPTO_EccPoint *input)
+/**
+ * Check that a table of pre-calculated values loaded from disk
+ * is what we want.
+ *
+ * @param header the table
+ * @param size size of the table
+ * @param max maximum value the factor can be
+ * @param mem memory to use
+ * @return #GNUNET_OK if the table is good
+ */
+static enum GNUNET_GenericReturnValue
+check_table (const struct DlogTableHeader *header,
+             size_t size,
+             unsigned int max,
+             unsigned int mem)
 {
-  unsigned int K = ((edc->max + (edc->mem - 1)) / edc->mem);
-  int res;
+  const struct DlogEntry *table = (const struct DlogEntry *) &header[1];
+  uint32_t count = 2 * mem + 1;
+  unsigned int K = get_k (max,
+                          mem);
+
+  if ( (size != sizeof (*header) + count * sizeof (struct DlogEntry)) ||
+       (0 != memcmp (header->magic,
+                     DLOG_TABLE_MAGIC,
+                     sizeof (header->magic))) ||
+       (max != ntohl (header->max)) ||
+       (mem != ntohl (header->mem)) ||
+       (count != ntohl (header->count)) )
+    return GNUNET_SYSERR;
+  for (uint32_t off = 1; off < count; off++)
+    if (0 <= cmp_entry (&table[off - 1],
+                        &table[off]))
+      return GNUNET_SYSERR;
+  /* check some of the entries, the file could have been
+     written for a different curve or be damaged */
+  for (unsigned int c = 0; c < DLOG_SPOT_CHECKS; c++)
+  {
+    uint32_t off = GNUNET_CRYPTO_random_u32 (GNUNET_CRYPTO_QUALITY_WEAK,
+                                             count);
+    int i = (int32_t) ntohl (table[off].i);
+    struct GNUNET_CRYPTO_EccPoint p;
+
+    if ( (i < -(int) mem) ||
+         (i > (int) mem) )
+      return GNUNET_SYSERR;
+    calc_point ((int) K * i,
+                &p);
+    if (0 != GNUNET_memcmp (&p,
+                            &table[off].point))
+      return GNUNET_SYSERR;
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Map a table of pre-calculated values from disk.
+ *
+ * @param max maximum value the factor can be
+ * @param mem memory to use
+ * @param filename file with the table
+ * @return NULL if the file does not exist or does not have the
+ *         table we want
+ */
+static struct GNUNET_CRYPTO_EccDlogContext *
+load_table (unsigned int max,
+            unsigned int mem,
+            const char *filename)
+{
+  struct GNUNET_CRYPTO_EccDlogContext *edc;
+  struct GNUNET_DISK_FileHandle *fh;
+  struct GNUNET_DISK_MapHandle *mh;
+  const struct DlogTableHeader *header;
+  off_t size;
+
+  if (GNUNET_YES !=
+      GNUNET_DISK_file_test (filename))
+    return NULL;
+  fh = GNUNET_DISK_file_open (filename,
+                              GNUNET_DISK_OPEN_READ,
+                              GNUNET_DISK_PERM_NONE);
+  if (NULL == fh)
+    return NULL;
+  if ( (GNUNET_OK !=
+        GNUNET_DISK_file_handle_size (fh,
+                                      &size)) ||
+       (size < (off_t) sizeof (*header)) )
+  {
+    GNUNET_DISK_file_close (fh);
+    return NULL;
+  }
+  header = GNUNET_DISK_file_map (fh,
+                                 &mh,
+                                 GNUNET_DISK_MAP_TYPE_READ,
+                                 size);
+  if (NULL == header)
+  {
+    GNUNET_DISK_file_close (fh);
+    return NULL;
+  }
+  if (GNUNET_OK !=
+      check_table (header,
+                   size,
+                   max,
+                   mem))
+  {
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                "Ignoring DLOG table `%s', it is not for max=%u and mem=%u or damaged\n",
+                filename,
+                max,
+                mem);
+    GNUNET_DISK_file_unmap (mh);
+    GNUNET_DISK_file_close (fh);
+    return NULL;
+  }
+  edc = create_context (header,
+                        create_pool ());
+  edc->fh = fh;
+  edc->mh = mh;
+  return edc;
+}
+
+
+struct GNUNET_CRYPTO_EccDlogContext *
+GNUNET_CRYPTO_ecc_dlog_prepare_file (unsigned int max,
+                                     unsigned int mem,
+                                     const char *filename)
+{
+  struct GNUNET_CRYPTO_EccDlogContext *edc;
+
+  GNUNET_assert (max < INT32_MAX);
+  GNUNET_assert (mem < INT32_MAX / 2);
+  edc = load_table (max,
+                    mem,
+                    filename);
+  if (NULL != edc)
+    return edc;
+  GNUNET_log (GNUNET_ERROR_TYPE_INFO,
+              "Calculating DLOG table `%s' for max=%u and mem=%u\n",
+              filename,
+              max,
+              mem);
+  edc = GNUNET_CRYPTO_ecc_dlog_prepare (max,
+                                        mem);
+  if (NULL == edc)
+    return NULL;
+  if (GNUNET_OK !=
+      GNUNET_DISK_fn_write (filename,
+                            edc->header,
+                            sizeof (*edc->header)
+                            + edc->count * sizeof (struct DlogEntry),
+                            GNUNET_DISK_PERM_USER_READ
+                            | GNUNET_DISK_PERM_USER_WRITE))
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                "Failed to store DLOG table in `%s'\n",
+                filename);
+  return edc;
+}
+
+
+/**
+ * Take the steps from the worker's @e start to its @e end
+ * for calculating the DLOG of its @e input.
+ *
+ * @param cls the `struct DlogWorker`
+ */
+static void
+calc_dlog (void *cls)
+{
+  struct DlogWorker *w = cls;
+  unsigned int K = get_k (w->edc->max,
+                          w->edc->mem);
   struct GNUNET_CRYPTO_EccPoint g;
   struct GNUNET_CRYPTO_EccPoint q;
-  struct GNUNET_CRYPTO_EccPoint nq;
 
+  calc_point (1,
+              &g);
+  if (0 == w->start)
   {
-    struct GNUNET_CRYPTO_EccScalar fact;
-
-    memset (&fact,
-            0,
-            sizeof (fact));
-    sodium_increment (fact.v,
-                      sizeof (fact.v));
+    q = *w->input;
+  }
+  else
+  {
+    calc_point (w->start,
+                &q);
     GNUNET_assert (0 ==
-                   crypto_scalarmult_ed25519_base_noclamp (g.v,
-                                                           fact.v));
+                   crypto_core_ed25519_add (q.v,
+                                            w->input->v,
+                                            q.v));
   }
-  /* make compiler happy: initialize q and nq, technically not needed! */
-  memset (&q,
-          0,
-          sizeof (q));
-  memset (&nq,
-          0,
-          sizeof (nq));
-  res = INT_MAX;
-  for (unsigned int i = 0; i <= edc->max / edc->mem; i++)
+  for (int i = w->start; i <= w->end; i++)
   {
-    struct GNUNET_PeerIdentity key;
-    void *retp;
+    int j;
 
-    GNUNET_assert (sizeof (key) == crypto_scalarmult_BYTES);
-    if (0 == i)
-    {
-      memcpy (&key,
-              input,
-              sizeof (key));
-    }
-    else
-    {
-      memcpy (&key,
-              &q,
-              sizeof (key));
-    }
-    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-                "Trying offset i=%u): %s\n",
-                i,
-                GNUNET_i2s (&key));
-    retp = GNUNET_CONTAINER_multipeermap_get (edc->map,
-                                              &key);
-    if (NULL != retp)
+    if (GNUNET_YES ==
+        lookup_point (w->edc,
+                      &q,
+                      &j))
     {
-      res = (((long) retp) - edc->max) * K - i;
+      w->res = j * (int) K - i;
       /* we continue the loop here to make the implementation
          "constant-time". If we do not care about this, we could just
          'break' here and do fewer operations... */
     }
-    if (i == edc->max / edc->mem)
+    if (i == w->end)
       break;
     /* q = q + g */
-    if (0 == i)
-    {
-      GNUNET_assert (0 ==
-                     crypto_core_ed25519_add (q.v,
-                                              input->v,
-                                              g.v));
-    }
-    else
-    {
-      GNUNET_assert (0 ==
-                     crypto_core_ed25519_add (q.v,
-                                              q.v,
-                                              g.v));
-    }
+    GNUNET_assert (0 ==
+                   crypto_core_ed25519_add (q.v,
+                                            q.v,
+                                            g.v));
   }
-  return res;
+}
+
+
+int
+GNUNET_CRYPTO_ecc_dlog (struct GNUNET_CRYPTO_EccDlogContext *edc,
+                        const struct GNUNET_CRYPTO_EccPoint *input)
+{
+  struct DlogWorker proto;
+
+  memset (&proto,
+          0,
+          sizeof (proto));
+  proto.edc = edc;
+  proto.input = input;
+  return run_workers (edc->pool,
+                      0,
+                      edc->max / edc->mem,
+                      &proto,
+                      &calc_dlog);
 }
 
 
@@ -201,7 +796,13 @@ GNUNET_CRYPTO_ecc_random_mod_n (struct GNUNET_CRYPTO_EccScalar *r)
 void
 GNUNET_CRYPTO_ecc_dlog_release (struct GNUNET_CRYPTO_EccDlogContext *edc)
 {
-  GNUNET_CONTAINER_multipeermap_destroy (edc->map);
+  if (NULL != edc->mh)
+    GNUNET_DISK_file_unmap (edc->mh);
+  if (NULL != edc->fh)
+    GNUNET_DISK_file_close (edc->fh);
+  GNUNET_free (edc->buf);
+  GNUNET_free (edc->index);
+  GNUNET_THREAD_pool_destroy (edc->pool);
   GNUNET_free (edc);
 }
 
@@ -68,6 +68,94 @@ derive_h (const void *pub,
 }
 
 
+/**
+ * Reduce the 'h' value modulo the order of the base point.  'h' is
+ * interpreted as a big-endian number, as we did when we used
+ * libgcrypt for the arithmetic.
+ *
+ * @param hc the 'h' value
+ * @param[out] h_mod_n little-endian result for libsodium
+ */
+static void
+derive_h_mod_n (const struct GNUNET_HashCode *hc,
+                unsigned char h_mod_n[crypto_core_ed25519_SCALARBYTES])
+{
+  const unsigned char *be = (const unsigned char *) hc;
+  unsigned char le[crypto_core_ed25519_NONREDUCEDSCALARBYTES];
+
+  GNUNET_static_assert (sizeof(*hc) == sizeof(le));
+  for (size_t i = 0; i < sizeof(le); i++)
+    le[i] = be[sizeof(le) - 1 - i];
+  crypto_core_ed25519_scalar_reduce (h_mod_n, le);
+}
+
+
+/**
+ * Multiply a public key by the 'h' value.  libsodium only multiplies
+ * points of the prime order subgroup, which all keys we generate are
+ * in; for anything else we fall back to the generic libgcrypt point
+ * multiplication.
+ *
+ * @param q_y compressed point to multiply
+ * @param hc the 'h' value
+ * @param[out] result compressed result
+ */
+static void
+derive_public (const unsigned char q_y[crypto_core_ed25519_BYTES],
+               const struct GNUNET_HashCode *hc,
+               unsigned char result[crypto_core_ed25519_BYTES])
+{
+  unsigned char h_mod_n[crypto_core_ed25519_SCALARBYTES];
+  gcry_ctx_t ctx;
+  gcry_mpi_t q;
+  gcry_mpi_t h;
+  gcry_mpi_t n;
+  gcry_mpi_t hn;
+  gcry_mpi_point_t p;
+  gcry_mpi_point_t v;
+
+  derive_h_mod_n (hc, h_mod_n);
+  if (0 == crypto_scalarmult_ed25519_noclamp (result,
+                                              h_mod_n,
+                                              q_y))
+    return;
+
+  GNUNET_assert (0 == gcry_mpi_ec_new (&ctx, NULL, CURVE));
+
+  /* obtain point 'p' from the public key.  The provided 'q' is
+     compressed thus we first store it in the context and then get it
+     back as a (decompresssed) point.  */
+  q = gcry_mpi_set_opaque_copy (NULL, q_y, 8 * crypto_core_ed25519_BYTES);
+  GNUNET_assert (NULL != q);
+  GNUNET_assert (0 == gcry_mpi_ec_set_mpi ("q", q, ctx));
+  gcry_mpi_release (q);
+  p = gcry_mpi_ec_get_point ("q", ctx, 0);
+  GNUNET_assert (p);
+
+  /* calculate hn = h % n */
+  GNUNET_CRYPTO_mpi_scan_unsigned (&h, (unsigned char *) hc, sizeof(*hc));
+  n = gcry_mpi_ec_get_mpi ("n", ctx, 1);
+  hn = gcry_mpi_new (256);
+  gcry_mpi_mod (hn, h, n);
+  /* calculate v = hn * p */
+  v = gcry_mpi_point_new (0);
+  gcry_mpi_ec_mul (v, hn, p, ctx);
+  gcry_mpi_release (hn);
+  gcry_mpi_release (h);
+  gcry_mpi_release (n);
+  gcry_mpi_point_release (p);
+
+  /* convert point 'v' to the compressed form that we return */
+  GNUNET_assert (0 == gcry_mpi_ec_set_point ("q", v, ctx));
+  gcry_mpi_point_release (v);
+  q = gcry_mpi_ec_get_mpi ("q@eddsa", ctx, 0);
+  GNUNET_assert (q);
+  GNUNET_CRYPTO_mpi_print_unsigned (result, crypto_core_ed25519_BYTES, q);
+  gcry_mpi_release (q);
+  gcry_ctx_release (ctx);
+}
+
+
 /**
  * This is a signature function for EdDSA which takes the
  * secret scalar sk instead of the private seed which is
@@ -184,38 +272,23 @@ GNUNET_CRYPTO_ecdsa_private_key_derive (
   struct GNUNET_CRYPTO_EcdsaPublicKey pub;
   struct GNUNET_CRYPTO_EcdsaPrivateKey *ret;
   struct GNUNET_HashCode hc;
-  uint8_t dc[32];
-  gcry_mpi_t h;
-  gcry_mpi_t x;
-  gcry_mpi_t d;
-  gcry_mpi_t n;
-  gcry_ctx_t ctx;
+  unsigned char h_mod_n[crypto_core_ed25519_SCALARBYTES];
+  unsigned char x[crypto_core_ed25519_NONREDUCEDSCALARBYTES];
+  unsigned char x_mod_n[crypto_core_ed25519_SCALARBYTES];
 
-  GNUNET_assert (0 == gcry_mpi_ec_new (&ctx, NULL, CURVE));
-
-  n = gcry_mpi_ec_get_mpi ("n", ctx, 1);
   GNUNET_CRYPTO_ecdsa_key_get_public (priv, &pub);
 
   derive_h (&pub, sizeof (pub), label, context, &hc);
-  GNUNET_CRYPTO_mpi_scan_unsigned (&h, (unsigned char *) &hc, sizeof(hc));
+  derive_h_mod_n (&hc, h_mod_n);
 
-  /* Convert to big endian for libgcrypt */
-  for (size_t i = 0; i < 32; i++)
-    dc[i] = priv->d[31 - i];
-  GNUNET_CRYPTO_mpi_scan_unsigned (&x, dc, sizeof(dc));
-  d = gcry_mpi_new (256);
-  gcry_mpi_mulm (d, h, x, n);
-  gcry_mpi_release (h);
-  gcry_mpi_release (x);
-  gcry_mpi_release (n);
-  gcry_ctx_release (ctx);
+  /* d' = h * d mod n, the private key is little-endian already */
+  memset (x, 0, sizeof(x));
+  memcpy (x, priv->d, sizeof(priv->d));
+  crypto_core_ed25519_scalar_reduce (x_mod_n, x);
   ret = GNUNET_new (struct GNUNET_CRYPTO_EcdsaPrivateKey);
-  GNUNET_CRYPTO_mpi_print_unsigned (dc, sizeof(dc), d);
-  /* Convert to big endian for libgcrypt */
-  for (size_t i = 0; i < 32; i++)
-    ret->d[i] = dc[31 - i];
-  sodium_memzero (dc, sizeof(dc));
-  gcry_mpi_release (d);
+  crypto_core_ed25519_scalar_mul (ret->d, h_mod_n, x_mod_n);
+  sodium_memzero (x, sizeof(x));
+  sodium_memzero (x_mod_n, sizeof(x_mod_n));
   return ret;
 }
 
@@ -228,48 +301,9 @@ GNUNET_CRYPTO_ecdsa_public_key_derive (
   struct GNUNET_CRYPTO_EcdsaPublicKey *result)
 {
   struct GNUNET_HashCode hc;
-  gcry_ctx_t ctx;
-  gcry_mpi_t q_y;
-  gcry_mpi_t h;
-  gcry_mpi_t n;
-  gcry_mpi_t h_mod_n;
-  gcry_mpi_point_t q;
-  gcry_mpi_point_t v;
 
-  GNUNET_assert (0 == gcry_mpi_ec_new (&ctx, NULL, CURVE));
-
-  /* obtain point 'q' from original public key.  The provided 'q' is
-     compressed thus we first store it in the context and then get it
-     back as a (decompresssed) point.  */
-  q_y = gcry_mpi_set_opaque_copy (NULL, pub->q_y, 8 * sizeof(pub->q_y));
-  GNUNET_assert (NULL != q_y);
-  GNUNET_assert (0 == gcry_mpi_ec_set_mpi ("q", q_y, ctx));
-  gcry_mpi_release (q_y);
-  q = gcry_mpi_ec_get_point ("q", ctx, 0);
-  GNUNET_assert (q);
-
-  /* calculate h_mod_n = h % n */
   derive_h (pub, sizeof (*pub), label, context, &hc);
-  GNUNET_CRYPTO_mpi_scan_unsigned (&h, (unsigned char *) &hc, sizeof(hc));
-  n = gcry_mpi_ec_get_mpi ("n", ctx, 1);
-  h_mod_n = gcry_mpi_new (256);
-  gcry_mpi_mod (h_mod_n, h, n);
-  /* calculate v = h_mod_n * q */
-  v = gcry_mpi_point_new (0);
-  gcry_mpi_ec_mul (v, h_mod_n, q, ctx);
-  gcry_mpi_release (h_mod_n);
-  gcry_mpi_release (h);
-  gcry_mpi_release (n);
-  gcry_mpi_point_release (q);
-
-  /* convert point 'v' to public key that we return */
-  GNUNET_assert (0 == gcry_mpi_ec_set_point ("q", v, ctx));
-  gcry_mpi_point_release (v);
-  q_y = gcry_mpi_ec_get_mpi ("q@eddsa", ctx, 0);
-  GNUNET_assert (q_y);
-  GNUNET_CRYPTO_mpi_print_unsigned (result->q_y, sizeof(result->q_y), q_y);
-  gcry_mpi_release (q_y);
-  gcry_ctx_release (ctx);
+  derive_public (pub->q_y, &hc, result->q_y);
 }
 
 
@@ -282,27 +316,11 @@ GNUNET_CRYPTO_eddsa_private_key_derive (
 {
   struct GNUNET_CRYPTO_EddsaPublicKey pub;
   struct GNUNET_HashCode hc;
-  uint8_t dc[32];
   unsigned char sk[64];
-  gcry_mpi_t h;
-  gcry_mpi_t h_mod_n;
-  gcry_mpi_t x;
-  gcry_mpi_t d;
-  gcry_mpi_t n;
-  gcry_mpi_t a1;
-  gcry_mpi_t a2;
-  gcry_ctx_t ctx;
-
-  /**
-   * Libsodium does not offer an API with arbitrary arithmetic.
-   * Hence we have to use libgcrypt here.
-   */
-  GNUNET_assert (0 == gcry_mpi_ec_new (&ctx, NULL, "Ed25519"));
+  unsigned char h_mod_n[crypto_core_ed25519_SCALARBYTES];
+  unsigned char a1[crypto_core_ed25519_SCALARBYTES];
+  unsigned char a2[crypto_core_ed25519_SCALARBYTES];
 
-  /**
-   * Get our modulo
-   */
-  n = gcry_mpi_ec_get_mpi ("n", ctx, 1);
   GNUNET_CRYPTO_eddsa_key_get_public (priv, &pub);
 
   /**
@@ -320,36 +338,24 @@ GNUNET_CRYPTO_eddsa_private_key_derive (
    * Get h mod n
    */
   derive_h (&pub, sizeof (pub), label, context, &hc);
-  GNUNET_CRYPTO_mpi_scan_unsigned (&h, (unsigned char *) &hc, sizeof(hc));
-  h_mod_n = gcry_mpi_new (256);
-  gcry_mpi_mod (h_mod_n, h, n);
-  /* Convert scalar to big endian for libgcrypt */
-  for (size_t i = 0; i < 32; i++)
-    dc[i] = sk[31 - i];
+  derive_h_mod_n (&hc, h_mod_n);
 
   /**
-   * dc now contains the private scalar "a".
+   * sk now contains the private scalar "a".
    * We carefully remove the clamping and derive a'.
    * Calculate:
    * a1 := a / 8
    * a2 := h * a1 mod n
-   * a' := a2 * 8 mod n
+   * a' := a2 * 8
+   * All numbers are little-endian; a' does not fit a
+   * reduced scalar, so we do the shifts ourselves.
    */
-  GNUNET_CRYPTO_mpi_scan_unsigned (&x, dc, sizeof(dc)); // a
-  a1 = gcry_mpi_new (256);
-  gcry_mpi_t eight = gcry_mpi_set_ui (NULL, 8);
-  gcry_mpi_div (a1, NULL, x, eight, 0); // a1 := a / 8
-  a2 = gcry_mpi_new (256);
-  gcry_mpi_mulm (a2, h_mod_n, a1, n); // a2 := h * a1 mod n
-  d = gcry_mpi_new (256);
-  gcry_mpi_mul (d, a2, eight); // a' := a2 * 8
-  gcry_mpi_release (h);
-  gcry_mpi_release (x);
-  gcry_mpi_release (n);
-  gcry_mpi_release (a1);
-  gcry_mpi_release (a2);
-  gcry_ctx_release (ctx);
-  GNUNET_CRYPTO_mpi_print_unsigned (dc, sizeof(dc), d);
+  for (size_t i = 0; i < 32; i++)
+    a1[i] = (sk[i] >> 3) | ((i < 31) ? (unsigned char) (sk[i + 1] << 5) : 0);
+  crypto_core_ed25519_scalar_mul (a2, h_mod_n, a1);
+  for (size_t i = 0; i < 32; i++)
+    result->s[i] = (unsigned char) (a2[i] << 3) | ((i > 0) ? (a2[i - 1] >> 5)
+                                                   : 0);
   /**
    * We hash the derived "h" parameter with the
    * other half of the expanded private key. This ensures
@@ -361,13 +367,10 @@ GNUNET_CRYPTO_eddsa_private_key_derive (
   crypto_hash_sha256_update (&hs, sk + 32, 32);
   crypto_hash_sha256_update (&hs, (unsigned char*) &hc, sizeof (hc));
   crypto_hash_sha256_final (&hs, result->s + 32);
-  //memcpy (result->s, sk, sizeof (sk));
-  /* Convert to little endian for libsodium */
-  for (size_t i = 0; i < 32; i++)
-    result->s[i] = dc[31 - i];
 
-  sodium_memzero (dc, sizeof(dc));
-  gcry_mpi_release (d);
+  sodium_memzero (sk, sizeof(sk));
+  sodium_memzero (a1, sizeof(a1));
+  sodium_memzero (a2, sizeof(a2));
 }
 
 
@@ -379,51 +382,9 @@ GNUNET_CRYPTO_eddsa_public_key_derive (
   struct GNUNET_CRYPTO_EddsaPublicKey *result)
 {
   struct GNUNET_HashCode hc;
-  gcry_ctx_t ctx;
-  gcry_mpi_t q_y;
-  gcry_mpi_t h;
-  gcry_mpi_t n;
-  gcry_mpi_t h_mod_n;
-  gcry_mpi_point_t q;
-  gcry_mpi_point_t v;
-
-  GNUNET_assert (0 == gcry_mpi_ec_new (&ctx, NULL, "Ed25519"));
-
-  /* obtain point 'q' from original public key.  The provided 'q' is
-     compressed thus we first store it in the context and then get it
-     back as a (decompresssed) point.  */
-  q_y = gcry_mpi_set_opaque_copy (NULL, pub->q_y, 8 * sizeof(pub->q_y));
-  GNUNET_assert (NULL != q_y);
-  GNUNET_assert (0 == gcry_mpi_ec_set_mpi ("q", q_y, ctx));
-  gcry_mpi_release (q_y);
-  q = gcry_mpi_ec_get_point ("q", ctx, 0);
-  GNUNET_assert (q);
 
-  /* calculate h_mod_n = h % n */
   derive_h (pub, sizeof (*pub), label, context, &hc);
-  GNUNET_CRYPTO_mpi_scan_unsigned (&h, (unsigned char *) &hc, sizeof(hc));
-
-  n = gcry_mpi_ec_get_mpi ("n", ctx, 1);
-  h_mod_n = gcry_mpi_new (256);
-  gcry_mpi_mod (h_mod_n, h, n);
-
-  /* calculate v = h_mod_n * q */
-  v = gcry_mpi_point_new (0);
-  gcry_mpi_ec_mul (v, h_mod_n, q, ctx);
-  gcry_mpi_release (h_mod_n);
-  gcry_mpi_release (h);
-  gcry_mpi_release (n);
-  gcry_mpi_point_release (q);
-
-  /* convert point 'v' to public key that we return */
-  GNUNET_assert (0 == gcry_mpi_ec_set_point ("q", v, ctx));
-  gcry_mpi_point_release (v);
-  q_y = gcry_mpi_ec_get_mpi ("q@eddsa", ctx, 0);
-  GNUNET_assert (q_y);
-  GNUNET_CRYPTO_mpi_print_unsigned (result->q_y, sizeof(result->q_y), q_y);
-  gcry_mpi_release (q_y);
-  gcry_ctx_release (ctx);
-
+  derive_public (pub->q_y, &hc, result->q_y);
 }
 
 
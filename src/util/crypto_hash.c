@@ -275,25 +275,11 @@ GNUNET_CRYPTO_hmac_raw (const void *key, size_t key_len,
                         const void *plaintext, size_t plaintext_len,
                         struct GNUNET_HashCode *hmac)
 {
-  static int once;
-  static gcry_md_hd_t md;
-  const unsigned char *mc;
+  struct GNUNET_CRYPTO_HmacContext hc;
 
-  if (! once)
-  {
-    once = 1;
-    GNUNET_assert (GPG_ERR_NO_ERROR ==
-                   gcry_md_open (&md, GCRY_MD_SHA512, GCRY_MD_FLAG_HMAC));
-  }
-  else
-  {
-    gcry_md_reset (md);
-  }
-  gcry_md_setkey (md, key, key_len);
-  gcry_md_write (md, plaintext, plaintext_len);
-  mc = gcry_md_read (md, GCRY_MD_SHA512);
-  GNUNET_assert (NULL != mc);
-  GNUNET_memcpy (hmac->bits, mc, sizeof(hmac->bits));
+  GNUNET_CRYPTO_hmac_context_init (&hc, key, key_len);
+  GNUNET_CRYPTO_hmac_context_calculate (&hc, plaintext, plaintext_len, hmac);
+  GNUNET_CRYPTO_hmac_context_clear (&hc);
 }
 
 
@@ -308,6 +294,36 @@ GNUNET_CRYPTO_hmac (const struct GNUNET_CRYPTO_AuthKey *key,
 }
 
 
+void
+GNUNET_CRYPTO_hmac_context_init (struct GNUNET_CRYPTO_HmacContext *hc,
+                                 const void *key, size_t key_len)
+{
+  crypto_auth_hmacsha512_init (&hc->state, key, key_len);
+}
+
+
+void
+GNUNET_CRYPTO_hmac_context_calculate (
+  const struct GNUNET_CRYPTO_HmacContext *hc,
+  const void *plaintext, size_t plaintext_len,
+  struct GNUNET_HashCode *hmac)
+{
+  crypto_auth_hmacsha512_state state;
+
+  /* the final step wipes the state, so work on a copy */
+  state = hc->state;
+  crypto_auth_hmacsha512_update (&state, plaintext, plaintext_len);
+  crypto_auth_hmacsha512_final (&state, (unsigned char *) hmac->bits);
+}
+
+
+void
+GNUNET_CRYPTO_hmac_context_clear (struct GNUNET_CRYPTO_HmacContext *hc)
+{
+  sodium_memzero (hc, sizeof(*hc));
+}
+
+
 struct GNUNET_HashContext
 {
   /**
@@ -164,6 +164,22 @@ GNUNET_CRYPTO_hkdf_v (void *result, size_t out_len, int xtr_algo, int prf_algo,
 
   BENCHMARK_START (hkdf);
 
+#if GNUNET_BUILD
+  if ( (GCRY_MD_SHA512 == xtr_algo) &&
+       (GCRY_MD_SHA256 == prf_algo) )
+  {
+    struct GNUNET_CRYPTO_KdfContext kc;
+
+    /* the common instantiation, see #GNUNET_CRYPTO_kdf(); use the
+       precomputed HMAC states instead of fresh gcrypt handles */
+    GNUNET_CRYPTO_kdf_context_init (&kc, xts, xts_len);
+    GNUNET_CRYPTO_kdf_context_derive_v (&kc, result, out_len,
+                                        skm, skm_len, argp);
+    GNUNET_CRYPTO_kdf_context_clear (&kc);
+    BENCHMARK_END (hkdf);
+    return GNUNET_YES;
+  }
+#endif
   if (0 == k)
     return GNUNET_SYSERR;
   if (GPG_ERR_NO_ERROR !=
@@ -111,6 +111,127 @@ GNUNET_CRYPTO_kdf (void *result,
 }
 
 
+/**
+ * @brief Initialize a KDF context for a salt
+ * @param[out] kc context to initialize
+ * @param xts salt
+ * @param xts_len length of @a xts
+ */
+void
+GNUNET_CRYPTO_kdf_context_init (struct GNUNET_CRYPTO_KdfContext *kc,
+                                const void *xts,
+                                size_t xts_len)
+{
+  GNUNET_CRYPTO_hmac_context_init (&kc->xtr, xts, xts_len);
+}
+
+
+/**
+ * @brief Derive key, HKDF with HMAC-SHA512 as XTR and HMAC-SHA256 as PRF
+ * @param kc context with the salt
+ * @param result buffer for the derived key, allocated by caller
+ * @param out_len desired length of the derived key
+ * @param skm source key material
+ * @param skm_len length of @a skm
+ * @param argp va_list of void * & size_t pairs for context chunks
+ */
+void
+GNUNET_CRYPTO_kdf_context_derive_v (const struct GNUNET_CRYPTO_KdfContext *kc,
+                                    void *result,
+                                    size_t out_len,
+                                    const void *skm,
+                                    size_t skm_len,
+                                    va_list argp)
+{
+  struct GNUNET_HashCode prk;
+  crypto_auth_hmacsha256_state prf;
+  crypto_auth_hmacsha256_state state;
+  unsigned char k[crypto_auth_hmacsha256_BYTES];
+  unsigned char i;
+  char *dst = result;
+
+  GNUNET_CRYPTO_hmac_context_calculate (&kc->xtr,
+                                        skm,
+                                        skm_len,
+                                        &prk);
+  /* key the PRF once, every K(i) starts from a copy */
+  crypto_auth_hmacsha256_init (&prf,
+                               (const unsigned char *) &prk,
+                               sizeof(prk));
+  i = 1;
+  while (out_len > 0)
+  {
+    size_t len = GNUNET_MIN (out_len, sizeof(k));
+    const void *ctx;
+    va_list args;
+
+    /* K(i) = HMAC(PRK, K(i-1) | ctx | i) */
+    state = prf;
+    if (i > 1)
+      crypto_auth_hmacsha256_update (&state, k, sizeof(k));
+    va_copy (args, argp);
+    while (NULL != (ctx = va_arg (args, const void *)))
+    {
+      size_t ctx_len = va_arg (args, size_t);
+
+      crypto_auth_hmacsha256_update (&state, ctx, ctx_len);
+    }
+    va_end (args);
+    crypto_auth_hmacsha256_update (&state, &i, 1);
+    crypto_auth_hmacsha256_final (&state, k);
+    GNUNET_memcpy (dst, k, len);
+    dst += len;
+    out_len -= len;
+    i++;
+  }
+  sodium_memzero (&prk, sizeof(prk));
+  sodium_memzero (&prf, sizeof(prf));
+  sodium_memzero (k, sizeof(k));
+}
+
+
+/**
+ * @brief Derive key, HKDF with HMAC-SHA512 as XTR and HMAC-SHA256 as PRF
+ * @param kc context with the salt
+ * @param result buffer for the derived key, allocated by caller
+ * @param out_len desired length of the derived key
+ * @param skm source key material
+ * @param skm_len length of @a skm
+ * @param ... void * & size_t pairs for context chunks
+ */
+void
+GNUNET_CRYPTO_kdf_context_derive (const struct GNUNET_CRYPTO_KdfContext *kc,
+                                  void *result,
+                                  size_t out_len,
+                                  const void *skm,
+                                  size_t skm_len,
+                                  ...)
+{
+  va_list argp;
+
+  va_start (argp, skm_len);
+  GNUNET_CRYPTO_kdf_context_derive_v (kc,
+                                      result,
+                                      out_len,
+                                      skm,
+                                      skm_len,
+                                      argp);
+  va_end (argp);
+}
+
+
+/**
+ * Wipe the key material of a KDF context.
+ *
+ * @param kc context to clear
+ */
+void
+GNUNET_CRYPTO_kdf_context_clear (struct GNUNET_CRYPTO_KdfContext *kc)
+{
+  GNUNET_CRYPTO_hmac_context_clear (&kc->xtr);
+}
+
+
 /**
  * Deterministically generate a pseudo-random number uniformly from the
  * integers modulo a libgcrypt mpi.
@@ -26,6 +26,7 @@
  */
 #include "platform.h"
 #include <gcrypt.h>
+#include <pthread.h>
 #include "gnunet_util_lib.h"
 
 
@@ -323,6 +324,489 @@ GNUNET_CRYPTO_paillier_encrypt (const struct
 }
 
 
+/**
+ * How many values of r^n mod n^2 do we keep around at most?
+ */
+#define MAX_POOL_SIZE (64 * 1024)
+
+/**
+ * Maximum number of threads for calculating with one context.
+ */
+#define MAX_THREADS 16
+
+/**
+ * Minimum number of encryptions per thread of a batch.
+ */
+#define MIN_PER_THREAD 4
+
+
+/**
+ * Pre-calculated values for encrypting many plaintexts with the
+ * same public key.
+ */
+struct GNUNET_CRYPTO_PaillierContext
+{
+  /**
+   * The public key.
+   */
+  gcry_mpi_t n;
+
+  /**
+   * n^2
+   */
+  gcry_mpi_t n_square;
+
+  /**
+   * Highest bit set in @e n.
+   */
+  unsigned int highbit;
+
+  /**
+   * Protects @e pool, @e pool_len, @e pool_size, @e pending and
+   * @e running.
+   */
+  pthread_mutex_t lock;
+
+  /**
+   * Values r^n mod n^2 for random r < n, each used for one
+   * encryption only.
+   */
+  gcry_mpi_t *pool;
+
+  /**
+   * Number of values in @e pool.
+   */
+  unsigned int pool_len;
+
+  /**
+   * Allocated length of @e pool.
+   */
+  unsigned int pool_size;
+
+  /**
+   * How many more values should the jobs in @e jobs calculate?
+   */
+  unsigned int pending;
+
+  /**
+   * How many jobs in @e jobs are still calculating?
+   */
+  unsigned int running;
+
+  /**
+   * Threads calculating values for @e pool in the background,
+   * started with the first precomputation.
+   */
+  struct GNUNET_THREAD_Pool *workers;
+
+  /**
+   * Jobs of @e workers calculating values for @e pool.
+   */
+  struct GNUNET_THREAD_Job *jobs[MAX_THREADS];
+
+  /**
+   * Number of jobs in @e jobs we have to wait for.
+   */
+  unsigned int job_count;
+};
+
+
+/**
+ * Work of one thread of #GNUNET_CRYPTO_paillier_encrypt_batch().
+ */
+struct BatchWorker
+{
+  /**
+   * The job doing this part, NULL for the calling thread.
+   */
+  struct GNUNET_THREAD_Job *job;
+
+  /**
+   * The context.
+   */
+  const struct GNUNET_CRYPTO_PaillierContext *ctx;
+
+  /**
+   * Plaintexts to encrypt.
+   */
+  const gcry_mpi_t *m;
+
+  /**
+   * Values r^n mod n^2 to use for the plaintexts, NULL entries
+   * must be calculated.
+   */
+  gcry_mpi_t *rn;
+
+  /**
+   * Where to write the ciphertexts.
+   */
+  struct GNUNET_CRYPTO_PaillierCiphertext *ciphertexts;
+
+  /**
+   * First plaintext of this thread.
+   */
+  unsigned int start;
+
+  /**
+   * Number of plaintexts of this thread.
+   */
+  unsigned int count;
+
+  /**
+   * Soft-cap on the number of homomorphic operations.
+   */
+  int desired_ops;
+
+  /**
+   * Minimum number of homomorphic operations of the ciphertexts.
+   */
+  int min_ops;
+};
+
+
+/**
+ * Get the number of threads to use on this system.
+ *
+ * @return number of threads
+ */
+static unsigned int
+get_thread_count (void)
+{
+  long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+
+  if (ncpu < 1)
+    return 1;
+  return GNUNET_MIN ((unsigned long) ncpu,
+                     MAX_THREADS);
+}
+
+
+/**
+ * Calculate r^n mod n^2 for a random r < n.
+ *
+ * @param n the public key
+ * @param n_square n^2
+ * @param highbit highest bit set in @a n
+ * @return r^n mod n^2
+ */
+static gcry_mpi_t
+calc_rn (gcry_mpi_t n,
+         gcry_mpi_t n_square,
+         unsigned int highbit)
+{
+  gcry_mpi_t r;
+
+  /* generate r < n (without bias) */
+  GNUNET_assert (NULL != (r = gcry_mpi_new (0)));
+  do
+  {
+    gcry_mpi_randomize (r, highbit + 1, GCRY_STRONG_RANDOM);
+  }
+  while (gcry_mpi_cmp (r, n) >= 0);
+  /* r <- r^n mod n^2 */
+  gcry_mpi_powm (r, r, n, n_square);
+  return r;
+}
+
+
+/**
+ * Calculate values for the pool of a context until no more are
+ * pending.
+ *
+ * @param cls the `struct GNUNET_CRYPTO_PaillierContext`
+ */
+static void
+fill_pool (void *cls)
+{
+  struct GNUNET_CRYPTO_PaillierContext *ctx = cls;
+  gcry_mpi_t n;
+  gcry_mpi_t n_square;
+
+  /* libgcrypt wants its own copies in every thread */
+  n = gcry_mpi_copy (ctx->n);
+  n_square = gcry_mpi_copy (ctx->n_square);
+  GNUNET_assert (0 == pthread_mutex_lock (&ctx->lock));
+  while (0 < ctx->pending)
+  {
+    gcry_mpi_t rn;
+
+    ctx->pending--;
+    GNUNET_assert (0 == pthread_mutex_unlock (&ctx->lock));
+    rn = calc_rn (n,
+                  n_square,
+                  ctx->highbit);
+    GNUNET_assert (0 == pthread_mutex_lock (&ctx->lock));
+    if (ctx->pool_len == ctx->pool_size)
+      GNUNET_array_grow (ctx->pool,
+                         ctx->pool_size,
+                         GNUNET_MAX (16,
+                                     ctx->pool_size * 2));
+    ctx->pool[ctx->pool_len++] = rn;
+  }
+  ctx->running--;
+  GNUNET_assert (0 == pthread_mutex_unlock (&ctx->lock));
+  gcry_mpi_release (n);
+  gcry_mpi_release (n_square);
+}
+
+
+/**
+ * Wait for the jobs that calculated values for the pool of
+ * @a ctx.  They must be done or about to be done.
+ *
+ * @param ctx the context
+ */
+static void
+wait_pool_jobs (struct GNUNET_CRYPTO_PaillierContext *ctx)
+{
+  for (unsigned int i = 0; i < ctx->job_count; i++)
+    GNUNET_THREAD_pool_wait (ctx->jobs[i]);
+  ctx->job_count = 0;
+}
+
+
+struct GNUNET_CRYPTO_PaillierContext *
+GNUNET_CRYPTO_paillier_context_create (
+  const struct GNUNET_CRYPTO_PaillierPublicKey *public_key)
+{
+  struct GNUNET_CRYPTO_PaillierContext *ctx;
+  gcry_mpi_t n;
+  unsigned int highbit;
+
+  GNUNET_CRYPTO_mpi_scan_unsigned (&n,
+                                   public_key,
+                                   sizeof(struct
+                                          GNUNET_CRYPTO_PaillierPublicKey));
+  /* check public key for number of bits, bail out if key is all zeros */
+  highbit = GNUNET_CRYPTO_PAILLIER_BITS - 1;
+  while ((! gcry_mpi_test_bit (n, highbit)) &&
+         (0 != highbit))
+    highbit--;
+  if (0 == highbit)
+  {
+    /* invalid public key */
+    GNUNET_break_op (0);
+    gcry_mpi_release (n);
+    return NULL;
+  }
+  ctx = GNUNET_new (struct GNUNET_CRYPTO_PaillierContext);
+  ctx->n = n;
+  ctx->highbit = highbit;
+  GNUNET_assert (0 != (ctx->n_square = gcry_mpi_new (0)));
+  gcry_mpi_mul (ctx->n_square,
+                n,
+                n);
+  GNUNET_assert (0 == pthread_mutex_init (&ctx->lock,
+                                          NULL));
+  return ctx;
+}
+
+
+void
+GNUNET_CRYPTO_paillier_precompute (struct GNUNET_CRYPTO_PaillierContext *ctx,
+                                   unsigned int count)
+{
+  unsigned int threads;
+
+  GNUNET_assert (0 == pthread_mutex_lock (&ctx->lock));
+  if (ctx->pool_len + ctx->pending < MAX_POOL_SIZE)
+    ctx->pending += GNUNET_MIN (count,
+                                MAX_POOL_SIZE - ctx->pool_len - ctx->pending);
+  /* jobs that are still running will take care of the new
+     values as well */
+  threads = (0 != ctx->running)
+            ? 0
+            : GNUNET_MIN (get_thread_count (),
+                          ctx->pending);
+  ctx->running += threads;
+  GNUNET_assert (0 == pthread_mutex_unlock (&ctx->lock));
+  if (0 == threads)
+    return;
+  wait_pool_jobs (ctx);
+  if (NULL == ctx->workers)
+    ctx->workers = GNUNET_THREAD_pool_create (get_thread_count ());
+  if (0 == GNUNET_THREAD_pool_get_size (ctx->workers))
+  {
+    /* no background threads, calculate along with the encryption */
+    GNUNET_assert (0 == pthread_mutex_lock (&ctx->lock));
+    ctx->running = 0;
+    ctx->pending = 0;
+    GNUNET_assert (0 == pthread_mutex_unlock (&ctx->lock));
+    return;
+  }
+  for (unsigned int i = 0; i < threads; i++)
+    ctx->jobs[ctx->job_count++] = GNUNET_THREAD_pool_submit (ctx->workers,
+                                                             &fill_pool,
+                                                             NULL,
+                                                             ctx);
+}
+
+
+/**
+ * Get the number of homomorphic operations we can allow with
+ * a ciphertext of @a m.
+ *
+ * @param m the plaintext, must not be negative
+ * @param desired_ops how many homomorphic ops the caller intends to use
+ * @return number of operations
+ */
+static int
+get_possible_ops (const gcry_mpi_t m,
+                  int desired_ops)
+{
+  /* Like in #GNUNET_CRYPTO_paillier_encrypt(), assuming the other
+     number has the same length (or is smaller), we can add numbers
+     until the result no longer fits into GNUNET_CRYPTO_PAILLIER_BITS,
+     keeping one bit in reserve. */
+  int possible_ops = GNUNET_CRYPTO_PAILLIER_BITS
+                     - (int) gcry_mpi_get_nbits (m) - 1;
+
+  if (possible_ops < 1)
+    possible_ops = 0;
+  return GNUNET_MIN (desired_ops,
+                     possible_ops);
+}
+
+
+/**
+ * Encrypt the plaintexts of one thread of a batch.
+ *
+ * @param cls the `struct BatchWorker`
+ */
+static void
+encrypt_batch (void *cls)
+{
+  struct BatchWorker *w = cls;
+  gcry_mpi_t n;
+  gcry_mpi_t n_square;
+  gcry_mpi_t c;
+
+  n = gcry_mpi_copy (w->ctx->n);
+  n_square = gcry_mpi_copy (w->ctx->n_square);
+  GNUNET_assert (0 != (c = gcry_mpi_new (0)));
+  w->min_ops = w->desired_ops;
+  for (unsigned int i = w->start; i < w->start + w->count; i++)
+  {
+    int ops = get_possible_ops (w->m[i],
+                                w->desired_ops);
+
+    w->min_ops = GNUNET_MIN (w->min_ops,
+                             ops);
+    w->ciphertexts[i].remaining_ops = htonl (ops);
+    if (NULL == w->rn[i])
+      w->rn[i] = calc_rn (n,
+                          n_square,
+                          w->ctx->highbit);
+    /* with g = n + 1, g^m mod n^2 = 1 + m * n mod n^2, which
+       saves us the exponentiation */
+    gcry_mpi_mulm (c, w->m[i], n, n_square);
+    gcry_mpi_add_ui (c, c, 1);
+    /* c <- rn * g^m mod n^2 */
+    gcry_mpi_mulm (c, w->rn[i], c, n_square);
+    GNUNET_CRYPTO_mpi_print_unsigned (w->ciphertexts[i].bits,
+                                      sizeof(w->ciphertexts[i].bits),
+                                      c);
+  }
+  gcry_mpi_release (c);
+  gcry_mpi_release (n);
+  gcry_mpi_release (n_square);
+}
+
+
+int
+GNUNET_CRYPTO_paillier_encrypt_batch (
+  struct GNUNET_CRYPTO_PaillierContext *ctx,
+  const gcry_mpi_t *m,
+  unsigned int count,
+  int desired_ops,
+  struct GNUNET_CRYPTO_PaillierCiphertext *ciphertexts)
+{
+  struct BatchWorker workers[MAX_THREADS];
+  struct GNUNET_THREAD_Pool *tp;
+  unsigned int threads;
+  unsigned int have;
+  gcry_mpi_t *rn;
+  int min_ops;
+
+  if (0 == count)
+    return desired_ops;
+  rn = GNUNET_new_array (count,
+                         gcry_mpi_t);
+  /* use up what the background threads calculated so far,
+     the rest we calculate along with the encryption */
+  GNUNET_assert (0 == pthread_mutex_lock (&ctx->lock));
+  have = GNUNET_MIN (count,
+                     ctx->pool_len);
+  ctx->pool_len -= have;
+  GNUNET_memcpy (rn,
+                 &ctx->pool[ctx->pool_len],
+                 have * sizeof(gcry_mpi_t));
+  GNUNET_assert (0 == pthread_mutex_unlock (&ctx->lock));
+  threads = GNUNET_MIN (get_thread_count (),
+                        count / MIN_PER_THREAD);
+  threads = GNUNET_MAX (threads,
+                        1);
+  for (unsigned int t = 0; t < threads; t++)
+  {
+    struct BatchWorker *w = &workers[t];
+
+    w->ctx = ctx;
+    w->m = m;
+    w->rn = rn;
+    w->ciphertexts = ciphertexts;
+    w->desired_ops = desired_ops;
+    w->start = (unsigned int) ((uint64_t) count * t / threads);
+    w->count = (unsigned int) ((uint64_t) count * (t + 1) / threads)
+               - w->start;
+  }
+  /* the calling thread encrypts the first part */
+  tp = (1 < threads)
+       ? GNUNET_THREAD_pool_create (threads - 1)
+       : NULL;
+  for (unsigned int t = 1; t < threads; t++)
+    workers[t].job = GNUNET_THREAD_pool_submit (tp,
+                                                &encrypt_batch,
+                                                NULL,
+                                                &workers[t]);
+  encrypt_batch (&workers[0]);
+  min_ops = workers[0].min_ops;
+  for (unsigned int t = 1; t < threads; t++)
+  {
+    GNUNET_THREAD_pool_wait (workers[t].job);
+    min_ops = GNUNET_MIN (min_ops,
+                          workers[t].min_ops);
+  }
+  if (NULL != tp)
+    GNUNET_THREAD_pool_destroy (tp);
+  for (unsigned int i = 0; i < count; i++)
+    gcry_mpi_release (rn[i]);
+  GNUNET_free (rn);
+  return min_ops;
+}
+
+
+void
+GNUNET_CRYPTO_paillier_context_destroy (
+  struct GNUNET_CRYPTO_PaillierContext *ctx)
+{
+  GNUNET_assert (0 == pthread_mutex_lock (&ctx->lock));
+  ctx->pending = 0;
+  GNUNET_assert (0 == pthread_mutex_unlock (&ctx->lock));
+  wait_pool_jobs (ctx);
+  if (NULL != ctx->workers)
+    GNUNET_THREAD_pool_destroy (ctx->workers);
+  for (unsigned int i = 0; i < ctx->pool_len; i++)
+    gcry_mpi_release (ctx->pool[i]);
+  GNUNET_array_grow (ctx->pool,
+                     ctx->pool_size,
+                     0);
+  GNUNET_assert (0 == pthread_mutex_destroy (&ctx->lock));
+  gcry_mpi_release (ctx->n);
+  gcry_mpi_release (ctx->n_square);
+  GNUNET_free (ctx);
+}
+
+
 /**
  * Decrypt a paillier ciphertext with a private key.
  *
@@ -66,6 +66,12 @@ main (int argc, char *argv[])
   struct GNUNET_CRYPTO_EcdhePublicKey dhpub[l];
   struct GNUNET_CRYPTO_EddsaPrivateKey eddsa[l];
   struct GNUNET_CRYPTO_EddsaPublicKey dspub[l];
+  struct GNUNET_CRYPTO_EddsaPublicKey dspub2[l];
+  struct GNUNET_CRYPTO_EddsaPrivateScalar dsscalar;
+  struct GNUNET_CRYPTO_EcdsaPrivateKey ecdsa[l];
+  struct GNUNET_CRYPTO_EcdsaPublicKey ecpub[l];
+  struct GNUNET_CRYPTO_EcdsaPublicKey ecpub2[l];
+  struct GNUNET_CRYPTO_EccPoint point;
   struct TestSig sig[l];
 
   start = GNUNET_TIME_absolute_get ();
@@ -107,6 +113,57 @@ main (int argc, char *argv[])
                                                 &dspub[i]));
   log_duration ("EdDSA", "verify HashCode");
 
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+    GNUNET_CRYPTO_eddsa_public_key_derive (&dspub[i],
+                                           "label",
+                                           "gns",
+                                           &dspub2[i]);
+  log_duration ("EdDSA", "derive public");
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+    GNUNET_CRYPTO_eddsa_private_key_derive (&eddsa[i],
+                                            "label",
+                                            "gns",
+                                            &dsscalar);
+  log_duration ("EdDSA", "derive private");
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+    GNUNET_CRYPTO_ecdsa_key_create (&ecdsa[i]);
+  log_duration ("ECDSA", "create key");
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+    GNUNET_CRYPTO_ecdsa_key_get_public (&ecdsa[i], &ecpub[i]);
+  log_duration ("ECDSA", "get public");
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+    GNUNET_CRYPTO_ecdsa_public_key_derive (&ecpub[i],
+                                           "label",
+                                           "gns",
+                                           &ecpub2[i]);
+  log_duration ("ECDSA", "derive public");
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+  {
+    struct GNUNET_CRYPTO_EcdsaPrivateKey *dpriv;
+
+    dpriv = GNUNET_CRYPTO_ecdsa_private_key_derive (&ecdsa[i],
+                                                    "label",
+                                                    "gns");
+    GNUNET_free (dpriv);
+  }
+  log_duration ("ECDSA", "derive private");
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+    GNUNET_CRYPTO_ecc_dexp (i + 1, &point);
+  log_duration ("ECC", "dexp");
+
   start = GNUNET_TIME_absolute_get ();
   for (i = 0; i < l; i++)
     GNUNET_CRYPTO_ecdhe_key_create (&ecdhe[i]);
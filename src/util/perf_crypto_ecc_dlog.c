@@ -47,6 +47,12 @@
  */
 #define MAX_MEM 1024
 
+/**
+ * Memory to use for the table we keep in a file; as it only
+ * needs to be calculated once, it can be much bigger.
+ */
+#define TABLE_MEM (64 * 1024)
+
 /**
  * How many values do we test?
  */
@@ -137,12 +143,48 @@ test_dlog (struct GNUNET_CRYPTO_EccDlogContext *edc,
 }
 
 
+/**
+ * Benchmark DLOG operations.
+ *
+ * @param edc context for ECC operations
+ * @param what description of @a edc for the output
+ * @param gauger_name name of the value for gauger
+ */
+static void
+bench_dlog (struct GNUNET_CRYPTO_EccDlogContext *edc,
+            const char *what,
+            const char *gauger_name)
+{
+  struct GNUNET_TIME_Absolute start;
+  struct GNUNET_TIME_Relative delta;
+
+  start = GNUNET_TIME_absolute_get ();
+  /* first do a baseline run without the DLOG */
+  test_dlog (edc, false);
+  delta = GNUNET_TIME_absolute_get_duration (start);
+  start = GNUNET_TIME_absolute_get ();
+  test_dlog (edc, true);
+  delta = GNUNET_TIME_relative_subtract (GNUNET_TIME_absolute_get_duration (
+                                           start),
+                                         delta);
+  printf ("%u DLOG calculations with %s took %s\n",
+          TEST_ITER,
+          what,
+          GNUNET_STRINGS_relative_time_to_string (delta,
+                                                  GNUNET_YES));
+  GAUGER ("UTIL",
+          gauger_name,
+          delta.rel_value_us / 1000LL / TEST_ITER,
+          "ms/op");
+}
+
+
 int
 main (int argc, char *argv[])
 {
   struct GNUNET_CRYPTO_EccDlogContext *edc;
   struct GNUNET_TIME_Absolute start;
-  struct GNUNET_TIME_Relative delta;
+  char *fn;
 
   GNUNET_log_setup ("perf-crypto-ecc-dlog",
                     "WARNING",
@@ -157,25 +199,44 @@ main (int argc, char *argv[])
   GAUGER ("UTIL", "ECC DLOG initialization",
           GNUNET_TIME_absolute_get_duration
             (start).rel_value_us / 1000LL, "ms/op");
+  bench_dlog (edc,
+              "1M/1K",
+              "ECC DLOG operations");
+  GNUNET_CRYPTO_ecc_dlog_release (edc);
+
+  fn = GNUNET_DISK_mktemp ("perf-crypto-ecc-dlog");
+  if (NULL == fn)
+    return 1;
+  /* the (empty) file does not have a table yet, so this calculates
+     and stores it */
   start = GNUNET_TIME_absolute_get ();
-  /* first do a baseline run without the DLOG */
-  test_dlog (edc, false);
-  delta = GNUNET_TIME_absolute_get_duration (start);
+  edc = GNUNET_CRYPTO_ecc_dlog_prepare_file (MAX_FACT,
+                                             TABLE_MEM,
+                                             fn);
+  GNUNET_assert (NULL != edc);
+  printf ("DLOG precomputation 1M/64K into file took %s\n",
+          GNUNET_STRINGS_relative_time_to_string (
+            GNUNET_TIME_absolute_get_duration (start),
+            GNUNET_YES));
+  GNUNET_CRYPTO_ecc_dlog_release (edc);
   start = GNUNET_TIME_absolute_get ();
-  test_dlog (edc, true);
-  delta = GNUNET_TIME_relative_subtract (GNUNET_TIME_absolute_get_duration (
-                                           start),
-                                         delta);
-  printf ("%u DLOG calculations took %s\n",
-          TEST_ITER,
-          GNUNET_STRINGS_relative_time_to_string (delta,
-                                                  GNUNET_YES));
-  GAUGER ("UTIL",
-          "ECC DLOG operations",
-          delta.rel_value_us / 1000LL / TEST_ITER,
-          "ms/op");
-
+  edc = GNUNET_CRYPTO_ecc_dlog_prepare_file (MAX_FACT,
+                                             TABLE_MEM,
+                                             fn);
+  GNUNET_assert (NULL != edc);
+  printf ("DLOG loading 1M/64K from file took %s\n",
+          GNUNET_STRINGS_relative_time_to_string (
+            GNUNET_TIME_absolute_get_duration (start),
+            GNUNET_YES));
+  GAUGER ("UTIL", "ECC DLOG loading table",
+          GNUNET_TIME_absolute_get_duration
+            (start).rel_value_us / 1000LL, "ms/op");
+  bench_dlog (edc,
+              "1M/64K from file",
+              "ECC DLOG operations with table");
   GNUNET_CRYPTO_ecc_dlog_release (edc);
+  GNUNET_break (0 == unlink (fn));
+  GNUNET_free (fn);
   return 0;
 }
 
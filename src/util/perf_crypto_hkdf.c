@@ -0,0 +1,146 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2021 GNUnet e.V.
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+
+/**
+ * @file util/perf_crypto_hkdf.c
+ * @brief measure performance of the HMAC and key derivation functions
+ *        with the small inputs used per message by core, CADET and
+ *        the communicators
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <gauger.h>
+#include <gcrypt.h>
+
+static struct GNUNET_TIME_Absolute start;
+
+#define l 10000
+
+
+static void
+log_duration (const char *description)
+{
+  struct GNUNET_TIME_Relative t;
+
+  t = GNUNET_TIME_absolute_get_duration (start);
+  t = GNUNET_TIME_relative_divide (t, l);
+  fprintf (stdout,
+           "%22s: %10s\n",
+           description,
+           GNUNET_STRINGS_relative_time_to_string (t,
+                                                   GNUNET_NO));
+  GAUGER ("UTIL", description, t.rel_value_us, "us");
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  static const char ctx[] = "authentication key";
+  struct GNUNET_CRYPTO_SymmetricSessionKey skey;
+  struct GNUNET_CRYPTO_AuthKey akey;
+  struct GNUNET_CRYPTO_HmacContext hc;
+  struct GNUNET_CRYPTO_KdfContext kc;
+  struct GNUNET_HashCode hmac;
+  char msg[1024];
+  uint32_t seed;
+  int i;
+
+  GNUNET_log_setup ("perf-crypto-hkdf", "WARNING", NULL);
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                              &skey,
+                              sizeof(skey));
+  GNUNET_CRYPTO_random_block (GNUNET_CRYPTO_QUALITY_WEAK,
+                              msg,
+                              sizeof(msg));
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+  {
+    seed = i;
+    GNUNET_CRYPTO_hkdf (&akey, sizeof(akey),
+                        GCRY_MD_SHA256, GCRY_MD_SHA256,
+                        &seed, sizeof(seed),
+                        &skey, sizeof(skey),
+                        ctx, sizeof(ctx),
+                        NULL, 0);
+  }
+  log_duration ("HKDF SHA256 (gcrypt)");
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+  {
+    seed = i;
+    GNUNET_CRYPTO_kdf (&akey, sizeof(akey),
+                       &seed, sizeof(seed),
+                       &skey, sizeof(skey),
+                       ctx, sizeof(ctx),
+                       NULL, 0);
+  }
+  log_duration ("KDF new salt");
+
+  GNUNET_CRYPTO_kdf_context_init (&kc,
+                                  ctx,
+                                  sizeof(ctx));
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+  {
+    seed = i;
+    GNUNET_CRYPTO_kdf_context_derive (&kc,
+                                      &akey, sizeof(akey),
+                                      &skey, sizeof(skey),
+                                      &seed, sizeof(seed),
+                                      NULL, 0);
+  }
+  log_duration ("KDF context");
+  GNUNET_CRYPTO_kdf_context_clear (&kc);
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+    GNUNET_CRYPTO_hmac (&akey,
+                        msg,
+                        sizeof(msg),
+                        &hmac);
+  log_duration ("HMAC 1k new key");
+
+  GNUNET_CRYPTO_hmac_context_init (&hc,
+                                   akey.key,
+                                   sizeof(akey.key));
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+    GNUNET_CRYPTO_hmac_context_calculate (&hc,
+                                          msg,
+                                          sizeof(msg),
+                                          &hmac);
+  log_duration ("HMAC 1k context");
+
+  start = GNUNET_TIME_absolute_get ();
+  for (i = 0; i < l; i++)
+    GNUNET_CRYPTO_hmac_context_calculate (&hc,
+                                          &seed,
+                                          sizeof(seed),
+                                          &hmac);
+  log_duration ("HMAC 4 bytes context");
+  GNUNET_CRYPTO_hmac_context_clear (&hc);
+  return 0;
+}
+
+
+/* end of perf_crypto_hkdf.c */
@@ -35,6 +35,9 @@ main (int argc, char *argv[])
   struct GNUNET_CRYPTO_PaillierPublicKey public_key;
   struct GNUNET_CRYPTO_PaillierPrivateKey private_key;
   struct GNUNET_CRYPTO_PaillierCiphertext c1;
+  struct GNUNET_CRYPTO_PaillierCiphertext cb[100];
+  struct GNUNET_CRYPTO_PaillierContext *ctx;
+  gcry_mpi_t mb[100];
   gcry_mpi_t m1;
   unsigned int i;
 
@@ -72,6 +75,44 @@ main (int argc, char *argv[])
                        + GNUNET_TIME_absolute_get_duration
                          (start).rel_value_us / 1000LL), "ops/ms");
 
+  ctx = GNUNET_CRYPTO_paillier_context_create (&public_key);
+  GNUNET_assert (NULL != ctx);
+  for (i = 0; i < 100; i++)
+    mb[i] = m1;
+  start = GNUNET_TIME_absolute_get ();
+  GNUNET_CRYPTO_paillier_encrypt_batch (ctx,
+                                        mb,
+                                        100,
+                                        2,
+                                        cb);
+  printf ("100x batch encryption took %s\n",
+          GNUNET_STRINGS_relative_time_to_string (
+            GNUNET_TIME_absolute_get_duration (start),
+            GNUNET_YES));
+  GAUGER ("UTIL", "Paillier batch encryption",
+          64 * 1024 / (1
+                       + GNUNET_TIME_absolute_get_duration
+                         (start).rel_value_us / 10000LL), "ops/ms");
+  GNUNET_CRYPTO_paillier_precompute (ctx,
+                                     100);
+  /* give the background threads time to fill the pool */
+  sleep (10);
+  start = GNUNET_TIME_absolute_get ();
+  GNUNET_CRYPTO_paillier_encrypt_batch (ctx,
+                                        mb,
+                                        100,
+                                        2,
+                                        cb);
+  printf ("100x batch encryption with precomputed randomness took %s\n",
+          GNUNET_STRINGS_relative_time_to_string (
+            GNUNET_TIME_absolute_get_duration (start),
+            GNUNET_YES));
+  GAUGER ("UTIL", "Paillier precomputed batch encryption",
+          64 * 1024 / (1
+                       + GNUNET_TIME_absolute_get_duration
+                         (start).rel_value_us / 10000LL), "ops/ms");
+  GNUNET_CRYPTO_paillier_context_destroy (ctx);
+
   start = GNUNET_TIME_absolute_get ();
   for (i = 0; i < 10; i++)
     GNUNET_CRYPTO_paillier_decrypt (&private_key,
@@ -224,6 +224,64 @@ out:
 }
 
 
+static int
+test_batch ()
+{
+  gcry_mpi_t plaintexts[8];
+  gcry_mpi_t plaintext_result;
+  struct GNUNET_CRYPTO_PaillierCiphertext ciphertexts[8];
+  struct GNUNET_CRYPTO_PaillierPublicKey public_key;
+  struct GNUNET_CRYPTO_PaillierPrivateKey private_key;
+  struct GNUNET_CRYPTO_PaillierContext *ctx;
+  int ret = 0;
+
+  GNUNET_CRYPTO_paillier_create (&public_key,
+                                 &private_key);
+  ctx = GNUNET_CRYPTO_paillier_context_create (&public_key);
+  GNUNET_assert (NULL != ctx);
+  GNUNET_assert (NULL != (plaintext_result = gcry_mpi_new (0)));
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    GNUNET_assert (NULL != (plaintexts[i] = gcry_mpi_new (0)));
+    gcry_mpi_randomize (plaintexts[i],
+                        GNUNET_CRYPTO_PAILLIER_BITS / 8 * i + 1,
+                        GCRY_WEAK_RANDOM);
+  }
+  /* use some precomputed randomness, and some calculated on the fly */
+  GNUNET_CRYPTO_paillier_precompute (ctx,
+                                     4);
+  if (2 != GNUNET_CRYPTO_paillier_encrypt_batch (ctx,
+                                                 plaintexts,
+                                                 8,
+                                                 2,
+                                                 ciphertexts))
+  {
+    fprintf (stderr,
+             "GNUNET_CRYPTO_paillier_encrypt_batch should allow 2 operations!\n");
+    ret = 1;
+  }
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    GNUNET_CRYPTO_paillier_decrypt (&private_key,
+                                    &public_key,
+                                    &ciphertexts[i],
+                                    plaintext_result);
+    if (0 != gcry_mpi_cmp (plaintexts[i],
+                           plaintext_result))
+    {
+      fprintf (stderr,
+               "Paillier batch decryption failed with plaintext of size %u\n",
+               gcry_mpi_get_nbits (plaintexts[i]));
+      ret = 1;
+    }
+    gcry_mpi_release (plaintexts[i]);
+  }
+  gcry_mpi_release (plaintext_result);
+  GNUNET_CRYPTO_paillier_context_destroy (ctx);
+  return ret;
+}
+
+
 int
 main (int argc,
       char *argv[])
@@ -240,6 +298,9 @@ main (int argc,
   if (0 != ret)
     return ret;
   ret = test_hom ();
+  if (0 != ret)
+    return ret;
+  ret = test_batch ();
   return ret;
 }
 
@@ -0,0 +1,217 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2021 GNUnet e.V.
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+/**
+ * @file util/test_thread_pool.c
+ * @brief testcase for the thread pool
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+
+#define JOBS 64
+
+/**
+ * State of one job of the test.
+ */
+struct TestJob
+{
+  /**
+   * Handle of the job.
+   */
+  struct GNUNET_THREAD_Job *job;
+
+  /**
+   * Input of the job.
+   */
+  unsigned int in;
+
+  /**
+   * Output of the job.
+   */
+  unsigned int out;
+
+  /**
+   * How often did the continuation run?
+   */
+  unsigned int done;
+};
+
+
+static struct TestJob jobs[JOBS];
+
+static struct GNUNET_THREAD_Pool *pool;
+
+static unsigned int jobs_left;
+
+static int ret;
+
+
+/**
+ * Work of a job: square the input, slowly.
+ *
+ * @param cls a `struct TestJob`
+ */
+static void
+square (void *cls)
+{
+  struct TestJob *tj = cls;
+
+  tj->out = 0;
+  for (unsigned int i = 0; i < tj->in; i++)
+    tj->out += tj->in;
+}
+
+
+/**
+ * All jobs are done, release the pool.  Needed to terminate the
+ * scheduler, as the pool keeps watching its pipe until then.
+ *
+ * @param cls NULL
+ */
+static void
+finish (void *cls)
+{
+  (void) cls;
+  GNUNET_THREAD_pool_destroy (pool);
+  pool = NULL;
+}
+
+
+/**
+ * Continuation of a job: check the result.
+ *
+ * @param cls a `struct TestJob`
+ */
+static void
+check_square (void *cls)
+{
+  struct TestJob *tj = cls;
+
+  tj->job = NULL;
+  tj->done++;
+  if (tj->out != tj->in * tj->in)
+  {
+    GNUNET_break (0);
+    ret = 1;
+  }
+  if (0 != --jobs_left)
+    return;
+  for (unsigned int i = 0; i < JOBS; i++)
+    if (1 != jobs[i].done)
+    {
+      GNUNET_break (0);
+      ret = 1;
+    }
+  GNUNET_SCHEDULER_add_now (&finish,
+                            NULL);
+}
+
+
+/**
+ * Submit #JOBS jobs to #pool, wait for some of them right away and
+ * let the scheduler run the continuations of the others.
+ *
+ * @param cls NULL
+ */
+static void
+run (void *cls)
+{
+  (void) cls;
+  jobs_left = JOBS;
+  for (unsigned int i = 0; i < JOBS; i++)
+  {
+    jobs[i].in = 1000 * i;
+    jobs[i].done = 0;
+    jobs[i].job = GNUNET_THREAD_pool_submit (pool,
+                                             &square,
+                                             &check_square,
+                                             &jobs[i]);
+  }
+  for (unsigned int i = 0; i < JOBS; i += 3)
+  {
+    GNUNET_THREAD_pool_wait (jobs[i].job);
+    if (1 != jobs[i].done)
+    {
+      GNUNET_break (0);
+      ret = 1;
+    }
+  }
+}
+
+
+/**
+ * Run the test with a pool of @a threads threads.
+ *
+ * @param threads number of threads
+ */
+static void
+test_pool (unsigned int threads)
+{
+  struct TestJob tj;
+
+  pool = GNUNET_THREAD_pool_create (threads);
+  if (threads != GNUNET_THREAD_pool_get_size (pool))
+  {
+    GNUNET_break (0);
+    ret = 1;
+  }
+  /* without continuations, we do not need the scheduler */
+  tj.in = 12345;
+  tj.job = GNUNET_THREAD_pool_submit (pool,
+                                      &square,
+                                      NULL,
+                                      &tj);
+  GNUNET_THREAD_pool_wait (tj.job);
+  if (tj.out != tj.in * tj.in)
+  {
+    GNUNET_break (0);
+    ret = 1;
+  }
+  tj.job = GNUNET_THREAD_pool_submit (pool,
+                                      &square,
+                                      NULL,
+                                      &tj);
+  GNUNET_THREAD_pool_cancel (tj.job);
+  GNUNET_SCHEDULER_run (&run,
+                        NULL);
+  if ((0 != jobs_left) ||
+      (NULL != pool))
+  {
+    GNUNET_break (0);
+    ret = 1;
+  }
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  (void) argv;
+  GNUNET_log_setup ("test-thread-pool",
+                    "WARNING",
+                    NULL);
+  test_pool (0);
+  test_pool (1);
+  test_pool (4);
+  return ret;
+}
+
+
+/* end of test_thread_pool.c */
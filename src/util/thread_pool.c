@@ -0,0 +1,458 @@
+/*
+     This file is part of GNUnet.
+     Copyright (C) 2021 GNUnet e.V.
+
+     GNUnet is free software: you can redistribute it and/or modify it
+     under the terms of the GNU Affero General Public License as published
+     by the Free Software Foundation, either version 3 of the License,
+     or (at your option) any later version.
+
+     GNUnet is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Affero General Public License for more details.
+
+     You should have received a copy of the GNU Affero General Public License
+     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+     SPDX-License-Identifier: AGPL3.0-or-later
+ */
+
+/**
+ * @file util/thread_pool.c
+ * @brief pool of worker threads
+ */
+#include "platform.h"
+#include "gnunet_util_lib.h"
+#include <pthread.h>
+
+#define LOG_STRERROR(kind, syscall) \
+  GNUNET_log_from_strerror (kind, "util-thread-pool", syscall)
+
+
+/**
+ * State of a job.
+ */
+enum JobState
+{
+  /**
+   * Waiting for a worker thread.
+   */
+  JOB_QUEUED,
+
+  /**
+   * A worker thread is doing the work.
+   */
+  JOB_RUNNING,
+
+  /**
+   * Work done, waiting for the main thread.
+   */
+  JOB_DONE
+};
+
+
+/**
+ * Handle for a job submitted to a pool.
+ */
+struct GNUNET_THREAD_Job
+{
+  /**
+   * Kept in a DLL of the pool (queued or done jobs).
+   */
+  struct GNUNET_THREAD_Job *next;
+
+  /**
+   * Kept in a DLL of the pool (queued or done jobs).
+   */
+  struct GNUNET_THREAD_Job *prev;
+
+  /**
+   * Pool the job was submitted to.
+   */
+  struct GNUNET_THREAD_Pool *pool;
+
+  /**
+   * Work to do in a worker thread.
+   */
+  GNUNET_THREAD_JobWork work;
+
+  /**
+   * Continuation to run in the main thread, or NULL.
+   */
+  GNUNET_THREAD_JobDone done;
+
+  /**
+   * Closure for @e work and @e done.
+   */
+  void *cls;
+
+  /**
+   * State of the job, protected by the lock of the pool.
+   */
+  enum JobState state;
+};
+
+
+/**
+ * Handle for a pool of worker threads.
+ */
+struct GNUNET_THREAD_Pool
+{
+  /**
+   * Protects the job lists, the state of the jobs and @e stop.
+   */
+  pthread_mutex_t lock;
+
+  /**
+   * Signalled when jobs are added to @e todo_head.
+   */
+  pthread_cond_t work_cond;
+
+  /**
+   * Signalled when a worker thread finished a job.
+   */
+  pthread_cond_t done_cond;
+
+  /**
+   * Jobs waiting for a worker thread.
+   */
+  struct GNUNET_THREAD_Job *todo_head;
+
+  /**
+   * Jobs waiting for a worker thread.
+   */
+  struct GNUNET_THREAD_Job *todo_tail;
+
+  /**
+   * Jobs the worker threads are done with.
+   */
+  struct GNUNET_THREAD_Job *done_head;
+
+  /**
+   * Jobs the worker threads are done with.
+   */
+  struct GNUNET_THREAD_Job *done_tail;
+
+  /**
+   * Our worker threads, @e thread_count entries.
+   */
+  pthread_t *threads;
+
+  /**
+   * Number of entries in @e threads.
+   */
+  unsigned int thread_count;
+
+  /**
+   * Set to #GNUNET_YES to make the worker threads terminate.
+   */
+  int stop;
+
+  /**
+   * Pipe used to wake up the main thread when jobs with a
+   * continuation are done, NULL until we have such a job.
+   */
+  struct GNUNET_DISK_PipeHandle *pipe;
+
+  /**
+   * Task reading from @e pipe.
+   */
+  struct GNUNET_SCHEDULER_Task *done_task;
+};
+
+
+/**
+ * Hand a job whose work is done back to the main thread.  Must be
+ * called with the lock of the pool held.
+ *
+ * @param pool the pool
+ * @param job the job
+ */
+static void
+finish_job (struct GNUNET_THREAD_Pool *pool,
+            struct GNUNET_THREAD_Job *job)
+{
+  char c = 0;
+
+  job->state = JOB_DONE;
+  GNUNET_CONTAINER_DLL_insert_tail (pool->done_head,
+                                    pool->done_tail,
+                                    job);
+  GNUNET_assert (0 == pthread_cond_broadcast (&pool->done_cond));
+  if (NULL == job->done)
+    return;
+  /* if the pipe is full, the main thread will be woken anyway */
+  (void) GNUNET_DISK_file_write (GNUNET_DISK_pipe_handle (pool->pipe,
+                                                          GNUNET_DISK_PIPE_END_WRITE),
+                                 &c,
+                                 sizeof(c));
+}
+
+
+/**
+ * Main function of a worker thread.  Takes jobs from the
+ * @e todo_head of the pool and hands them back via @e done_head.
+ *
+ * @param cls the `struct GNUNET_THREAD_Pool`
+ * @return NULL
+ */
+static void *
+worker (void *cls)
+{
+  struct GNUNET_THREAD_Pool *pool = cls;
+  struct GNUNET_THREAD_Job *job;
+
+  GNUNET_assert (0 == pthread_mutex_lock (&pool->lock));
+  while (1)
+  {
+    while ((NULL == pool->todo_head) &&
+           (GNUNET_YES != pool->stop))
+      GNUNET_assert (0 == pthread_cond_wait (&pool->work_cond,
+                                             &pool->lock));
+    if (GNUNET_YES == pool->stop)
+      break;
+    job = pool->todo_head;
+    GNUNET_CONTAINER_DLL_remove (pool->todo_head,
+                                 pool->todo_tail,
+                                 job);
+    job->state = JOB_RUNNING;
+    GNUNET_assert (0 == pthread_mutex_unlock (&pool->lock));
+    job->work (job->cls);
+    GNUNET_assert (0 == pthread_mutex_lock (&pool->lock));
+    finish_job (pool,
+                job);
+  }
+  GNUNET_assert (0 == pthread_mutex_unlock (&pool->lock));
+  return NULL;
+}
+
+
+/**
+ * Worker threads completed jobs.  Run their continuations.
+ *
+ * @param cls the `struct GNUNET_THREAD_Pool`
+ */
+static void
+done_cb (void *cls)
+{
+  struct GNUNET_THREAD_Pool *pool = cls;
+  const struct GNUNET_DISK_FileHandle *wakeup;
+  struct GNUNET_THREAD_Job *job;
+  char buf[64];
+
+  wakeup = GNUNET_DISK_pipe_handle (pool->pipe,
+                                    GNUNET_DISK_PIPE_END_READ);
+  pool->done_task = NULL;
+  (void) GNUNET_DISK_file_read (wakeup,
+                                buf,
+                                sizeof(buf));
+  pool->done_task =
+    GNUNET_SCHEDULER_add_read_file (GNUNET_TIME_UNIT_FOREVER_REL,
+                                    wakeup,
+                                    &done_cb,
+                                    pool);
+  /* continuations may wait for or cancel other jobs on the done
+     list, so always start again from the head */
+  GNUNET_assert (0 == pthread_mutex_lock (&pool->lock));
+  while (1)
+  {
+    GNUNET_THREAD_JobDone done;
+    void *done_cls;
+
+    for (job = pool->done_head; NULL != job; job = job->next)
+      if (NULL != job->done)
+        break;
+    if (NULL == job)
+      break;
+    GNUNET_CONTAINER_DLL_remove (pool->done_head,
+                                 pool->done_tail,
+                                 job);
+    GNUNET_assert (0 == pthread_mutex_unlock (&pool->lock));
+    done = job->done;
+    done_cls = job->cls;
+    GNUNET_free (job);
+    done (done_cls);
+    GNUNET_assert (0 == pthread_mutex_lock (&pool->lock));
+  }
+  GNUNET_assert (0 == pthread_mutex_unlock (&pool->lock));
+}
+
+
+struct GNUNET_THREAD_Pool *
+GNUNET_THREAD_pool_create (unsigned int threads)
+{
+  struct GNUNET_THREAD_Pool *pool;
+
+  pool = GNUNET_new (struct GNUNET_THREAD_Pool);
+  GNUNET_assert (0 == pthread_mutex_init (&pool->lock,
+                                          NULL));
+  GNUNET_assert (0 == pthread_cond_init (&pool->work_cond,
+                                         NULL));
+  GNUNET_assert (0 == pthread_cond_init (&pool->done_cond,
+                                         NULL));
+  if (0 == threads)
+    return pool;
+  pool->threads = GNUNET_new_array (threads,
+                                    pthread_t);
+  for (unsigned int i = 0; i < threads; i++)
+  {
+    if (0 != pthread_create (&pool->threads[pool->thread_count],
+                             NULL,
+                             &worker,
+                             pool))
+    {
+      LOG_STRERROR (GNUNET_ERROR_TYPE_WARNING,
+                    "pthread_create");
+      break;
+    }
+    pool->thread_count++;
+  }
+  return pool;
+}
+
+
+unsigned int
+GNUNET_THREAD_pool_get_size (const struct GNUNET_THREAD_Pool *pool)
+{
+  return pool->thread_count;
+}
+
+
+struct GNUNET_THREAD_Job *
+GNUNET_THREAD_pool_submit (struct GNUNET_THREAD_Pool *pool,
+                           GNUNET_THREAD_JobWork work,
+                           GNUNET_THREAD_JobDone done,
+                           void *cls)
+{
+  struct GNUNET_THREAD_Job *job;
+
+  if ((NULL != done) &&
+      (NULL == pool->pipe))
+  {
+    pool->pipe = GNUNET_DISK_pipe (GNUNET_DISK_PF_NONE);
+    GNUNET_assert (NULL != pool->pipe);
+    pool->done_task =
+      GNUNET_SCHEDULER_add_read_file (GNUNET_TIME_UNIT_FOREVER_REL,
+                                      GNUNET_DISK_pipe_handle (
+                                        pool->pipe,
+                                        GNUNET_DISK_PIPE_END_READ),
+                                      &done_cb,
+                                      pool);
+  }
+  job = GNUNET_new (struct GNUNET_THREAD_Job);
+  job->pool = pool;
+  job->work = work;
+  job->done = done;
+  job->cls = cls;
+  if (0 == pool->thread_count)
+  {
+    job->state = JOB_RUNNING;
+    work (cls);
+    GNUNET_assert (0 == pthread_mutex_lock (&pool->lock));
+    finish_job (pool,
+                job);
+    GNUNET_assert (0 == pthread_mutex_unlock (&pool->lock));
+    return job;
+  }
+  GNUNET_assert (0 == pthread_mutex_lock (&pool->lock));
+  job->state = JOB_QUEUED;
+  GNUNET_CONTAINER_DLL_insert_tail (pool->todo_head,
+                                    pool->todo_tail,
+                                    job);
+  GNUNET_assert (0 == pthread_cond_signal (&pool->work_cond));
+  GNUNET_assert (0 == pthread_mutex_unlock (&pool->lock));
+  return job;
+}
+
+
+void
+GNUNET_THREAD_pool_wait (struct GNUNET_THREAD_Job *job)
+{
+  struct GNUNET_THREAD_Pool *pool = job->pool;
+  GNUNET_THREAD_JobDone done;
+  void *done_cls;
+
+  GNUNET_assert (0 == pthread_mutex_lock (&pool->lock));
+  while (JOB_DONE != job->state)
+    GNUNET_assert (0 == pthread_cond_wait (&pool->done_cond,
+                                           &pool->lock));
+  GNUNET_CONTAINER_DLL_remove (pool->done_head,
+                               pool->done_tail,
+                               job);
+  GNUNET_assert (0 == pthread_mutex_unlock (&pool->lock));
+  done = job->done;
+  done_cls = job->cls;
+  GNUNET_free (job);
+  if (NULL != done)
+    done (done_cls);
+}
+
+
+void
+GNUNET_THREAD_pool_cancel (struct GNUNET_THREAD_Job *job)
+{
+  struct GNUNET_THREAD_Pool *pool = job->pool;
+
+  GNUNET_assert (0 == pthread_mutex_lock (&pool->lock));
+  while (JOB_RUNNING == job->state)
+    GNUNET_assert (0 == pthread_cond_wait (&pool->done_cond,
+                                           &pool->lock));
+  if (JOB_QUEUED == job->state)
+    GNUNET_CONTAINER_DLL_remove (pool->todo_head,
+                                 pool->todo_tail,
+                                 job);
+  else
+    GNUNET_CONTAINER_DLL_remove (pool->done_head,
+                                 pool->done_tail,
+                                 job);
+  GNUNET_assert (0 == pthread_mutex_unlock (&pool->lock));
+  GNUNET_free (job);
+}
+
+
+void
+GNUNET_THREAD_pool_destroy (struct GNUNET_THREAD_Pool *pool)
+{
+  struct GNUNET_THREAD_Job *job;
+
+  GNUNET_assert (0 == pthread_mutex_lock (&pool->lock));
+  pool->stop = GNUNET_YES;
+  GNUNET_assert (0 == pthread_cond_broadcast (&pool->work_cond));
+  GNUNET_assert (0 == pthread_mutex_unlock (&pool->lock));
+  for (unsigned int i = 0; i < pool->thread_count; i++)
+    GNUNET_assert (0 == pthread_join (pool->threads[i],
+                                      NULL));
+  GNUNET_free (pool->threads);
+  while (NULL != (job = pool->todo_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (pool->todo_head,
+                                 pool->todo_tail,
+                                 job);
+    GNUNET_free (job);
+  }
+  while (NULL != (job = pool->done_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (pool->done_head,
+                                 pool->done_tail,
+                                 job);
+    GNUNET_free (job);
+  }
+  if (NULL != pool->done_task)
+  {
+    GNUNET_SCHEDULER_cancel (pool->done_task);
+    pool->done_task = NULL;
+  }
+  if (NULL != pool->pipe)
+  {
+    GNUNET_DISK_pipe_close (pool->pipe);
+    pool->pipe = NULL;
+  }
+  GNUNET_assert (0 == pthread_cond_destroy (&pool->done_cond));
+  GNUNET_assert (0 == pthread_cond_destroy (&pool->work_cond));
+  GNUNET_assert (0 == pthread_mutex_destroy (&pool->lock));
+  GNUNET_free (pool);
+}
+
+
+/* end of thread_pool.c */
@@ -90,6 +90,14 @@
  */
 #define DHT_GNS_REPLICATION_LEVEL 5
 
+/**
+ * How many blocks may be in the publishing pipeline (waiting for or
+ * being signed by a worker, or waiting for the DHT PUT to complete)?
+ * We never ask the namestore for more records than fit into the
+ * window, so we never exceed #DHT_QUEUE_LIMIT.
+ */
+#define SIGN_WINDOW DHT_QUEUE_LIMIT
+
 
 /**
  * Handle for DHT PUT activity triggered from the namestore monitor.
@@ -118,6 +126,97 @@ struct DhtPutActivity
 };
 
 
+/**
+ * A block to be signed by one of the signing workers.
+ */
+struct SignJob
+{
+  /**
+   * Kept in a DLL.
+   */
+  struct SignJob *next;
+
+  /**
+   * Kept in a DLL.
+   */
+  struct SignJob *prev;
+
+  /**
+   * Job handed to #sign_pool.
+   */
+  struct GNUNET_THREAD_Job *job;
+
+  /**
+   * Private key of the zone.
+   */
+  struct GNUNET_IDENTITY_PrivateKey key;
+
+  /**
+   * Label of the record set, allocated at the end of this struct.
+   */
+  const char *label;
+
+  /**
+   * Public records to sign, allocated at the end of this struct
+   * (followed by the record data).
+   */
+  struct GNUNET_GNSRECORD_Data *rd;
+
+  /**
+   * Number of records in @e rd.
+   */
+  unsigned int rd_count;
+
+  /**
+   * Expiration time of the block.
+   */
+  struct GNUNET_TIME_Absolute expire;
+
+  /**
+   * Resulting block, set by the worker; NULL on error.
+   */
+  struct GNUNET_GNSRECORD_Block *block;
+
+  /**
+   * Query under which to store the @e block, set by the worker.
+   */
+  struct GNUNET_HashCode query;
+};
+
+
+/**
+ * A block we signed earlier, kept so that the next zone iteration
+ * can republish it without signing it again.
+ */
+struct CachedBlock
+{
+  /**
+   * The signed block.
+   */
+  struct GNUNET_GNSRECORD_Block *block;
+
+  /**
+   * Query under which the @e block is stored.
+   */
+  struct GNUNET_HashCode query;
+
+  /**
+   * Expiration time of the @e block.
+   */
+  struct GNUNET_TIME_Absolute expire;
+
+  /**
+   * Hash over the public records in the @e block.
+   */
+  struct GNUNET_HashCode rd_hash;
+
+  /**
+   * Number of public records in the @e block.
+   */
+  unsigned int rd_count;
+};
+
+
 /**
  * Handle to the statistics service
  */
@@ -226,6 +325,11 @@ static struct GNUNET_SCHEDULER_Task *zone_publish_task;
  */
 static unsigned int ns_iteration_left;
 
+/**
+ * How many values did we ask the namestore for with the current query?
+ */
+static unsigned int ns_iteration_size;
+
 /**
  * #GNUNET_YES if zone has never been published before
  */
@@ -237,6 +341,339 @@ static int first_zone_iteration;
  */
 static int cache_keys;
 
+/**
+ * Number of signing worker threads, 0 to sign in the main thread.
+ */
+static unsigned long long sign_worker_count;
+
+/**
+ * Our signing worker threads, NULL to sign in the main thread.
+ */
+static struct GNUNET_THREAD_Pool *sign_pool;
+
+/**
+ * Jobs handed to #sign_pool and not yet collected.
+ */
+static struct SignJob *sign_head;
+
+/**
+ * Jobs handed to #sign_pool and not yet collected.
+ */
+static struct SignJob *sign_tail;
+
+/**
+ * Number of jobs submitted to the workers and not yet collected.
+ */
+static unsigned int sign_jobs_pending;
+
+/**
+ * #GNUNET_YES if we stopped asking the namestore for more records
+ * because the publishing pipeline is full.
+ */
+static int sign_window_full;
+
+/**
+ * Number of blocks signed since #sign_rate_start.
+ */
+static unsigned long long sign_cnt;
+
+/**
+ * When did we start counting #sign_cnt?
+ */
+static struct GNUNET_TIME_Absolute sign_rate_start;
+
+/**
+ * Blocks we signed, by hash over zone key and label.  NULL if
+ * we do not cache blocks.
+ */
+static struct GNUNET_CONTAINER_MultiHashMap *block_cache;
+
+/**
+ * Maximum number of blocks in #block_cache.
+ */
+static unsigned long long block_cache_size;
+
+/**
+ * Journal serial up to which the namestore told us about changed
+ * labels.
+ */
+static uint64_t journal_serial;
+
+/**
+ * How many more changed labels we expect from the namestore before
+ * we need to ask for the next batch.
+ */
+static unsigned int changes_left;
+
+
+/**
+ * Release @a job.
+ *
+ * @param job signing job to free
+ */
+static void
+free_sign_job (struct SignJob *job)
+{
+  GNUNET_free (job->block);
+  GNUNET_free (job);
+}
+
+
+/**
+ * Compute the key under which we cache the block for @a label
+ * in the zone @a key.
+ *
+ * @param key private key of the zone
+ * @param label label of the block
+ * @param hc[out] set to the cache key
+ */
+static void
+get_cache_key (const struct GNUNET_IDENTITY_PrivateKey *key,
+               const char *label,
+               struct GNUNET_HashCode *hc)
+{
+  struct GNUNET_HashContext *ctx;
+
+  ctx = GNUNET_CRYPTO_hash_context_start ();
+  GNUNET_CRYPTO_hash_context_read (ctx,
+                                   key,
+                                   sizeof(*key));
+  GNUNET_CRYPTO_hash_context_read (ctx,
+                                   label,
+                                   strlen (label));
+  GNUNET_CRYPTO_hash_context_finish (ctx,
+                                     hc);
+}
+
+
+/**
+ * Hash the public records of a record set, so that we notice if
+ * they differ from those in a cached block.
+ *
+ * @param rd_public public record data
+ * @param rd_public_count number of records in @a rd_public
+ * @param rd_hash[out] set to the hash
+ * @return #GNUNET_OK on success
+ */
+static int
+hash_records (const struct GNUNET_GNSRECORD_Data *rd_public,
+              unsigned int rd_public_count,
+              struct GNUNET_HashCode *rd_hash)
+{
+  ssize_t len;
+
+  len = GNUNET_GNSRECORD_records_get_size (rd_public_count,
+                                           rd_public);
+  if (len < 0)
+    return GNUNET_SYSERR;
+  {
+    char buf[GNUNET_NZL (len)];
+
+    if (len != GNUNET_GNSRECORD_records_serialize (rd_public_count,
+                                                   rd_public,
+                                                   len,
+                                                   buf))
+      return GNUNET_SYSERR;
+    GNUNET_CRYPTO_hash (buf,
+                        len,
+                        rd_hash);
+  }
+  return GNUNET_OK;
+}
+
+
+/**
+ * Free a cached block.
+ *
+ * @param cls NULL
+ * @param key unused
+ * @param value a `struct CachedBlock` to free
+ * @return #GNUNET_OK (continue to iterate)
+ */
+static int
+free_cached_block (void *cls,
+                   const struct GNUNET_HashCode *key,
+                   void *value)
+{
+  struct CachedBlock *cb = value;
+
+  (void) cls;
+  GNUNET_assert (GNUNET_YES ==
+                 GNUNET_CONTAINER_multihashmap_remove (block_cache,
+                                                       key,
+                                                       cb));
+  GNUNET_free (cb->block);
+  GNUNET_free (cb);
+  return GNUNET_OK;
+}
+
+
+/**
+ * Forget the cached block for @a label in zone @a key, if any.
+ *
+ * @param key private key of the zone
+ * @param label label of the block
+ */
+static void
+drop_cached_block (const struct GNUNET_IDENTITY_PrivateKey *key,
+                   const char *label)
+{
+  struct GNUNET_HashCode hc;
+  struct CachedBlock *cb;
+
+  get_cache_key (key,
+                 label,
+                 &hc);
+  cb = GNUNET_CONTAINER_multihashmap_get (block_cache,
+                                          &hc);
+  if (NULL != cb)
+    free_cached_block (NULL,
+                       &hc,
+                       cb);
+}
+
+
+/**
+ * Remember a block we signed so that we can republish it later.
+ * Takes ownership of @a block.
+ *
+ * @param key private key of the zone
+ * @param label label of the block
+ * @param rd_public public records in the block
+ * @param rd_public_count number of records in @a rd_public
+ * @param block the signed block
+ * @param query query for the @a block
+ * @param expire expiration time of the @a block
+ */
+static void
+cache_block (const struct GNUNET_IDENTITY_PrivateKey *key,
+             const char *label,
+             const struct GNUNET_GNSRECORD_Data *rd_public,
+             unsigned int rd_public_count,
+             struct GNUNET_GNSRECORD_Block *block,
+             const struct GNUNET_HashCode *query,
+             struct GNUNET_TIME_Absolute expire)
+{
+  struct GNUNET_HashCode hc;
+  struct CachedBlock *cb;
+
+  if (NULL == block_cache)
+  {
+    GNUNET_free (block);
+    return;
+  }
+  get_cache_key (key,
+                 label,
+                 &hc);
+  cb = GNUNET_CONTAINER_multihashmap_get (block_cache,
+                                          &hc);
+  if (NULL == cb)
+  {
+    if (GNUNET_CONTAINER_multihashmap_size (block_cache) >= block_cache_size)
+    {
+      GNUNET_free (block);
+      return;
+    }
+    cb = GNUNET_new (struct CachedBlock);
+    GNUNET_assert (GNUNET_OK ==
+                   GNUNET_CONTAINER_multihashmap_put (
+                     block_cache,
+                     &hc,
+                     cb,
+                     GNUNET_CONTAINER_MULTIHASHMAPOPTION_UNIQUE_ONLY));
+  }
+  if (GNUNET_OK !=
+      hash_records (rd_public,
+                    rd_public_count,
+                    &cb->rd_hash))
+  {
+    GNUNET_break (0);
+    free_cached_block (NULL,
+                       &hc,
+                       cb);
+    GNUNET_free (block);
+    return;
+  }
+  GNUNET_free (cb->block);
+  cb->block = block;
+  cb->query = *query;
+  cb->expire = expire;
+  cb->rd_count = rd_public_count;
+  GNUNET_STATISTICS_set (statistics,
+                         "Signed blocks cached",
+                         GNUNET_CONTAINER_multihashmap_size (block_cache),
+                         GNUNET_NO);
+}
+
+
+/**
+ * Find a cached block for @a label that is still good to publish
+ * @a rd_public until the next zone iteration.
+ *
+ * @param key private key of the zone
+ * @param label label of the block
+ * @param rd_public public records to publish
+ * @param rd_public_count number of records in @a rd_public
+ * @return NULL if we have to sign a new block
+ */
+static const struct CachedBlock *
+lookup_cached_block (const struct GNUNET_IDENTITY_PrivateKey *key,
+                     const char *label,
+                     const struct GNUNET_GNSRECORD_Data *rd_public,
+                     unsigned int rd_public_count)
+{
+  struct GNUNET_HashCode hc;
+  struct GNUNET_HashCode rd_hash;
+  struct CachedBlock *cb;
+
+  if (NULL == block_cache)
+    return NULL;
+  get_cache_key (key,
+                 label,
+                 &hc);
+  cb = GNUNET_CONTAINER_multihashmap_get (block_cache,
+                                          &hc);
+  if (NULL == cb)
+    return NULL;
+  if (GNUNET_TIME_absolute_get_remaining (cb->expire).rel_value_us <
+      zone_publish_time_window.rel_value_us)
+    return NULL; /* expires before we come around again, re-sign */
+  if ((cb->rd_count != rd_public_count) ||
+      (GNUNET_OK !=
+       hash_records (rd_public,
+                     rd_public_count,
+                     &rd_hash)) ||
+      (0 != GNUNET_memcmp (&rd_hash,
+                           &cb->rd_hash)))
+    return NULL; /* changed after we looked at the journal */
+  return cb;
+}
+
+
+/**
+ * Stop the signing workers (if any) and discard all jobs that
+ * were not yet published.
+ */
+static void
+sign_workers_stop (void)
+{
+  struct SignJob *job;
+
+  if (NULL == sign_pool)
+    return;
+  while (NULL != (job = sign_head))
+  {
+    GNUNET_CONTAINER_DLL_remove (sign_head,
+                                 sign_tail,
+                                 job);
+    GNUNET_THREAD_pool_cancel (job->job);
+    free_sign_job (job);
+  }
+  sign_jobs_pending = 0;
+  GNUNET_THREAD_pool_destroy (sign_pool);
+  sign_pool = NULL;
+}
+
 
 /**
  * Task run during shutdown.
@@ -252,6 +689,15 @@ shutdown_task (void *cls)
   (void) cls;
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Shutting down!\n");
+  sign_workers_stop ();
+  if (NULL != block_cache)
+  {
+    GNUNET_CONTAINER_multihashmap_iterate (block_cache,
+                                           &free_cached_block,
+                                           NULL);
+    GNUNET_CONTAINER_multihashmap_destroy (block_cache);
+    block_cache = NULL;
+  }
   while (NULL != (ma = it_head))
   {
     GNUNET_DHT_put_cancel (ma->ph);
@@ -299,13 +745,26 @@ shutdown_task (void *cls)
 static void
 publish_zone_namestore_next (void *cls)
 {
+  unsigned int pending;
+
   (void) cls;
   zone_publish_task = NULL;
   GNUNET_assert (NULL != namestore_iter);
   GNUNET_assert (0 == ns_iteration_left);
-  ns_iteration_left = NS_BLOCK_SIZE;
+  /* every record takes at most one slot in the publishing pipeline,
+     so do not ask for more records than there are free slots */
+  pending = sign_jobs_pending + dht_queue_length;
+  if (pending >= SIGN_WINDOW)
+  {
+    /* pipeline full, continue iteration once it drained */
+    sign_window_full = GNUNET_YES;
+    return;
+  }
+  ns_iteration_size = GNUNET_MIN (NS_BLOCK_SIZE,
+                                  SIGN_WINDOW - pending);
+  ns_iteration_left = ns_iteration_size;
   GNUNET_NAMESTORE_zone_iterator_next (namestore_iter,
-                                       NS_BLOCK_SIZE);
+                                       ns_iteration_size);
 }
 
 
@@ -486,15 +945,15 @@ check_zone_namestore_next ()
   put_cnt = 0;
   delay = GNUNET_TIME_relative_subtract (target_iteration_velocity_per_record,
                                          sub_delta);
-  /* We delay *once* per #NS_BLOCK_SIZE, so we need to multiply the
-     per-record delay calculated so far with the #NS_BLOCK_SIZE */
+  /* We delay *once* per NAMESTORE query, so we need to multiply the
+     per-record delay calculated so far with the size of the query */
   GNUNET_STATISTICS_set (statistics,
                          "Current artificial NAMESTORE delay (μs/record)",
                          delay.rel_value_us,
                          GNUNET_NO);
   delay = GNUNET_TIME_relative_multiply (delay,
-                                         NS_BLOCK_SIZE);
-  /* make sure we do not overshoot because of the #NS_BLOCK_SIZE factor */
+                                         ns_iteration_size);
+  /* make sure we do not overshoot because of the query size factor */
   delay = GNUNET_TIME_relative_min (MAXIMUM_ZONE_ITERATION_INTERVAL,
                                     delay);
   /* no delays on first iteration */
@@ -507,6 +966,25 @@ check_zone_namestore_next ()
 }
 
 
+/**
+ * Check if the publishing pipeline has room for more blocks, and if
+ * so continue the zone iteration (if we paused it because the
+ * pipeline was full).
+ */
+static void
+check_sign_window ()
+{
+  if (GNUNET_YES != sign_window_full)
+    return;
+  if (sign_jobs_pending + dht_queue_length > SIGN_WINDOW / 2)
+    return;
+  sign_window_full = GNUNET_NO;
+  GNUNET_assert (NULL == zone_publish_task);
+  zone_publish_task = GNUNET_SCHEDULER_add_now (&publish_zone_namestore_next,
+                                                NULL);
+}
+
+
 /**
  * Continuation called from DHT once the PUT operation is done.
  *
@@ -524,6 +1002,7 @@ dht_put_continuation (void *cls)
                                it_tail,
                                ma);
   GNUNET_free (ma);
+  check_sign_window ();
 }
 
 
@@ -569,31 +1048,31 @@ convert_records_for_export (const struct GNUNET_GNSRECORD_Data *rd,
 
 
 /**
- * Store GNS records in the DHT.
+ * Create and sign the block for @a label.  Must not use the
+ * scheduler, statistics or logging, as it may be run by one of
+ * the signing workers.
  *
  * @param key key of the zone
  * @param label label to store under
  * @param rd_public public record data
  * @param rd_public_count number of records in @a rd_public
- * @param ma handle for the put operation
- * @return DHT PUT handle, NULL on error
+ * @param expire expiration time of the block
+ * @param use_cache #GNUNET_YES to use the (not thread-safe) key cache
+ * @param query[out] set to the query for the block
+ * @return the signed block, NULL on error
  */
-static struct GNUNET_DHT_PutHandle *
-perform_dht_put (const struct GNUNET_IDENTITY_PrivateKey *key,
-                 const char *label,
-                 const struct GNUNET_GNSRECORD_Data *rd_public,
-                 unsigned int rd_public_count,
-                 struct DhtPutActivity *ma)
+static struct GNUNET_GNSRECORD_Block *
+sign_block (const struct GNUNET_IDENTITY_PrivateKey *key,
+            const char *label,
+            const struct GNUNET_GNSRECORD_Data *rd_public,
+            unsigned int rd_public_count,
+            struct GNUNET_TIME_Absolute expire,
+            int use_cache,
+            struct GNUNET_HashCode *query)
 {
   struct GNUNET_GNSRECORD_Block *block;
-  struct GNUNET_HashCode query;
-  struct GNUNET_TIME_Absolute expire;
-  size_t block_size;
-  struct GNUNET_DHT_PutHandle *ret;
 
-  expire = GNUNET_GNSRECORD_record_get_expiration_time (rd_public_count,
-                                                        rd_public);
-  if (cache_keys)
+  if (use_cache)
     block = GNUNET_GNSRECORD_block_create2 (key,
                                             expire,
                                             label,
@@ -606,14 +1085,55 @@ perform_dht_put (const struct GNUNET_IDENTITY_PrivateKey *key,
                                            rd_public,
                                            rd_public_count);
   if (NULL == block)
-  {
-    GNUNET_break (0);
-    return NULL;   /* whoops */
-  }
-  block_size = GNUNET_GNSRECORD_block_get_size (block);
+    return NULL;
   GNUNET_GNSRECORD_query_from_private_key (key,
                                            label,
-                                           &query);
+                                           query);
+  return block;
+}
+
+
+/**
+ * We signed another block, update the signing rate statistic.
+ */
+static void
+count_signed_block ()
+{
+  struct GNUNET_TIME_Relative delta;
+
+  sign_cnt++;
+  if (0 != sign_cnt % DELTA_INTERVAL)
+    return;
+  delta = GNUNET_TIME_absolute_get_duration (sign_rate_start);
+  if (0 != delta.rel_value_us)
+    GNUNET_STATISTICS_set (statistics,
+                           "Signed blocks per second",
+                           sign_cnt * 1000LL * 1000LL / delta.rel_value_us,
+                           GNUNET_NO);
+  sign_cnt = 0;
+  sign_rate_start = GNUNET_TIME_absolute_get ();
+}
+
+
+/**
+ * Store a signed GNS block in the DHT.
+ *
+ * @param block the signed block
+ * @param query the query to store the @a block under
+ * @param expire expiration time of the @a block
+ * @param label label of the block (for logging)
+ * @param rd_public_count number of records in @a block (for logging)
+ * @param ma handle for the put operation
+ * @return DHT PUT handle, NULL on error
+ */
+static struct GNUNET_DHT_PutHandle *
+put_signed_block (const struct GNUNET_GNSRECORD_Block *block,
+                  const struct GNUNET_HashCode *query,
+                  struct GNUNET_TIME_Absolute expire,
+                  const char *label,
+                  unsigned int rd_public_count,
+                  struct DhtPutActivity *ma)
+{
   GNUNET_STATISTICS_update (statistics,
                             "DHT put operations initiated",
                             1,
@@ -623,23 +1143,237 @@ perform_dht_put (const struct GNUNET_IDENTITY_PrivateKey *key,
               rd_public_count,
               label,
               GNUNET_STRINGS_absolute_time_to_string (expire),
-              GNUNET_h2s (&query));
+              GNUNET_h2s (query));
   num_public_records++;
-  ret = GNUNET_DHT_put (dht_handle,
-                        &query,
-                        DHT_GNS_REPLICATION_LEVEL,
-                        GNUNET_DHT_RO_DEMULTIPLEX_EVERYWHERE,
-                        GNUNET_BLOCK_TYPE_GNS_NAMERECORD,
-                        block_size,
-                        block,
-                        expire,
-                        &dht_put_continuation,
-                        ma);
-  GNUNET_free (block);
+  return GNUNET_DHT_put (dht_handle,
+                         query,
+                         DHT_GNS_REPLICATION_LEVEL,
+                         GNUNET_DHT_RO_DEMULTIPLEX_EVERYWHERE,
+                         GNUNET_BLOCK_TYPE_GNS_NAMERECORD,
+                         GNUNET_GNSRECORD_block_get_size (block),
+                         block,
+                         expire,
+                         &dht_put_continuation,
+                         ma);
+}
+
+
+/**
+ * Store GNS records in the DHT.
+ *
+ * @param key key of the zone
+ * @param label label to store under
+ * @param rd_public public record data
+ * @param rd_public_count number of records in @a rd_public
+ * @param ma handle for the put operation
+ * @return DHT PUT handle, NULL on error
+ */
+static struct GNUNET_DHT_PutHandle *
+perform_dht_put (const struct GNUNET_IDENTITY_PrivateKey *key,
+                 const char *label,
+                 const struct GNUNET_GNSRECORD_Data *rd_public,
+                 unsigned int rd_public_count,
+                 struct DhtPutActivity *ma)
+{
+  struct GNUNET_GNSRECORD_Block *block;
+  struct GNUNET_HashCode query;
+  struct GNUNET_TIME_Absolute expire;
+  struct GNUNET_DHT_PutHandle *ret;
+
+  expire = GNUNET_GNSRECORD_record_get_expiration_time (rd_public_count,
+                                                        rd_public);
+  block = sign_block (key,
+                      label,
+                      rd_public,
+                      rd_public_count,
+                      expire,
+                      cache_keys,
+                      &query);
+  if (NULL == block)
+  {
+    GNUNET_break (0);
+    return NULL;   /* whoops */
+  }
+  count_signed_block ();
+  ret = put_signed_block (block,
+                          &query,
+                          expire,
+                          label,
+                          rd_public_count,
+                          ma);
+  cache_block (key,
+               label,
+               rd_public,
+               rd_public_count,
+               block,
+               &query,
+               expire);
   return ret;
 }
 
 
+/**
+ * Remember @a ma as pending DHT PUT, cancelling the oldest
+ * PUT if we have too many pending.
+ *
+ * @param ma the PUT that was started
+ */
+static void
+track_dht_put (struct DhtPutActivity *ma)
+{
+  dht_queue_length++;
+  GNUNET_CONTAINER_DLL_insert_tail (it_head,
+                                    it_tail,
+                                    ma);
+  if (dht_queue_length > DHT_QUEUE_LIMIT)
+  {
+    ma = it_head;
+    GNUNET_CONTAINER_DLL_remove (it_head,
+                                 it_tail,
+                                 ma);
+    GNUNET_DHT_put_cancel (ma->ph);
+    dht_queue_length--;
+    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                "DHT PUT unconfirmed after %s, aborting PUT\n",
+                GNUNET_STRINGS_relative_time_to_string (
+                  GNUNET_TIME_absolute_get_duration (ma->start_date),
+                  GNUNET_YES));
+    GNUNET_free (ma);
+  }
+}
+
+
+/**
+ * Sign the block of a job.  Run in one of the signing workers.
+ *
+ * @param cls a `struct SignJob`
+ */
+static void
+sign_job_work (void *cls)
+{
+  struct SignJob *job = cls;
+
+  job->block = sign_block (&job->key,
+                           job->label,
+                           job->rd,
+                           job->rd_count,
+                           job->expire,
+                           GNUNET_NO,
+                           &job->query);
+}
+
+
+/**
+ * A signing worker completed a job.  Start the DHT PUT for the
+ * signed block.
+ *
+ * @param cls a `struct SignJob`
+ */
+static void
+sign_job_done (void *cls)
+{
+  struct SignJob *job = cls;
+  struct DhtPutActivity *ma;
+
+  GNUNET_CONTAINER_DLL_remove (sign_head,
+                               sign_tail,
+                               job);
+  sign_jobs_pending--;
+  if (NULL == job->block)
+  {
+    GNUNET_break (0);
+  }
+  else
+  {
+    count_signed_block ();
+    ma = GNUNET_new (struct DhtPutActivity);
+    ma->start_date = GNUNET_TIME_absolute_get ();
+    ma->ph = put_signed_block (job->block,
+                               &job->query,
+                               job->expire,
+                               job->label,
+                               job->rd_count,
+                               ma);
+    if (NULL == ma->ph)
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                  "Could not perform DHT PUT, is the DHT running?\n");
+      GNUNET_free (ma);
+    }
+    else
+    {
+      track_dht_put (ma);
+    }
+    cache_block (&job->key,
+                 job->label,
+                 job->rd,
+                 job->rd_count,
+                 job->block,
+                 &job->query,
+                 job->expire);
+    job->block = NULL;
+  }
+  free_sign_job (job);
+  check_sign_window ();
+}
+
+
+/**
+ * Hand the records for @a label to the signing workers.
+ *
+ * @param key key of the zone
+ * @param label label to store under
+ * @param rd_public public record data
+ * @param rd_public_count number of records in @a rd_public
+ */
+static void
+submit_sign_job (const struct GNUNET_IDENTITY_PrivateKey *key,
+                 const char *label,
+                 const struct GNUNET_GNSRECORD_Data *rd_public,
+                 unsigned int rd_public_count)
+{
+  struct SignJob *job;
+  size_t label_len = strlen (label) + 1;
+  size_t data_size = 0;
+  char *pos;
+
+  for (unsigned int i = 0; i < rd_public_count; i++)
+    data_size += rd_public[i].data_size;
+  job = GNUNET_malloc (sizeof(struct SignJob)
+                       + rd_public_count * sizeof(struct GNUNET_GNSRECORD_Data)
+                       + label_len
+                       + data_size);
+  job->key = *key;
+  job->rd_count = rd_public_count;
+  job->rd = (struct GNUNET_GNSRECORD_Data *) &job[1];
+  job->expire = GNUNET_GNSRECORD_record_get_expiration_time (rd_public_count,
+                                                             rd_public);
+  pos = (char *) &job->rd[rd_public_count];
+  memcpy (pos,
+          label,
+          label_len);
+  job->label = pos;
+  pos += label_len;
+  for (unsigned int i = 0; i < rd_public_count; i++)
+  {
+    job->rd[i] = rd_public[i];
+    GNUNET_memcpy (pos,
+                   rd_public[i].data,
+                   rd_public[i].data_size);
+    job->rd[i].data = pos;
+    pos += rd_public[i].data_size;
+  }
+  sign_jobs_pending++;
+  GNUNET_CONTAINER_DLL_insert_tail (sign_head,
+                                    sign_tail,
+                                    job);
+  job->job = GNUNET_THREAD_pool_submit (sign_pool,
+                                        &sign_job_work,
+                                        &sign_job_done,
+                                        job);
+}
+
+
 /**
  * We encountered an error in our zone iteration.
  *
@@ -652,6 +1386,7 @@ zone_iteration_error (void *cls)
   GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
               "Got disconnected from namestore database, retrying.\n");
   namestore_iter = NULL;
+  sign_window_full = GNUNET_NO;
   /* We end up here on error/disconnect/shutdown, so potentially
      while a zone publish task or a DHT put is still running; hence
      we need to cancel those. */
@@ -731,6 +1466,7 @@ put_gns_record (void *cls,
   struct GNUNET_GNSRECORD_Data rd_public[rd_count];
   unsigned int rd_public_count;
   struct DhtPutActivity *ma;
+  const struct CachedBlock *cb;
 
   (void) cls;
   ns_iteration_left--;
@@ -744,16 +1480,52 @@ put_gns_record (void *cls,
     check_zone_namestore_next ();
     return;
   }
-  /* We got a set of records to publish */
-  GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
-              "Starting DHT PUT\n");
-  ma = GNUNET_new (struct DhtPutActivity);
-  ma->start_date = GNUNET_TIME_absolute_get ();
-  ma->ph = perform_dht_put (key,
+  cb = lookup_cached_block (key,
                             label,
                             rd_public,
-                            rd_public_count,
-                            ma);
+                            rd_public_count);
+  if (NULL != cb)
+  {
+    /* Unchanged since we signed it, and not about to expire */
+    GNUNET_STATISTICS_update (statistics,
+                              "Cached blocks republished",
+                              1,
+                              GNUNET_NO);
+    ma = GNUNET_new (struct DhtPutActivity);
+    ma->start_date = GNUNET_TIME_absolute_get ();
+    ma->ph = put_signed_block (cb->block,
+                               &cb->query,
+                               cb->expire,
+                               label,
+                               cb->rd_count,
+                               ma);
+  }
+  else if (NULL != sign_pool)
+  {
+    /* Let the workers sign, the DHT PUT is started once done */
+    submit_sign_job (key,
+                     label,
+                     rd_public,
+                     rd_public_count);
+    put_cnt++;
+    if (0 == put_cnt % DELTA_INTERVAL)
+      update_velocity (DELTA_INTERVAL);
+    check_zone_namestore_next ();
+    return;
+  }
+  else
+  {
+    /* We got a set of records to publish */
+    GNUNET_log (GNUNET_ERROR_TYPE_DEBUG,
+                "Starting DHT PUT\n");
+    ma = GNUNET_new (struct DhtPutActivity);
+    ma->start_date = GNUNET_TIME_absolute_get ();
+    ma->ph = perform_dht_put (key,
+                              label,
+                              rd_public,
+                              rd_public_count,
+                              ma);
+  }
   put_cnt++;
   if (0 == put_cnt % DELTA_INTERVAL)
     update_velocity (DELTA_INTERVAL);
@@ -765,38 +1537,16 @@ put_gns_record (void *cls,
     GNUNET_free (ma);
     return;
   }
-  dht_queue_length++;
-  GNUNET_CONTAINER_DLL_insert_tail (it_head,
-                                    it_tail,
-                                    ma);
-  if (dht_queue_length > DHT_QUEUE_LIMIT)
-  {
-    ma = it_head;
-    GNUNET_CONTAINER_DLL_remove (it_head,
-                                 it_tail,
-                                 ma);
-    GNUNET_DHT_put_cancel (ma->ph);
-    dht_queue_length--;
-    GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
-                "DHT PUT unconfirmed after %s, aborting PUT\n",
-                GNUNET_STRINGS_relative_time_to_string (
-                  GNUNET_TIME_absolute_get_duration (ma->start_date),
-                  GNUNET_YES));
-    GNUNET_free (ma);
-  }
+  track_dht_put (ma);
 }
 
 
 /**
- * Periodically iterate over all zones and store everything in DHT
- *
- * @param cls NULL
+ * Iterate over all zones and store everything in DHT.
  */
 static void
-publish_zone_dht_start (void *cls)
+publish_zone_namestore_start ()
 {
-  (void) cls;
-  zone_publish_task = NULL;
   GNUNET_STATISTICS_update (statistics,
                             "Full zone iterations launched",
                             1,
@@ -805,8 +1555,10 @@ publish_zone_dht_start (void *cls)
               "Starting DHT zone update!\n");
   /* start counting again */
   num_public_records = 0;
+  sign_window_full = GNUNET_NO;
   GNUNET_assert (NULL == namestore_iter);
   ns_iteration_left = 1;
+  ns_iteration_size = 1;
   namestore_iter
     = GNUNET_NAMESTORE_zone_iteration_start (namestore_handle,
                                              NULL, /* All zones */
@@ -820,6 +1572,96 @@ publish_zone_dht_start (void *cls)
 }
 
 
+/**
+ * A label changed since we last looked at the journal, so its cached
+ * block (if any) is outdated.
+ *
+ * @param cls NULL
+ * @param key the private key of the zone
+ * @param label the label that changed
+ * @param rd_count the number of records now in @a rd
+ * @param rd the record data
+ */
+static void
+drop_changed_block (void *cls,
+                    const struct GNUNET_IDENTITY_PrivateKey *key,
+                    const char *label,
+                    unsigned int rd_count,
+                    const struct GNUNET_GNSRECORD_Data *rd)
+{
+  (void) cls;
+  (void) rd_count;
+  (void) rd;
+  GNUNET_STATISTICS_update (statistics,
+                            "Changed labels seen in journal",
+                            1,
+                            GNUNET_NO);
+  drop_cached_block (key,
+                     label);
+  if (0 != --changes_left)
+    return;
+  changes_left = NS_BLOCK_SIZE;
+  GNUNET_NAMESTORE_zone_iterator_next (namestore_iter,
+                                       NS_BLOCK_SIZE);
+}
+
+
+/**
+ * We caught up with the change journal, now republish the zones.
+ *
+ * @param cls NULL
+ * @param serial journal serial we are now up to, 0 if unknown
+ */
+static void
+changes_finished (void *cls,
+                  uint64_t serial)
+{
+  (void) cls;
+  namestore_iter = NULL;
+  if (0 == serial)
+  {
+    /* no journal, we cannot know which blocks are still good */
+    GNUNET_CONTAINER_multihashmap_iterate (block_cache,
+                                           &free_cached_block,
+                                           NULL);
+  }
+  journal_serial = serial;
+  publish_zone_namestore_start ();
+}
+
+
+/**
+ * Periodically iterate over all zones and store everything in DHT,
+ * first dropping cached blocks of labels that changed.
+ *
+ * @param cls NULL
+ */
+static void
+publish_zone_dht_start (void *cls)
+{
+  (void) cls;
+  zone_publish_task = NULL;
+  if (NULL == block_cache)
+  {
+    publish_zone_namestore_start ();
+    return;
+  }
+  GNUNET_assert (NULL == namestore_iter);
+  changes_left = 1;
+  namestore_iter
+    = GNUNET_NAMESTORE_zone_changes_start (namestore_handle,
+                                           NULL, /* All zones */
+                                           journal_serial,
+                                           &zone_iteration_error,
+                                           NULL,
+                                           &drop_changed_block,
+                                           NULL,
+                                           &changes_finished,
+                                           NULL);
+  GNUNET_assert (NULL != namestore_iter);
+}
+
+
 /**
  * Perform zonemaster duties: watch namestore, publish records.
  *
@@ -833,6 +1675,7 @@ run (void *cls,
      struct GNUNET_SERVICE_Handle *service)
 {
   unsigned long long max_parallel_bg_queries = 128;
+  unsigned long long key_cache_size;
 
   (void) cls;
   (void) service;
@@ -851,6 +1694,26 @@ run (void *cls,
   cache_keys = GNUNET_CONFIGURATION_get_value_yesno (c,
                                                      "namestore",
                                                      "CACHE_KEYS");
+  if (GNUNET_OK !=
+      GNUNET_CONFIGURATION_get_value_number (c,
+                                             "zonemaster",
+                                             "SIGN_WORKERS",
+                                             &sign_worker_count))
+    sign_worker_count = 0;
+  if ((GNUNET_OK ==
+       GNUNET_CONFIGURATION_get_value_number (c,
+                                              "zonemaster",
+                                              "BLOCK_CACHE_SIZE",
+                                              &block_cache_size)) &&
+      (0 != block_cache_size))
+    block_cache = GNUNET_CONTAINER_multihashmap_create (1024,
+                                                        GNUNET_NO);
+  if (GNUNET_OK ==
+      GNUNET_CONFIGURATION_get_value_number (c,
+                                             "zonemaster",
+                                             "KEY_CACHE_SIZE",
+                                             &key_cache_size))
+    GNUNET_GNSRECORD_set_key_cache_size ((unsigned int) key_cache_size);
   zone_publish_time_window_default = GNUNET_DHT_DEFAULT_REPUBLISH_FREQUENCY;
   if (GNUNET_OK ==
       GNUNET_CONFIGURATION_get_value_time (c,
@@ -888,6 +1751,19 @@ run (void *cls,
     return;
   }
 
+  sign_rate_start = GNUNET_TIME_absolute_get ();
+  if (0 != sign_worker_count)
+  {
+    sign_pool = GNUNET_THREAD_pool_create (sign_worker_count);
+    if (0 == GNUNET_THREAD_pool_get_size (sign_pool))
+    {
+      GNUNET_log (GNUNET_ERROR_TYPE_WARNING,
+                  "Failed to start signing workers, signing in main thread\n");
+      GNUNET_THREAD_pool_destroy (sign_pool);
+      sign_pool = NULL;
+    }
+  }
+
   /* Schedule periodic put for our records. */
   first_zone_iteration = GNUNET_YES;
   statistics = GNUNET_STATISTICS_create ("zonemaster",